@@ -10,9 +10,9 @@ export PATH="$GITHUB_WORKSPACE/pgsql/bin:$GITHUB_WORKSPACE/python3-venv/bin:$PAT
 if [ $GITHUB_JOB = "run-benchmark" ]; then
 	pip_packages="psycopg2-binary six testgres python-telegram-bot matplotlib"
 elif [ $GITHUB_JOB = "pgindent" ]; then
-	pip_packages="psycopg2 six testgres moto[s3] flask flask_cors boto3 pyOpenSSL yapf"
+	pip_packages="psycopg2 six testgres moto[s3] flask flask_cors boto3 pyOpenSSL zstandard yapf"
 else
-	pip_packages="psycopg2 six testgres moto[s3] flask flask_cors boto3 pyOpenSSL"
+	pip_packages="psycopg2 six testgres moto[s3] flask flask_cors boto3 pyOpenSSL zstandard"
 fi
 
 # install required packages
@@ -0,0 +1,29 @@
+/*-------------------------------------------------------------------------
+ *
+ * ahi.h
+ *		Declarations for adaptive hash index over orioledb B-tree leaves.
+ *
+ * Copyright (c) 2021-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/btree/ahi.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __BTREE_AHI_H__
+#define __BTREE_AHI_H__
+
+#include "btree.h"
+
+extern int	adaptive_hash_index_size;
+
+extern Size ahi_shmem_needs(void);
+extern void ahi_shmem_init(Pointer ptr, bool found);
+
+extern bool ahi_get_tag(BTreeDescr *desc, void *key, BTreeKeyType keyType,
+						uint64 *tag);
+extern bool ahi_lookup(BTreeDescr *desc, uint64 tag,
+					   BTreeLocationHint *hint);
+extern void ahi_remember(uint64 tag, BTreeLocationHint *hint);
+
+#endif							/* __BTREE_AHI_H__ */
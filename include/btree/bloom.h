@@ -0,0 +1,41 @@
+/*-------------------------------------------------------------------------
+ *
+ * bloom.h
+ *		Declarations for Bloom filters over evicted orioledb B-tree pages.
+ *
+ * Copyright (c) 2021-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/btree/bloom.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __BTREE_BLOOM_H__
+#define __BTREE_BLOOM_H__
+
+#include "btree.h"
+
+#define BLOOM_FILTER_BITS	(4096)
+#define BLOOM_FILTER_HASHES	(3)
+
+/* Filter over the keys of the evicted subtree */
+typedef struct
+{
+	uint64		words[BLOOM_FILTER_BITS / 64];
+} OBloomFilter;
+
+extern int	bloom_filter_size;
+
+extern Size bloom_filter_shmem_needs(void);
+extern void bloom_filter_shmem_init(Pointer ptr, bool found);
+
+extern bool bloom_filter_key_hash(BTreeDescr *desc, void *key,
+								  BTreeKeyType keyType, uint64 *hash);
+extern bool bloom_filter_build(BTreeDescr *desc, Page p, OBloomFilter *filter);
+extern void bloom_filter_remember(BTreeDescr *desc, uint64 downlink,
+								  OBloomFilter *filter);
+extern void bloom_filter_forget(BTreeDescr *desc, uint64 downlink);
+extern bool bloom_filter_excludes(BTreeDescr *desc, uint64 downlink,
+								  uint64 hash);
+
+#endif							/* __BTREE_BLOOM_H__ */
@@ -124,6 +124,27 @@ typedef enum
 	OTupleKeyLengthNoVersion
 } OLengthType;
 
+#define O_KEY_IMAGE_MAX_VALUES	(3)
+
+/*
+ * Normalized (order-preserving) image of the leading key columns.  Each
+ * column is mapped to uint64 preserving the comparator order, so images
+ * could be compared as plain integers.  Different images define the
+ * comparison result, while equal images require a comparator call.
+ *
+ * Some images (for instance, of text or uuid) contain only a prefix of the
+ * value.  Comparison can't proceed to the following columns after equal
+ * inexact images.
+ */
+typedef struct
+{
+	/* Number of imaged leading columns */
+	uint8		nvalues;
+	/* Number of leading images representing column values exactly */
+	uint8		nexact;
+	uint64		values[O_KEY_IMAGE_MAX_VALUES];
+} OKeyImage;
+
 typedef struct
 {
 	/*
@@ -149,6 +170,13 @@ typedef struct
 	uint32		(*hash) (BTreeDescr *desc, OTuple tuple, BTreeKeyType tupleType);
 	uint32		(*unique_hash) (BTreeDescr *desc, OTuple tuple);
 	OBTreeKeyCmp cmp;
+
+	/*
+	 * Optional.  Fills the normalized image of the leading key columns of
+	 * `p`.  Returns false when no image is available.  See OKeyImage.
+	 */
+	bool		(*key_image) (BTreeDescr *desc, void *p, BTreeKeyType keyType,
+							  OKeyImage *image);
 } BTreeOps;
 
 #define MAX_NUM_DIRTY_PARTS			4
@@ -184,6 +212,8 @@ struct BTreeDescr
 	SeqBufDescPrivate tmpBuf[2];
 	BTreeS3PartsInfo buildPartsInfo[2];
 	OXid		createOxid;
+	/* end of the last extent given by get_extent() to this backend */
+	uint64		lastExtentEnd;
 	BTreeOps   *ops;
 };
 
@@ -216,6 +246,34 @@ o_btree_needs_undo(BTreeDescr *desc, BTreeOperationType action,
 							  oldDeleted, newTuple, newOxid);
 }
 
+static inline bool
+o_btree_key_image(BTreeDescr *desc, void *p, BTreeKeyType keyType,
+				  OKeyImage *image)
+{
+	return (desc->ops->key_image != NULL) &&
+		desc->ops->key_image(desc, p, keyType, image);
+}
+
+/*
+ * Compare key images.  Returns zero when images don't define the result of
+ * keys comparison.
+ */
+static inline int
+o_key_image_cmp(OKeyImage *image1, OKeyImage *image2)
+{
+	int			i,
+				n = Min(image1->nvalues, image2->nvalues);
+
+	for (i = 0; i < n; i++)
+	{
+		if (image1->values[i] != image2->values[i])
+			return (image1->values[i] < image2->values[i]) ? -1 : 1;
+		if (i >= image1->nexact || i >= image2->nexact)
+			break;
+	}
+	return 0;
+}
+
 static inline uint32
 o_btree_hash(BTreeDescr *desc, OTuple tuple, BTreeKeyType tupleType)
 {
@@ -269,6 +327,13 @@ typedef struct
 #define TREE_NUM_LEAF_PAGES(desc) \
 	(pg_atomic_read_u32(&BTREE_GET_META(desc)->leafPagesNum))
 
+/*
+ * Get estimated number of live tuples per tree leaf page, zero if unknown.
+ */
+#define TREE_LEAF_DENSITY(desc) \
+	((double) pg_atomic_read_u32(&BTREE_GET_META(desc)->leafTuplesDensity) / \
+	 O_LEAF_DENSITY_SCALE)
+
 /*
  * Check if given tree needs WAL and XIP records.  Currently, only primary index
  * tree and TOAST tree need it.  Argument is (BTreeDescr *).
@@ -366,5 +431,7 @@ extern void btree_page_stopevent_params_internal(BTreeDescr *desc, Page p,
 extern Jsonb *btree_page_stopevent_params(BTreeDescr *desc, Page p);
 extern Jsonb *btree_downlink_stopevent_params(BTreeDescr *desc, Page p,
 											  BTreePageItemLocator *loc);
+extern void btree_mark_subtree_dirty(BTreeDescr *desc, OInMemoryBlkno blkno);
+extern void btree_page_adopt_children(OInMemoryBlkno blkno);
 
 #endif							/* __BTREE_H__ */
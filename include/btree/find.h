@@ -56,6 +56,12 @@ typedef struct
 	 * BTREE_PAGE_FIND_LOKEY_UNDO is set when present.
 	 */
 	OFixedKey	undoLokey;
+
+	/*
+	 * Bloom filter hash of the key being looked up.  Valid when
+	 * BTREE_PAGE_FIND_SKIP_ABSENT is set.
+	 */
+	uint64		keyHash;
 	uint16		flags;
 } OBTreeFindPageContext;
 
@@ -72,6 +78,8 @@ typedef struct
 #define BTREE_PAGE_FIND_IMAGE			(0x0200)
 #define BTREE_PAGE_FIND_DOWNLINK_LOCATION (0x0400)
 #define BTREE_PAGE_FIND_READ_CSN		(0x0800)
+#define BTREE_PAGE_FIND_SKIP_ABSENT		(0x1000)
+#define BTREE_PAGE_FIND_KEY_ABSENT		(0x2000)
 
 #define BTREE_PAGE_FIND_SET(context, flag) ((context)->flags |= BTREE_PAGE_FIND_##flag)
 #define BTREE_PAGE_FIND_UNSET(context, flag) ((context)->flags &= ~(BTREE_PAGE_FIND_##flag))
@@ -91,11 +99,18 @@ extern bool refind_page(OBTreeFindPageContext *context, void *key,
 						OInMemoryBlkno blkno, uint32 pageChangeCount);
 
 extern bool find_right_page(OBTreeFindPageContext *context, OFixedKey *hikey);
+extern bool find_page_from_leaf(OBTreeFindPageContext *context, void *key,
+								BTreeKeyType keyType);
 extern bool find_left_page(OBTreeFindPageContext *context, OFixedKey *hikey);
 extern OTuple btree_find_context_lokey(OBTreeFindPageContext *context);
+extern bool btree_finger_find_page(OBTreeFindPageContext *context, void *key,
+								   BTreeKeyType keyType);
+extern void btree_finger_remember(OBTreeFindPageContext *context);
 extern void btree_find_context_from_modify_to_read(OBTreeFindPageContext *context,
 												   Pointer key,
 												   BTreeKeyType keyType,
 												   uint16 level);
+extern void btree_prefetch_key(BTreeDescr *desc, Pointer key,
+							   BTreeKeyType keyType);
 
 #endif							/* __BTREE_FIND_H__ */
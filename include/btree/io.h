@@ -24,9 +24,20 @@ typedef enum OWalkPageResult
 	OWalkPageMerged,
 } OWalkPageResult;
 
+/* Classes of I/O having separate concurrency budgets */
+typedef enum OIOClass
+{
+	OIOClassForegroundRead,
+	OIOClassEvictionWrite,
+	OIOClassCheckpoint,
+	OIOClassS3,
+	OIOClassesCount
+} OIOClass;
+
 extern Size btree_io_shmem_needs(void);
 extern void btree_io_shmem_init(Pointer buf, bool found);
 extern void btree_io_error_cleanup(void);
+extern void set_io_class(OIOClass ioClass);
 extern void request_btree_io_lwlocks(void);
 extern int	assign_io_num(OInMemoryBlkno blkno, OffsetNumber offnum);
 extern OWalkPageResult walk_page(OInMemoryBlkno blkno, bool evict);
@@ -42,6 +53,7 @@ extern void btree_init_smgr(BTreeDescr *descr);
 extern void btree_open_smgr(BTreeDescr *descr);
 extern void btree_close_smgr(BTreeDescr *descr);
 extern char *btree_filename(Oid datoid, Oid relnode, int segno, uint32 chkpNum);
+extern List *btree_stripe_directories(void);
 extern char *btree_smgr_filename(BTreeDescr *desc, off_t offset,
 								 uint32 chkpNum);
 extern int	btree_smgr_read(BTreeDescr *desc, char *buffer, uint32 chkpNum,
@@ -51,9 +63,13 @@ extern void btree_smgr_writeback(BTreeDescr *desc, uint32 chkpNum,
 extern void btree_smgr_sync(BTreeDescr *desc, uint32 chkpNum, off_t length);
 extern void btree_smgr_punch_hole(BTreeDescr *desc, uint32 chkpNum,
 								  off_t offset, int length);
+extern void btree_smgr_preallocate(BTreeDescr *desc, off_t oldLength,
+								   off_t newLength);
 extern void init_btree_io_lwlocks(void);
 extern bool read_page_from_disk(BTreeDescr *desc, Pointer img, uint64 downlink, FileExtent *extent);
+extern void prefetch_page_from_disk(BTreeDescr *desc, uint64 downlink);
 extern void load_page(OBTreeFindPageContext *context);
+extern double page_read_latency(void);
 extern uint64 perform_page_io(BTreeDescr *desc, OInMemoryBlkno blkno,
 							  Page img, uint32 checkpoint_number,
 							  bool copy_blkno, bool *dirty_parent);
@@ -0,0 +1,29 @@
+/*-------------------------------------------------------------------------
+ *
+ * io_stats.h
+ *		Declarations of per-tree I/O statistics.
+ *
+ * Copyright (c) 2025-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/btree/io_stats.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __BTREE_IO_STATS_H__
+#define __BTREE_IO_STATS_H__
+
+#include "orioledb.h"
+
+#include "portability/instr_time.h"
+
+extern Size tree_io_stats_shmem_needs(void);
+extern void tree_io_stats_shmem_init(Pointer ptr, bool found);
+extern void tree_io_stats_page_load(ORelOids oids, uint64 bytes,
+									instr_time *start);
+extern void tree_io_stats_s3_load(Oid datoid, Oid relnode);
+extern void tree_io_stats_page_write(ORelOids oids, uint64 bytes,
+									 instr_time *start);
+extern void tree_io_stats_page_evict(ORelOids oids);
+
+#endif							/* __BTREE_IO_STATS_H__ */
@@ -46,6 +46,8 @@ extern BTreeIterator *o_btree_iterator_create(BTreeDescr *desc, void *key,
 											  BTreeKeyType kind,
 											  OSnapshot *o_snapshot,
 											  ScanDirection scan);
+extern void o_btree_iterator_rescan(BTreeIterator *it, void *key,
+									BTreeKeyType kind);
 extern void o_btree_iterator_set_tuple_ctx(BTreeIterator *it,
 										   MemoryContext tupleCxt);
 extern void o_btree_iterator_set_callback(BTreeIterator *it,
@@ -56,6 +58,12 @@ extern OTuple o_btree_iterator_fetch(BTreeIterator *it,
 									 void *end, BTreeKeyType endType,
 									 bool endIsIncluded,
 									 BTreeLocationHint *hint);
+extern int	o_btree_iterator_fetch_batch(BTreeIterator *it, OTuple *tuples,
+										 CommitSeqNo *tupleCsns, int maxTuples,
+										 void *end, BTreeKeyType endType,
+										 bool endIsIncluded,
+										 BTreeLocationHint *hint);
+extern bool o_btree_iterator_get_hikey(BTreeIterator *it, OFixedKey *hikey);
 extern OTuple btree_iterate_raw(BTreeIterator *it, void *end,
 								BTreeKeyType endKind, bool endInclude,
 								bool *scanEnd, BTreeLocationHint *hint);
@@ -82,5 +90,11 @@ extern OTuple o_find_tuple_version(BTreeDescr *desc, Page p,
 								   MemoryContext mcxt,
 								   TupleFetchCallback cb,
 								   void *arg);
+extern OTuple o_find_tuple_version_ref(BTreeDescr *desc, Page p,
+									   BTreePageItemLocator *loc,
+									   OSnapshot *oSnapshot,
+									   CommitSeqNo *tupleCsn,
+									   MemoryContext mcxt,
+									   bool *allocated);
 
 #endif							/* __BTREE_ITERATOR_H__ */
@@ -0,0 +1,39 @@
+/*-------------------------------------------------------------------------
+ *
+ * key_sample.h
+ *		Declarations for sampling of the accessed keys.
+ *
+ * Copyright (c) 2025-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/btree/key_sample.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __BTREE_KEY_SAMPLE_H__
+#define __BTREE_KEY_SAMPLE_H__
+
+#include "btree/find.h"
+
+extern int	key_sample_rate;
+extern uint32 keySampleCounter;
+
+extern Size key_sample_shmem_needs(void);
+extern void key_sample_shmem_init(Pointer ptr, bool found);
+extern void btree_key_sample_take(OBTreeFindPageContext *context);
+
+/*
+ * Samples one of each key_sample_rate leaf lookups and modifications.  Must
+ * be called once the context is positioned to the key within the leaf.
+ */
+static inline void
+btree_key_sample(OBTreeFindPageContext *context)
+{
+	if (key_sample_rate > 0 && ++keySampleCounter >= key_sample_rate)
+	{
+		keySampleCounter = 0;
+		btree_key_sample_take(context);
+	}
+}
+
+#endif							/* __BTREE_KEY_SAMPLE_H__ */
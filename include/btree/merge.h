@@ -15,6 +15,14 @@
 
 #include "btree.h"
 
+typedef struct
+{
+	uint64		pagesScanned;
+	uint64		pagesCompacted;
+	uint64		pagesMerged;
+	uint64		bytesReclaimed;
+} OBTreeVacuumStats;
+
 extern bool btree_try_merge_pages(BTreeDescr *desc,
 								  OInMemoryBlkno parent_blkno,
 								  OFixedKey *parent_hikey,
@@ -26,5 +34,6 @@ extern bool btree_try_merge_pages(BTreeDescr *desc,
 extern bool btree_try_merge_and_unlock(BTreeDescr *desc, OInMemoryBlkno blkno,
 									   bool nested, bool wait_io);
 extern bool is_page_too_sparse(BTreeDescr *desc, Page p);
+extern void btree_vacuum_tree(BTreeDescr *desc, OBTreeVacuumStats *stats);
 
 #endif							/* __BTREE_MERGE_H__ */
@@ -46,6 +46,13 @@ typedef struct BTreeModifyCallbackInfo
 														 BTreeLocationHint *hint,
 														 void *arg);
 	bool		needsUndoForSelfCreated;
+
+	/*
+	 * The wait callback never waits.  So, a conflicting in-progress
+	 * transaction at the head of the tuple chain is reported to it without
+	 * walking the row-level locks in undo.
+	 */
+	bool		noWait;
 	void	   *arg;
 } BTreeModifyCallbackInfo;
 
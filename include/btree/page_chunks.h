@@ -22,6 +22,17 @@ typedef enum BTreeItemPageFitType
 	BTreeItemPageFitSplitRequired
 } BTreeItemPageFitType;
 
+/*
+ * Observed leaf access mix.  Stored in the leaf page header and used to
+ * choose between finer chunks (read-heavy) and coarser chunks (write-heavy).
+ */
+typedef enum BTreePageAccessMix
+{
+	BTreePageAccessBalanced = 0,
+	BTreePageAccessReadHeavy = 1,
+	BTreePageAccessWriteHeavy = 2
+} BTreePageAccessMix;
+
 typedef struct
 {
 	Pointer		data;
@@ -41,7 +52,9 @@ extern BTreeItemPageFitType page_locator_fits_item(BTreeDescr *desc,
 extern void perform_page_compaction(BTreeDescr *desc, OInMemoryBlkno blkno,
 									BTreePageItemLocator *loc,
 									OTuple tuple, LocationIndex tuplesize, bool replace);
-extern void o_btree_page_calculate_statistics(BTreeDescr *desc, Pointer p);
+extern void page_mark_all_visible(BTreeDescr *desc, Page p);
+extern int	o_btree_page_calculate_statistics(BTreeDescr *desc, Pointer p);
+extern void o_btree_update_leaf_density(BTreeDescr *desc, int nLive);
 extern void init_page_first_chunk(BTreeDescr *desc, Page p,
 								  LocationIndex hikeySize);
 extern void page_chunk_fill_locator(Page p, OffsetNumber chunkOffset,
@@ -61,6 +74,8 @@ extern LocationIndex page_locator_get_item_size(Page p,
 extern void page_locator_resize_item(Page p, BTreePageItemLocator *locator,
 									 LocationIndex newsize);
 extern void page_locator_delete_item(Page p, BTreePageItemLocator *locator);
+extern void page_count_read(OInMemoryBlkno blkno);
+extern void page_count_write(OInMemoryBlkno blkno);
 extern void page_split_chunk_if_needed(BTreeDescr *desc, Page p,
 									   BTreePageItemLocator *locator);
 extern void btree_page_reorg(BTreeDescr *desc, Page p, BTreePageItem *items,
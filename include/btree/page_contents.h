@@ -18,6 +18,8 @@
 
 #define NUM_SEQ_SCANS_ARRAY_SIZE	32
 
+#define O_LEAF_DENSITY_SCALE	16
+
 /* The structure of BTree meta page.  Referenced by metaPageBlkno. */
 typedef struct
 {
@@ -40,12 +42,39 @@ typedef struct
 	pg_atomic_uint64 ctid;
 	pg_atomic_uint32 leafPagesNum;
 
+	/*
+	 * Signed score of the recent leaf splits: positive for ascending inserts,
+	 * negative for descending.  See btree_get_split_left_count().
+	 */
+	pg_atomic_uint32 insertPattern;
+
+	/*
+	 * Running estimate of live tuples per leaf page multiplied by
+	 * O_LEAF_DENSITY_SCALE, zero if unknown yet.  Updated on leaf splits and
+	 * merges, see o_btree_page_calculate_statistics().
+	 */
+	pg_atomic_uint32 leafTuplesDensity;
+
+	/*
+	 * The compression dictionary for the new page images, see
+	 * O_COMPRESS_DICT_MAKE().  Zero if none.
+	 */
+	pg_atomic_uint64 compressDict;
+
 	/* Number of running sequential scans depending on the checkpoint number */
 	pg_atomic_uint32 numSeqScans[NUM_SEQ_SCANS_ARRAY_SIZE];
 
 	bool		dirtyFlag1;
 	bool		dirtyFlag2;
 
+	/*
+	 * Set when the subtree dirty marks might be lost.  Then the next
+	 * checkpoint walks the whole tree.
+	 */
+	pg_atomic_uint32 subtreeDirtyUnknown;
+	/* The checkpoint walk of the tree is in progress (checkpointer only) */
+	bool		subtreeWalkActive;
+
 	BTreeS3PartsInfo partsInfo[2];
 
 	LWLock		punchHolesLock;
@@ -133,6 +162,7 @@ typedef struct
 #define O_BTREE_FLAG_LEAF				(0x0004)
 #define O_BTREE_FLAG_BROKEN_SPLIT		(0x0008)
 #define O_BTREE_FLAG_PRE_CLEANUP		(0x0010)
+#define O_BTREE_FLAG_ALL_VISIBLE		(0x0020)
 #define O_BTREE_FLAGS_ROOT_INIT		(O_BTREE_FLAG_LEAF | O_BTREE_FLAG_RIGHTMOST | O_BTREE_FLAG_LEFTMOST)
 
 /* Check given property of B-tree page */
@@ -242,6 +272,8 @@ typedef struct PartialPageState PartialPageState;
 
 #define PAGE_GET_LEVEL(p) (O_PAGE_IS(p, LEAF) ? 0 : ((BTreePageHeader *)(p))->field1)
 #define PAGE_SET_LEVEL(p, level) (AssertMacro(!O_PAGE_IS(p, LEAF)), ((BTreePageHeader *)(p))->field1 = (level))
+#define PAGE_GET_ACCESS_MIX(p) (AssertMacro(O_PAGE_IS(p, LEAF)), ((BTreePageHeader *)(p))->field1)
+#define PAGE_SET_ACCESS_MIX(p, mix) (AssertMacro(O_PAGE_IS(p, LEAF)), ((BTreePageHeader *)(p))->field1 = (mix))
 #define PAGE_GET_N_ONDISK(p) (AssertMacro(!O_PAGE_IS(p, LEAF)), ((BTreePageHeader *)(p))->field2)
 #define PAGE_SET_N_ONDISK(p, n) (AssertMacro(!O_PAGE_IS(p, LEAF)), ((BTreePageHeader *)(p))->field2 = (n))
 #define PAGE_INC_N_ONDISK(p) (AssertMacro(!O_PAGE_IS(p, LEAF)), ((BTreePageHeader *)(p))->field2++)
@@ -30,6 +30,13 @@
 #define O_PAGE_STATE_BLOCK_READ(state) ((state) | PAGE_STATE_LOCKED_FLAG | PAGE_STATE_NO_READ_FLAG)
 #define O_PAGE_STATE_READ_IS_BLOCKED(state) ((state) & PAGE_STATE_NO_READ_FLAG)
 
+/* Number of spin delays before waiting for reads to be enabled */
+#define PAGE_READ_SPIN_DELAYS	(1000)
+
+extern bool page_lock_stats;
+
+extern Size page_lock_stats_shmem_needs(void);
+extern void page_lock_stats_shmem_init(Pointer ptr, bool found);
 extern bool have_locked_pages(void);
 extern void lock_page(OInMemoryBlkno blkno);
 extern void relock_page(OInMemoryBlkno blkno);
@@ -39,6 +46,7 @@ extern bool page_is_locked(OInMemoryBlkno blkno);
 extern void page_block_reads(OInMemoryBlkno blkno);
 extern void unlock_page(OInMemoryBlkno blkno);
 extern void release_all_page_locks(void);
+extern bool page_spin_for_read_enable(OInMemoryBlkno blkno);
 extern void page_wait_for_read_enable(OInMemoryBlkno blkno);
 extern void btree_register_inprogress_split(OInMemoryBlkno left_blkno);
 extern void btree_unregister_inprogress_split(OInMemoryBlkno left_blkno);
@@ -0,0 +1,30 @@
+/*-------------------------------------------------------------------------
+ *
+ * residency.h
+ *		Declarations for pinning of trees in the page pool.
+ *
+ * Copyright (c) 2025-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/btree/residency.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __BTREE_RESIDENCY_H__
+#define __BTREE_RESIDENCY_H__
+
+#include "orioledb.h"
+
+#include "btree/btree.h"
+
+extern int	pinned_pages_limit;
+extern bool orioledb_enable_residency_costing;
+
+extern Size pinned_trees_shmem_needs(void);
+extern void pinned_trees_shmem_init(Pointer ptr, bool found);
+extern bool o_page_is_pinned(OInMemoryBlkno blkno);
+extern bool o_tree_is_pinned(ORelOids oids);
+extern double o_tree_resident_fraction(BTreeDescr *desc);
+extern BlockNumber o_tree_costed_pages(BTreeDescr *desc, BlockNumber pages);
+
+#endif							/* __BTREE_RESIDENCY_H__ */
@@ -15,6 +15,7 @@
 
 #include "btree/btree.h"
 #include "btree/page_contents.h"
+#include "btree/zone_map.h"
 
 #include "executor/tuptable.h"
 #include "utils/sampling.h"
@@ -46,9 +47,16 @@ extern BTreeSeqScan *make_btree_seq_scan_cb(BTreeDescr *desc,
 											void *arg);
 extern BTreeSeqScan *make_btree_sampling_scan(BTreeDescr *desc,
 											  BlockSampler sampler);
+extern void btree_seq_scan_set_zone_map(BTreeSeqScan *scan,
+										OZoneMapQual *qual, uint64 *skipped);
 extern OTuple btree_seq_scan_getnext(BTreeSeqScan *scan, MemoryContext mctx,
 									 CommitSeqNo *tupleCsn,
 									 BTreeLocationHint *hint);
+extern OTuple btree_seq_scan_getnext_ref(BTreeSeqScan *scan,
+										 MemoryContext mctx,
+										 CommitSeqNo *tupleCsn,
+										 BTreeLocationHint *hint,
+										 bool *allocated);
 extern OTuple btree_seq_scan_getnext_raw(BTreeSeqScan *scan, MemoryContext mctx,
 										 bool *end, BTreeLocationHint *hint);
 extern void free_btree_seq_scan(BTreeSeqScan *scan);
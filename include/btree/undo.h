@@ -72,6 +72,14 @@ extern BTreeLeafTuphdr *make_undo_record(BTreeDescr *desc, OTuple tuple,
 										 bool is_tuple, BTreeOperationType action,
 										 OInMemoryBlkno blkno, uint32 pageChangeCount,
 										 UndoLocation *undoLocation);
+extern BTreeLeafTuphdr *make_update_undo_record(BTreeDescr *desc,
+												OTuple prevTuple,
+												OTuple nextTuple,
+												OInMemoryBlkno blkno,
+												uint32 pageChangeCount,
+												UndoLocation *undoLocation);
+extern bool prev_tuple_is_delta_in_undo(UndoLogType undoType,
+										BTreeLeafTuphdr *tuphdr);
 
 extern void get_page_from_undo(BTreeDescr *desc, UndoLocation undo_loc, Pointer key,
 							   BTreeKeyType kind, Pointer dest,
@@ -134,6 +142,6 @@ extern void add_undo_drop_relnode(ORelOids oids, ORelOids *treeOids,
 								  int numTreeOids);
 extern void add_undo_create_relnode(ORelOids oids, ORelOids *treeOids,
 									int numTreeOids);
-extern void check_pending_truncates(void);
+extern void check_pending_truncates(bool all);
 
 #endif							/* __BTREE_UNDO_H__ */
@@ -0,0 +1,57 @@
+/*-------------------------------------------------------------------------
+ *
+ * zone_map.h
+ *		Declarations for zone maps over orioledb B-tree leaves.
+ *
+ * Copyright (c) 2021-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/btree/zone_map.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __BTREE_ZONE_MAP_H__
+#define __BTREE_ZONE_MAP_H__
+
+#include "btree.h"
+
+#include "access/stratnum.h"
+#include "fmgr.h"
+
+/* Maximum number of conditions checked against the leaf summaries */
+#define ZONE_MAP_MAX_CONDS	(4)
+
+/* "column <strategy> value" condition */
+typedef struct
+{
+	StrategyNumber strategy;
+	Datum		value;
+} OZoneMapCond;
+
+/*
+ * Strict conditions over the single fixed-length by-value column of the
+ * primary key leaf tuples.  Leaves, where no tuple can match all the
+ * conditions, are skipped by the sequential scan.
+ */
+typedef struct
+{
+	AttrNumber	attnum;			/* attribute number in the leaf tuple */
+	Oid			collation;
+	FmgrInfo	cmpProc;		/* btree comparison support function */
+	int			nConds;
+	OZoneMapCond conds[ZONE_MAP_MAX_CONDS];
+} OZoneMapQual;
+
+extern int	zone_map_size;
+
+extern Size zone_map_shmem_needs(void);
+extern void zone_map_shmem_init(Pointer ptr, bool found);
+
+extern bool zone_map_leaf_is_excluded(BTreeDescr *desc, OZoneMapQual *qual,
+									  OInMemoryBlkno blkno,
+									  uint32 pageChangeCount,
+									  uint32 *state);
+extern void zone_map_summarize_leaf(BTreeDescr *desc, OZoneMapQual *qual,
+									OInMemoryBlkno blkno, Page img);
+
+#endif							/* __BTREE_ZONE_MAP_H__ */
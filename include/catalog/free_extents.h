@@ -15,6 +15,10 @@
 
 #include "catalog/sys_trees.h"
 
+extern int	free_extents_cache_size;
+
+extern Size free_extents_cache_shmem_needs(void);
+extern void free_extents_cache_shmem_init(Pointer ptr, bool found);
 extern FileExtent get_extent(BTreeDescr *desc, uint16 len);
 extern void free_extent(BTreeDescr *desc, FileExtent extent);
 
@@ -218,6 +218,9 @@ typedef struct OSysCacheFuncs
 
 typedef uint32 (*O_CCHashFN) (OSysCacheKey *key, int att_num);
 
+/* Number of the recently used entries remembered by each sys cache */
+#define O_SYS_CACHE_RECENT_SIZE 16
+
 typedef struct OSysCache
 {
 	int			sys_tree_num;
@@ -231,8 +234,13 @@ typedef struct OSysCache
 								 * cache */
 	HTAB	   *fast_cache;		/* contains OSysCacheHashEntry-s */
 	O_CCHashFN	cc_hashfunc[CATCACHE_MAXKEYS];
-	OSysCacheHashKey last_fast_cache_key;
-	Pointer		last_fast_cache_entry;
+	/*
+	 * Direct-mapped cache of the recently used fast cache entries indexed by
+	 * the hash value.  Lets the repeated lookups skip the fast cache hash
+	 * table and its entry lists.
+	 */
+	OSysCacheHashKey recent_keys[O_SYS_CACHE_RECENT_SIZE];
+	Pointer		recent_entries[O_SYS_CACHE_RECENT_SIZE];
 	OSysCacheFuncs *funcs;
 } OSysCache;
 
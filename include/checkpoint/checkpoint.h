@@ -18,6 +18,8 @@
 #include "btree/page_contents.h"
 
 #include "access/xlogdefs.h"
+#include "datatype/timestamp.h"
+#include "utils/hsearch.h"
 
 struct CheckpointFileHeader
 {
@@ -153,6 +155,16 @@ typedef struct
 	pid_t		pid;
 	double		dirtyPagesEstimate;
 	uint64		pagesWritten;
+
+	/*
+	 * Progress of the checkpoint in progress shared with the helpers, see
+	 * orioledb_get_checkpoint_progress().  progressStartTime is zero when no
+	 * checkpoint is in progress.
+	 */
+	TimestampTz progressStartTime;
+	pg_atomic_uint32 progressTreesDone;
+	pg_atomic_uint64 progressPagesWritten;
+	pg_atomic_uint64 progressBytesWritten;
 	/* helps to avoid skip a new table for the checkpoint in progress */
 	int			oTablesMetaTrancheId;
 	LWLock		oTablesMetaLock;
@@ -221,21 +233,29 @@ extern Size checkpoint_shmem_size(void);
 extern void checkpoint_shmem_init(Pointer ptr, bool found);
 extern uint32 o_get_latest_chkp_num(Oid datoid, Oid relnode,
 									uint32 max_chkp_num, bool *found);
+extern HTAB *o_load_latest_chkp_nums(void);
+extern uint32 o_lookup_latest_chkp_num(HTAB *chkpNums, Oid datoid,
+									   Oid relnode, uint32 max_chkp_num,
+									   bool *found);
 extern void o_update_latest_chkp_num(Oid datoid, Oid relnode, uint32 chkp_num);
 extern void o_delete_chkp_num(Oid datoid, Oid relnode);
 
 extern void o_perform_checkpoint(XLogRecPtr redo_pos, int flags);
+PGDLLEXPORT void checkpoint_helper_main(Datum main_arg);
 extern void o_after_checkpoint_cleanup_hook(XLogRecPtr checkPointRedo,
 											int flags);
 
 extern bool page_is_under_checkpoint(BTreeDescr *desc, OInMemoryBlkno blkno,
 									 bool includingHikeyBlkno);
 extern bool tree_is_under_checkpoint(BTreeDescr *desc);
+extern bool tree_checkpoint_unfinished(BTreeDescr *desc);
+extern void checkpoint_move_hikey_blkno(int level, OInMemoryBlkno blkno,
+										OInMemoryBlkno newBlkno);
 extern bool get_checkpoint_number(BTreeDescr *desc, OInMemoryBlkno blkno, uint32 *checkpoint_number, bool *copy_blkno);
 extern uint32 get_cur_checkpoint_number(ORelOids *oids, OIndexType type, bool *checkpoint_concurrent);
 extern bool can_use_checkpoint_extents(BTreeDescr *desc, uint32 chkp_num);
 extern void free_extent_for_checkpoint(BTreeDescr *desc, FileExtent *extent, uint32 chkp_num);
-extern void backend_set_autonomous_level(CheckpointState *state, uint32 level);
+extern void backend_set_autonomous_level(BTreeDescr *desc, uint32 level);
 extern bool tbl_data_exists(ORelOids *oids);
 extern void evictable_tree_init(BTreeDescr *desc, bool init_shmem,
 								bool *was_evicted);
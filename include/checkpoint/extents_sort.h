@@ -0,0 +1,21 @@
+/*-------------------------------------------------------------------------
+ *
+ * extents_sort.h
+ *		Declarations for sorting the free extents files.
+ *
+ * Copyright (c) 2025-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/checkpoint/extents_sort.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __CHECKPOINT_EXTENTS_SORT_H__
+#define __CHECKPOINT_EXTENTS_SORT_H__
+
+#include "storage/fd.h"
+
+extern void sort_extents_file(File file, off_t start, uint64 size,
+							  bool extents);
+
+#endif							/* __CHECKPOINT_EXTENTS_SORT_H__ */
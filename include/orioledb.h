@@ -49,6 +49,7 @@
 #define ORIOLEDB_UNDO_DIR "orioledb_undo"
 #define ORIOLEDB_RMGR_ID (129)
 #define ORIOLEDB_XLOG_CONTAINER (0x00)
+#define ORIOLEDB_XLOG_CONTAINER_COMPRESSED (0x10)
 
 /*
  * perform_page_split() removes a key data from first right page downlink.
@@ -261,6 +262,13 @@ typedef struct
 	FileExtent	fileExtent;
 	uint32		flags:4,
 				type:28;
+	/* approximate leaf access counters, see page_count_write() */
+	uint16		nReads;
+	uint16		nWrites;
+	/* parent of the B-tree page, see btree_page_adopt_children() */
+	OInMemoryBlkno parentBlkno;
+	/* the subtree might be modified since the checkpointer passed it */
+	pg_atomic_uint32 subtreeDirty;
 	proclist_head waitersList;
 } OrioleDBPageDesc;
 
@@ -287,6 +295,21 @@ typedef struct
 		O_PAGE_HEADER(page)->pageChangeCount++;
 #define O_PAGE_GET_CHANGE_COUNT(p) (O_PAGE_HEADER(p)->pageChangeCount)
 
+/* Values of orioledb.buffers_huge_pages */
+typedef enum
+{
+	BUFFERS_HUGE_PAGES_OFF,
+	BUFFERS_HUGE_PAGES_ON,
+	BUFFERS_HUGE_PAGES_TRY
+} BuffersHugePagesType;
+
+/* Values of orioledb.s3_checksum_algorithm */
+typedef enum
+{
+	S3_CHECKSUM_SHA256,
+	S3_CHECKSUM_CRC32C
+} S3ChecksumAlgorithm;
+
 /* orioledb.c */
 extern Size orioledb_buffers_size;
 extern Size orioledb_buffers_count;
@@ -301,26 +324,49 @@ extern ODBProcData *oProcData;
 extern int	max_procs;
 extern OrioleDBPageDesc *page_descs;
 extern bool remove_old_checkpoint_files;
+extern bool orioledb_async_file_cleanup;
 extern bool skip_unmodified_trees;
+extern bool skip_unmodified_subtrees;
 extern bool debug_disable_bgwriter;
 extern MemoryContext btree_insert_context;
 extern MemoryContext btree_seqscan_context;
 extern double o_checkpoint_completion_ratio;
+extern int	checkpoint_workers;
+extern double checkpoint_read_latency_target;
 extern int	max_io_concurrency;
+extern int	background_io_concurrency;
+extern int	main_buffers_limit_guc;
 extern bool use_mmap;
+extern bool numa_interleave;
+extern bool orioledb_direct_io;
+extern int	buffers_huge_pages;
+extern int	buffers_huge_page_size;
+extern bool buffers_prefault;
 extern bool use_device;
 extern bool orioledb_use_sparse_files;
+extern int	data_file_prealloc_size;
+extern int	ctid_cache_size;
 extern int	device_fd;
 extern char *device_filename;
+extern char *data_stripe_directories;
 extern Pointer mmap_data;
 extern Size device_length;
 extern int	default_compress;
 extern int	default_primary_compress;
 extern int	default_toast_compress;
+extern int	hot_pages_compress;
+extern int	compress_min_saving;
 extern bool orioledb_table_description_compress;
 extern bool orioledb_s3_mode;
 extern int	s3_num_workers;
 extern int	s3_desired_size;
+extern int	s3_multipart_part_size;
+extern int	s3_multipart_concurrency;
+extern int	s3_prefetch_parts;
+extern int	s3_wal_compression;
+extern int	s3_checksum_algorithm;
+extern bool s3_second_touch_admission;
+extern bool s3_incremental_backup;
 extern int	s3_queue_size_guc;
 extern char *s3_host;
 extern bool s3_use_https;
@@ -345,10 +391,27 @@ extern char *s3_cainfo;
 extern void o_check_init_db_dir(Oid dbOid);
 extern void orioledb_check_shmem(void);
 
+/*
+ * Compression setting of a tree.  Values from 0 to o_compress_max_lvl() are
+ * zstd levels.  The range starting from O_COMPRESS_LZ4 selects LZ4 and LZ4HC
+ * of the given level.
+ */
 typedef int OCompress;
 #define O_COMPRESS_DEFAULT (10)
 #define InvalidOCompress (-1)
 #define OCompressIsValid(compress) ((compress) != InvalidOCompress)
+#define O_COMPRESS_LZ4 (0x1000)
+#define O_COMPRESS_LZ4HC(level) (O_COMPRESS_LZ4 + (level))
+#define O_COMPRESS_LZ4HC_DEFAULT_LEVEL (9)
+#define O_COMPRESS_LZ4HC_MAX_LEVEL (12)
+#define OCompressIsLZ4(compress) ((compress) >= O_COMPRESS_LZ4 && \
+								  (compress) <= O_COMPRESS_LZ4HC(O_COMPRESS_LZ4HC_MAX_LEVEL))
+
+/* Compression algorithms recorded in OCompressHeader */
+#define O_COMPRESS_ALGORITHM_ZSTD (0)
+#define O_COMPRESS_ALGORITHM_LZ4 (1)
+#define OCompressGetAlgorithm(compress) \
+	(OCompressIsLZ4(compress) ? O_COMPRESS_ALGORITHM_LZ4 : O_COMPRESS_ALGORITHM_ZSTD)
 
 /*
  * We save number of chunks inside downlinks instead of size of compressed data
@@ -361,7 +424,8 @@ typedef struct OCompressHeader
 {
 	uint32		chkpNum;
 	uint16		page_size;
-	uint16		reserved;		/* for possible future use */
+	uint16		algorithm:4,	/* O_COMPRESS_ALGORITHM_* */
+				dictId:12;		/* compression dictionary id, 0 if none */
 } OCompressHeader;
 typedef struct ORelOptions
 {
@@ -425,5 +489,6 @@ extern void o_rewrite_cleanup(void);
 
 /* scan.c */
 extern CustomScanMethods o_scan_methods;
+extern CustomScanMethods o_count_scan_methods;
 
 #endif							/* __ORIOLEDB_H__ */
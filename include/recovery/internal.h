@@ -45,6 +45,7 @@ extern uint64 recovery_queue_data_size;
 #define RECOVERY_INSERT ((uint16) 1 << 0)
 #define RECOVERY_DELETE ((uint16) 1 << 1)
 #define RECOVERY_UPDATE ((uint16) 1 << 2)
+#define RECOVERY_UPDATE_DELTA ((uint16) 1 << 3)
 #define RECOVERY_COMMIT ((uint16) 1 << 4)
 #define RECOVERY_ROLLBACK ((uint16) 1 << 5)
 #define RECOVERY_FINISHED ((uint16) 1 << 6)
@@ -57,7 +58,8 @@ extern uint64 recovery_queue_data_size;
 #define RECOVERY_WORKER_PARALLEL_INDEX_BUILD ((uint16) 1 << 13)
 #define RECOVERY_LEADER_PARALLEL_INDEX_BUILD ((uint16) 1 << 14)
 #define RECOVERY_INIT ((uint16) 1 << 15)
-#define RECOVERY_MODIFY (RECOVERY_INSERT | RECOVERY_DELETE | RECOVERY_UPDATE)
+#define RECOVERY_MODIFY (RECOVERY_INSERT | RECOVERY_DELETE | RECOVERY_UPDATE | \
+						 RECOVERY_UPDATE_DELTA)
 #define RECOVERY_QUEUE_BUF_SIZE (8 * 1024)
 
 
@@ -116,6 +118,9 @@ typedef struct
 	pg_atomic_uint64 commitPtr;
 	pg_atomic_uint64 retainPtr;
 	uint32		flushedUndoLocCompletedCheckpointNumber;
+	/* Statistics of the messages applied by the worker */
+	pg_atomic_uint64 appliedRecords;
+	pg_atomic_uint64 appliedBytes;
 } RecoveryWorkerPtrs;
 
 typedef struct
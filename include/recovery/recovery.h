@@ -43,6 +43,9 @@ is_recovery_in_progress(void)
 extern XLogRecPtr recovery_get_current_ptr(void);
 extern int	recovery_queue_size_guc;
 extern int	recovery_pool_size_guc;
+extern bool recovery_rebalance_guc;
+extern bool recovery_prefetch_guc;
+extern bool recovery_skip_dropped_guc;
 extern int	recovery_idx_pool_size_guc;
 extern int	recovery_parallel_indices_rebuild_limit_guc;
 extern OXid recovery_oxid;
@@ -51,11 +54,16 @@ typedef struct BTreeDescr BTreeDescr;
 
 extern OTuple recovery_rec_insert(BTreeDescr *desc, OTuple tuple, bool *allocated, int *size);
 extern OTuple recovery_rec_update(BTreeDescr *desc, OTuple tuple, bool *allocated, int *size);
+extern int	recovery_rec_update_delta_length(OTuple rec);
+extern OTuple recovery_rec_update_from_delta(BTreeDescr *desc, OTuple rec);
 extern OTuple recovery_rec_delete(BTreeDescr *desc, OTuple tuple, bool *allocated, int *size);
 extern OTuple recovery_rec_delete_key(BTreeDescr *desc, OTuple key, bool *allocated, int *size);
 
 extern void recovery_cleanup_old_files(uint32 max_chkp_num,
 									   bool before_recovery);
 
+extern void recovery_prescan_dropped_trees(void);
+extern bool recovery_tree_is_dropped(ORelOids oids);
+
 
 #endif							/* __RECOVERY_H__ */
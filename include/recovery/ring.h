@@ -0,0 +1,67 @@
+/*-------------------------------------------------------------------------
+ *
+ * ring.h
+ *		Declarations for the recovery message ring.
+ *
+ * Copyright (c) 2021-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/recovery/ring.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __RECOVERY_RING_H__
+#define __RECOVERY_RING_H__
+
+#include "port/atomics.h"
+#include "postmaster/bgworker.h"
+
+/*
+ * Single-producer single-consumer ring of message batches in shared memory.
+ * The sender only advances 'head' and the receiver only advances 'tail', so
+ * they are kept on separate cache lines.
+ */
+typedef struct
+{
+	pg_atomic_uint64 head;
+	char		headPad[PG_CACHE_LINE_SIZE - sizeof(pg_atomic_uint64)];
+	pg_atomic_uint64 tail;
+	char		tailPad[PG_CACHE_LINE_SIZE - sizeof(pg_atomic_uint64)];
+	pg_atomic_uint32 receiverAttached;
+	pg_atomic_uint32 detached;
+	Size		size;
+	char		data[FLEXIBLE_ARRAY_MEMBER];
+} RecoveryRing;
+
+/* Receiver-local state */
+typedef struct
+{
+	RecoveryRing *ring;
+	/* position of the next batch to read */
+	uint64		pos;
+	/* end of the batches published by the sender at the last check */
+	uint64		end;
+} RecoveryRingReader;
+
+typedef enum
+{
+	RecoveryRingSuccess,
+	RecoveryRingEmpty,
+	RecoveryRingDetached
+} RecoveryRingResult;
+
+#define RECOVERY_RING_OVERHEAD (offsetof(RecoveryRing, data))
+
+extern void recovery_ring_create(Pointer ptr, Size size);
+extern bool recovery_ring_wait_for_attach(RecoveryRing *ring,
+										  BackgroundWorkerHandle *handle);
+extern RecoveryRingResult recovery_ring_send(RecoveryRing *ring, Pointer data,
+											 Size len,
+											 BackgroundWorkerHandle *handle);
+extern void recovery_ring_attach(RecoveryRing *ring,
+								 RecoveryRingReader *reader);
+extern RecoveryRingResult recovery_ring_receive(RecoveryRingReader *reader,
+												Size *len, Pointer *data);
+extern void recovery_ring_detach(RecoveryRing *ring);
+
+#endif							/* __RECOVERY_RING_H__ */
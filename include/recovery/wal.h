@@ -30,6 +30,7 @@
 #define WAL_REC_ROLLBACK_TO_SAVEPOINT (11)
 #define WAL_REC_JOINT_COMMIT (12)
 #define WAL_REC_TRUNCATE	(13)
+#define WAL_REC_UPDATE_DELTA (14)
 
 /* Constants for commitInProgressXlogLocation */
 #define OWalTmpCommitPos			(0)
@@ -72,6 +73,29 @@ typedef struct
 	uint8		length[sizeof(OffsetNumber)];
 } WALRecModify;
 
+/*
+ * Header of the WAL_REC_UPDATE_DELTA record payload, which follows
+ * WALRecModify.  The header is followed by the primary key, placed at
+ * MAXALIGN(sizeof(WALRecUpdateDelta)) offset, and the changed bytes.  The
+ * new tuple of 'newLength' bytes consists of first 'prefixLength' bytes of
+ * the old tuple, the changed bytes and the last 'suffixLength' bytes of the
+ * old tuple.  The old
+ * tuple length and checksum allow to verify that the delta is applied to the
+ * same tuple version it was made against.
+ */
+typedef struct
+{
+	uint8		keyLength[sizeof(OffsetNumber)];
+	uint8		keyFormatFlags;
+	uint8		oldLength[sizeof(OffsetNumber)];
+	uint8		oldChecksum[sizeof(uint32)];
+	uint8		newLength[sizeof(OffsetNumber)];
+	uint8		prefixLength[sizeof(OffsetNumber)];
+	uint8		suffixLength[sizeof(OffsetNumber)];
+} WALRecUpdateDelta;
+
+#define WALRecUpdateDeltaHeaderSize MAXALIGN(sizeof(WALRecUpdateDelta))
+
 typedef struct
 {
 	uint8		recType;
@@ -110,6 +134,22 @@ typedef struct
 } WALRecTruncate;
 
 #define LOCAL_WAL_BUFFER_SIZE	(8192)
+
+/*
+ * Header of ORIOLEDB_XLOG_CONTAINER_COMPRESSED record, followed by the
+ * compressed container.
+ */
+typedef struct
+{
+	uint8		rawLength[sizeof(uint16)];
+} WALContainerCompressed;
+
+extern bool wal_update_delta;
+extern int	wal_commit_delay;
+extern int	wal_commit_group_size;
+extern int	wal_compress;
+extern int	wal_compress_threshold;
+
 #define ORIOLEDB_WAL_PREFIX	"o_wal"
 #define ORIOLEDB_WAL_PREFIX_SIZE (5)
 
@@ -127,9 +167,15 @@ extern XLogRecPtr wal_joint_commit(OXid oxid, TransactionId logicalXid,
 								   TransactionId xid);
 extern void wal_after_commit(void);
 extern void wal_rollback(OXid oxid, TransactionId logicalXid);
+extern Size wal_group_commit_shmem_needs(void);
+extern void wal_group_commit_shmem_init(Pointer ptr, bool found);
+extern void wal_commit_flush(XLogRecPtr pos);
 extern XLogRecPtr log_logical_wal_container(Pointer ptr, int length);
+extern Pointer wal_container_decompress(uint8 info, Pointer data, int *length);
 extern void o_wal_insert(BTreeDescr *desc, OTuple tuple);
 extern void o_wal_update(BTreeDescr *desc, OTuple tuple);
+extern void o_wal_update_delta(BTreeDescr *desc, OTuple oldTuple,
+							   OTuple newTuple);
 extern void o_wal_delete(BTreeDescr *desc, OTuple tuple);
 extern void o_wal_delete_key(BTreeDescr *desc, OTuple key);
 extern void add_truncate_wal_record(ORelOids oids);
@@ -36,6 +36,7 @@ typedef enum
 	 (t1).segNum == (t2).segNum)
 
 extern int	s3_headers_buffers_size;
+extern uint64 s3_header_my_misses;
 
 extern Size s3_headers_shmem_needs(void);
 extern void s3_headers_shmem_init(Pointer buf, bool found);
@@ -43,8 +44,10 @@ extern void s3_headers_increase_loaded_parts(uint64 inc);
 extern uint32 s3_header_get_load_id(S3HeaderTag tag);
 extern bool s3_header_lock_part(S3HeaderTag tag, int index,
 								uint32 *loadId);
-extern S3PartStatus s3_header_mark_part_loading(S3HeaderTag tag, int index);
-extern void s3_header_mark_part_loaded(S3HeaderTag tag, int index);
+extern S3PartStatus s3_header_mark_part_loading(S3HeaderTag tag, int index,
+												 bool prefetch);
+extern void s3_header_mark_part_loaded(S3HeaderTag tag, int index,
+									   bool fromS3);
 extern void s3_header_unlock_part(S3HeaderTag tag, int index, bool setDirty);
 extern bool s3_header_mark_part_scheduled_for_write(S3HeaderTag tag, int index);
 extern void s3_header_mark_part_writing(S3HeaderTag tag, int index);
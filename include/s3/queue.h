@@ -27,5 +27,7 @@ extern S3TaskLocation s3_queue_try_pick_task(void);
 Pointer		s3_queue_get_task(S3TaskLocation taskLocation);
 extern void s3_queue_erase_task(S3TaskLocation taskLocation);
 extern void s3_queue_wait_for_location(S3TaskLocation location);
+extern void s3_queue_wait_for_task(S3TaskLocation location);
+extern void s3_queue_wait_for_tasks(long timeout);
 
 #endif							/* __S3_QUEUE_H__ */
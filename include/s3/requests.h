@@ -18,7 +18,12 @@
 #define S3_RESPONSE_CONDITION_CONFLICT	409
 #define S3_RESPONSE_CONDITION_FAILED	412
 
+/* Suffix of the WAL file objects compressed with zstd */
+#define S3_WAL_COMPRESSED_SUFFIX		".zst"
+
 extern long s3_put_file(char *objectname, char *filename, bool ifNoneMatch);
+extern long s3_put_file_compressed(char *objectname, char *filename,
+								   int level);
 extern void s3_get_file(char *objectname, char *filename);
 extern void s3_put_empty_dir(char *objectname);
 extern long s3_put_file_part(char *objectname, char *filename, int partnum);
@@ -31,4 +36,7 @@ extern void s3_delete_object(char *objectname);
 
 extern Pointer read_file(const char *filename, uint64 *size);
 
+extern Size s3_requests_shmem_needs(void);
+extern void s3_requests_shmem_init(Pointer ptr, bool found);
+
 #endif							/* __S3_REQUESTS_H__ */
@@ -74,8 +74,20 @@ typedef struct
 	}			typeSpecific;
 } S3Task;
 
+/* The number of uncompressed pages in the data file part */
+#define S3_PART_PAGES	(ORIOLEDB_S3_PART_SIZE / ORIOLEDB_BLCKSZ)
+
 #define FILE_CHECKSUMS_FILENAME		ORIOLEDB_DATA_DIR "/file_checksums"
 
+/*
+ * With orioledb.s3_incremental_backup the PostgreSQL files larger than the
+ * chunk are uploaded by chunks.  The chunk N of the file is checksummed and
+ * stored as "<file>.orioledb_chunk.N", so only the changed chunks are
+ * uploaded.  orioledb_s3_loader.py assembles the files back.
+ */
+#define S3_PG_FILE_CHUNK_SIZE		(4 * 1024 * 1024)
+#define S3_PG_FILE_CHUNK_SUFFIX		".orioledb_chunk."
+
 extern Size s3_workers_shmem_needs(void);
 extern void s3_workers_init_shmem(Pointer ptr, bool found);
 extern void register_s3worker(int num);
@@ -92,12 +104,13 @@ extern S3TaskLocation s3_schedule_file_part_write(uint32 chkpNum, Oid datoid,
 												  int32 partNum);
 extern S3TaskLocation s3_schedule_file_part_read(uint32 chkpNum, Oid datoid,
 												 Oid relnode, int32 segNum,
-												 int32 partNum);
+												 int32 partNum, bool prefetch);
 extern S3TaskLocation s3_schedule_wal_file_write(char *filename);
 extern S3TaskLocation s3_schedule_undo_file_write(UndoLogType undoType,
 												  uint64 fileNum);
 extern S3TaskLocation s3_schedule_downlink_load(struct BTreeDescr *desc,
-												uint64 downlink);
+												uint64 downlink, bool prefetch);
+extern void s3_prefetch_downlink(struct BTreeDescr *desc, uint64 downlink);
 extern S3TaskLocation s3_schedule_root_file_write(char *filename, bool delete);
 extern S3TaskLocation s3_schedule_pg_file_write(uint32 chkpNum, char *filename);
 extern void s3_load_file_part(uint32 chkpNum, Oid datoid, Oid relnode,
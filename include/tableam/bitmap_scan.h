@@ -17,9 +17,37 @@
 #include "tableam/handler.h"
 #include "tableam/scan.h"
 
-#include "lib/rbtree.h"
+#include "port/atomics.h"
+#include "storage/condition_variable.h"
+#include "storage/spin.h"
+#include "utils/dsa.h"
 
 typedef struct OBitmapScan OBitmapScan;
+typedef struct OKeyBitmap OKeyBitmap;
+
+typedef enum OParallelBitmapStatus
+{
+	OParallelBitmapInitial,
+	OParallelBitmapInProgress,
+	OParallelBitmapFinished
+} OParallelBitmapStatus;
+
+/*
+ * Shared state of parallel bitmap scan.  The first participant builds the key
+ * bitmap and publishes its chunks in the query DSA area.  Then participants
+ * claim disjoint groups of chunks and scan the primary key ranges they cover.
+ */
+typedef struct ParallelOBitmapScanData
+{
+	slock_t		mutex;
+	ConditionVariable cv;
+	OParallelBitmapStatus status;
+	dsa_pointer chunks;
+	uint64		nchunks;
+	pg_atomic_uint64 nextChunk;
+} ParallelOBitmapScanData;
+
+typedef ParallelOBitmapScanData *ParallelOBitmapScan;
 
 typedef struct OBitmapHeapPlanState
 {
@@ -28,11 +56,13 @@ typedef struct OBitmapHeapPlanState
 	PlanState  *bitmapqualplanstate;
 	/* index quals, in standard expr form */
 	List	   *bitmapqualorig;
+	ExprState  *bitmapqualorigstate;
 	Oid			typeoid;
 	OSnapshot	oSnapshot;
 	MemoryContext cxt;
 	OBitmapScan *scan;
 	OEACallsCounters *eaCounters;
+	ParallelOBitmapScan pscan;
 } OBitmapHeapPlanState;
 
 extern OBitmapScan *o_make_bitmap_scan(OBitmapHeapPlanState *bitmap_state,
@@ -43,15 +73,26 @@ extern OBitmapScan *o_make_bitmap_scan(OBitmapHeapPlanState *bitmap_state,
 extern TupleTableSlot *o_exec_bitmap_fetch(OBitmapScan *scan,
 										   CustomScanState *node);
 extern void o_free_bitmap_scan(OBitmapScan *scan);
+extern void o_init_parallel_bitmap_scan(ParallelOBitmapScan pscan);
+extern void o_reinit_parallel_bitmap_scan(ParallelOBitmapScan pscan,
+										  dsa_area *dsa);
 
-extern RBTree *o_keybitmap_create(void);
-extern void o_keybitmap_insert(RBTree *rbtree, uint64 value);
-extern void o_keybitmap_intersect(RBTree *a, RBTree *b);
-extern void o_keybitmap_union(RBTree *a, RBTree *b);
-extern void o_keybitmap_free(RBTree *tree);
-extern bool o_keybitmap_is_empty(RBTree *rbtree);
-extern bool o_keybitmap_test(RBTree *rbtree, uint64 value);
-extern bool o_keybitmap_range_is_valid(RBTree *rbtree, uint64 low, uint64 high);
-extern uint64 o_keybitmap_get_next(RBTree *rbtree, uint64 prev, bool *found);
+extern OKeyBitmap *o_keybitmap_create(Size maxMem);
+extern void o_keybitmap_insert(OKeyBitmap *bitmap, uint64 value);
+extern void o_keybitmap_intersect(OKeyBitmap *a, OKeyBitmap *b);
+extern void o_keybitmap_union(OKeyBitmap *a, OKeyBitmap *b);
+extern void o_keybitmap_free(OKeyBitmap *bitmap);
+extern bool o_keybitmap_is_empty(OKeyBitmap *bitmap);
+extern bool o_keybitmap_test(OKeyBitmap *bitmap, uint64 value, bool *recheck);
+extern bool o_keybitmap_range_is_valid(OKeyBitmap *bitmap, uint64 low,
+									   uint64 high);
+extern uint64 o_keybitmap_get_next(OKeyBitmap *bitmap, uint64 prev,
+								   bool *found);
+extern uint64 o_keybitmap_get_last(OKeyBitmap *bitmap, bool *found);
+extern uint64 o_keybitmap_count_chunks(OKeyBitmap *bitmap);
+extern Size o_keybitmap_serialized_size(OKeyBitmap *bitmap);
+extern void o_keybitmap_serialize(OKeyBitmap *bitmap, Pointer dst);
+extern OKeyBitmap *o_keybitmap_deserialize(Pointer src, uint64 first,
+										   uint64 count);
 
 #endif							/* __TABLEAM_BITMAP_SCAN_H__ */
@@ -27,6 +27,7 @@
 #include "commands/explain.h"
 #include "executor/tuptable.h"
 #include "nodes/pathnodes.h"
+#include "utils/uuid.h"
 
 /* tableam/descr.c */
 
@@ -55,6 +56,30 @@ typedef struct
 typedef struct OComparator OComparator;
 typedef struct OComparatorKey OComparatorKey;
 
+/* Built-in B-tree operator families (see pg_opfamily.dat) */
+#define O_BYTEA_BTREE_FAM_OID		428
+#define O_DATETIME_BTREE_FAM_OID	434
+#define O_INTEGER_BTREE_FAM_OID		1976
+#define O_OID_BTREE_FAM_OID			1989
+#define O_TEXT_BTREE_FAM_OID		1994
+#define O_TID_BTREE_FAM_OID			2789
+#define O_UUID_BTREE_FAM_OID		2968
+
+/*
+ * Kind of the built-in comparison used for the index field values instead of
+ * calling the OComparator.  See o_call_field_comparator().
+ */
+typedef enum
+{
+	OFieldCmpGeneric = 0,
+	OFieldCmpInt2,
+	OFieldCmpInt4,
+	OFieldCmpInt8,
+	OFieldCmpOid,
+	OFieldCmpUuid,
+	OFieldCmpCText
+} OFieldCmpType;
+
 /*
  * The index field descriptor
  */
@@ -78,8 +103,30 @@ typedef struct
 	 * and opclass.
 	 */
 	OComparator *comparator;
+
+	/* Built-in comparison matching the comparator, if any */
+	OFieldCmpType cmpType;
 } OIndexField;
 
+/*
+ * Kind of normalized image of the index field value.  Images allow B-tree
+ * page search to skip most of the comparator calls.  See OKeyImage.
+ */
+typedef enum
+{
+	OKeyImageNone = 0,
+	OKeyImageInt,
+	OKeyImageOid,
+	OKeyImageTid,
+	OKeyImageDate,
+	OKeyImageTimestamp,
+	OKeyImageUuid,
+	OKeyImageText,
+	OKeyImageBytea
+} OKeyImageType;
+
+#define OKeyImageIsExact(type) ((type) < OKeyImageUuid)
+
 typedef struct AttrNumberMap
 {
 	AttrNumber	key;
@@ -142,6 +189,10 @@ struct OIndexDescr
 	int			nIncludedFields;
 	OIndexField fields[INDEX_MAX_KEYS];
 
+	/* Kinds of images of the leading fields, see o_idx_key_image() */
+	int			nKeyImageFields;
+	OKeyImageType keyImageTypes[O_KEY_IMAGE_MAX_VALUES];
+
 	/*
 	 * Attnums for primary key values in the secondary index tuples. We may
 	 * assume that secondary index tuple just contain primary key values in
@@ -271,6 +322,66 @@ extern int	o_call_comparator(OComparator *comparator, Datum left,
 extern void o_invalidate_comparator_cache(Oid opfamily, Oid lefttype,
 										  Oid righttype);
 
+/*
+ * Compares two non-null values of the index field.  Values of common
+ * built-in types are compared inline, others go through the comparator.
+ */
+static inline int
+o_call_field_comparator(OIndexField *field, Datum left, Datum right)
+{
+	switch (field->cmpType)
+	{
+		case OFieldCmpInt2:
+			return (int) DatumGetInt16(left) - (int) DatumGetInt16(right);
+		case OFieldCmpInt4:
+			{
+				int32		l = DatumGetInt32(left),
+							r = DatumGetInt32(right);
+
+				return (l > r) - (l < r);
+			}
+		case OFieldCmpInt8:
+			{
+				int64		l = DatumGetInt64(left),
+							r = DatumGetInt64(right);
+
+				return (l > r) - (l < r);
+			}
+		case OFieldCmpOid:
+			{
+				Oid			l = DatumGetObjectId(left),
+							r = DatumGetObjectId(right);
+
+				return (l > r) - (l < r);
+			}
+		case OFieldCmpUuid:
+			return memcmp(DatumGetPointer(left), DatumGetPointer(right),
+						  UUID_LEN);
+		case OFieldCmpCText:
+			{
+				Pointer		l = DatumGetPointer(left),
+							r = DatumGetPointer(right);
+				int			llen,
+							rlen,
+							cmp;
+
+				if (VARATT_IS_EXTERNAL(l) || VARATT_IS_COMPRESSED(l) ||
+					VARATT_IS_EXTERNAL(r) || VARATT_IS_COMPRESSED(r))
+					break;
+
+				llen = VARSIZE_ANY_EXHDR(l);
+				rlen = VARSIZE_ANY_EXHDR(r);
+				cmp = memcmp(VARDATA_ANY(l), VARDATA_ANY(r), Min(llen, rlen));
+				if (cmp != 0)
+					return cmp;
+				return (llen > rlen) - (llen < rlen);
+			}
+		default:
+			break;
+	}
+	return o_call_comparator(field->comparator, left, right);
+}
+
 extern EvictedTreeData *read_evicted_data(Oid datoid, Oid relnode, bool delete);
 extern void insert_evicted_data(EvictedTreeData *data);
 
@@ -20,6 +20,7 @@
 #include "nodes/execnodes.h"
 #include "nodes/pathnodes.h"
 #include "rewrite/rewriteHandler.h"
+#include "storage/condition_variable.h"
 
 extern bool is_orioledb_rel(Relation rel);
 extern OIndexNumber find_tree_in_descr(OTableDescr *descr, ORelOids oids);
@@ -32,9 +33,17 @@ typedef struct
 	uint32		load;			/* load_page() */
 	uint32		lock;			/* lock_page() */
 	uint32		evict;			/* evict_page() */
+	uint32		retry;			/* retries of inconsistent page reads */
+	/* Counters below are shown by EXPLAIN (ANALYZE, VERBOSE) only */
+	uint32		descent;		/* root-to-leaf descents by find_page() */
+	uint32		wait;			/* lock_page() sleeps */
+	uint32		s3load;			/* load_page() waiting for S3 */
+	uint32		undo;			/* undo records visited to find a version */
+	uint64		decompressed;	/* compressed bytes decompressed */
 } OEACallsCounter;
 
-#define EA_COUNTERS_NUM (5)		/* number of EXPLAIN ANALYZE counters */
+#define EA_COUNTERS_NUM (11)	/* number of EXPLAIN ANALYZE counters */
+#define EA_BASIC_COUNTERS_NUM (6)	/* counters shown without VERBOSE */
 
 /*
  * EXPLAIN ANALYZE counters for different trees involved in single executor
@@ -61,11 +70,11 @@ typedef struct
  */
 extern OEACallsCounters *ea_counters;
 
-/* returns AnalyzeCallsCounter for specified index number */
+/* returns AnalyzeCallsCounter for specified tree */
 static inline OEACallsCounter *
-get_ea_counters(OrioleDBPageDesc *desc)
+get_ea_counters_by_oids(ORelOids oids)
 {
-	OIndexNumber ix_num = find_tree_in_descr(ea_counters->descr, desc->oids);
+	OIndexNumber ix_num = find_tree_in_descr(ea_counters->descr, oids);
 
 	if (ix_num == InvalidIndexNumber)
 		return &ea_counters->others;
@@ -74,6 +83,13 @@ get_ea_counters(OrioleDBPageDesc *desc)
 	return &ea_counters->indices[ix_num];
 }
 
+/* returns AnalyzeCallsCounter for specified page */
+static inline OEACallsCounter *
+get_ea_counters(OrioleDBPageDesc *desc)
+{
+	return get_ea_counters_by_oids(desc->oids);
+}
+
 /* increases EXPLAIN_ANALYZE counter for o_btree_read_page() call */
 #define EA_READ_INC(blkno)  \
 	if (ea_counters != NULL)	\
@@ -124,6 +140,64 @@ get_ea_counters(OrioleDBPageDesc *desc)
 			ix_counter->evict++; \
 	}
 
+/* increases EXPLAIN_ANALYZE counter for page copy retry */
+#define EA_RETRY_INC(blkno)  \
+	if (ea_counters != NULL)	\
+	{	\
+		OrioleDBPageDesc *desc = O_GET_IN_MEMORY_PAGEDESC(blkno);	\
+		OEACallsCounter *ix_counter = get_ea_counters(desc); \
+		if (ix_counter != NULL) \
+			ix_counter->retry++; \
+	}
+
+/* increases EXPLAIN_ANALYZE counter for lock_page() sleep */
+#define EA_WAIT_INC(blkno)  \
+	if (ea_counters != NULL)	\
+	{	\
+		OrioleDBPageDesc *desc = O_GET_IN_MEMORY_PAGEDESC(blkno);	\
+		OEACallsCounter *ix_counter = get_ea_counters(desc); \
+		if (ix_counter != NULL) \
+			ix_counter->wait++; \
+	}
+
+/* increases EXPLAIN_ANALYZE counter for load_page() waiting for S3 */
+#define EA_S3LOAD_INC(blkno)  \
+	if (ea_counters != NULL)	\
+	{	\
+		OrioleDBPageDesc *desc = O_GET_IN_MEMORY_PAGEDESC(blkno);	\
+		OEACallsCounter *ix_counter = get_ea_counters(desc); \
+		if (ix_counter != NULL) \
+			ix_counter->s3load++; \
+	}
+
+/* adds compressed image size to EXPLAIN_ANALYZE counter */
+#define EA_DECOMPRESSED_ADD(blkno, bytes)  \
+	if (ea_counters != NULL)	\
+	{	\
+		OrioleDBPageDesc *desc = O_GET_IN_MEMORY_PAGEDESC(blkno);	\
+		OEACallsCounter *ix_counter = get_ea_counters(desc); \
+		if (ix_counter != NULL) \
+			ix_counter->decompressed += (bytes); \
+	}
+
+/* increases EXPLAIN_ANALYZE counter for find_page() descent */
+#define EA_DESCENT_INC(tree)  \
+	if (ea_counters != NULL)	\
+	{	\
+		OEACallsCounter *ix_counter = get_ea_counters_by_oids((tree)->oids); \
+		if (ix_counter != NULL) \
+			ix_counter->descent++; \
+	}
+
+/* increases EXPLAIN_ANALYZE counter for visited undo record */
+#define EA_UNDO_INC(tree)  \
+	if (ea_counters != NULL)	\
+	{	\
+		OEACallsCounter *ix_counter = get_ea_counters_by_oids((tree)->oids); \
+		if (ix_counter != NULL) \
+			ix_counter->undo++; \
+	}
+
 extern void cleanup_btree(Oid datoid, Oid relnode, bool files);
 extern bool o_drop_shared_root_info(Oid datoid, Oid relnode);
 extern void o_tableam_descr_init(void);
@@ -217,6 +291,34 @@ typedef struct ParallelOScanDescData
 
 typedef ParallelOScanDescData *ParallelOScanDesc;
 
+typedef enum
+{
+	OParallelIndexScanNotStarted,
+	OParallelIndexScanAdvancing,	/* some worker is taking the next chunk */
+	OParallelIndexScanIdle,		/* the next chunk starts at nextKey */
+	OParallelIndexScanExclusive,	/* scan can't be split, one worker does it
+									 * all */
+	OParallelIndexScanDone
+} OParallelIndexScanStatus;
+
+/*
+ * OrioleDB-specific shared state for parallel index scan.
+ *
+ * The key range of the scan is split into chunks along the leaf page
+ * boundaries.  Workers take chunks one by one: the worker taking the chunk
+ * finds the leaf page containing `nextKey`, publishes its hikey as the start
+ * of the following chunk, and then scans its chunk concurrently with others.
+ */
+typedef struct ParallelOIndexScanDescData
+{
+	slock_t		mutex;
+	ConditionVariable cv;
+	OParallelIndexScanStatus status;
+	OFixedShmemKey nextKey;
+} ParallelOIndexScanDescData;
+
+typedef ParallelOIndexScanDescData *ParallelOIndexScanDesc;
+
 extern bool in_nontransactional_truncate;
 
 #endif
@@ -18,6 +18,28 @@
 
 #include "access/sdir.h"
 
+/* Maximum number of tuples fetched from the index iterator at once */
+#define O_SCAN_BATCH_SIZE	64
+/* Maximum number of secondary index tuples buffered for sorted PK fetch */
+#define O_SCAN_PK_BATCH_SIZE	256
+
+extern bool orioledb_enable_skip_scan;
+
+/*
+ * Simple "column op constant" qual, which could be checked directly on the
+ * index leaf tuple before any slot is formed.
+ */
+typedef struct OScanFilter
+{
+	/* attribute number in the index leaf tuple */
+	AttrNumber	attnum;
+	/* is column the left operand of the operator */
+	bool		varOnLeft;
+	Datum		value;
+	Oid			collation;
+	FmgrInfo	finfo;
+} OScanFilter;
+
 typedef struct OScanState
 {
 	IndexScanDescData scandesc;
@@ -33,6 +55,55 @@ typedef struct OScanState
 	bool		exact;
 	OBTreeKeyRange curKeyRange;
 	BTreeIterator *iterator;
+	/* tuples fetched from the iterator, but not yet returned */
+	int			batchCount;
+	int			batchIndex;
+	OTuple		batchTuples[O_SCAN_BATCH_SIZE];
+	CommitSeqNo batchCsns[O_SCAN_BATCH_SIZE];
+	BTreeLocationHint batchHint;
+	/*
+	 * number of rows the consumer is expected to need according to the
+	 * LIMIT clause, zero if unknown.  It's only used to fetch no more tuples
+	 * in advance than needed.
+	 */
+	int			rowBound;
+	int64		rowsReturned;
+	/* quals checked over the whole batch before returning tuples */
+	int			nFilters;
+	OScanFilter *filters;
+	/* shared state of parallel index scan, NULL if not parallel */
+	ParallelOIndexScanDesc pscan;
+	/* the key range is split into chunks between parallel workers */
+	bool		parallelChunks;
+	/* this worker does the whole scan, which can't be split */
+	bool		parallelOwner;
+	/* no more chunks for this worker */
+	bool		parallelDone;
+	/* the end of the current chunk, unset for the rightmost one */
+	bool		chunkHasEnd;
+	OFixedKey	chunkEnd;
+	/* skip over the distinct values of the first non-exact column */
+	bool		skipScan;
+	/*
+	 * secondary index tuples buffered to fetch primary index tuples in the
+	 * primary key order, used when the output order doesn't matter
+	 */
+	bool		sortedPkFetch;
+	int			pkBatchCount;
+	int			pkBatchIndex;
+	OTuple		pkBatchTuples[O_SCAN_PK_BATCH_SIZE];
+	/*
+	 * memory context for the range iterators, which outlives the rescans, if
+	 * they could reuse the iterator.  NULL means cxt is used.
+	 */
+	MemoryContext rescanCxt;
+	/* iterator of the previous scan, whose leaf page could be reused */
+	BTreeIterator *rescanIterator;
+	/*
+	 * generation context for the tuples returned to the scan slot, created
+	 * on the first fetch
+	 */
+	MemoryContext tupleCxt;
 	List	   *indexQuals;
 	/* used only by direct modify functions */
 	CmdType		cmd;
@@ -63,6 +134,10 @@ extern void init_index_scan_state(OPlanState *o_plan_state, OScanState *ostate,
 extern OTuple o_iterate_index(OIndexDescr *indexDescr, OScanState *ostate,
 							  CommitSeqNo *tupleCsn, MemoryContext tupleCxt,
 							  BTreeLocationHint *hint);
+extern void o_index_scan_init_filters(OScanState *ostate, OIndexDescr *id,
+									  List *qual, Index scanrelid);
+extern void o_index_scan_discard_batch(OScanState *ostate);
+extern void o_index_scan_discard_pk_batch(OScanState *ostate);
 extern OTuple o_index_scan_getnext(OTableDescr *descr, OScanState *ostate,
 								   CommitSeqNo *tupleCsn,
 								   bool scan_primary, MemoryContext tupleCxt,
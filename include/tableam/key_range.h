@@ -70,5 +70,6 @@ extern bool o_key_data_to_key_range(OBTreeKeyRange *res,
 									int numPrefixExactKeys,
 									int resultNKeys,
 									OIndexField *fields);
+extern bool o_is_binary_coercible(Oid srctype, Oid targettype);
 
 #endif
@@ -85,9 +85,18 @@ typedef struct
 	bool		selfModified;
 } OLockCallbackArg;
 
+extern bool orioledb_enable_index_prefetch;
+
 extern TupleTableSlot *o_tbl_insert(OTableDescr *descr, Relation relation,
 									TupleTableSlot *slot, OXid oxid,
 									CommitSeqNo csn);
+extern void o_tbl_insert_batch(OTableDescr *descr, Relation relation,
+							   TupleTableSlot **slots, int ntuples,
+							   OXid oxid, CommitSeqNo csn);
+extern bool o_tbl_bulk_load_insert(OTableDescr *descr, Relation relation,
+								   TupleTableSlot **slots, int ntuples,
+								   int options);
+extern void o_tbl_bulk_load_finish(Relation relation);
 extern TupleTableSlot *o_tbl_insert_with_arbiter(Relation rel,
 												 OTableDescr *descr,
 												 TupleTableSlot *slot,
@@ -24,6 +24,7 @@ typedef enum OPlanTag
 {
 	O_IndexPlan,
 	O_BitmapHeapPlan,
+	O_SeqScanPlan,
 } OPlanTag;
 
 typedef struct OPlanState
@@ -32,12 +33,23 @@ typedef struct OPlanState
 } OPlanState;
 
 extern set_rel_pathlist_hook_type old_set_rel_pathlist_hook;
+extern create_upper_paths_hook_type old_create_upper_paths_hook;
+extern bool orioledb_enable_parallel_index_scan;
+extern bool orioledb_enable_parallel_bitmap_scan;
+extern bool orioledb_enable_sorted_pk_fetch;
+extern bool orioledb_enable_index_only_costing;
+extern bool orioledb_enable_count_pushdown;
 
 extern void orioledb_set_rel_pathlist_hook(PlannerInfo *root, RelOptInfo *rel,
 										   Index rti, RangeTblEntry *rte);
 extern bool orioledb_set_plain_rel_pathlist_hook(PlannerInfo *root,
 												 RelOptInfo *rel,
 												 RangeTblEntry *rte);
+extern void orioledb_create_upper_paths_hook(PlannerInfo *root,
+											 UpperRelationKind stage,
+											 RelOptInfo *input_rel,
+											 RelOptInfo *output_rel,
+											 void *extra);
 
 extern bool is_o_custom_scan(CustomScan *scan);
 extern bool is_o_custom_scan_state(CustomScanState *scan);
@@ -36,6 +36,7 @@ extern int	o_idx_cmp_value_bounds(OBTreeValueBound *bound1,
 extern int	o_idx_cmp(BTreeDescr *desc,
 					  void *p1, BTreeKeyType keyType1,
 					  void *p2, BTreeKeyType keyType2);
+extern void o_index_fill_key_image_types(OIndexDescr *id);
 extern int	o_idx_cmp_range_key_to_value(OBTreeValueBound *sk1, OIndexField *field,
 										 Datum value, bool isnull);
 
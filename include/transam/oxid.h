@@ -38,10 +38,21 @@ typedef struct
 
 	int			xidMapTrancheId;
 	LWLock		xidMapWriteLock;
+
+	/* wait_for_oxid() statistics, see orioledb_oxid_wait_stats() */
+	pg_atomic_uint64 waitSpins;
+	pg_atomic_uint64 waitSpinSuccesses;
+	pg_atomic_uint64 waitSleeps;
 } XidMeta;
 
 extern XidMeta *xid_meta;
 
+/*
+ * Xmins of the processes.  Kept in a dense array rather than in ODBProcData,
+ * so advance_global_xmin() reads them from adjacent cache lines.
+ */
+extern pg_atomic_uint64 *oProcXmins;
+
 typedef struct OSnapshot
 {
 	CommitSeqNo csn;
@@ -96,6 +107,7 @@ extern void fill_current_oxid_osnapshot(OXid *oxid, OSnapshot *snapshot);
 extern int	oxid_get_procnum(OXid oxid);
 extern bool xid_is_finished(OXid xid);
 extern bool xid_is_finished_for_everybody(OXid xid);
+extern bool xid_is_visible_for_everybody(OXid xid);
 extern void fsync_xidmap_range(OXid xmin, OXid xmax, uint32 wait_event_info);
 
 #endif							/* __OXID_H__ */
@@ -40,8 +40,6 @@ typedef struct
 	 * [checkpointRetainStartLocation; checkpointRetainEndLocation) -- range of
 	 * undo locations required for recovery from the checkpoint.
 	 */
-	pg_atomic_uint64 lastUsedLocation;
-	pg_atomic_uint64 advanceReservedLocation;
 	pg_atomic_uint64 writeInProgressLocation;
 	pg_atomic_uint64 writtenLocation;
 	pg_atomic_uint64 lastUsedUndoLocationWhenUpdatedMinLocation;
@@ -58,12 +56,25 @@ typedef struct
 	int			undoWriteTrancheId;
 	LWLock		undoWriteLock;
 	int			undoStackLocationsFlushLockTrancheId;
+
+	/*
+	 * lastUsedLocation and advanceReservedLocation are advanced by every
+	 * backend for every undo record, while the fields above are mostly read.
+	 * Keep each of them on its own cache line, so that undo allocations
+	 * don't invalidate the cache lines read by the other backends.
+	 */
+	char		lastUsedLocationPad[PG_CACHE_LINE_SIZE];
+	pg_atomic_uint64 lastUsedLocation;
+	char		advanceReservedLocationPad[PG_CACHE_LINE_SIZE - sizeof(pg_atomic_uint64)];
+	pg_atomic_uint64 advanceReservedLocation;
+	char		tailPad[PG_CACHE_LINE_SIZE - sizeof(pg_atomic_uint64)];
 } UndoMeta;
 
 typedef struct
 {
 	int			pendingTruncatesTrancheId;
 	LWLock		pendingTruncatesLock;
+	uint64		pendingTruncatesStart;
 	uint64		pendingTruncatesLocation;
 } PendingTruncatesMeta;
 
@@ -77,7 +88,8 @@ typedef enum
 	SysTreesLockUndoItemType,
 	InvalidateUndoItemType,
 	BranchUndoItemType,
-	SubXactUndoItemType
+	SubXactUndoItemType,
+	ModifyDeltaUndoItemType
 } UndoItemType;
 
 struct UndoStackItem
@@ -109,6 +121,8 @@ typedef struct
 	bool		local_wal_has_material_changes;
 	OXid		oxid;
 	TransactionId logicalXid;
+	int			subxactsUndoCount;
+	int			subxactsWalCount;
 } OAutonomousTxState;
 
 /*
@@ -141,6 +155,7 @@ typedef enum
 } UndoStackKind;
 
 extern bool oxid_needs_wal_flush;
+extern int	undo_compress;
 extern UndoLocation curRetainUndoLocations[(int) UndoLogsCount];
 extern PendingTruncatesMeta *pending_truncates_meta;
 
@@ -211,6 +226,7 @@ extern void undo_snapshot_register_hook(Snapshot snapshot);
 extern void undo_snapshot_deregister_hook(Snapshot snapshot);
 extern void orioledb_snapshot_hook(Snapshot snapshot);
 extern void add_subxact_undo_item(SubTransactionId parentSubid);
+extern void add_pending_savepoint_wal_records(void);
 extern void rollback_to_savepoint(UndoLogType undoType,
 								  UndoStackKind kind,
 								  SubTransactionId parentSubid,
@@ -43,6 +43,7 @@ typedef struct OTableSlot
 #define ORIOLEDB_TO_TOAST_COMPRESSION_TRIED ('c')
 
 extern PGDLLIMPORT const TupleTableSlotOps TTSOpsOrioleDB;
+extern int	inline_compress_threshold;
 
 extern void tts_orioledb_detoast(TupleTableSlot *slot);
 extern void tts_orioledb_store_tuple(TupleTableSlot *slot, OTuple tuple,
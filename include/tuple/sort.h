@@ -19,6 +19,8 @@ extern Tuplesortstate *tuplesort_begin_orioledb_index(OIndexDescr *idx,
 													  int workMem,
 													  bool randomAccess,
 													  SortCoordinate coordinate);
+extern void tuplesort_orioledb_index_set_insert_rel(Tuplesortstate *state,
+													Relation rel);
 extern Tuplesortstate *tuplesort_begin_orioledb_toast(OIndexDescr *toast,
 													  OIndexDescr *primary,
 													  int workMem,
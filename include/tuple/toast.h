@@ -100,6 +100,16 @@ extern bool generic_toast_update(ToastAPI *api, void *key, Pointer data,
 extern bool generic_toast_delete(ToastAPI *api, void *key, OXid oxid,
 								 CommitSeqNo csn, void *arg);
 
+/*
+ * Same as generic_toast_update, but keeps the chunks which are equal to the
+ * chunks of the old value.
+ */
+extern bool generic_toast_update_changed(ToastAPI *api, void *key,
+										 Pointer data, Size data_size,
+										 Pointer old_data, Size old_data_size,
+										 OXid oxid, CommitSeqNo csn,
+										 void *arg);
+
 extern bool generic_toast_insert_optional_wal(ToastAPI *api, void *key,
 											  Pointer data, Size data_size,
 											  OXid oxid, CommitSeqNo csn,
@@ -116,6 +126,25 @@ extern bool generic_toast_delete_optional_wal(ToastAPI *api, void *key,
 extern Pointer generic_toast_get(ToastAPI *api, void *key, Size data_size,
 								 OSnapshot *snapshot, void *arg);
 
+/*
+ * Receives the consecutive pieces of the value fetched by
+ * generic_toast_stream().  'offset' is the position of the piece within the
+ * value.  Returns false to stop the stream.
+ */
+typedef bool (*ToastStreamCallback) (Pointer data, Size length, Size offset,
+									 void *arg);
+
+/* Streams the part of the value reading only the chunks covering it */
+extern Size generic_toast_stream(ToastAPI *api, void *key, Size offset,
+								 Size length, OSnapshot *snapshot, void *arg,
+								 ToastStreamCallback callback,
+								 void *callback_arg);
+
+/* Returns the part of the value only if it's fully fetched, or NULL */
+extern Pointer generic_toast_get_slice(ToastAPI *api, void *key, Size offset,
+									   Size length, OSnapshot *snapshot,
+									   void *arg);
+
 /* Returns tuple and size of data if found, or NULL otherwise */
 extern Pointer generic_toast_get_any(ToastAPI *api, void *key,
 									 Size *data_size, OSnapshot *snapshot,
@@ -154,6 +183,11 @@ extern void o_toast_sort_add(OIndexDescr *primary, OIndexDescr *toast,
 							 OTuple pk, uint16 attn,
 							 Pointer data, Size data_size,
 							 Tuplesortstate *sortstate);
+extern bool o_toast_update(OIndexDescr *primary, OIndexDescr *toast,
+						   OTuple pk, uint16 attn,
+						   Pointer data, Size data_size,
+						   Pointer old_data, Size old_data_size,
+						   OXid oxid, CommitSeqNo csn);
 extern bool o_toast_delete(OIndexDescr *primary, OIndexDescr *toast,
 						   OTuple pk, uint16 attn,
 						   OXid oxid, CommitSeqNo csn);
@@ -161,6 +195,10 @@ extern Pointer o_toast_get(OIndexDescr *primary, OIndexDescr *toast,
 						   OTuple pk, uint16 attn, Size data_size,
 						   OSnapshot *snapshot);
 
+extern Pointer o_toast_get_slice(OIndexDescr *primary, OIndexDescr *toast,
+								 OTuple pk, uint16 attn, Size offset,
+								 Size length, OSnapshot *snapshot);
+
 extern int	o_toast_cmp(BTreeDescr *desc, void *p1, BTreeKeyType k1,
 						void *p2, BTreeKeyType k2);
 extern bool o_toast_needs_undo(BTreeDescr *desc, BTreeOperationType action,
@@ -0,0 +1,22 @@
+/*-------------------------------------------------------------------------
+ *
+ * bench.h
+ *		Declarations for microbenchmarks of the BTree primitives.
+ *
+ * Copyright (c) 2021-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/utils/bench.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include "storage/dsm.h"
+#include "storage/shm_toc.h"
+
+extern Datum orioledb_btree_bench(PG_FUNCTION_ARGS);
+PGDLLEXPORT void o_btree_bench_worker_main(dsm_segment *seg, shm_toc *toc);
+
+#endif							/* __BENCH_H__ */
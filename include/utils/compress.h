@@ -13,10 +13,40 @@
 #ifndef __COMPRESS_H__
 #define __COMPRESS_H__
 
+/* Maximal size of the tree compression dictionary */
+#define O_COMPRESS_DICT_MAX_SIZE	(128 * 1024)
+/* Maximal dictionary id fitting OCompressHeader.dictId */
+#define O_COMPRESS_DICT_MAX_ID		(0xFFF)
+
+/*
+ * The tree dictionary reference kept in the meta-page: the dense dictionary
+ * id and the zstd id of the dictionary contents.
+ */
+#define O_COMPRESS_DICT_MAKE(dictId, zstdId) \
+	(((uint64) (dictId) << 32) | (uint32) (zstdId))
+#define O_COMPRESS_DICT_GET_ID(dict)		((uint16) ((dict) >> 32))
+#define O_COMPRESS_DICT_GET_ZSTD_ID(dict)	((uint32) (dict))
+
 extern void o_compress_init(void);
 extern Pointer o_compress_page(Pointer page, size_t *size, OCompress lvl);
-extern void o_decompress_page(Pointer src, size_t size, Pointer page);
+extern Pointer o_compress_page_dict(Pointer page, size_t *size, OCompress lvl,
+									Oid datoid, Oid relnode, uint64 dict,
+									uint16 *dictId);
+extern void o_decompress_page(Pointer src, size_t size, Pointer page,
+							  int algorithm, Oid datoid, Oid relnode,
+							  uint16 dictId);
+extern size_t o_compress_buffer(Pointer src, size_t srcSize, Pointer dst,
+								size_t dstCapacity, OCompress lvl);
+extern void o_decompress_buffer(Pointer src, size_t size, Pointer dst,
+								size_t dstSize);
+extern Pointer o_compress_dict_train(Pointer samples, size_t *sampleSizes,
+									 int nsamples, size_t dictCapacity,
+									 size_t *dictSize, uint32 *zstdId);
+extern void o_compress_dict_write(Oid datoid, Oid relnode, uint16 dictId,
+								  Pointer dict, size_t size);
+extern uint64 o_compress_dict_find_last(Oid datoid, Oid relnode);
 extern OCompress o_compress_max_lvl(void);
+extern char *o_compress_name(OCompress compress);
 extern void validate_compress(OCompress compress, char *prefix);
 
 #endif							/* __COMPRESS_H__ */
@@ -0,0 +1,50 @@
+/*-------------------------------------------------------------------------
+ *
+ * latency.h
+ *		Declarations of latency histograms for the critical paths.
+ *
+ * Copyright (c) 2025-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/utils/latency.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __LATENCY_H__
+#define __LATENCY_H__
+
+#include "portability/instr_time.h"
+
+typedef enum
+{
+	OLatencyLoadPageMemory,
+	OLatencyLoadPageDisk,
+	OLatencyLoadPageS3,
+	OLatencyEvictPage,
+	OLatencyCompressPage,
+	OLatencyDecompressPage,
+	OLatencyCommitFlush,
+	OLatencyPageLockWait,
+	OLatencyEventsCount
+} OLatencyEvent;
+
+extern bool latency_histograms;
+
+extern Size latency_shmem_needs(void);
+extern void latency_shmem_init(Pointer ptr, bool found);
+extern void latency_record(OLatencyEvent event, instr_time *start);
+
+/*
+ * Starts timing of the operation, which is accounted by latency_record().
+ * Leaves 'start' zero if the histograms are disabled.
+ */
+static inline void
+latency_start(instr_time *start)
+{
+	if (latency_histograms)
+		INSTR_TIME_SET_CURRENT(*start);
+	else
+		INSTR_TIME_SET_ZERO(*start);
+}
+
+#endif							/* __LATENCY_H__ */
@@ -24,6 +24,8 @@ typedef struct
 	const char *groupCtlTrancheName;
 	const char *bufferCtlTrancheName;
 	uint32		buffersCount;
+	/* compression level of the evicted blocks, NULL if never compressed */
+	const int  *compress;
 
 	/* these fields are initilized in o_buffers.c */
 	uint32		groupsCount;
@@ -32,6 +34,9 @@ typedef struct
 	File		curFile;
 	char		curFileName[MAXPGPATH];
 	uint64		curFileNum;
+	/* the last block read from the file by this process, for read-ahead */
+	int64		lastReadBlockNum;
+	int64		readAheadBlockNum;
 } OBuffersDesc;
 
 extern Size o_buffers_shmem_needs(OBuffersDesc *desc);
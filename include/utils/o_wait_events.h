@@ -0,0 +1,37 @@
+/*-------------------------------------------------------------------------
+ *
+ * o_wait_events.h
+ *		Declarations of OrioleDB wait events and their statistics.
+ *
+ * Copyright (c) 2025-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/utils/o_wait_events.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __O_WAIT_EVENTS_H__
+#define __O_WAIT_EVENTS_H__
+
+#include "portability/instr_time.h"
+
+typedef enum
+{
+	OWaitPageLock,
+	OWaitPageReadEnable,
+	OWaitPageChangeCount,
+	OWaitIOCompletion,
+	OWaitOxid,
+	OWaitS3Queue,
+	OWaitUndoReserve,
+	OWaitEventsCount
+} OWaitEvent;
+
+extern Size o_wait_events_shmem_needs(void);
+extern void o_wait_events_shmem_init(Pointer ptr, bool found);
+extern uint32 o_wait_event_info(OWaitEvent event);
+extern void o_wait_event_start(OWaitEvent event, instr_time *start);
+extern void o_wait_event_end(OWaitEvent event, instr_time *start);
+extern void o_wait_event_account(OWaitEvent event, instr_time *start);
+
+#endif							/* __O_WAIT_EVENTS_H__ */
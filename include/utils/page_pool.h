@@ -36,12 +36,40 @@
 #define PPOOL_RESERVE_MASK_ALL (PPOOL_RESERVE_META_MASK | PPOOL_RESERVE_INSERT_MASK \
 								| PPOOL_RESERVE_FIND_MASK | PPOOL_RESERVE_SHARED_INFO_INSERT_MASK)
 
+/*
+ * Cumulative statistics of the page pool, see orioledb_page_pool_stats().
+ */
+typedef struct
+{
+	/* pages reserved */
+	pg_atomic_uint64 gets;
+	/* reservations which had to run the clock themselves */
+	pg_atomic_uint64 misses;
+	/* clock runs and the pages visited by them */
+	pg_atomic_uint64 clockRuns;
+	pg_atomic_uint64 clockIterations;
+	/* pages written or evicted by the clock of the backends */
+	pg_atomic_uint64 backendEvictions;
+	pg_atomic_uint64 backendWrites;
+	/* pages written or evicted by the clock of the background writers */
+	pg_atomic_uint64 bgwriterEvictions;
+	pg_atomic_uint64 bgwriterWrites;
+	/* dirty pages queued by the backends, and evicted by bgwriter */
+	pg_atomic_uint64 queuedEvictions;
+	pg_atomic_uint64 queuedEvicted;
+	/* pages merged instead of eviction */
+	pg_atomic_uint64 merges;
+} OPagePoolStats;
+
 struct OPagePool
 {
 	/* count of available to reserve pages in the pool */
 	pg_atomic_uint64 *availablePagesCount;
 	/* count of dirty pages in the pool */
 	pg_atomic_uint32 *dirtyPagesCount;
+	/* count of pages excluded from the pool by ppool_set_pages_limit() */
+	pg_atomic_uint64 *withheldPagesCount;
+	OPagePoolStats *stats;
 	/* init position for the ucm */
 	OInMemoryBlkno location;
 	/* offset of the pool in the o_shared_buffers */
@@ -61,7 +89,11 @@ extern Size ppool_estimate_space(OPagePool *pool, OInMemoryBlkno offset, OInMemo
 extern void ppool_shmem_init(OPagePool *pool, Pointer ptr, bool found);
 extern OInMemoryBlkno ppool_free_pages_count(OPagePool *pool);
 extern OInMemoryBlkno ppool_dirty_pages_count(OPagePool *pool);
-extern void ppool_run_clock(OPagePool *pool, bool evict, volatile sig_atomic_t *shutdown_requested);
+extern void ppool_set_pages_limit(OPagePool *pool, OInMemoryBlkno limit);
+extern void ppool_run_clock(OPagePool *pool, bool evict,
+							volatile sig_atomic_t *shutdown_requested,
+							OInMemoryBlkno *clockHand);
+extern void ppool_evict_page(OPagePool *pool, OInMemoryBlkno blkno);
 
 extern void ppool_reserve_pages(OPagePool *pool, int kind, int count);
 extern void ppool_release_reserved(OPagePool *pool, uint32 mask);
@@ -96,6 +128,7 @@ extern void ppool_free_page(OPagePool *pool, OInMemoryBlkno blkno, bool haveLock
 		{ \
 			O_GET_IN_MEMORY_PAGEDESC(blkno)->flags |= PAGE_DESC_FLAG_CONCURRENT_DIRTY; \
 		} \
+		btree_mark_subtree_dirty((desc), (blkno)); \
 	} \
 	while (0);
 
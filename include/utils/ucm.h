@@ -35,6 +35,8 @@ extern void init_ucm(UsageCountMap *map, Pointer ptr, bool found);
 extern void page_inc_usage_count(UsageCountMap *map, OInMemoryBlkno blkno,
 								 uint32 usageCount, bool no_skip);
 extern void page_change_usage_count(UsageCountMap *map, OInMemoryBlkno blkno, uint32 usageCount);
+extern uint32 ucm_new_page_usage_count(UsageCountMap *map);
+extern uint32 page_get_hotness(UsageCountMap *map, OInMemoryBlkno blkno);
 extern bool ucm_check_map(UsageCountMap *map);
 extern bool ucm_epoch_needs_shift(UsageCountMap *map);
 extern void ucm_epoch_shift(UsageCountMap *map);
@@ -42,5 +44,7 @@ extern OInMemoryBlkno ucm_next_blkno(UsageCountMap *map, OInMemoryBlkno init_blk
 extern OInMemoryBlkno ucm_occupy_free_page(UsageCountMap *map);
 extern void set_skip_ucm(void);
 extern void unset_skip_ucm(void);
+extern void set_cold_ucm(void);
+extern void unset_cold_ucm(void);
 
 #endif							/* __UCM_H__ */
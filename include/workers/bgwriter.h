@@ -14,8 +14,12 @@
 #define __BGWRITER_H__
 
 extern bool IsBGWriter;
+extern int	bgwriter_eviction_queue_size;
 
-extern void register_bgwriter(void);
+extern Size bgwriter_shmem_needs(void);
+extern void bgwriter_shmem_init(Pointer ptr, bool found);
+extern bool bgwriter_queue_eviction(OInMemoryBlkno blkno);
+extern void register_bgwriter(int num);
 PGDLLEXPORT void bgwriter_main(Datum);
 
 #endif							/* __BGWRITER_H__ */
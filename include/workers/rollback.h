@@ -0,0 +1,25 @@
+/*-------------------------------------------------------------------------
+ *
+ * rollback.h
+ *		Routines for background rollback of large transactions.
+ *
+ * Copyright (c) 2025-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/workers/rollback.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __ROLLBACK_H__
+#define __ROLLBACK_H__
+
+extern int	deferred_rollback_threshold;
+
+extern Size rollback_worker_shmem_needs(void);
+extern void rollback_worker_shmem_init(Pointer ptr, bool found);
+extern bool deferred_rollback_hand_over(OXid oxid);
+extern OXid deferred_rollback_get_oxid(void);
+extern void register_rollback_worker(void);
+PGDLLEXPORT void rollback_worker_main(Datum);
+
+#endif							/* __ROLLBACK_H__ */
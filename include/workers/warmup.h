@@ -0,0 +1,22 @@
+/*-------------------------------------------------------------------------
+ *
+ * warmup.h
+ *		Routines for saving and restoring the hot page set.
+ *
+ * Copyright (c) 2021-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/workers/warmup.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __WARMUP_H__
+#define __WARMUP_H__
+
+extern int	buffer_warmup_workers;
+
+extern void buffer_warmup_save(uint32 chkpNum);
+extern void register_warmup_workers(void);
+PGDLLEXPORT void warmup_worker_main(Datum);
+
+#endif							/* __WARMUP_H__ */
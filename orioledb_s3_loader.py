@@ -131,6 +131,7 @@ class OrioledbS3ObjectLoader:
 		self.download_unchanged_files(
 		    self.bucket_name, os.path.join("orioledb_data", "file_checksums"),
 		    chkp_num, None)
+		self.assemble_chunked_files()
 
 		self.download_unchanged_small_files(
 		    self.bucket_name,
@@ -148,7 +149,31 @@ class OrioledbS3ObjectLoader:
 		wal_file = control["Latest checkpoint's REDO WAL file"]
 		local_path = os.path.join(self.data_dir, f"pg_wal/{wal_file}")
 		wal_file = os.path.join(self.prefix, f"wal/{wal_file}")
-		self.download_file(self.bucket_name, wal_file, local_path)
+		self.download_wal_file(self.bucket_name, wal_file, local_path)
+
+	def download_wal_file(self, bucket_name, file_key, local_path):
+		# The WAL files compressed by orioledb.s3_wal_compression have the
+		# ".zst" suffix
+		compressed_key = f"{file_key}.zst"
+		try:
+			self.s3.head_object(Bucket=bucket_name, Key=compressed_key)
+		except ClientError as e:
+			if e.response['Error']['Code'] == "404":
+				self.download_file(bucket_name, file_key, local_path)
+				return
+			raise
+
+		import zstandard
+
+		compressed_path = f"{local_path}.zst"
+		if not self.download_file(bucket_name, compressed_key,
+		                          compressed_path):
+			return
+		with open(compressed_path, 'rb') as src, \
+		     open(local_path, 'wb') as dst:
+			zstandard.ZstdDecompressor().copy_stream(src, dst)
+		os.chmod(local_path, 0o600)
+		os.unlink(compressed_path)
 
 	def download_undo(self, startLocation, endLocation, template):
 		UNDO_FILE_SIZE = 0x4000000
@@ -403,6 +428,35 @@ class OrioledbS3ObjectLoader:
 			self.download_unchanged_files(bucket_name, file_checksums_name,
 			                              prev_chkp_num, prev_file_checksums)
 
+	# The files uploaded by chunks with orioledb.s3_incremental_backup
+	PG_FILE_CHUNK_SIZE = 4 * 1024 * 1024
+	PG_FILE_CHUNK_PATTERN = re.compile(r'^(?P<name>.+)\.orioledb_chunk\.(?P<num>\d+)$')
+
+	def assemble_chunked_files(self):
+		chunked_files = {}
+		for root, _, files in os.walk(self.data_dir):
+			for name in files:
+				m = self.PG_FILE_CHUNK_PATTERN.match(name)
+				if m is None:
+					continue
+				path = os.path.join(root, m.group('name'))
+				chunked_files.setdefault(path, []).append(
+				    (int(m.group('num')), os.path.join(root, name)))
+
+		for path, chunks in chunked_files.items():
+			chunks.sort()
+			if [num for num, _ in chunks] != list(range(len(chunks))):
+				raise Exception(f"Missing chunks of the file {path}")
+			if self.verbose:
+				print(f"{len(chunks)} chunks -> {path}", flush=True)
+			with open(path, 'wb') as file:
+				for num, chunk_path in chunks:
+					with open(chunk_path, 'rb') as chunk:
+						file.seek(num * self.PG_FILE_CHUNK_SIZE)
+						file.write(chunk.read())
+					os.unlink(chunk_path)
+			os.chmod(path, 0o600)
+
 	def download_unchanged_small_files(self, bucket_name: str,
 	                                   file_checksums_name: str, chkp_num: int,
 	                                   file_checksums: dict[str, str] | None):
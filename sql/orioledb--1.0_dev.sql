@@ -19,3 +19,19 @@ CREATE FUNCTION s3_put(objectname text, filename text)
 RETURNS text
 AS 'MODULE_PATHNAME'
 VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_btree_bench(relid regclass,
+									 operation text,
+									 nops int8,
+									 distribution text DEFAULT 'uniform',
+									 keys int8 DEFAULT 1000000,
+									 workers int4 DEFAULT 0,
+									 OUT ops int8,
+									 OUT elapsed_ms float8,
+									 OUT ops_per_sec float8,
+									 OUT p50_us float8,
+									 OUT p90_us float8,
+									 OUT p99_us float8,
+									 OUT max_us float8)
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
@@ -11,3 +11,329 @@ CREATE FUNCTION orioledb_tree_stat(relid regclass,
 RETURNS SETOF record
 AS 'MODULE_PATHNAME'
 VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_tree_defragment(relid regclass,
+										 max_pages int8 DEFAULT 10000,
+										 pages_per_second float8 DEFAULT 0)
+RETURNS int8
+AS 'MODULE_PATHNAME'
+VOLATILE STRICT LANGUAGE C;
+
+CREATE FUNCTION orioledb_tree_space(relid regclass,
+									OUT datafile_size int8,
+									OUT free_size int8,
+									OUT free_extents int8,
+									OUT max_free_extent int8)
+AS 'MODULE_PATHNAME'
+VOLATILE STRICT LANGUAGE C;
+
+CREATE FUNCTION orioledb_tree_train_dictionary(relid regclass,
+											   sample_pages int4 DEFAULT 1000,
+											   dict_size int4 DEFAULT 65536)
+RETURNS int4
+AS 'MODULE_PATHNAME'
+VOLATILE STRICT LANGUAGE C;
+
+CREATE FUNCTION orioledb_page_lock_stats(OUT datoid oid,
+										 OUT reloid oid,
+										 OUT relnode oid,
+										 OUT acquisitions int8,
+										 OUT spins int8,
+										 OUT waits int8,
+										 OUT wait_time float8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_page_lock_stats_reset()
+RETURNS void
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_wal_group_commit_stats(OUT groups int8,
+												OUT commits int8,
+												OUT avg_group_size float8,
+												OUT wait_time float8)
+RETURNS record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_wal_group_commit_stats_reset()
+RETURNS void
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_get_checkpoint_progress(OUT checkpoint_number int8,
+												 OUT start_time timestamptz,
+												 OUT trees_done int8,
+												 OUT pages_written int8,
+												 OUT bytes_written int8,
+												 OUT progress float8,
+												 OUT estimated_finish_time timestamptz)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE VIEW orioledb_checkpoint_progress AS
+  SELECT * FROM orioledb_get_checkpoint_progress();
+
+CREATE FUNCTION orioledb_io_stats(OUT io_class text,
+								  OUT concurrency int4,
+								  OUT in_progress int8,
+								  OUT waiting int8,
+								  OUT ops int8,
+								  OUT wait_time float8,
+								  OUT io_time float8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_io_stats_reset()
+RETURNS void
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_tree_io_stats(OUT datoid oid,
+									   OUT reloid oid,
+									   OUT relnode oid,
+									   OUT disk_loads int8,
+									   OUT s3_loads int8,
+									   OUT evictions int8,
+									   OUT writes int8,
+									   OUT bytes_read int8,
+									   OUT bytes_written int8,
+									   OUT compression_ratio float8,
+									   OUT load_time float8,
+									   OUT write_time float8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_tree_io_stats_reset()
+RETURNS void
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+-- Trees of the current database rolled up to their tables
+CREATE VIEW orioledb_statio_tables AS
+  SELECT c.oid AS relid,
+		 n.nspname AS schemaname,
+		 c.relname,
+		 sum(s.disk_loads)::int8 AS disk_loads,
+		 sum(s.s3_loads)::int8 AS s3_loads,
+		 sum(s.evictions)::int8 AS evictions,
+		 sum(s.writes)::int8 AS writes,
+		 sum(s.bytes_read)::int8 AS bytes_read,
+		 sum(s.bytes_written)::int8 AS bytes_written,
+		 CASE WHEN sum(s.bytes_written) > 0
+			  THEN sum(s.bytes_written * s.compression_ratio) /
+				   sum(s.bytes_written)
+		 END AS compression_ratio,
+		 sum(s.load_time) AS load_time,
+		 sum(s.write_time) AS write_time
+  FROM orioledb_tree_io_stats() s
+	   LEFT JOIN pg_index i ON i.indexrelid = s.reloid
+	   JOIN pg_class c ON c.oid = COALESCE(i.indrelid, s.reloid)
+	   JOIN pg_namespace n ON n.oid = c.relnamespace
+  WHERE s.datoid = (SELECT oid FROM pg_database
+					WHERE datname = current_database())
+  GROUP BY c.oid, n.nspname, c.relname;
+
+CREATE FUNCTION orioledb_page_pool_stats(OUT pool_name text,
+										 OUT free_pages int8,
+										 OUT dirty_pages int8,
+										 OUT gets int8,
+										 OUT misses int8,
+										 OUT clock_runs int8,
+										 OUT clock_iterations int8,
+										 OUT backend_evictions int8,
+										 OUT backend_writes int8,
+										 OUT bgwriter_evictions int8,
+										 OUT bgwriter_writes int8,
+										 OUT queued_evictions int8,
+										 OUT queued_evicted int8,
+										 OUT merges int8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_tree_pin(relid regclass)
+RETURNS void
+AS 'MODULE_PATHNAME'
+VOLATILE STRICT LANGUAGE C;
+
+CREATE FUNCTION orioledb_tree_unpin(relid regclass)
+RETURNS void
+AS 'MODULE_PATHNAME'
+VOLATILE STRICT LANGUAGE C;
+
+CREATE FUNCTION orioledb_tree_residency(OUT datoid oid,
+										OUT reloid oid,
+										OUT relnode oid,
+										OUT pages int8,
+										OUT leaf_pages int8,
+										OUT dirty_pages int8,
+										OUT bytes int8,
+										OUT pinned bool)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_prewarm(relid regclass)
+RETURNS int8
+AS 'MODULE_PATHNAME'
+VOLATILE STRICT LANGUAGE C;
+
+CREATE FUNCTION orioledb_s3_stats(OUT requests int8,
+								  OUT new_connections int8,
+								  OUT http2_requests int8,
+								  OUT connect_time float8,
+								  OUT request_time float8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_s3_stats_reset()
+RETURNS void
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_s3_cache_stats(OUT loaded_parts int8,
+										OUT loaded_bytes int8,
+										OUT desired_bytes int8,
+										OUT hits int8,
+										OUT misses int8,
+										OUT hit_ratio float8,
+										OUT loads int8,
+										OUT prefetch_loads int8,
+										OUT evictions int8,
+										OUT unused_prefetch_evictions int8,
+										OUT evicted_bytes int8,
+										OUT eviction_passes int8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_oxid_wait_stats(OUT spins int8,
+										 OUT spin_successes int8,
+										 OUT sleeps int8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_wait_stats(OUT wait_event text,
+									OUT waits int8,
+									OUT wait_time float8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_wait_stats_reset()
+RETURNS void
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_latency_stats(OUT event text,
+									   OUT count int8,
+									   OUT mean_us float8,
+									   OUT p50_us float8,
+									   OUT p90_us float8,
+									   OUT p99_us float8,
+									   OUT p999_us float8,
+									   OUT max_us float8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_latency_histogram(OUT event text,
+										   OUT low_us float8,
+										   OUT high_us float8,
+										   OUT count int8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_latency_stats_reset()
+RETURNS void
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_deferred_rollback_stats(OUT deferred int8,
+												 OUT completed int8)
+RETURNS record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_undo_stats(OUT undo_type text,
+									OUT last_used_location int8,
+									OUT min_reserved_location int8,
+									OUT min_transaction_retain_location int8,
+									OUT min_retain_location int8,
+									OUT written_location int8,
+									OUT cleaned_location int8,
+									OUT checkpoint_retain_location int8,
+									OUT buffer_size int8,
+									OUT in_memory_size int8,
+									OUT spilled_size int8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_undo_backend_stats(OUT pid int4,
+											OUT undo_type text,
+											OUT reserved_location int8,
+											OUT transaction_retain_location int8,
+											OUT snapshot_retain_location int8,
+											OUT transaction_retain_size int8,
+											OUT snapshot_retain_size int8,
+											OUT xmin int8,
+											OUT xmin_age int8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_recovery_consistent_lsn()
+RETURNS pg_lsn
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_recovery_stats(OUT dispatched_lsn pg_lsn,
+										OUT consistent_lsn pg_lsn,
+										OUT retain_lsn pg_lsn,
+										OUT index_builds_queued int8,
+										OUT index_builds_pending int8)
+RETURNS record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_recovery_worker_stats(OUT worker_id int4,
+											   OUT worker_type text,
+											   OUT commit_lsn pg_lsn,
+											   OUT retain_lsn pg_lsn,
+											   OUT queue_used_bytes int8,
+											   OUT queue_size int8,
+											   OUT applied_records int8,
+											   OUT applied_bytes int8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_key_sample_top(relid regclass,
+										OUT key jsonb,
+										OUT samples int8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE STRICT LANGUAGE C;
+
+CREATE FUNCTION orioledb_key_sample_histogram(relid regclass,
+											  OUT low_key jsonb,
+											  OUT high_key jsonb,
+											  OUT samples int8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE STRICT LANGUAGE C;
+
+CREATE FUNCTION orioledb_key_sample_reset()
+RETURNS void
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
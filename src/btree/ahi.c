@@ -0,0 +1,176 @@
+/*-------------------------------------------------------------------------
+ *
+ * ahi.c
+ *		Adaptive hash index over orioledb B-tree leaves.
+ *
+ * Copyright (c) 2021-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/btree/ahi.c
+ *
+ * NOTES
+ *
+ *		The adaptive hash index is a fixed-size direct-mapped table in shared
+ *		memory.  It maps the key image of a primary key lookup to the leaf page
+ *		where that key was found last time.  The table is populated by
+ *		ordinary point lookups and by modifications of the existing rows, so
+ *		frequently accessed keys of hot trees stay in it while cold entries
+ *		get overwritten.
+ *
+ *		Entries are only hints.  They are never explicitly invalidated: a hit
+ *		goes through refind_page(), which checks the page change count (this
+ *		catches merges, evictions and page reuse) and follows rightlinks (this
+ *		catches splits).  Then the caller checks that the leaf actually
+ *		contains the requested key, and falls back to the full descent
+ *		otherwise.  Thus, torn or stale entries only cost a wasted page read.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "btree/ahi.h"
+#include "tableam/descr.h"
+#include "tableam/key_range.h"
+
+#include "common/hashfn.h"
+#include "port/atomics.h"
+
+typedef struct
+{
+	pg_atomic_uint64 tag;
+	pg_atomic_uint64 location;
+} AHIEntry;
+
+#define AHI_EMPTY_TAG				(0)
+#define AHI_MAKE_LOCATION(blkno, changeCount) \
+	(((uint64) (blkno) << 32) | (uint64) (changeCount))
+#define AHI_LOCATION_GET_BLKNO(location) ((OInMemoryBlkno) ((location) >> 32))
+#define AHI_LOCATION_GET_CHANGECOUNT(location) ((uint32) (location))
+
+/* Number of entries, zero means adaptive hash index is disabled */
+int			adaptive_hash_index_size = 0;
+
+static AHIEntry *ahiEntries = NULL;
+
+Size
+ahi_shmem_needs(void)
+{
+	return mul_size(sizeof(AHIEntry), adaptive_hash_index_size);
+}
+
+void
+ahi_shmem_init(Pointer ptr, bool found)
+{
+	int			i;
+
+	ahiEntries = (AHIEntry *) ptr;
+
+	if (!found)
+	{
+		for (i = 0; i < adaptive_hash_index_size; i++)
+		{
+			pg_atomic_init_u64(&ahiEntries[i].tag, AHI_EMPTY_TAG);
+			pg_atomic_init_u64(&ahiEntries[i].location, 0);
+		}
+	}
+}
+
+/*
+ * Calculates the adaptive hash index tag for the given key.  Returns false if
+ * the key isn't eligible: only full primary key bounds, which are
+ * representable as key images, are.
+ */
+bool
+ahi_get_tag(BTreeDescr *desc, void *key, BTreeKeyType keyType, uint64 *tag)
+{
+	OIndexDescr *id;
+	OBTreeKeyBound *bound;
+	OKeyImage	image;
+	uint32		treeHash,
+				keyHash;
+	int			i;
+
+	if (adaptive_hash_index_size <= 0 ||
+		desc->type != oIndexPrimary ||
+		keyType != BTreeKeyBound)
+		return false;
+
+	id = (OIndexDescr *) desc->arg;
+	bound = (OBTreeKeyBound *) key;
+	if (id == NULL || bound->nkeys < id->nUniqueFields)
+		return false;
+
+	for (i = 0; i < id->nUniqueFields; i++)
+	{
+		if (bound->keys[i].flags & O_VALUE_BOUND_NO_VALUE)
+			return false;
+	}
+
+	if (!o_btree_key_image(desc, key, keyType, &image) ||
+		image.nvalues != id->nKeyImageFields)
+		return false;
+
+	treeHash = hash_bytes((unsigned char *) &desc->oids, sizeof(desc->oids));
+	keyHash = hash_bytes((unsigned char *) image.values,
+						 sizeof(image.values[0]) * image.nvalues);
+	keyHash = hash_combine(treeHash, keyHash);
+
+	*tag = ((uint64) treeHash << 32) | (uint64) keyHash;
+	if (*tag == AHI_EMPTY_TAG)
+		*tag = 1;
+	return true;
+}
+
+/*
+ * Looks up the leaf location for the given tag.  The caller must validate
+ * the result as described in the header comment.
+ */
+bool
+ahi_lookup(BTreeDescr *desc, uint64 tag, BTreeLocationHint *hint)
+{
+	AHIEntry   *entry = &ahiEntries[(uint32) tag % adaptive_hash_index_size];
+	uint64		location;
+
+	if (pg_atomic_read_u64(&entry->tag) != tag)
+		return false;
+	pg_read_barrier();
+	location = pg_atomic_read_u64(&entry->location);
+	pg_read_barrier();
+	if (pg_atomic_read_u64(&entry->tag) != tag)
+		return false;
+
+	hint->blkno = AHI_LOCATION_GET_BLKNO(location);
+	hint->pageChangeCount = AHI_LOCATION_GET_CHANGECOUNT(location);
+	if (!OInMemoryBlknoIsValid(hint->blkno) ||
+		hint->blkno >= orioledb_buffers_count)
+		return false;
+
+	/* Quick check that the page still belongs to the same tree */
+	if (!ORelOidsIsEqual(O_GET_IN_MEMORY_PAGEDESC(hint->blkno)->oids,
+						 desc->oids))
+		return false;
+	return true;
+}
+
+/*
+ * Remembers the leaf location for the given tag, replacing the previous
+ * entry in the slot.
+ */
+void
+ahi_remember(uint64 tag, BTreeLocationHint *hint)
+{
+	AHIEntry   *entry = &ahiEntries[(uint32) tag % adaptive_hash_index_size];
+	uint64		location = AHI_MAKE_LOCATION(hint->blkno, hint->pageChangeCount);
+
+	if (pg_atomic_read_u64(&entry->tag) == tag &&
+		pg_atomic_read_u64(&entry->location) == location)
+		return;
+
+	pg_atomic_write_u64(&entry->tag, AHI_EMPTY_TAG);
+	pg_write_barrier();
+	pg_atomic_write_u64(&entry->location, location);
+	pg_write_barrier();
+	pg_atomic_write_u64(&entry->tag, tag);
+}
@@ -0,0 +1,325 @@
+/*-------------------------------------------------------------------------
+ *
+ * bloom.c
+ *		Bloom filters over evicted orioledb B-tree pages.
+ *
+ * Copyright (c) 2021-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/btree/bloom.c
+ *
+ * NOTES
+ *
+ *		Bloom filters are kept in a fixed-size direct-mapped table in shared
+ *		memory.  Each entry is identified by the tree and the on-disk downlink
+ *		of the evicted page.  The filter contains key images of all the
+ *		primary key leaf tuples of the evicted subtree including the deleted
+ *		ones.  The filter of a leaf is built on its eviction.  The filter of a
+ *		non-leaf page is the union of its children filters.  Point lookups,
+ *		which reach the on-disk downlink, check the filter and skip loading
+ *		the page when the key can't be there.
+ *
+ *		The page under on-disk downlink can't change until it is loaded
+ *		again, so the filter stays exact while the downlink stays the same.
+ *		load_page() forgets the filter before replacing the downlink, and
+ *		every eviction writes the filter (or forgets the stale one) before
+ *		setting the new on-disk downlink.  Filters aren't built for leaves
+ *		with retained page-level undo: old snapshots might need the keys,
+ *		which are gone from the page image.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "btree/bloom.h"
+#include "btree/page_contents.h"
+#include "tableam/descr.h"
+#include "transam/undo.h"
+
+#include "common/hashfn.h"
+#include "port/atomics.h"
+#include "port/pg_bitutils.h"
+
+typedef struct
+{
+	/* odd while the entry is being written */
+	pg_atomic_uint32 version;
+	ORelOids	oids;
+	uint64		downlink;
+	OBloomFilter filter;
+} BloomFilterEntry;
+
+/* Don't keep the filters, which are too full to reject anything */
+#define BLOOM_FILTER_MAX_BITS_SET	(BLOOM_FILTER_BITS / 2)
+
+/* Number of entries, zero means Bloom filters are disabled */
+int			bloom_filter_size = 0;
+
+static BloomFilterEntry *bloomFilterEntries = NULL;
+
+Size
+bloom_filter_shmem_needs(void)
+{
+	return mul_size(sizeof(BloomFilterEntry), bloom_filter_size);
+}
+
+void
+bloom_filter_shmem_init(Pointer ptr, bool found)
+{
+	int			i;
+
+	bloomFilterEntries = (BloomFilterEntry *) ptr;
+
+	if (!found)
+	{
+		for (i = 0; i < bloom_filter_size; i++)
+		{
+			pg_atomic_init_u32(&bloomFilterEntries[i].version, 0);
+			bloomFilterEntries[i].oids.datoid = InvalidOid;
+			bloomFilterEntries[i].oids.reloid = InvalidOid;
+			bloomFilterEntries[i].oids.relnode = InvalidOid;
+			bloomFilterEntries[i].downlink = InvalidDiskDownlink;
+		}
+	}
+}
+
+static BloomFilterEntry *
+bloom_filter_get_entry(BTreeDescr *desc, uint64 downlink)
+{
+	uint32		hash;
+
+	hash = hash_bytes((unsigned char *) &desc->oids, sizeof(desc->oids));
+	hash = hash_combine(hash, hash_bytes_uint32((uint32) downlink));
+	hash = hash_combine(hash, hash_bytes_uint32((uint32) (downlink >> 32)));
+	return &bloomFilterEntries[hash % bloom_filter_size];
+}
+
+/*
+ * Copies the filter for the given downlink.  Returns false if there is no
+ * such filter or the entry is being concurrently written.
+ */
+static bool
+bloom_filter_read(BTreeDescr *desc, uint64 downlink, OBloomFilter *filter)
+{
+	BloomFilterEntry *entry = bloom_filter_get_entry(desc, downlink);
+	uint32		version;
+	bool		match;
+
+	version = pg_atomic_read_u32(&entry->version);
+	if (version & 1)
+		return false;
+	pg_read_barrier();
+	match = ORelOidsIsEqual(entry->oids, desc->oids) &&
+		entry->downlink == downlink;
+	if (match)
+		memcpy(filter, &entry->filter, sizeof(OBloomFilter));
+	pg_read_barrier();
+	return match && pg_atomic_read_u32(&entry->version) == version;
+}
+
+/*
+ * Writes the filter for the given downlink, or clears the entry if the filter
+ * is NULL and the entry belongs to that downlink.  Unlike the adaptive hash
+ * index, stale entries must never survive, so wait for concurrent writers.
+ */
+static void
+bloom_filter_write(BTreeDescr *desc, uint64 downlink, OBloomFilter *filter)
+{
+	BloomFilterEntry *entry = bloom_filter_get_entry(desc, downlink);
+	uint32		version;
+
+	while (true)
+	{
+		version = pg_atomic_read_u32(&entry->version);
+		if (!(version & 1) &&
+			pg_atomic_compare_exchange_u32(&entry->version, &version,
+										   version + 1))
+			break;
+		pg_spin_delay();
+	}
+
+	if (filter)
+	{
+		entry->oids = desc->oids;
+		entry->downlink = downlink;
+		memcpy(&entry->filter, filter, sizeof(OBloomFilter));
+	}
+	else if (ORelOidsIsEqual(entry->oids, desc->oids) &&
+			 entry->downlink == downlink)
+	{
+		entry->downlink = InvalidDiskDownlink;
+	}
+	pg_write_barrier();
+	pg_atomic_write_u32(&entry->version, version + 2);
+}
+
+/*
+ * Calculates the hash of the key image.  Only primary keys, which are
+ * represented by their images exactly, are eligible: then equal keys always
+ * have equal hashes.
+ */
+bool
+bloom_filter_key_hash(BTreeDescr *desc, void *key, BTreeKeyType keyType,
+					  uint64 *hash)
+{
+	OIndexDescr *id = (OIndexDescr *) desc->arg;
+	OKeyImage	image;
+
+	if (bloom_filter_size <= 0 || desc->type != oIndexPrimary || id == NULL)
+		return false;
+
+	if (keyType == BTreeKeyBound)
+	{
+		OBTreeKeyBound *bound = (OBTreeKeyBound *) key;
+		int			i;
+
+		if (bound->nkeys < id->nUniqueFields)
+			return false;
+		for (i = 0; i < id->nUniqueFields; i++)
+		{
+			if (bound->keys[i].flags & O_VALUE_BOUND_NO_VALUE)
+				return false;
+		}
+	}
+	else if (keyType != BTreeKeyLeafTuple)
+		return false;
+
+	if (!o_btree_key_image(desc, key, keyType, &image) ||
+		image.nvalues != id->nUniqueFields ||
+		image.nexact < image.nvalues)
+		return false;
+
+	*hash = hash_bytes_extended((unsigned char *) image.values,
+								sizeof(image.values[0]) * image.nvalues, 0);
+	return true;
+}
+
+static void
+bloom_filter_add(OBloomFilter *filter, uint64 hash)
+{
+	uint32		h1 = (uint32) hash,
+				h2 = (uint32) (hash >> 32) | 1;
+	int			i;
+
+	for (i = 0; i < BLOOM_FILTER_HASHES; i++)
+	{
+		uint32		bit = (h1 + i * h2) % BLOOM_FILTER_BITS;
+
+		filter->words[bit / 64] |= UINT64CONST(1) << (bit % 64);
+	}
+}
+
+static bool
+bloom_filter_contains(OBloomFilter *filter, uint64 hash)
+{
+	uint32		h1 = (uint32) hash,
+				h2 = (uint32) (hash >> 32) | 1;
+	int			i;
+
+	for (i = 0; i < BLOOM_FILTER_HASHES; i++)
+	{
+		uint32		bit = (h1 + i * h2) % BLOOM_FILTER_BITS;
+
+		if (!(filter->words[bit / 64] & (UINT64CONST(1) << (bit % 64))))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Builds the filter for the locked page being evicted.  Returns false when
+ * the filter can't be built or wouldn't be useful.
+ */
+bool
+bloom_filter_build(BTreeDescr *desc, Page p, OBloomFilter *filter)
+{
+	BTreePageHeader *header = (BTreePageHeader *) p;
+	BTreePageItemLocator loc;
+
+	if (bloom_filter_size <= 0 || desc->type != oIndexPrimary)
+		return false;
+
+	memset(filter, 0, sizeof(OBloomFilter));
+
+	if (O_PAGE_IS(p, LEAF))
+	{
+		if (UndoLocationIsValid(header->undoLocation) &&
+			UNDO_REC_EXISTS(desc->undoType, header->undoLocation))
+			return false;
+
+		BTREE_PAGE_FOREACH_ITEMS(p, &loc)
+		{
+			OTuple		tuple;
+			uint64		hash;
+
+			BTREE_PAGE_READ_LEAF_TUPLE(tuple, p, &loc);
+			if (!bloom_filter_key_hash(desc, &tuple, BTreeKeyLeafTuple, &hash))
+				return false;
+			bloom_filter_add(filter, hash);
+		}
+	}
+	else
+	{
+		BTREE_PAGE_FOREACH_ITEMS(p, &loc)
+		{
+			BTreeNonLeafTuphdr *tuphdr;
+			OBloomFilter child;
+			int			i;
+
+			tuphdr = (BTreeNonLeafTuphdr *) BTREE_PAGE_LOCATOR_GET_ITEM(p, &loc);
+			if (!DOWNLINK_IS_ON_DISK(tuphdr->downlink) ||
+				!bloom_filter_read(desc, tuphdr->downlink, &child))
+				return false;
+
+			for (i = 0; i < lengthof(filter->words); i++)
+				filter->words[i] |= child.words[i];
+		}
+	}
+
+	return pg_popcount((char *) filter->words, sizeof(filter->words)) <=
+		BLOOM_FILTER_MAX_BITS_SET;
+}
+
+/*
+ * Remembers the filter for the new on-disk downlink.  NULL filter forgets
+ * the possibly stale filter for that downlink.  Must be called before the
+ * downlink becomes visible.
+ */
+void
+bloom_filter_remember(BTreeDescr *desc, uint64 downlink, OBloomFilter *filter)
+{
+	if (bloom_filter_size <= 0)
+		return;
+	bloom_filter_write(desc, downlink, filter);
+}
+
+/*
+ * Forgets the filter for the on-disk downlink, which is going to be loaded.
+ */
+void
+bloom_filter_forget(BTreeDescr *desc, uint64 downlink)
+{
+	if (bloom_filter_size <= 0)
+		return;
+	bloom_filter_write(desc, downlink, NULL);
+}
+
+/*
+ * Checks if the subtree under the on-disk downlink certainly doesn't contain
+ * the key with the given hash.
+ */
+bool
+bloom_filter_excludes(BTreeDescr *desc, uint64 downlink, uint64 hash)
+{
+	OBloomFilter filter;
+
+	if (bloom_filter_size <= 0)
+		return false;
+
+	if (!bloom_filter_read(desc, downlink, &filter))
+		return false;
+
+	return !bloom_filter_contains(&filter, hash);
+}
@@ -33,6 +33,8 @@
 #include "fmgr.h"
 #include "miscadmin.h"
 #include "utils/fmgrprotos.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
 #include "utils/numeric.h"
 
 LWLockPadded *unique_locks;
@@ -250,12 +252,70 @@ o_btree_check_size_of_tuple(int len, char *relation_name, bool index)
 						relation_name)));
 }
 
+/*
+ * Range of ctids reserved by the backend for the tree.
+ */
+typedef struct
+{
+	ORelOids	oids;			/* hash table key */
+	uint64		next;
+	uint64		end;
+} CtidCacheEntry;
+
+static HTAB *ctid_cache = NULL;
+
+/*
+ * Returns the next ctid number for the tree.  With orioledb.ctid_cache_size
+ * greater than one, the backend reserves a range of ctids at once and hands
+ * them out locally.  So, concurrent loaders neither contend on the shared
+ * counter nor insert to the same rightmost leaf.  Unused numbers of the range
+ * are lost like cached sequence values.
+ */
+static uint64
+btree_ctid_next(BTreeDescr *desc)
+{
+	BTreeMetaPage *metaPageBlkno = BTREE_GET_META(desc);
+	CtidCacheEntry *entry;
+	bool		found;
+
+	if (ctid_cache_size <= 1)
+		return pg_atomic_fetch_add_u64(&metaPageBlkno->ctid, 1);
+
+	if (!ctid_cache)
+	{
+		HASHCTL		ctl;
+
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(ORelOids);
+		ctl.entrysize = sizeof(CtidCacheEntry);
+		ctl.hcxt = TopMemoryContext;
+		ctid_cache = hash_create("orioledb ctid cache", 16, &ctl,
+								 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	entry = (CtidCacheEntry *) hash_search(ctid_cache, &desc->oids,
+										   HASH_ENTER, &found);
+
+	/*
+	 * The shared counter is below the end of our range only if the tree was
+	 * re-created with the same oids since we reserved it.
+	 */
+	if (!found || entry->next >= entry->end ||
+		pg_atomic_read_u64(&metaPageBlkno->ctid) < entry->end)
+	{
+		entry->next = pg_atomic_fetch_add_u64(&metaPageBlkno->ctid,
+											  ctid_cache_size);
+		entry->end = entry->next + ctid_cache_size;
+	}
+
+	return entry->next++;
+}
+
 ItemPointerData
 btree_ctid_get_and_inc(BTreeDescr *desc)
 {
-	BTreeMetaPage *metaPageBlkno = BTREE_GET_META(desc);
 	ItemPointerData result;
-	uint64		ctid = pg_atomic_fetch_add_u64(&metaPageBlkno->ctid, 1);
+	uint64		ctid = btree_ctid_next(desc);
 
 	Assert(ORootPageIsValid(desc) && OMetaPageIsValid(desc));
 	Assert(ctid / (MaxOffsetNumber - FirstOffsetNumber) < InvalidBlockNumber);
@@ -287,6 +347,71 @@ btree_ctid_update_if_needed(BTreeDescr *desc, ItemPointerData ctid)
 	} while (!pg_atomic_compare_exchange_u64(&metaPageBlkno->ctid, &old_ctid, new_ctid));
 }
 
+/*
+ * Marks the subtrees containing the given page as modified.  The checkpointer
+ * clears the mark of the page when it descends into it, and reuses the
+ * previous image of the subtree, which root is neither dirty nor marked.  If
+ * the chain of parents is broken, then the whole tree is marked.
+ *
+ * Should be called after marking the page itself dirty.  The parent of a page
+ * might change concurrently.  But the new parent is either a new page or a
+ * dirty page, so it's not skipped until the checkpointer descends into it and
+ * sees the marks of the children.
+ */
+void
+btree_mark_subtree_dirty(BTreeDescr *desc, OInMemoryBlkno blkno)
+{
+	OInMemoryBlkno rootBlkno = desc->rootInfo.rootPageBlkno;
+	int			i;
+
+	/*
+	 * Order the page dirty flag before reading the marks.  Pairs with the
+	 * barrier in checkpoint_try_skip_subtree().
+	 */
+	pg_memory_barrier();
+
+	for (i = 0; i < ORIOLEDB_MAX_DEPTH && blkno != rootBlkno; i++)
+	{
+		OrioleDBPageDesc *parentDesc;
+
+		blkno = O_GET_IN_MEMORY_PAGEDESC(blkno)->parentBlkno;
+		if (!OInMemoryBlknoIsValid(blkno))
+			break;
+
+		parentDesc = O_GET_IN_MEMORY_PAGEDESC(blkno);
+		if (!ORelOidsIsEqual(parentDesc->oids, desc->oids))
+			break;
+
+		/* The mark is cleared only when the checkpointer descends */
+		if (pg_atomic_read_u32(&parentDesc->subtreeDirty) == 0)
+			pg_atomic_fetch_or_u32(&parentDesc->subtreeDirty, 1);
+	}
+
+	if (blkno != rootBlkno)
+		pg_atomic_fetch_or_u32(&BTREE_GET_META(desc)->subtreeDirtyUnknown, 1);
+}
+
+/*
+ * Sets the given internal page as the parent of its in-memory children.
+ * Should be called under the page lock after moving downlinks to the page.
+ */
+void
+btree_page_adopt_children(OInMemoryBlkno blkno)
+{
+	Page		p = O_GET_IN_MEMORY_PAGE(blkno);
+	BTreePageItemLocator loc;
+
+	Assert(!O_PAGE_IS(p, LEAF));
+
+	BTREE_PAGE_FOREACH_ITEMS(p, &loc)
+	{
+		BTreeNonLeafTuphdr *tuphdr = (BTreeNonLeafTuphdr *) BTREE_PAGE_LOCATOR_GET_ITEM(p, &loc);
+
+		if (DOWNLINK_IS_IN_MEMORY(tuphdr->downlink))
+			O_GET_IN_MEMORY_PAGEDESC(DOWNLINK_GET_IN_MEMORY_BLKNO(tuphdr->downlink))->parentBlkno = blkno;
+	}
+}
+
 static inline OIndexDescr *
 o_get_tree_def(BTreeDescr *desc)
 {
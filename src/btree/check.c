@@ -55,6 +55,8 @@ typedef struct
 static int	file_extent_cmp(const void *p1, const void *p2);
 static void check_walk_btree(BTreeCheckStatus *status, OInMemoryBlkno blkno,
 							 OInMemoryBlkno parentPagenum);
+static void check_prefetch_children(BTreeDescr *desc, Page p);
+static int	downlink_disk_off_cmp(const void *p1, const void *p2);
 static void add_extent(ExtentsArray *arr, FileExtent extent);
 static bool check_extents(ExtentsArray *busy, ExtentsArray *free);
 static void get_free_extents(BTreeDescr *desc, ExtentsArray *free_extents,
@@ -515,6 +517,49 @@ add_extent(ExtentsArray *arr, FileExtent extent)
 	arr->blocksCount += extent.len;
 }
 
+static int
+downlink_disk_off_cmp(const void *p1, const void *p2)
+{
+	uint64		off1 = DOWNLINK_GET_DISK_OFF(*((const uint64 *) p1));
+	uint64		off2 = DOWNLINK_GET_DISK_OFF(*((const uint64 *) p2));
+
+	if (off1 != off2)
+		return off1 < off2 ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Hints the reads of all the on-disk children of the internal page in the
+ * order of their file offsets.  The walk loads the children one by one, so
+ * that turns its random reads into mostly sequential ones.
+ */
+static void
+check_prefetch_children(BTreeDescr *desc, Page p)
+{
+	BTreePageItemLocator loc;
+	uint64	   *downlinks;
+	int			count = 0,
+				i;
+
+	if (desc->storageType != BTreeStoragePersistence)
+		return;
+
+	downlinks = (uint64 *) palloc(sizeof(uint64) * BTREE_PAGE_ITEMS_COUNT(p));
+	BTREE_PAGE_FOREACH_ITEMS(p, &loc)
+	{
+		BTreeNonLeafTuphdr *tuphdr = (BTreeNonLeafTuphdr *) BTREE_PAGE_LOCATOR_GET_ITEM(p, &loc);
+
+		if (DOWNLINK_IS_ON_DISK(tuphdr->downlink))
+			downlinks[count++] = tuphdr->downlink;
+	}
+
+	if (count > 1)
+		qsort(downlinks, count, sizeof(uint64), downlink_disk_off_cmp);
+	for (i = 0; i < count; i++)
+		prefetch_page_from_disk(desc, downlinks[i]);
+	pfree(downlinks);
+}
+
 static void
 check_walk_btree(BTreeCheckStatus *status, OInMemoryBlkno blkno,
 				 OInMemoryBlkno parentPagenum)
@@ -544,6 +589,8 @@ check_walk_btree(BTreeCheckStatus *status, OInMemoryBlkno blkno,
 	{
 		BTreePageItemLocator loc;
 
+		check_prefetch_children(status->desc, p);
+
 		BTREE_PAGE_LOCATOR_FIRST(p, &loc);
 		while (BTREE_PAGE_LOCATOR_IS_VALID(p, &loc))
 		{
@@ -602,6 +649,8 @@ btree_check_compression_recursive(BTreeDescr *desc, BTreeCompressStats *stats, O
 	{
 		BTreePageItemLocator loc;
 
+		check_prefetch_children(desc, p);
+
 		BTREE_PAGE_LOCATOR_FIRST(p, &loc);
 		while (BTREE_PAGE_LOCATOR_IS_VALID(p, &loc))
 		{
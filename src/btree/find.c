@@ -14,10 +14,12 @@
 
 #include "orioledb.h"
 
+#include "btree/bloom.h"
 #include "btree/find.h"
 #include "btree/insert.h"
 #include "btree/io.h"
 #include "btree/page_chunks.h"
+#include "btree/page_state.h"
 #include "tableam/descr.h"
 #include "utils/stopevent.h"
 
@@ -134,6 +136,8 @@ find_page(OBTreeFindPageContext *context, void *key, BTreeKeyType keyType,
 	context->partial.isPartial = false;
 	context->index = 0;
 
+	EA_DESCENT_INC(desc);
+
 	/* starts from the rootPageBlkno */
 	intCxt.blkno = desc->rootInfo.rootPageBlkno;
 	intCxt.pageChangeCount = desc->rootInfo.rootPageChangeCount;
@@ -482,6 +486,20 @@ find_page(OBTreeFindPageContext *context, void *key, BTreeKeyType keyType,
 		}
 		else if (DOWNLINK_IS_ON_DISK(noneLeafHdr->downlink))
 		{
+			/*
+			 * Don't load the evicted subtree, which certainly doesn't contain
+			 * the key.
+			 */
+			if (BTREE_PAGE_FIND_IS(context, SKIP_ABSENT) &&
+				bloom_filter_excludes(desc, noneLeafHdr->downlink,
+									  context->keyHash))
+			{
+				if (intCxt.haveLock)
+					unlock_page(intCxt.blkno);
+				BTREE_PAGE_FIND_SET(context, KEY_ABSENT);
+				return false;
+			}
+
 			if (tryFlag)
 			{
 				/*
@@ -916,6 +934,80 @@ find_right_page(OBTreeFindPageContext *context, OFixedKey *hikey)
 	return true;
 }
 
+/*
+ * Re-finds the leaf page for the given key in the image context previously
+ * positioned by find_page().  If the key belongs to the current leaf, only
+ * this leaf is re-read.  Parent items are kept as is, find_right_page()
+ * checks them anyway.  Otherwise, we fall back to the descent from the root.
+ *
+ * The current leaf fits the key if the key is greater than its first tuple
+ * and less than its hikey.  Both are taken from the up to date image of the
+ * page.  The first tuple can't be less than the lokey,
+ * which can't change without the change of the page change count.
+ */
+bool
+find_page_from_leaf(OBTreeFindPageContext *context, void *key,
+					BTreeKeyType keyType)
+{
+	BTreeDescr *desc = context->desc;
+	OBtreePageFindItem *item = &context->items[context->index];
+	BTreePageItemLocator loc;
+	Page		img = context->img;
+	OFixedKey	hikey;
+	OTuple		tuple;
+
+	Assert(BTREE_PAGE_FIND_IS(context, IMAGE));
+	Assert(!BTREE_PAGE_FIND_IS(context, MODIFY));
+	Assert(!BTREE_PAGE_FIND_IS(context, KEEP_LOKEY));
+	Assert(key != NULL);
+
+	/*
+	 * Keep the page traversal predictable for the stopevent-based tests.
+	 * Images from undo might have the key range different from the current
+	 * page, so leave them to the full descent.
+	 */
+	if (STOPEVENTS_ENABLED() || context->index == 0 ||
+		!O_PAGE_IS(img, LEAF) || UndoLocationIsValid(context->imgUndoLoc))
+		return find_page(context, key, keyType, 0);
+
+	BTREE_PAGE_LOCATOR_FIRST(img, &loc);
+	(void) page_locator_find_real_item(img, NULL, &loc);
+	if (!BTREE_PAGE_LOCATOR_IS_VALID(img, &loc))
+		return find_page(context, key, keyType, 0);
+	BTREE_PAGE_READ_LEAF_TUPLE(tuple, img, &loc);
+	if (o_btree_cmp(desc, key, keyType, &tuple, BTreeKeyLeafTuple) <= 0)
+		return find_page(context, key, keyType, 0);
+
+	if (!O_PAGE_IS(img, RIGHTMOST))
+	{
+		copy_fixed_hikey(desc, &hikey, img);
+		if (o_btree_cmp(desc, key, keyType, &hikey.tuple,
+						BTreeKeyNonLeafKey) >= 0)
+			return find_page(context, key, keyType, 0);
+	}
+
+	if (!btree_find_read_page(context, item->blkno, item->pageChangeCount,
+							  img, key, keyType, NULL) ||
+		UndoLocationIsValid(context->imgUndoLoc) ||
+		PAGE_GET_LEVEL(img) != 0 ||
+		O_PAGE_GET_CHANGE_COUNT(img) != item->pageChangeCount)
+		return find_page(context, key, keyType, 0);
+
+	/* The page might be split concurrently */
+	if (!O_PAGE_IS(img, RIGHTMOST))
+	{
+		copy_fixed_hikey(desc, &hikey, img);
+		if (o_btree_cmp(desc, key, keyType, &hikey.tuple,
+						BTreeKeyNonLeafKey) >= 0)
+			return find_page(context, key, keyType, 0);
+	}
+
+	(void) btree_page_search(desc, img, key, keyType, NULL, &loc);
+	(void) page_locator_find_real_item(img, NULL, &loc);
+	item->locator = loc;
+	return true;
+}
+
 /*
  * Find the left sibling of the current page.
  *
@@ -1224,6 +1316,9 @@ btree_page_search(BTreeDescr *desc, Page p, Pointer key, BTreeKeyType keyType,
 	BTreeKeyType midkind;
 	int			targetCmpVal,
 				result;
+	OKeyImage	keyImage,
+				midImage;
+	bool		useImage;
 
 	if (keyType == BTreeKeyPageHiKey && isLeaf)
 	{
@@ -1277,6 +1372,8 @@ btree_page_search(BTreeDescr *desc, Page p, Pointer key, BTreeKeyType keyType,
 	if (keyType == BTreeKeyPageHiKey)
 		keyType = BTreeKeyNonLeafKey;
 
+	useImage = o_btree_key_image(desc, key, keyType, &keyImage);
+
 	while (high > low)
 	{
 		mid = low + ((high - low) / 2);
@@ -1289,7 +1386,12 @@ btree_page_search(BTreeDescr *desc, Page p, Pointer key, BTreeKeyType keyType,
 
 			locator->itemOffset = mid;
 			BTREE_PAGE_READ_TUPLE(midTup, p, locator);
-			result = cmpFunc(desc, key, keyType, &midTup, midkind);
+			result = 0;
+			if (useImage &&
+				o_btree_key_image(desc, &midTup, midkind, &midImage))
+				result = o_key_image_cmp(&keyImage, &midImage);
+			if (result == 0)
+				result = cmpFunc(desc, key, keyType, &midTup, midkind);
 		}
 
 		if (result >= targetCmpVal)
@@ -1315,7 +1417,10 @@ btree_page_binary_search_chunks(BTreeDescr *desc, Page p,
 				high;
 	int			targetCmpVal,
 				result;
-	bool		nextkey;
+	bool		nextkey,
+				useImage;
+	OKeyImage	keyImage,
+				midImage;
 	BTreePageHeader *header = (BTreePageHeader *) p;
 	OBTreeKeyCmp cmpFunc = desc->ops->cmp;
 
@@ -1337,6 +1442,8 @@ btree_page_binary_search_chunks(BTreeDescr *desc, Page p,
 	if (keyType == BTreeKeyPageHiKey)
 		keyType = BTreeKeyNonLeafKey;
 
+	useImage = o_btree_key_image(desc, key, keyType, &keyImage);
+
 	while (high > low)
 	{
 		OTuple		midTup;
@@ -1348,7 +1455,17 @@ btree_page_binary_search_chunks(BTreeDescr *desc, Page p,
 
 		midTup.formatFlags = header->chunkDesc[mid].hikeyFlags;
 		midTup.data = p + SHORT_GET_LOCATION(header->chunkDesc[mid].hikeyShortLocation);
-		result = cmpFunc(desc, key, keyType, &midTup, BTreeKeyNonLeafKey);
+
+		/*
+		 * Different normalized images of the leading key columns define the
+		 * result without calling the comparator.
+		 */
+		result = 0;
+		if (useImage &&
+			o_btree_key_image(desc, &midTup, BTreeKeyNonLeafKey, &midImage))
+			result = o_key_image_cmp(&keyImage, &midImage);
+		if (result == 0)
+			result = cmpFunc(desc, key, keyType, &midTup, BTreeKeyNonLeafKey);
 
 		if (result >= targetCmpVal)
 			low = mid + 1;
@@ -1358,3 +1475,202 @@ btree_page_binary_search_chunks(BTreeDescr *desc, Page p,
 
 	return low;
 }
+
+/*
+ * Per-backend "finger" caches: the leaf pages where the previous lookup and
+ * the previous modification in the tree have landed.  Lookups and
+ * modifications of nearby keys (nested loops, IN-lists, sorted batches,
+ * ascending inserts to the rightmost leaf) try to use them before descending
+ * from the root.
+ *
+ * Besides the page location we keep the page hikey and the key of some tuple
+ * found on the page (lowKey).  The page lokey can't change without the change
+ * of the page change count, thus, any key within [lowKey, hikey) belongs to
+ * the page as long as the change count is the same.  Concurrent splits are
+ * handled by refind_page() following the rightlink, other concurrent page
+ * changes make refind_page() fall back to the full descent.
+ */
+typedef struct
+{
+	bool		valid;
+	ORelOids	oids;
+	OIndexType	type;
+	BTreeLocationHint hint;
+	bool		rightmost;
+	OFixedKey	lowKey;
+	OFixedKey	hikey;
+} BTreeFinger;
+
+#define BTREE_FINGERS_COUNT (16)
+
+static BTreeFinger fetchFingers[BTREE_FINGERS_COUNT];
+static BTreeFinger modifyFingers[BTREE_FINGERS_COUNT];
+
+static inline BTreeFinger *
+btree_get_finger(OBTreeFindPageContext *context)
+{
+	BTreeDescr *desc = context->desc;
+	uint32		hash = desc->oids.datoid ^ desc->oids.reloid ^ desc->oids.relnode;
+
+	Assert(BTREE_PAGE_FIND_IS(context, FETCH) ||
+		   BTREE_PAGE_FIND_IS(context, MODIFY));
+
+	if (BTREE_PAGE_FIND_IS(context, MODIFY))
+		return &modifyFingers[hash % BTREE_FINGERS_COUNT];
+	else
+		return &fetchFingers[hash % BTREE_FINGERS_COUNT];
+}
+
+/*
+ * Tries to find the leaf page for the given key using the finger cache.
+ * Returns false if the cached page doesn't fit the key.  Context must be
+ * initialized for either fetch or modification.
+ */
+bool
+btree_finger_find_page(OBTreeFindPageContext *context, void *key,
+					   BTreeKeyType keyType)
+{
+	BTreeDescr *desc = context->desc;
+	BTreeFinger *finger = btree_get_finger(context);
+	int			cmp;
+
+	/* Keep the page traversal predictable for the stopevent-based tests */
+	if (STOPEVENTS_ENABLED())
+		return false;
+
+	if (!finger->valid ||
+		!ORelOidsIsEqual(finger->oids, desc->oids) ||
+		finger->type != desc->type)
+		return false;
+
+	if (keyType != BTreeKeyBound && keyType != BTreeKeyLeafTuple &&
+		keyType != BTreeKeyNonLeafKey)
+		return false;
+
+	/*
+	 * Bound may match multiple tuples.  Equal to lowKey doesn't guarantee the
+	 * first match is not on the left page.
+	 */
+	cmp = o_btree_cmp(desc, key, keyType, &finger->lowKey.tuple,
+					  BTreeKeyNonLeafKey);
+	if (cmp < 0 || (cmp == 0 && keyType == BTreeKeyBound))
+		return false;
+
+	if (!finger->rightmost &&
+		o_btree_cmp(desc, key, keyType, &finger->hikey.tuple,
+					BTreeKeyNonLeafKey) >= 0)
+		return false;
+
+	return refind_page(context, key, keyType, 0, finger->hint.blkno,
+					   finger->hint.pageChangeCount);
+}
+
+/*
+ * Remembers the leaf page found by the context in the finger cache.  For
+ * fetch we use the context image and the found tuple as lowKey.  For
+ * modification, the page is locked and we use its first tuple as lowKey.
+ */
+void
+btree_finger_remember(OBTreeFindPageContext *context)
+{
+	BTreeDescr *desc = context->desc;
+	BTreeFinger *finger = btree_get_finger(context);
+	OBtreePageFindItem *item = &context->items[context->index];
+	BTreePageItemLocator loc;
+	Page		p;
+	OTuple		tuple;
+	bool		allocated;
+
+	if (finger->valid &&
+		finger->hint.blkno == item->blkno &&
+		finger->hint.pageChangeCount == item->pageChangeCount &&
+		ORelOidsIsEqual(finger->oids, desc->oids) &&
+		finger->type == desc->type)
+		return;
+
+	if (BTREE_PAGE_FIND_IS(context, MODIFY))
+	{
+		p = O_GET_IN_MEMORY_PAGE(item->blkno);
+		Assert(page_is_locked(item->blkno));
+		BTREE_PAGE_LOCATOR_FIRST(p, &loc);
+		(void) page_locator_find_real_item(p, NULL, &loc);
+	}
+	else
+	{
+		p = context->img;
+		loc = item->locator;
+	}
+
+	if (!O_PAGE_IS(p, LEAF) || !BTREE_PAGE_LOCATOR_IS_VALID(p, &loc))
+		return;
+
+	finger->valid = false;
+
+	BTREE_PAGE_READ_LEAF_TUPLE(tuple, p, &loc);
+	finger->lowKey.tuple = o_btree_tuple_make_key(desc, tuple,
+												  finger->lowKey.fixedData,
+												  false, &allocated);
+	Assert(!allocated);
+
+	finger->rightmost = O_PAGE_IS(p, RIGHTMOST);
+	if (!finger->rightmost)
+		copy_fixed_hikey(desc, &finger->hikey, p);
+
+	finger->oids = desc->oids;
+	finger->type = desc->type;
+	finger->hint.blkno = item->blkno;
+	finger->hint.pageChangeCount = item->pageChangeCount;
+	finger->valid = true;
+}
+
+/*
+ * Hints the kernel to read the evicted page on the path to the leaf, which
+ * contains the given key.  The descent only reads the images of the internal
+ * pages.  It neither locks nor loads any page, and it silently gives up on
+ * concurrent changes.  It's used by the recovery to issue reads of the pages,
+ * which are going to be modified by the recovery workers soon.
+ */
+void
+btree_prefetch_key(BTreeDescr *desc, Pointer key, BTreeKeyType keyType)
+{
+	char		img[ORIOLEDB_BLCKSZ];
+	OInMemoryBlkno blkno;
+	uint32		pageChangeCount;
+	BTreePageItemLocator loc;
+	BTreeNonLeafTuphdr *tuphdr;
+
+	o_btree_load_shmem(desc);
+
+	blkno = desc->rootInfo.rootPageBlkno;
+	pageChangeCount = desc->rootInfo.rootPageChangeCount;
+
+	while (true)
+	{
+		if (!o_btree_read_page(desc, blkno, pageChangeCount, img,
+							   COMMITSEQNO_INPROGRESS, NULL, BTreeKeyNone,
+							   NULL, NULL, NULL, NULL))
+			return;
+
+		if (O_PAGE_IS(img, LEAF))
+			return;
+
+		(void) btree_page_search(desc, img, key, keyType, NULL, &loc);
+		BTREE_PAGE_LOCATOR_PREV(img, &loc);
+		if (!BTREE_PAGE_LOCATOR_IS_VALID(img, &loc))
+			return;
+
+		tuphdr = (BTreeNonLeafTuphdr *) BTREE_PAGE_LOCATOR_GET_ITEM(img, &loc);
+		if (DOWNLINK_IS_ON_DISK(tuphdr->downlink))
+		{
+			prefetch_page_from_disk(desc, tuphdr->downlink);
+			return;
+		}
+		else if (DOWNLINK_IS_IN_IO(tuphdr->downlink))
+		{
+			return;
+		}
+
+		blkno = DOWNLINK_GET_IN_MEMORY_BLKNO(tuphdr->downlink);
+		pageChangeCount = DOWNLINK_GET_IN_MEMORY_CHANGECOUNT(tuphdr->downlink);
+	}
+}
@@ -223,6 +223,10 @@ o_btree_finish_root_split_internal(BTreeDescr *desc,
 	ptr = BTREE_PAGE_LOCATOR_GET_ITEM(p, &loc);
 	memcpy(ptr, &internal_header, BTreeNonLeafTuphdrSize);
 
+	btree_page_adopt_children(desc->rootInfo.rootPageBlkno);
+	if (!is_leaf)
+		btree_page_adopt_children(left_blkno);
+
 	MARK_DIRTY(desc, left_blkno);
 	MARK_DIRTY(desc, desc->rootInfo.rootPageBlkno);
 
@@ -508,7 +512,7 @@ o_btree_insert_item(BTreeInsertStackItem *insert_item, int reserve_kind)
 			 * We change a node that is under checkpoint and must mark it as
 			 * autonomous.
 			 */
-			backend_set_autonomous_level(checkpoint_state, insert_item->level);
+			backend_set_autonomous_level(desc, insert_item->level);
 		}
 
 		if (fit != BTreeItemPageFitSplitRequired)
@@ -608,6 +612,14 @@ o_btree_insert_item(BTreeInsertStackItem *insert_item, int reserve_kind)
 			memcpy(ptr, insert_item->tuple.data, insert_item->tuplen);
 			BTREE_PAGE_SET_ITEM_FLAGS(p, &loc, insert_item->tuple.formatFlags);
 
+			if (insert_item->level > 0)
+			{
+				uint64		downlink = ((BTreeNonLeafTuphdr *) insert_item->tupheader)->downlink;
+
+				if (DOWNLINK_IS_IN_MEMORY(downlink))
+					O_GET_IN_MEMORY_PAGEDESC(DOWNLINK_GET_IN_MEMORY_BLKNO(downlink))->parentBlkno = blkno;
+			}
+
 			if (insert_item->left_blkno != OInvalidInMemoryBlkno)
 			{
 				btree_split_mark_finished(insert_item->left_blkno, true, true);
@@ -615,6 +627,8 @@ o_btree_insert_item(BTreeInsertStackItem *insert_item, int reserve_kind)
 				insert_item->left_blkno = OInvalidInMemoryBlkno;
 			}
 
+			if (O_PAGE_IS(p, LEAF))
+				page_count_write(blkno);
 			page_split_chunk_if_needed(desc, p, &loc);
 
 			MARK_DIRTY(desc, blkno);
@@ -677,8 +691,7 @@ o_btree_insert_item(BTreeInsertStackItem *insert_item, int reserve_kind)
 			 * Move hikeyBlkno of split.  This change is atomic, no need to
 			 * bother about change count.
 			 */
-			if (checkpoint_state->stack[insert_item->level].hikeyBlkno == blkno)
-				checkpoint_state->stack[insert_item->level].hikeyBlkno = right_blkno;
+			checkpoint_move_hikey_blkno(insert_item->level, blkno, right_blkno);
 
 			perform_page_split(desc, blkno, right_blkno,
 							   left_count, split_key, split_key_len,
@@ -20,7 +20,9 @@
 
 #include "orioledb.h"
 
+#include "btree/bloom.h"
 #include "btree/io.h"
+#include "btree/io_stats.h"
 #include "btree/find.h"
 #include "btree/merge.h"
 #include "btree/page_chunks.h"
@@ -34,6 +36,8 @@
 #include "tableam/handler.h"
 #include "utils/compress.h"
 #include "utils/elog.h"
+#include "utils/latency.h"
+#include "utils/o_wait_events.h"
 #include "utils/page_pool.h"
 #include "utils/seq_buf.h"
 #include "utils/stopevent.h"
@@ -42,18 +46,67 @@
 
 #include "access/transam.h"
 #include "access/relation.h"
+#include "funcapi.h"
+#include "miscadmin.h"
 #include "pgstat.h"
+#include "portability/instr_time.h"
 #include "storage/bufmgr.h"
+#include "utils/builtins.h"
 #include "utils/memutils.h"
 #include "utils/syscache.h"
+#include "utils/tuplestore.h"
+#include "utils/varlena.h"
+
+/*
+ * Page read latency is kept as moving average in microseconds multiplied by
+ * READ_LATENCY_SCALE.  Each new sample has READ_LATENCY_WEIGHT share.
+ */
+#define READ_LATENCY_SCALE		(16)
+#define READ_LATENCY_WEIGHT		(8)
+/* The average is considered outdated after a second without reads */
+#define READ_LATENCY_OUTDATED_US (1000000)
+
+/*
+ * The background I/O yields to the queued foreground reads for at most
+ * IO_PRIORITY_MAX_DELAY_US, then proceeds anyway to not stall checkpoints
+ * and evictions forever.
+ */
+#define IO_PRIORITY_SLEEP_US		(100)
+#define IO_PRIORITY_MAX_DELAY_US	(10000)
+
+/*
+ * Each I/O class has its own queue of tickets.  An I/O takes the next ticket
+ * number in 'started' and waits until no more than the class budget of the
+ * previous tickets are unfinished.
+ */
+typedef struct
+{
+	pg_atomic_uint64 started;
+	pg_atomic_uint64 finished;
+	/* statistics, see orioledb_io_stats() */
+	pg_atomic_uint64 ops;
+	pg_atomic_uint64 waitTime;
+	pg_atomic_uint64 ioTime;
+} IOClassState;
 
 typedef struct
 {
-	pg_atomic_uint64 writesStarted;
-	pg_atomic_uint64 writesFinished;
+	IOClassState classes[OIOClassesCount];
+	/* moving average of the page read latency, see page_read_latency() */
+	pg_atomic_uint64 readLatency;
+	pg_atomic_uint64 readLatencyTime;
+	/* max_procs condition variables for each I/O class */
 	ConditionVariable cv[FLEXIBLE_ARRAY_MEMBER];
 } IOShmem;
 
+static const char *const io_class_names[OIOClassesCount] =
+{
+	"foreground read",
+	"eviction write",
+	"checkpoint",
+	"s3"
+};
+
 typedef struct TreeOffset
 {
 	Oid			datoid;
@@ -79,6 +132,9 @@ static LWLockPadded *io_locks;
 static IOShmem *ioShmem = NULL;
 static int	num_io_lwlocks;
 static bool io_in_progress = false;
+static OIOClass io_in_progress_class;
+static instr_time io_in_progress_start;
+static OIOClass io_process_class = OIOClassesCount;
 
 static bool prepare_non_leaf_page(Page p);
 static uint64 get_free_disk_offset(BTreeDescr *desc);
@@ -89,7 +145,8 @@ static bool get_free_disk_extent_copy_blkno(BTreeDescr *desc, off_t page_size,
 
 static bool write_page_to_disk(BTreeDescr *desc, FileExtent *extent,
 							   uint32 curChkpNum,
-							   Pointer page, off_t page_size);
+							   Pointer page, off_t page_size,
+							   uint16 dictId);
 static void write_page(OBTreeFindPageContext *context,
 					   OInMemoryBlkno blkno, Page img,
 					   uint32 checkpoint_number,
@@ -98,15 +155,18 @@ static int	tree_offsets_cmp(const void *a, const void *b);
 static void writeback_put_extent(IOWriteBack *writeback, BTreeDescr *desc,
 								 uint64 downlink);
 static void perform_writeback(IOWriteBack *writeback);
+static OWalkPageResult walk_page_internal(OInMemoryBlkno blkno, bool evict);
 
 PG_FUNCTION_INFO_V1(orioledb_evict_pages);
 PG_FUNCTION_INFO_V1(orioledb_write_pages);
+PG_FUNCTION_INFO_V1(orioledb_io_stats);
+PG_FUNCTION_INFO_V1(orioledb_io_stats_reset);
 
 Size
 btree_io_shmem_needs(void)
 {
 	return CACHELINEALIGN(offsetof(IOShmem, cv) +
-						  sizeof(ConditionVariable) * max_procs);
+						  sizeof(ConditionVariable) * max_procs * OIOClassesCount);
 }
 
 void
@@ -119,45 +179,177 @@ btree_io_shmem_init(Pointer buf, bool found)
 	{
 		int			i;
 
-		pg_atomic_init_u64(&ioShmem->writesStarted, 0);
-		pg_atomic_init_u64(&ioShmem->writesFinished, 0);
+		for (i = 0; i < OIOClassesCount; i++)
+		{
+			IOClassState *state = &ioShmem->classes[i];
+
+			pg_atomic_init_u64(&state->started, 0);
+			pg_atomic_init_u64(&state->finished, 0);
+			pg_atomic_init_u64(&state->ops, 0);
+			pg_atomic_init_u64(&state->waitTime, 0);
+			pg_atomic_init_u64(&state->ioTime, 0);
+		}
+		pg_atomic_init_u64(&ioShmem->readLatency, 0);
+		pg_atomic_init_u64(&ioShmem->readLatencyTime, 0);
 
-		for (i = 0; i < max_procs; i++)
+		for (i = 0; i < max_procs * OIOClassesCount; i++)
 			ConditionVariableInit(&ioShmem->cv[i]);
 	}
 }
 
+/*
+ * Accounts the page read latency.  Concurrent updates might be lost, that's
+ * OK for the moving average.
+ */
 static void
-io_start(void)
+account_page_read(instr_time *start)
 {
+	instr_time	end,
+				duration;
+	uint64		latency,
+				sample;
+
+	INSTR_TIME_SET_CURRENT(end);
+	duration = end;
+	INSTR_TIME_SUBTRACT(duration, *start);
+
+	sample = INSTR_TIME_GET_MICROSEC(duration) * READ_LATENCY_SCALE;
+	latency = pg_atomic_read_u64(&ioShmem->readLatency);
+	latency = latency - latency / READ_LATENCY_WEIGHT + sample / READ_LATENCY_WEIGHT;
+	pg_atomic_write_u64(&ioShmem->readLatency, latency);
+	pg_atomic_write_u64(&ioShmem->readLatencyTime, INSTR_TIME_GET_MICROSEC(end));
+}
+
+/*
+ * Returns the recent average latency of the page reads by the backends in
+ * microseconds.  Returns zero if there were no page reads recently.
+ */
+double
+page_read_latency(void)
+{
+	instr_time	now;
+	uint64		updated = pg_atomic_read_u64(&ioShmem->readLatencyTime);
+
+	INSTR_TIME_SET_CURRENT(now);
+	if (updated == 0 || INSTR_TIME_GET_MICROSEC(now) > updated + READ_LATENCY_OUTDATED_US)
+		return 0.0;
+
+	return (double) pg_atomic_read_u64(&ioShmem->readLatency) / READ_LATENCY_SCALE;
+}
+
+/*
+ * Sets the I/O class for all the I/O of the current process.  Background
+ * workers call it at startup.
+ */
+void
+set_io_class(OIOClass ioClass)
+{
+	io_process_class = ioClass;
+}
+
+static OIOClass
+get_io_class(bool write)
+{
+	if (io_process_class != OIOClassesCount)
+		return io_process_class;
+	if (MyBackendType == B_CHECKPOINTER)
+		return OIOClassCheckpoint;
+	return write ? OIOClassEvictionWrite : OIOClassForegroundRead;
+}
+
+/*
+ * Returns the concurrency budget of the I/O class.  Zero means unlimited.
+ */
+static int
+io_class_concurrency(OIOClass ioClass)
+{
+	if (max_io_concurrency == 0 || ioClass == OIOClassForegroundRead)
+		return max_io_concurrency;
+	if (background_io_concurrency > 0)
+		return background_io_concurrency;
+	return Max(max_io_concurrency / 2, 1);
+}
+
+static inline ConditionVariable *
+io_class_cv(OIOClass ioClass, uint64 ticket)
+{
+	return &ioShmem->cv[ioClass * max_procs + ticket % max_procs];
+}
+
+/*
+ * Checks if there are foreground reads waiting for their budget.
+ */
+static bool
+foreground_reads_queued(void)
+{
+	IOClassState *state = &ioShmem->classes[OIOClassForegroundRead];
+	uint64		finished = pg_atomic_read_u64(&state->finished);
+
+	return pg_atomic_read_u64(&state->started) > finished + max_io_concurrency;
+}
+
+static void
+io_start(bool write)
+{
+	OIOClass	ioClass = get_io_class(write);
+	IOClassState *state = &ioShmem->classes[ioClass];
+	int			concurrency = io_class_concurrency(ioClass);
 	uint64		startNum;
 	bool		slept = false;
+	instr_time	waitStart,
+				waitTime;
 
-	if (max_io_concurrency == 0)
-		return;
-
-	startNum = pg_atomic_add_fetch_u64(&ioShmem->writesStarted, 1);
+	INSTR_TIME_SET_CURRENT(waitStart);
+	startNum = pg_atomic_add_fetch_u64(&state->started, 1);
 	io_in_progress = true;
-	while (startNum > pg_atomic_read_u64(&ioShmem->writesFinished) + max_io_concurrency)
+	io_in_progress_class = ioClass;
+
+	if (concurrency > 0)
 	{
-		ConditionVariableSleep(&ioShmem->cv[startNum % max_procs], WAIT_EVENT_PG_SLEEP);
-		slept = true;
+		while (startNum > pg_atomic_read_u64(&state->finished) + concurrency)
+		{
+			ConditionVariableSleep(io_class_cv(ioClass, startNum), WAIT_EVENT_PG_SLEEP);
+			slept = true;
+		}
+		if (slept)
+			ConditionVariableCancelSleep();
+
+		if (ioClass != OIOClassForegroundRead)
+		{
+			int			delay = 0;
+
+			while (delay < IO_PRIORITY_MAX_DELAY_US && foreground_reads_queued())
+			{
+				pg_usleep(IO_PRIORITY_SLEEP_US);
+				delay += IO_PRIORITY_SLEEP_US;
+			}
+		}
 	}
-	if (slept)
-		ConditionVariableCancelSleep();
+
+	INSTR_TIME_SET_CURRENT(io_in_progress_start);
+	waitTime = io_in_progress_start;
+	INSTR_TIME_SUBTRACT(waitTime, waitStart);
+	pg_atomic_fetch_add_u64(&state->waitTime, INSTR_TIME_GET_MICROSEC(waitTime));
 }
 
 static void
 io_finish(void)
 {
+	IOClassState *state = &ioShmem->classes[io_in_progress_class];
+	int			concurrency = io_class_concurrency(io_in_progress_class);
 	uint64		finishNum;
+	instr_time	duration;
 
-	if (max_io_concurrency == 0)
-		return;
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, io_in_progress_start);
+	pg_atomic_fetch_add_u64(&state->ioTime, INSTR_TIME_GET_MICROSEC(duration));
+	pg_atomic_fetch_add_u64(&state->ops, 1);
 
-	finishNum = pg_atomic_add_fetch_u64(&ioShmem->writesFinished, 1);
+	finishNum = pg_atomic_add_fetch_u64(&state->finished, 1);
 	io_in_progress = false;
-	ConditionVariableBroadcast(&ioShmem->cv[(finishNum + max_io_concurrency) % max_procs]);
+	if (concurrency > 0)
+		ConditionVariableBroadcast(io_class_cv(io_in_progress_class,
+											   finishNum + concurrency));
 }
 
 int
@@ -166,7 +358,7 @@ OFileRead(File file, char *buffer, int amount, off_t offset,
 {
 	int			result;
 
-	io_start();
+	io_start(false);
 	result = FileRead(file, buffer, amount, offset, wait_event_info);
 	io_finish();
 	return result;
@@ -178,12 +370,100 @@ OFileWrite(File file, char *buffer, int amount, off_t offset,
 {
 	int			result;
 
-	io_start();
+	io_start(true);
 	result = FileWrite(file, buffer, amount, offset, wait_event_info);
 	io_finish();
 	return result;
 }
 
+/*
+ * Page-sized buffer aligned for direct I/O.
+ */
+typedef union
+{
+#ifdef pg_attribute_aligned
+	pg_attribute_aligned(PG_IO_ALIGN_SIZE)
+#endif
+	char		data[ORIOLEDB_BLCKSZ];
+	double		force_align_d;
+	int64		force_align_i64;
+} OIOAlignedPage;
+
+static OIOAlignedPage direct_io_buf;
+
+/*
+ * Buffer to gather the compressed page image with its header.
+ */
+static union
+{
+	char		data[ORIOLEDB_BLCKSZ + ORIOLEDB_COMP_BLCKSZ];
+	double		force_align_d;
+	int64		force_align_i64;
+} compressed_write_buf;
+
+/*
+ * Checks if the data files of the tree are accessed with direct I/O.  Only
+ * uncompressed trees use direct I/O: their extents are page-sized and
+ * page-aligned, while compressed images have the separately written header
+ * and are aligned by ORIOLEDB_COMP_BLCKSZ only.
+ */
+static inline bool
+btree_use_direct_io(BTreeDescr *desc)
+{
+	return orioledb_direct_io && !OCompressIsValid(desc->compress) &&
+		!orioledb_s3_mode && !use_mmap && !use_device;
+}
+
+/*
+ * Reads or writes the data file of the tree.  With direct I/O, the images
+ * not aligned in memory are copied through the aligned buffer.
+ */
+static int
+btree_file_io(BTreeDescr *desc, File file, char *buffer, int amount,
+			  off_t offset, bool write)
+{
+	int			done = 0;
+
+	if (!btree_use_direct_io(desc) ||
+		(uintptr_t) buffer % PG_IO_ALIGN_SIZE == 0)
+	{
+		if (write)
+			return OFileWrite(file, buffer, amount, offset,
+							  WAIT_EVENT_DATA_FILE_WRITE);
+		return OFileRead(file, buffer, amount, offset,
+						 WAIT_EVENT_DATA_FILE_READ);
+	}
+
+	Assert(amount % PG_IO_ALIGN_SIZE == 0 && offset % PG_IO_ALIGN_SIZE == 0);
+
+	while (done < amount)
+	{
+		int			chunk = Min(amount - done, ORIOLEDB_BLCKSZ);
+		int			result;
+
+		if (write)
+		{
+			memcpy(direct_io_buf.data, buffer + done, chunk);
+			result = OFileWrite(file, direct_io_buf.data, chunk,
+								offset + done, WAIT_EVENT_DATA_FILE_WRITE);
+		}
+		else
+		{
+			result = OFileRead(file, direct_io_buf.data, chunk,
+							   offset + done, WAIT_EVENT_DATA_FILE_READ);
+			if (result > 0)
+				memcpy(buffer + done, direct_io_buf.data, result);
+		}
+
+		if (result <= 0)
+			return done > 0 ? done : result;
+		done += result;
+		if (result < chunk)
+			break;
+	}
+	return done;
+}
+
 typedef struct
 {
 	uint32		checkpointNumber;
@@ -256,6 +536,107 @@ btree_smgr_filename(BTreeDescr *desc, off_t offset, uint32 chkpNum)
 						  chkpNum);
 }
 
+/*
+ * Absolute paths listed in orioledb.data_stripe_directories.  Parsed once per
+ * process, striping is disabled in S3 and device modes.
+ */
+static List *stripeDirectories = NIL;
+static bool stripeDirectoriesParsed = false;
+
+List *
+btree_stripe_directories(void)
+{
+	MemoryContext mcxt;
+	ListCell   *lc;
+
+	if (stripeDirectoriesParsed)
+		return stripeDirectories;
+
+	if (!data_stripe_directories || data_stripe_directories[0] == '\0' ||
+		orioledb_s3_mode || use_device)
+	{
+		stripeDirectoriesParsed = true;
+		return NIL;
+	}
+
+	mcxt = MemoryContextSwitchTo(TopMemoryContext);
+	if (!SplitDirectoriesString(pstrdup(data_stripe_directories), ',',
+								&stripeDirectories))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("invalid list syntax in parameter \"orioledb.data_stripe_directories\"")));
+	MemoryContextSwitchTo(mcxt);
+
+	foreach(lc, stripeDirectories)
+	{
+		char	   *dirname = (char *) lfirst(lc);
+
+		if (!is_absolute_path(dirname))
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("stripe directory \"%s\" must be an absolute path",
+							dirname)));
+	}
+	stripeDirectoriesParsed = true;
+	return stripeDirectories;
+}
+
+/*
+ * Places a new data file segment to one of the stripe directories.
+ *
+ * Segments go round-robin over the data directory and the stripe
+ * directories.  The data directory always keeps a segment's name: the striped
+ * ones are symlinks there, so iterating, fsyncing and removing the tree
+ * files work as before.  The first segment is never striped, because
+ * recovery checks its presence.
+ */
+static void
+btree_stripe_segment(Oid datoid, Oid relnode, int segno,
+					 const char *filename)
+{
+	List	   *dirs = btree_stripe_directories();
+	struct stat st;
+	char	   *dirname,
+			   *target;
+	int			slot,
+				fd;
+
+	if (dirs == NIL || segno == 0)
+		return;
+
+	slot = (relnode + segno) % (list_length(dirs) + 1);
+	if (slot == 0 || lstat(filename, &st) == 0)
+		return;
+
+	dirname = psprintf("%s/%u", (char *) list_nth(dirs, slot - 1), datoid);
+	if (pg_mkdir_p(dirname, S_IRWXU) != 0 && errno != EEXIST)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not create directory \"%s\": %m", dirname)));
+
+	/* Create the target durably before it's linked */
+	target = psprintf("%s/%u.%u", dirname, relnode, segno);
+	fd = OpenTransientFile(target, O_RDWR | O_CREAT | PG_BINARY);
+	if (fd < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not create file \"%s\": %m", target)));
+	CloseTransientFile(fd);
+	fsync_fname(dirname, true);
+
+	if (symlink(target, filename) < 0 && errno != EEXIST)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not create symbolic link \"%s\": %m",
+						filename)));
+	pfree(dirname);
+	dirname = psprintf(ORIOLEDB_DATA_DIR "/%u", datoid);
+	fsync_fname(dirname, true);
+
+	pfree(dirname);
+	pfree(target);
+}
+
 static File
 btree_open_smgr_file(BTreeDescr *desc, uint32 num, uint32 chkpNum,
 					 uint32 loadId)
@@ -312,7 +693,11 @@ btree_open_smgr_file(BTreeDescr *desc, uint32 num, uint32 chkpNum,
 		filename = btree_smgr_filename(desc,
 									   (off_t) num * ORIOLEDB_SEGMENT_SIZE,
 									   chkpNum);
-		desc->smgr.array.files[num] = PathNameOpenFile(filename, O_RDWR | O_CREAT | PG_BINARY);
+		btree_stripe_segment(desc->oids.datoid, desc->oids.relnode, num,
+							 filename);
+		desc->smgr.array.files[num] = PathNameOpenFile(filename,
+													   O_RDWR | O_CREAT | PG_BINARY |
+													   (btree_use_direct_io(desc) ? PG_O_DIRECT : 0));
 
 		if (desc->smgr.array.files[num] <= 0)
 			ereport(FATAL,
@@ -578,9 +963,9 @@ btree_smgr_write(BTreeDescr *desc, char *buffer, uint32 chkpNum,
 		file = btree_open_smgr_file(desc, segno, chkpNum, loadId);
 		if ((curOffset + amount) / granularity == curOffset / granularity)
 		{
-			result += OFileWrite(file, buffer, amount,
-								 curOffset % ORIOLEDB_SEGMENT_SIZE + (orioledb_s3_mode ? ORIOLEDB_BLCKSZ : 0),
-								 WAIT_EVENT_DATA_FILE_WRITE);
+			result += btree_file_io(desc, file, buffer, amount,
+									curOffset % ORIOLEDB_SEGMENT_SIZE + (orioledb_s3_mode ? ORIOLEDB_BLCKSZ : 0),
+									true);
 			if (orioledb_s3_mode)
 				s3_header_unlock_part(tag, partno, true);
 			break;
@@ -590,9 +975,9 @@ btree_smgr_write(BTreeDescr *desc, char *buffer, uint32 chkpNum,
 			int			stepAmount = granularity - curOffset % granularity;
 
 			Assert(amount >= stepAmount);
-			result += OFileWrite(file, buffer, stepAmount,
-								 curOffset % ORIOLEDB_SEGMENT_SIZE + (orioledb_s3_mode ? ORIOLEDB_BLCKSZ : 0),
-								 WAIT_EVENT_DATA_FILE_WRITE);
+			result += btree_file_io(desc, file, buffer, stepAmount,
+									curOffset % ORIOLEDB_SEGMENT_SIZE + (orioledb_s3_mode ? ORIOLEDB_BLCKSZ : 0),
+									true);
 			buffer += stepAmount;
 			curOffset += stepAmount;
 			amount -= stepAmount;
@@ -670,9 +1055,9 @@ btree_smgr_read(BTreeDescr *desc, char *buffer, uint32 chkpNum,
 		file = btree_open_smgr_file(desc, segno, chkpNum, loadId);
 		if ((offset + amount) / granularity == offset / granularity)
 		{
-			result += OFileRead(file, buffer, amount,
-								offset % ORIOLEDB_SEGMENT_SIZE + (orioledb_s3_mode ? ORIOLEDB_BLCKSZ : 0),
-								WAIT_EVENT_DATA_FILE_READ);
+			result += btree_file_io(desc, file, buffer, amount,
+									offset % ORIOLEDB_SEGMENT_SIZE + (orioledb_s3_mode ? ORIOLEDB_BLCKSZ : 0),
+									false);
 			if (orioledb_s3_mode)
 				s3_header_unlock_part(tag, partno, false);
 			break;
@@ -682,9 +1067,9 @@ btree_smgr_read(BTreeDescr *desc, char *buffer, uint32 chkpNum,
 			int			stepAmount = granularity - offset % granularity;
 
 			Assert(amount >= stepAmount);
-			result += OFileRead(file, buffer, stepAmount,
-								offset % ORIOLEDB_SEGMENT_SIZE + (orioledb_s3_mode ? ORIOLEDB_BLCKSZ : 0),
-								WAIT_EVENT_DATA_FILE_READ);
+			result += btree_file_io(desc, file, buffer, stepAmount,
+									offset % ORIOLEDB_SEGMENT_SIZE + (orioledb_s3_mode ? ORIOLEDB_BLCKSZ : 0),
+									false);
 			buffer += stepAmount;
 			offset += stepAmount;
 			amount -= stepAmount;
@@ -707,8 +1092,9 @@ btree_smgr_writeback(BTreeDescr *desc, uint32 chkpNum,
 		msync(mmap_data + offset, amount, MS_ASYNC);
 		return;
 	}
-	else if (use_device)
+	else if (use_device || btree_use_direct_io(desc))
 	{
+		/* Direct I/O bypasses the kernel page cache, nothing to write back */
 		return;
 	}
 
@@ -750,10 +1136,34 @@ btree_smgr_writeback(BTreeDescr *desc, uint32 chkpNum,
 	}
 }
 
+static File
+btree_smgr_sync_file(BTreeDescr *desc, uint32 chkpNum, int num)
+{
+	uint32		loadId = 0;
+
+	if (orioledb_s3_mode)
+	{
+		S3HeaderTag tag = {.datoid = desc->oids.datoid,
+			.relnode = desc->oids.relnode,
+			.checkpointNum = chkpNum,
+		.segNum = num};
+
+		loadId = s3_header_get_load_id(tag);
+	}
+
+	return btree_open_smgr_file(desc, num, chkpNum, loadId);
+}
+
+/*
+ * Syncs the data files of the tree up to 'length'.  The writeback of all the
+ * segments is started first, so the kernel flushes them concurrently and
+ * every fsync only waits for what's left.
+ */
 void
 btree_smgr_sync(BTreeDescr *desc, uint32 chkpNum, off_t length)
 {
-	int			num;
+	int			num,
+				numSegments;
 
 	if (orioledb_s3_mode)
 		btree_s3_flush(desc, chkpNum);
@@ -761,24 +1171,24 @@ btree_smgr_sync(BTreeDescr *desc, uint32 chkpNum, off_t length)
 	if (use_mmap || use_device)
 		return;
 
-	for (num = 0; num < length / ORIOLEDB_SEGMENT_SIZE; num++)
-	{
-		File		file;
-		uint32		loadId = 0;
+	numSegments = (length + ORIOLEDB_SEGMENT_SIZE - 1) / ORIOLEDB_SEGMENT_SIZE;
 
-		if (orioledb_s3_mode)
+	if (numSegments > 1)
+	{
+		for (num = 0; num < numSegments; num++)
 		{
-			S3HeaderTag tag = {.datoid = desc->oids.datoid,
-				.relnode = desc->oids.relnode,
-				.checkpointNum = chkpNum,
-			.segNum = num};
+			off_t		segLength;
 
-			loadId = s3_header_get_load_id(tag);
+			segLength = Min(length - (off_t) num * ORIOLEDB_SEGMENT_SIZE,
+							ORIOLEDB_SEGMENT_SIZE);
+			FileWriteback(btree_smgr_sync_file(desc, chkpNum, num),
+						  0, segLength, WAIT_EVENT_DATA_FILE_FLUSH);
 		}
-
-		file = btree_open_smgr_file(desc, num, chkpNum, loadId);
-		FileSync(file, WAIT_EVENT_DATA_FILE_SYNC);
 	}
+
+	for (num = 0; num < numSegments; num++)
+		FileSync(btree_smgr_sync_file(desc, chkpNum, num),
+				 WAIT_EVENT_DATA_FILE_SYNC);
 }
 
 void
@@ -839,6 +1249,56 @@ btree_smgr_punch_hole(BTreeDescr *desc, uint32 chkpNum,
 	}
 }
 
+/*
+ * Preallocates the chunk of the data file the extension from 'oldLength' to
+ * 'newLength' enters together with the following chunk.  So, the writes
+ * usually find the file space already allocated.  FALLOC_FL_KEEP_SIZE keeps
+ * the reads past the written data hitting EOF.  The preallocation doesn't
+ * cross the segment boundary not to create the next segment file ahead.
+ */
+void
+btree_smgr_preallocate(BTreeDescr *desc, off_t oldLength, off_t newLength)
+{
+	off_t		chunk = (off_t) data_file_prealloc_size * 1024,
+				offset,
+				segend;
+	int			segno;
+
+	if (chunk == 0 || orioledb_s3_mode || use_mmap || use_device)
+		return;
+
+	if (oldLength > 0 && (oldLength - 1) / chunk == (newLength - 1) / chunk)
+		return;
+
+	offset = ((newLength - 1) / chunk) * chunk;
+	segno = (newLength - 1) / ORIOLEDB_SEGMENT_SIZE;
+	segend = (off_t) (segno + 1) * ORIOLEDB_SEGMENT_SIZE;
+	offset = Max(offset, (off_t) segno * ORIOLEDB_SEGMENT_SIZE);
+
+#ifndef __APPLE__
+	{
+		File		file = btree_open_smgr_file(desc, segno, 0, 0);
+		off_t		length = Min(offset + 2 * chunk, segend) - offset;
+
+		if (fallocate(FileGetRawDesc(file), FALLOC_FL_KEEP_SIZE,
+					  offset % ORIOLEDB_SEGMENT_SIZE, length) < 0)
+		{
+			int			save_errno = errno;
+
+			/* The filesystem doesn't support preallocation, that's OK */
+			if (save_errno != EOPNOTSUPP)
+				ereport(WARNING,
+						(errcode_for_file_access(),
+						 errmsg("fail to preallocate data file datoid=%u relnode=%u offset=%llu length=%llu (%d %s)",
+								desc->oids.datoid, desc->oids.relnode,
+								(unsigned long long) offset,
+								(unsigned long long) length,
+								save_errno, strerror(save_errno))));
+		}
+	}
+#endif
+}
+
 void
 btree_io_error_cleanup(void)
 {
@@ -893,8 +1353,19 @@ assign_io_num(OInMemoryBlkno blkno, OffsetNumber offnum)
 void
 wait_for_io_completion(int ionum)
 {
+	instr_time	waitStart;
+
+	if (LWLockConditionalAcquire(&io_locks[ionum].lock, LW_SHARED))
+	{
+		LWLockRelease(&io_locks[ionum].lock);
+		return;
+	}
+
+	/* LWLockAcquire() reports its own wait event, so only account the wait */
+	INSTR_TIME_SET_CURRENT(waitStart);
 	LWLockAcquire(&io_locks[ionum].lock, LW_SHARED);
 	LWLockRelease(&io_locks[ionum].lock);
+	o_wait_event_account(OWaitIOCompletion, &waitStart);
 }
 
 /*
@@ -1029,6 +1500,11 @@ get_free_disk_offset(BTreeDescr *desc)
 			result = pg_atomic_fetch_add_u64(&metaPage->datafileLength[0], 1);
 	}
 	LWLockRelease(metaLock);
+
+	if (!gotBlock && !use_device)
+		btree_smgr_preallocate(desc, (off_t) result * ORIOLEDB_BLCKSZ,
+							   (off_t) (result + 1) * ORIOLEDB_BLCKSZ);
+
 	return result;
 }
 
@@ -1101,10 +1577,7 @@ get_free_disk_extent_copy_blkno(BTreeDescr *desc, off_t page_size,
 	}
 
 	if ((desc->storageType == BTreeStoragePersistence || desc->storageType == BTreeStorageUnlogged) &&
-		checkpoint_state->treeType == desc->type &&
-		checkpoint_state->datoid == desc->oids.datoid &&
-		checkpoint_state->relnode == desc->oids.relnode &&
-		checkpoint_state->curKeyType != CurKeyFinished)
+		tree_checkpoint_unfinished(desc))
 	{
 		/*
 		 * We're writing to the next checkpoint, while current checkpoint is
@@ -1203,9 +1676,14 @@ read_page_from_disk(BTreeDescr *desc, Pointer img, uint64 downlink,
 			if (!err)
 			{
 				OCompressHeader header;
+				instr_time	decompressStart;
 
 				memcpy(&header, buf, sizeof(OCompressHeader));
-				o_decompress_page(buf + sizeof(OCompressHeader), header.page_size, img);
+				latency_start(&decompressStart);
+				o_decompress_page(buf + sizeof(OCompressHeader), header.page_size,
+								  img, header.algorithm, desc->oids.datoid,
+								  desc->oids.relnode, header.dictId);
+				latency_record(OLatencyDecompressPage, &decompressStart);
 			}
 		}
 		else
@@ -1237,12 +1715,77 @@ read_page_from_disk(BTreeDescr *desc, Pointer img, uint64 downlink,
 	return !err;
 }
 
+/*
+ * Hints the kernel that a page referenced by the valid downlink is going to
+ * be read soon.  It's used by sequential scans to issue reads of the next
+ * on-disk leaves while the current one is processed.  In S3 mode, schedules
+ * the load of the data file part containing the page.  Does nothing for
+ * memory-mapped devices, where the data is readily available.
+ */
+void
+prefetch_page_from_disk(BTreeDescr *desc, uint64 downlink)
+{
+	off_t		byte_offset,
+				prefetch_size;
+	uint64		offset = DOWNLINK_GET_DISK_OFF(downlink);
+	uint16		len = DOWNLINK_GET_DISK_LEN(downlink);
+	int			segno;
+	File		file;
+
+	Assert(FileExtentOffIsValid(offset));
+	Assert(FileExtentLenIsValid(len));
+
+	if (orioledb_s3_mode)
+	{
+		if (s3_prefetch_parts > 0)
+			s3_prefetch_downlink(desc, downlink);
+		return;
+	}
+
+	if (use_mmap || btree_use_direct_io(desc))
+		return;
+
+	if (!OCompressIsValid(desc->compress))
+	{
+		if (use_device)
+			byte_offset = (off_t) offset * (off_t) ORIOLEDB_COMP_BLCKSZ;
+		else
+			byte_offset = (off_t) offset * (off_t) ORIOLEDB_BLCKSZ;
+		prefetch_size = ORIOLEDB_BLCKSZ;
+	}
+	else
+	{
+		byte_offset = (off_t) offset * (off_t) ORIOLEDB_COMP_BLCKSZ;
+		prefetch_size = len * ORIOLEDB_COMP_BLCKSZ;
+	}
+
+	if (use_device)
+	{
+#ifdef USE_POSIX_FADVISE
+		Assert(byte_offset + prefetch_size <= device_length);
+		(void) posix_fadvise(device_fd, byte_offset, prefetch_size,
+							 POSIX_FADV_WILLNEED);
+#endif
+		return;
+	}
+
+	/* Pages crossing the segment boundary are rare, don't bother with them */
+	segno = byte_offset / ORIOLEDB_SEGMENT_SIZE;
+	if ((byte_offset + prefetch_size - 1) / ORIOLEDB_SEGMENT_SIZE != segno)
+		return;
+
+	file = btree_open_smgr_file(desc, segno, 0, 0);
+	(void) FilePrefetch(file, byte_offset % ORIOLEDB_SEGMENT_SIZE,
+						prefetch_size, WAIT_EVENT_DATA_FILE_PREFETCH);
+}
+
 /*
  * Writes a page to the disk. An array of file offsets must be valid.
+ * 'dictId' is the compression dictionary of the compressed image.
  */
 static bool
 write_page_to_disk(BTreeDescr *desc, FileExtent *extent, uint32 curChkpNum,
-				   Pointer page, off_t page_size)
+				   Pointer page, off_t page_size, uint16 dictId)
 {
 
 	off_t		byte_offset,
@@ -1276,6 +1819,8 @@ write_page_to_disk(BTreeDescr *desc, FileExtent *extent, uint32 curChkpNum,
 	else
 	{
 		OCompressHeader header = {0};
+		Pointer		body;
+		off_t		body_size;
 
 		byte_offset = (off_t) extent->off;
 		if (orioledb_s3_mode)
@@ -1291,20 +1836,15 @@ write_page_to_disk(BTreeDescr *desc, FileExtent *extent, uint32 curChkpNum,
 		Assert(sizeof(((OCompressHeader *) 0)->page_size) == sizeof(uint16));
 		Assert(ORIOLEDB_BLCKSZ < UINT16_MAX);
 
-		/* we need to write header first */
 		header.page_size = page_size;
 		header.chkpNum = curChkpNum;
-		write_size = sizeof(OCompressHeader);
-		err = btree_smgr_write(desc, (char *) &header, chkpNum, write_size, byte_offset) != write_size;
-		byte_offset += write_size;
-
-		if (err)
-			return false;
+		header.algorithm = OCompressGetAlgorithm(desc->compress);
+		header.dictId = dictId;
 
 		if (page_size != ORIOLEDB_BLCKSZ)
 		{
-			write_size = extent->len * ORIOLEDB_COMP_BLCKSZ - sizeof(OCompressHeader);
-			err = btree_smgr_write(desc, page, chkpNum, write_size, byte_offset) != write_size;
+			body = page;
+			body_size = extent->len * ORIOLEDB_COMP_BLCKSZ - sizeof(OCompressHeader);
 		}
 		else
 		{
@@ -1317,16 +1857,67 @@ write_page_to_disk(BTreeDescr *desc, FileExtent *extent, uint32 curChkpNum,
 			 * using sizeof checkpointNum because offsetof(BTreePageHeader,
 			 * flags) is forbidden
 			 */
-			page += skipped;
-			write_size = ORIOLEDB_BLCKSZ - skipped;
-			err = btree_smgr_write(desc, page, chkpNum, write_size, byte_offset) != write_size;
-
+			body = page + skipped;
+			body_size = ORIOLEDB_BLCKSZ - skipped;
 		}
+
+		/*
+		 * Gather the header and the image into one buffer, so the extent is
+		 * written with a single call instead of two.
+		 */
+		write_size = sizeof(OCompressHeader) + body_size;
+		Assert(write_size <= sizeof(compressed_write_buf.data));
+		memcpy(compressed_write_buf.data, &header, sizeof(OCompressHeader));
+		memcpy(compressed_write_buf.data + sizeof(OCompressHeader), body,
+			   body_size);
+		err = btree_smgr_write(desc, compressed_write_buf.data, chkpNum,
+							   write_size, byte_offset) != write_size;
 	}
 
 	return !err;
 }
 
+/*
+ * The position of the last page loaded on the tree level by this backend.
+ */
+typedef struct
+{
+	Oid			datoid;
+	Oid			relnode;
+	OInMemoryBlkno parentBlkno;
+	int			offset;
+} LoadPosition;
+
+static LoadPosition lastLoads[ORIOLEDB_MAX_DEPTH];
+
+/*
+ * Checks if the page load continues the forward sequence of loads on the same
+ * tree level: it either follows the previous load within the same parent, or
+ * it's the first child of another parent.  That looks like a scan.
+ */
+static bool
+is_sequential_load(BTreeDescr *desc, OInMemoryBlkno parentBlkno, int offset,
+				   int level)
+{
+	LoadPosition *last;
+	bool		result;
+
+	if (level < 0 || level >= ORIOLEDB_MAX_DEPTH)
+		return false;
+
+	last = &lastLoads[level];
+	result = last->datoid == desc->oids.datoid &&
+		last->relnode == desc->oids.relnode &&
+		(last->parentBlkno == parentBlkno ? offset > last->offset : offset == 0);
+
+	last->datoid = desc->oids.datoid;
+	last->relnode = desc->oids.relnode;
+	last->parentBlkno = parentBlkno;
+	last->offset = offset;
+
+	return result;
+}
+
 /*
  * Load the page where context is pointing from disk to memory, assuming parent
  * page is locked.
@@ -1357,6 +1948,12 @@ load_page(OBTreeFindPageContext *context)
 	bool		was_image = false;
 	bool		was_keep_lokey = false;
 	uint32		chkpNum = 0;
+	instr_time	readStart,
+				memoryStart;
+	uint64		s3Misses = s3_header_my_misses;
+	uint64	   *prefetchDownlinks = NULL;
+	int			prefetchCount = 0,
+				loadOffset;
 
 	context_index = context->index;
 	parent_blkno = context->items[context_index].blkno;
@@ -1372,11 +1969,13 @@ load_page(OBTreeFindPageContext *context)
 	Assert(DOWNLINK_IS_ON_DISK(int_hdr->downlink));
 
 	downlink = int_hdr->downlink;
+	bloom_filter_forget(desc, downlink);
 
 	int_hdr->downlink = MAKE_IO_DOWNLINK(ionum);
 	Assert(PAGE_GET_N_ONDISK(parent_page) > 0);
 	PAGE_DEC_N_ONDISK(parent_page);
 
+	loadOffset = BTREE_PAGE_LOCATOR_GET_OFFSET(parent_page, parent_loc);
 	BTREE_PAGE_LOCATOR_NEXT(parent_page, parent_loc);
 	if (BTREE_PAGE_LOCATOR_IS_VALID(parent_page, parent_loc))
 		copy_fixed_page_key(desc, &target_hikey, parent_page, parent_loc);
@@ -1386,13 +1985,49 @@ load_page(OBTreeFindPageContext *context)
 		clear_fixed_key(&target_hikey);
 	target_level = PAGE_GET_LEVEL(parent_page) - 1;
 
+	/*
+	 * In S3 mode, a scan would wait for the parts of the following on-disk
+	 * siblings one by one.  Collect them to schedule the parts loads ahead.
+	 */
+	if (orioledb_s3_mode && s3_prefetch_parts > 0 &&
+		is_sequential_load(desc, parent_blkno, loadOffset, target_level) &&
+		PAGE_GET_N_ONDISK(parent_page) > 0)
+	{
+		BTreePageItemLocator loc = *parent_loc;
+		int			maxCount = Min(PAGE_GET_N_ONDISK(parent_page),
+								   s3_prefetch_parts * S3_PART_PAGES);
+
+		prefetchDownlinks = (uint64 *) palloc(sizeof(uint64) * maxCount);
+		while (BTREE_PAGE_LOCATOR_IS_VALID(parent_page, &loc) &&
+			   prefetchCount < maxCount)
+		{
+			BTreeNonLeafTuphdr *tupHdr;
+
+			tupHdr = (BTreeNonLeafTuphdr *) BTREE_PAGE_LOCATOR_GET_ITEM(parent_page, &loc);
+			if (DOWNLINK_IS_ON_DISK(tupHdr->downlink))
+				prefetchDownlinks[prefetchCount++] = tupHdr->downlink;
+			BTREE_PAGE_LOCATOR_NEXT(parent_page, &loc);
+		}
+	}
+
 	unlock_page(parent_blkno);
 
+	if (prefetchDownlinks)
+	{
+		int			i;
+
+		for (i = 0; i < prefetchCount; i++)
+			s3_prefetch_downlink(desc, prefetchDownlinks[i]);
+		pfree(prefetchDownlinks);
+	}
+
 	/* Prepare new page metaPage-data */
+	latency_start(&memoryStart);
 	ppool_reserve_pages(desc->ppool, PPOOL_RESERVE_FIND, 1);
 	blkno = ppool_get_page(desc->ppool, PPOOL_RESERVE_FIND);
 	lock_page(blkno);
 	page_block_reads(blkno);
+	latency_record(OLatencyLoadPageMemory, &memoryStart);
 
 	Assert(OInMemoryBlknoIsValid(blkno));
 	page = O_GET_IN_MEMORY_PAGE(blkno);
@@ -1402,6 +2037,7 @@ load_page(OBTreeFindPageContext *context)
 	page_desc->flags = 0;
 
 	/* Read page data and put it to the page */
+	INSTR_TIME_SET_CURRENT(readStart);
 	if (!read_page_from_disk(desc, buf, downlink, &page_desc->fileExtent))
 	{
 		int_hdr->downlink = downlink;
@@ -1417,9 +2053,20 @@ load_page(OBTreeFindPageContext *context)
 							   btree_smgr_filename(desc, DOWNLINK_GET_DISK_OFF(downlink), chkpNum))));
 	}
 
+	account_page_read(&readStart);
+	if (latency_histograms)
+		latency_record(s3_header_my_misses != s3Misses ?
+					   OLatencyLoadPageS3 : OLatencyLoadPageDisk,
+					   &readStart);
+	tree_io_stats_page_load(desc->oids,
+							OCompressIsValid(desc->compress) ?
+							page_desc->fileExtent.len * ORIOLEDB_COMP_BLCKSZ :
+							ORIOLEDB_BLCKSZ,
+							&readStart);
+
 	put_page_image(blkno, buf);
 	page_change_usage_count(&desc->ppool->ucm, blkno,
-							(pg_atomic_read_u32(desc->ppool->ucm.epoch) + 2) % UCM_USAGE_LEVELS);
+							ucm_new_page_usage_count(&desc->ppool->ucm));
 	page_desc->type = parent_page_desc->type;
 	page_desc->oids = parent_page_desc->oids;
 
@@ -1439,10 +2086,20 @@ load_page(OBTreeFindPageContext *context)
 			BTreeNonLeafTuphdr *tupHdr;
 
 			tupHdr = (BTreeNonLeafTuphdr *) BTREE_PAGE_LOCATOR_GET_ITEM(page, &loc);
-			(void) s3_schedule_downlink_load(desc, tupHdr->downlink);
+			(void) s3_schedule_downlink_load(desc, tupHdr->downlink, true);
 		}
 	}
 
+	if (s3_header_my_misses != s3Misses)
+	{
+		EA_S3LOAD_INC(blkno);
+	}
+	if (OCompressIsValid(desc->compress) &&
+		page_desc->fileExtent.len != ORIOLEDB_BLCKSZ / ORIOLEDB_COMP_BLCKSZ)
+	{
+		EA_DECOMPRESSED_ADD(blkno, page_desc->fileExtent.len * ORIOLEDB_COMP_BLCKSZ);
+	}
+
 	unlock_page(blkno);
 
 	EA_LOAD_INC(blkno);
@@ -1535,29 +2192,81 @@ load_page(OBTreeFindPageContext *context)
 	parent_page = O_GET_IN_MEMORY_PAGE(parent_blkno);
 	int_hdr = (BTreeNonLeafTuphdr *) BTREE_PAGE_LOCATOR_GET_ITEM(parent_page, parent_loc);
 	Assert(int_hdr->downlink == MAKE_IO_DOWNLINK(ionum));
+	O_GET_IN_MEMORY_PAGEDESC(blkno)->parentBlkno = parent_blkno;
 	int_hdr->downlink = MAKE_IN_MEMORY_DOWNLINK(blkno, O_PAGE_HEADER(page)->pageChangeCount);
 
 	unlock_io(ionum);
 }
 
 /*
- * Returns pointer to writable image. It compresses page if needed.
+ * Minimal space saving for the page to be written compressed.  Pages are
+ * decompressed as a whole on every load, so with orioledb.compress_min_saving
+ * set poorly compressible pages are kept uncompressed.  Otherwise, the page
+ * has to save at least a compression block.
+ */
+#define O_COMPRESS_MIN_SAVING	Max(compress_min_saving, ORIOLEDB_COMP_BLCKSZ)
+
+/*
+ * Returns the compression level for the in-memory page written.  With
+ * orioledb.hot_pages_compress set, the level is interpolated between the
+ * tree level for the coldest pages and hot_pages_compress for the hottest
+ * ones according to the page hotness in UCM.  Hot pages are usually written
+ * by checkpointer and will be rewritten soon, so it's not worth spending much
+ * CPU on them.  The decompression doesn't depend on the level.
+ */
+static OCompress
+get_page_compress_level(BTreeDescr *desc, OInMemoryBlkno blkno)
+{
+	OCompress	lvl = desc->compress;
+	uint32		hotness;
+
+	if (!OCompressIsValid(lvl) || OCompressIsLZ4(lvl) ||
+		!OCompressIsValid(hot_pages_compress) || hot_pages_compress >= lvl)
+		return lvl;
+
+	/* Switching levels would rebuild the digested dictionary every time */
+	if (O_COMPRESS_DICT_GET_ID(pg_atomic_read_u64(&BTREE_GET_META(desc)->compressDict)) != 0)
+		return lvl;
+
+	hotness = page_get_hotness(&desc->ppool->ucm, blkno);
+
+	return lvl - (lvl - hot_pages_compress) * (int) hotness / (UCM_USAGE_LEVELS - 1);
+}
+
+/*
+ * Returns pointer to writable image. It compresses page if needed with 'lvl'
+ * compression level.  'useDict' allows using the tree compression dictionary,
+ * the dictionary actually used is returned in '*dictId'.
  */
 static inline Pointer
-get_write_img(BTreeDescr *desc, Page page, size_t *size)
+get_write_img(BTreeDescr *desc, Page page, size_t *size, OCompress lvl,
+			  bool useDict, uint16 *dictId)
 {
 	Pointer		result;
 
+	*dictId = 0;
 	if (OCompressIsValid(desc->compress))
 	{
-		result = o_compress_page(page, size, desc->compress);
-		if (*size > (ORIOLEDB_BLCKSZ - ORIOLEDB_COMP_BLCKSZ - sizeof(OCompressHeader)))
+		instr_time	compressStart;
+
+		latency_start(&compressStart);
+		if (useDict)
+			result = o_compress_page_dict(page, size, lvl,
+										  desc->oids.datoid,
+										  desc->oids.relnode,
+										  pg_atomic_read_u64(&BTREE_GET_META(desc)->compressDict),
+										  dictId);
+		else
+			result = o_compress_page(page, size, lvl);
+		latency_record(OLatencyCompressPage, &compressStart);
+		if (*size > (ORIOLEDB_BLCKSZ - O_COMPRESS_MIN_SAVING - sizeof(OCompressHeader)))
 		{
 			/*
 			 * No sense to write compressed page
 			 */
 			result = page;
 			*size = ORIOLEDB_BLCKSZ;
+			*dictId = 0;
 		}
 	}
 	else
@@ -1599,15 +2308,18 @@ perform_page_io(BTreeDescr *desc, OInMemoryBlkno blkno,
 	OrioleDBPageDesc *page_desc = O_GET_IN_MEMORY_PAGEDESC(blkno);
 	Pointer		write_img;
 	size_t		write_size;
+	uint16		dictId;
 	int			chkp_index;
 	bool		less_num,
 				err = false;
+	instr_time	writeStart;
 
 #ifdef USE_ASSERT_CHECKING
 	prewrite_image_check(img);
 #endif
 
 	EA_WRITE_INC(blkno);
+	INSTR_TIME_SET_CURRENT(writeStart);
 
 	less_num = header->checkpointNum < checkpoint_number;
 	if (less_num)
@@ -1632,7 +2344,9 @@ perform_page_io(BTreeDescr *desc, OInMemoryBlkno blkno,
 		Assert(header->checkpointNum == checkpoint_number);
 	}
 
-	write_img = get_write_img(desc, img, &write_size);
+	write_img = get_write_img(desc, img, &write_size,
+							  get_page_compress_level(desc, blkno),
+							  true, &dictId);
 
 	/*
 	 * Determine the file position to write this page.
@@ -1782,7 +2496,7 @@ perform_page_io(BTreeDescr *desc, OInMemoryBlkno blkno,
 
 	Assert(FileExtentIsValid(page_desc->fileExtent));
 
-	if (!write_page_to_disk(desc, &page_desc->fileExtent, checkpoint_number, write_img, write_size))
+	if (!write_page_to_disk(desc, &page_desc->fileExtent, checkpoint_number, write_img, write_size, dictId))
 	{
 		ereport(PANIC, (errcode_for_file_access(),
 						errmsg("could not write page %d to file %s with offset %lu",
@@ -1793,6 +2507,8 @@ perform_page_io(BTreeDescr *desc, OInMemoryBlkno blkno,
 		return InvalidDiskDownlink;
 	}
 
+	tree_io_stats_page_write(desc->oids, write_size, &writeStart);
+
 	return MAKE_ON_DISK_DOWNLINK(page_desc->fileExtent);
 }
 
@@ -1806,12 +2522,16 @@ perform_page_io_autonomous(BTreeDescr *desc, uint32 chkpNum, Page img, FileExten
 {
 	Pointer		write_img;
 	size_t		write_size;
+	uint16		dictId;
+	instr_time	writeStart;
 
 #ifdef USE_ASSERT_CHECKING
 	prewrite_image_check(img);
 #endif
 
-	write_img = get_write_img(desc, img, &write_size);
+	INSTR_TIME_SET_CURRENT(writeStart);
+	write_img = get_write_img(desc, img, &write_size, desc->compress,
+							  true, &dictId);
 
 	if (!get_free_disk_extent(desc, chkpNum, write_size, extent))
 	{
@@ -1824,7 +2544,7 @@ perform_page_io_autonomous(BTreeDescr *desc, uint32 chkpNum, Page img, FileExten
 
 	Assert(FileExtentIsValid(*extent));
 
-	if (!write_page_to_disk(desc, extent, chkpNum, write_img, write_size))
+	if (!write_page_to_disk(desc, extent, chkpNum, write_img, write_size, dictId))
 	{
 		uint64		offset;
 
@@ -1847,6 +2567,8 @@ perform_page_io_autonomous(BTreeDescr *desc, uint32 chkpNum, Page img, FileExten
 		return InvalidDiskDownlink;
 	}
 
+	tree_io_stats_page_write(desc->oids, write_size, &writeStart);
+
 	return MAKE_ON_DISK_DOWNLINK(*extent);
 }
 
@@ -1861,6 +2583,7 @@ perform_page_io_build(BTreeDescr *desc, Page img,
 {
 	Pointer		write_img;
 	size_t		write_size;
+	uint16		dictId;
 	uint32		chkpNum;
 
 	btree_page_update_max_key_len(desc, img);
@@ -1869,7 +2592,8 @@ perform_page_io_build(BTreeDescr *desc, Page img,
 	prewrite_image_check(img);
 #endif
 
-	write_img = get_write_img(desc, img, &write_size);
+	write_img = get_write_img(desc, img, &write_size, desc->compress,
+							  false, &dictId);
 
 	if (orioledb_s3_mode)
 		chkpNum = checkpoint_state->lastCheckpointNumber;
@@ -1914,8 +2638,8 @@ perform_page_io_build(BTreeDescr *desc, Page img,
 			tag.checkpointNum = chkpNum;
 			tag.segNum = offset / ORIOLEDB_SEGMENT_SIZE;
 			index = (offset % ORIOLEDB_SEGMENT_SIZE) / ORIOLEDB_S3_PART_SIZE;
-			s3_header_mark_part_loading(tag, index);
-			s3_header_mark_part_loaded(tag, index);
+			s3_header_mark_part_loading(tag, index, false);
+			s3_header_mark_part_loaded(tag, index, false);
 			s3_headers_increase_loaded_parts(1);
 		}
 
@@ -1924,7 +2648,7 @@ perform_page_io_build(BTreeDescr *desc, Page img,
 
 	Assert(FileExtentIsValid(*extent));
 
-	if (!write_page_to_disk(desc, extent, 0, write_img, write_size))
+	if (!write_page_to_disk(desc, extent, 0, write_img, write_size, dictId))
 	{
 		ereport(PANIC, (errcode_for_file_access(),
 						errmsg("could not write autonomous page to file %s with offset %lu",
@@ -1992,6 +2716,8 @@ write_page(OBTreeFindPageContext *context, OInMemoryBlkno blkno, Page img,
 	uint32		parent_change_count = 0;
 	OrioleDBPageDesc *page_desc = O_GET_IN_MEMORY_PAGEDESC(blkno);
 	bool		is_root = desc->rootInfo.rootPageBlkno == blkno;
+	OBloomFilter filter;
+	bool		haveFilter = false;
 
 	/* rootPageBlkno can not be evicted here */
 	Assert(!evict || !is_root);
@@ -1999,6 +2725,13 @@ write_page(OBTreeFindPageContext *context, OInMemoryBlkno blkno, Page img,
 	Assert(page_is_locked(blkno));
 	EA_EVICT_INC(blkno);
 
+	/* Page can't change under the lock, collect its keys before eviction */
+	if (evict)
+	{
+		haveFilter = bloom_filter_build(desc, p, &filter);
+		tree_io_stats_page_evict(desc->oids);
+	}
+
 	if (!is_root)
 	{
 		context_index = context->index;
@@ -2031,6 +2764,8 @@ write_page(OBTreeFindPageContext *context, OInMemoryBlkno blkno, Page img,
 		 * Easy case: page isn't dirty and doesn't need to be written to the
 		 * disk.  Then we just have to change downlink in the parent.
 		 */
+		bloom_filter_remember(desc, MAKE_ON_DISK_DOWNLINK(page_desc->fileExtent),
+							  haveFilter ? &filter : NULL);
 		int_hdr->downlink = MAKE_ON_DISK_DOWNLINK(page_desc->fileExtent);
 		PAGE_INC_N_ONDISK(parent_page);
 
@@ -2163,6 +2898,8 @@ write_page(OBTreeFindPageContext *context, OInMemoryBlkno blkno, Page img,
 
 				if (evict)
 				{
+					bloom_filter_remember(desc, new_downlink,
+										  haveFilter ? &filter : NULL);
 					int_hdr->downlink = new_downlink;
 					PAGE_INC_N_ONDISK(parent_page);
 				}
@@ -2375,10 +3112,27 @@ index_oids_get_btree_descr(ORelOids oids, OIndexType type)
 }
 
 /*
- * Examine single page and evict it if possible.
+ * Examine single page and evict it if possible.  Accounts the eviction
+ * latency.
  */
 OWalkPageResult
 walk_page(OInMemoryBlkno blkno, bool evict)
+{
+	OWalkPageResult result;
+	instr_time	start;
+
+	if (!evict)
+		return walk_page_internal(blkno, false);
+
+	latency_start(&start);
+	result = walk_page_internal(blkno, true);
+	if (result == OWalkPageEvicted)
+		latency_record(OLatencyEvictPage, &start);
+	return result;
+}
+
+static OWalkPageResult
+walk_page_internal(OInMemoryBlkno blkno, bool evict)
 {
 	OrioleDBPageDesc *page_desc = O_GET_IN_MEMORY_PAGEDESC(blkno);
 	OBTreeFindPageContext context;
@@ -2779,6 +3533,81 @@ orioledb_write_pages(PG_FUNCTION_ARGS)
 	PG_RETURN_VOID();
 }
 
+/*
+ * Returns the queue depth and the latency of every I/O class.
+ */
+Datum
+orioledb_io_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Datum		values[7];
+	bool		nulls[7];
+	int			i;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+
+	orioledb_check_shmem();
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	MemSet(nulls, 0, sizeof(nulls));
+	for (i = 0; i < OIOClassesCount; i++)
+	{
+		IOClassState *state = &ioShmem->classes[i];
+		int			concurrency = io_class_concurrency((OIOClass) i);
+		uint64		finished = pg_atomic_read_u64(&state->finished);
+		uint64		depth = pg_atomic_read_u64(&state->started) - finished;
+		uint64		running = depth;
+
+		if (concurrency > 0)
+			running = Min(depth, (uint64) concurrency);
+
+		values[0] = CStringGetTextDatum(io_class_names[i]);
+		values[1] = Int32GetDatum(concurrency);
+		values[2] = Int64GetDatum(running);
+		values[3] = Int64GetDatum(depth - running);
+		values[4] = Int64GetDatum(pg_atomic_read_u64(&state->ops));
+		values[5] = Float8GetDatum((double) pg_atomic_read_u64(&state->waitTime) / 1000.0);
+		values[6] = Float8GetDatum((double) pg_atomic_read_u64(&state->ioTime) / 1000.0);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+Datum
+orioledb_io_stats_reset(PG_FUNCTION_ARGS)
+{
+	int			i;
+
+	orioledb_check_shmem();
+
+	for (i = 0; i < OIOClassesCount; i++)
+	{
+		IOClassState *state = &ioShmem->classes[i];
+
+		pg_atomic_write_u64(&state->ops, 0);
+		pg_atomic_write_u64(&state->waitTime, 0);
+		pg_atomic_write_u64(&state->ioTime, 0);
+	}
+
+	PG_RETURN_VOID();
+}
+
 static int
 tree_offsets_cmp(const void *a, const void *b)
 {
@@ -2820,7 +3649,8 @@ writeback_put_extent(IOWriteBack *writeback, BTreeDescr *desc,
 	extent.len = DOWNLINK_GET_DISK_LEN(downlink);
 	extent.off = DOWNLINK_GET_DISK_OFF(downlink);
 
-	if (!ORelOidsIsValid(desc->oids) || desc->type == oIndexInvalid)
+	if (!ORelOidsIsValid(desc->oids) || desc->type == oIndexInvalid ||
+		btree_use_direct_io(desc))
 		return;
 
 	if (orioledb_s3_mode)
@@ -2933,6 +3763,7 @@ perform_writeback(IOWriteBack *writeback)
 				char	   *filename;
 
 				filename = btree_filename(datoid, relnode, segno, chkpNum);
+				btree_stripe_segment(datoid, relnode, segno, filename);
 				file = PathNameOpenFile(filename, O_RDWR | O_CREAT | PG_BINARY);
 				pfree(filename);
 				offset = cur.fileExtent.off;
@@ -3018,7 +3849,7 @@ iterate_relnode_files(Oid datoid, Oid relnode, RelnodeFileCallback callback,
 		if ((sscanf(file->d_name, "%10u-%10u.%4s",
 					&file_relnode, &file_chkp, file_ext) == 3 &&
 			 (!strcmp(file_ext, "tmp") || !strcmp(file_ext, "map") ||
-			  !strcmp(file_ext, "evt")) &&
+			  !strcmp(file_ext, "evt") || !strcmp(file_ext, "dict")) &&
 			 (file_ext_p = file_ext)) ||
 			sscanf(file->d_name, "%10u.%10u",
 				   &file_relnode, &file_segno) == 2 ||
@@ -3060,9 +3891,23 @@ unlink_callback(const char *filename, uint32 segno, char *ext, void *arg)
 	 * situation when partially deleted file data is visible.
 	 */
 	if (segno == 0 && ext == NULL)
+	{
 		durable_unlink(filename, ERROR);
+	}
 	else
+	{
+		char		target[MAXPGPATH];
+		ssize_t		len;
+
+		/* Striped segment: remove the file the symlink points to */
+		len = readlink(filename, target, sizeof(target) - 1);
+		if (len > 0)
+		{
+			target[len] = '\0';
+			unlink(target);
+		}
 		unlink(filename);
+	}
 }
 
 bool
@@ -3071,6 +3916,23 @@ cleanup_btree_files(Oid datoid, Oid relnode)
 	return iterate_relnode_files(datoid, relnode, unlink_callback, NULL);
 }
 
+static void
+pre_sync_callback(const char *filename, uint32 segno, char *ext, void *arg)
+{
+	int			fd;
+
+	if (ext != NULL && strcmp(ext, "tmp") == 0)
+		return;
+
+	fd = OpenTransientFile(filename, O_RDONLY | PG_BINARY);
+	if (fd < 0)
+		return;
+
+	/* Errors are reported by the following fsync */
+	pg_flush_data(fd, 0, 0);
+	(void) CloseTransientFile(fd);
+}
+
 static void
 fsync_callback(const char *filename, uint32 segno, char *ext, void *arg)
 {
@@ -3078,9 +3940,15 @@ fsync_callback(const char *filename, uint32 segno, char *ext, void *arg)
 		fsync_fname(filename, false);
 }
 
+/*
+ * Fsyncs the files of the tree.  The first pass starts the writeback of all
+ * the files, so the second pass fsyncs don't flush them one after another.
+ */
 bool
 fsync_btree_files(Oid datoid, Oid relnode)
 {
+	if (!iterate_relnode_files(datoid, relnode, pre_sync_callback, NULL))
+		return false;
 	return iterate_relnode_files(datoid, relnode, fsync_callback, NULL);
 }
 
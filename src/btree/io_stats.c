@@ -0,0 +1,295 @@
+/*-------------------------------------------------------------------------
+ *
+ * io_stats.c
+ *		Per-tree I/O statistics.
+ *
+ * Copyright (c) 2025-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/btree/io_stats.c
+ *
+ * NOTES
+ *
+ *		The counters are accounted on the page I/O paths only, which are
+ *		expensive anyway.  So, they are always collected.  Trees are mapped
+ *		to the fixed number of slots using open addressing like the page lock
+ *		statistics.  Once all the probed slots are occupied, the tree isn't
+ *		accounted.  The slots of the dropped trees are released only by
+ *		orioledb_tree_io_stats_reset().
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "btree/io_stats.h"
+
+#include "common/hashfn.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "utils/tuplestore.h"
+
+#define TREE_IO_STATS_SLOTS		4096
+#define TREE_IO_STATS_PROBES	8
+
+typedef struct
+{
+	pg_atomic_uint64 key;		/* datoid and relnode, zero if free */
+	pg_atomic_uint32 reloid;
+	pg_atomic_uint64 diskLoads;
+	pg_atomic_uint64 s3Loads;
+	pg_atomic_uint64 evictions;
+	pg_atomic_uint64 writes;
+	pg_atomic_uint64 bytesRead;
+	pg_atomic_uint64 bytesWritten;
+	pg_atomic_uint64 loadTime;	/* in microseconds */
+	pg_atomic_uint64 writeTime; /* in microseconds */
+} TreeIOStatsEntry;
+
+static TreeIOStatsEntry *treeIOStats = NULL;
+
+PG_FUNCTION_INFO_V1(orioledb_tree_io_stats);
+PG_FUNCTION_INFO_V1(orioledb_tree_io_stats_reset);
+
+Size
+tree_io_stats_shmem_needs(void)
+{
+	return mul_size(sizeof(TreeIOStatsEntry), TREE_IO_STATS_SLOTS);
+}
+
+static void
+tree_io_stats_clear_entry(TreeIOStatsEntry *entry)
+{
+	pg_atomic_write_u64(&entry->diskLoads, 0);
+	pg_atomic_write_u64(&entry->s3Loads, 0);
+	pg_atomic_write_u64(&entry->evictions, 0);
+	pg_atomic_write_u64(&entry->writes, 0);
+	pg_atomic_write_u64(&entry->bytesRead, 0);
+	pg_atomic_write_u64(&entry->bytesWritten, 0);
+	pg_atomic_write_u64(&entry->loadTime, 0);
+	pg_atomic_write_u64(&entry->writeTime, 0);
+	pg_atomic_write_u32(&entry->reloid, InvalidOid);
+	pg_atomic_write_u64(&entry->key, 0);
+}
+
+void
+tree_io_stats_shmem_init(Pointer ptr, bool found)
+{
+	int			i;
+
+	treeIOStats = (TreeIOStatsEntry *) ptr;
+
+	if (!found)
+	{
+		for (i = 0; i < TREE_IO_STATS_SLOTS; i++)
+		{
+			TreeIOStatsEntry *entry = &treeIOStats[i];
+
+			pg_atomic_init_u64(&entry->key, 0);
+			pg_atomic_init_u32(&entry->reloid, InvalidOid);
+			pg_atomic_init_u64(&entry->diskLoads, 0);
+			pg_atomic_init_u64(&entry->s3Loads, 0);
+			pg_atomic_init_u64(&entry->evictions, 0);
+			pg_atomic_init_u64(&entry->writes, 0);
+			pg_atomic_init_u64(&entry->bytesRead, 0);
+			pg_atomic_init_u64(&entry->bytesWritten, 0);
+			pg_atomic_init_u64(&entry->loadTime, 0);
+			pg_atomic_init_u64(&entry->writeTime, 0);
+		}
+	}
+}
+
+/*
+ * Finds or allocates the statistics slot for the tree.  'reloid' might be
+ * invalid when the caller knows only the tree relnode.
+ */
+static TreeIOStatsEntry *
+tree_io_stats_get_entry(Oid datoid, Oid reloid, Oid relnode)
+{
+	uint64		key;
+	uint32		pos;
+	int			i;
+
+	if (!OidIsValid(datoid) || !OidIsValid(relnode))
+		return NULL;
+
+	key = ((uint64) datoid << 32) | (uint64) relnode;
+	pos = hash_combine(murmurhash32(datoid), murmurhash32(relnode));
+
+	for (i = 0; i < TREE_IO_STATS_PROBES; i++)
+	{
+		TreeIOStatsEntry *entry;
+		uint64		curKey;
+
+		entry = &treeIOStats[(pos + i) % TREE_IO_STATS_SLOTS];
+		curKey = pg_atomic_read_u64(&entry->key);
+		if (curKey == 0 &&
+			pg_atomic_compare_exchange_u64(&entry->key, &curKey, key))
+			curKey = key;
+
+		if (curKey == key)
+		{
+			if (OidIsValid(reloid) &&
+				pg_atomic_read_u32(&entry->reloid) != reloid)
+				pg_atomic_write_u32(&entry->reloid, reloid);
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+static uint64
+elapsed_microsec(instr_time *start)
+{
+	instr_time	duration;
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, *start);
+	return INSTR_TIME_GET_MICROSEC(duration);
+}
+
+/*
+ * Accounts the page read from disk by load_page().
+ */
+void
+tree_io_stats_page_load(ORelOids oids, uint64 bytes, instr_time *start)
+{
+	TreeIOStatsEntry *entry;
+
+	entry = tree_io_stats_get_entry(oids.datoid, oids.reloid, oids.relnode);
+	if (!entry)
+		return;
+
+	pg_atomic_fetch_add_u64(&entry->diskLoads, 1);
+	pg_atomic_fetch_add_u64(&entry->bytesRead, bytes);
+	pg_atomic_fetch_add_u64(&entry->loadTime, elapsed_microsec(start));
+}
+
+/*
+ * Accounts the file part downloaded from S3 on behalf of the tree.
+ */
+void
+tree_io_stats_s3_load(Oid datoid, Oid relnode)
+{
+	TreeIOStatsEntry *entry;
+
+	entry = tree_io_stats_get_entry(datoid, InvalidOid, relnode);
+	if (entry)
+		pg_atomic_fetch_add_u64(&entry->s3Loads, 1);
+}
+
+/*
+ * Accounts the dirty page image written to disk.  'bytes' is the size of
+ * the possibly compressed image.
+ */
+void
+tree_io_stats_page_write(ORelOids oids, uint64 bytes, instr_time *start)
+{
+	TreeIOStatsEntry *entry;
+
+	entry = tree_io_stats_get_entry(oids.datoid, oids.reloid, oids.relnode);
+	if (!entry)
+		return;
+
+	pg_atomic_fetch_add_u64(&entry->writes, 1);
+	pg_atomic_fetch_add_u64(&entry->bytesWritten, bytes);
+	pg_atomic_fetch_add_u64(&entry->writeTime, elapsed_microsec(start));
+}
+
+/*
+ * Accounts the page evicted from the shared memory.
+ */
+void
+tree_io_stats_page_evict(ORelOids oids)
+{
+	TreeIOStatsEntry *entry;
+
+	entry = tree_io_stats_get_entry(oids.datoid, oids.reloid, oids.relnode);
+	if (entry)
+		pg_atomic_fetch_add_u64(&entry->evictions, 1);
+}
+
+/*
+ * Returns the I/O statistics for every accounted tree.
+ */
+Datum
+orioledb_tree_io_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Datum		values[12];
+	bool		nulls[12];
+	int			i;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+
+	orioledb_check_shmem();
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	for (i = 0; i < TREE_IO_STATS_SLOTS; i++)
+	{
+		TreeIOStatsEntry *entry = &treeIOStats[i];
+		uint64		key = pg_atomic_read_u64(&entry->key);
+		uint64		writes,
+					bytesWritten;
+		Oid			reloid;
+
+		if (key == 0)
+			continue;
+
+		MemSet(nulls, 0, sizeof(nulls));
+		reloid = pg_atomic_read_u32(&entry->reloid);
+		writes = pg_atomic_read_u64(&entry->writes);
+		bytesWritten = pg_atomic_read_u64(&entry->bytesWritten);
+
+		values[0] = ObjectIdGetDatum((Oid) (key >> 32));
+		values[1] = ObjectIdGetDatum(reloid);
+		nulls[1] = !OidIsValid(reloid);
+		values[2] = ObjectIdGetDatum((Oid) key);
+		values[3] = Int64GetDatum(pg_atomic_read_u64(&entry->diskLoads));
+		values[4] = Int64GetDatum(pg_atomic_read_u64(&entry->s3Loads));
+		values[5] = Int64GetDatum(pg_atomic_read_u64(&entry->evictions));
+		values[6] = Int64GetDatum(writes);
+		values[7] = Int64GetDatum(pg_atomic_read_u64(&entry->bytesRead));
+		values[8] = Int64GetDatum(bytesWritten);
+		/* Ratio of the page images size to the space they take on disk */
+		if (bytesWritten > 0)
+			values[9] = Float8GetDatum((double) writes * ORIOLEDB_BLCKSZ /
+									   (double) bytesWritten);
+		else
+			nulls[9] = true;
+		values[10] = Float8GetDatum((double) pg_atomic_read_u64(&entry->loadTime) / 1000.0);
+		values[11] = Float8GetDatum((double) pg_atomic_read_u64(&entry->writeTime) / 1000.0);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+Datum
+orioledb_tree_io_stats_reset(PG_FUNCTION_ARGS)
+{
+	int			i;
+
+	orioledb_check_shmem();
+
+	for (i = 0; i < TREE_IO_STATS_SLOTS; i++)
+		tree_io_stats_clear_entry(&treeIOStats[i]);
+
+	PG_RETURN_VOID();
+}
@@ -14,12 +14,16 @@
 
 #include "orioledb.h"
 
+#include "btree/ahi.h"
+#include "btree/bloom.h"
 #include "btree/btree.h"
 #include "btree/find.h"
 #include "btree/iterator.h"
+#include "btree/key_sample.h"
 #include "btree/page_chunks.h"
 #include "btree/undo.h"
 #include "catalog/sys_trees.h"
+#include "tableam/handler.h"
 #include "transam/oxid.h"
 #include "transam/undo.h"
 #include "utils/page_pool.h"
@@ -64,6 +68,8 @@ struct BTreeIterator
 	/* callback for fetching tuple version */
 	TupleFetchCallback fetchCallback;
 	void	   *fetchCallbackArg;
+	/* batch fetch reached the end of the scan */
+	bool		finished;
 #ifdef USE_ASSERT_CHECKING
 	/* additional check for iteration order */
 	OFixedTuple prevTuple;
@@ -73,6 +79,9 @@ struct BTreeIterator
 static void get_next_combined_location(BTreeIterator *it);
 static void load_page_from_undo(BTreeIterator *it, void *key, BTreeKeyType kind);
 static bool btree_iterator_check_load_next_page(BTreeIterator *it);
+static OTuple o_btree_iterator_page_step(BTreeIterator *it,
+										 CommitSeqNo *tupleCsn);
+static bool o_btree_iterator_page_has_items(BTreeIterator *it);
 static OTuple o_btree_iterator_fetch_internal(BTreeIterator *it,
 											  CommitSeqNo *tupleCsn);
 static bool o_btree_interator_can_fetch_from_undo(BTreeDescr *desc, BTreeIterator *it);
@@ -105,6 +114,25 @@ static void undo_it_find_internal(UndoIterator *undoIt, void *key, BTreeKeyType
 			BTREE_PAGE_LOCATOR_PREV((undoIt)->image, (loc)); \
 	} while (0); \
 
+/*
+ * Checks if the leaf image found by the context contains the tuple matching
+ * the given key.
+ */
+static bool
+o_btree_page_contains_key(BTreeDescr *desc, Page img,
+						  OBTreeFindPageContext *context,
+						  void *key, BTreeKeyType kind)
+{
+	BTreePageItemLocator *loc = &context->items[context->index].locator;
+	OTuple		curTuple;
+
+	if (!BTREE_PAGE_LOCATOR_IS_VALID(img, loc))
+		return false;
+
+	BTREE_PAGE_READ_LEAF_TUPLE(curTuple, img, loc);
+	return o_btree_cmp(desc, key, kind, &curTuple, BTreeKeyLeafTuple) == 0;
+}
+
 /*
  * Fetches tuple from the tree with given CSN snapshot.  Tuple is allocated
  * in the given context.  Leaf page is found using the given hint (if provided).
@@ -133,11 +161,62 @@ o_btree_find_tuple_by_key_cb(BTreeDescr *desc, void *key,
 						   combinedResult ? COMMITSEQNO_INPROGRESS : read_o_snapshot->csn,
 						   BTREE_PAGE_FIND_FETCH);
 
-	/* Use page location hint if provided */
+	/*
+	 * Use page location hint if provided.  Otherwise, try the leaf of the
+	 * previous lookup in this tree.
+	 */
 	if (hint && OInMemoryBlknoIsValid(hint->blkno))
+	{
 		refind_page(&context, key, kind, 0, hint->blkno, hint->pageChangeCount);
-	else
-		(void) find_page(&context, key, kind, 0);
+	}
+	else if (!btree_finger_find_page(&context, key, kind))
+	{
+		BTreeLocationHint ahiHint;
+		uint64		ahiTag = 0;
+		bool		useAhi,
+					found = false;
+
+		useAhi = ahi_get_tag(desc, key, kind, &ahiTag);
+		if (useAhi && ahi_lookup(desc, ahiTag, &ahiHint))
+		{
+			refind_page(&context, key, kind, 0, ahiHint.blkno,
+						ahiHint.pageChangeCount);
+
+			/*
+			 * The hint is only trustworthy when the leaf really contains the
+			 * key.  Otherwise, do the full descent.
+			 */
+			found = o_btree_page_contains_key(desc, img, &context, key, kind);
+		}
+
+		if (!found)
+		{
+			if (bloom_filter_key_hash(desc, key, kind, &context.keyHash))
+				BTREE_PAGE_FIND_SET(&context, SKIP_ABSENT);
+			(void) find_page(&context, key, kind, 0);
+
+			/* Evicted subtree, where the key should be, doesn't contain it */
+			if (BTREE_PAGE_FIND_IS(&context, KEY_ABSENT))
+			{
+				O_TUPLE_SET_NULL(result);
+				return result;
+			}
+			BTREE_PAGE_FIND_UNSET(&context, SKIP_ABSENT);
+
+			if (useAhi)
+				found = o_btree_page_contains_key(desc, img, &context, key, kind);
+		}
+
+		/* Remember (or refresh) the location of the found key */
+		if (found)
+		{
+			ahiHint.blkno = context.items[context.index].blkno;
+			ahiHint.pageChangeCount = context.items[context.index].pageChangeCount;
+			ahi_remember(ahiTag, &ahiHint);
+		}
+	}
+	btree_finger_remember(&context);
+	btree_key_sample(&context);
 
 	loc = context.items[context.index].locator;
 
@@ -223,13 +302,16 @@ o_btree_find_tuple_by_key(BTreeDescr *desc, void *key, BTreeKeyType kind,
 
 
 /*
- * Finds appropriate tuple version in the undo chain.
+ * Finds appropriate tuple version in the undo chain.  If 'allocated' is
+ * given, the current version of the tuple isn't copied: the result points
+ * into the page image, and *allocated is set to false.
  */
-OTuple
-o_find_tuple_version(BTreeDescr *desc, Page p, BTreePageItemLocator *loc,
-					 OSnapshot *oSnapshot, CommitSeqNo *tupleCsn,
-					 MemoryContext mcxt, TupleFetchCallback cb,
-					 void *arg)
+static OTuple
+o_find_tuple_version_internal(BTreeDescr *desc, Page p,
+							  BTreePageItemLocator *loc,
+							  OSnapshot *oSnapshot, CommitSeqNo *tupleCsn,
+							  MemoryContext mcxt, TupleFetchCallback cb,
+							  void *arg, bool *allocated)
 {
 	BTreeLeafTuphdr tupHdr,
 			   *tupHdrPtr;
@@ -239,6 +321,7 @@ o_find_tuple_version(BTreeDescr *desc, Page p, BTreePageItemLocator *loc,
 	UndoLocation undoLocation = InvalidUndoLocation;
 	bool		curTupleAllocated = false;
 	MemoryContext prevMctx;
+	bool		allVisible = O_PAGE_IS(p, ALL_VISIBLE) && !cb;
 
 	prevMctx = MemoryContextSwitchTo(mcxt);
 
@@ -256,6 +339,17 @@ o_find_tuple_version(BTreeDescr *desc, Page p, BTreePageItemLocator *loc,
 		CommitSeqNo tupcsn;
 		XLogRecPtr	tupptr;
 
+		/*
+		 * Every tuple of the all-visible page is frozen for any snapshot.  So,
+		 * the current version is the one we need.
+		 */
+		if (allVisible)
+		{
+			if (tupleCsn)
+				*tupleCsn = COMMITSEQNO_IS_NORMAL(oSnapshot->csn) ? oSnapshot->csn : COMMITSEQNO_MAX_NORMAL - 1;
+			break;
+		}
+
 		oxid_match_snapshot(XACT_INFO_GET_OXID(xactInfo), oSnapshot,
 							&tupcsn, &tupptr);
 		if (tupleCsn)
@@ -344,6 +438,8 @@ o_find_tuple_version(BTreeDescr *desc, Page p, BTreePageItemLocator *loc,
 			return result;
 		}
 
+		EA_UNDO_INC(desc);
+
 		if (tupHdr.deleted != BTreeLeafTupleNonDeleted ||
 			XACT_INFO_IS_LOCK_ONLY(tupHdr.xactInfo))
 		{
@@ -351,10 +447,13 @@ o_find_tuple_version(BTreeDescr *desc, Page p, BTreePageItemLocator *loc,
 		}
 		else
 		{
-			if (curTupleAllocated)
-				pfree(curTuple.data);
+			Pointer		nextTupleData = curTuple.data;
+
+			/* The next version is needed to apply delta undo records */
 			get_prev_leaf_header_and_tuple_from_undo(desc->undoType, &tupHdr,
 													 &curTuple, 0);
+			if (curTupleAllocated)
+				pfree(nextTupleData);
 			curTupleAllocated = true;
 		}
 
@@ -378,7 +477,14 @@ o_find_tuple_version(BTreeDescr *desc, Page p, BTreePageItemLocator *loc,
 		return result;
 	}
 
-	if (!curTupleAllocated)
+	if (allocated)
+		*allocated = curTupleAllocated;
+
+	if (!curTupleAllocated && allocated)
+	{
+		result = curTuple;
+	}
+	else if (!curTupleAllocated)
 	{
 		result_size = o_btree_len(desc, curTuple, OTupleLength);
 		/* TODO: check result tuple size */
@@ -396,6 +502,31 @@ o_find_tuple_version(BTreeDescr *desc, Page p, BTreePageItemLocator *loc,
 	return result;
 }
 
+OTuple
+o_find_tuple_version(BTreeDescr *desc, Page p, BTreePageItemLocator *loc,
+					 OSnapshot *oSnapshot, CommitSeqNo *tupleCsn,
+					 MemoryContext mcxt, TupleFetchCallback cb,
+					 void *arg)
+{
+	return o_find_tuple_version_internal(desc, p, loc, oSnapshot, tupleCsn,
+										 mcxt, cb, arg, NULL);
+}
+
+/*
+ * Same as o_find_tuple_version(), but the current version of the tuple is
+ * returned as a pointer into 'p'.  That is useful for private page images,
+ * whose lifetime is controlled by the caller.  *allocated is set if the
+ * result is allocated in mcxt.
+ */
+OTuple
+o_find_tuple_version_ref(BTreeDescr *desc, Page p, BTreePageItemLocator *loc,
+						 OSnapshot *oSnapshot, CommitSeqNo *tupleCsn,
+						 MemoryContext mcxt, bool *allocated)
+{
+	return o_find_tuple_version_internal(desc, p, loc, oSnapshot, tupleCsn,
+										 mcxt, NULL, NULL, allocated);
+}
+
 BTreeIterator *
 o_btree_iterator_create(BTreeDescr *desc, void *key, BTreeKeyType kind,
 						OSnapshot *o_snapshot, ScanDirection scanDir)
@@ -411,6 +542,7 @@ o_btree_iterator_create(BTreeDescr *desc, void *key, BTreeKeyType kind,
 	it->tupleCxt = CurrentMemoryContext;
 	it->fetchCallback = NULL;
 	it->fetchCallbackArg = NULL;
+	it->finished = false;
 	BTREE_PAGE_LOCATOR_SET_INVALID(&it->undoLoc);
 #ifdef USE_ASSERT_CHECKING
 	O_TUPLE_SET_NULL(it->prevTuple.tuple);
@@ -469,6 +601,45 @@ o_btree_iterator_create(BTreeDescr *desc, void *key, BTreeKeyType kind,
 	return it;
 }
 
+/*
+ * Restarts the forward iterator from the given key.  The leaf page where
+ * the iterator has stopped is reused if the key belongs to it.  That saves
+ * the descent from the root for the rescans with monotonically advancing
+ * keys.
+ */
+void
+o_btree_iterator_rescan(BTreeIterator *it, void *key, BTreeKeyType kind)
+{
+	BTreeDescr *desc = it->context.desc;
+	bool		combinedResult;
+
+	Assert(IT_IS_FORWARD(it) && key != NULL);
+
+	it->finished = false;
+	BTREE_PAGE_LOCATOR_SET_INVALID(&it->undoLoc);
+#ifdef USE_ASSERT_CHECKING
+	O_TUPLE_SET_NULL(it->prevTuple.tuple);
+#endif
+
+	/* Our transaction might start writing since the previous scan */
+	combinedResult = !have_current_undo(desc->undoType) &&
+		COMMITSEQNO_IS_NORMAL(it->oSnapshot.csn);
+	if (combinedResult != it->combinedResult)
+	{
+		it->combinedResult = combinedResult;
+		init_page_find_context(&it->context, desc,
+							   combinedResult ? COMMITSEQNO_INPROGRESS : it->oSnapshot.csn,
+							   BTREE_PAGE_FIND_IMAGE);
+		find_page(&it->context, key, kind, 0);
+	}
+	else
+	{
+		find_page_from_leaf(&it->context, key, kind);
+	}
+
+	load_page_from_undo(it, key, kind);
+}
+
 void
 o_btree_iterator_set_tuple_ctx(BTreeIterator *it, MemoryContext tupleCxt)
 {
@@ -484,46 +655,128 @@ o_btree_iterator_set_callback(BTreeIterator *it,
 	it->fetchCallbackArg = arg;
 }
 
+/*
+ * Checks if the tuple fetched by the iterator is beyond the end bound.
+ */
+static inline bool
+o_btree_iterator_is_beyond_end(BTreeIterator *it, OTuple tuple,
+							   void *end, BTreeKeyType endType,
+							   bool endIsIncluded)
+{
+	int			cmp;
+
+	if (end == NULL)
+		return false;
+
+	cmp = o_btree_cmp(it->context.desc, &tuple, BTreeKeyLeafTuple, end, endType);
+	if (IT_IS_BACKWARD(it))
+		cmp *= -1;
+
+	return cmp >= (endIsIncluded ? 1 : 0);
+}
+
+#ifdef USE_ASSERT_CHECKING
+static void
+o_btree_iterator_check_order(BTreeIterator *it, OTuple tuple)
+{
+	BTreeDescr *desc = it->context.desc;
+
+	if (!O_TUPLE_IS_NULL(it->prevTuple.tuple))
+	{
+		int			cmp;
+
+		cmp = o_btree_cmp(desc, &it->prevTuple.tuple, BTreeKeyLeafTuple,
+						  &tuple, BTreeKeyLeafTuple);
+
+		Assert((IT_IS_FORWARD(it) && cmp < 0) || cmp > 0);
+	}
+	copy_fixed_tuple(desc, &it->prevTuple, tuple);
+}
+#endif
+
 OTuple
 o_btree_iterator_fetch(BTreeIterator *it, CommitSeqNo *tupleCsn,
 					   void *end, BTreeKeyType endType,
 					   bool endIsIncluded, BTreeLocationHint *hint)
 {
-	BTreeDescr *desc = it->context.desc;
 	OTuple		result;
 
 	result = o_btree_iterator_fetch_internal(it, tupleCsn);
 
-	if (!O_TUPLE_IS_NULL(result) && end != NULL)
+	if (!O_TUPLE_IS_NULL(result) &&
+		o_btree_iterator_is_beyond_end(it, result, end, endType, endIsIncluded))
 	{
-		int			cmp = o_btree_cmp(desc, &result, BTreeKeyLeafTuple, end, endType);
-
-		if (IT_IS_BACKWARD(it))
-			cmp *= -1;
-
-		if (cmp >= (endIsIncluded ? 1 : 0))
-		{
-			pfree(result.data);
-			O_TUPLE_SET_NULL(result);
-			return result;
-		}
+		pfree(result.data);
+		O_TUPLE_SET_NULL(result);
+		return result;
 	}
 
 #ifdef USE_ASSERT_CHECKING
 	if (!O_TUPLE_IS_NULL(result))
+		o_btree_iterator_check_order(it, result);
+#endif
+
+	if (hint)
 	{
-		if (!O_TUPLE_IS_NULL(it->prevTuple.tuple))
-		{
-			int			cmp;
+		hint->blkno = it->context.items[it->context.index].blkno;
+		hint->pageChangeCount = it->context.items[it->context.index].pageChangeCount;
+	}
+
+	return result;
+}
 
-			cmp = o_btree_cmp(desc, &it->prevTuple.tuple, BTreeKeyLeafTuple,
-							  &result, BTreeKeyLeafTuple);
+/*
+ * Fetches up to `maxTuples` visible tuples from the current page image (and
+ * its undo image if the result is combined) into the caller-provided arrays.
+ * The next page is loaded only once the current one is exhausted, so the
+ * per-tuple page checks of o_btree_iterator_fetch() are avoided.
+ *
+ * All the returned tuples belong to the same leaf page, so a single `hint`
+ * is reported for the whole batch.  `tupleCsns` might be NULL.  Returns the
+ * number of fetched tuples, zero means the end of the scan.  The iterator
+ * shouldn't be used with o_btree_iterator_fetch() after that.
+ */
+int
+o_btree_iterator_fetch_batch(BTreeIterator *it, OTuple *tuples,
+							 CommitSeqNo *tupleCsns, int maxTuples,
+							 void *end, BTreeKeyType endType,
+							 bool endIsIncluded, BTreeLocationHint *hint)
+{
+	int			n = 0;
 
-			Assert((IT_IS_FORWARD(it) && cmp < 0) || cmp > 0);
+	Assert(maxTuples > 0);
+
+	while (n == 0 && !it->finished)
+	{
+		if (!btree_iterator_check_load_next_page(it))
+		{
+			it->finished = true;
+			break;
 		}
-		copy_fixed_tuple(desc, &it->prevTuple, result);
-	}
+
+		do
+		{
+			OTuple		result;
+
+			result = o_btree_iterator_page_step(it,
+												tupleCsns ? &tupleCsns[n] : NULL);
+			if (O_TUPLE_IS_NULL(result))
+				continue;
+
+			if (o_btree_iterator_is_beyond_end(it, result, end, endType,
+											   endIsIncluded))
+			{
+				pfree(result.data);
+				it->finished = true;
+				break;
+			}
+
+#ifdef USE_ASSERT_CHECKING
+			o_btree_iterator_check_order(it, result);
 #endif
+			tuples[n++] = result;
+		} while (n < maxTuples && o_btree_iterator_page_has_items(it));
+	}
 
 	if (hint)
 	{
@@ -531,7 +784,23 @@ o_btree_iterator_fetch(BTreeIterator *it, CommitSeqNo *tupleCsn,
 		hint->pageChangeCount = it->context.items[it->context.index].pageChangeCount;
 	}
 
-	return result;
+	return n;
+}
+
+/*
+ * Copies the hikey of the page the iterator currently points to.  Returns
+ * false if it's the rightmost page.
+ */
+bool
+o_btree_iterator_get_hikey(BTreeIterator *it, OFixedKey *hikey)
+{
+	Page		img = it->context.img;
+
+	if (O_PAGE_IS(img, RIGHTMOST))
+		return false;
+
+	copy_fixed_hikey(it->context.desc, hikey, img);
+	return true;
 }
 
 /*
@@ -635,10 +904,13 @@ get_next_combined_location(BTreeIterator *it)
 }
 
 /*
- * Fetch next tuple without checking for end condition.
+ * Makes one step over the current page image (and its undo image if the
+ * result is combined).  Returns the visible version of the tuple under the
+ * current location or a null tuple if it has no visible version.  The caller
+ * must ensure there are items to step over.
  */
 static OTuple
-o_btree_iterator_fetch_internal(BTreeIterator *it, CommitSeqNo *tupleCsn)
+o_btree_iterator_page_step(BTreeIterator *it, CommitSeqNo *tupleCsn)
 {
 	BTreeDescr *desc = it->context.desc;
 	OBTreeFindPageContext *context = &it->context;
@@ -650,79 +922,102 @@ o_btree_iterator_fetch_internal(BTreeIterator *it, CommitSeqNo *tupleCsn)
 				htup;
 	int			cmp;
 
-	while (true)
+	leaf_item = &context->items[context->index];
+
+	if (it->combinedPage)
 	{
-		if (!btree_iterator_check_load_next_page(it))
+		if (!BTREE_PAGE_LOCATOR_IS_VALID(hImg, &it->undoLoc))
+			cmp = -1;
+		else if (!BTREE_PAGE_LOCATOR_IS_VALID(img, &leaf_item->locator))
+			cmp = 1;
+		else
 		{
-			O_TUPLE_SET_NULL(result);
-			return result;
+			BTREE_PAGE_READ_LEAF_TUPLE(itup, img, &leaf_item->locator);
+			BTREE_PAGE_READ_LEAF_TUPLE(htup, hImg, &it->undoLoc);
+			cmp = o_btree_cmp(desc, &itup, BTreeKeyLeafTuple, &htup, BTreeKeyLeafTuple);
+			if (IT_IS_BACKWARD(it))
+				cmp *= -1;		/* mirror compare logic */
 		}
 
-		leaf_item = &context->items[context->index];
-
-		if (it->combinedPage)
+		if (cmp <= 0)
 		{
-			if (!BTREE_PAGE_LOCATOR_IS_VALID(hImg, &it->undoLoc))
-				cmp = -1;
-			else if (!BTREE_PAGE_LOCATOR_IS_VALID(img, &leaf_item->locator))
-				cmp = 1;
-			else
-			{
-				BTREE_PAGE_READ_LEAF_TUPLE(itup, img, &leaf_item->locator);
-				BTREE_PAGE_READ_LEAF_TUPLE(htup, hImg, &it->undoLoc);
-				cmp = o_btree_cmp(desc, &itup, BTreeKeyLeafTuple, &htup, BTreeKeyLeafTuple);
-				if (IT_IS_BACKWARD(it))
-					cmp *= -1;	/* mirror compare logic */
-			}
-
-			if (cmp <= 0)
-			{
-				result = o_find_tuple_version(desc, img,
-											  &leaf_item->locator,
-											  &it->oSnapshot, tupleCsn,
-											  it->tupleCxt,
-											  it->fetchCallback,
-											  it->fetchCallbackArg);
-
-				IT_NEXT_OFFSET(it, &leaf_item->locator);
-
-				get_next_combined_location(it);
+			result = o_find_tuple_version(desc, img,
+										  &leaf_item->locator,
+										  &it->oSnapshot, tupleCsn,
+										  it->tupleCxt,
+										  it->fetchCallback,
+										  it->fetchCallbackArg);
 
-				if (cmp == 0)
-					UNDO_IT_NEXT_OFFSET(&it->undoIt, &it->undoLoc);
+			IT_NEXT_OFFSET(it, &leaf_item->locator);
 
-				if (!O_TUPLE_IS_NULL(result))
-					return result;
-			}
-			else
-			{
-				result = o_find_tuple_version(desc, hImg,
-											  &it->undoLoc,
-											  &it->oSnapshot, tupleCsn,
-											  it->tupleCxt,
-											  it->fetchCallback,
-											  it->fetchCallbackArg);
+			get_next_combined_location(it);
 
+			if (cmp == 0)
 				UNDO_IT_NEXT_OFFSET(&it->undoIt, &it->undoLoc);
-
-				if (!O_TUPLE_IS_NULL(result))
-					return result;
-			}
 		}
 		else
 		{
-			result = o_find_tuple_version(desc, context->img,
-										  &leaf_item->locator,
+			result = o_find_tuple_version(desc, hImg,
+										  &it->undoLoc,
 										  &it->oSnapshot, tupleCsn,
 										  it->tupleCxt,
 										  it->fetchCallback,
 										  it->fetchCallbackArg);
 
-			IT_NEXT_OFFSET(it, &leaf_item->locator);
+			UNDO_IT_NEXT_OFFSET(&it->undoIt, &it->undoLoc);
+		}
+	}
+	else
+	{
+		result = o_find_tuple_version(desc, context->img,
+									  &leaf_item->locator,
+									  &it->oSnapshot, tupleCsn,
+									  it->tupleCxt,
+									  it->fetchCallback,
+									  it->fetchCallbackArg);
+
+		IT_NEXT_OFFSET(it, &leaf_item->locator);
+	}
 
-			if (!O_TUPLE_IS_NULL(result))
-				return result;
+	return result;
+}
+
+/*
+ * Checks if the current page image still has items to step over without
+ * loading the next page.  Mirrors the checks of
+ * btree_iterator_check_load_next_page().
+ */
+static bool
+o_btree_iterator_page_has_items(BTreeIterator *it)
+{
+	OBTreeFindPageContext *context = &it->context;
+
+	if (o_btree_interator_can_fetch_from_undo(context->desc, it))
+		return true;
+
+	return BTREE_PAGE_LOCATOR_IS_VALID(context->img,
+									   &context->items[context->index].locator);
+}
+
+/*
+ * Fetch next tuple without checking for end condition.
+ */
+static OTuple
+o_btree_iterator_fetch_internal(BTreeIterator *it, CommitSeqNo *tupleCsn)
+{
+	OTuple		result;
+
+	while (true)
+	{
+		if (!btree_iterator_check_load_next_page(it))
+		{
+			O_TUPLE_SET_NULL(result);
+			return result;
 		}
+
+		result = o_btree_iterator_page_step(it, tupleCsn);
+		if (!O_TUPLE_IS_NULL(result))
+			return result;
 	}
 
 	O_TUPLE_SET_NULL(result);
@@ -0,0 +1,529 @@
+/*-------------------------------------------------------------------------
+ *
+ * key_sample.c
+ *		Sampling of the keys accessed by lookups and modifications.
+ *
+ * Copyright (c) 2025-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/btree/key_sample.c
+ *
+ * NOTES
+ *
+ *		Each backend samples one of orioledb.key_sample_rate positionings of
+ *		the point lookups and modifications to the leaf.  The sampled key is
+ *		the key of the leaf tuple the lookup has landed on.  Samples are
+ *		accounted in the shared sketch of the tree: a count-min sketch, the
+ *		top keys by the sketch estimate and a uniform reservoir of the
+ *		sampled keys.  The reservoir is mapped to the downlinks of the root
+ *		page only when the histogram is requested, so it follows the splits
+ *		of the root.
+ *
+ *		There are few sketches, trees take them on first sample like the
+ *		tree I/O statistics slots.  Keys longer than KEY_SAMPLE_KEY_SIZE
+ *		aren't sampled.  The sketches are released only by
+ *		orioledb_key_sample_reset().
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "btree/btree.h"
+#include "btree/key_sample.h"
+#include "btree/page_contents.h"
+#include "btree/page_state.h"
+#include "catalog/sys_trees.h"
+#include "tableam/descr.h"
+
+#include "access/relation.h"
+#include "catalog/pg_class.h"
+#include "common/hashfn.h"
+#include "common/pg_prng.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "storage/spin.h"
+#include "utils/jsonb.h"
+#include "utils/rel.h"
+#include "utils/tuplestore.h"
+
+#define KEY_SAMPLE_TREES		8
+#define KEY_SAMPLE_CM_DEPTH		4
+#define KEY_SAMPLE_CM_WIDTH		1024
+#define KEY_SAMPLE_TOP_KEYS		32
+#define KEY_SAMPLE_RESERVOIR	256
+#define KEY_SAMPLE_KEY_SIZE		128
+
+typedef struct
+{
+	uint16		len;
+	uint8		formatFlags;
+	char		data[KEY_SAMPLE_KEY_SIZE];
+} KeySampleKey;
+
+typedef struct
+{
+	uint32		hash;
+	uint64		count;
+	KeySampleKey key;
+} KeySampleTopEntry;
+
+typedef struct
+{
+	pg_atomic_uint64 key;		/* datoid and relnode, zero if free */
+	slock_t		lock;
+	uint64		samples;
+	uint32		sketch[KEY_SAMPLE_CM_DEPTH][KEY_SAMPLE_CM_WIDTH];
+	int			nTop;
+	KeySampleTopEntry top[KEY_SAMPLE_TOP_KEYS];
+	int			nReservoir;
+	KeySampleKey reservoir[KEY_SAMPLE_RESERVOIR];
+} KeySampleTree;
+
+int			key_sample_rate = 0;
+uint32		keySampleCounter = 0;
+
+static KeySampleTree *keySampleTrees = NULL;
+
+PG_FUNCTION_INFO_V1(orioledb_key_sample_top);
+PG_FUNCTION_INFO_V1(orioledb_key_sample_histogram);
+PG_FUNCTION_INFO_V1(orioledb_key_sample_reset);
+
+Size
+key_sample_shmem_needs(void)
+{
+	return mul_size(sizeof(KeySampleTree), KEY_SAMPLE_TREES);
+}
+
+static void
+key_sample_clear_tree(KeySampleTree *tree)
+{
+	SpinLockAcquire(&tree->lock);
+	tree->samples = 0;
+	memset(tree->sketch, 0, sizeof(tree->sketch));
+	tree->nTop = 0;
+	tree->nReservoir = 0;
+	pg_atomic_write_u64(&tree->key, 0);
+	SpinLockRelease(&tree->lock);
+}
+
+void
+key_sample_shmem_init(Pointer ptr, bool found)
+{
+	int			i;
+
+	keySampleTrees = (KeySampleTree *) ptr;
+
+	if (!found)
+	{
+		for (i = 0; i < KEY_SAMPLE_TREES; i++)
+		{
+			KeySampleTree *tree = &keySampleTrees[i];
+
+			pg_atomic_init_u64(&tree->key, 0);
+			SpinLockInit(&tree->lock);
+			tree->samples = 0;
+			memset(tree->sketch, 0, sizeof(tree->sketch));
+			tree->nTop = 0;
+			tree->nReservoir = 0;
+		}
+	}
+}
+
+/*
+ * Finds the sketch of the tree.  Takes a free one if 'alloc' is true.
+ */
+static KeySampleTree *
+key_sample_get_tree(Oid datoid, Oid relnode, bool alloc)
+{
+	uint64		key = ((uint64) datoid << 32) | (uint64) relnode;
+	int			i;
+
+	for (i = 0; i < KEY_SAMPLE_TREES; i++)
+	{
+		KeySampleTree *tree = &keySampleTrees[i];
+		uint64		curKey = pg_atomic_read_u64(&tree->key);
+
+		if (curKey == 0 && alloc &&
+			pg_atomic_compare_exchange_u64(&tree->key, &curKey, key))
+			curKey = key;
+
+		if (curKey == key)
+			return tree;
+	}
+	return NULL;
+}
+
+static inline bool
+key_sample_keys_equal(KeySampleKey *a, KeySampleKey *b)
+{
+	return a->len == b->len && a->formatFlags == b->formatFlags &&
+		memcmp(a->data, b->data, a->len) == 0;
+}
+
+/*
+ * Accounts the key of the leaf tuple the context is positioned to.
+ */
+void
+btree_key_sample_take(OBTreeFindPageContext *context)
+{
+	BTreeDescr *desc = context->desc;
+	OBtreePageFindItem *item = &context->items[context->index];
+	KeySampleTree *tree;
+	KeySampleKey sample;
+	OFixedKey	keyData;
+	OTuple		tuple,
+				key;
+	Page		p;
+	uint32		hash,
+				estimate = PG_UINT32_MAX;
+	bool		allocated;
+	int			i,
+				minIndex = -1;
+
+	if (keySampleTrees == NULL || desc->type == oIndexToast ||
+		desc->type == oIndexInvalid || IS_SYS_TREE_OIDS(desc->oids))
+		return;
+
+	if (BTREE_PAGE_FIND_IS(context, MODIFY))
+		p = O_GET_IN_MEMORY_PAGE(item->blkno);
+	else
+		p = context->img;
+
+	if (!O_PAGE_IS(p, LEAF) || !BTREE_PAGE_LOCATOR_IS_VALID(p, &item->locator))
+		return;
+
+	BTREE_PAGE_READ_LEAF_TUPLE(tuple, p, &item->locator);
+	key = o_btree_tuple_make_key(desc, tuple, keyData.fixedData, false,
+								 &allocated);
+	Assert(!allocated);
+	sample.len = o_btree_len(desc, key, OKeyLength);
+	if (sample.len > KEY_SAMPLE_KEY_SIZE)
+		return;
+	sample.formatFlags = key.formatFlags;
+	memcpy(sample.data, key.data, sample.len);
+	hash = hash_bytes((unsigned char *) sample.data, sample.len);
+
+	tree = key_sample_get_tree(desc->oids.datoid, desc->oids.relnode, true);
+	if (tree == NULL)
+		return;
+
+	SpinLockAcquire(&tree->lock);
+	tree->samples++;
+
+	for (i = 0; i < KEY_SAMPLE_CM_DEPTH; i++)
+	{
+		uint32		pos = hash_combine(hash, i) % KEY_SAMPLE_CM_WIDTH;
+
+		estimate = Min(estimate, ++tree->sketch[i][pos]);
+	}
+
+	/* Keep the keys with the highest estimates */
+	for (i = 0; i < tree->nTop; i++)
+	{
+		KeySampleTopEntry *entry = &tree->top[i];
+
+		if (entry->hash == hash && key_sample_keys_equal(&entry->key, &sample))
+			break;
+		if (minIndex < 0 || entry->count < tree->top[minIndex].count)
+			minIndex = i;
+	}
+	if (i < tree->nTop)
+	{
+		tree->top[i].count = estimate;
+	}
+	else
+	{
+		if (tree->nTop < KEY_SAMPLE_TOP_KEYS)
+			i = tree->nTop++;
+		else if (tree->top[minIndex].count < estimate)
+			i = minIndex;
+		else
+			i = -1;
+
+		if (i >= 0)
+		{
+			tree->top[i].hash = hash;
+			tree->top[i].count = estimate;
+			tree->top[i].key = sample;
+		}
+	}
+
+	/* Uniform reservoir of all the samples */
+	if (tree->nReservoir < KEY_SAMPLE_RESERVOIR)
+	{
+		tree->reservoir[tree->nReservoir++] = sample;
+	}
+	else
+	{
+		uint64		pos = pg_prng_uint64_range(&pg_global_prng_state, 0,
+											   tree->samples - 1);
+
+		if (pos < KEY_SAMPLE_RESERVOIR)
+			tree->reservoir[pos] = sample;
+	}
+	SpinLockRelease(&tree->lock);
+}
+
+/*
+ * Returns the index descriptor for the index, or the primary index
+ * descriptor for the table.
+ */
+static OIndexDescr *
+key_sample_get_index(Oid relid)
+{
+	Relation	rel;
+	ORelOids	oids;
+	OTableDescr *descr;
+	bool		index = false;
+	int			i;
+
+	rel = relation_open(relid, AccessShareLock);
+	if (rel->rd_rel->relkind == RELKIND_INDEX)
+	{
+		Oid			tableOid = rel->rd_index->indrelid;
+
+		relation_close(rel, NoLock);
+		rel = relation_open(tableOid, AccessShareLock);
+		index = true;
+	}
+
+	if (!is_orioledb_rel(rel))
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("\"%s\" is not an orioledb table",
+						RelationGetRelationName(rel))));
+
+	ORelOidsSetFromRel(oids, rel);
+	descr = o_fetch_table_descr(oids);
+	relation_close(rel, NoLock);
+
+	if (!index)
+		return GET_PRIMARY(descr);
+
+	for (i = 0; i < descr->nIndices; i++)
+	{
+		if (descr->indices[i]->oids.reloid == relid)
+			return descr->indices[i];
+	}
+	elog(ERROR, "index %u is not found", relid);
+	return NULL;				/* keep compiler quiet */
+}
+
+static Datum
+key_sample_key_to_jsonb(BTreeDescr *desc, KeySampleKey *sample)
+{
+	JsonbParseState *state = NULL;
+	OFixedKey	key;
+
+	memcpy(key.fixedData, sample->data, sample->len);
+	key.tuple.data = key.fixedData;
+	key.tuple.formatFlags = sample->formatFlags;
+	return PointerGetDatum(JsonbValueToJsonb(o_btree_key_to_jsonb(desc,
+																  key.tuple,
+																  &state)));
+}
+
+static int
+key_sample_top_cmp(const void *a, const void *b)
+{
+	uint64		countA = ((const KeySampleTopEntry *) a)->count;
+	uint64		countB = ((const KeySampleTopEntry *) b)->count;
+
+	if (countA != countB)
+		return countA > countB ? -1 : 1;
+	return 0;
+}
+
+static void
+key_sample_init_srf(FunctionCallInfo fcinfo)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	MemoryContext oldcontext;
+
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * Returns the most often sampled keys of the tree with the count-min sketch
+ * estimates of their samples.
+ */
+Datum
+orioledb_key_sample_top(PG_FUNCTION_ARGS)
+{
+	Oid			relid = PG_GETARG_OID(0);
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	OIndexDescr *id;
+	KeySampleTree *tree;
+	KeySampleTopEntry *top;
+	int			nTop = 0,
+				i;
+
+	orioledb_check_shmem();
+	key_sample_init_srf(fcinfo);
+
+	id = key_sample_get_index(relid);
+	tree = key_sample_get_tree(id->desc.oids.datoid, id->desc.oids.relnode,
+							   false);
+	if (tree == NULL)
+		return (Datum) 0;
+
+	top = (KeySampleTopEntry *) palloc(sizeof(tree->top));
+	SpinLockAcquire(&tree->lock);
+	if (pg_atomic_read_u64(&tree->key) != 0)
+	{
+		nTop = tree->nTop;
+		memcpy(top, tree->top, sizeof(KeySampleTopEntry) * nTop);
+	}
+	SpinLockRelease(&tree->lock);
+
+	qsort(top, nTop, sizeof(KeySampleTopEntry), key_sample_top_cmp);
+
+	for (i = 0; i < nTop; i++)
+	{
+		Datum		values[2];
+		bool		nulls[2] = {false, false};
+
+		values[0] = key_sample_key_to_jsonb(&id->desc, &top[i].key);
+		values[1] = Int64GetDatum(top[i].count);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * Returns the number of the reservoir samples falling into the key range of
+ * each downlink of the root page.
+ */
+Datum
+orioledb_key_sample_histogram(PG_FUNCTION_ARGS)
+{
+	Oid			relid = PG_GETARG_OID(0);
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	OIndexDescr *id;
+	BTreeDescr *desc;
+	KeySampleTree *tree;
+	KeySampleKey *reservoir;
+	OTuple	   *downlinkKeys;
+	uint64	   *counts;
+	BTreePageItemLocator loc;
+	OInMemoryBlkno rootBlkno;
+	char		img[ORIOLEDB_BLCKSZ];
+	int			nReservoir = 0,
+				nDownlinks,
+				i;
+
+	orioledb_check_shmem();
+	key_sample_init_srf(fcinfo);
+
+	id = key_sample_get_index(relid);
+	desc = &id->desc;
+	tree = key_sample_get_tree(desc->oids.datoid, desc->oids.relnode, false);
+	if (tree == NULL)
+		return (Datum) 0;
+
+	reservoir = (KeySampleKey *) palloc(sizeof(tree->reservoir));
+	SpinLockAcquire(&tree->lock);
+	if (pg_atomic_read_u64(&tree->key) != 0)
+	{
+		nReservoir = tree->nReservoir;
+		memcpy(reservoir, tree->reservoir, sizeof(KeySampleKey) * nReservoir);
+	}
+	SpinLockRelease(&tree->lock);
+
+	o_btree_load_shmem(desc);
+	rootBlkno = desc->rootInfo.rootPageBlkno;
+	lock_page(rootBlkno);
+	memcpy(img, O_GET_IN_MEMORY_PAGE(rootBlkno), ORIOLEDB_BLCKSZ);
+	unlock_page(rootBlkno);
+
+	/* The leftmost downlink has no key */
+	nDownlinks = O_PAGE_IS(img, LEAF) ? 1 : BTREE_PAGE_ITEMS_COUNT(img);
+	downlinkKeys = (OTuple *) palloc0(sizeof(OTuple) * nDownlinks);
+	counts = (uint64 *) palloc0(sizeof(uint64) * nDownlinks);
+	if (!O_PAGE_IS(img, LEAF))
+	{
+		i = 0;
+		BTREE_PAGE_FOREACH_ITEMS(img, &loc)
+		{
+			if (i > 0)
+				BTREE_PAGE_READ_INTERNAL_TUPLE(downlinkKeys[i], img, &loc);
+			i++;
+		}
+	}
+
+	for (i = 0; i < nReservoir; i++)
+	{
+		OFixedKey	key;
+		int			low = 1,
+					high = nDownlinks;
+
+		memcpy(key.fixedData, reservoir[i].data, reservoir[i].len);
+		key.tuple.data = key.fixedData;
+		key.tuple.formatFlags = reservoir[i].formatFlags;
+
+		/* Find the last downlink, whose key isn't greater than the sample */
+		while (low < high)
+		{
+			int			mid = low + (high - low) / 2;
+
+			if (o_btree_cmp(desc, &key.tuple, BTreeKeyNonLeafKey,
+							&downlinkKeys[mid], BTreeKeyNonLeafKey) >= 0)
+				low = mid + 1;
+			else
+				high = mid;
+		}
+		counts[low - 1]++;
+	}
+
+	for (i = 0; i < nDownlinks; i++)
+	{
+		Datum		values[3];
+		bool		nulls[3] = {false, false, false};
+		JsonbParseState *state = NULL;
+
+		if (i > 0)
+			values[0] = PointerGetDatum(JsonbValueToJsonb(o_btree_key_to_jsonb(desc,
+																			   downlinkKeys[i],
+																			   &state)));
+		else
+			nulls[0] = true;
+		state = NULL;
+		if (i + 1 < nDownlinks)
+			values[1] = PointerGetDatum(JsonbValueToJsonb(o_btree_key_to_jsonb(desc,
+																			   downlinkKeys[i + 1],
+																			   &state)));
+		else
+			nulls[1] = true;
+		values[2] = Int64GetDatum(counts[i]);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+Datum
+orioledb_key_sample_reset(PG_FUNCTION_ARGS)
+{
+	int			i;
+
+	orioledb_check_shmem();
+
+	for (i = 0; i < KEY_SAMPLE_TREES; i++)
+		key_sample_clear_tree(&keySampleTrees[i]);
+
+	PG_RETURN_VOID();
+}
@@ -20,6 +20,7 @@
 #include "btree/page_chunks.h"
 #include "btree/undo.h"
 #include "checkpoint/checkpoint.h"
+#include "tableam/descr.h"
 #include "utils/page_pool.h"
 #include "transam/undo.h"
 
@@ -154,6 +155,8 @@ btree_try_merge_pages(BTreeDescr *desc,
 	 */
 	merge_pages(desc, left_blkno, right, csn);
 	btree_page_update_max_key_len(desc, left);
+	if (!O_PAGE_IS(left, LEAF))
+		btree_page_adopt_children(left_blkno);
 	MARK_DIRTY_EXTENDED(desc, left_blkno, checkpoint);
 
 	/* the right page can not be found in B-Tree after this line */
@@ -167,9 +170,7 @@ btree_try_merge_pages(BTreeDescr *desc,
 	pg_write_barrier();
 	left_header->csn = csn;
 
-	Assert(checkpoint_state->stack[level].hikeyBlkno != left_blkno);
-	if (checkpoint_state->stack[level].hikeyBlkno == right_blkno)
-		checkpoint_state->stack[level].hikeyBlkno = left_blkno;
+	checkpoint_move_hikey_blkno(level, right_blkno, left_blkno);
 	unlock_page(left_blkno);
 	left_blkno = OInvalidInMemoryBlkno;
 
@@ -547,7 +548,8 @@ merge_pages(BTreeDescr *desc, OInMemoryBlkno left_blkno,
 				rightHikeySize;
 	BTreePageItemLocator loc;
 	BTreePageItem items[BTREE_PAGE_MAX_CHUNK_ITEMS];
-	int			i;
+	int			i,
+				nLive;
 	bool		leaf = O_PAGE_IS(left, LEAF);
 	bool		first;
 	char		newItem[Max(BTreeLeafTuphdrSize, BTreeNonLeafTuphdrSize) + O_BTREE_MAX_TUPLE_SIZE];
@@ -660,11 +662,14 @@ merge_pages(BTreeDescr *desc, OInMemoryBlkno left_blkno,
 
 	page_block_reads(left_blkno);
 
-	left_header->flags = left_header->flags | right_header->flags;
+	left_header->flags = (left_header->flags | right_header->flags) &
+		~O_BTREE_FLAG_ALL_VISIBLE;
 
 	btree_page_reorg(desc, left, items, i, rightHikeySize, rightHikey, NULL);
 
-	o_btree_page_calculate_statistics(desc, left);
+	nLive = o_btree_page_calculate_statistics(desc, left);
+	if (leaf)
+		o_btree_update_leaf_density(desc, nLive);
 
 	left_header->rightLink = InvalidRightLink;
 	left_header->prevInsertOffset = InvalidOffsetNumber;
@@ -709,3 +714,131 @@ is_page_too_sparse(BTreeDescr *desc, Page p)
 		return ((double) space_free / ORIOLEDB_BLCKSZ) >= O_MERGE_NODE_FREE_RATIO;
 	}
 }
+
+/*
+ * Compacts the leaf and tries to merge the page if it's too sparse.
+ */
+static void
+vacuum_page(BTreeDescr *desc, OInMemoryBlkno blkno, uint32 changeCount,
+			OBTreeVacuumStats *stats)
+{
+	Page		p = O_GET_IN_MEMORY_PAGE(blkno);
+
+	reserve_undo_size(desc->undoType, 2 * O_MERGE_UNDO_IMAGE_SIZE);
+	lock_page(blkno);
+
+	if (O_PAGE_GET_CHANGE_COUNT(p) != changeCount || O_PAGE_IS(p, PRE_CLEANUP))
+	{
+		unlock_page(blkno);
+		release_undo_size(desc->undoType);
+		return;
+	}
+
+	stats->pagesScanned++;
+
+	if (O_PAGE_IS(p, LEAF) && PAGE_GET_N_VACATED(p) > 0 &&
+		page_get_vacated_space(desc, p, COMMITSEQNO_INPROGRESS) > 0)
+	{
+		LocationIndex freeSpace = BTREE_PAGE_FREE_SPACE(p);
+		OTuple		nullTup;
+
+		O_TUPLE_SET_NULL(nullTup);
+		perform_page_compaction(desc, blkno, NULL, nullTup, 0, false);
+		MARK_DIRTY(desc, blkno);
+		stats->pagesCompacted++;
+		if (BTREE_PAGE_FREE_SPACE(p) > freeSpace)
+			stats->bytesReclaimed += BTREE_PAGE_FREE_SPACE(p) - freeSpace;
+	}
+
+	if (blkno != desc->rootInfo.rootPageBlkno && is_page_too_sparse(desc, p))
+	{
+		if (btree_try_merge_and_unlock(desc, blkno, true, true))
+		{
+			stats->pagesMerged++;
+			stats->bytesReclaimed += ORIOLEDB_BLCKSZ;
+		}
+	}
+	else
+	{
+		unlock_page(blkno);
+	}
+	release_undo_size(desc->undoType);
+}
+
+static bool
+vacuum_tree_pages_recursive(BTreeDescr *desc, OInMemoryBlkno blkno,
+							uint32 changeCount, OBTreeVacuumStats *stats)
+{
+	Page		p;
+	OInMemoryBlkno childPageNumbers[BTREE_PAGE_MAX_CHUNK_ITEMS];
+	uint32		childPageChangeCounts[BTREE_PAGE_MAX_CHUNK_ITEMS];
+	int			childPagesCount = 0;
+	int			i;
+	BTreePageItemLocator loc;
+
+	if (!OInMemoryBlknoIsValid(blkno))
+		return false;
+
+	lock_page(blkno);
+	p = O_GET_IN_MEMORY_PAGE(blkno);
+	if (O_PAGE_GET_CHANGE_COUNT(p) != changeCount)
+	{
+		unlock_page(blkno);
+		return false;
+	}
+
+	if (!O_PAGE_IS(p, LEAF))
+	{
+		BTREE_PAGE_FOREACH_ITEMS(p, &loc)
+		{
+			BTreeNonLeafTuphdr *tuphdr = (BTreeNonLeafTuphdr *) BTREE_PAGE_LOCATOR_GET_ITEM(p, &loc);
+
+			if (DOWNLINK_IS_IN_MEMORY(tuphdr->downlink))
+			{
+				childPageNumbers[childPagesCount] = DOWNLINK_GET_IN_MEMORY_BLKNO(tuphdr->downlink);
+				childPageChangeCounts[childPagesCount] = DOWNLINK_GET_IN_MEMORY_CHANGECOUNT(tuphdr->downlink);
+				childPagesCount++;
+			}
+		}
+	}
+
+	unlock_page(blkno);
+
+	for (i = 0; i < childPagesCount; i++)
+	{
+		CHECK_FOR_INTERRUPTS();
+		(void) vacuum_tree_pages_recursive(desc,
+										   childPageNumbers[i],
+										   childPageChangeCounts[i],
+										   stats);
+	}
+
+	vacuum_page(desc, blkno, changeCount, stats);
+
+	return true;
+}
+
+/*
+ * Walks the in-memory pages of the tree: compacts leaves with the space
+ * occupied by deleted tuples, and merges sparse pages with their siblings.
+ * Evicted pages are left as is.
+ */
+void
+btree_vacuum_tree(BTreeDescr *desc, OBTreeVacuumStats *stats)
+{
+	o_btree_load_shmem(desc);
+	if (!vacuum_tree_pages_recursive(desc,
+									 desc->rootInfo.rootPageBlkno,
+									 desc->rootInfo.rootPageChangeCount,
+									 stats))
+	{
+		desc->rootInfo.rootPageBlkno = OInvalidInMemoryBlkno;
+		desc->rootInfo.metaPageBlkno = OInvalidInMemoryBlkno;
+		desc->rootInfo.rootPageChangeCount = 0;
+		o_btree_load_shmem(desc);
+		(void) vacuum_tree_pages_recursive(desc,
+										   desc->rootInfo.rootPageBlkno,
+										   desc->rootInfo.rootPageChangeCount,
+										   stats);
+	}
+}
@@ -14,9 +14,11 @@
 
 #include "orioledb.h"
 
+#include "btree/ahi.h"
 #include "btree/find.h"
 #include "btree/insert.h"
 #include "btree/io.h"
+#include "btree/key_sample.h"
 #include "btree/merge.h"
 #include "btree/modify.h"
 #include "btree/page_chunks.h"
@@ -434,6 +436,36 @@ o_btree_modify_handle_conflicts(BTreeModifyInternalContext *context)
 
 	BTREE_PAGE_READ_LEAF_ITEM(tuphdr, curTuple, page, loc);
 
+	/*
+	 * Fast path for the callers, which don't wait (SKIP LOCKED and NOWAIT).
+	 * If the head of the chain belongs to another in-progress transaction
+	 * holding a conflicting lock, then the row is locked whatever is
+	 * further in the chain.
+	 */
+	if (context->callbackInfo->noWait &&
+		!XACT_INFO_IS_FINISHED(tuphdr->xactInfo) &&
+		XACT_INFO_GET_OXID(tuphdr->xactInfo) != context->opOxid &&
+		ROW_LOCKS_CONFLICT(XACT_INFO_GET_LOCK_MODE(tuphdr->xactInfo),
+						   context->lockMode) &&
+		COMMITSEQNO_IS_INPROGRESS(oxid_get_csn(XACT_INFO_GET_OXID(tuphdr->xactInfo))))
+	{
+		OBTreeWaitCallbackAction cbAction PG_USED_FOR_ASSERTS_ONLY;
+		BTreeLocationHint cbHint;
+
+		cbHint.blkno = blkno;
+		cbHint.pageChangeCount = pageFindContext->items[pageFindContext->index].pageChangeCount;
+		cbAction = context->callbackInfo->waitCallback(desc,
+													   curTuple, &context->tuple,
+													   XACT_INFO_GET_OXID(tuphdr->xactInfo),
+													   tuphdr->xactInfo,
+													   tuphdr->undoLocation,
+													   &context->lockMode, &cbHint,
+													   context->callbackInfo->arg);
+		Assert(cbAction == OBTreeCallbackActionXidExit);
+		unlock_page(blkno);
+		return ConflictResolutionFound;
+	}
+
 	if (row_lock_conflicts(tuphdr,
 						   &context->conflictTupHdr,
 						   desc->undoType,
@@ -685,6 +717,22 @@ o_btree_modify_insert_update(BTreeModifyInternalContext *context)
 	BTreeDescr *desc = pageFindContext->desc;
 	int			tuplen;
 
+	/*
+	 * Our own tuple can be replaced without a new undo record.  But if the
+	 * previous version is stored as a delta against the current one, we
+	 * can't lose the current one.
+	 */
+	if (context->undoIsReserved && !context->needsUndo && context->replace)
+	{
+		OInMemoryBlkno blkno = pageFindContext->items[pageFindContext->index].blkno;
+		BTreePageItemLocator *loc = &pageFindContext->items[pageFindContext->index].locator;
+		BTreeLeafTuphdr *tuphdr;
+
+		tuphdr = (BTreeLeafTuphdr *) BTREE_PAGE_LOCATOR_GET_ITEM(O_GET_IN_MEMORY_PAGE(blkno), loc);
+		if (prev_tuple_is_delta_in_undo(desc->undoType, tuphdr))
+			context->needsUndo = true;
+	}
+
 	if (context->undoIsReserved && context->needsUndo)
 		o_btree_modify_add_undo_record(context);
 
@@ -724,10 +772,10 @@ o_btree_modify_add_undo_record(BTreeModifyInternalContext *context)
 
 		BTREE_PAGE_READ_LEAF_ITEM(tuphdr, curTuple, page, &loc);
 
-		prevTuphdr = make_undo_record(desc, curTuple, true,
-									  BTreeOperationUpdate, blkno,
-									  O_PAGE_GET_CHANGE_COUNT(page),
-									  &undoLocation);
+		prevTuphdr = make_update_undo_record(desc, curTuple, context->tuple,
+											 blkno,
+											 O_PAGE_GET_CHANGE_COUNT(page),
+											 &undoLocation);
 		leafTuphdr->undoLocation = undoLocation;
 		leafTuphdr->chainHasLocks = tuphdr->chainHasLocks ||
 			XACT_INFO_IS_LOCK_ONLY(tuphdr->xactInfo);
@@ -946,6 +994,64 @@ prepare_modify_start_params(BTreeDescr *desc)
 	return res;
 }
 
+/*
+ * Checks if the locked leaf found by the context contains the tuple matching
+ * the given key.
+ */
+static bool
+o_btree_locked_page_contains_key(OBTreeFindPageContext *context,
+								 Pointer key, BTreeKeyType keyType)
+{
+	OBtreePageFindItem *item = &context->items[context->index];
+	Page		page = O_GET_IN_MEMORY_PAGE(item->blkno);
+	OTuple		curTuple;
+
+	Assert(page_is_locked(item->blkno));
+
+	if (!BTREE_PAGE_LOCATOR_IS_VALID(page, &item->locator))
+		return false;
+
+	BTREE_PAGE_READ_LEAF_TUPLE(curTuple, page, &item->locator);
+	return o_btree_cmp(context->desc, key, keyType,
+					   &curTuple, BTreeKeyLeafTuple) == 0;
+}
+
+/*
+ * Finds and locks the leaf page for modification of the given key, trying the
+ * adaptive hash index before the full descent.  Similar to point lookups,
+ * the hit is only trusted when the leaf really contains the key.  So, this
+ * mainly helps to modify the existing rows by primary key without the
+ * location hint, like INSERT ... ON CONFLICT does for the conflicting rows.
+ */
+static void
+o_btree_modify_find_page(OBTreeFindPageContext *context,
+						 Pointer key, BTreeKeyType keyType)
+{
+	BTreeLocationHint ahiHint;
+	uint64		ahiTag = 0;
+	bool		useAhi;
+
+	useAhi = !STOPEVENTS_ENABLED() &&
+		ahi_get_tag(context->desc, key, keyType, &ahiTag);
+	if (useAhi && ahi_lookup(context->desc, ahiTag, &ahiHint))
+	{
+		refind_page(context, key, keyType, 0, ahiHint.blkno,
+					ahiHint.pageChangeCount);
+		if (o_btree_locked_page_contains_key(context, key, keyType))
+			return;
+		unlock_page(context->items[context->index].blkno);
+	}
+
+	(void) find_page(context, key, keyType, 0);
+
+	if (useAhi && o_btree_locked_page_contains_key(context, key, keyType))
+	{
+		ahiHint.blkno = context->items[context->index].blkno;
+		ahiHint.pageChangeCount = context->items[context->index].pageChangeCount;
+		ahi_remember(ahiTag, &ahiHint);
+	}
+}
+
 static OBTreeModifyResult
 o_btree_normal_modify(BTreeDescr *desc, BTreeOperationType action,
 					  OTuple tuple, BTreeKeyType tupleType,
@@ -984,10 +1090,21 @@ o_btree_normal_modify(BTreeDescr *desc, BTreeOperationType action,
 	init_page_find_context(&pageFindContext, desc, COMMITSEQNO_INPROGRESS,
 						   BTREE_PAGE_FIND_MODIFY | BTREE_PAGE_FIND_FIX_LEAF_SPLIT);
 
-	if (hint && OInMemoryBlknoIsValid(hint->blkno))
+	/*
+	 * The hint usually comes from the scan, which has just fetched the tuple
+	 * being modified, so we go straight to its leaf.  If the leaf has changed
+	 * since then, refind_page() would do the full descent, so give the finger
+	 * and the adaptive hash index a chance first.  The unlocked check is
+	 * rechecked under the page lock.
+	 */
+	if (hint && OInMemoryBlknoIsValid(hint->blkno) &&
+		O_PAGE_GET_CHANGE_COUNT(O_GET_IN_MEMORY_PAGE(hint->blkno)) == hint->pageChangeCount)
 		refind_page(&pageFindContext, key, keyType, 0, hint->blkno, hint->pageChangeCount);
-	else
-		(void) find_page(&pageFindContext, key, keyType, 0);
+	else if (!btree_finger_find_page(&pageFindContext, key, keyType))
+		o_btree_modify_find_page(&pageFindContext, key, keyType);
+
+	btree_finger_remember(&pageFindContext);
+	btree_key_sample(&pageFindContext);
 
 	return o_btree_modify_internal(&pageFindContext, action, tuple, tupleType,
 								   key, keyType, opOxid, opCsn,
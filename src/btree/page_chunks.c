@@ -20,6 +20,7 @@
 #include "btree/page_chunks.h"
 #include "btree/undo.h"
 #include "recovery/recovery.h"
+#include "transam/oxid.h"
 #include "transam/undo.h"
 #include "utils/page_pool.h"
 #include "utils/ucm.h"
@@ -211,7 +212,8 @@ perform_page_compaction(BTreeDescr *desc, OInMemoryBlkno blkno,
 }
 
 /*
- * Reclaim page space occupied by deleted and/or resized items.
+ * Reclaim page space occupied by deleted and/or resized items.  The new item
+ * is placed at `location` if given.  Otherwise, the page is just compacted.
  */
 static void
 reclaim_page_space(BTreeDescr *desc, Pointer p, CommitSeqNo csn,
@@ -225,7 +227,7 @@ reclaim_page_space(BTreeDescr *desc, Pointer p, CommitSeqNo csn,
 	OFixedKey	hikey;
 	LocationIndex hikeySize,
 				nVacated = 0;
-	bool		addedNewItem = false;
+	bool		addedNewItem = (location == NULL);
 
 	Assert(O_PAGE_IS(p, LEAF));
 
@@ -303,6 +305,39 @@ reclaim_page_space(BTreeDescr *desc, Pointer p, CommitSeqNo csn,
 	}
 	btree_page_reorg(desc, p, items, i, hikeySize, hikey.tuple, location);
 	PAGE_SET_N_VACATED(p, nVacated);
+
+	if (location == NULL)
+		page_mark_all_visible(desc, p);
+}
+
+/*
+ * Sets O_BTREE_FLAG_ALL_VISIBLE on the locked leaf if all its tuples look the
+ * same for every snapshot.  Readers then take tuples as they are without
+ * checking their transactions.  The flag doesn't change the page contents, so
+ * it might be set without blocking reads.  It's cleared by page_block_reads()
+ * on the next page modification.
+ */
+void
+page_mark_all_visible(BTreeDescr *desc, Page p)
+{
+	BTreePageItemLocator loc;
+
+	Assert(O_PAGE_IS(p, LEAF));
+
+	if (desc->undoType == UndoLogNone || O_PAGE_IS(p, ALL_VISIBLE))
+		return;
+
+	BTREE_PAGE_FOREACH_ITEMS(p, &loc)
+	{
+		BTreeLeafTuphdr *tupHdr;
+
+		tupHdr = (BTreeLeafTuphdr *) BTREE_PAGE_LOCATOR_GET_ITEM(p, &loc);
+		if (XACT_INFO_IS_LOCK_ONLY(tupHdr->xactInfo) ||
+			!xid_is_visible_for_everybody(XACT_INFO_GET_OXID(tupHdr->xactInfo)))
+			return;
+	}
+
+	((BTreePageHeader *) p)->flags |= O_BTREE_FLAG_ALL_VISIBLE;
 }
 
 void
@@ -927,6 +962,94 @@ page_split_chunk(Page p, BTreePageItemLocator *locator,
 	page_chunk_fill_locator(p, i, locator);
 }
 
+/* Only each PAGE_READS_SAMPLE_RATE-th leaf read is counted */
+#define PAGE_READS_SAMPLE_RATE		(8)
+/* Both counters are halved once one of them reaches this value */
+#define PAGE_ACCESS_COUNTER_MAX		(1024)
+/* Minimal number of writes and sampled reads to classify the leaf */
+#define PAGE_ACCESS_MIN_WRITES		(256)
+#define PAGE_ACCESS_MIN_READS		(64)
+
+static uint32 pageReadsSampleCounter = 0;
+
+/*
+ * Accounts the read of the leaf.  Reads are sampled and counted without a
+ * lock.  Lost increments are fine, because we only need a rough estimate.
+ */
+void
+page_count_read(OInMemoryBlkno blkno)
+{
+	OrioleDBPageDesc *page_desc;
+
+	if (++pageReadsSampleCounter % PAGE_READS_SAMPLE_RATE != 0)
+		return;
+
+	page_desc = O_GET_IN_MEMORY_PAGEDESC(blkno);
+	if (page_desc->nReads < PAGE_ACCESS_COUNTER_MAX)
+		page_desc->nReads++;
+}
+
+/*
+ * Accounts the insertion into the locked leaf and reclassifies its access
+ * mix.  Counters are halved periodically, so the classification follows the
+ * recent workload.  The caller must hold the page lock and block the page
+ * reads.
+ */
+void
+page_count_write(OInMemoryBlkno blkno)
+{
+	OrioleDBPageDesc *page_desc = O_GET_IN_MEMORY_PAGEDESC(blkno);
+	Page		p = O_GET_IN_MEMORY_PAGE(blkno);
+	uint32		reads,
+				writes;
+	BTreePageAccessMix mix;
+
+	Assert(O_PAGE_IS(p, LEAF));
+
+	if (page_desc->nWrites >= PAGE_ACCESS_COUNTER_MAX ||
+		page_desc->nReads >= PAGE_ACCESS_COUNTER_MAX)
+	{
+		page_desc->nWrites /= 2;
+		page_desc->nReads /= 2;
+	}
+	page_desc->nWrites++;
+
+	reads = (uint32) page_desc->nReads * PAGE_READS_SAMPLE_RATE;
+	writes = page_desc->nWrites;
+
+	if (writes >= PAGE_ACCESS_MIN_WRITES && writes > 4 * reads)
+		mix = BTreePageAccessWriteHeavy;
+	else if (page_desc->nReads >= PAGE_ACCESS_MIN_READS && reads > 16 * writes)
+		mix = BTreePageAccessReadHeavy;
+	else
+		mix = BTreePageAccessBalanced;
+
+	if (PAGE_GET_ACCESS_MIX(p) != mix)
+		PAGE_SET_ACCESS_MIX(p, mix);
+}
+
+/*
+ * Returns the multiplier for the minimal chunk size.  Read-heavy leaves get
+ * smaller chunks for cheaper search and partial reads, while write-heavy
+ * leaves get larger chunks to move less data on insertions.
+ */
+static float4
+page_chunk_size_factor(Page p)
+{
+	if (!O_PAGE_IS(p, LEAF))
+		return 1.0f;
+
+	switch (PAGE_GET_ACCESS_MIX(p))
+	{
+		case BTreePageAccessReadHeavy:
+			return 0.5f;
+		case BTreePageAccessWriteHeavy:
+			return 2.0f;
+		default:
+			return 1.0f;
+	}
+}
+
 #define MAXALIGN_WASTE(s) \
 	((MAXIMUM_ALIGNOF - 1) - ((s) + (MAXIMUM_ALIGNOF - 1)) % (MAXIMUM_ALIGNOF))
 
@@ -954,7 +1077,8 @@ page_split_chunk_if_needed(BTreeDescr *desc, Page p, BTreePageItemLocator *locat
 	chunkOffset = locator->chunkOffset;
 
 	if ((float4) locator->chunkSize / (float4) (ORIOLEDB_BLCKSZ - hikeysEnd) <
-		(float4) MAXALIGN(header->maxKeyLen) * 2.0f / (float4) (hikeysEnd - offsetof(BTreePageHeader, chunkDesc)))
+		(float4) MAXALIGN(header->maxKeyLen) * 2.0f * page_chunk_size_factor(p) /
+		(float4) (hikeysEnd - offsetof(BTreePageHeader, chunkDesc)))
 		return;
 
 	hikeysFreeSpace = hikeysEnd - header->hikeysEnd;
@@ -1146,6 +1270,7 @@ btree_page_reorg(BTreeDescr *desc, Page p, BTreePageItem *items,
 	bool		isRightmost = O_PAGE_IS(p, RIGHTMOST);
 	LocationIndex chunkDataSize;
 	LocationIndex maxKeyLen;
+	float4		sizeFactor = page_chunk_size_factor(p);
 
 	VALGRIND_CHECK_MEM_IS_DEFINED(p, ORIOLEDB_BLCKSZ);
 	VALGRIND_MAKE_MEM_DEFINED(p, ORIOLEDB_BLCKSZ);
@@ -1194,7 +1319,8 @@ btree_page_reorg(BTreeDescr *desc, Page p, BTreePageItem *items,
 			continue;
 		}
 
-		dataSizeRatio = (float4) chunkDataSize / (float4) totalDataSize;
+		dataSizeRatio = (float4) chunkDataSize / (float4) totalDataSize /
+			sizeFactor;
 		if (dataSizeRatio >= (float4) (nextKeySize + sizeof(BTreePageChunkDesc)) / (float4) hikeysFreeSpace &&
 			dataSizeRatio >= (float4) dataSpaceDiff / (float4) dataFreeSpace)
 		{
@@ -50,6 +50,34 @@ read_page_from_undo(BTreeDescr *desc, Page img, UndoLocation undo_loc,
 
 	while (true)
 	{
+		UndoPageImageHeader imageHeader;
+		BTreePageHeader pageHeader;
+
+		EA_UNDO_INC(desc);
+
+		/*
+		 * Most of the hops go through single-page images.  For them we only
+		 * need the page header to find out whether to continue traversing the
+		 * undo chain.  So, read just the headers and skip the copy of the
+		 * whole page image until we reach the image we need.  Merge images
+		 * need the key to choose the page, so they take the full path.
+		 */
+		undo_read(desc->undoType, undo_loc,
+				  sizeof(UndoPageImageHeader), (Pointer) &imageHeader);
+		if (imageHeader.type == UndoPageImageSplit ||
+			imageHeader.type == UndoPageImageCompact)
+		{
+			undo_read(desc->undoType, O_UNDO_GET_IMAGE_LOCATION(undo_loc, true),
+					  sizeof(BTreePageHeader), (Pointer) &pageHeader);
+			if (COMMITSEQNO_IS_NORMAL(pageHeader.csn) && pageHeader.csn >= csn)
+			{
+				Assert(UNDO_REC_EXISTS(desc->undoType, undo_loc));
+				is_left = true;
+				undo_loc = pageHeader.undoLocation;
+				continue;
+			}
+		}
+
 		/* Read page image from page-level undo item */
 		get_page_from_undo(desc, undo_loc, key, keyType, img,
 						   &is_left, NULL, lokey, NULL, NULL);
@@ -142,14 +170,24 @@ try_copy_page(OInMemoryBlkno blkno, uint32 pageChangeCount, Page dest,
 
 /*
  * Copy consistent image of page with page number = blkno to dest.
+ *
+ * Modifications of internal pages are short (insertion or deletion of a
+ * downlink), but all the descents go through them.  So, we optimistically
+ * re-read internal pages spinning on their state, and only wait in the queue
+ * if the page stays blocked for too long.
  */
 static inline void
 copy_page(OInMemoryBlkno blkno, Page dest, PartialPageState *partial,
 		  CommitSeqNo *readCsn)
 {
+	bool		isLeaf = O_PAGE_IS(O_GET_IN_MEMORY_PAGE(blkno), LEAF);
+
 	while (try_copy_page(blkno, InvalidOPageChangeCount, dest,
 						 partial, readCsn) != ReadPageResultOK)
 	{
+		EA_RETRY_INC(blkno);
+		if (!isLeaf && page_spin_for_read_enable(blkno))
+			continue;
 		(void) page_wait_for_read_enable(blkno);
 	}
 }
@@ -173,6 +211,8 @@ o_btree_read_page(BTreeDescr *desc, OInMemoryBlkno blkno,
 	bool		read_undo = O_PAGE_IS(p, LEAF);
 
 	EA_READ_INC(blkno);
+	if (read_undo)
+		page_count_read(blkno);
 
 	/*---
 	 * Check if we need to load page image from undo?
@@ -373,12 +413,16 @@ init_meta_page(OInMemoryBlkno blkno, uint32 leafPagesNum)
 
 	memset(p + O_PAGE_HEADER_SIZE, 0, ORIOLEDB_BLCKSZ - O_PAGE_HEADER_SIZE);
 	pg_atomic_init_u32(&metaPage->leafPagesNum, leafPagesNum);
+	pg_atomic_init_u32(&metaPage->insertPattern, 0);
+	pg_atomic_init_u32(&metaPage->leafTuplesDensity, 0);
+	pg_atomic_init_u64(&metaPage->compressDict, 0);
 	pg_atomic_init_u64(&metaPage->numFreeBlocks, 0);
 	pg_atomic_init_u64(&metaPage->datafileLength[0], 0);
 	pg_atomic_init_u64(&metaPage->datafileLength[1], 0);
 	pg_atomic_init_u64(&metaPage->ctid, 0);
 	for (i = 0; i < NUM_SEQ_SCANS_ARRAY_SIZE; i++)
 		pg_atomic_init_u32(&metaPage->numSeqScans[i], 0);
+	pg_atomic_init_u32(&metaPage->subtreeDirtyUnknown, 1);
 
 	LWLockInitialize(&metaPage->copyBlknoLock,
 					 checkpoint_state->copyBlknoTrancheId);
@@ -491,17 +535,39 @@ put_page_image(OInMemoryBlkno blkno, Page img)
 }
 
 /*
- * Calculates number of vacated bytes for leaf pages and number of
- * disk downlinks for non-leaf pages.
+ * Folds the number of live tuples on the leaf page into the tree-wide
+ * running estimate of leaf page density.  Concurrent updates might overwrite
+ * each other, that's fine for an estimate.
  */
 void
+o_btree_update_leaf_density(BTreeDescr *desc, int nLive)
+{
+	BTreeMetaPage *metaPage = BTREE_GET_META(desc);
+	int64		density,
+				sample = (int64) nLive * O_LEAF_DENSITY_SCALE;
+
+	density = pg_atomic_read_u32(&metaPage->leafTuplesDensity);
+	if (density == 0)
+		density = Max(sample, 1);
+	else
+		density = Max(density + (sample - density) / 8, 1);
+	pg_atomic_write_u32(&metaPage->leafTuplesDensity, (uint32) density);
+}
+
+/*
+ * Calculates number of vacated bytes for leaf pages and number of
+ * disk downlinks for non-leaf pages.  Returns the number of live tuples for
+ * leaf pages and zero for non-leaf pages.
+ */
+int
 o_btree_page_calculate_statistics(BTreeDescr *desc, Pointer p)
 {
 	BTreePageItemLocator loc;
 
 	if (O_PAGE_IS(p, LEAF))
 	{
-		int			nVacated = 0;
+		int			nVacated = 0,
+					nLive = 0;
 
 		BTREE_PAGE_FOREACH_ITEMS(p, &loc)
 		{
@@ -511,12 +577,18 @@ o_btree_page_calculate_statistics(BTreeDescr *desc, Pointer p)
 			BTREE_PAGE_READ_LEAF_ITEM(tupHdr, tuple, p, &loc);
 
 			if (tupHdr->deleted)
+			{
 				nVacated += BTREE_PAGE_GET_ITEM_SIZE(p, &loc);
+			}
 			else
+			{
 				nVacated += BTREE_PAGE_GET_ITEM_SIZE(p, &loc) -
 					(BTreeLeafTuphdrSize + MAXALIGN(o_btree_len(desc, tuple, OTupleLength)));
+				nLive++;
+			}
 		}
 		PAGE_SET_N_VACATED(p, nVacated);
+		return nLive;
 	}
 	else
 	{
@@ -530,6 +602,7 @@ o_btree_page_calculate_statistics(BTreeDescr *desc, Pointer p)
 				nOnDisk++;
 		}
 		PAGE_SET_N_ONDISK(p, nOnDisk);
+		return 0;
 	}
 }
 
@@ -22,17 +22,23 @@
 #include "tableam/descr.h"
 #include "transam/oxid.h"
 #include "transam/undo.h"
+#include "utils/latency.h"
+#include "utils/o_wait_events.h"
 #include "utils/page_pool.h"
 #include "utils/stopevent.h"
 #include "utils/ucm.h"
 
 #include "access/transam.h"
+#include "common/hashfn.h"
+#include "funcapi.h"
 #include "miscadmin.h"
 #include "pgstat.h"
+#include "portability/instr_time.h"
 #include "storage/proc.h"
 #include "storage/proclist.h"
 #include "storage/s_lock.h"
 #include "utils/memdebug.h"
+#include "utils/tuplestore.h"
 
 /* Maximum simultaneously locked pages per process */
 #define MAX_PAGES_PER_PROCESS 8
@@ -54,6 +60,43 @@ static OInMemoryBlkno myInProgressSplitPages[ORIOLEDB_MAX_DEPTH * 2];
 static int	numberOfMyLockedPages = 0;
 static int	numberOfMyInProgressSplitPages = 0;
 
+/*
+ * Adaptive number of spins before waiting for a page lock in the queue.  It
+ * grows when the lock gets released while we spin, and slowly shrinks
+ * otherwise.  So it follows how long page locks are usually held, like
+ * spins_per_delay does for spinlocks.
+ */
+#define MIN_PAGE_LOCK_SPINS		10
+#define MAX_PAGE_LOCK_SPINS		1000
+#define DEFAULT_PAGE_LOCK_SPINS	100
+
+static int	pageLockSpins = DEFAULT_PAGE_LOCK_SPINS;
+
+/*
+ * Per-tree page lock statistics.  Trees are mapped to the fixed number of
+ * slots using open addressing.  Once all the probed slots are occupied,
+ * the tree isn't accounted.
+ */
+#define PAGE_LOCK_STATS_SLOTS	1024
+#define PAGE_LOCK_STATS_PROBES	8
+
+typedef struct
+{
+	pg_atomic_uint64 key;		/* datoid and relnode, zero if free */
+	pg_atomic_uint32 reloid;
+	pg_atomic_uint64 acquisitions;
+	pg_atomic_uint64 spins;
+	pg_atomic_uint64 waits;
+	pg_atomic_uint64 waitTime;	/* in microseconds */
+} PageLockStatsEntry;
+
+bool		page_lock_stats = false;
+
+static PageLockStatsEntry *pageLockStats = NULL;
+
+PG_FUNCTION_INFO_V1(orioledb_page_lock_stats);
+PG_FUNCTION_INFO_V1(orioledb_page_lock_stats_reset);
+
 
 #ifdef CHECK_PAGE_STRUCT
 static void o_check_page_struct(BTreeDescr *desc, Page p);
@@ -265,9 +308,122 @@ dequeue_self(OInMemoryBlkno blkno)
 	return state;
 }
 
+Size
+page_lock_stats_shmem_needs(void)
+{
+	return mul_size(sizeof(PageLockStatsEntry), PAGE_LOCK_STATS_SLOTS);
+}
+
+void
+page_lock_stats_shmem_init(Pointer ptr, bool found)
+{
+	int			i;
+
+	pageLockStats = (PageLockStatsEntry *) ptr;
+
+	if (!found)
+	{
+		for (i = 0; i < PAGE_LOCK_STATS_SLOTS; i++)
+		{
+			PageLockStatsEntry *entry = &pageLockStats[i];
+
+			pg_atomic_init_u64(&entry->key, 0);
+			pg_atomic_init_u32(&entry->reloid, InvalidOid);
+			pg_atomic_init_u64(&entry->acquisitions, 0);
+			pg_atomic_init_u64(&entry->spins, 0);
+			pg_atomic_init_u64(&entry->waits, 0);
+			pg_atomic_init_u64(&entry->waitTime, 0);
+		}
+	}
+}
+
+/*
+ * Finds or allocates the statistics slot for the tree the page belongs to.
+ */
+static PageLockStatsEntry *
+page_lock_stats_get_entry(OInMemoryBlkno blkno)
+{
+	ORelOids	oids = O_GET_IN_MEMORY_PAGEDESC(blkno)->oids;
+	uint64		key;
+	uint32		pos;
+	int			i;
+
+	if (!ORelOidsIsValid(oids))
+		return NULL;
+
+	key = ((uint64) oids.datoid << 32) | (uint64) oids.relnode;
+	pos = hash_combine(murmurhash32(oids.datoid), murmurhash32(oids.relnode));
+
+	for (i = 0; i < PAGE_LOCK_STATS_PROBES; i++)
+	{
+		PageLockStatsEntry *entry;
+		uint64		curKey;
+
+		entry = &pageLockStats[(pos + i) % PAGE_LOCK_STATS_SLOTS];
+		curKey = pg_atomic_read_u64(&entry->key);
+		if (curKey == 0 &&
+			pg_atomic_compare_exchange_u64(&entry->key, &curKey, key))
+		{
+			pg_atomic_write_u32(&entry->reloid, oids.reloid);
+			return entry;
+		}
+		if (curKey == key)
+			return entry;
+	}
+	return NULL;
+}
+
+static void
+page_lock_stats_account(OInMemoryBlkno blkno, bool spun, bool waited,
+						instr_time *waitStart)
+{
+	PageLockStatsEntry *entry = page_lock_stats_get_entry(blkno);
+
+	if (!entry)
+		return;
+
+	pg_atomic_fetch_add_u64(&entry->acquisitions, 1);
+	if (spun)
+		pg_atomic_fetch_add_u64(&entry->spins, 1);
+	if (waited)
+	{
+		instr_time	waitTime;
+
+		INSTR_TIME_SET_CURRENT(waitTime);
+		INSTR_TIME_SUBTRACT(waitTime, *waitStart);
+		pg_atomic_fetch_add_u64(&entry->waits, 1);
+		pg_atomic_fetch_add_u64(&entry->waitTime,
+								INSTR_TIME_GET_MICROSEC(waitTime));
+	}
+}
+
+/*
+ * Spins until the page gets unlocked, without writing to the page state.
+ * Returns false if the page is still locked after pageLockSpins iterations.
+ */
+static bool
+page_lock_spin(OInMemoryBlkno blkno)
+{
+	OrioleDBPageHeader *header = (OrioleDBPageHeader *) O_GET_IN_MEMORY_PAGE(blkno);
+	int			i;
+
+	for (i = 0; i < pageLockSpins; i++)
+	{
+		pg_spin_delay();
+		if (!O_PAGE_STATE_IS_LOCKED(pg_atomic_read_u32(&header->state)))
+		{
+			pageLockSpins = Min(pageLockSpins + 100, MAX_PAGE_LOCK_SPINS);
+			return true;
+		}
+	}
+	pageLockSpins = Max(pageLockSpins - 1, MIN_PAGE_LOCK_SPINS);
+	return false;
+}
+
 /*
  * Place exclusive lock on the page.  Doesn't block readers before
- * page_block_reads() is called.
+ * page_block_reads() is called.  If the page is locked, spins for a while
+ * before waiting in the queue.
  */
 void
 lock_page(OInMemoryBlkno blkno)
@@ -277,20 +433,31 @@ lock_page(OInMemoryBlkno blkno)
 	OrioleDBPageHeader *header = (OrioleDBPageHeader *) p;
 	uint32		prevState;
 	int			extraWaits = 0;
+	bool		spun = false,
+				waited = false;
+	instr_time	waitStart,
+				sleepStart;
+	uint32		waitEventInfo;
 
 	Assert(get_my_locked_page_index(blkno) < 0);
 
 	EA_LOCK_INC(blkno);
 
+	INSTR_TIME_SET_ZERO(waitStart);
+
 	page_inc_usage_count(ucm, blkno,
 						 pg_atomic_read_u32(&header->usageCount), false);
 
+	if (O_PAGE_STATE_IS_LOCKED(pg_atomic_read_u32(&header->state)))
+		spun = page_lock_spin(blkno);
+
 	while (true)
 	{
 		prevState = lock_page_or_list(blkno);
 		if (!O_PAGE_STATE_IS_LOCKED(prevState))
 			break;
 
+		waitEventInfo = o_wait_event_info(OWaitPageLock);
 		proclist_push_tail(&O_GET_IN_MEMORY_PAGEDESC(blkno)->waitersList,
 						   MYPROCNUMBER,
 						   lwWaitLink);
@@ -307,7 +474,12 @@ lock_page(OInMemoryBlkno blkno)
 			}
 		}
 
-		pgstat_report_wait_start(PG_WAIT_LWLOCK | LWTRANCHE_BUFFER_CONTENT);
+		if ((page_lock_stats || latency_histograms) && !waited)
+			INSTR_TIME_SET_CURRENT(waitStart);
+		waited = true;
+
+		INSTR_TIME_SET_CURRENT(sleepStart);
+		pgstat_report_wait_start(waitEventInfo);
 
 		for (;;)
 		{
@@ -318,6 +490,7 @@ lock_page(OInMemoryBlkno blkno)
 		}
 
 		pgstat_report_wait_end();
+		o_wait_event_account(OWaitPageLock, &sleepStart);
 	}
 
 	my_locked_page_add(blkno, prevState | PAGE_STATE_LOCKED_FLAG);
@@ -327,6 +500,38 @@ lock_page(OInMemoryBlkno blkno)
 	 */
 	while (extraWaits-- > 0)
 		PGSemaphoreUnlock(MyProc->sem);
+
+	if (page_lock_stats)
+		page_lock_stats_account(blkno, spun && !waited, waited, &waitStart);
+	if (waited && latency_histograms)
+		latency_record(OLatencyPageLockWait, &waitStart);
+	if (waited)
+	{
+		EA_WAIT_INC(blkno);
+	}
+}
+
+/*
+ * Spins until reads of the page are enabled.  Unlike
+ * page_wait_for_read_enable(), doesn't write to the page state, so
+ * concurrent readers don't bounce the cache line of a hot page.  Gives up
+ * after PAGE_READ_SPIN_DELAYS iterations, then caller should wait in the
+ * queue.
+ */
+bool
+page_spin_for_read_enable(OInMemoryBlkno blkno)
+{
+	Page		p = O_GET_IN_MEMORY_PAGE(blkno);
+	OrioleDBPageHeader *header = (OrioleDBPageHeader *) p;
+	int			i;
+
+	for (i = 0; i < PAGE_READ_SPIN_DELAYS; i++)
+	{
+		if (!O_PAGE_STATE_READ_IS_BLOCKED(pg_atomic_read_u32(&header->state)))
+			return true;
+		pg_spin_delay();
+	}
+	return false;
 }
 
 void
@@ -336,6 +541,8 @@ page_wait_for_read_enable(OInMemoryBlkno blkno)
 	OrioleDBPageHeader *header = (OrioleDBPageHeader *) p;
 	uint32		prevState;
 	int			extraWaits = 0;
+	instr_time	sleepStart;
+	uint32		waitEventInfo;
 
 	while (true)
 	{
@@ -343,6 +550,7 @@ page_wait_for_read_enable(OInMemoryBlkno blkno)
 		if (!(prevState & PAGE_STATE_NO_READ_FLAG))
 			break;
 
+		waitEventInfo = o_wait_event_info(OWaitPageReadEnable);
 		proclist_push_tail(&O_GET_IN_MEMORY_PAGEDESC(blkno)->waitersList,
 						   MYPROCNUMBER,
 						   lwWaitLink);
@@ -356,7 +564,8 @@ page_wait_for_read_enable(OInMemoryBlkno blkno)
 			return;
 		}
 
-		pgstat_report_wait_start(PG_WAIT_LWLOCK | LWTRANCHE_BUFFER_CONTENT);
+		INSTR_TIME_SET_CURRENT(sleepStart);
+		pgstat_report_wait_start(waitEventInfo);
 
 		for (;;)
 		{
@@ -367,6 +576,7 @@ page_wait_for_read_enable(OInMemoryBlkno blkno)
 		}
 
 		pgstat_report_wait_end();
+		o_wait_event_account(OWaitPageReadEnable, &sleepStart);
 	}
 
 	/*
@@ -385,6 +595,8 @@ page_wait_for_changecount(OInMemoryBlkno blkno, uint32 state)
 	OrioleDBPageHeader *header = (OrioleDBPageHeader *) p;
 	uint32		curState;
 	int			extraWaits = 0;
+	instr_time	sleepStart;
+	uint32		waitEventInfo = o_wait_event_info(OWaitPageChangeCount);
 
 	while (true)
 	{
@@ -412,7 +624,8 @@ page_wait_for_changecount(OInMemoryBlkno blkno, uint32 state)
 			return dequeue_self(blkno);
 		}
 
-		pgstat_report_wait_start(PG_WAIT_LWLOCK | LWTRANCHE_BUFFER_CONTENT);
+		INSTR_TIME_SET_CURRENT(sleepStart);
+		pgstat_report_wait_start(waitEventInfo);
 
 		for (;;)
 		{
@@ -427,10 +640,10 @@ page_wait_for_changecount(OInMemoryBlkno blkno, uint32 state)
 			}
 			extraWaits++;
 		}
+		pgstat_report_wait_end();
+		o_wait_event_account(OWaitPageChangeCount, &sleepStart);
 		if (exit_loop)
 			break;
-
-		pgstat_report_wait_end();
 	}
 
 	/*
@@ -526,6 +739,9 @@ page_block_reads(OInMemoryBlkno blkno)
 	state = pg_atomic_fetch_or_u32(&(O_PAGE_HEADER(p)->state), PAGE_STATE_NO_READ_FLAG);
 	Assert((state & PAGE_STATE_LOCKED_FLAG));
 	myLockedPages[i].state = state | PAGE_STATE_NO_READ_FLAG;
+
+	/* The modification might add tuples, which aren't visible for everybody */
+	((BTreePageHeader *) p)->flags &= ~O_BTREE_FLAG_ALL_VISIBLE;
 }
 
 static void
@@ -897,3 +1113,78 @@ o_check_btree_page_statistics(BTreeDescr *desc, Pointer p)
 	}
 }
 #endif
+
+/*
+ * Returns the page lock statistics for every accounted tree.
+ */
+Datum
+orioledb_page_lock_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Datum		values[7];
+	bool		nulls[7];
+	int			i;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+
+	orioledb_check_shmem();
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	MemSet(nulls, 0, sizeof(nulls));
+	for (i = 0; i < PAGE_LOCK_STATS_SLOTS; i++)
+	{
+		PageLockStatsEntry *entry = &pageLockStats[i];
+		uint64		key = pg_atomic_read_u64(&entry->key);
+
+		if (key == 0)
+			continue;
+
+		values[0] = ObjectIdGetDatum((Oid) (key >> 32));
+		values[1] = ObjectIdGetDatum(pg_atomic_read_u32(&entry->reloid));
+		values[2] = ObjectIdGetDatum((Oid) key);
+		values[3] = Int64GetDatum(pg_atomic_read_u64(&entry->acquisitions));
+		values[4] = Int64GetDatum(pg_atomic_read_u64(&entry->spins));
+		values[5] = Int64GetDatum(pg_atomic_read_u64(&entry->waits));
+		values[6] = Float8GetDatum((double) pg_atomic_read_u64(&entry->waitTime) / 1000.0);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+Datum
+orioledb_page_lock_stats_reset(PG_FUNCTION_ARGS)
+{
+	int			i;
+
+	orioledb_check_shmem();
+
+	for (i = 0; i < PAGE_LOCK_STATS_SLOTS; i++)
+	{
+		PageLockStatsEntry *entry = &pageLockStats[i];
+
+		pg_atomic_write_u64(&entry->acquisitions, 0);
+		pg_atomic_write_u64(&entry->spins, 0);
+		pg_atomic_write_u64(&entry->waits, 0);
+		pg_atomic_write_u64(&entry->waitTime, 0);
+		pg_atomic_write_u32(&entry->reloid, InvalidOid);
+		pg_atomic_write_u64(&entry->key, 0);
+	}
+
+	PG_RETURN_VOID();
+}
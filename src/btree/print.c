@@ -338,7 +338,9 @@ print_page_contents_recursive(BTreeDescr *desc, OInMemoryBlkno blkno,
 				BTreeLeafTuphdr tuphdr,
 						   *pageTuphdr;
 				OTuple		tuple;
-				bool		inUndo = false;
+				bool		inUndo = false,
+							tupleAllocated = false,
+							showTuple = true;
 
 				BTREE_PAGE_READ_LEAF_ITEM(pageTuphdr, tuple, p, &loc);
 				tuphdr = *pageTuphdr;
@@ -423,7 +425,7 @@ print_page_contents_recursive(BTreeDescr *desc, OInMemoryBlkno blkno,
 						appendStringInfo(outbuf, "chainHasLocks");
 					}
 
-					if (!O_TUPLE_IS_NULL(tuple))
+					if (showTuple)
 					{
 						if (needsComma)
 							appendStringInfo(outbuf, ", ");
@@ -438,17 +440,25 @@ print_page_contents_recursive(BTreeDescr *desc, OInMemoryBlkno blkno,
 						UndoLocationIsValid(tuphdr.undoLocation))
 					{
 						Assert(UNDO_REC_EXISTS(desc->undoType, tuphdr.undoLocation));
-						if (inUndo && !O_TUPLE_IS_NULL(tuple))
-							pfree(tuple.data);
 						if (!tuphdr.deleted && !XACT_INFO_IS_LOCK_ONLY(tuphdr.xactInfo))
 						{
+							Pointer		nextTupleData = tuple.data;
+
+							/*
+							 * Keep the next version till the previous one is
+							 * read: delta undo records are applied to it.
+							 */
 							get_prev_leaf_header_and_tuple_from_undo(desc->undoType,
 																	 &tuphdr, &tuple, 0);
+							if (tupleAllocated)
+								pfree(nextTupleData);
+							tupleAllocated = true;
+							showTuple = true;
 						}
 						else
 						{
 							get_prev_leaf_header_from_undo(desc->undoType, &tuphdr, false);
-							O_TUPLE_SET_NULL(tuple);
+							showTuple = false;
 						}
 						inUndo = true;
 					}
@@ -457,7 +467,7 @@ print_page_contents_recursive(BTreeDescr *desc, OInMemoryBlkno blkno,
 						break;
 					}
 				}
-				if (inUndo && !O_TUPLE_IS_NULL(tuple))
+				if (tupleAllocated)
 					pfree(tuple.data);
 			}
 			else
@@ -0,0 +1,765 @@
+/*-------------------------------------------------------------------------
+ *
+ * residency.c
+ *		Pinning of trees in the main page pool, per-tree residency report
+ *		and explicit prewarming.
+ *
+ * Copyright (c) 2025-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/btree/residency.c
+ *
+ * NOTES
+ *
+ *		The pinned trees are kept in a small shared array.  The clock of the
+ *		page pool skips the pages of the pinned trees when it looks for a
+ *		page to evict (see ppool_run_clock()).  The trees are identified by
+ *		the database and relation oids, so the pin survives the rewrite of
+ *		the relation, but not the restart.
+ *
+ *		The size of the pinned trees is capped by
+ *		orioledb.pinned_pages_limit percent of the main page pool.  The
+ *		cap is checked against the number of leaves of the trees at the
+ *		moment of pinning.  The pinned trees might grow afterwards, so the
+ *		clock stops skipping the pinned pages once it skipped a quarter of
+ *		the pool in a single run.
+ *
+ *		With orioledb.enable_residency_costing, the planner scales the page
+ *		counts of the relation and its indexes by the estimated fraction of
+ *		the tree leaves residing in the page pool.  The fraction is
+ *		estimated from the downlinks of the root and of a few of its
+ *		children, see o_tree_resident_fraction().
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "btree/btree.h"
+#include "btree/find.h"
+#include "btree/iterator.h"
+#include "btree/page_contents.h"
+#include "btree/residency.h"
+#include "btree/page_state.h"
+#include "btree/scan.h"
+#include "tableam/descr.h"
+#include "utils/page_pool.h"
+
+#include "access/relation.h"
+#include "catalog/pg_class.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "storage/spin.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+#include "utils/tuplestore.h"
+
+#include <math.h>
+
+#define PINNED_TREES_MAX		64
+#define PINNED_TREE_KEY(datoid, reloid) \
+	(((uint64) (datoid) << 32) | (uint64) (reloid))
+
+/* Number of leaves prefetched ahead of the prewarm */
+#define PREWARM_PREFETCH_DISTANCE	32
+
+/* Number of the root children looked at by o_tree_resident_fraction() */
+#define RESIDENCY_SAMPLE_CHILDREN	16
+
+/*
+ * The cost of reading a resident page relative to a local disk read, and
+ * the one of reading a page from S3.
+ */
+#define RESIDENT_PAGE_COST_FACTOR	0.05
+#define S3_PAGE_COST_FACTOR			4.0
+
+typedef struct
+{
+	pg_atomic_uint64 key;		/* datoid and reloid, zero if free */
+	uint64		pages;			/* leaves of the tree when pinned */
+} PinnedTree;
+
+typedef struct
+{
+	slock_t		lock;
+	pg_atomic_uint32 count;
+	uint64		pages;
+	PinnedTree	trees[PINNED_TREES_MAX];
+} PinnedTreesShared;
+
+typedef struct
+{
+	ORelOids	oids;
+	OIndexType	type;
+	int64		pages;
+	int64		leafPages;
+	int64		dirtyPages;
+} TreeResidencyEntry;
+
+typedef struct
+{
+	BTreeDescr *desc;
+	MemoryContext mcxt;
+	List	   *keys;
+} PrewarmState;
+
+/* Low key of the leaf to prewarm, the data follows */
+typedef struct
+{
+	OTuple		key;
+} PrewarmKey;
+
+int			pinned_pages_limit = 25;
+bool		orioledb_enable_residency_costing = false;
+
+static PinnedTreesShared *pinnedTrees = NULL;
+
+PG_FUNCTION_INFO_V1(orioledb_tree_pin);
+PG_FUNCTION_INFO_V1(orioledb_tree_unpin);
+PG_FUNCTION_INFO_V1(orioledb_tree_residency);
+PG_FUNCTION_INFO_V1(orioledb_prewarm);
+
+Size
+pinned_trees_shmem_needs(void)
+{
+	return MAXALIGN(sizeof(PinnedTreesShared));
+}
+
+void
+pinned_trees_shmem_init(Pointer ptr, bool found)
+{
+	int			i;
+
+	pinnedTrees = (PinnedTreesShared *) ptr;
+
+	if (!found)
+	{
+		SpinLockInit(&pinnedTrees->lock);
+		pg_atomic_init_u32(&pinnedTrees->count, 0);
+		pinnedTrees->pages = 0;
+		for (i = 0; i < PINNED_TREES_MAX; i++)
+		{
+			pg_atomic_init_u64(&pinnedTrees->trees[i].key, 0);
+			pinnedTrees->trees[i].pages = 0;
+		}
+	}
+}
+
+/*
+ * Checks if the in-memory page belongs to the pinned tree.  Doesn't lock the
+ * page, so the answer might be stale, which is fine for the clock.
+ */
+bool
+o_page_is_pinned(OInMemoryBlkno blkno)
+{
+	OrioleDBPageDesc *page_desc;
+	ORelOids	oids;
+	uint64		key;
+	int			i;
+
+	if (pg_atomic_read_u32(&pinnedTrees->count) == 0)
+		return false;
+
+	page_desc = O_GET_IN_MEMORY_PAGEDESC(blkno);
+	oids = *((volatile ORelOids *) &page_desc->oids);
+	if (!ORelOidsIsValid(oids) || IS_SYS_TREE_OIDS(oids))
+		return false;
+
+	key = PINNED_TREE_KEY(oids.datoid, oids.reloid);
+	for (i = 0; i < PINNED_TREES_MAX; i++)
+	{
+		if (pg_atomic_read_u64(&pinnedTrees->trees[i].key) == key)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Returns the trees of the relation: all the trees of the table, or the
+ * single tree of the index.  The relation stays locked till the end of the
+ * transaction.
+ */
+static List *
+relation_get_trees(Oid relid)
+{
+	Relation	rel;
+	ORelOids	oids;
+	OTableDescr *descr;
+	List	   *result = NIL;
+	bool		index = false;
+	int			i;
+
+	rel = relation_open(relid, AccessShareLock);
+	if (rel->rd_rel->relkind == RELKIND_INDEX)
+	{
+		Oid			tableOid = rel->rd_index->indrelid;
+
+		relation_close(rel, NoLock);
+		rel = relation_open(tableOid, AccessShareLock);
+		index = true;
+	}
+
+	if (!is_orioledb_rel(rel))
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("\"%s\" is not an orioledb table",
+						RelationGetRelationName(rel))));
+
+	ORelOidsSetFromRel(oids, rel);
+	descr = o_fetch_table_descr(oids);
+	relation_close(rel, NoLock);
+
+	for (i = 0; i < descr->nIndices; i++)
+	{
+		if (!index || descr->indices[i]->oids.reloid == relid)
+			result = lappend(result, &descr->indices[i]->desc);
+	}
+	if (!index)
+		result = lappend(result, &descr->toast->desc);
+
+	return result;
+}
+
+Datum
+orioledb_tree_pin(PG_FUNCTION_ARGS)
+{
+	Oid			relid = PG_GETARG_OID(0);
+	List	   *trees;
+	ListCell   *lc;
+	uint64		pages = 0,
+				total,
+				limit;
+	int			nfree = 0,
+				nnew = 0,
+				i;
+	bool		tooLarge;
+
+	orioledb_check_shmem();
+
+	trees = relation_get_trees(relid);
+	foreach(lc, trees)
+	{
+		BTreeDescr *desc = (BTreeDescr *) lfirst(lc);
+
+		if (desc->storageType == BTreeStorageInMemory)
+			continue;
+		o_btree_load_shmem(desc);
+		pages += pg_atomic_read_u32(&BTREE_GET_META(desc)->leafPagesNum);
+	}
+
+	limit = (uint64) get_ppool(OPagePoolMain)->size * pinned_pages_limit / 100;
+
+	SpinLockAcquire(&pinnedTrees->lock);
+
+	/* Count the trees, which aren't pinned yet, and the free slots */
+	for (i = 0; i < PINNED_TREES_MAX; i++)
+	{
+		if (pg_atomic_read_u64(&pinnedTrees->trees[i].key) == 0)
+			nfree++;
+	}
+	foreach(lc, trees)
+	{
+		BTreeDescr *desc = (BTreeDescr *) lfirst(lc);
+		uint64		key = PINNED_TREE_KEY(desc->oids.datoid, desc->oids.reloid);
+
+		for (i = 0; i < PINNED_TREES_MAX; i++)
+		{
+			if (pg_atomic_read_u64(&pinnedTrees->trees[i].key) == key)
+			{
+				pages -= Min(pages, pinnedTrees->trees[i].pages);
+				break;
+			}
+		}
+		if (i == PINNED_TREES_MAX)
+			nnew++;
+	}
+
+	total = pinnedTrees->pages + pages;
+	tooLarge = total > limit;
+	if (tooLarge || nnew > nfree)
+	{
+		SpinLockRelease(&pinnedTrees->lock);
+		if (tooLarge)
+			ereport(ERROR,
+					(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+					 errmsg("pinned trees would exceed orioledb.pinned_pages_limit"),
+					 errdetail("The pinned trees would have %llu leaves, the limit is %llu.",
+							   (unsigned long long) total,
+							   (unsigned long long) limit)));
+		else
+			ereport(ERROR,
+					(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+					 errmsg("too many pinned trees"),
+					 errdetail("At most %d trees can be pinned.",
+							   PINNED_TREES_MAX)));
+	}
+
+	foreach(lc, trees)
+	{
+		BTreeDescr *desc = (BTreeDescr *) lfirst(lc);
+		uint64		key = PINNED_TREE_KEY(desc->oids.datoid, desc->oids.reloid);
+		uint64		treePages = 0;
+		int			freeSlot = -1;
+
+		if (desc->storageType != BTreeStorageInMemory)
+			treePages = pg_atomic_read_u32(&BTREE_GET_META(desc)->leafPagesNum);
+
+		for (i = 0; i < PINNED_TREES_MAX; i++)
+		{
+			uint64		curKey = pg_atomic_read_u64(&pinnedTrees->trees[i].key);
+
+			if (curKey == key)
+				break;
+			if (curKey == 0 && freeSlot < 0)
+				freeSlot = i;
+		}
+
+		if (i < PINNED_TREES_MAX)
+		{
+			/* Already pinned, refresh the size estimate */
+			pinnedTrees->pages -= pinnedTrees->trees[i].pages;
+			pinnedTrees->trees[i].pages = treePages;
+		}
+		else
+		{
+			Assert(freeSlot >= 0);
+			pinnedTrees->trees[freeSlot].pages = treePages;
+			pg_atomic_write_u64(&pinnedTrees->trees[freeSlot].key, key);
+			pg_atomic_fetch_add_u32(&pinnedTrees->count, 1);
+		}
+		pinnedTrees->pages += treePages;
+	}
+
+	SpinLockRelease(&pinnedTrees->lock);
+
+	PG_RETURN_VOID();
+}
+
+Datum
+orioledb_tree_unpin(PG_FUNCTION_ARGS)
+{
+	Oid			relid = PG_GETARG_OID(0);
+	List	   *trees;
+	ListCell   *lc;
+	int			i;
+
+	orioledb_check_shmem();
+
+	trees = relation_get_trees(relid);
+
+	SpinLockAcquire(&pinnedTrees->lock);
+	foreach(lc, trees)
+	{
+		BTreeDescr *desc = (BTreeDescr *) lfirst(lc);
+		uint64		key = PINNED_TREE_KEY(desc->oids.datoid, desc->oids.reloid);
+
+		for (i = 0; i < PINNED_TREES_MAX; i++)
+		{
+			if (pg_atomic_read_u64(&pinnedTrees->trees[i].key) == key)
+			{
+				pinnedTrees->pages -= pinnedTrees->trees[i].pages;
+				pinnedTrees->trees[i].pages = 0;
+				pg_atomic_write_u64(&pinnedTrees->trees[i].key, 0);
+				pg_atomic_fetch_sub_u32(&pinnedTrees->count, 1);
+				break;
+			}
+		}
+	}
+	SpinLockRelease(&pinnedTrees->lock);
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * Returns the number of in-memory pages of every tree in all the page pools.
+ * The page descriptors are read without locks, so the result is
+ * approximate.
+ */
+Datum
+orioledb_tree_residency(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	HASHCTL		ctl;
+	HTAB	   *residency;
+	HASH_SEQ_STATUS hash_seq;
+	TreeResidencyEntry *entry;
+	int			i;
+
+	orioledb_check_shmem();
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	ctl.keysize = offsetof(TreeResidencyEntry, pages);
+	ctl.entrysize = sizeof(TreeResidencyEntry);
+	ctl.hcxt = CurrentMemoryContext;
+	residency = hash_create("orioledb tree residency", 256, &ctl,
+							HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	for (i = 0; i < OPagePoolTypesCount; i++)
+	{
+		OPagePool  *pool = get_ppool((OPagePoolType) i);
+		OInMemoryBlkno blkno;
+
+		for (blkno = pool->offset; blkno < pool->offset + pool->size; blkno++)
+		{
+			OrioleDBPageDesc *page_desc = O_GET_IN_MEMORY_PAGEDESC(blkno);
+			TreeResidencyEntry key;
+			bool		found;
+
+			memset(&key, 0, sizeof(key));
+			key.oids = *((volatile ORelOids *) &page_desc->oids);
+			key.type = page_desc->type;
+			if (!ORelOidsIsValid(key.oids) || key.type == oIndexInvalid)
+				continue;
+
+			entry = (TreeResidencyEntry *) hash_search(residency, &key,
+													   HASH_ENTER, &found);
+			if (!found)
+			{
+				entry->pages = 0;
+				entry->leafPages = 0;
+				entry->dirtyPages = 0;
+			}
+			entry->pages++;
+			if (O_PAGE_IS(O_GET_IN_MEMORY_PAGE(blkno), LEAF))
+				entry->leafPages++;
+			if (IS_DIRTY(blkno))
+				entry->dirtyPages++;
+		}
+	}
+
+	hash_seq_init(&hash_seq, residency);
+	while ((entry = (TreeResidencyEntry *) hash_seq_search(&hash_seq)) != NULL)
+	{
+		Datum		values[8];
+		bool		nulls[8] = {false};
+
+		values[0] = ObjectIdGetDatum(entry->oids.datoid);
+		values[1] = ObjectIdGetDatum(entry->oids.reloid);
+		values[2] = ObjectIdGetDatum(entry->oids.relnode);
+		values[3] = Int64GetDatum(entry->pages);
+		values[4] = Int64GetDatum(entry->leafPages);
+		values[5] = Int64GetDatum(entry->dirtyPages);
+		values[6] = Int64GetDatum(entry->pages * ORIOLEDB_BLCKSZ);
+		values[7] = BoolGetDatum(!IS_SYS_TREE_OIDS(entry->oids) &&
+								 o_tree_is_pinned(entry->oids));
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+	hash_destroy(residency);
+
+	return (Datum) 0;
+}
+
+/*
+ * Checks if the tree is pinned.
+ */
+bool
+o_tree_is_pinned(ORelOids oids)
+{
+	uint64		key = PINNED_TREE_KEY(oids.datoid, oids.reloid);
+	int			i;
+
+	for (i = 0; i < PINNED_TREES_MAX; i++)
+	{
+		if (pg_atomic_read_u64(&pinnedTrees->trees[i].key) == key)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Copies the internal page and returns the fraction of its downlinks pointing
+ * to the in-memory pages.  Remembers up to 'maxChildren' of those in
+ * 'children'.  Returns a negative value if the page doesn't belong to the
+ * tree anymore or isn't internal.
+ */
+static double
+internal_page_resident_fraction(BTreeDescr *desc, OInMemoryBlkno blkno,
+								OInMemoryBlkno *children, int maxChildren,
+								int *nChildren)
+{
+	char		img[ORIOLEDB_BLCKSZ];
+	OrioleDBPageDesc *pageDesc = O_GET_IN_MEMORY_PAGEDESC(blkno);
+	BTreePageItemLocator loc;
+	int			nDownlinks = 0,
+				nInMemory = 0;
+
+	lock_page(blkno);
+	memcpy(img, O_GET_IN_MEMORY_PAGE(blkno), ORIOLEDB_BLCKSZ);
+	if (pageDesc->oids.datoid != desc->oids.datoid ||
+		pageDesc->oids.relnode != desc->oids.relnode)
+	{
+		unlock_page(blkno);
+		return -1.0;
+	}
+	unlock_page(blkno);
+
+	if (O_PAGE_IS(img, LEAF))
+		return -1.0;
+
+	BTREE_PAGE_FOREACH_ITEMS(img, &loc)
+	{
+		BTreeNonLeafTuphdr *tuphdr;
+		OTuple		tuple;
+
+		BTREE_PAGE_READ_INTERNAL_ITEM(tuphdr, tuple, img, &loc);
+		nDownlinks++;
+		if (DOWNLINK_IS_IN_MEMORY(tuphdr->downlink))
+		{
+			nInMemory++;
+			if (*nChildren < maxChildren)
+				children[(*nChildren)++] = DOWNLINK_GET_IN_MEMORY_BLKNO(tuphdr->downlink);
+		}
+	}
+
+	return nDownlinks > 0 ? (double) nInMemory / nDownlinks : 1.0;
+}
+
+/*
+ * Estimates the fraction of the tree leaves residing in the page pool.  Looks
+ * only at the root and at a few of its in-memory children, so it's cheap
+ * enough for the planner.
+ */
+double
+o_tree_resident_fraction(BTreeDescr *desc)
+{
+	OInMemoryBlkno children[RESIDENCY_SAMPLE_CHILDREN];
+	OInMemoryBlkno rootBlkno;
+	int			nChildren = 0,
+				nSampled = 0,
+				i;
+	double		rootFraction,
+				childrenFraction = 0.0;
+
+	if (desc->storageType == BTreeStorageInMemory)
+		return 1.0;
+
+	o_btree_load_shmem(desc);
+	rootBlkno = desc->rootInfo.rootPageBlkno;
+	if (O_PAGE_IS(O_GET_IN_MEMORY_PAGE(rootBlkno), LEAF))
+		return 1.0;
+
+	rootFraction = internal_page_resident_fraction(desc, rootBlkno, children,
+												   RESIDENCY_SAMPLE_CHILDREN,
+												   &nChildren);
+	if (rootFraction < 0.0)
+		return 1.0;
+
+	for (i = 0; i < nChildren; i++)
+	{
+		double		fraction;
+		int			nGrandChildren = 0;
+
+		fraction = internal_page_resident_fraction(desc, children[i], NULL, 0,
+												   &nGrandChildren);
+		if (fraction < 0.0)
+			continue;
+		childrenFraction += fraction;
+		nSampled++;
+	}
+
+	if (nSampled == 0)
+		return rootFraction;
+	return rootFraction * childrenFraction / nSampled;
+}
+
+/*
+ * Scales the number of the pages the planner expects to read from the tree
+ * according to its residency and storage.  The pages residing in the page
+ * pool are nearly free to read, while the evicted pages of S3 trees cost
+ * far more than the local ones.
+ */
+BlockNumber
+o_tree_costed_pages(BTreeDescr *desc, BlockNumber pages)
+{
+	double		resident,
+				factor;
+
+	if (pages == 0)
+		return 0;
+
+	resident = o_tree_resident_fraction(desc);
+	factor = resident * RESIDENT_PAGE_COST_FACTOR +
+		(1.0 - resident) * (orioledb_s3_mode ? S3_PAGE_COST_FACTOR : 1.0);
+
+	return (BlockNumber) Max(1.0, Min(ceil(pages * factor),
+									  (double) MaxBlockNumber));
+}
+
+/*
+ * Remembers the low key of every leaf, but doesn't let the scan read any of
+ * them.
+ */
+static bool
+prewarm_collect_range(OTuple low, OTuple high, void *arg)
+{
+	PrewarmState *state = (PrewarmState *) arg;
+	PrewarmKey *key;
+	int			len = 0;
+
+	if (!O_TUPLE_IS_NULL(low))
+		len = o_btree_len(state->desc, low, OKeyLength);
+
+	key = (PrewarmKey *) MemoryContextAlloc(state->mcxt,
+											sizeof(PrewarmKey) + len);
+	if (O_TUPLE_IS_NULL(low))
+	{
+		O_TUPLE_SET_NULL(key->key);
+	}
+	else
+	{
+		key->key.formatFlags = low.formatFlags;
+		key->key.data = (Pointer) key + sizeof(PrewarmKey);
+		memcpy(key->key.data, low.data, len);
+	}
+	state->keys = lappend(state->keys, key);
+	return false;
+}
+
+static bool
+prewarm_next_key(OFixedKey *key, bool inclusive, void *arg)
+{
+	return false;
+}
+
+/*
+ * Loads the leaf of the given low key into the page pool.  The leftmost
+ * leaf has no low key.
+ */
+static void
+prewarm_load_leaf(BTreeDescr *desc, PrewarmKey *key)
+{
+	if (O_TUPLE_IS_NULL(key->key))
+	{
+		BTreeIterator *it;
+		OTuple		tuple;
+
+		it = o_btree_iterator_create(desc, NULL, BTreeKeyNone,
+									 &o_in_progress_snapshot,
+									 ForwardScanDirection);
+		tuple = o_btree_iterator_fetch(it, NULL, NULL, BTreeKeyNone,
+									   false, NULL);
+		if (!O_TUPLE_IS_NULL(tuple))
+			pfree(tuple.data);
+		btree_iterator_free(it);
+	}
+	else
+	{
+		OTuple		tuple;
+
+		tuple = o_btree_find_tuple_by_key(desc, &key->key,
+										  BTreeKeyNonLeafKey,
+										  &o_in_progress_snapshot, NULL,
+										  CurrentMemoryContext, NULL);
+		if (!O_TUPLE_IS_NULL(tuple))
+			pfree(tuple.data);
+	}
+}
+
+/*
+ * Loads the leaves of the tree into the page pool.  The low keys of the
+ * leaves are collected first, then the leaves are looked up in the key
+ * order, while the reads of the following leaves are prefetched.  Stops
+ * once the page pool is almost full, so the prewarm never evicts anything.
+ * Returns the number of leaves looked up.
+ */
+static int64
+prewarm_tree(BTreeDescr *desc)
+{
+	OPagePool  *pool = desc->ppool;
+	PrewarmState state;
+	BTreeSeqScanCallbacks cb = {
+		.isRangeValid = prewarm_collect_range,
+		.getNextKey = prewarm_next_key
+	};
+	BTreeSeqScan *scan;
+	MemoryContext loadContext;
+	ListCell   *lc;
+	bool		end = false;
+	int64		prefetched = 0,
+				loaded = 0;
+
+	if (desc->storageType == BTreeStorageInMemory)
+		return 0;
+
+	state.desc = desc;
+	state.mcxt = CurrentMemoryContext;
+	state.keys = NIL;
+	scan = make_btree_seq_scan_cb(desc, &o_in_progress_snapshot, &cb, &state);
+	while (!end)
+		(void) btree_seq_scan_getnext_raw(scan, CurrentMemoryContext, &end, NULL);
+	free_btree_seq_scan(scan);
+
+	loadContext = AllocSetContextCreate(CurrentMemoryContext,
+										"orioledb prewarm context",
+										ALLOCSET_DEFAULT_SIZES);
+	foreach(lc, state.keys)
+	{
+		PrewarmKey *key = (PrewarmKey *) lfirst(lc);
+		MemoryContext prevContext;
+
+		if (ppool_free_pages_count(pool) < pool->size / 10)
+			break;
+
+		while (prefetched < list_length(state.keys) &&
+			   prefetched < loaded + PREWARM_PREFETCH_DISTANCE)
+		{
+			PrewarmKey *next = (PrewarmKey *) list_nth(state.keys, prefetched);
+
+			if (!O_TUPLE_IS_NULL(next->key))
+				btree_prefetch_key(desc, (Pointer) &next->key,
+								   BTreeKeyNonLeafKey);
+			prefetched++;
+		}
+
+		prevContext = MemoryContextSwitchTo(loadContext);
+		prewarm_load_leaf(desc, key);
+		MemoryContextSwitchTo(prevContext);
+		MemoryContextReset(loadContext);
+		loaded++;
+
+		CHECK_FOR_INTERRUPTS();
+	}
+	MemoryContextDelete(loadContext);
+
+	return loaded;
+}
+
+Datum
+orioledb_prewarm(PG_FUNCTION_ARGS)
+{
+	Oid			relid = PG_GETARG_OID(0);
+	List	   *trees;
+	ListCell   *lc;
+	int64		result = 0;
+
+	orioledb_check_shmem();
+
+	trees = relation_get_trees(relid);
+	foreach(lc, trees)
+	{
+		BTreeDescr *desc = (BTreeDescr *) lfirst(lc);
+
+		o_btree_load_shmem(desc);
+		result += prewarm_tree(desc);
+	}
+
+	PG_RETURN_INT64(result);
+}
@@ -36,6 +36,29 @@
  *		   on-disk downlinks to the dsm.  The leader sorts on-disk downlinks.
  *		5. Workers process on-disk downlinks in parallel one by one.
  *
+ * SCAN RESISTANCE
+ *
+ *		Leaves read from disk never get into the page pool: they are read
+ *		into the private image of the scan.  But the internal pages are
+ *		loaded into the pool and the in-memory pages accessed get hotter.
+ *		So, sampling scans and the scans of trees bigger than a quarter of
+ *		the page pool don't increase the usage counts of the pages, and the
+ *		pages they load get the coldest usage count (see set_cold_ucm()).
+ *		Thus, they are evicted first, and the hot set survives the scan.
+ *
+ * SAMPLING
+ *
+ *		When the sampler asks for a small fraction of a tall tree's leaves,
+ *		walking all the internal pages of level 1 would read much more than
+ *		the sampled leaves themselves.  Then each sampled leaf is chosen by a
+ *		random walk from the root instead.  On every internal page, the walk
+ *		picks a random slot among the largest fan-out seen on that level so
+ *		far and restarts if the slot is past the last downlink.  This
+ *		acceptance/rejection makes every leaf equally likely regardless of
+ *		the fan-outs along its path (exactly so once the maximal fan-outs are
+ *		known).  Leaves sampled twice are rejected as well.  On-disk leaves
+ *		are collected and read in disk order like in the regular scan.
+ *
  *-------------------------------------------------------------------------
  */
 #include "postgres.h"
@@ -49,14 +72,32 @@
 #include "btree/page_chunks.h"
 #include "btree/scan.h"
 #include "btree/undo.h"
+#include "btree/zone_map.h"
+#include "s3/worker.h"
 #include "transam/oxid.h"
 #include "tuple/slot.h"
+#include "utils/page_pool.h"
 #include "utils/sampling.h"
 #include "utils/stopevent.h"
+#include "utils/ucm.h"
 
+#include "common/pg_prng.h"
 #include "miscadmin.h"
+#include "storage/bufmgr.h"
+#include "utils/hsearch.h"
 #include "utils/wait_event.h"
 
+/* Maximum number of tuples fetched from the iterator at once */
+#define BTREE_SEQ_SCAN_ITER_BATCH_SIZE	64
+
+/*
+ * Sample leaves by random walks when the sampler asks for less than one of
+ * that many leaves, see SAMPLING.
+ */
+#define BTREE_SAMPLING_WALK_RATIO		16
+/* Maximum number of random walks made for a single sampled leaf */
+#define BTREE_SAMPLING_WALK_ATTEMPTS	64
+
 typedef enum
 {
 	BTreeSeqScanInMemory,
@@ -103,9 +144,16 @@ struct BTreeSeqScan
 	int64		downlinksCount;
 	int64		downlinkIndex;
 	int64		allocatedDownlinks;
+	int64		prefetchIndex;
 
 	BTreeIterator *iter;
 	OTuple		iterEnd;
+	/* tuples fetched from the iterator, but not yet returned */
+	int			iterTuplesCount;
+	int			iterTuplesIndex;
+	OTuple		iterTuples[BTREE_SEQ_SCAN_ITER_BATCH_SIZE];
+	CommitSeqNo iterCsns[BTREE_SEQ_SCAN_ITER_BATCH_SIZE];
+	BTreeLocationHint iterHint;
 
 	/*
 	 * Number of the last completed checkpoint when scan was started.  We need
@@ -120,11 +168,19 @@ struct BTreeSeqScan
 
 	OFixedKey	nextKey;
 
+	/* Don't make the pages hotter, see SCAN RESISTANCE */
+	bool		coldUcm;
+
 	bool		needSampling;
 	BlockSampler sampler;
 	BlockNumber samplingNumber;
 	BlockNumber samplingNext;
 
+	/* Sampling by random walks from the root, see SAMPLING */
+	bool		randomWalk;
+	uint16		walkMaxFanout[ORIOLEDB_MAX_DEPTH];
+	HTAB	   *walkSampled;
+
 	BTreeSeqScanCallbacks *cb;
 	void	   *arg;
 	bool		isSingleLeafPage;	/* Scan couldn't read first internal page */
@@ -132,6 +188,10 @@ struct BTreeSeqScan
 				keyRangeHigh;
 	bool		firstPageIsLoaded;
 
+	/* Conditions for zone map pruning and the counter of skipped leaves */
+	OZoneMapQual *zoneMap;
+	uint64	   *zoneMapSkipped;
+
 	/* Private parallel worker info in a backend */
 	ParallelOScanDesc poscan;
 	bool		isLeader;
@@ -569,6 +629,96 @@ get_next_key(BTreeSeqScan *scan, BTreePageItemLocator *intLoc, OFixedKey *nextKe
 		clear_fixed_key(nextKey);
 }
 
+/*
+ * Makes a random walk from the root to a leaf downlink.  Returns false if
+ * the walk is rejected, see SAMPLING.
+ */
+static bool
+random_walk_downlink(BTreeSeqScan *scan, uint64 *downlink,
+					 OFixedKey *keyRangeLow, OFixedKey *keyRangeHigh)
+{
+	BTreeDescr *desc = scan->desc;
+	Page		img = scan->context.img;
+	BTreePageItemLocator loc;
+	OFixedKey	key;
+	uint16		level;
+
+	clear_fixed_key(&key);
+	level = PAGE_GET_LEVEL(O_GET_IN_MEMORY_PAGE(desc->rootInfo.rootPageBlkno));
+
+	while (true)
+	{
+		int			count;
+		uint64		slot;
+
+		if (O_TUPLE_IS_NULL(key.tuple))
+			find_page(&scan->context, NULL, BTreeKeyNone, level);
+		else
+			find_page(&scan->context, &key.tuple, BTreeKeyNonLeafKey, level);
+
+		/* The root might be concurrently split or merged */
+		if (level == 0 || PAGE_GET_LEVEL(img) != level)
+			return false;
+
+		count = BTREE_PAGE_ITEMS_COUNT(img);
+		if (count == 0)
+			return false;
+		scan->walkMaxFanout[level] = Max(scan->walkMaxFanout[level], count);
+		slot = pg_prng_uint64_range(&scan->sampler->randstate, 0,
+									scan->walkMaxFanout[level] - 1);
+		if (slot >= count)
+			return false;
+		BTREE_PAGE_OFFSET_GET_LOCATOR(img, (OffsetNumber) slot, &loc);
+
+		if (level == 1)
+		{
+			OTuple		lokey;
+
+			if (O_PAGE_IS(img, LEFTMOST))
+				O_TUPLE_SET_NULL(lokey);
+			else
+				lokey = scan->context.lokey.tuple;
+
+			get_current_downlink_key(scan, &loc, 0, lokey, keyRangeLow,
+									 downlink, img);
+			get_next_key(scan, &loc, keyRangeHigh, img);
+			return true;
+		}
+
+		/* The first downlink is reached by the key we came here with */
+		if (slot > 0)
+			copy_fixed_page_key(desc, &key, img, &loc);
+		level--;
+	}
+}
+
+/*
+ * Gets the downlink of the next sampled leaf by random walks.
+ */
+static bool
+get_random_downlink(BTreeSeqScan *scan, uint64 *downlink,
+					OFixedKey *keyRangeLow, OFixedKey *keyRangeHigh)
+{
+	while (BlockSampler_HasMore(scan->sampler))
+	{
+		int			attempt;
+
+		(void) BlockSampler_Next(scan->sampler);
+		for (attempt = 0; attempt < BTREE_SAMPLING_WALK_ATTEMPTS; attempt++)
+		{
+			bool		found;
+
+			if (!random_walk_downlink(scan, downlink, keyRangeLow, keyRangeHigh))
+				continue;
+
+			(void) hash_search(scan->walkSampled, downlink, HASH_ENTER, &found);
+			if (!found)
+				return true;
+		}
+	}
+	return false;
+}
+
 /*
  * Gets the next downlink with it's keyrange (low and high keys of the
  * keyrange).
@@ -586,7 +736,11 @@ get_next_downlink(BTreeSeqScan *scan, uint64 *downlink,
 {
 	ParallelOScanDesc poscan = scan->poscan;
 
-	if (!poscan)
+	if (scan->randomWalk)
+	{
+		return get_random_downlink(scan, downlink, keyRangeLow, keyRangeHigh);
+	}
+	else if (!poscan)
 	{
 		/* Non-parallel case */
 		bool		pageIsLoaded = scan->firstPageIsLoaded;
@@ -778,11 +932,10 @@ get_next_downlink(BTreeSeqScan *scan, uint64 *downlink,
  * Hikey of leaf page should match to next downlink or internal page hikey if
  * we're considering the last downlink.
  */
-static void
-check_in_memory_leaf_page(BTreeSeqScan *scan, OTuple keyRangeLow, OTuple keyRangeHigh)
+static bool
+leaf_hikey_matches(BTreeSeqScan *scan, OTuple keyRangeHigh)
 {
 	OTuple		leafHikey;
-	bool		result = false;
 
 	if (!O_PAGE_IS(scan->leafImg, RIGHTMOST))
 		BTREE_PAGE_GET_HIKEY(leafHikey, scan->leafImg);
@@ -790,27 +943,67 @@ check_in_memory_leaf_page(BTreeSeqScan *scan, OTuple keyRangeLow, OTuple keyRang
 		O_TUPLE_SET_NULL(leafHikey);
 
 	if (O_TUPLE_IS_NULL(keyRangeHigh) && O_TUPLE_IS_NULL(leafHikey))
-		return;
+		return true;
 
 	if (O_TUPLE_IS_NULL(keyRangeHigh) || O_TUPLE_IS_NULL(leafHikey))
-	{
-		result = true;
-	}
-	else
-	{
-		if (o_btree_cmp(scan->desc,
-						&keyRangeHigh, BTreeKeyNonLeafKey,
-						&leafHikey, BTreeKeyNonLeafKey) != 0)
-			result = true;
-	}
+		return false;
+
+	return o_btree_cmp(scan->desc,
+					   &keyRangeHigh, BTreeKeyNonLeafKey,
+					   &leafHikey, BTreeKeyNonLeafKey) == 0;
+}
 
-	if (result)
+static void
+check_in_memory_leaf_page(BTreeSeqScan *scan, OTuple keyRangeLow, OTuple keyRangeHigh)
+{
+	if (!leaf_hikey_matches(scan, keyRangeHigh))
 	{
 		elog(DEBUG3, "scan_make_iterator 2");
 		scan_make_iterator(scan, keyRangeLow, keyRangeHigh);
 	}
 }
 
+/*
+ * Checks if the zone map allows to skip the in-memory leaf page without
+ * reading it as a whole.  The leaf summary must be built for the current
+ * page state.  We check that on the partial image, which has only the header
+ * and the hikeys.  The partial image also lets us check that the leaf still
+ * covers the downlink key range, and the scan doesn't need its historical
+ * image.
+ */
+static bool
+zone_map_skip_leaf(BTreeSeqScan *scan, OInMemoryBlkno blkno,
+				   uint32 pageChangeCount)
+{
+	PartialPageState partial;
+	BTreePageHeader *header;
+	uint32		state;
+
+	if (!zone_map_leaf_is_excluded(scan->desc, scan->zoneMap, blkno,
+								   pageChangeCount, &state))
+		return false;
+
+	memset(&partial, 0, sizeof(partial));
+	if (o_btree_try_read_page(scan->desc, blkno, pageChangeCount,
+							  scan->leafImg, scan->context.imgReadCsn,
+							  NULL, BTreeKeyNone, &partial,
+							  NULL) != ReadPageResultOK ||
+		!partial.isPartial)
+		return false;
+
+	header = (BTreePageHeader *) scan->leafImg;
+	if ((pg_atomic_read_u32(&header->o_header.state) &
+		 PAGE_STATE_CHANGE_COUNT_MASK) != state)
+		return false;
+
+	if (COMMITSEQNO_IS_NORMAL(scan->oSnapshot.csn) &&
+		COMMITSEQNO_IS_NORMAL(header->csn) &&
+		header->csn >= scan->oSnapshot.csn)
+		return false;
+
+	return leaf_hikey_matches(scan, scan->keyRangeHigh.tuple);
+}
+
 
 /*
  * Interates the internal page till we either:
@@ -830,7 +1023,7 @@ iterate_internal_page(BTreeSeqScan *scan)
 		if (scan->cb && scan->cb->isRangeValid)
 			valid_downlink = scan->cb->isRangeValid(scan->keyRangeLow.tuple, scan->keyRangeHigh.tuple,
 													scan->arg);
-		else if (scan->needSampling)
+		else if (scan->needSampling && !scan->randomWalk)
 		{
 			if (scan->samplingNumber < scan->samplingNext)
 			{
@@ -856,6 +1049,16 @@ iterate_internal_page(BTreeSeqScan *scan)
 			{
 				ReadPageResult result;
 
+				if (scan->zoneMap &&
+					zone_map_skip_leaf(scan,
+									   DOWNLINK_GET_IN_MEMORY_BLKNO(downlink),
+									   DOWNLINK_GET_IN_MEMORY_CHANGECOUNT(downlink)))
+				{
+					if (scan->zoneMapSkipped)
+						(*scan->zoneMapSkipped)++;
+					continue;
+				}
+
 				result = o_btree_try_read_page(scan->desc,
 											   DOWNLINK_GET_IN_MEMORY_BLKNO(downlink),
 											   DOWNLINK_GET_IN_MEMORY_CHANGECOUNT(downlink),
@@ -874,6 +1077,10 @@ iterate_internal_page(BTreeSeqScan *scan)
 
 					scan->hint.blkno = DOWNLINK_GET_IN_MEMORY_BLKNO(downlink);
 					scan->hint.pageChangeCount = DOWNLINK_GET_IN_MEMORY_CHANGECOUNT(downlink);
+					if (scan->zoneMap)
+						zone_map_summarize_leaf(scan->desc, scan->zoneMap,
+												scan->hint.blkno,
+												scan->leafImg);
 					BTREE_PAGE_LOCATOR_FIRST(scan->leafImg, &scan->leafLoc);
 					O_TUPLE_SET_NULL(scan->nextKey.tuple);
 					load_first_historical_page(scan);
@@ -911,6 +1118,37 @@ iterate_internal_page(BTreeSeqScan *scan)
 	return false;
 }
 
+/*
+ * Issues prefetch requests for the on-disk leaves following the one with the
+ * given index.  Downlinks are sorted by their disk offsets, so this turns the
+ * sequence of synchronous reads into a stream of mostly sequential I/O.  The
+ * prefetch window is limited by effective_io_concurrency, or by
+ * orioledb.s3_prefetch_parts data file parts in S3 mode.
+ */
+static void
+prefetch_disk_leaf_pages(BTreeSeqScan *scan,
+						 BTreeSeqScanDiskDownlink *downlinks,
+						 int64 index, int64 count)
+{
+	int64		end,
+				window;
+
+	window = orioledb_s3_mode ? (int64) s3_prefetch_parts * S3_PART_PAGES :
+		effective_io_concurrency;
+	if (window <= 0)
+		return;
+
+	end = Min(index + 1 + window, count);
+	scan->prefetchIndex = Max(scan->prefetchIndex, index + 1);
+
+	while (scan->prefetchIndex < end)
+	{
+		prefetch_page_from_disk(scan->desc,
+								downlinks[scan->prefetchIndex].downlink);
+		scan->prefetchIndex++;
+	}
+}
+
 static bool
 load_next_disk_leaf_page(BTreeSeqScan *scan)
 {
@@ -926,6 +1164,8 @@ load_next_disk_leaf_page(BTreeSeqScan *scan)
 			return false;
 
 		downlink = scan->diskDownlinks[scan->downlinkIndex];
+		prefetch_disk_leaf_pages(scan, scan->diskDownlinks,
+								 scan->downlinkIndex, scan->downlinksCount);
 	}
 	else
 	{
@@ -944,6 +1184,14 @@ load_next_disk_leaf_page(BTreeSeqScan *scan)
 			return false;
 		}
 		downlink = ((BTreeSeqScanDiskDownlink *) dsm_segment_address(scan->dsmSeg))[index];
+
+		/*
+		 * Other workers claim downlinks concurrently, so some of our
+		 * prefetches may be consumed by them.  That's still useful.
+		 */
+		prefetch_disk_leaf_pages(scan,
+								 (BTreeSeqScanDiskDownlink *) dsm_segment_address(scan->dsmSeg),
+								 index, poscan->downlinksCount);
 	}
 
 	success = read_page_from_disk(scan->desc,
@@ -1071,7 +1319,24 @@ init_btree_seq_scan(BTreeSeqScan *scan)
 	if (sampler)
 	{
 		scan->needSampling = true;
-		if (BlockSampler_HasMore(scan->sampler))
+		scan->randomWalk = !poscan &&
+			(uint64) sampler->n * BTREE_SAMPLING_WALK_RATIO < sampler->N &&
+			PAGE_GET_LEVEL(O_GET_IN_MEMORY_PAGE(desc->rootInfo.rootPageBlkno)) > 1;
+
+		if (scan->randomWalk)
+		{
+			HASHCTL		ctl;
+
+			memset(scan->walkMaxFanout, 0, sizeof(scan->walkMaxFanout));
+			ctl.keysize = sizeof(uint64);
+			ctl.entrysize = sizeof(uint64);
+			ctl.hcxt = scan->mctx;
+			scan->walkSampled = hash_create("orioledb sampled leaves",
+											sampler->n, &ctl,
+											HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+			scan->samplingNext = InvalidBlockNumber;
+		}
+		else if (BlockSampler_HasMore(scan->sampler))
 			scan->samplingNext = BlockSampler_Next(scan->sampler);
 		else
 			scan->samplingNext = InvalidBlockNumber;
@@ -1082,8 +1347,14 @@ init_btree_seq_scan(BTreeSeqScan *scan)
 		scan->samplingNext = InvalidBlockNumber;
 	}
 
+	scan->coldUcm = sampler != NULL ||
+		pg_atomic_read_u32(&BTREE_GET_META(desc)->leafPagesNum) > desc->ppool->size / 4;
+
 	O_TUPLE_SET_NULL(scan->nextKey.tuple);
 
+	if (scan->coldUcm)
+		set_cold_ucm();
+
 	init_page_find_context(&scan->context, desc, scan->oSnapshot.csn,
 						   BTREE_PAGE_FIND_IMAGE |
 						   BTREE_PAGE_FIND_KEEP_LOKEY |
@@ -1099,6 +1370,9 @@ init_btree_seq_scan(BTreeSeqScan *scan)
 			scan->status = BTreeSeqScanFinished;
 	}
 
+	if (scan->coldUcm)
+		unset_cold_ucm();
+
 	scan->initialized = true;
 }
 
@@ -1117,19 +1391,27 @@ make_btree_seq_scan_internal(BTreeDescr *desc, OSnapshot *oSnapshot,
 	scan->allocatedDownlinks = 16;
 	scan->downlinksCount = 0;
 	scan->downlinkIndex = 0;
+	scan->prefetchIndex = 0;
 	scan->diskDownlinks = (BTreeSeqScanDiskDownlink *) palloc(sizeof(scan->diskDownlinks[0]) * scan->allocatedDownlinks);
 	scan->mctx = CurrentMemoryContext;
 	scan->iter = NULL;
+	scan->iterTuplesCount = 0;
+	scan->iterTuplesIndex = 0;
 	scan->cb = cb;
 	scan->arg = arg;
 	scan->firstPageIsLoaded = false;
 	scan->intStartOffset = 0;
 	scan->samplingNumber = 0;
 	scan->sampler = sampler;
+	scan->randomWalk = false;
+	scan->walkSampled = NULL;
 	scan->dsmSeg = NULL;
 	scan->initialized = false;
 	scan->checkpointNumberSet = false;
 	scan->haveHistImg = false;
+	scan->zoneMap = NULL;
+	scan->zoneMapSkipped = NULL;
+	scan->coldUcm = false;
 	BTREE_PAGE_LOCATOR_SET_INVALID(&scan->leafLoc);
 
 	dlist_push_tail(&listOfScans, &scan->listNode);
@@ -1159,6 +1441,20 @@ make_btree_sampling_scan(BTreeDescr *desc, BlockSampler sampler)
 										NULL, NULL, sampler, NULL);
 }
 
+/*
+ * Makes the scan skip the in-memory leaves, where the zone map shows no
+ * tuples matching the qual.  Skipped leaves are counted in *skipped if it's
+ * given.  Must be called before fetching the first tuple.
+ */
+void
+btree_seq_scan_set_zone_map(BTreeSeqScan *scan, OZoneMapQual *qual,
+							uint64 *skipped)
+{
+	Assert(!scan->initialized);
+	scan->zoneMap = qual;
+	scan->zoneMapSkipped = skipped;
+}
+
 static OTuple
 btree_seq_scan_get_tuple_from_iterator(BTreeSeqScan *scan,
 									   CommitSeqNo *tupleCsn,
@@ -1166,21 +1462,44 @@ btree_seq_scan_get_tuple_from_iterator(BTreeSeqScan *scan,
 {
 	OTuple		result;
 
-	if (!O_TUPLE_IS_NULL(scan->iterEnd))
-		result = o_btree_iterator_fetch(scan->iter, tupleCsn,
-										&scan->iterEnd, BTreeKeyNonLeafKey,
-										false, hint);
-	else
-		result = o_btree_iterator_fetch(scan->iter, tupleCsn,
-										NULL, BTreeKeyNone,
-										false, hint);
-
-	if (O_TUPLE_IS_NULL(result))
+	if (scan->iterTuplesIndex >= scan->iterTuplesCount)
 	{
-		btree_iterator_free(scan->iter);
-		scan->iter = NULL;
-		scan->haveHistImg = false;
+		scan->iterTuplesIndex = 0;
+		if (!O_TUPLE_IS_NULL(scan->iterEnd))
+			scan->iterTuplesCount = o_btree_iterator_fetch_batch(scan->iter,
+																 scan->iterTuples,
+																 scan->iterCsns,
+																 BTREE_SEQ_SCAN_ITER_BATCH_SIZE,
+																 &scan->iterEnd,
+																 BTreeKeyNonLeafKey,
+																 false,
+																 &scan->iterHint);
+		else
+			scan->iterTuplesCount = o_btree_iterator_fetch_batch(scan->iter,
+																 scan->iterTuples,
+																 scan->iterCsns,
+																 BTREE_SEQ_SCAN_ITER_BATCH_SIZE,
+																 NULL,
+																 BTreeKeyNone,
+																 false,
+																 &scan->iterHint);
+
+		if (scan->iterTuplesCount == 0)
+		{
+			btree_iterator_free(scan->iter);
+			scan->iter = NULL;
+			scan->haveHistImg = false;
+			O_TUPLE_SET_NULL(result);
+			return result;
+		}
 	}
+
+	result = scan->iterTuples[scan->iterTuplesIndex];
+	if (tupleCsn)
+		*tupleCsn = scan->iterCsns[scan->iterTuplesIndex];
+	if (hint)
+		*hint = scan->iterHint;
+	scan->iterTuplesIndex++;
 	return result;
 }
 
@@ -1307,12 +1626,33 @@ apply_next_key(BTreeSeqScan *scan)
 	}
 }
 
+/*
+ * Finds the visible version of the tuple in the private page image of the
+ * scan.  Avoids copying the tuple if 'allocated' is given.
+ */
+static inline OTuple
+seq_scan_find_tuple_version(BTreeSeqScan *scan, Page img,
+							BTreePageItemLocator *loc, CommitSeqNo *tupleCsn,
+							MemoryContext mctx, bool *allocated)
+{
+	if (allocated)
+		return o_find_tuple_version_ref(scan->desc, img, loc,
+										&scan->oSnapshot, tupleCsn,
+										mctx, allocated);
+	return o_find_tuple_version(scan->desc, img, loc, &scan->oSnapshot,
+								tupleCsn, mctx, NULL, NULL);
+}
+
 static OTuple
 btree_seq_scan_getnext_internal(BTreeSeqScan *scan, MemoryContext mctx,
-								CommitSeqNo *tupleCsn, BTreeLocationHint *hint)
+								CommitSeqNo *tupleCsn, BTreeLocationHint *hint,
+								bool *allocated)
 {
 	OTuple		tuple;
 
+	if (allocated)
+		*allocated = true;
+
 	if (scan->iter)
 	{
 		tuple = btree_seq_scan_get_tuple_from_iterator(scan, tupleCsn, hint);
@@ -1407,14 +1747,9 @@ btree_seq_scan_getnext_internal(BTreeSeqScan *scan, MemoryContext mctx,
 				}
 			}
 
-			tuple = o_find_tuple_version(scan->desc,
-										 scan->histImg,
-										 &scan->histLoc,
-										 &scan->oSnapshot,
-										 tupleCsn,
-										 mctx,
-										 NULL,
-										 NULL);
+			tuple = seq_scan_find_tuple_version(scan, scan->histImg,
+												&scan->histLoc, tupleCsn,
+												mctx, allocated);
 			BTREE_PAGE_LOCATOR_NEXT(scan->histImg, &scan->histLoc);
 			if (!O_TUPLE_IS_NULL(tuple))
 			{
@@ -1460,14 +1795,9 @@ btree_seq_scan_getnext_internal(BTreeSeqScan *scan, MemoryContext mctx,
 			continue;
 		}
 
-		tuple = o_find_tuple_version(scan->desc,
-									 scan->leafImg,
-									 &scan->leafLoc,
-									 &scan->oSnapshot,
-									 tupleCsn,
-									 mctx,
-									 NULL,
-									 NULL);
+		tuple = seq_scan_find_tuple_version(scan, scan->leafImg,
+											&scan->leafLoc, tupleCsn,
+											mctx, allocated);
 		BTREE_PAGE_LOCATOR_NEXT(scan->leafImg, &scan->leafLoc);
 		if (!O_TUPLE_IS_NULL(tuple))
 		{
@@ -1482,9 +1812,10 @@ btree_seq_scan_getnext_internal(BTreeSeqScan *scan, MemoryContext mctx,
 	return tuple;
 }
 
-OTuple
-btree_seq_scan_getnext(BTreeSeqScan *scan, MemoryContext mctx,
-					   CommitSeqNo *tupleCsn, BTreeLocationHint *hint)
+static OTuple
+btree_seq_scan_getnext_common(BTreeSeqScan *scan, MemoryContext mctx,
+							  CommitSeqNo *tupleCsn, BTreeLocationHint *hint,
+							  bool *allocated)
 {
 	OTuple		tuple;
 
@@ -1495,7 +1826,12 @@ btree_seq_scan_getnext(BTreeSeqScan *scan, MemoryContext mctx,
 	if (scan->status == BTreeSeqScanInMemory ||
 		scan->status == BTreeSeqScanDisk)
 	{
-		tuple = btree_seq_scan_getnext_internal(scan, mctx, tupleCsn, hint);
+		if (scan->coldUcm)
+			set_cold_ucm();
+		tuple = btree_seq_scan_getnext_internal(scan, mctx, tupleCsn, hint,
+												allocated);
+		if (scan->coldUcm)
+			unset_cold_ucm();
 
 		if (!O_TUPLE_IS_NULL(tuple))
 			return tuple;
@@ -1506,6 +1842,28 @@ btree_seq_scan_getnext(BTreeSeqScan *scan, MemoryContext mctx,
 	return tuple;
 }
 
+OTuple
+btree_seq_scan_getnext(BTreeSeqScan *scan, MemoryContext mctx,
+					   CommitSeqNo *tupleCsn, BTreeLocationHint *hint)
+{
+	return btree_seq_scan_getnext_common(scan, mctx, tupleCsn, hint, NULL);
+}
+
+/*
+ * Same as btree_seq_scan_getnext(), but doesn't copy the tuples, whose
+ * current version is visible.  Such tuples point into the private page image
+ * of the scan, and they are valid only till the next call.  *allocated is set
+ * if the returned tuple is allocated in mctx.
+ */
+OTuple
+btree_seq_scan_getnext_ref(BTreeSeqScan *scan, MemoryContext mctx,
+						   CommitSeqNo *tupleCsn, BTreeLocationHint *hint,
+						   bool *allocated)
+{
+	return btree_seq_scan_getnext_common(scan, mctx, tupleCsn, hint,
+										 allocated);
+}
+
 static OTuple
 btree_seq_scan_get_tuple_from_iterator_raw(BTreeSeqScan *scan,
 										   bool *end,
@@ -1606,7 +1964,11 @@ btree_seq_scan_getnext_raw(BTreeSeqScan *scan, MemoryContext mctx,
 	if (scan->status == BTreeSeqScanInMemory ||
 		scan->status == BTreeSeqScanDisk)
 	{
+		if (scan->coldUcm)
+			set_cold_ucm();
 		tuple = btree_seq_scan_getnext_raw_internal(scan, mctx, hint);
+		if (scan->coldUcm)
+			unset_cold_ucm();
 		if (scan->status == BTreeSeqScanInMemory ||
 			scan->status == BTreeSeqScanDisk)
 		{
@@ -1642,6 +2004,15 @@ free_btree_seq_scan(BTreeSeqScan *scan)
 																			 * have already detached */
 		dsm_detach(scan->dsmSeg);
 	}
+	if (scan->walkSampled)
+		hash_destroy(scan->walkSampled);
+
+	/* The scan might be ended before the iterator is exhausted */
+	while (scan->iterTuplesIndex < scan->iterTuplesCount)
+		pfree(scan->iterTuples[scan->iterTuplesIndex++].data);
+	if (scan->iter)
+		btree_iterator_free(scan->iter);
+
 	pfree(scan->diskDownlinks);
 	pfree(scan);
 }
@@ -280,6 +280,82 @@ btree_page_split_location(BTreeDescr *desc, Page page, OffsetNumber offset,
 	return minLeftPageItemsCount;
 }
 
+/*
+ * Leaf splits update the insert pattern score of the tree.  Insert pattern is
+ * considered ascending or descending when the absolute value of the score
+ * reaches the threshold.
+ */
+#define INSERT_PATTERN_MAX_SCORE	(16)
+#define INSERT_PATTERN_THRESHOLD	(8)
+
+typedef enum
+{
+	InsertPatternRandom,
+	InsertPatternAscending,
+	InsertPatternDescending
+} InsertPattern;
+
+/*
+ * Moves the tree insert pattern score towards the pattern of the insert,
+ * which caused the split.  Returns the new score.
+ */
+static int32
+update_insert_pattern_score(BTreeDescr *desc, InsertPattern pattern)
+{
+	pg_atomic_uint32 *ptr = &BTREE_GET_META(desc)->insertPattern;
+	uint32		oldValue = pg_atomic_read_u32(ptr);
+	int32		score,
+				newScore;
+
+	while (true)
+	{
+		score = (int32) oldValue;
+		if (pattern == InsertPatternAscending)
+			newScore = Min(score + 1, INSERT_PATTERN_MAX_SCORE);
+		else if (pattern == InsertPatternDescending)
+			newScore = Max(score - 1, -INSERT_PATTERN_MAX_SCORE);
+		else if (score > 0)
+			newScore = score - 1;
+		else if (score < 0)
+			newScore = score + 1;
+		else
+			newScore = score;
+
+		if (newScore == score ||
+			pg_atomic_compare_exchange_u32(ptr, &oldValue, (uint32) newScore))
+			return newScore;
+	}
+}
+
+/*
+ * Returns the chunk boundary closest to the middle of the page if it's close
+ * enough and the new item goes to the right of it.  Splitting there lets
+ * perform_page_split() truncate the left page instead of rebuilding it.
+ * Returns zero if there is no suitable boundary.
+ */
+static OffsetNumber
+split_chunk_boundary_target(Page page, OffsetNumber offset)
+{
+	BTreePageHeader *header = (BTreePageHeader *) page;
+	OffsetNumber middle = header->itemsCount / 2,
+				tolerance = header->itemsCount / 8,
+				result = 0;
+	int			i;
+
+	for (i = 1; i < header->chunksCount; i++)
+	{
+		OffsetNumber boundary = header->chunkDesc[i].offset;
+
+		if (boundary > offset)
+			break;
+		if (Abs((int) boundary - (int) middle) <= tolerance &&
+			(result == 0 ||
+			 Abs((int) boundary - (int) middle) < Abs((int) result - (int) middle)))
+			result = boundary;
+	}
+	return result;
+}
+
 OffsetNumber
 btree_get_split_left_count(BTreeDescr *desc, OInMemoryBlkno blkno,
 						   OTuple tuple, LocationIndex tuplesize,
@@ -294,11 +370,26 @@ btree_get_split_left_count(BTreeDescr *desc, OInMemoryBlkno blkno,
 	float4		spaceRatio;
 	float4		fillfactorRatio = ((float4) desc->fillfactor) / 100.0f;
 	OTuple		split_item;
+	InsertPattern pattern = InsertPatternRandom;
+	int32		score = 0;
 
 	/* The default target is to split the page 50%/50% */
 	targetCount = 0;
 	spaceRatio = 0.5f;
 
+	/*
+	 * Inserts close to the end of the leaf look ascending, and ones close to
+	 * the beginning look descending.  Remember that for the whole tree.
+	 */
+	if (O_PAGE_IS(page, LEAF) && !replace)
+	{
+		if ((float) offset / (float) header->itemsCount >= 0.9f)
+			pattern = InsertPatternAscending;
+		else if ((float) offset / (float) header->itemsCount <= 0.1f)
+			pattern = InsertPatternDescending;
+		score = update_insert_pattern_score(desc, pattern);
+	}
+
 	/*
 	 * Try to autodetect ordered inserts and split near the insertion point.
 	 * If we're close to the end of the page, split already inserted data away
@@ -327,6 +418,18 @@ btree_get_split_left_count(BTreeDescr *desc, OInMemoryBlkno blkno,
 			targetCount = offset;
 	}
 
+	/*
+	 * Otherwise, follow the insert pattern of the tree if the insertion point
+	 * agrees with it.  That keeps pages dense when many sequences of ordered
+	 * inserts are interleaved.
+	 */
+	else if (pattern == InsertPatternAscending &&
+			 score >= INSERT_PATTERN_THRESHOLD)
+		spaceRatio = fillfactorRatio;
+	else if (pattern == InsertPatternDescending &&
+			 score <= -INSERT_PATTERN_THRESHOLD)
+		spaceRatio = 1.0f - fillfactorRatio;
+
 	/*
 	 * If we don't autodetect the insertion order, we still assume TOAST and
 	 * rightmost inserts are always assumed to be ordered ascendingly.
@@ -334,6 +437,10 @@ btree_get_split_left_count(BTreeDescr *desc, OInMemoryBlkno blkno,
 	else if ((desc->type == oIndexToast && O_PAGE_IS(page, LEAF)) || O_PAGE_IS(page, RIGHTMOST))
 		spaceRatio = fillfactorRatio;
 
+	/* Even splits are free to move to the nearby chunk boundary */
+	else
+		targetCount = split_chunk_boundary_target(page, offset);
+
 	result = btree_page_split_location(desc, page, offset, tuplesize, tuple, replace,
 									   targetCount, spaceRatio, &split_item, csn);
 
@@ -364,6 +471,93 @@ btree_get_split_left_count(BTreeDescr *desc, OInMemoryBlkno blkno,
 	return result;
 }
 
+/*
+ * Location of the hikeys area of the page having 'chunksCount' chunks.
+ */
+static inline LocationIndex
+split_hikeys_start(int chunksCount)
+{
+	return MAXALIGN(offsetof(BTreePageHeader, chunkDesc) +
+					sizeof(BTreePageChunkDesc) * chunksCount);
+}
+
+/*
+ * Returns the number of the chunk starting at 'left_count' item if the left
+ * page can be truncated at it keeping the items of the chunks before it
+ * as-is, zero otherwise.  The chunk descriptors array shrinks, so the
+ * remaining hikeys are shifted down, and the split key replaces the hikey of
+ * the last remaining chunk.  The chunks data must start at the default
+ * hikeys area end, since after the shift it can't be adjacent to the hikeys.
+ */
+static int
+split_left_page_chunk(BTreeDescr *desc, Page page, OffsetNumber left_count,
+					  LocationIndex splitkey_len)
+{
+	BTreePageHeader *header = (BTreePageHeader *) page;
+	LocationIndex dataLocation = SHORT_GET_LOCATION(header->chunkDesc[0].shortLocation);
+	int			i;
+
+	if (dataLocation != BTREE_PAGE_HIKEYS_END(desc, page))
+		return 0;
+
+	for (i = 1; i < header->chunksCount; i++)
+	{
+		if (header->chunkDesc[i].offset == left_count)
+		{
+			LocationIndex hikeyLocation = SHORT_GET_LOCATION(header->chunkDesc[i - 1].hikeyShortLocation);
+
+			hikeyLocation -= SHORT_GET_LOCATION(header->chunkDesc[0].hikeyShortLocation) -
+				split_hikeys_start(i);
+			if (hikeyLocation + MAXALIGN(splitkey_len) <= dataLocation)
+				return i;
+			return 0;
+		}
+		if (header->chunkDesc[i].offset > left_count)
+			break;
+	}
+	return 0;
+}
+
+/*
+ * Truncates the left page to the chunks before 'chunk' and places the split
+ * key as its hikey.  Unlike btree_page_reorg(), the items of the remaining
+ * chunks aren't touched.  Their hikeys are moved to the start of the
+ * shrunken hikeys area.
+ */
+static void
+split_truncate_left_page(Page page, int chunk, OTuple splitkey,
+						 LocationIndex splitkey_len)
+{
+	BTreePageHeader *header = (BTreePageHeader *) page;
+	BTreePageChunkDesc *lastChunkDesc = &header->chunkDesc[chunk - 1];
+	LocationIndex oldStart = SHORT_GET_LOCATION(header->chunkDesc[0].hikeyShortLocation),
+				newStart = split_hikeys_start(chunk),
+				shift = oldStart - newStart;
+	Pointer		hikeyPtr;
+	int			i;
+
+	Assert(oldStart >= newStart);
+	if (shift > 0)
+	{
+		memmove((Pointer) page + newStart, (Pointer) page + oldStart,
+				SHORT_GET_LOCATION(lastChunkDesc->hikeyShortLocation) - oldStart);
+		for (i = 0; i < chunk; i++)
+			header->chunkDesc[i].hikeyShortLocation -= LOCATION_GET_SHORT(shift);
+	}
+	hikeyPtr = (Pointer) page + SHORT_GET_LOCATION(lastChunkDesc->hikeyShortLocation);
+
+	header->itemsCount = header->chunkDesc[chunk].offset;
+	header->dataSize = SHORT_GET_LOCATION(header->chunkDesc[chunk].shortLocation);
+	header->chunksCount = chunk;
+
+	memcpy(hikeyPtr, splitkey.data, splitkey_len);
+	if (splitkey_len != MAXALIGN(splitkey_len))
+		memset(hikeyPtr + splitkey_len, 0, MAXALIGN(splitkey_len) - splitkey_len);
+	lastChunkDesc->hikeyFlags = splitkey.formatFlags;
+	header->hikeysEnd = (hikeyPtr - (Pointer) page) + MAXALIGN(splitkey_len);
+	header->maxKeyLen = Max(header->maxKeyLen, MAXALIGN(splitkey_len));
+}
+
 /*
  * Split B-tree page into two.
  *
@@ -382,17 +576,21 @@ perform_page_split(BTreeDescr *desc, OInMemoryBlkno blkno, OInMemoryBlkno new_bl
 	BTreePageHeader *left_header = (BTreePageHeader *) left_page,
 			   *right_header = (BTreePageHeader *) right_page;
 	bool		leaf = O_PAGE_IS(left_page, LEAF);
+	bool		leftIntact = true;
 	OTuple		hikey;
 	LocationIndex hikeySize;
 	int			i,
-				count;
+				count,
+				leftChunk,
+				leftLive,
+				rightLive;
 	LocationIndex tuple_header_size = leaf ? BTreeLeafTuphdrSize : BTreeNonLeafTuphdrSize;
 	BTreePageItemLocator loc;
 	BTreePageItem items[BTREE_PAGE_MAX_CHUNK_ITEMS + 1];
 	char		newItem[Max(BTreeLeafTuphdrSize, BTreeNonLeafTuphdrSize) + O_BTREE_MAX_TUPLE_SIZE];
 
 	init_new_btree_page(desc, new_blkno,
-						left_header->flags & ~(O_BTREE_FLAG_LEFTMOST),
+						left_header->flags & ~(O_BTREE_FLAG_LEFTMOST | O_BTREE_FLAG_ALL_VISIBLE),
 						PAGE_GET_LEVEL(left_page), false);
 
 	/* Fill the array of items for btree_page_reorg() function */
@@ -402,6 +600,8 @@ perform_page_split(BTreeDescr *desc, OInMemoryBlkno blkno, OInMemoryBlkno new_bl
 	{
 		if (i == *offset)
 		{
+			if (i < left_count)
+				leftIntact = false;
 			memcpy(newItem, tupleheader, tuple_header_size);
 			memcpy(&newItem[tuple_header_size], tuple.data, tuplesize);
 			if (tuplesize != MAXALIGN(tuplesize))
@@ -442,7 +642,10 @@ perform_page_split(BTreeDescr *desc, OInMemoryBlkno blkno, OInMemoryBlkno new_bl
 				(COMMITSEQNO_IS_INPROGRESS(csn) || XACT_INFO_MAP_CSN(tupHdr->xactInfo) < csn))
 			{
 				if (i < left_count)
+				{
 					left_count--;
+					leftIntact = false;
+				}
 				if (i < *offset)
 					(*offset)--;
 				BTREE_PAGE_LOCATOR_NEXT(left_page, &loc);
@@ -455,6 +658,9 @@ perform_page_split(BTreeDescr *desc, OInMemoryBlkno blkno, OInMemoryBlkno new_bl
 				(BTreeLeafTuphdrSize + MAXALIGN(o_btree_len(desc, tup, OTupleLength))) :
 				BTREE_PAGE_GET_ITEM_SIZE(left_page, &loc);
 			items[i].newItem = false;
+			if (i < left_count && finished &&
+				items[i].size != BTREE_PAGE_GET_ITEM_SIZE(left_page, &loc))
+				leftIntact = false;
 		}
 		else
 		{
@@ -497,6 +703,14 @@ perform_page_split(BTreeDescr *desc, OInMemoryBlkno blkno, OInMemoryBlkno new_bl
 	btree_page_reorg(desc, right_page, &items[left_count], count - left_count,
 					 hikeySize, hikey, NULL);
 
+	/*
+	 * If the left page keeps its items as-is and the split falls on a chunk
+	 * boundary, the left page is just truncated, minimizing the time readers
+	 * are blocked.
+	 */
+	leftChunk = leftIntact ? split_left_page_chunk(desc, left_page,
+												   left_count, splitkey_len) : 0;
+
 	/*
 	 * Start page modification.  It contains the required memory barrier
 	 * between making undo image and setting the undo location.
@@ -519,11 +733,32 @@ perform_page_split(BTreeDescr *desc, OInMemoryBlkno blkno, OInMemoryBlkno new_bl
 													  O_PAGE_GET_CHANGE_COUNT(right_page));
 	left_header->flags &= ~(O_BTREE_FLAG_RIGHTMOST);
 
-	btree_page_reorg(desc, left_page, &items[0], left_count,
-					 splitkey_len, splitkey, NULL);
+	if (leftChunk > 0)
+		split_truncate_left_page(left_page, leftChunk, splitkey, splitkey_len);
+	else
+		btree_page_reorg(desc, left_page, &items[0], left_count,
+						 splitkey_len, splitkey, NULL);
+
+	leftLive = o_btree_page_calculate_statistics(desc, left_page);
+	rightLive = o_btree_page_calculate_statistics(desc, right_page);
 
-	o_btree_page_calculate_statistics(desc, left_page);
-	o_btree_page_calculate_statistics(desc, right_page);
+	/*
+	 * Ascending or descending inserts leave one of the halves full, and it's
+	 * the one which stays representative of the tree.  Random inserts split
+	 * evenly, and then the larger half is a reasonable lower bound.
+	 */
+	if (leaf)
+		o_btree_update_leaf_density(desc, Max(leftLive, rightLive));
+
+	/* The new page shares the parent, and takes a part of the children */
+	O_GET_IN_MEMORY_PAGEDESC(new_blkno)->parentBlkno =
+		(blkno == desc->rootInfo.rootPageBlkno) ? blkno :
+		O_GET_IN_MEMORY_PAGEDESC(blkno)->parentBlkno;
+	if (!leaf)
+	{
+		btree_page_adopt_children(blkno);
+		btree_page_adopt_children(new_blkno);
+	}
 
 	MARK_DIRTY(desc, blkno);
 	MARK_DIRTY(desc, new_blkno);
@@ -43,6 +43,31 @@ typedef struct
 	BTreeLeafTuphdr tuphdr;
 } BTreeModifyUndoStackItem;
 
+/*
+ * Header of the delta update undo record data.  Instead of the whole
+ * previous tuple version, the delta record holds the key and only the bytes
+ * the previous version differs from the next one in.  The previous version
+ * consists of first 'prefixLen' bytes of the next version, then 'prevLen -
+ * prefixLen - suffixLen' bytes following the key in the record, and then
+ * the last 'suffixLen' bytes of the next version.
+ */
+typedef struct
+{
+	LocationIndex nextLen;
+	LocationIndex prevLen;
+	LocationIndex prefixLen;
+	LocationIndex suffixLen;
+	LocationIndex keyLen;
+	uint8		keyFlags;
+} BTreeUndoDeltaHeader;
+
+#define BTreeUndoDeltaHeaderSize MAXALIGN(sizeof(BTreeUndoDeltaHeader))
+
+/*
+ * The delta record is only used when it is at most half of the full record.
+ */
+#define UNDO_DELTA_IS_WORTH(deltaLen, prevLen) ((deltaLen) * 2 <= (prevLen))
+
 typedef struct
 {
 	OnCommitUndoStackItem header;
@@ -257,7 +282,7 @@ retry:
 static Jsonb *
 undo_record_key_stopevent_params(BTreeOperationType action,
 								 BTreeDescr *desc,
-								 OTuple tuple, OXid oxid)
+								 OTuple tuple, bool isTuple, OXid oxid)
 {
 	JsonbParseState *state = NULL;
 	Jsonb	   *res;
@@ -275,7 +300,7 @@ undo_record_key_stopevent_params(BTreeOperationType action,
 	jsonb_push_int8_key(&state, "oxid", oxid);
 	btree_desc_stopevent_params_internal(desc, &state);
 	jsonb_push_key(&state, "key");
-	if (action == BTreeOperationUpdate)
+	if (isTuple)
 	{
 		OTuple		key;
 		bool		allocated;
@@ -359,6 +384,111 @@ make_undo_record(BTreeDescr *desc, OTuple tuple, bool is_tuple,
 	return &item->tuphdr;
 }
 
+/*
+ * Make undo record for the update of 'prevTuple' to 'nextTuple'.  When both
+ * versions share the most of their bytes, the delta record is made.  It holds
+ * the key and the changed bytes only.  Otherwise, falls back to the regular
+ * record with the whole previous version.
+ */
+BTreeLeafTuphdr *
+make_update_undo_record(BTreeDescr *desc, OTuple prevTuple, OTuple nextTuple,
+						OInMemoryBlkno blkno, uint32 pageChangeCount,
+						UndoLocation *undoLocation)
+{
+	BTreeModifyUndoStackItem *item;
+	BTreeUndoDeltaHeader *delta;
+	LocationIndex prevLen,
+				nextLen,
+				keyLen,
+				prefixLen = 0,
+				suffixLen = 0,
+				middleLen,
+				size;
+	Pointer		ptr;
+	OTuple		key;
+	bool		key_palloc = false;
+
+	prevLen = o_btree_len(desc, prevTuple, OTupleLength);
+	nextLen = o_btree_len(desc, nextTuple, OTupleLength);
+
+	while (prefixLen < prevLen && prefixLen < nextLen &&
+		   prevTuple.data[prefixLen] == nextTuple.data[prefixLen])
+		prefixLen++;
+	while (suffixLen < prevLen - prefixLen && suffixLen < nextLen - prefixLen &&
+		   prevTuple.data[prevLen - suffixLen - 1] ==
+		   nextTuple.data[nextLen - suffixLen - 1])
+		suffixLen++;
+	middleLen = prevLen - prefixLen - suffixLen;
+
+	keyLen = o_btree_len(desc, prevTuple, OTupleKeyLength);
+	size = BTreeUndoDeltaHeaderSize + MAXALIGN(keyLen) + middleLen;
+	if (!UNDO_DELTA_IS_WORTH(size, prevLen))
+		return make_undo_record(desc, prevTuple, true, BTreeOperationUpdate,
+								blkno, pageChangeCount, undoLocation);
+
+	size += sizeof(BTreeModifyUndoStackItem);
+	item = (BTreeModifyUndoStackItem *) get_undo_record(desc->undoType,
+														undoLocation,
+														MAXALIGN(size));
+	item->header.itemSize = size;
+	item->header.type = ModifyDeltaUndoItemType;
+	item->header.indexType = desc->type;
+	item->action = BTreeOperationUpdate;
+	item->blkno = blkno;
+	item->pageChangeCount = pageChangeCount;
+	item->oids = desc->oids;
+	item->tuphdr.formatFlags = prevTuple.formatFlags;
+
+	ptr = (Pointer) item + sizeof(BTreeModifyUndoStackItem);
+	delta = (BTreeUndoDeltaHeader *) ptr;
+	delta->nextLen = nextLen;
+	delta->prevLen = prevLen;
+	delta->prefixLen = prefixLen;
+	delta->suffixLen = suffixLen;
+	delta->keyLen = keyLen;
+	ptr += BTreeUndoDeltaHeaderSize;
+
+	memset(ptr, 0, MAXALIGN(keyLen));
+	key = o_btree_tuple_make_key(desc, prevTuple, ptr, true, &key_palloc);
+	Assert(!key_palloc);
+	delta->keyFlags = key.formatFlags;
+	ptr += MAXALIGN(keyLen);
+
+	memcpy(ptr, prevTuple.data + prefixLen, middleLen);
+
+	add_new_undo_stack_item(desc->undoType, *undoLocation);
+
+	*undoLocation += offsetof(BTreeModifyUndoStackItem, tuphdr);
+	return &item->tuphdr;
+}
+
+/*
+ * Checks if the version preceding the given leaf tuple is stored in undo as
+ * a delta against it.  Such a tuple can't be overwritten without making a
+ * new undo record, otherwise the previous version becomes unrecoverable.
+ */
+bool
+prev_tuple_is_delta_in_undo(UndoLogType undoType, BTreeLeafTuphdr *tuphdr)
+{
+	BTreeLeafTuphdr nonLockTuphdr = *tuphdr;
+	UndoStackItem header;
+	UndoLocation location;
+
+	(void) find_non_lock_only_undo_record(undoType, &nonLockTuphdr);
+	location = nonLockTuphdr.undoLocation;
+
+	if (nonLockTuphdr.deleted != BTreeLeafTupleNonDeleted ||
+		XACT_INFO_IS_LOCK_ONLY(nonLockTuphdr.xactInfo) ||
+		!UndoLocationIsValid(location) ||
+		!UNDO_REC_EXISTS(undoType, location))
+		return false;
+
+	undo_read(undoType,
+			  location - offsetof(BTreeModifyUndoStackItem, tuphdr),
+			  sizeof(header), (Pointer) &header);
+	return header.type == ModifyDeltaUndoItemType;
+}
+
 static BTreeDescr *
 get_tree_descr(ORelOids oids, OIndexType type)
 {
@@ -403,14 +533,29 @@ modify_undo_callback(UndoLogType undoType, UndoLocation location,
 	if (!desc)
 		return;
 
-	tuple.formatFlags = item->tuphdr.formatFlags;
-	tuple.data = (Pointer) item + sizeof(BTreeModifyUndoStackItem);
+	if (baseItem->type == ModifyDeltaUndoItemType)
+	{
+		BTreeUndoDeltaHeader *delta;
+
+		/* Delta record holds the key instead of the tuple */
+		delta = (BTreeUndoDeltaHeader *) ((Pointer) item + sizeof(BTreeModifyUndoStackItem));
+		tuple.formatFlags = delta->keyFlags;
+		tuple.data = (Pointer) delta + BTreeUndoDeltaHeaderSize;
+		keyType = BTreeKeyNonLeafKey;
+	}
+	else
+	{
+		tuple.formatFlags = item->tuphdr.formatFlags;
+		tuple.data = (Pointer) item + sizeof(BTreeModifyUndoStackItem);
+	}
 
 	if (STOPEVENTS_ENABLED())
 	{
 		Jsonb	   *params = undo_record_key_stopevent_params(item->action,
 															  desc,
-															  tuple, oxid);
+															  tuple,
+															  keyType == BTreeKeyLeafTuple,
+															  oxid);
 
 		STOPEVENT(STOPEVENT_APPLY_UNDO, params);
 	}
@@ -528,7 +673,8 @@ lock_undo_callback(UndoLogType undoType, UndoLocation location,
 	if (STOPEVENTS_ENABLED())
 	{
 		Jsonb	   *params = undo_record_key_stopevent_params(BTreeOperationLock,
-															  desc, key, oxid);
+															  desc, key, false,
+															  oxid);
 
 		STOPEVENT(STOPEVENT_APPLY_UNDO, params);
 	}
@@ -633,6 +779,12 @@ lock_undo_callback(UndoLogType undoType, UndoLocation location,
 
 #define PENDING_TRUNCATES_FILENAME (ORIOLEDB_DATA_DIR "/pending_truncates")
 
+/*
+ * The maximum number of trees whose files are unlinked by the single
+ * check_pending_truncates() call of the background writer.
+ */
+#define PENDING_TRUNCATES_TREES_PER_CALL (4)
+
 static void
 add_pending_truncate(ORelOids relOids, int numTrees, ORelOids *treeOids)
 {
@@ -661,7 +813,7 @@ add_pending_truncate(ORelOids relOids, int numTrees, ORelOids *treeOids)
 	offset += length;
 	length = sizeof(numTrees);
 
-	if (FileWrite(pendingTruncatesFile, (Pointer) &numTrees, length, 0,
+	if (FileWrite(pendingTruncatesFile, (Pointer) &numTrees, length, offset,
 				  WAIT_EVENT_BUFFILE_WRITE) != length)
 		ereport(FATAL, (errcode_for_file_access(),
 						errmsg("could not write pending truncates file %s",
@@ -670,7 +822,7 @@ add_pending_truncate(ORelOids relOids, int numTrees, ORelOids *treeOids)
 	offset += length;
 	length = sizeof(*treeOids) * numTrees;
 
-	if (FileWrite(pendingTruncatesFile, (Pointer) &treeOids, length, 0,
+	if (FileWrite(pendingTruncatesFile, (Pointer) treeOids, length, offset,
 				  WAIT_EVENT_BUFFILE_WRITE) != length)
 		ereport(FATAL, (errcode_for_file_access(),
 						errmsg("could not write pending truncates file %s",
@@ -684,8 +836,14 @@ add_pending_truncate(ORelOids relOids, int numTrees, ORelOids *treeOids)
 	LWLockRelease(&pending_truncates_meta->pendingTruncatesLock);
 }
 
+/*
+ * Unlinks the files of the trees queued by add_pending_truncate().  The
+ * background writer calls it with all = false to unlink a few trees at a
+ * time, so that the files are removed gradually.  Checkpointer completes the
+ * whole queue.
+ */
 void
-check_pending_truncates(void)
+check_pending_truncates(bool all)
 {
 	uint64		offset;
 	uint64		length;
@@ -694,6 +852,7 @@ check_pending_truncates(void)
 	int			numTrees;
 	ORelOids   *relNodes = NULL;
 	int			relNodesAllocated = 0;
+	int			numCleaned = 0;
 	File		pendingTruncatesFile;
 
 	ORelOidsSetInvalid(relOids);
@@ -701,8 +860,11 @@ check_pending_truncates(void)
 	if (have_backup_in_progress() || pending_truncates_meta->pendingTruncatesLocation == 0)
 		return;
 
-	if (!LWLockConditionalAcquire(&pending_truncates_meta->pendingTruncatesLock,
-								  LW_EXCLUSIVE))
+	if (all)
+		LWLockAcquire(&pending_truncates_meta->pendingTruncatesLock,
+					  LW_EXCLUSIVE);
+	else if (!LWLockConditionalAcquire(&pending_truncates_meta->pendingTruncatesLock,
+									   LW_EXCLUSIVE))
 		return;
 
 	if (have_backup_in_progress() || pending_truncates_meta->pendingTruncatesLocation == 0)
@@ -718,9 +880,10 @@ check_pending_truncates(void)
 						errmsg("could not open pending truncates file %s",
 							   PENDING_TRUNCATES_FILENAME)));
 
-	offset = 0;
+	offset = pending_truncates_meta->pendingTruncatesStart;
 	maxOffset = pending_truncates_meta->pendingTruncatesLocation;
-	while (offset < maxOffset)
+	while (offset < maxOffset &&
+		   (all || numCleaned < PENDING_TRUNCATES_TREES_PER_CALL))
 	{
 		int			i;
 
@@ -758,11 +921,24 @@ check_pending_truncates(void)
 							errmsg("could not read pending truncates file %s",
 								   PENDING_TRUNCATES_FILENAME)));
 
+		offset += length;
+
 		for (i = 0; i < numTrees; i++)
 			cleanup_btree_files(relNodes[i].datoid, relNodes[i].relnode);
+		numCleaned += numTrees;
 	}
 
-	pending_truncates_meta->pendingTruncatesLocation = 0;
+	FileClose(pendingTruncatesFile);
+
+	if (offset >= maxOffset)
+	{
+		pending_truncates_meta->pendingTruncatesStart = 0;
+		pending_truncates_meta->pendingTruncatesLocation = 0;
+	}
+	else
+	{
+		pending_truncates_meta->pendingTruncatesStart = offset;
+	}
 
 	LWLockRelease(&pending_truncates_meta->pendingTruncatesLock);
 
@@ -786,6 +962,7 @@ btree_relnode_undo_callback(UndoLogType undoType, UndoLocation location,
 	int			dropNumTreeOids;
 	ORelOids   *dropTreeOids;
 	bool		cleanupFiles = true;
+	bool		deferCleanupFiles = false;
 
 	datoid = relnode_item->datoid;
 	reloid = relnode_item->relid;
@@ -806,6 +983,16 @@ btree_relnode_undo_callback(UndoLogType undoType, UndoLocation location,
 								 &relnode_item->oids[0]);
 			cleanupFiles = false;
 		}
+		else if (orioledb_async_file_cleanup && !is_recovery_in_progress())
+		{
+			/*
+			 * Release the pages now, but leave unlinking of the files to the
+			 * background writer.  If we crash before, recovery replays this
+			 * drop and unlinks the files synchronously.
+			 */
+			deferCleanupFiles = true;
+			cleanupFiles = false;
+		}
 	}
 	else
 	{
@@ -856,6 +1043,10 @@ btree_relnode_undo_callback(UndoLogType undoType, UndoLocation location,
 				o_tables_rel_unlock_extended(&dropTreeOids[i], AccessExclusiveLock, false);
 			o_tables_rel_unlock_extended(&dropTreeOids[i], AccessExclusiveLock, true);
 		}
+
+		/* Queue the files once nobody can write the released pages there */
+		if (deferCleanupFiles)
+			add_pending_truncate(oids, dropNumTreeOids, dropTreeOids);
 	}
 
 	if (OidIsValid(remainRelnode))
@@ -1575,6 +1766,13 @@ get_prev_leaf_header_from_undo(UndoLogType undoType,
 	}
 }
 
+/*
+ * Reads the previous tuple version from the update undo record.  On input,
+ * 'tuple' is the next version, which the delta undo records are applied to.
+ * When 'sizeAvailable' is non-zero, the previous version is reconstructed in
+ * place of the next one.  Otherwise, it's placed into the newly allocated
+ * memory, and the next version is left intact.
+ */
 void
 get_prev_leaf_header_and_tuple_from_undo(UndoLogType undoType,
 										 BTreeLeafTuphdr *tuphdr,
@@ -1592,10 +1790,53 @@ get_prev_leaf_header_and_tuple_from_undo(UndoLogType undoType,
 			  tuphdr->undoLocation - offsetof(BTreeModifyUndoStackItem, tuphdr),
 			  sizeof(BTreeModifyUndoStackItem),
 			  (Pointer) &item);
-	Assert(item.header.type == ModifyUndoItemType);
+	Assert(item.header.type == ModifyUndoItemType ||
+		   item.header.type == ModifyDeltaUndoItemType);
 	Assert(item.action == BTreeOperationUpdate);
 
 	*tuphdr = item.tuphdr;
+
+	if (item.header.type == ModifyDeltaUndoItemType)
+	{
+		BTreeUndoDeltaHeader delta;
+		Pointer		next = tuple->data,
+					prev;
+
+		undo_read(undoType, undoLocation + BTreeLeafTuphdrSize,
+				  sizeof(delta), (Pointer) &delta);
+
+		Assert(next != NULL);
+		Assert(sizeAvailable == 0 ||
+			   (sizeAvailable >= delta.prevLen &&
+				sizeAvailable >= delta.nextLen));
+
+		if (sizeAvailable == 0)
+		{
+			prev = palloc(delta.prevLen);
+			memcpy(prev, next, delta.prefixLen);
+			memcpy(prev + delta.prevLen - delta.suffixLen,
+				   next + delta.nextLen - delta.suffixLen,
+				   delta.suffixLen);
+		}
+		else
+		{
+			prev = next;
+			memmove(prev + delta.prevLen - delta.suffixLen,
+					next + delta.nextLen - delta.suffixLen,
+					delta.suffixLen);
+		}
+		undo_read(undoType,
+				  undoLocation + BTreeLeafTuphdrSize + BTreeUndoDeltaHeaderSize +
+				  MAXALIGN(delta.keyLen),
+				  delta.prevLen - delta.prefixLen - delta.suffixLen,
+				  prev + delta.prefixLen);
+
+		tuple->data = prev;
+		tuple->formatFlags = tuphdr->formatFlags;
+		tuphdr->formatFlags = 0;
+		return;
+	}
+
 	tuple->formatFlags = tuphdr->formatFlags;
 	tupleSize = item.header.itemSize - sizeof(BTreeModifyUndoStackItem);
 	if (sizeAvailable == 0)
@@ -0,0 +1,302 @@
+/*-------------------------------------------------------------------------
+ *
+ * zone_map.c
+ *		Zone maps over orioledb B-tree leaves.
+ *
+ * Copyright (c) 2021-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/btree/zone_map.c
+ *
+ * NOTES
+ *
+ *		The zone map is a fixed-size direct-mapped table in shared memory.
+ *		Each entry summarizes one column of the in-memory primary key leaf:
+ *		the minimum and maximum of its non-null values.  Sequential scans
+ *		populate the table with the leaves they read, and skip the leaves,
+ *		where no tuple can match the scan conditions.
+ *
+ *		Unlike adaptive hash index entries, the summaries must be exact.  So,
+ *		an entry is only valid for the page state change count it was built
+ *		with.  Every page modification goes through page_block_reads(), which
+ *		increases the change count on unlock.  Thus, any modification makes
+ *		the summary stale.  Also, summaries are only built for leaves, which
+ *		don't have retained undo records for their tuples.  Such leaves look
+ *		the same for every snapshot.  Entries are written using the seqlock
+ *		protocol, so readers never use torn entries.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "btree/page_contents.h"
+#include "btree/page_state.h"
+#include "btree/zone_map.h"
+#include "tableam/descr.h"
+#include "transam/undo.h"
+#include "tuple/format.h"
+
+#include "common/hashfn.h"
+#include "port/atomics.h"
+
+typedef struct
+{
+	ORelOids	oids;
+	OInMemoryBlkno blkno;
+	uint32		pageChangeCount;
+	uint32		state;
+	AttrNumber	attnum;
+	bool		hasValues;
+	Datum		min;
+	Datum		max;
+} ZoneMapSummary;
+
+typedef struct
+{
+	/* odd while the summary is being written */
+	pg_atomic_uint32 version;
+	ZoneMapSummary summary;
+} ZoneMapEntry;
+
+/* Number of entries, zero means zone map is disabled */
+int			zone_map_size = 0;
+
+static ZoneMapEntry *zoneMapEntries = NULL;
+
+Size
+zone_map_shmem_needs(void)
+{
+	return mul_size(sizeof(ZoneMapEntry), zone_map_size);
+}
+
+void
+zone_map_shmem_init(Pointer ptr, bool found)
+{
+	int			i;
+
+	zoneMapEntries = (ZoneMapEntry *) ptr;
+
+	if (!found)
+	{
+		for (i = 0; i < zone_map_size; i++)
+		{
+			pg_atomic_init_u32(&zoneMapEntries[i].version, 0);
+			memset(&zoneMapEntries[i].summary, 0, sizeof(ZoneMapSummary));
+		}
+	}
+}
+
+static ZoneMapEntry *
+zone_map_get_entry(BTreeDescr *desc, OInMemoryBlkno blkno, AttrNumber attnum)
+{
+	uint32		hash;
+
+	hash = hash_bytes((unsigned char *) &desc->oids, sizeof(desc->oids));
+	hash = hash_combine(hash, hash_uint32(blkno));
+	hash = hash_combine(hash, hash_uint32(attnum));
+	return &zoneMapEntries[hash % zone_map_size];
+}
+
+/*
+ * Copies the summary from the entry.  Returns false if the entry is being
+ * concurrently written.
+ */
+static bool
+zone_map_read_entry(ZoneMapEntry *entry, ZoneMapSummary *summary)
+{
+	uint32		version;
+
+	version = pg_atomic_read_u32(&entry->version);
+	if (version & 1)
+		return false;
+	pg_read_barrier();
+	memcpy(summary, &entry->summary, sizeof(ZoneMapSummary));
+	pg_read_barrier();
+	return pg_atomic_read_u32(&entry->version) == version;
+}
+
+static void
+zone_map_write_entry(ZoneMapEntry *entry, ZoneMapSummary *summary)
+{
+	uint32		version;
+
+	/* Just skip the write if somebody else is writing the entry */
+	version = pg_atomic_read_u32(&entry->version);
+	if ((version & 1) ||
+		!pg_atomic_compare_exchange_u32(&entry->version, &version,
+										version + 1))
+		return;
+
+	memcpy(&entry->summary, summary, sizeof(ZoneMapSummary));
+	pg_write_barrier();
+	pg_atomic_write_u32(&entry->version, version + 2);
+}
+
+/*
+ * Checks if "column <strategy> value" can't be true for any value within
+ * [min, max].
+ */
+static bool
+zone_map_cond_excludes(OZoneMapQual *qual, OZoneMapCond *cond,
+					   Datum min, Datum max)
+{
+	int32		cmp;
+
+	switch (cond->strategy)
+	{
+		case BTLessStrategyNumber:
+			cmp = DatumGetInt32(FunctionCall2Coll(&qual->cmpProc,
+												  qual->collation,
+												  min, cond->value));
+			return cmp >= 0;
+		case BTLessEqualStrategyNumber:
+			cmp = DatumGetInt32(FunctionCall2Coll(&qual->cmpProc,
+												  qual->collation,
+												  min, cond->value));
+			return cmp > 0;
+		case BTEqualStrategyNumber:
+			cmp = DatumGetInt32(FunctionCall2Coll(&qual->cmpProc,
+												  qual->collation,
+												  min, cond->value));
+			if (cmp > 0)
+				return true;
+			cmp = DatumGetInt32(FunctionCall2Coll(&qual->cmpProc,
+												  qual->collation,
+												  max, cond->value));
+			return cmp < 0;
+		case BTGreaterEqualStrategyNumber:
+			cmp = DatumGetInt32(FunctionCall2Coll(&qual->cmpProc,
+												  qual->collation,
+												  max, cond->value));
+			return cmp < 0;
+		case BTGreaterStrategyNumber:
+			cmp = DatumGetInt32(FunctionCall2Coll(&qual->cmpProc,
+												  qual->collation,
+												  max, cond->value));
+			return cmp <= 0;
+		default:
+			return false;
+	}
+}
+
+/*
+ * Checks if the summary of the given leaf shows that no tuple could match the
+ * qual.  On success, outputs the page state change count the summary is
+ * valid for.  The caller must check it against the page image it would
+ * otherwise read.
+ */
+bool
+zone_map_leaf_is_excluded(BTreeDescr *desc, OZoneMapQual *qual,
+						  OInMemoryBlkno blkno, uint32 pageChangeCount,
+						  uint32 *state)
+{
+	ZoneMapSummary summary;
+	int			i;
+
+	if (zone_map_size <= 0)
+		return false;
+
+	if (!zone_map_read_entry(zone_map_get_entry(desc, blkno, qual->attnum),
+							 &summary))
+		return false;
+
+	if (!ORelOidsIsEqual(summary.oids, desc->oids) ||
+		summary.blkno != blkno ||
+		summary.pageChangeCount != pageChangeCount ||
+		summary.attnum != qual->attnum)
+		return false;
+
+	/* All the conditions are strict, so nulls never match */
+	if (summary.hasValues)
+	{
+		for (i = 0; i < qual->nConds; i++)
+		{
+			if (zone_map_cond_excludes(qual, &qual->conds[i],
+									   summary.min, summary.max))
+				break;
+		}
+		if (i >= qual->nConds)
+			return false;
+	}
+
+	*state = summary.state;
+	return true;
+}
+
+/*
+ * Builds the summary of the leaf image just read by the sequential scan.
+ * Does nothing if the image doesn't match the current page or some of its
+ * tuples might look differently for other snapshots.
+ */
+void
+zone_map_summarize_leaf(BTreeDescr *desc, OZoneMapQual *qual,
+						OInMemoryBlkno blkno, Page img)
+{
+	OIndexDescr *id = (OIndexDescr *) desc->arg;
+	Page		p = O_GET_IN_MEMORY_PAGE(blkno);
+	BTreePageItemLocator loc;
+	ZoneMapSummary summary;
+	uint32		imgState,
+				pageState;
+
+	if (zone_map_size <= 0 || id == NULL)
+		return;
+
+	imgState = pg_atomic_read_u32(&O_PAGE_HEADER(img)->state) &
+		PAGE_STATE_CHANGE_COUNT_MASK;
+	pageState = pg_atomic_read_u32(&O_PAGE_HEADER(p)->state);
+	if (O_PAGE_STATE_READ_IS_BLOCKED(pageState) ||
+		(pageState & PAGE_STATE_CHANGE_COUNT_MASK) != imgState ||
+		O_PAGE_GET_CHANGE_COUNT(p) != O_PAGE_GET_CHANGE_COUNT(img))
+		return;
+
+	memset(&summary, 0, sizeof(summary));
+	summary.oids = desc->oids;
+	summary.blkno = blkno;
+	summary.pageChangeCount = O_PAGE_GET_CHANGE_COUNT(img);
+	summary.state = imgState;
+	summary.attnum = qual->attnum;
+	summary.hasValues = false;
+
+	BTREE_PAGE_FOREACH_ITEMS(img, &loc)
+	{
+		BTreeLeafTuphdr *tuphdr;
+		OTuple		tuple;
+		Datum		value;
+		bool		isnull;
+
+		BTREE_PAGE_READ_LEAF_ITEM(tuphdr, tuple, img, &loc);
+
+		if (UndoLocationIsValid(tuphdr->undoLocation) &&
+			UNDO_REC_EXISTS(desc->undoType, tuphdr->undoLocation))
+			return;
+
+		/* Deleted tuples without undo are invisible to everybody */
+		if (tuphdr->deleted)
+			continue;
+
+		value = o_fastgetattr(tuple, qual->attnum, id->leafTupdesc,
+							  &id->leafSpec, &isnull);
+		if (isnull)
+			continue;
+
+		if (!summary.hasValues)
+		{
+			summary.min = summary.max = value;
+			summary.hasValues = true;
+		}
+		else if (DatumGetInt32(FunctionCall2Coll(&qual->cmpProc,
+												 qual->collation,
+												 value, summary.min)) < 0)
+			summary.min = value;
+		else if (DatumGetInt32(FunctionCall2Coll(&qual->cmpProc,
+												 qual->collation,
+												 value, summary.max)) > 0)
+			summary.max = value;
+	}
+
+	zone_map_write_entry(zone_map_get_entry(desc, blkno, qual->attnum),
+						 &summary);
+}
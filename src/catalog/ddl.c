@@ -66,6 +66,7 @@
 #include "commands/vacuum.h"
 #include "commands/view.h"
 #include "commands/tablecmds.h"
+#include "executor/executor.h"
 #include "fmgr.h"
 #include "mb/pg_wchar.h"
 #include "miscadmin.h"
@@ -981,6 +982,36 @@ orioledb_utility_command(PlannedStmt *pstmt,
 			table_close(rel, lockmode);
 		}
 	}
+	else if (IsA(pstmt->utilityStmt, IndexStmt))
+	{
+		IndexStmt  *stmt = (IndexStmt *) pstmt->utilityStmt;
+
+		/*
+		 * Reject CREATE INDEX CONCURRENTLY before its first transaction
+		 * commits the catalog entry, otherwise the failed build would leave
+		 * an invalid index behind.
+		 */
+		if (stmt->concurrent)
+		{
+			Oid			tableOid;
+			Relation	rel;
+			bool		orioledb;
+
+			tableOid = RangeVarGetRelid(stmt->relation, AccessShareLock, true);
+			if (OidIsValid(tableOid))
+			{
+				rel = relation_open(tableOid, AccessShareLock);
+				orioledb = is_orioledb_rel(rel);
+				relation_close(rel, AccessShareLock);
+				if (orioledb)
+					ereport(ERROR,
+							(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+							 errmsg("orioledb table \"%s\" does not support CREATE INDEX CONCURRENTLY",
+									stmt->relation->relname)),
+							errdetail("CREATE INDEX CONCURRENTLY is not supported for OrioleDB tables yet.  This will be implemented in future."));
+			}
+		}
+	}
 	else if (IsA(pstmt->utilityStmt, ClusterStmt))
 	{
 		ClusterStmt *stmt = (ClusterStmt *) pstmt->utilityStmt;
@@ -1940,6 +1971,12 @@ rewrite_table(Relation rel, OTable *old_o_table, OTable *new_o_table)
 	OSnapshot	oSnapshot;
 	OXid		oxid;
 	int			primary_init_nfields = old_o_table->primary_init_nfields;
+	int			natts;
+	EState	   *estate;
+	ExprContext *econtext;
+	ExprState **typeExprs;
+	ExprState **nullExprs;
+	MemoryContext oldcxt;
 
 	if (!old_o_table->has_primary)
 		primary_init_nfields--;
@@ -1948,92 +1985,114 @@ rewrite_table(Relation rel, OTable *old_o_table, OTable *new_o_table)
 	descr = relation_get_descr(rel);
 	old_slot = MakeSingleTupleTableSlot(old_descr->tupdesc, &TTSOpsOrioleDB);
 	new_slot = MakeSingleTupleTableSlot(descr->tupdesc, &TTSOpsOrioleDB);
-	sscan = make_btree_seq_scan(&GET_PRIMARY(old_descr)->desc, &o_in_progress_snapshot, NULL);
 
-	fill_current_oxid_osnapshot(&oxid, &oSnapshot);
+	/*
+	 * Prepare the expressions once for the whole rewrite.  The new type
+	 * expression applies to every row, while the default, generated or
+	 * domain expression applies only to rows having NULL in the column.
+	 */
+	natts = old_slot->tts_tupleDescriptor->natts;
+	estate = CreateExecutorState();
+	econtext = GetPerTupleExprContext(estate);
+	typeExprs = (ExprState **) palloc0(sizeof(ExprState *) * natts);
+	nullExprs = (ExprState **) palloc0(sizeof(ExprState *) * natts);
 
-	while (!O_TUPLE_IS_NULL(tup = btree_seq_scan_getnext(sscan, old_slot->tts_mcxt, &tupleCsn, &hint)))
+	for (int i = 0; i < natts; i++)
 	{
-		tts_orioledb_store_tuple(old_slot, tup, old_descr,
-								 COMMITSEQNO_INPROGRESS, PrimaryIndexNumber,
-								 true, &hint);
-		slot_getallattrs(old_slot);
-		tts_orioledb_detoast(old_slot);
+		Node	   *expr = NULL;
+		Form_pg_attribute attr = &old_slot->tts_tupleDescriptor->attrs[i];
+		ListCell   *lc;
 
-		for (int i = 0; i < old_slot->tts_tupleDescriptor->natts; i++)
+		foreach(lc, alter_type_exprs)
 		{
-			Node	   *expr = NULL;
-			Form_pg_attribute attr = &old_slot->tts_tupleDescriptor->attrs[i];
+			AttrNumber	attnum = intVal(linitial((List *) lfirst(lc)));
 
-			ListCell   *lc;
-
-			foreach(lc, alter_type_exprs)
+			if (attnum == i + 1)
 			{
-				AttrNumber	attnum = intVal(linitial((List *) lfirst(lc)));
-
-				if (attnum == i + 1)
-				{
-					expr = (Node *) lsecond((List *) lfirst(lc));
-					break;
-				}
+				expr = (Node *) lsecond((List *) lfirst(lc));
+				break;
 			}
+		}
 
-			if (!expr && attr->atthasdef && !attr->atthasmissing &&
-				i >= primary_init_nfields &&
-				old_slot->tts_isnull[i])
-			{
-				Node	   *defaultexpr = build_column_default(rel, i + 1);
+		if (expr)
+		{
+			typeExprs[i] = ExecPrepareExpr((Expr *) expr, estate);
+			continue;
+		}
 
-				expr = defaultexpr;
-			}
+		if (attr->atthasdef && !attr->atthasmissing &&
+			i >= primary_init_nfields)
+			expr = build_column_default(rel, i + 1);
 
-			if (!expr && attr->attgenerated && old_slot->tts_isnull[i])
-			{
-				Node	   *defaultexpr = build_column_default(rel, i + 1);
+		if (!expr && attr->attgenerated)
+			expr = build_column_default(rel, i + 1);
 
-				expr = defaultexpr;
-			}
+		if (!expr && DomainHasConstraints(attr->atttypid))
+		{
+			Oid			baseTypeId;
+			int32		baseTypeMod;
+			Oid			baseTypeColl;
+			Node	   *defval;
 
-			if (!expr && DomainHasConstraints(attr->atttypid) &&
-				old_slot->tts_isnull[i])
+			defval = build_column_default(rel, i + 1);
+
+			if (!defval)
 			{
-				Oid			baseTypeId;
-				int32		baseTypeMod;
-				Oid			baseTypeColl;
-				Node	   *defval;
+				baseTypeMod = attr->atttypmod;
+				baseTypeId = getBaseTypeAndTypmod(attr->atttypid, &baseTypeMod);
+				baseTypeColl = get_typcollation(baseTypeId);
+				defval = (Node *) makeNullConst(baseTypeId, baseTypeMod, baseTypeColl);
+			}
+			else
+			{
+				baseTypeId = exprType(defval);
+			}
+			defval = (Node *) coerce_to_target_type(NULL,
+													defval,
+													baseTypeId,
+													attr->atttypid,
+													attr->atttypmod,
+													COERCION_ASSIGNMENT,
+													COERCE_IMPLICIT_CAST,
+													-1);
+			if (defval == NULL) /* should not happen */
+				elog(ERROR, "failed to coerce base type to domain");
+			expr = defval;
+		}
 
-				defval = build_column_default(rel, i + 1);
+		if (expr)
+			nullExprs[i] = ExecPrepareExpr((Expr *) expr, estate);
+	}
 
-				if (!defval)
-				{
-					baseTypeMod = attr->atttypmod;
-					baseTypeId = getBaseTypeAndTypmod(attr->atttypid, &baseTypeMod);
-					baseTypeColl = get_typcollation(baseTypeId);
-					defval = (Node *) makeNullConst(baseTypeId, baseTypeMod, baseTypeColl);
-				}
-				else
-				{
-					baseTypeId = exprType(defval);
-				}
-				defval = (Node *) coerce_to_target_type(NULL,
-														defval,
-														baseTypeId,
-														attr->atttypid,
-														attr->atttypmod,
-														COERCION_ASSIGNMENT,
-														COERCE_IMPLICIT_CAST,
-														-1);
-				if (defval == NULL) /* should not happen */
-					elog(ERROR, "failed to coerce base type to domain");
-				expr = defval;
-			}
+	sscan = make_btree_seq_scan(&GET_PRIMARY(old_descr)->desc, &o_in_progress_snapshot, NULL);
 
-			attr = &new_slot->tts_tupleDescriptor->attrs[i];
-			if (expr)
+	fill_current_oxid_osnapshot(&oxid, &oSnapshot);
+
+	while (!O_TUPLE_IS_NULL(tup = btree_seq_scan_getnext(sscan, old_slot->tts_mcxt, &tupleCsn, &hint)))
+	{
+		tts_orioledb_store_tuple(old_slot, tup, old_descr,
+								 COMMITSEQNO_INPROGRESS, PrimaryIndexNumber,
+								 true, &hint);
+		slot_getallattrs(old_slot);
+		tts_orioledb_detoast(old_slot);
+
+		/* New values live in the per-tuple memory until the next row */
+		ResetExprContext(econtext);
+		econtext->ecxt_scantuple = old_slot;
+		oldcxt = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+
+		for (int i = 0; i < natts; i++)
+		{
+			ExprState  *exprState = typeExprs[i];
+			Form_pg_attribute attr = &new_slot->tts_tupleDescriptor->attrs[i];
+
+			if (!exprState && old_slot->tts_isnull[i])
+				exprState = nullExprs[i];
+
+			if (exprState)
 			{
-				new_slot->tts_values[i] = o_eval_default(new_o_table, rel, expr, old_slot,
-														 attr->attbyval, attr->attlen,
-														 &new_slot->tts_isnull[i]);
+				new_slot->tts_values[i] = ExecEvalExpr(exprState, econtext,
+													   &new_slot->tts_isnull[i]);
 			}
 			else
 			{
@@ -2050,6 +2109,7 @@ rewrite_table(Relation rel, OTable *old_o_table, OTable *new_o_table)
 			}
 		}
 		new_slot->tts_nvalid = new_slot->tts_tupleDescriptor->natts;
+		MemoryContextSwitchTo(oldcxt);
 
 		o_tbl_insert(descr, rel, new_slot, oxid, oSnapshot.csn);
 
@@ -2060,6 +2120,9 @@ rewrite_table(Relation rel, OTable *old_o_table, OTable *new_o_table)
 	ExecDropSingleTupleTableSlot(old_slot);
 	ExecDropSingleTupleTableSlot(new_slot);
 	free_btree_seq_scan(sscan);
+	FreeExecutorState(estate);
+	pfree(typeExprs);
+	pfree(nullExprs);
 
 	drop_table(old_o_table->oids);
 }
@@ -2940,11 +3003,32 @@ o_parse_compress(const char *value)
 			result = O_COMPRESS_DEFAULT;
 		else if (strcmp(value, "off") == 0)
 			result = InvalidOCompress;
+		else if (strcmp(value, "lz4") == 0)
+			result = O_COMPRESS_LZ4;
+		else if (strcmp(value, "lz4hc") == 0)
+			result = O_COMPRESS_LZ4HC(O_COMPRESS_LZ4HC_DEFAULT_LEVEL);
+		else if (strncmp(value, "lz4hc:", 6) == 0)
+		{
+			char	   *end;
+			long		level = strtol(value + 6, &end, 10);
+
+			if (end == value + 6 || *end != '\0' ||
+				level < 1 || level > O_COMPRESS_LZ4HC_MAX_LEVEL)
+				ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+								errmsg("LZ4HC compression level must be between %d and %d",
+									   1, O_COMPRESS_LZ4HC_MAX_LEVEL)));
+			result = O_COMPRESS_LZ4HC(level);
+		}
 		else
 			ereport(ERROR, (errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
 							errmsg("invalid compression value: \"%s\"",
 								   value)));
 	}
+	else if (OCompressIsLZ4(result))
+	{
+		/* Numeric values are zstd levels only */
+		result = PG_INT16_MAX;
+	}
 
 	return result;
 }
@@ -38,13 +38,384 @@
 #include "utils/page_pool.h"
 
 #include "access/transam.h"
+#include "common/hashfn.h"
 #include "miscadmin.h"
+#include "storage/spin.h"
 #include "utils/wait_event.h"
 
 #define EXTENTS_IX_EQ(ex1, ex2) ((ex1).ixType == (ex2).ixType && \
 								 (ex1).datoid == (ex2).datoid && \
 								 (ex1).relnode == (ex2).relnode)
 
+/*
+ * Cache of the recently freed extents in front of the free extents B-trees.
+ *
+ * Each bucket holds the extents of the single length of the single tree.
+ * The page images of the compressed tree come in a few sizes, so freed
+ * extents are often reused at the same size.  The cache serves them without
+ * the B-trees lookups.  Extents only go from free_extent() to the cache and
+ * from the cache to get_extent().  They never move between the cache and the
+ * B-trees, so foreach_free_extent() sees each free extent exactly once
+ * scanning the B-trees first.  The cached extents aren't merged with their
+ * neighbors, so the buckets are kept small.
+ */
+#define FREE_EXTENTS_CACHE_BUCKET_SIZE	(8)
+#define FREE_EXTENTS_CACHE_MAX_LEN		(ORIOLEDB_BLCKSZ / ORIOLEDB_COMP_BLCKSZ)
+
+typedef struct
+{
+	slock_t		lock;
+	OIndexType	ixType;
+	Oid			datoid;
+	Oid			relnode;
+	uint16		len;
+	uint16		count;
+	FileExtent	extents[FREE_EXTENTS_CACHE_BUCKET_SIZE];
+} FreeExtentsCacheBucket;
+
+#define CACHE_BUCKET_MATCHES(bucket, desc, l) ((bucket)->ixType == (desc)->type && \
+											   (bucket)->datoid == (desc)->oids.datoid && \
+											   (bucket)->relnode == (desc)->oids.relnode && \
+											   (bucket)->len == (l))
+
+/* Number of buckets, zero means the cache is disabled */
+int			free_extents_cache_size = 1024;
+
+static FreeExtentsCacheBucket *freeExtentsCache = NULL;
+
+Size
+free_extents_cache_shmem_needs(void)
+{
+	return mul_size(sizeof(FreeExtentsCacheBucket), free_extents_cache_size);
+}
+
+void
+free_extents_cache_shmem_init(Pointer ptr, bool found)
+{
+	int			i;
+
+	freeExtentsCache = (FreeExtentsCacheBucket *) ptr;
+
+	if (!found)
+	{
+		for (i = 0; i < free_extents_cache_size; i++)
+		{
+			SpinLockInit(&freeExtentsCache[i].lock);
+			freeExtentsCache[i].len = 0;
+			freeExtentsCache[i].count = 0;
+		}
+	}
+}
+
+static FreeExtentsCacheBucket *
+free_extents_cache_bucket(BTreeDescr *desc, uint16 len)
+{
+	uint32		hash;
+
+	if (free_extents_cache_size == 0 || len > FREE_EXTENTS_CACHE_MAX_LEN)
+		return NULL;
+
+	hash = hash_bytes_uint32(desc->oids.datoid);
+	hash = hash_combine(hash, hash_bytes_uint32(desc->oids.relnode));
+	hash = hash_combine(hash, hash_bytes_uint32((uint32) desc->type *
+												(FREE_EXTENTS_CACHE_MAX_LEN + 1) + len));
+	return &freeExtentsCache[hash % free_extents_cache_size];
+}
+
+/*
+ * Puts the extent into the cache.  Returns false if the bucket is full or
+ * occupied by another tree or length.
+ */
+static bool
+free_extents_cache_put(BTreeDescr *desc, FileExtent extent)
+{
+	FreeExtentsCacheBucket *bucket = free_extents_cache_bucket(desc, extent.len);
+
+	if (bucket == NULL)
+		return false;
+
+	SpinLockAcquire(&bucket->lock);
+	if (bucket->count == 0)
+	{
+		bucket->ixType = desc->type;
+		bucket->datoid = desc->oids.datoid;
+		bucket->relnode = desc->oids.relnode;
+		bucket->len = extent.len;
+	}
+	else if (!CACHE_BUCKET_MATCHES(bucket, desc, extent.len) ||
+			 bucket->count == FREE_EXTENTS_CACHE_BUCKET_SIZE)
+	{
+		SpinLockRelease(&bucket->lock);
+		return false;
+	}
+	bucket->extents[bucket->count++] = extent;
+	SpinLockRelease(&bucket->lock);
+
+	return true;
+}
+
+/*
+ * Gets the extent of given length from the cache.  Prefers the extent
+ * continuing the previous one given to this backend.
+ */
+static bool
+free_extents_cache_get(BTreeDescr *desc, uint16 len, FileExtent *result)
+{
+	FreeExtentsCacheBucket *bucket = free_extents_cache_bucket(desc, len);
+	int			i,
+				j;
+
+	if (bucket == NULL)
+		return false;
+
+	SpinLockAcquire(&bucket->lock);
+	if (bucket->count == 0 || !CACHE_BUCKET_MATCHES(bucket, desc, len))
+	{
+		SpinLockRelease(&bucket->lock);
+		return false;
+	}
+
+	j = bucket->count - 1;
+	for (i = 0; i < bucket->count; i++)
+	{
+		if (bucket->extents[i].off == desc->lastExtentEnd)
+		{
+			j = i;
+			break;
+		}
+	}
+	*result = bucket->extents[j];
+	bucket->extents[j] = bucket->extents[--bucket->count];
+	SpinLockRelease(&bucket->lock);
+
+	pg_atomic_fetch_sub_u64(&BTREE_GET_META(desc)->numFreeBlocks, (uint64) len);
+	return true;
+}
+
+/*
+ * Calls the callback for each cached extent of the tree.
+ */
+static void
+free_extents_cache_foreach(BTreeDescr *desc, ForEachExtentCallback callback,
+						   void *arg)
+{
+	FileExtent	extents[FREE_EXTENTS_CACHE_BUCKET_SIZE];
+	uint16		len;
+	int			i,
+				count;
+
+	if (free_extents_cache_size == 0)
+		return;
+
+	for (len = 1; len <= FREE_EXTENTS_CACHE_MAX_LEN; len++)
+	{
+		FreeExtentsCacheBucket *bucket = free_extents_cache_bucket(desc, len);
+
+		SpinLockAcquire(&bucket->lock);
+		count = 0;
+		if (CACHE_BUCKET_MATCHES(bucket, desc, len))
+		{
+			count = bucket->count;
+			memcpy(extents, bucket->extents, sizeof(FileExtent) * count);
+		}
+		SpinLockRelease(&bucket->lock);
+
+		for (i = 0; i < count; i++)
+			callback(desc, extents[i], arg);
+	}
+}
+
+/*
+ * Allocates the extent at the end of the data file.
+ */
+static FileExtent
+get_extent_extend_file(BTreeDescr *desc, uint16 len)
+{
+	BTreeMetaPage *metaPage = BTREE_GET_META(desc);
+	FileExtent	result;
+
+	result.len = len;
+	if (use_device)
+		result.off = orioledb_device_alloc(desc, len * ORIOLEDB_COMP_BLCKSZ) / ORIOLEDB_COMP_BLCKSZ;
+	else
+	{
+		result.off = pg_atomic_fetch_add_u64(&metaPage->datafileLength[0], len);
+		btree_smgr_preallocate(desc, (off_t) result.off * ORIOLEDB_COMP_BLCKSZ,
+							   (off_t) (result.off + len) * ORIOLEDB_COMP_BLCKSZ);
+	}
+	desc->lastExtentEnd = result.off + result.len;
+	return result;
+}
+
+/*
+ * Takes the first 'len' blocks of the free extent found under the locked
+ * page of (len, off) B-tree.  Unlocks the page.  See get_extent() for the
+ * algorithm.
+ */
+static FileExtent
+get_extent_consume(BTreeDescr *desc, OBTreeFindPageContext *context,
+				   BTreeLeafTuphdr *header, FreeTreeTuple *cur_tup, uint16 len)
+{
+	BTreeMetaPage *metaPage = BTREE_GET_META(desc);
+	BTreeDescr *len_off_tree = get_sys_tree(SYS_TREES_EXTENTS_LEN_OFF);
+	BTreeDescr *off_len_tree = get_sys_tree(SYS_TREES_EXTENTS_OFF_LEN);
+	Page		p = O_GET_IN_MEMORY_PAGE(context->items[context->index].blkno);
+	FreeTreeTuple tup,
+				deleted_tup;
+	FileExtent	result;
+	bool		modify_result;
+	OTuple		tmpTup;
+
+	pg_atomic_fetch_sub_u64(&metaPage->numFreeBlocks, (uint64) len);
+
+	/* delete the extent from the (len, off) B-tree in-place */
+	page_block_reads(context->items[context->index].blkno);
+
+	START_CRIT_SECTION();
+
+	header->deleted = true;
+	header->xactInfo = OXID_GET_XACT_INFO(BootstrapTransactionId, RowLockUpdate, false);
+	PAGE_ADD_N_VACATED(p, BTreeLeafTuphdrSize + sizeof(FreeTreeTuple));
+
+	END_CRIT_SECTION();
+
+	deleted_tup = *cur_tup;
+
+	MARK_DIRTY(len_off_tree, context->items[context->index].blkno);
+
+	if (is_page_too_sparse(len_off_tree, p))
+		(void) btree_try_merge_and_unlock(len_off_tree,
+										  context->items[context->index].blkno,
+										  false, false);
+	else
+		unlock_page(context->items[context->index].blkno);
+
+	Assert(deleted_tup.extent.length >= len);
+	tup = deleted_tup;
+	tup.extent.length -= len;
+
+	if (tup.extent.length > 0)
+	{
+		/* we have a remaining part, insert it into (off, len) B-tree */
+		tup.extent.offset += len;
+		tmpTup.formatFlags = 0;
+		tmpTup.data = (Pointer) &tup;
+		modify_result = o_btree_autonomous_insert(off_len_tree, tmpTup);
+		if (!modify_result)
+		{
+			elog(FATAL, "unable to insert extent (%lu, %lu) into the (off, len) B-tree",
+				 tup.extent.offset, tup.extent.length);
+		}
+	}
+
+	/* delete the extent from the (off, len) B-tree */
+	tmpTup.formatFlags = 0;
+	tmpTup.data = (Pointer) &deleted_tup;
+	modify_result = o_btree_autonomous_delete(off_len_tree, tmpTup, BTreeKeyLeafTuple, NULL);
+	if (!modify_result)
+	{
+		elog(FATAL, "unable to delete extent (%lu, %lu) from the (off, len) B-tree",
+			 deleted_tup.extent.offset, deleted_tup.extent.length);
+	}
+
+	if (tup.extent.length > 0)
+	{
+		/*
+		 * we have a remaining part, insert it into (len, off) B-tree after
+		 * this remaining part may be gotten
+		 */
+		tmpTup.formatFlags = 0;
+		tmpTup.data = (Pointer) &tup;
+		modify_result = o_btree_autonomous_insert(len_off_tree, tmpTup);
+		if (!modify_result)
+		{
+			elog(FATAL, "unable to insert extent (%lu, %lu) into the (len, off) B-tree",
+				 tup.extent.offset, tup.extent.length);
+		}
+	}
+
+	result.off = deleted_tup.extent.offset;
+	result.len = len;
+
+	return result;
+}
+
+/*
+ * Tries to get the extent of length 'len' starting exactly at 'off'.  Looks
+ * up the (off, len) B-tree and then deletes the found extent from the
+ * (len, off) B-tree in-place like get_extent() does.  Returns false if there
+ * is no such extent or it was concurrently taken.
+ */
+static bool
+get_extent_at(BTreeDescr *desc, uint64 off, uint16 len, FileExtent *result)
+{
+	BTreeDescr *len_off_tree = get_sys_tree(SYS_TREES_EXTENTS_LEN_OFF);
+	BTreeDescr *off_len_tree = get_sys_tree(SYS_TREES_EXTENTS_OFF_LEN);
+	BTreeIterator *it;
+	BTreeLeafTuphdr *header;
+	BTreePageItemLocator *loc;
+	OBTreeFindPageContext context;
+	FreeTreeTuple tup,
+			   *cur;
+	OTuple		tmpTup;
+	Page		p;
+
+	memset(&tup, 0, sizeof(FreeTreeTuple));
+	tup.ixType = desc->type;
+	tup.datoid = desc->oids.datoid;
+	tup.relnode = desc->oids.relnode;
+	tup.extent.offset = off;
+	tup.extent.length = 0;
+
+	tmpTup.data = (Pointer) &tup;
+	tmpTup.formatFlags = 0;
+	it = o_btree_iterator_create(off_len_tree, (Pointer) &tmpTup,
+								 BTreeKeyNonLeafKey,
+								 &o_in_progress_snapshot,
+								 ForwardScanDirection);
+	tmpTup = o_btree_iterator_fetch(it, NULL, NULL, BTreeKeyLeafTuple,
+									false, NULL);
+	btree_iterator_free(it);
+
+	cur = (FreeTreeTuple *) tmpTup.data;
+	if (cur == NULL)
+		return false;
+	if (!EXTENTS_IX_EQ(*cur, tup) || cur->extent.offset != off ||
+		cur->extent.length < len)
+	{
+		pfree(cur);
+		return false;
+	}
+	tup.extent.length = cur->extent.length;
+	pfree(cur);
+
+	init_page_find_context(&context, len_off_tree, COMMITSEQNO_INPROGRESS,
+						   BTREE_PAGE_FIND_MODIFY | BTREE_PAGE_FIND_FIX_LEAF_SPLIT);
+	tmpTup.data = (Pointer) &tup;
+	tmpTup.formatFlags = 0;
+	(void) find_page(&context, (Pointer) &tmpTup, BTreeKeyLeafTuple, 0);
+	p = O_GET_IN_MEMORY_PAGE(context.items[context.index].blkno);
+	loc = &context.items[context.index].locator;
+
+	if (BTREE_PAGE_LOCATOR_IS_VALID(p, loc))
+	{
+		BTREE_PAGE_READ_LEAF_ITEM(header, tmpTup, p, loc);
+		cur = (FreeTreeTuple *) tmpTup.data;
+
+		if (EXTENTS_IX_EQ(*cur, tup) &&
+			cur->extent.offset == tup.extent.offset &&
+			cur->extent.length == tup.extent.length &&
+			!header->deleted)
+		{
+			*result = get_extent_consume(desc, &context, header, cur, len);
+			return true;
+		}
+	}
+
+	unlock_page(context.items[context.index].blkno);
+	return false;
+}
+
 /*
  * Returns free file extent with length = len.
  *
@@ -66,6 +437,10 @@
  * 3. Delete founded extent from the (off, len) B-tree.
  * 4. If found extent is more than needed than return the remaining part into
  * the (len, off) B-tree.
+ *
+ * Before the search, get_extent() tries the cache of freed extents and then
+ * the free extent starting right after the previous extent given to this
+ * backend.  So, the consecutive page writes tend to be sequential.
  */
 FileExtent
 get_extent(BTreeDescr *desc, uint16 len)
@@ -73,37 +448,42 @@ get_extent(BTreeDescr *desc, uint16 len)
 	BTreeMetaPage *metaPage = BTREE_GET_META(desc);
 	BTreeLeafTuphdr *header = NULL;
 	FreeTreeTuple tup,
-				deleted_tup,
 			   *cur_tup = NULL;
 	FileExtent	result;
 	OBTreeFindPageContext context;
 	Page		p = NULL;
 	bool		old_enable_stopevents;
 	bool		found = false,
-				end = false,
-				modify_result;
+				end = false;
 	BTreePageItemLocator *loc;
 	BTreeDescr *len_off_tree = get_sys_tree(SYS_TREES_EXTENTS_LEN_OFF);
-	BTreeDescr *off_len_tree = get_sys_tree(SYS_TREES_EXTENTS_OFF_LEN);
 	OTuple		tmpTup;
 
 	Assert(!orioledb_s3_mode);
 
 	/* a fast check */
 	if (pg_atomic_read_u64(&metaPage->numFreeBlocks) < len)
+		return get_extent_extend_file(desc, len);
+
+	/* the cache of recently freed extents goes first */
+	if (free_extents_cache_get(desc, len, &result))
 	{
-		/* free extent can not be founded, increase file length */
-		result.len = len;
-		if (use_device)
-			result.off = orioledb_device_alloc(desc, len * ORIOLEDB_COMP_BLCKSZ) / ORIOLEDB_COMP_BLCKSZ;
-		else
-			result.off = pg_atomic_fetch_add_u64(&metaPage->datafileLength[0], len);
+		desc->lastExtentEnd = result.off + result.len;
 		return result;
 	}
 
 	old_enable_stopevents = enable_stopevents;
 	enable_stopevents = false;
 
+	/* try to continue the previous extent */
+	if (desc->lastExtentEnd != 0 &&
+		get_extent_at(desc, desc->lastExtentEnd, len, &result))
+	{
+		enable_stopevents = old_enable_stopevents;
+		desc->lastExtentEnd = result.off + result.len;
+		return result;
+	}
+
 	tup.ixType = desc->type;
 	tup.datoid = desc->oids.datoid;
 	tup.relnode = desc->oids.relnode;
@@ -174,90 +554,17 @@ get_extent(BTreeDescr *desc, uint16 len)
 	if (!found)
 	{
 		/* free extent not founded, increase file length */
-		result.len = len;
-		if (use_device)
-			result.off = orioledb_device_alloc(desc, len * ORIOLEDB_COMP_BLCKSZ) / ORIOLEDB_COMP_BLCKSZ;
-		else
-			result.off = pg_atomic_fetch_add_u64(&metaPage->datafileLength[0], len);
 		enable_stopevents = old_enable_stopevents;
-		return result;
+		return get_extent_extend_file(desc, len);
 	}
 
 	Assert(p != NULL);
 	Assert(header != NULL);
 	Assert(cur_tup != NULL);
-	pg_atomic_fetch_sub_u64(&metaPage->numFreeBlocks, (uint64) len);
-
-	/* delete the extent from the (len, off) B-tree in-place */
-	page_block_reads(context.items[context.index].blkno);
-
-	START_CRIT_SECTION();
-
-	header->deleted = true;
-	header->xactInfo = OXID_GET_XACT_INFO(BootstrapTransactionId, RowLockUpdate, false);
-	PAGE_ADD_N_VACATED(p, BTreeLeafTuphdrSize + sizeof(FreeTreeTuple));
-
-	END_CRIT_SECTION();
-
-	deleted_tup = *cur_tup;
-
-	MARK_DIRTY(len_off_tree, context.items[context.index].blkno);
-
-	if (is_page_too_sparse(len_off_tree, p))
-		(void) btree_try_merge_and_unlock(len_off_tree,
-										  context.items[context.index].blkno,
-										  false, false);
-	else
-		unlock_page(context.items[context.index].blkno);
-
-	Assert(deleted_tup.extent.length >= len);
-	tup = deleted_tup;
-	tup.extent.length -= len;
-
-	if (tup.extent.length > 0)
-	{
-		/* we have a remaining part, insert it into (off, len) B-tree */
-		tup.extent.offset += len;
-		tmpTup.formatFlags = 0;
-		tmpTup.data = (Pointer) &tup;
-		modify_result = o_btree_autonomous_insert(off_len_tree, tmpTup);
-		if (!modify_result)
-		{
-			elog(FATAL, "unable to insert extent (%lu, %lu) into the (off, len) B-tree",
-				 tup.extent.offset, tup.extent.length);
-		}
-	}
-
-	/* delete the extent from the (off, len) B-tree */
-	tmpTup.formatFlags = 0;
-	tmpTup.data = (Pointer) &deleted_tup;
-	modify_result = o_btree_autonomous_delete(off_len_tree, tmpTup, BTreeKeyLeafTuple, NULL);
-	if (!modify_result)
-	{
-		elog(FATAL, "unable to delete extent (%lu, %lu) from the (off, len) B-tree",
-			 deleted_tup.extent.offset, deleted_tup.extent.length);
-	}
-
-	if (tup.extent.length > 0)
-	{
-		/*
-		 * we have a remaining part, insert it into (len, off) B-tree after
-		 * this remaining part may be gotten
-		 */
-		tmpTup.formatFlags = 0;
-		tmpTup.data = (Pointer) &tup;
-		modify_result = o_btree_autonomous_insert(len_off_tree, tmpTup);
-		if (!modify_result)
-		{
-			elog(FATAL, "unable to insert extent (%lu, %lu) into the (len, off) B-tree",
-				 tup.extent.offset, tup.extent.length);
-		}
-	}
-
-	result.off = deleted_tup.extent.offset;
-	result.len = len;
+	result = get_extent_consume(desc, &context, header, cur_tup, len);
 
 	enable_stopevents = old_enable_stopevents;
+	desc->lastExtentEnd = result.off + result.len;
 	return result;
 }
 
@@ -292,10 +599,13 @@ free_extent(BTreeDescr *desc, FileExtent extent)
 	BTreeDescr *off_len_tree = get_sys_tree(SYS_TREES_EXTENTS_OFF_LEN);
 	OTuple		tmpTup;
 
-	enable_stopevents = false;
-
 	Assert(FileExtentIsValid(extent));
 
+	if (free_extents_cache_put(desc, extent))
+		return;
+
+	enable_stopevents = false;
+
 	memset(&tup, 0, sizeof(FreeTreeTuple));
 	memset(&right, 0, sizeof(FreeTreeTuple));
 	memset(&left, 0, sizeof(FreeTreeTuple));
@@ -537,6 +847,10 @@ foreach_free_extent(BTreeDescr *desc, ForEachExtentCallback callback, void *arg)
 	}
 
 	btree_iterator_free(it);
+
+	/* The cached extents go after the B-trees, see the cache comment */
+	free_extents_cache_foreach(desc, callback, arg);
+
 	enable_stopevents = old_enable_stopevents;
 }
 
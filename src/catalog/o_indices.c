@@ -23,6 +23,7 @@
 #include "commands/defrem.h"
 #include "recovery/recovery.h"
 #include "tableam/descr.h"
+#include "tableam/tree.h"
 #include "tuple/slot.h"
 #include "tuple/toast.h"
 
@@ -678,7 +679,12 @@ fillFixedFormatSpec(TupleDesc tupdesc, OTupleFixedFormatSpec *spec,
 		if (attr->attlen <= 0)
 			break;
 
+		/*
+		 * Offsets of the leading fixed-width fields are static.  Cache them
+		 * upfront, so that o_tuple_read_fixed_fields() can use them.
+		 */
 		len = att_align_nominal(len, attr->attalign);
+		attr->attcacheoff = len;
 		len += attr->attlen;
 	}
 	spec->natts = i;
@@ -894,6 +900,11 @@ o_index_fill_descr(OIndexDescr *descr, OIndex *oIndex, OTable *oTable)
 										   iField->opclass);
 	}
 
+	if (oIndex->indexType != oIndexToast)
+		o_index_fill_key_image_types(descr);
+	else
+		descr->nKeyImageFields = 0;
+
 	mcxt = OGetIndexContext(descr);
 	old_mcxt = MemoryContextSwitchTo(mcxt);
 	descr->predicate = list_copy_deep(oIndex->predicate);
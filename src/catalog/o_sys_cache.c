@@ -379,14 +379,12 @@ invalidate_fastcache_entry(int cacheid, uint32 hashvalue)
 			if (tree_entry->sys_cache)
 			{
 				OSysCache  *sys_cache = tree_entry->sys_cache;
+				int			slot = hashvalue % O_SYS_CACHE_RECENT_SIZE;
 
-				if (!memcmp(&sys_cache->last_fast_cache_key,
-							&fast_cache_entry->key,
-							sizeof(OSysCacheHashKey)))
+				if (sys_cache->recent_entries[slot] == tree_entry->entry)
 				{
-					memset(&sys_cache->last_fast_cache_key, 0,
-						   sizeof(OSysCacheHashKey));
-					sys_cache->last_fast_cache_entry = NULL;
+					sys_cache->recent_keys[slot] = 0;
+					sys_cache->recent_entries[slot] = NULL;
 				}
 				tree_entry->sys_cache->funcs->free_entry(tree_entry->entry);
 			}
@@ -429,30 +427,31 @@ o_sys_cache_search(OSysCache *sys_cache, int nkeys, OSysCacheKey *key)
 	Pointer		tree_entry;
 	MemoryContext prev_context;
 	OSysCacheHashTreeEntry *new_entry;
+	int			slot;
 
 	cur_fast_cache_key = compute_hash_value(sys_cache->cc_hashfunc,
 											sys_cache->nkeys, key);
+	slot = cur_fast_cache_key % O_SYS_CACHE_RECENT_SIZE;
 
 	/* fast search */
-	if (!memcmp(&cur_fast_cache_key, &sys_cache->last_fast_cache_key,
-				sizeof(OSysCacheHashKey)) &&
-		sys_cache->last_fast_cache_entry)
+	if (sys_cache->recent_keys[slot] == cur_fast_cache_key &&
+		sys_cache->recent_entries[slot])
 	{
 		OSysCacheKey *sys_cache_key;
 
-		sys_cache_key = (OSysCacheKey *) sys_cache->last_fast_cache_entry;
+		sys_cache_key = (OSysCacheKey *) sys_cache->recent_entries[slot];
 
 		if (sys_cache_key->common.datoid == key->common.datoid &&
 			o_sys_cache_key_cmp(sys_cache, sys_cache->nkeys, sys_cache_key,
 								key) == 0)
-			return sys_cache->last_fast_cache_entry;
+			return sys_cache->recent_entries[slot];
 	}
 
 	/* cache search */
 	fast_cache_entry = (OSysCacheHashEntry *)
-		hash_search(sys_cache->fast_cache, &cur_fast_cache_key, HASH_ENTER,
-					&found);
-	if (found)
+		hash_search(sys_cache->fast_cache, &cur_fast_cache_key, HASH_FIND,
+					NULL);
+	if (fast_cache_entry)
 	{
 		ListCell   *lc;
 
@@ -472,17 +471,13 @@ o_sys_cache_search(OSysCache *sys_cache, int nkeys, OSysCacheKey *key)
 					o_sys_cache_key_cmp(sys_cache, sys_cache->nkeys,
 										sys_cache_key, key) == 0)
 				{
-					memcpy(&sys_cache->last_fast_cache_key,
-						   &cur_fast_cache_key,
-						   sizeof(OSysCacheHashKey));
-					sys_cache->last_fast_cache_entry = tree_entry->entry;
-					return sys_cache->last_fast_cache_entry;
+					sys_cache->recent_keys[slot] = cur_fast_cache_key;
+					sys_cache->recent_entries[slot] = tree_entry->entry;
+					return tree_entry->entry;
 				}
 			}
 		}
 	}
-	else
-		fast_cache_entry->tree_entries = NIL;
 
 	prev_context = MemoryContextSwitchTo(sys_cache->mcxt);
 	if (sys_cache->is_toast)
@@ -498,16 +493,23 @@ o_sys_cache_search(OSysCache *sys_cache, int nkeys, OSysCacheKey *key)
 	new_entry->sys_cache = sys_cache;
 	new_entry->entry = tree_entry;
 
+	/*
+	 * Enter the fast cache entry only now: misses shouldn't leave empty
+	 * entries, and the tree search might process the invalidations.
+	 */
+	fast_cache_entry = (OSysCacheHashEntry *)
+		hash_search(sys_cache->fast_cache, &cur_fast_cache_key, HASH_ENTER,
+					&found);
+	if (!found)
+		fast_cache_entry->tree_entries = NIL;
 	fast_cache_entry->tree_entries = lappend(fast_cache_entry->tree_entries,
 											 new_entry);
 
 	MemoryContextSwitchTo(prev_context);
 
-	memcpy(&sys_cache->last_fast_cache_key,
-		   &cur_fast_cache_key,
-		   sizeof(OSysCacheHashKey));
-	sys_cache->last_fast_cache_entry = new_entry->entry;
-	return sys_cache->last_fast_cache_entry;
+	sys_cache->recent_keys[slot] = cur_fast_cache_key;
+	sys_cache->recent_entries[slot] = new_entry->entry;
+	return new_entry->entry;
 }
 
 static TupleFetchCallbackResult
@@ -25,6 +25,7 @@
 #include "tableam/operations.h"
 #include "transam/oxid.h"
 #include "tuple/toast.h"
+#include "utils/compress.h"
 #include "utils/planner.h"
 
 #include "access/heapam.h"
@@ -1334,10 +1335,10 @@ describe_table(ORelOids oids)
 	}
 
 	initStringInfo(&title);
-	appendStringInfo(&title, "Compress = %d, Primary compress = %d, TOAST compress = %d\n",
-					 table->default_compress,
-					 table->primary_compress,
-					 table->toast_compress);
+	appendStringInfo(&title, "Compress = %s, Primary compress = %s, TOAST compress = %s\n",
+					 o_compress_name(table->default_compress),
+					 o_compress_name(table->primary_compress),
+					 o_compress_name(table->toast_compress));
 	appendStringInfo(&title, " %%%ds | %%%ds | %%%ds | Nullable | Droped ",
 					 max_column_str,
 					 max_type_str,
@@ -743,6 +743,7 @@ sys_tree_init(int i, bool init_shmem)
 	ops->tuple_make_key = sys_tree_tuple_make_key;
 	ops->needs_undo = meta->needs_undo;
 	ops->cmp = meta->cmpFunc;
+	ops->key_image = NULL;
 	ops->unique_hash = NULL;
 	ops->hash = sys_tree_hash;
 
@@ -752,6 +753,7 @@ sys_tree_init(int i, bool init_shmem)
 	descr->undoType = meta->undoLogType;
 	descr->storageType = meta->storageType;
 	descr->createOxid = InvalidOXid;
+	descr->lastExtentEnd = 0;
 
 	if (descr->storageType == BTreeStoragePersistence)
 	{
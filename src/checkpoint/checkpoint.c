@@ -35,6 +35,7 @@
 #include "catalog/sys_trees.h"
 #include "checkpoint/checkpoint.h"
 #include "checkpoint/control.h"
+#include "checkpoint/extents_sort.h"
 #include "recovery/internal.h"
 #include "recovery/recovery.h"
 #include "recovery/wal.h"
@@ -47,19 +48,30 @@
 #include "utils/seq_buf.h"
 #include "utils/stopevent.h"
 #include "utils/ucm.h"
+#include "workers/warmup.h"
 
 #include "access/xlog_internal.h"
 #include "access/xlogarchive.h"
 #include "catalog/pg_database.h"
 #include "common/hashfn.h"
+#include "funcapi.h"
 #include "miscadmin.h"
 #include "pgstat.h"
+#include "portability/instr_time.h"
+#include "postmaster/bgworker.h"
 #include "postmaster/bgwriter.h"
 #include "storage/bufmgr.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
 #include "storage/proc.h"
+#include "storage/sinvaladt.h"
 #include "utils/memdebug.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/timeout.h"
+#include "utils/timestamp.h"
+#include "utils/tuplestore.h"
+#include "utils/wait_event.h"
 
 /*
  * Single action in B-tree checkpoint loop.
@@ -128,8 +140,41 @@ typedef struct
 {
 	List	   *postProcessList;
 	int			flags;
+	/* number of the checkpoint helpers started for this checkpoint */
+	int			helpersNum;
 } CheckpointTablesArg;
 
+typedef enum
+{
+	CheckpointHelperStarting,
+	CheckpointHelperIdle,
+	CheckpointHelperBusy,
+	CheckpointHelperDone,
+	CheckpointHelperFailed,
+	CheckpointHelperExit
+} CheckpointHelperStatus;
+
+/*
+ * Shared state of the checkpoint helper.  The checkpointer assigns a tree to
+ * an idle helper, the helper checkpoints it and reports the post-processing
+ * item back.
+ */
+typedef struct
+{
+	pg_atomic_uint32 status;
+	struct Latch *latch;
+	int			flags;
+	OIndexType	type;
+	ORelOids	treeOids;
+	bool		postProcess;
+	IndexIdItem item;
+} CheckpointHelper;
+
+#define CHECKPOINT_HELPER_STATE_SIZE CACHELINEALIGN(sizeof(CheckpointState))
+#define GET_CHECKPOINT_HELPER_STATE(i) \
+	((CheckpointState *) (checkpoint_helper_states + \
+						  (i) * CHECKPOINT_HELPER_STATE_SIZE))
+
 typedef struct
 {
 	FileExtent *extents;
@@ -157,22 +202,44 @@ CheckpointState *checkpoint_state = NULL;
 MemoryContext chkp_main_context = NULL;
 MemoryContext chkp_tree_context = NULL;
 
+static Pointer checkpoint_helper_states = NULL;
+static CheckpointHelper *checkpoint_helpers = NULL;
+static BackgroundWorkerHandle **checkpoint_helper_handles = NULL;
+
 static char *xidFilename = NULL;
 static uint32 xidFileCheckpointnum = 0;
 static File xidFile = -1;
 static S3TaskLocation maxLocation = 0;
 
+/* Reuse the previous images of clean subtrees during the current walk */
+static bool skip_clean_subtrees = false;
+
+/*
+ * Moving average of the writeback latency per block in microseconds observed
+ * by this process.  Each new sample has WRITEBACK_LATENCY_WEIGHT share.
+ */
+static double writeback_latency = 0.0;
+#define WRITEBACK_LATENCY_WEIGHT	(8.0)
+
+/* Limits of the pacing delay in microseconds, see checkpoint_pace() */
+#define CHECKPOINT_PACE_MIN_DELAY	(100.0)
+#define CHECKPOINT_PACE_MAX_DELAY	(100000.0)
+/* Maximal slowdown due to the slow foreground reads */
+#define CHECKPOINT_PACE_MAX_BACKOFF (8.0)
+
+PG_FUNCTION_INFO_V1(orioledb_get_checkpoint_progress);
+
 static void init_writeback(CheckpointWriteBack *writeback, int flags, bool isCompressed);
 static void writeback_put_extent(CheckpointWriteBack *writeback, FileExtent *extent);
-static void perform_writeback(BTreeDescr *desc, CheckpointWriteBack *writeback);
+static void perform_writeback(BTreeDescr *desc, CheckpointWriteBack *writeback,
+							  CheckpointState *state);
 static void free_writeback(CheckpointWriteBack *writeback);
+static void drain_xids_queue(void);
 
 static uint64 append_file_contents(File target, char *source_filename, uint64 offset);
 static uint64 finalize_chkp_map(File chkp_file, uint64 len,
 								char *input_filename, uint64 input_offset,
 								uint32 input_num);
-static int	uint32_offsets_cmp(const void *a, const void *b);
-static int	file_extents_len_off_cmp(const void *a, const void *b);
 static int	file_extents_off_len_cmp(const void *a, const void *b);
 static int	file_extents_writeback_cmp(const void *a, const void *b);
 
@@ -180,8 +247,12 @@ static void sort_checkpoint_map_file(BTreeDescr *descr, int cur_chkp_index);
 static void sort_checkpoint_tmp_file(BTreeDescr *descr, int cur_chkp_index);
 static inline void checkpoint_ix_init_state(CheckpointState *state, BTreeDescr *descr);
 static void checkpoint_init_new_seq_bufs(BTreeDescr *descr, int chkpNum);
-static void checkpoint_temporary_tree(int flags, BTreeDescr *descr);
-static bool checkpoint_ix(int flags, BTreeDescr *descr);
+static void checkpoint_temporary_tree(int flags, BTreeDescr *descr,
+									  CheckpointState *state);
+static bool checkpoint_ix(int flags, BTreeDescr *descr,
+						  CheckpointState *state);
+static bool checkpoint_table_tree(int flags, BTreeDescr *td,
+								  CheckpointState *state, IndexIdItem *item);
 static uint64 checkpoint_btree(BTreeDescr **descrPtr, CheckpointState *state,
 							   CheckpointWriteBack *writeback);
 static Jsonb *prepare_checkpoint_step_params(BTreeDescr *descr,
@@ -198,6 +269,9 @@ static void prepare_leaf_page(BTreeDescr *descr, CheckpointState *state);
 static void checkpoint_lock_page(BTreeDescr *descr, CheckpointState *state,
 								 OInMemoryBlkno *blkno, uint32 page_chage_count,
 								 int level);
+static int	checkpoint_helpers_start(int flags);
+static void checkpoint_helpers_shutdown(CheckpointTablesArg *tbl_arg);
+static void checkpoint_helpers_stop(CheckpointTablesArg *tbl_arg);
 static void checkpoint_tables_callback(OIndexType type, ORelOids treeOids,
 									   ORelOids tableOids, void *arg);
 static inline void init_seq_buf_pages(BTreeDescr *desc, SeqBufDescShared *shared);
@@ -227,7 +301,7 @@ checkpoint_reset_stack(CheckpointState *state)
 		Assert(state->stack[i].nextkeyType == NextKeyNone);
 	}
 
-	pg_atomic_write_u32(&checkpoint_state->autonomousLevel, ORIOLEDB_MAX_DEPTH);
+	pg_atomic_write_u32(&state->autonomousLevel, ORIOLEDB_MAX_DEPTH);
 
 	chkp_inc_changecount_after(state);
 }
@@ -239,6 +313,13 @@ checkpoint_shmem_size(void)
 
 	size = offsetof(CheckpointState, xidRecQueue);
 	size = add_size(size, mul_size(sizeof(XidFileRec), XID_RECS_QUEUE_SIZE));
+	size = CACHELINEALIGN(size);
+
+	/* Tree states and shared states of the checkpoint helpers */
+	size = add_size(size, mul_size(CHECKPOINT_HELPER_STATE_SIZE,
+								   checkpoint_workers));
+	size = add_size(size, mul_size(sizeof(CheckpointHelper),
+								   checkpoint_workers));
 
 	return CACHELINEALIGN(size);
 }
@@ -246,18 +327,44 @@ checkpoint_shmem_size(void)
 void
 checkpoint_shmem_init(Pointer ptr, bool found)
 {
+	Size		size;
+
 	checkpoint_state = (CheckpointState *) ptr;
+	size = offsetof(CheckpointState, xidRecQueue);
+	size = add_size(size, mul_size(sizeof(XidFileRec), XID_RECS_QUEUE_SIZE));
+	checkpoint_helper_states = ptr + CACHELINEALIGN(size);
+	checkpoint_helpers = (CheckpointHelper *) (checkpoint_helper_states +
+											   CHECKPOINT_HELPER_STATE_SIZE * checkpoint_workers);
 
 	if (!found)
 	{
 		int			i;
 		CheckpointControl control;
 
+		for (i = 0; i < checkpoint_workers; i++)
+		{
+			CheckpointState *state = GET_CHECKPOINT_HELPER_STATE(i);
+
+			memset(state, 0, sizeof(*state));
+			state->treeType = oIndexInvalid;
+			state->curKeyType = CurKeyFinished;
+			state->pid = InvalidPid;
+			pg_atomic_init_u32(&state->autonomousLevel, ORIOLEDB_MAX_DEPTH);
+			checkpoint_reset_stack(state);
+
+			memset(&checkpoint_helpers[i], 0, sizeof(CheckpointHelper));
+			pg_atomic_init_u32(&checkpoint_helpers[i].status,
+							   CheckpointHelperExit);
+		}
+
 		memset(checkpoint_state, 0, sizeof(*checkpoint_state));
 		checkpoint_state->curKeyType = CurKeyFinished;
 		checkpoint_state->pid = InvalidPid;
 		pg_atomic_init_u64(&checkpoint_state->mmapDataLength, 0);
 		pg_atomic_init_u32(&checkpoint_state->autonomousLevel, ORIOLEDB_MAX_DEPTH);
+		pg_atomic_init_u32(&checkpoint_state->progressTreesDone, 0);
+		pg_atomic_init_u64(&checkpoint_state->progressPagesWritten, 0);
+		pg_atomic_init_u64(&checkpoint_state->progressBytesWritten, 0);
 
 		for (i = 0; i < (int) UndoLogsCount; i++)
 		{
@@ -405,6 +512,10 @@ writeback_put_extent(CheckpointWriteBack *writeback, FileExtent *extent)
 													 sizeof(FileExtent) * writeback->extentsAllocated);
 	}
 	writeback->extents[writeback->extentsNumber] = *extent;
+	pg_atomic_fetch_add_u64(&checkpoint_state->progressPagesWritten, 1);
+	pg_atomic_fetch_add_u64(&checkpoint_state->progressBytesWritten,
+							(uint64) extent->len *
+							(writeback->isCompressed ? ORIOLEDB_COMP_BLCKSZ : ORIOLEDB_BLCKSZ));
 	if (orioledb_s3_mode)
 		writeback->extents[writeback->extentsNumber].off &= S3_OFFSET_MASK;
 	if (!writeback->isCompressed && use_device)
@@ -412,16 +523,117 @@ writeback_put_extent(CheckpointWriteBack *writeback, FileExtent *extent)
 	writeback->extentsNumber++;
 }
 
+/*
+ * Estimates the fraction of the checkpoint pages already written.  The
+ * estimate made at the checkpoint start is refined with the number of dirty
+ * pages remaining.
+ */
+static double
+checkpoint_get_progress(void)
+{
+	double		written = (double) pg_atomic_read_u64(&checkpoint_state->progressPagesWritten);
+	double		total;
+
+	total = Min(checkpoint_state->dirtyPagesEstimate,
+				written + (double) get_dirty_pages_count_sum());
+	if (total <= 0.0)
+		return 1.0;
+	return Min(written / total, 1.0);
+}
+
+/*
+ * Sleeps between the writebacks if the checkpoint is ahead of its time
+ * schedule.  The delay equals the time the device took for the writeback, so
+ * the device gets idle time for the foreground reads.  The delay is extended
+ * when the foreground page reads are slower than
+ * orioledb.checkpoint_read_latency_target.  The delay never exceeds the time
+ * the checkpoint is ahead of the schedule.
+ */
+static void
+checkpoint_pace(int flags, double progress, double writebackTime)
+{
+	double		budget,
+				elapsed,
+				slack,
+				readLatency,
+				delay;
+
+	if (flags & (CHECKPOINT_IMMEDIATE | CHECKPOINT_IS_SHUTDOWN |
+				 CHECKPOINT_END_OF_RECOVERY))
+		return;
+
+	if (checkpoint_state->progressStartTime == 0)
+		return;
+
+	/* Time for writing the trees within the checkpoint in microseconds */
+	budget = (double) CheckPointTimeout * 1000000.0 *
+		CheckPointCompletionTarget * o_checkpoint_completion_ratio;
+	elapsed = (double) (GetCurrentTimestamp() - checkpoint_state->progressStartTime);
+	slack = progress * budget - elapsed;
+	if (slack <= 0.0)
+		return;
+
+	delay = writebackTime;
+	readLatency = page_read_latency() / 1000.0;
+	if (checkpoint_read_latency_target > 0.0 &&
+		readLatency > checkpoint_read_latency_target)
+		delay *= Min(readLatency / checkpoint_read_latency_target,
+					 CHECKPOINT_PACE_MAX_BACKOFF);
+
+	delay = Min(delay, slack);
+	delay = Min(delay, CHECKPOINT_PACE_MAX_DELAY);
+	if (delay < CHECKPOINT_PACE_MIN_DELAY)
+		return;
+
+	pgstat_report_wait_start(WAIT_EVENT_CHECKPOINT_WRITE_DELAY);
+	pg_usleep((long) delay);
+	pgstat_report_wait_end();
+}
+
+/*
+ * Writes back the range of the data file, and paces the checkpoint.
+ */
+static void
+checkpoint_writeback_range(BTreeDescr *desc, CheckpointWriteBack *writeback,
+						   uint32 chkpNum, uint64 offset, int len, uint blcksz)
+{
+	instr_time	start,
+				duration;
+	double		progress;
+
+	INSTR_TIME_SET_CURRENT(start);
+	btree_smgr_writeback(desc, chkpNum,
+						 (off_t) offset * (off_t) blcksz,
+						 (off_t) len * (off_t) blcksz);
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+
+	writeback_latency += (INSTR_TIME_GET_DOUBLE(duration) * 1000000.0 / len -
+						  writeback_latency) / WRITEBACK_LATENCY_WEIGHT;
+
+	progress = checkpoint_get_progress();
+	if (progress < 1.0)
+	{
+		CheckpointWriteDelay(writeback->checkpointFlags,
+							 progress * o_checkpoint_completion_ratio);
+		checkpoint_pace(writeback->checkpointFlags, progress,
+						writeback_latency * len);
+	}
+}
+
 static void
-perform_writeback(BTreeDescr *desc, CheckpointWriteBack *writeback)
+perform_writeback(BTreeDescr *desc, CheckpointWriteBack *writeback,
+				  CheckpointState *state)
 {
 	int			i,
 				len = 0;
 	uint64		offset = InvalidFileExtentOff;
-	double		progress = 0.0;
 	uint		blcksz = (writeback->isCompressed || use_mmap) ? ORIOLEDB_COMP_BLCKSZ : ORIOLEDB_BLCKSZ;
 	uint32		chkpNum = checkpoint_state->lastCheckpointNumber + 1;
 
+	if (MyBackendType == B_CHECKPOINTER)
+		drain_xids_queue();
+
 	if (use_device && !use_mmap)
 	{
 		writeback->extentsNumber = 0;
@@ -446,30 +658,17 @@ perform_writeback(BTreeDescr *desc, CheckpointWriteBack *writeback)
 		else
 		{
 			if (len > 0)
-				btree_smgr_writeback(desc, chkpNum,
-									 (off_t) offset * (off_t) blcksz,
-									 (off_t) len * (off_t) blcksz);
+				checkpoint_writeback_range(desc, writeback, chkpNum,
+										   offset, len, blcksz);
 			offset = writeback->extents[i].off;
 			len = writeback->extents[i].len;
 		}
-
-		if (progress < 1.0)
-		{
-			progress = (double) (checkpoint_state->pagesWritten + (uint64) i)
-				/ (double) checkpoint_state->dirtyPagesEstimate;
-			if (progress < 1.0)
-			{
-				progress *= o_checkpoint_completion_ratio;
-				CheckpointWriteDelay(writeback->checkpointFlags, progress);
-			}
-		}
 	}
 
 	if (len > 0)
-		btree_smgr_writeback(desc, chkpNum,
-							 (off_t) offset * (off_t) blcksz,
-							 (off_t) len * (off_t) blcksz);
-	checkpoint_state->pagesWritten += writeback->extentsNumber;
+		checkpoint_writeback_range(desc, writeback, chkpNum,
+								   offset, len, blcksz);
+	state->pagesWritten += writeback->extentsNumber;
 	writeback->extentsNumber = 0;
 }
 
@@ -497,7 +696,7 @@ perform_writeback_and_relock(BTreeDescr *desc,
 			STOPEVENT(STOPEVENT_CHECKPOINT_WRITEBACK, params);
 		}
 
-		perform_writeback(desc, writeback);
+		perform_writeback(desc, writeback, state);
 
 		indexDescr = o_fetch_index_descr(treeOids, type, true, NULL);
 		if (!indexDescr)
@@ -508,7 +707,7 @@ perform_writeback_and_relock(BTreeDescr *desc,
 	}
 	else
 	{
-		perform_writeback(desc, writeback);
+		perform_writeback(desc, writeback, state);
 	}
 	return desc;
 }
@@ -519,17 +718,16 @@ free_writeback(CheckpointWriteBack *writeback)
 	pfree(writeback->extents);
 }
 
-static inline List *
-add_index_id_item(List *list, BTreeDescr *desc)
+/*
+ * Fills the item for post-processing of the tree after the checkpoint.
+ * Returns false if the tree needs no post-processing.
+ */
+static bool
+fill_index_id_item(IndexIdItem *item, BTreeDescr *desc)
 {
-	IndexIdItem *item;
-	MemoryContext old_context;
-
 	Assert(!orioledb_s3_mode);
 	Assert(desc->storageType == BTreeStoragePersistence ||
 		   desc->storageType == BTreeStorageUnlogged);
-	old_context = MemoryContextSwitchTo(chkp_main_context);
-	item = palloc(sizeof(IndexIdItem));
 	item->oids = desc->oids;
 	item->type = desc->type;
 	item->chkpNum = checkpoint_state->lastCheckpointNumber;
@@ -553,15 +751,34 @@ add_index_id_item(List *list, BTreeDescr *desc)
 		}
 	}
 
-	if (item->cleanupMap || item->freeExtents || item->punchHoles)
-		list = lappend(list, item);
-	else
-		pfree(item);
+	return item->cleanupMap || item->freeExtents || item->punchHoles;
+}
+
+static inline List *
+append_index_id_item(List *list, IndexIdItem *item)
+{
+	IndexIdItem *copy;
+	MemoryContext old_context;
+
+	old_context = MemoryContextSwitchTo(chkp_main_context);
+	copy = palloc(sizeof(IndexIdItem));
+	*copy = *item;
+	list = lappend(list, copy);
 	MemoryContextSwitchTo(old_context);
 
 	return list;
 }
 
+static inline List *
+add_index_id_item(List *list, BTreeDescr *desc)
+{
+	IndexIdItem item;
+
+	if (fill_index_id_item(&item, desc))
+		list = append_index_id_item(list, &item);
+	return list;
+}
+
 /*
  * Wait all the committing transactions to finish completely.  Ensures all the
  * transactions finished afterwards will have greater WAL position than given
@@ -689,6 +906,30 @@ try_flush_xids_queue(void)
 	}
 }
 
+/*
+ * Flushes the xids queue once it's half full.  The checkpointer calls this
+ * between its page writes, so the queue is written in the background and the
+ * backends committing during the checkpoint rarely find it full and have to
+ * write it themselves.  Never waits for the concurrent flush.
+ */
+static void
+drain_xids_queue(void)
+{
+	uint64		flushPos;
+
+	flushPos = pg_atomic_read_u64(&checkpoint_state->xidRecFlushPos);
+	if (pg_atomic_read_u64(&checkpoint_state->xidRecLastPos) - flushPos <
+		XID_RECS_QUEUE_SIZE / 2)
+		return;
+
+	if (LWLockConditionalAcquire(&checkpoint_state->oXidQueueFlushLock,
+								 LW_EXCLUSIVE))
+	{
+		flush_xids_queue();
+		LWLockRelease(&checkpoint_state->oXidQueueFlushLock);
+	}
+}
+
 /*
  * Write single xid record to queue.
  */
@@ -871,7 +1112,7 @@ checkpoint_sys_trees(int flags, uint32 cur_chkp_num,
 		if (desc->storageType == BTreeStoragePersistence ||
 			desc->storageType == BTreeStorageUnlogged)
 		{
-			success = checkpoint_ix(flags, desc);
+			success = checkpoint_ix(flags, desc, checkpoint_state);
 			/* System trees can't be concurrently deleted */
 			Assert(success);
 			if (!orioledb_s3_mode)
@@ -884,10 +1125,11 @@ checkpoint_sys_trees(int flags, uint32 cur_chkp_num,
 		}
 		else
 		{
-			checkpoint_temporary_tree(flags, desc);
+			checkpoint_temporary_tree(flags, desc, checkpoint_state);
 			if (!orioledb_s3_mode)
 				sort_checkpoint_tmp_file(desc, cur_chkp_num % 2);
 		}
+		pg_atomic_fetch_add_u32(&checkpoint_state->progressTreesDone, 1);
 	}
 }
 
@@ -903,7 +1145,7 @@ checkpoint_chkp_nums(int flags, uint32 cur_chkp_num,
 	checkpoint_ix_init_state(checkpoint_state, desc);
 	checkpoint_init_new_seq_bufs(desc, cur_chkp_num);
 
-	success = checkpoint_ix(flags, desc);
+	success = checkpoint_ix(flags, desc, checkpoint_state);
 
 	/* System trees can't be concurrently deleted */
 	Assert(success);
@@ -916,6 +1158,24 @@ checkpoint_chkp_nums(int flags, uint32 cur_chkp_num,
 	}
 }
 
+/*
+ * Returns the latest checkpoint number of the tuple not exceeding
+ * 'max_chkp_num'.
+ */
+static uint32
+chkp_num_tuple_get_latest(ChkpNumTuple *tuple, uint32 max_chkp_num)
+{
+	uint32		chkp_num = 0;
+
+	if (tuple->checkpointNumbers[0] <= max_chkp_num &&
+		tuple->checkpointNumbers[0] > chkp_num)
+		chkp_num = tuple->checkpointNumbers[0];
+	if (tuple->checkpointNumbers[1] <= max_chkp_num &&
+		tuple->checkpointNumbers[1] > chkp_num)
+		chkp_num = tuple->checkpointNumbers[1];
+	return chkp_num;
+}
+
 uint32
 o_get_latest_chkp_num(Oid datoid, Oid relnode, uint32 max_chkp_num,
 					  bool *found)
@@ -952,18 +1212,87 @@ o_get_latest_chkp_num(Oid datoid, Oid relnode, uint32 max_chkp_num,
 		*found = true;
 
 	result = (ChkpNumTuple *) result_tuple.data;
-	chkp_num = 0;
-	if (result->checkpointNumbers[0] <= max_chkp_num &&
-		result->checkpointNumbers[0] > chkp_num)
-		chkp_num = result->checkpointNumbers[0];
-	if (result->checkpointNumbers[1] <= max_chkp_num &&
-		result->checkpointNumbers[1] > chkp_num)
-		chkp_num = result->checkpointNumbers[1];
+	chkp_num = chkp_num_tuple_get_latest(result, max_chkp_num);
 	pfree(result_tuple.data);
 
 	return chkp_num;
 }
 
+/*
+ * Loads the whole chkp_num system tree into the local hash table keyed by
+ * (datoid, relnode).  The tree is the compact manifest of the live trees
+ * maintained by o_update_latest_chkp_num(), so the callers, which need the
+ * checkpoint numbers of many trees at once, read it once sequentially
+ * instead of doing a lookup per tree.
+ */
+HTAB *
+o_load_latest_chkp_nums(void)
+{
+	HASHCTL		ctl;
+	HTAB	   *chkpNums;
+	BTreeDescr *desc = get_sys_tree(SYS_TREES_CHKP_NUM);
+	BTreeIterator *it;
+	OTuple		tuple;
+
+	MemSet(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(SharedRootInfoKey);
+	ctl.entrysize = sizeof(ChkpNumTuple);
+	ctl.hcxt = CurrentMemoryContext;
+	chkpNums = hash_create("orioledb latest checkpoint numbers", 1024, &ctl,
+						   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	it = o_btree_iterator_create(desc, NULL, BTreeKeyNone,
+								 &o_in_progress_snapshot, ForwardScanDirection);
+	while (true)
+	{
+		ChkpNumTuple *entry;
+		ChkpNumTuple *chkpNumTuple;
+
+		tuple = o_btree_iterator_fetch(it, NULL, NULL, BTreeKeyNone, false,
+									   NULL);
+		if (O_TUPLE_IS_NULL(tuple))
+			break;
+
+		chkpNumTuple = (ChkpNumTuple *) tuple.data;
+		entry = (ChkpNumTuple *) hash_search(chkpNums, &chkpNumTuple->key,
+											 HASH_ENTER, NULL);
+		*entry = *chkpNumTuple;
+		pfree(tuple.data);
+	}
+	btree_iterator_free(it);
+
+	return chkpNums;
+}
+
+/*
+ * The same as o_get_latest_chkp_num(), but looks into the hash table loaded
+ * by o_load_latest_chkp_nums().
+ */
+uint32
+o_lookup_latest_chkp_num(HTAB *chkpNums, Oid datoid, Oid relnode,
+						 uint32 max_chkp_num, bool *found)
+{
+	SharedRootInfoKey key;
+	ChkpNumTuple *entry;
+
+	if (datoid == SYS_TREES_DATOID)
+	{
+		if (found)
+			*found = true;
+		return max_chkp_num;
+	}
+
+	key.datoid = datoid;
+	key.relnode = relnode;
+	entry = (ChkpNumTuple *) hash_search(chkpNums, &key, HASH_FIND, NULL);
+	if (found)
+		*found = (entry != NULL);
+	if (entry == NULL)
+		return max_chkp_num;
+
+	return chkp_num_tuple_get_latest(entry, max_chkp_num);
+}
+
 void
 o_update_latest_chkp_num(Oid datoid, Oid relnode, uint32 chkp_num)
 {
@@ -1109,12 +1438,18 @@ o_perform_checkpoint(XLogRecPtr redo_pos, int flags)
 
 	chkp_tbl_arg.postProcessList = NIL;
 	chkp_tbl_arg.flags = flags;
+	chkp_tbl_arg.helpersNum = 0;
 
 	checkpoint_state->dirtyPagesEstimate = get_dirty_pages_count_sum();
 	checkpoint_state->dirtyPagesEstimate *= (1.0 + CheckPointCompletionTarget
 											 * o_checkpoint_completion_ratio);
 	checkpoint_state->pagesWritten = 0;
 	checkpoint_state->toastConsistentPtr = InvalidXLogRecPtr;
+	pg_atomic_write_u32(&checkpoint_state->progressTreesDone, 0);
+	pg_atomic_write_u64(&checkpoint_state->progressPagesWritten, 0);
+	pg_atomic_write_u64(&checkpoint_state->progressBytesWritten, 0);
+	pg_write_barrier();
+	checkpoint_state->progressStartTime = GetCurrentTimestamp();
 
 	old_enable_stopevents = enable_stopevents;
 
@@ -1124,7 +1459,7 @@ o_perform_checkpoint(XLogRecPtr redo_pos, int flags)
 	enable_stopevents = false;
 
 	checkpoint_xmin = pg_atomic_read_u64(&xid_meta->runXmin);
-	pg_atomic_write_u64(&my_proc_info->xmin, checkpoint_xmin);
+	pg_atomic_write_u64(&oProcXmins[MYPROCNUMBER], checkpoint_xmin);
 	for (i = 0; i < (int) UndoLogsCount; i++)
 	{
 		UndoMeta   *undo_meta = get_undo_meta_by_type((UndoLogType) i);
@@ -1161,11 +1496,16 @@ o_perform_checkpoint(XLogRecPtr redo_pos, int flags)
 
 	enable_stopevents = old_enable_stopevents;
 
+	chkp_tbl_arg.helpersNum = checkpoint_helpers_start(flags);
+
 	LWLockAcquire(&checkpoint_state->oTablesMetaLock, LW_EXCLUSIVE);
 	o_indices_foreach_oids(checkpoint_tables_callback, &chkp_tbl_arg);
 
 	LWLockRelease(&checkpoint_state->oTablesMetaLock);
 
+	if (chkp_tbl_arg.helpersNum > 0)
+		checkpoint_helpers_stop(&chkp_tbl_arg);
+
 	checkpoint_chkp_nums(flags, cur_chkp_num, &chkp_tbl_arg);
 
 	/*
@@ -1273,6 +1613,19 @@ o_perform_checkpoint(XLogRecPtr redo_pos, int flags)
 	checkpoint_state->reloid = InvalidOid;
 	checkpoint_state->relnode = InvalidOid;
 	checkpoint_state->completed = false;
+	for (i = 0; i < checkpoint_workers; i++)
+	{
+		CheckpointState *state = GET_CHECKPOINT_HELPER_STATE(i);
+
+		chkp_inc_changecount_before(state);
+		state->treeType = oIndexInvalid;
+		state->datoid = InvalidOid;
+		state->reloid = InvalidOid;
+		state->relnode = InvalidOid;
+		state->completed = false;
+		state->curKeyType = CurKeyFinished;
+		chkp_inc_changecount_after(state);
+	}
 	chkp_inc_changecount_after(checkpoint_state);
 
 	LWLockRelease(&checkpoint_state->oTablesMetaLock);
@@ -1302,7 +1655,7 @@ o_perform_checkpoint(XLogRecPtr redo_pos, int flags)
 	for (i = 0; i < (int) UndoLogsCount; i++)
 		pg_atomic_write_u64(&my_proc_info->undoRetainLocations[i].snapshotRetainUndoLocation, InvalidUndoLocation);
 
-	pg_atomic_write_u64(&my_proc_info->xmin, InvalidOXid);
+	pg_atomic_write_u64(&oProcXmins[MYPROCNUMBER], InvalidOXid);
 
 	/*
 	 * Now we can free extents for compressed indices
@@ -1373,7 +1726,16 @@ o_perform_checkpoint(XLogRecPtr redo_pos, int flags)
 	if (remove_old_checkpoint_files)
 		unlink_xids_file(prev_chkp_num);
 
+	/*
+	 * Unlink the files of all the trees dropped so far.  The relnodes could
+	 * be reused once PostgreSQL removes its files after the checkpoint.
+	 */
+	check_pending_truncates(true);
+
 	CheckPointProgress = o_checkpoint_completion_ratio;
+	checkpoint_state->progressStartTime = 0;
+
+	buffer_warmup_save(checkpoint_state->lastCheckpointNumber);
 
 	o_unset_syscache_hooks();
 
@@ -1449,14 +1811,19 @@ checkpoint_init_new_seq_bufs(BTreeDescr *descr, int chkpNum)
 
 /*
  * Make checkpoint of an temporary index.
+ *
+ * Contents of temporary trees don't survive the restart, so there is no
+ * image to write.  We only switch the tree to the next checkpoint number
+ * and finalize its free extents.  Dirty pages stay in memory until evicted
+ * or dropped together with the tree.  That is the common fate of the
+ * temporary tables, so writing them here would be a waste of I/O.
  */
 static void
-checkpoint_temporary_tree(int flags, BTreeDescr *descr)
+checkpoint_temporary_tree(int flags, BTreeDescr *descr, CheckpointState *state)
 {
 	BTreeMetaPage *meta_page;
 	uint32		chkp_num = checkpoint_state->lastCheckpointNumber + 1;
 	int			cur_chkp_index = chkp_num % 2;
-	CheckpointWriteBack writeback;
 
 	Assert(!OCompressIsValid(descr->compress));
 
@@ -1465,15 +1832,6 @@ checkpoint_temporary_tree(int flags, BTreeDescr *descr)
 
 	Assert(ORootPageIsValid(descr) && OMetaPageIsValid(descr));
 
-	/* Make checkpoint of the tree itself */
-	init_writeback(&writeback, flags, false);
-	(void) checkpoint_btree(&descr, checkpoint_state, &writeback);
-	(void) perform_writeback_and_relock(descr, &writeback,
-										checkpoint_state, NULL, 0);
-	free_writeback(&writeback);
-
-	Assert(checkpoint_state->curKeyType == CurKeyGreatest);
-
 	STOPEVENT(STOPEVENT_BEFORE_BLKNO_LOCK, NULL);
 
 	/*
@@ -1482,9 +1840,9 @@ checkpoint_temporary_tree(int flags, BTreeDescr *descr)
 	 * details.
 	 */
 	LWLockAcquire(&meta_page->copyBlknoLock, LW_EXCLUSIVE);
-	chkp_inc_changecount_before(checkpoint_state);
-	checkpoint_state->curKeyType = CurKeyFinished;
-	chkp_inc_changecount_after(checkpoint_state);
+	chkp_inc_changecount_before(state);
+	state->curKeyType = CurKeyFinished;
+	chkp_inc_changecount_after(state);
 	LWLockRelease(&meta_page->copyBlknoLock);
 
 	if (!orioledb_s3_mode)
@@ -1494,9 +1852,9 @@ checkpoint_temporary_tree(int flags, BTreeDescr *descr)
 		free_seq_buf_pages(descr, descr->tmpBuf[cur_chkp_index].shared);
 	}
 
-	chkp_inc_changecount_before(checkpoint_state);
-	checkpoint_state->completed = true;
-	chkp_inc_changecount_after(checkpoint_state);
+	chkp_inc_changecount_before(state);
+	state->completed = true;
+	chkp_inc_changecount_after(state);
 }
 
 /*
@@ -1684,37 +2042,6 @@ finalize_chkp_map(File chkp_file, uint64 len, char *input_filename,
 	return len;
 }
 
-/*
- * Comparator for sort ascending.
- */
-static int
-uint32_offsets_cmp(const void *a, const void *b)
-{
-	uint32		val1 = *(uint32 *) a;
-	uint32		val2 = *(uint32 *) b;
-
-	if (val1 != val2)
-		return val1 > val2 ? 1 : -1;
-	return 0;
-}
-
-/*
- * Comparator for FileExtent.len sort descending.
- */
-static int
-file_extents_len_off_cmp(const void *a, const void *b)
-{
-	FileExtent *val1 = (FileExtent *) a;
-	FileExtent *val2 = (FileExtent *) b;
-
-	if (val1->len != val2->len)
-		return val1->len > val2->len ? -1 : 1;
-	else if (val1->off != val2->off)
-		return val1->off > val2->off ? 1 : -1;
-
-	return 0;
-}
-
 /*
  * Comparator for FileExtent.off sort ascending.
  */
@@ -1760,14 +2087,12 @@ file_extents_writeback_cmp(const void *a, const void *b)
 static void
 sort_checkpoint_map_file(BTreeDescr *descr, int cur_chkp_index)
 {
-	Pointer		free_blocks;
 	uint64		free_blocks_size;
 	File		file;
 	char	   *filename;
 	CheckpointFileHeader header = {0};
 	bool		ferror = false,
 				is_compressed = OCompressIsValid(descr->compress);
-	int			read_size;
 
 	filename = get_seq_buf_filename(&descr->nextChkp[cur_chkp_index].tag);
 	file = PathNameOpenFile(filename, O_RDWR | PG_BINARY);
@@ -1778,7 +2103,7 @@ sort_checkpoint_map_file(BTreeDescr *descr, int cur_chkp_index)
 							   filename)));
 	}
 
-	/* reads header and blocks from map file */
+	/* reads header from map file */
 	ferror = OFileRead(file, (Pointer) &header,
 					   sizeof(header), 0, WAIT_EVENT_DATA_FILE_READ) != sizeof(header);
 	if (ferror)
@@ -1797,30 +2122,11 @@ sort_checkpoint_map_file(BTreeDescr *descr, int cur_chkp_index)
 		free_blocks_size = sizeof(uint32) * header.numFreeBlocks;
 	}
 
-	free_blocks = palloc(free_blocks_size);
-	if (free_blocks_size > 0)
-	{
-		read_size = OFileRead(file, (Pointer) free_blocks, free_blocks_size,
-							  sizeof(header), WAIT_EVENT_DATA_FILE_READ);
-
-		if (read_size != free_blocks_size)
-		{
-			ereport(FATAL, (errcode_for_file_access(),
-							errmsg("Could not read data from checkpoint map file: %s",
-								   filename)));
-		}
-	}
-
-	/* sorts blocks */
-	if (is_compressed || use_device)
-		pg_qsort(free_blocks, header.numFreeBlocks, sizeof(FileExtent), file_extents_len_off_cmp);
-	else
-		pg_qsort(free_blocks, header.numFreeBlocks, sizeof(uint32), uint32_offsets_cmp);
+	/* sorts blocks in the map file */
+	sort_extents_file(file, sizeof(header), free_blocks_size,
+					  is_compressed || use_device);
 
-	/* writes sorted blocks to map file. */
-	if (OFileWrite(file, (Pointer) free_blocks, free_blocks_size,
-				   sizeof(header), WAIT_EVENT_DATA_FILE_WRITE) != free_blocks_size ||
-		FileSync(file, WAIT_EVENT_SLRU_SYNC) != 0)
+	if (FileSync(file, WAIT_EVENT_SLRU_SYNC) != 0)
 	{
 		ereport(FATAL, (errcode_for_file_access(),
 						errmsg("Could not write sorted data to checkpoint map file: %s",
@@ -1828,7 +2134,6 @@ sort_checkpoint_map_file(BTreeDescr *descr, int cur_chkp_index)
 	}
 	FileClose(file);
 	pfree(filename);
-	pfree(free_blocks);
 }
 
 /*
@@ -1837,12 +2142,9 @@ sort_checkpoint_map_file(BTreeDescr *descr, int cur_chkp_index)
 static void
 sort_checkpoint_tmp_file(BTreeDescr *descr, int cur_chkp_index)
 {
-	Pointer		free_blocks;
-	uint64		free_blocks_size;
 	File		file;
 	char	   *filename;
 	bool		is_compressed = OCompressIsValid(descr->compress);
-	int			read_size;
 
 	filename = get_seq_buf_filename(&descr->tmpBuf[cur_chkp_index].tag);
 	file = PathNameOpenFile(filename, O_RDWR | PG_BINARY);
@@ -1854,37 +2156,10 @@ sort_checkpoint_tmp_file(BTreeDescr *descr, int cur_chkp_index)
 		return;
 	}
 
-	free_blocks_size = FileSize(file);
-	free_blocks = palloc(free_blocks_size);
-
-	if (free_blocks_size > 0)
-	{
-		read_size = OFileRead(file, (Pointer) free_blocks,
-							  free_blocks_size, 0, WAIT_EVENT_DATA_FILE_READ);
-		if (read_size != free_blocks_size)
-		{
-			ereport(FATAL, (errcode_for_file_access(),
-							errmsg("Could not read data from checkpoint tmp file: %s %d %lu",
-								   filename, read_size, free_blocks_size)));
-		}
-	}
-
-	/* sorts blocks */
-	if (is_compressed || use_device)
-	{
-		pg_qsort(free_blocks, free_blocks_size / sizeof(FileExtent),
-				 sizeof(FileExtent), file_extents_len_off_cmp);
-	}
-	else
-	{
-		pg_qsort(free_blocks, free_blocks_size / sizeof(uint32),
-				 sizeof(uint32), uint32_offsets_cmp);
-	}
+	/* sorts blocks in the tmp file */
+	sort_extents_file(file, 0, FileSize(file), is_compressed || use_device);
 
-	/* writes sorted blocks to tmp file */
-	if (OFileWrite(file, (Pointer) free_blocks,
-				   free_blocks_size, 0, WAIT_EVENT_DATA_FILE_WRITE) != free_blocks_size ||
-		FileSync(file, WAIT_EVENT_SLRU_SYNC) != 0)
+	if (FileSync(file, WAIT_EVENT_SLRU_SYNC) != 0)
 	{
 		ereport(FATAL, (errcode_for_file_access(),
 						errmsg("Could not write sorted data to checkpoint tmp file: %s",
@@ -1893,20 +2168,19 @@ sort_checkpoint_tmp_file(BTreeDescr *descr, int cur_chkp_index)
 
 	FileClose(file);
 	pfree(filename);
-	pfree(free_blocks);
 }
 
 static inline void
 checkpoint_ix_init_state(CheckpointState *state, BTreeDescr *descr)
 {
-	chkp_inc_changecount_before(checkpoint_state);
-	checkpoint_state->treeType = descr->type;
-	checkpoint_state->datoid = descr->oids.datoid;
-	checkpoint_state->reloid = descr->oids.reloid;
-	checkpoint_state->relnode = descr->oids.relnode;
-	checkpoint_state->completed = false;
-	checkpoint_state->curKeyType = CurKeyLeast;
-	chkp_inc_changecount_after(checkpoint_state);
+	chkp_inc_changecount_before(state);
+	state->treeType = descr->type;
+	state->datoid = descr->oids.datoid;
+	state->reloid = descr->oids.reloid;
+	state->relnode = descr->oids.relnode;
+	state->completed = false;
+	state->curKeyType = CurKeyLeast;
+	chkp_inc_changecount_after(state);
 }
 
 /*
@@ -1959,53 +2233,142 @@ free_extent_for_checkpoint(BTreeDescr *desc, FileExtent *extent, uint32 chkp_num
 }
 
 /*
- * Returns true if page with given page number is under in-progress
- * checkpointing.
+ * Returns the state of the checkpoint helper processing the given tree or
+ * checkpoint_state if there is no such helper.  Helpers are assigned to the
+ * trees within the checkpoint_state change count section, so the caller must
+ * recheck the checkpoint_state change count after reading the result.
  */
-bool
-page_is_under_checkpoint(BTreeDescr *desc, OInMemoryBlkno blkno,
-						 bool includingHikeyBlkno)
+static CheckpointState *
+get_tree_checkpoint_state(OIndexType type, Oid datoid, Oid relnode)
 {
-	Page		p = O_GET_IN_MEMORY_PAGE(blkno);
-	Oid			datoid,
-				relnode;
-	int			level = PAGE_GET_LEVEL(p),
-				before_changecount,
-				after_changecount;
-	CurKeyType	cur_key;
-	OInMemoryBlkno blkno_on_checkpoint;
-	OInMemoryBlkno hikey_blkno_on_checkpoint;
-	OIndexType	type;
-	bool		result;
+	int			i;
 
-	while (true)
+	for (i = 0; i < checkpoint_workers; i++)
 	{
-		chkp_save_changecount_before(checkpoint_state, before_changecount);
-		if (before_changecount & 1)
-			continue;
+		CheckpointState *state = GET_CHECKPOINT_HELPER_STATE(i);
 
-		type = checkpoint_state->treeType;
-		datoid = checkpoint_state->datoid;
-		relnode = checkpoint_state->relnode;
-		blkno_on_checkpoint = checkpoint_state->stack[level].blkno;
-		hikey_blkno_on_checkpoint = checkpoint_state->stack[level].hikeyBlkno;
-		cur_key = checkpoint_state->curKeyType;
+		if (state->treeType == type &&
+			state->datoid == datoid &&
+			state->relnode == relnode)
+			return state;
+	}
+	return checkpoint_state;
+}
 
-		chkp_save_changecount_after(checkpoint_state, after_changecount);
-		if (before_changecount != after_changecount)
-			continue;
+/*
+ * Checks that neither the tree state nor the assignment of trees to the
+ * checkpoint helpers has changed since the change counts were saved.
+ */
+static inline bool
+tree_checkpoint_state_is_stable(CheckpointState *state,
+								int before_changecount,
+								int main_before_changecount)
+{
+	int			after_changecount;
 
-		if (desc->oids.datoid != datoid ||
-			desc->oids.relnode != relnode ||
-			desc->type != type)
-		{
-			/* BTree is not under checkpoint */
-			result = false;
-		}
-		else if (cur_key == CurKeyFinished)
-		{
-			/* checkpoint already finished */
-			result = false;
+	chkp_save_changecount_after(state, after_changecount);
+	if (before_changecount != after_changecount)
+		return false;
+
+	chkp_save_changecount_after(checkpoint_state, after_changecount);
+	return main_before_changecount == after_changecount;
+}
+
+/*
+ * Returns true if the checkpoint of the tree is started but doesn't reach
+ * CurKeyFinished yet.  The caller must hold the tree copyBlknoLock.
+ */
+bool
+tree_checkpoint_unfinished(BTreeDescr *desc)
+{
+	CheckpointState *state;
+
+	state = get_tree_checkpoint_state(desc->type, desc->oids.datoid,
+									  desc->oids.relnode);
+
+	return state->treeType == desc->type &&
+		state->datoid == desc->oids.datoid &&
+		state->relnode == desc->oids.relnode &&
+		state->curKeyType != CurKeyFinished;
+}
+
+/*
+ * Moves the page of the checkpoint stack to the new block number on split or
+ * merge.  This change is atomic, no need to bother about change count.
+ */
+void
+checkpoint_move_hikey_blkno(int level, OInMemoryBlkno blkno,
+							OInMemoryBlkno newBlkno)
+{
+	int			i;
+
+	for (i = -1; i < checkpoint_workers; i++)
+	{
+		CheckpointState *state = (i < 0) ? checkpoint_state :
+			GET_CHECKPOINT_HELPER_STATE(i);
+
+		Assert(state->stack[level].hikeyBlkno != newBlkno);
+		if (state->stack[level].hikeyBlkno == blkno)
+			state->stack[level].hikeyBlkno = newBlkno;
+	}
+}
+
+/*
+ * Returns true if page with given page number is under in-progress
+ * checkpointing.
+ */
+bool
+page_is_under_checkpoint(BTreeDescr *desc, OInMemoryBlkno blkno,
+						 bool includingHikeyBlkno)
+{
+	Page		p = O_GET_IN_MEMORY_PAGE(blkno);
+	Oid			datoid,
+				relnode;
+	int			level = PAGE_GET_LEVEL(p),
+				main_changecount,
+				before_changecount;
+	CurKeyType	cur_key;
+	OInMemoryBlkno blkno_on_checkpoint;
+	OInMemoryBlkno hikey_blkno_on_checkpoint;
+	OIndexType	type;
+	CheckpointState *state;
+	bool		result;
+
+	while (true)
+	{
+		chkp_save_changecount_before(checkpoint_state, main_changecount);
+		if (main_changecount & 1)
+			continue;
+
+		state = get_tree_checkpoint_state(desc->type, desc->oids.datoid,
+										  desc->oids.relnode);
+
+		chkp_save_changecount_before(state, before_changecount);
+		if (before_changecount & 1)
+			continue;
+
+		type = state->treeType;
+		datoid = state->datoid;
+		relnode = state->relnode;
+		blkno_on_checkpoint = state->stack[level].blkno;
+		hikey_blkno_on_checkpoint = state->stack[level].hikeyBlkno;
+		cur_key = state->curKeyType;
+
+		if (!tree_checkpoint_state_is_stable(state, before_changecount,
+											 main_changecount))
+			continue;
+
+		if (desc->oids.datoid != datoid ||
+			desc->oids.relnode != relnode ||
+			desc->type != type)
+		{
+			/* BTree is not under checkpoint */
+			result = false;
+		}
+		else if (cur_key == CurKeyFinished)
+		{
+			/* checkpoint already finished */
+			result = false;
 		}
 		else if (blkno_on_checkpoint == blkno ||
 				 (includingHikeyBlkno && hikey_blkno_on_checkpoint == blkno))
@@ -2025,8 +2388,8 @@ page_is_under_checkpoint(BTreeDescr *desc, OInMemoryBlkno blkno,
 			result = false;
 		}
 
-		chkp_save_changecount_after(checkpoint_state, after_changecount);
-		if (before_changecount != after_changecount)
+		if (!tree_checkpoint_state_is_stable(state, before_changecount,
+											 main_changecount))
 			continue;
 
 		return result;
@@ -2041,23 +2404,31 @@ tree_is_under_checkpoint(BTreeDescr *desc)
 {
 	Oid			datoid,
 				relnode;
-	int			before_changecount,
-				after_changecount;
+	int			main_changecount,
+				before_changecount;
 	OIndexType	type;
+	CheckpointState *state;
 	bool		result;
 
 	while (true)
 	{
-		chkp_save_changecount_before(checkpoint_state, before_changecount);
+		chkp_save_changecount_before(checkpoint_state, main_changecount);
+		if (main_changecount & 1)
+			continue;
+
+		state = get_tree_checkpoint_state(desc->type, desc->oids.datoid,
+										  desc->oids.relnode);
+
+		chkp_save_changecount_before(state, before_changecount);
 		if (before_changecount & 1)
 			continue;
 
-		type = checkpoint_state->treeType;
-		datoid = checkpoint_state->datoid;
-		relnode = checkpoint_state->relnode;
+		type = state->treeType;
+		datoid = state->datoid;
+		relnode = state->relnode;
 
-		chkp_save_changecount_after(checkpoint_state, after_changecount);
-		if (before_changecount != after_changecount)
+		if (!tree_checkpoint_state_is_stable(state, before_changecount,
+											 main_changecount))
 			continue;
 
 		if (desc->oids.datoid != datoid ||
@@ -2072,8 +2443,8 @@ tree_is_under_checkpoint(BTreeDescr *desc)
 			result = true;
 		}
 
-		chkp_save_changecount_after(checkpoint_state, after_changecount);
-		if (before_changecount != after_changecount)
+		if (!tree_checkpoint_state_is_stable(state, before_changecount,
+											 main_changecount))
 			continue;
 
 		return result;
@@ -2208,32 +2579,40 @@ get_checkpoint_number(BTreeDescr *desc, OInMemoryBlkno blkno,
 	Oid			datoid,
 				relnode;
 	int			level = PAGE_GET_LEVEL(page),
+				main_changecount,
 				before_changecount,
-				after_changecount,
 				cmp;
 	uint32		last_checkpoint_number;
 	OInMemoryBlkno chkp_lvl_blkno,
 				chkp_lvl_hikey_blkno;
 	OIndexType	type;
+	CheckpointState *state;
 	bool		under_checkpoint;
 
 	while (true)
 	{
-		chkp_save_changecount_before(checkpoint_state, before_changecount);
-		if ((before_changecount & 1) != 0)
+		chkp_save_changecount_before(checkpoint_state, main_changecount);
+		if ((main_changecount & 1) != 0)
 			continue;
 
 		last_checkpoint_number = checkpoint_state->lastCheckpointNumber;
-		type = checkpoint_state->treeType;
-		datoid = checkpoint_state->datoid;
-		relnode = checkpoint_state->relnode;
-		chkp_lvl_blkno = checkpoint_state->stack[level].blkno;
-		chkp_lvl_hikey_blkno = checkpoint_state->stack[level].hikeyBlkno;
-		bound = checkpoint_state->stack[level].bound;
-		cur_key_type = checkpoint_state->curKeyType;
-
-		chkp_save_changecount_after(checkpoint_state, after_changecount);
-		if (before_changecount != after_changecount)
+		state = get_tree_checkpoint_state(desc->type, desc->oids.datoid,
+										  desc->oids.relnode);
+
+		chkp_save_changecount_before(state, before_changecount);
+		if ((before_changecount & 1) != 0)
+			continue;
+
+		type = state->treeType;
+		datoid = state->datoid;
+		relnode = state->relnode;
+		chkp_lvl_blkno = state->stack[level].blkno;
+		chkp_lvl_hikey_blkno = state->stack[level].hikeyBlkno;
+		bound = state->stack[level].bound;
+		cur_key_type = state->curKeyType;
+
+		if (!tree_checkpoint_state_is_stable(state, before_changecount,
+											 main_changecount))
 			continue;
 
 		cmp = chkp_ordering_cmp(desc->type, desc->oids.datoid,
@@ -2256,8 +2635,8 @@ get_checkpoint_number(BTreeDescr *desc, OInMemoryBlkno blkno,
 				*copy_blkno = false;
 			}
 
-			chkp_save_changecount_after(checkpoint_state, after_changecount);
-			if (before_changecount != after_changecount)
+			if (!tree_checkpoint_state_is_stable(state, before_changecount,
+												 main_changecount))
 				continue;
 
 			return true;
@@ -2281,8 +2660,8 @@ get_checkpoint_number(BTreeDescr *desc, OInMemoryBlkno blkno,
 		 */
 		if (under_checkpoint)
 		{
-			chkp_save_changecount_after(checkpoint_state, after_changecount);
-			if (before_changecount != after_changecount)
+			if (!tree_checkpoint_state_is_stable(state, before_changecount,
+												 main_changecount))
 				continue;
 			return false;
 		}
@@ -2296,28 +2675,28 @@ get_checkpoint_number(BTreeDescr *desc, OInMemoryBlkno blkno,
 				*checkpoint_number = last_checkpoint_number + 2;
 			*copy_blkno = false;
 
-			chkp_save_changecount_after(checkpoint_state, after_changecount);
-			if (before_changecount != after_changecount)
+			if (!tree_checkpoint_state_is_stable(state, before_changecount,
+												 main_changecount))
 				continue;
 
 			return true;
 		}
 
 		if (cur_key_type == CurKeyValue)
-			copy_from_fixed_shmem_key(&cur_key, &checkpoint_state->curKeyValue);
+			copy_from_fixed_shmem_key(&cur_key, &state->curKeyValue);
 
 		if (bound == CheckpointBoundHikey)
-			copy_from_fixed_shmem_key(&lvl_hikey, &checkpoint_state->stack[level].hikey);
+			copy_from_fixed_shmem_key(&lvl_hikey, &state->stack[level].hikey);
 
-		chkp_save_changecount_after(checkpoint_state, after_changecount);
-		if (before_changecount != after_changecount)
+		if (!tree_checkpoint_state_is_stable(state, before_changecount,
+											 main_changecount))
 			continue;
 
 		cmp = side_of_checkpoint_bound(desc, page, cur_key.tuple, cur_key_type,
 									   lvl_hikey.tuple, bound);
 
-		chkp_save_changecount_after(checkpoint_state, after_changecount);
-		if (before_changecount != after_changecount)
+		if (!tree_checkpoint_state_is_stable(state, before_changecount,
+											 main_changecount))
 			continue;
 
 		if (cmp > 0)
@@ -2341,13 +2720,17 @@ get_checkpoint_number(BTreeDescr *desc, OInMemoryBlkno blkno,
  * Sets the autonomous level by backend. It should not be called for leafs.
  */
 void
-backend_set_autonomous_level(CheckpointState *state, uint32 level)
+backend_set_autonomous_level(BTreeDescr *desc, uint32 level)
 {
+	CheckpointState *state;
 	uint32		cur_level = ORIOLEDB_MAX_DEPTH;
 
 	/* no sense in autonomous level for leafs */
 	Assert(level != 0);
 
+	state = get_tree_checkpoint_state(desc->type, desc->oids.datoid,
+									  desc->oids.relnode);
+
 	/*
 	 * setups a new autonomous level if it less than current value of
 	 * state->autonomousLevel
@@ -2365,7 +2748,7 @@ backend_set_autonomous_level(CheckpointState *state, uint32 level)
  * Make checkpoint of an index.
  */
 static bool
-checkpoint_ix(int flags, BTreeDescr *descr)
+checkpoint_ix(int flags, BTreeDescr *descr, CheckpointState *state)
 {
 	FileExtentsArray *free_extents = NULL;
 	char	   *filename,
@@ -2389,21 +2772,32 @@ checkpoint_ix(int flags, BTreeDescr *descr)
 	meta_page = BTREE_GET_META(descr);
 	meta_page->dirtyFlag1 = false;
 
+	/*
+	 * Clean subtrees can be skipped only if the marks of modified subtrees
+	 * are reliable: none of them is lost, and the previous walk of the tree
+	 * wasn't interrupted.
+	 */
+	skip_clean_subtrees = skip_unmodified_subtrees && !orioledb_s3_mode &&
+		pg_atomic_exchange_u32(&meta_page->subtreeDirtyUnknown, 0) == 0 &&
+		!meta_page->subtreeWalkActive;
+	meta_page->subtreeWalkActive = true;
+
 	/* Make checkpoint of the tree itself */
 	init_writeback(&writeback, flags, is_compressed);
-	root_downlink = checkpoint_btree(&descr, checkpoint_state, &writeback);
+	root_downlink = checkpoint_btree(&descr, state, &writeback);
+	skip_clean_subtrees = false;
 	if (!DiskDownlinkIsValid(root_downlink))
 	{
 		free_writeback(&writeback);
 		return false;
 	}
-	descr = perform_writeback_and_relock(descr, &writeback,
-										 checkpoint_state, NULL, 0);
+	descr = perform_writeback_and_relock(descr, &writeback, state, NULL, 0);
 	free_writeback(&writeback);
 	if (!descr)
 		return false;
+	BTREE_GET_META(descr)->subtreeWalkActive = false;
 
-	Assert(checkpoint_state->curKeyType == CurKeyGreatest);
+	Assert(state->curKeyType == CurKeyGreatest);
 	Assert(DiskDownlinkIsValid(root_downlink));
 
 	if (!use_device)
@@ -2439,9 +2833,9 @@ checkpoint_ix(int flags, BTreeDescr *descr)
 	 */
 	LWLockAcquire(&meta_page->copyBlknoLock, LW_EXCLUSIVE);
 
-	chkp_inc_changecount_before(checkpoint_state);
-	checkpoint_state->curKeyType = CurKeyFinished;
-	chkp_inc_changecount_after(checkpoint_state);
+	chkp_inc_changecount_before(state);
+	state->curKeyType = CurKeyFinished;
+	chkp_inc_changecount_after(state);
 
 	/* Make header for the map file... */
 	header.rootDownlink = root_downlink;
@@ -2668,10 +3062,10 @@ checkpoint_ix(int flags, BTreeDescr *descr)
 		maxLocation = Max(maxLocation, location);
 	}
 
-	chkp_inc_changecount_before(checkpoint_state);
-	checkpoint_state->completed = true;
+	chkp_inc_changecount_before(state);
+	state->completed = true;
 	BTREE_GET_META(descr)->dirtyFlag2 = false;
-	chkp_inc_changecount_after(checkpoint_state);
+	chkp_inc_changecount_after(state);
 
 	if (!IS_SYS_TREE_OIDS(descr->oids))
 		o_update_latest_chkp_num(descr->oids.datoid,
@@ -3441,6 +3835,13 @@ checkpoint_btree_loop(BTreeDescr **descrPtr,
 			}
 			/* else level != 0 */
 
+			/*
+			 * The walk below sees the modifications of the subtree marked so
+			 * far.  Pairs with the barrier in btree_mark_subtree_dirty().
+			 */
+			pg_atomic_write_u32(&O_GET_IN_MEMORY_PAGEDESC(blkno)->subtreeDirty, 0);
+			pg_memory_barrier();
+
 			if (BTREE_PAGE_ITEMS_COUNT(img) == 0)
 			{
 				memset(img, 0, ORIOLEDB_BLCKSZ);
@@ -3935,6 +4336,94 @@ autonomous_stack_flush_to_disk(BTreeDescr *descr, CheckpointState *state,
 	}
 }
 
+/*
+ * Advances the current checkpoint key past the downlink at the given
+ * location.  Should be called within the state change count section.
+ */
+static void
+checkpoint_pass_downlink(BTreeDescr *descr, CheckpointState *state, int level,
+						 Page page, BTreePageItemLocator *loc)
+{
+	BTreePageItemLocator nextLoc = *loc;
+
+	BTREE_PAGE_LOCATOR_NEXT(page, &nextLoc);
+	if (BTREE_PAGE_LOCATOR_IS_VALID(page, &nextLoc) || !O_PAGE_IS(page, RIGHTMOST))
+	{
+		state->curKeyType = CurKeyValue;
+		if (BTREE_PAGE_LOCATOR_IS_VALID(page, &nextLoc))
+			copy_fixed_shmem_page_key(descr, &state->curKeyValue, page,
+									  &nextLoc);
+		else
+			copy_fixed_shmem_hikey(descr, &state->curKeyValue, page);
+
+		update_lowest_level_hikey(descr, state, level,
+								  fixed_shmem_key_get_tuple(&state->curKeyValue));
+	}
+	else
+	{
+		OTuple		nullTup;
+
+		state->curKeyType = CurKeyGreatest;
+		O_TUPLE_SET_NULL(nullTup);
+		update_lowest_level_hikey(descr, state, level, nullTup);
+	}
+}
+
+/*
+ * Tries to pass the internal child page referenced by the in-memory downlink
+ * as it was on disk.  That's possible when neither the child is dirty nor any
+ * page of its subtree is modified since the checkpointer descended into the
+ * child last time.  Then the previous image of the child is still valid and
+ * references valid images of its subtree.
+ *
+ * The page holding the downlink must be locked, that prevents the concurrent
+ * eviction of the child.  Returns true if the child is passed.
+ */
+static bool
+checkpoint_try_skip_subtree(BTreeDescr *descr, CheckpointState *state,
+							int level, Page page, BTreePageItemLocator *loc,
+							uint64 downlink)
+{
+	OInMemoryBlkno child_blkno = DOWNLINK_GET_IN_MEMORY_BLKNO(downlink);
+	OrioleDBPageDesc *child_desc = O_GET_IN_MEMORY_PAGEDESC(child_blkno);
+	Page		child = O_GET_IN_MEMORY_PAGE(child_blkno);
+	bool		clean;
+
+	/* Leaves are handled by the walk itself */
+	if (!skip_clean_subtrees || level < 2 ||
+		state->stack[level].autonomous ||
+		state->stack[level - 1].autonomous ||
+		BTREE_PAGE_ITEMS_COUNT(state->stack[level - 1].image) > 0)
+		return false;
+
+	if (O_PAGE_GET_CHANGE_COUNT(child) != DOWNLINK_GET_IN_MEMORY_CHANGECOUNT(downlink) ||
+		!FileExtentIsValid(child_desc->fileExtent) ||
+		child_desc->ionum >= 0 ||
+		RightLinkIsValid(BTREE_PAGE_GET_RIGHTLINK(child)) ||
+		O_PAGE_IS(child, BROKEN_SPLIT))
+		return false;
+
+	if (IS_DIRTY(child_blkno) ||
+		pg_atomic_read_u32(&child_desc->subtreeDirty) != 0)
+		return false;
+
+	/*
+	 * Recheck after advertising the change of the checkpoint state.  So,
+	 * either the modification of the subtree is visible here, or the pages
+	 * modified are going to be treated as passed by the checkpoint.  Pairs
+	 * with the barrier in btree_mark_subtree_dirty().
+	 */
+	chkp_inc_changecount_before(state);
+	pg_memory_barrier();
+	clean = !IS_DIRTY(child_blkno) &&
+		pg_atomic_read_u32(&child_desc->subtreeDirty) == 0 &&
+		pg_atomic_read_u32(&BTREE_GET_META(descr)->subtreeDirtyUnknown) == 0;
+	if (clean)
+		checkpoint_pass_downlink(descr, state, level, page, loc);
+	chkp_inc_changecount_after(state);
+
+	return clean;
+}
 
 static void
 checkpoint_internal_pass(BTreeDescr *descr, CheckpointState *state,
@@ -4151,7 +4640,23 @@ checkpoint_internal_pass(BTreeDescr *descr, CheckpointState *state,
 			state->stack[level].autonomousTupleExist = false;
 		}
 
-		if (DOWNLINK_IS_IN_MEMORY(downlink))
+		if (DOWNLINK_IS_IN_MEMORY(downlink) &&
+			checkpoint_try_skip_subtree(descr, state, level, page, &loc,
+										downlink))
+		{
+			BTreePageItemLocator imgLastLoc;
+			BTreeNonLeafTuphdr *imgTuphdr;
+			OrioleDBPageDesc *child_desc = O_GET_IN_MEMORY_PAGEDESC(DOWNLINK_GET_IN_MEMORY_BLKNO(downlink));
+
+			/* reference the previous image of the subtree */
+			BTREE_PAGE_LOCATOR_LAST(img, &imgLastLoc);
+			imgTuphdr = (BTreeNonLeafTuphdr *) BTREE_PAGE_LOCATOR_GET_ITEM(img, &imgLastLoc);
+			imgTuphdr->downlink = MAKE_ON_DISK_DOWNLINK(child_desc->fileExtent);
+
+			state->stack[level].nextkeyType = NextKeyNone;
+			BTREE_PAGE_LOCATOR_NEXT(page, &loc);
+		}
+		else if (DOWNLINK_IS_IN_MEMORY(downlink))
 		{
 			BTreePageItemLocator nextLoc = loc;
 
@@ -4204,8 +4709,7 @@ checkpoint_internal_pass(BTreeDescr *descr, CheckpointState *state,
 		}
 		else if (DOWNLINK_IS_ON_DISK(downlink))
 		{
-			BTreePageItemLocator nextLoc,
-						imgLastLoc;
+			BTreePageItemLocator imgLastLoc;
 
 			/* copy internal header with downlink */
 			BTREE_PAGE_LOCATOR_LAST(img, &imgLastLoc);
@@ -4254,33 +4758,9 @@ checkpoint_internal_pass(BTreeDescr *descr, CheckpointState *state,
 			 * Page is already on the disk, but we have to advance current key
 			 * ourselves...
 			 */
-			nextLoc = loc;
-			BTREE_PAGE_LOCATOR_NEXT(page, &nextLoc);
-			if (BTREE_PAGE_LOCATOR_IS_VALID(page, &nextLoc) || !O_PAGE_IS(page, RIGHTMOST))
-			{
-				chkp_inc_changecount_before(state);
-				state->curKeyType = CurKeyValue;
-				if (BTREE_PAGE_LOCATOR_IS_VALID(page, &nextLoc))
-					copy_fixed_shmem_page_key(descr, &state->curKeyValue, page,
-											  &nextLoc);
-				else
-					copy_fixed_shmem_hikey(descr, &state->curKeyValue, page);
-
-				update_lowest_level_hikey(descr, state, level,
-										  fixed_shmem_key_get_tuple(&state->curKeyValue));
-				chkp_inc_changecount_after(state);
-			}
-			else
-			{
-				OTuple		nullTup;
-
-				chkp_inc_changecount_before(state);
-				state->curKeyType = CurKeyGreatest;
-
-				O_TUPLE_SET_NULL(nullTup);
-				update_lowest_level_hikey(descr, state, level, nullTup);
-				chkp_inc_changecount_after(state);
-			}
+			chkp_inc_changecount_before(state);
+			checkpoint_pass_downlink(descr, state, level, page, &loc);
+			chkp_inc_changecount_after(state);
 
 			if (autonomous && BTREE_PAGE_LOCATOR_GET_OFFSET(page, &loc) + 1 == page_count)
 			{
@@ -4589,6 +5069,9 @@ prepare_leaf_page(BTreeDescr *descr, CheckpointState *state)
 	}
 	chkp_inc_changecount_after(state);
 
+	/* Let the subsequent scans skip visibility checks for this leaf */
+	page_mark_all_visible(descr, page);
+
 	unlock_page(blkno);
 }
 
@@ -4653,14 +5136,437 @@ check_tree_needs_checkpointing(OIndexType type, ORelOids treeOids)
 	return true;
 }
 
+/*
+ * Checkpoints the table tree locked by the caller and unlocks it.  Returns
+ * true and fills the item if the tree needs post-processing after the
+ * checkpoint.
+ */
+static bool
+checkpoint_table_tree(int flags, BTreeDescr *td, CheckpointState *state,
+					  IndexIdItem *item)
+{
+	BTreeMetaPage *meta = BTREE_GET_META(td);
+	ORelOids	treeOids = td->oids;
+	uint32		chkpNum = (checkpoint_state->lastCheckpointNumber + 1);
+	int			cur_chkp_index = chkpNum % 2;
+	bool		postProcess = false;
+	bool		skip = false;
+
+	checkpoint_init_new_seq_bufs(td, chkpNum);
+
+	if (!meta->dirtyFlag1 && !meta->dirtyFlag2)
+	{
+		chkp_inc_changecount_before(state);
+		if (!meta->dirtyFlag1 && !meta->dirtyFlag2)
+		{
+			state->completed = true;
+			state->curKeyType = CurKeyFinished;
+			skip = true;
+		}
+		chkp_inc_changecount_after(state);
+	}
+
+	if (skip)
+	{
+		if (!orioledb_s3_mode)
+		{
+			if (td->storageType == BTreeStoragePersistence ||
+				td->storageType == BTreeStorageUnlogged)
+			{
+				free_seq_buf_pages(td, td->nextChkp[cur_chkp_index].shared);
+				seq_buf_close_file(&td->nextChkp[cur_chkp_index]);
+			}
+			free_seq_buf_pages(td, td->tmpBuf[cur_chkp_index].shared);
+			seq_buf_close_file(&td->tmpBuf[cur_chkp_index]);
+		}
+		o_tables_rel_unlock_extended(&treeOids, AccessShareLock, true);
+	}
+	else if (td->storageType == BTreeStoragePersistence ||
+			 td->storageType == BTreeStorageUnlogged)
+	{
+		if (checkpoint_ix(flags, td, state))
+		{
+			if (!orioledb_s3_mode)
+			{
+				sort_checkpoint_map_file(td, cur_chkp_index);
+				sort_checkpoint_tmp_file(td, cur_chkp_index);
+				postProcess = fill_index_id_item(item, td);
+			}
+			o_tables_rel_unlock_extended(&treeOids, AccessShareLock, true);
+		}
+	}
+	else
+	{
+		checkpoint_temporary_tree(flags, td, state);
+		if (!orioledb_s3_mode)
+			sort_checkpoint_tmp_file(td, cur_chkp_index);
+		o_tables_rel_unlock_extended(&treeOids, AccessShareLock, true);
+	}
+	pg_atomic_fetch_add_u32(&checkpoint_state->progressTreesDone, 1);
+
+	return postProcess;
+}
+
+/*
+ * Starts the checkpoint helpers for the table trees.  Returns the number of
+ * registered helpers.  Shutdown and end-of-recovery checkpoints don't use
+ * helpers, because postmaster might not start new workers at that time.  S3
+ * mode doesn't use them either, because of the single maxLocation.
+ */
+static int
+checkpoint_helpers_start(int flags)
+{
+	int			i;
+
+	if (checkpoint_workers == 0 || !IsUnderPostmaster || orioledb_s3_mode ||
+		(flags & (CHECKPOINT_IS_SHUTDOWN | CHECKPOINT_END_OF_RECOVERY)))
+		return 0;
+
+	if (checkpoint_helper_handles == NULL)
+		checkpoint_helper_handles = (BackgroundWorkerHandle **)
+			MemoryContextAllocZero(TopMemoryContext,
+								   sizeof(BackgroundWorkerHandle *) * checkpoint_workers);
+
+	checkpoint_state->checkpointerLatch = MyLatch;
+	for (i = 0; i < checkpoint_workers; i++)
+		GET_CHECKPOINT_HELPER_STATE(i)->pagesWritten = 0;
+
+	for (i = 0; i < checkpoint_workers; i++)
+	{
+		BackgroundWorker worker;
+
+		pg_atomic_write_u32(&checkpoint_helpers[i].status,
+							CheckpointHelperStarting);
+
+		memset(&worker, 0, sizeof(worker));
+		worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+		worker.bgw_start_time = BgWorkerStart_PostmasterStart;
+		worker.bgw_restart_time = BGW_NEVER_RESTART;
+		worker.bgw_main_arg = Int32GetDatum(i);
+		worker.bgw_notify_pid = MyProcPid;
+		strcpy(worker.bgw_library_name, "orioledb");
+		strcpy(worker.bgw_function_name, "checkpoint_helper_main");
+		snprintf(worker.bgw_name, BGW_MAXLEN, "orioledb checkpoint helper %d", i);
+		strcpy(worker.bgw_type, "orioledb checkpoint helper");
+
+		if (!RegisterDynamicBackgroundWorker(&worker,
+											 &checkpoint_helper_handles[i]))
+		{
+			pg_atomic_write_u32(&checkpoint_helpers[i].status,
+								CheckpointHelperExit);
+			break;
+		}
+	}
+
+	return i;
+}
+
+/*
+ * Marks the tree assigned to the helper as finished, so concurrent processes
+ * don't wait for the helper to pass it.
+ */
+static void
+checkpoint_helper_finish_state(CheckpointState *state)
+{
+	chkp_inc_changecount_before(state);
+	state->completed = true;
+	state->curKeyType = CurKeyFinished;
+	chkp_inc_changecount_after(state);
+}
+
+/*
+ * Collects the results of the helpers, which have finished their trees.
+ * Waits for all the helpers to become idle if 'all' is true, or for any of
+ * them otherwise.  Returns an idle helper or NULL if there are no running
+ * helpers.
+ *
+ * If any helper fails its tree, waits for the rest of them to finish their
+ * trees, stops them and aborts the checkpoint with an error.
+ */
+static CheckpointHelper *
+checkpoint_helpers_wait(CheckpointTablesArg *tbl_arg, bool all)
+{
+	int			failed = -1;
+
+	while (true)
+	{
+		CheckpointHelper *idle = NULL;
+		bool		waiting = false;
+		int			i;
+
+		ResetLatch(MyLatch);
+
+		for (i = 0; i < tbl_arg->helpersNum; i++)
+		{
+			CheckpointHelper *helper = &checkpoint_helpers[i];
+			uint32		status = pg_atomic_read_u32(&helper->status);
+			pid_t		pid;
+
+			if (status == CheckpointHelperDone)
+			{
+				pg_read_barrier();
+				if (helper->postProcess)
+					tbl_arg->postProcessList = append_index_id_item(tbl_arg->postProcessList,
+																	&helper->item);
+				status = CheckpointHelperIdle;
+				pg_atomic_write_u32(&helper->status, status);
+			}
+
+			if (status == CheckpointHelperIdle)
+			{
+				if (idle == NULL)
+					idle = helper;
+			}
+			else if (status == CheckpointHelperFailed)
+			{
+				/* The helper has reset its state and exits */
+				if (failed < 0)
+					failed = i;
+			}
+			else if (status != CheckpointHelperExit)
+			{
+				if (GetBackgroundWorkerPid(checkpoint_helper_handles[i],
+										   &pid) != BGWH_STOPPED)
+				{
+					waiting = true;
+				}
+				else if (status == CheckpointHelperBusy)
+				{
+					/* The helper exited in the middle of the tree */
+					checkpoint_helper_finish_state(GET_CHECKPOINT_HELPER_STATE(i));
+					pg_atomic_write_u32(&helper->status, CheckpointHelperFailed);
+					if (failed < 0)
+						failed = i;
+				}
+				else
+				{
+					/* The helper has never started, don't use it */
+					pg_atomic_write_u32(&helper->status, CheckpointHelperExit);
+				}
+			}
+		}
+
+		if (failed >= 0 && !waiting)
+		{
+			checkpoint_helpers_shutdown(tbl_arg);
+			ereport(ERROR,
+					(errmsg("orioledb checkpoint helper %d failed, checkpoint aborted",
+							failed)));
+		}
+
+		if (failed < 0 && (all ? !waiting : (idle != NULL || !waiting)))
+			return idle;
+
+		AbsorbSyncRequests();
+		(void) WaitLatch(MyLatch,
+						 WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+						 100L, PG_WAIT_EXTENSION);
+	}
+}
+
+/*
+ * Assigns the tree to the idle helper.  The helper state gets the tree within
+ * the checkpoint_state change count section, which also moves checkpoint
+ * past the tree.  So, concurrent processes never see the tree neither passed
+ * nor under checkpoint.
+ */
+static void
+checkpoint_helper_assign(CheckpointHelper *helper, BTreeDescr *td, int flags)
+{
+	CheckpointState *state = GET_CHECKPOINT_HELPER_STATE(helper - checkpoint_helpers);
+
+	/* pairs with the barrier before the helper gets idle */
+	pg_read_barrier();
+
+	helper->flags = flags;
+	helper->type = td->type;
+	helper->treeOids = td->oids;
+	helper->postProcess = false;
+
+	chkp_inc_changecount_before(checkpoint_state);
+	checkpoint_ix_init_state(state, td);
+	checkpoint_state->treeType = td->type;
+	checkpoint_state->datoid = td->oids.datoid;
+	checkpoint_state->reloid = td->oids.reloid;
+	checkpoint_state->relnode = td->oids.relnode;
+	checkpoint_state->completed = true;
+	checkpoint_state->curKeyType = CurKeyFinished;
+	chkp_inc_changecount_after(checkpoint_state);
+
+	pg_write_barrier();
+	pg_atomic_write_u32(&helper->status, CheckpointHelperBusy);
+	SetLatch(helper->latch);
+}
+
+/*
+ * Waits for the helpers to finish their trees and stops them.
+ */
+static void
+checkpoint_helpers_stop(CheckpointTablesArg *tbl_arg)
+{
+	(void) checkpoint_helpers_wait(tbl_arg, true);
+	checkpoint_helpers_shutdown(tbl_arg);
+}
+
+/*
+ * Stops the helpers, none of which may be busy with a tree.
+ */
+static void
+checkpoint_helpers_shutdown(CheckpointTablesArg *tbl_arg)
+{
+	int			i;
+
+	for (i = 0; i < tbl_arg->helpersNum; i++)
+	{
+		CheckpointHelper *helper = &checkpoint_helpers[i];
+		uint32		status = pg_atomic_exchange_u32(&helper->status,
+													CheckpointHelperExit);
+
+		Assert(status != CheckpointHelperBusy);
+		if (status == CheckpointHelperIdle)
+		{
+			pg_read_barrier();
+			SetLatch(helper->latch);
+		}
+	}
+
+	for (i = 0; i < tbl_arg->helpersNum; i++)
+	{
+		(void) WaitForBackgroundWorkerShutdown(checkpoint_helper_handles[i]);
+		pfree(checkpoint_helper_handles[i]);
+		checkpoint_helper_handles[i] = NULL;
+	}
+	tbl_arg->helpersNum = 0;
+}
+
+static void
+checkpoint_helper_process(CheckpointHelper *helper, CheckpointState *state)
+{
+	OIndexDescr *descr;
+	MemoryContext prev_context;
+
+	prev_context = MemoryContextSwitchTo(chkp_tree_context);
+
+	descr = o_fetch_index_descr(helper->treeOids, helper->type, true, NULL);
+	if (descr != NULL && o_btree_load_shmem_checkpoint(&descr->desc))
+	{
+		Assert(!have_locked_pages());
+		Assert(!have_retained_undo_location());
+		helper->postProcess = checkpoint_table_tree(helper->flags,
+													&descr->desc, state,
+													&helper->item);
+	}
+	else
+	{
+		if (descr != NULL)
+			o_tables_rel_unlock_extended(&helper->treeOids, AccessShareLock, true);
+		checkpoint_helper_finish_state(state);
+	}
+
+	MemoryContextSwitchTo(prev_context);
+	MemoryContextResetOnly(chkp_tree_context);
+}
+
+/*
+ * Checkpoint helper main function.  Checkpoints the table trees assigned by
+ * the checkpointer until it asks to exit.
+ */
+void
+checkpoint_helper_main(Datum main_arg)
+{
+	int			id = DatumGetInt32(main_arg);
+	CheckpointHelper *helper = &checkpoint_helpers[id];
+	CheckpointState *state = GET_CHECKPOINT_HELPER_STATE(id);
+	uint32		status = CheckpointHelperStarting;
+	int			i;
+
+	/* enable timeout for relation lock */
+	RegisterTimeout(DEADLOCK_TIMEOUT, CheckDeadLockAlert);
+	/* enable relation cache invalidation (remove old table descriptors) */
+	RelationCacheInitialize();
+	SharedInvalBackendInit(false);
+
+	SetProcessingMode(NormalProcessing);
+
+	/*
+	 * The checkpointer finishes the checkpoint in progress before shutdown.
+	 * So, the helper exits only when the checkpointer asks.
+	 */
+	pqsignal(SIGTERM, SIG_IGN);
+	BackgroundWorkerUnblockSignals();
+	set_io_class(OIOClassCheckpoint);
+
+	chkp_main_context = AllocSetContextCreate(TopMemoryContext,
+											  "OrioleDB checkpoint context",
+											  ALLOCSET_DEFAULT_SIZES);
+	chkp_tree_context = AllocSetContextCreate(chkp_main_context,
+											  "OrioleDB single tree context",
+											  ALLOCSET_DEFAULT_SIZES);
+	MemoryContextSwitchTo(chkp_main_context);
+
+	for (i = 1; i <= SYS_TREES_NUM; i++)
+		(void) get_sys_tree(i);
+
+	o_set_syscache_hooks();
+	o_database_cache_set_database_encoding();
+#if PG_VERSION_NUM >= 170000
+	o_database_cache_set_default_locale_provider();
+#endif
+
+	helper->latch = MyLatch;
+	pg_write_barrier();
+	if (!pg_atomic_compare_exchange_u32(&helper->status, &status,
+										CheckpointHelperIdle))
+		proc_exit(0);
+	SetLatch(checkpoint_state->checkpointerLatch);
+
+	while (true)
+	{
+		ResetLatch(MyLatch);
+
+		status = pg_atomic_read_u32(&helper->status);
+		if (status == CheckpointHelperExit)
+			break;
+
+		if (status == CheckpointHelperBusy)
+		{
+			pg_read_barrier();
+			PG_TRY();
+			{
+				checkpoint_helper_process(helper, state);
+			}
+			PG_CATCH();
+			{
+				/* Let the checkpointer abort the checkpoint */
+				checkpoint_helper_finish_state(state);
+				pg_write_barrier();
+				pg_atomic_write_u32(&helper->status, CheckpointHelperFailed);
+				SetLatch(checkpoint_state->checkpointerLatch);
+				LockReleaseSession(DEFAULT_LOCKMETHOD);
+				PG_RE_THROW();
+			}
+			PG_END_TRY();
+			pg_write_barrier();
+			pg_atomic_write_u32(&helper->status, CheckpointHelperDone);
+			SetLatch(checkpoint_state->checkpointerLatch);
+			continue;
+		}
+
+		(void) WaitLatch(MyLatch, WL_LATCH_SET | WL_EXIT_ON_PM_DEATH, -1L,
+						 PG_WAIT_EXTENSION);
+	}
+
+	o_unset_syscache_hooks();
+	LockReleaseSession(DEFAULT_LOCKMETHOD);
+	proc_exit(0);
+}
+
 static void
 checkpoint_tables_callback(OIndexType type, ORelOids treeOids,
 						   ORelOids tableOids, void *arg)
 {
 	CheckpointTablesArg *tbl_arg = (CheckpointTablesArg *) arg;
 	OIndexDescr *descr;
-	uint32		chkpNum = (checkpoint_state->lastCheckpointNumber + 1);
-	int			cur_chkp_index = chkpNum % 2;
 	MemoryContext prev_context;
 	bool		loaded = false;
 
@@ -4686,9 +5592,7 @@ checkpoint_tables_callback(OIndexType type, ORelOids treeOids,
 	if (loaded)
 	{
 		BTreeDescr *td = &descr->desc;
-		BTreeMetaPage *meta = BTREE_GET_META(td);
-		bool		success;
-		bool		skip = false;
+		CheckpointHelper *helper = NULL;
 
 		elog(DEBUG3, "CHKP %u, (%u, %u, %u) => (%u, %u, %u)",
 			 type, treeOids.datoid, treeOids.reloid, treeOids.relnode,
@@ -4700,6 +5604,13 @@ checkpoint_tables_callback(OIndexType type, ORelOids treeOids,
 		if (td->type >= oIndexUnique &&
 			XLogRecPtrIsInvalid(checkpoint_state->toastConsistentPtr))
 		{
+			/* All the primary and TOAST trees must be finished by now */
+			if (tbl_arg->helpersNum > 0)
+			{
+				LWLockRelease(&checkpoint_state->oTablesMetaLock);
+				(void) checkpoint_helpers_wait(tbl_arg, true);
+				LWLockAcquire(&checkpoint_state->oTablesMetaLock, LW_EXCLUSIVE);
+			}
 			checkpoint_state->toastConsistentPtr = GetXLogInsertRecPtr();
 		}
 
@@ -4712,64 +5623,26 @@ checkpoint_tables_callback(OIndexType type, ORelOids treeOids,
 			STOPEVENT(STOPEVENT_CHECKPOINT_INDEX_START, params);
 		}
 
-		checkpoint_ix_init_state(checkpoint_state, td);
-		checkpoint_init_new_seq_bufs(td, chkpNum);
+		if (tbl_arg->helpersNum > 0)
+			helper = checkpoint_helpers_wait(tbl_arg, false);
 
-		if (!meta->dirtyFlag1 && !meta->dirtyFlag2)
+		if (helper != NULL)
 		{
-			chkp_inc_changecount_before(checkpoint_state);
-			if (!meta->dirtyFlag1 && !meta->dirtyFlag2)
-			{
-				checkpoint_state->treeType = td->type;
-				checkpoint_state->datoid = td->oids.datoid;
-				checkpoint_state->reloid = td->oids.reloid;
-				checkpoint_state->relnode = td->oids.relnode;
-				checkpoint_state->completed = true;
-				checkpoint_state->curKeyType = CurKeyFinished;
-				skip = true;
-			}
-			chkp_inc_changecount_after(checkpoint_state);
-		}
+			checkpoint_helper_assign(helper, td, tbl_arg->flags);
 
-		if (skip)
-		{
-			if (!orioledb_s3_mode)
-			{
-				if (td->storageType == BTreeStoragePersistence ||
-					td->storageType == BTreeStorageUnlogged)
-				{
-					free_seq_buf_pages(td, td->nextChkp[cur_chkp_index].shared);
-					seq_buf_close_file(&td->nextChkp[cur_chkp_index]);
-				}
-				free_seq_buf_pages(td, td->tmpBuf[cur_chkp_index].shared);
-				seq_buf_close_file(&td->tmpBuf[cur_chkp_index]);
-			}
+			/* The helper takes its own lock on the tree */
 			o_tables_rel_unlock_extended(&treeOids, AccessShareLock, true);
 		}
-		else if (td->storageType == BTreeStoragePersistence ||
-				 td->storageType == BTreeStorageUnlogged)
-		{
-			success = checkpoint_ix(tbl_arg->flags, td);
-
-			if (success)
-			{
-				if (!orioledb_s3_mode)
-				{
-					sort_checkpoint_map_file(td, cur_chkp_index);
-					sort_checkpoint_tmp_file(td, cur_chkp_index);
-					tbl_arg->postProcessList = add_index_id_item(tbl_arg->postProcessList, td);
-				}
-				o_tables_rel_unlock_extended(&treeOids, AccessShareLock, true);
-			}
-		}
 		else
 		{
-			checkpoint_temporary_tree(tbl_arg->flags, td);
-			if (!orioledb_s3_mode)
-				sort_checkpoint_tmp_file(td, cur_chkp_index);
-			o_tables_rel_unlock_extended(&treeOids, AccessShareLock, true);
-		}
+			IndexIdItem item;
 
+			checkpoint_ix_init_state(checkpoint_state, td);
+			if (checkpoint_table_tree(tbl_arg->flags, td, checkpoint_state,
+									  &item))
+				tbl_arg->postProcessList = append_index_id_item(tbl_arg->postProcessList,
+																&item);
+		}
 
 		LWLockAcquire(&checkpoint_state->oTablesMetaLock, LW_EXCLUSIVE);
 	}
@@ -4792,25 +5665,32 @@ get_cur_checkpoint_number(ORelOids *oids, OIndexType type,
 	OIndexType	chkp_tree_type = oIndexInvalid;
 	Oid			datoid = InvalidOid,
 				relnode = InvalidOid;
-	int			before_changecount,
-				after_changecount;
+	int			main_changecount,
+				before_changecount;
 	uint32		result,
 				completed;
+	CheckpointState *state;
 
 	do
 	{
-		chkp_save_changecount_before(checkpoint_state, before_changecount);
-		if ((before_changecount & 1) != 0)
+		chkp_save_changecount_before(checkpoint_state, main_changecount);
+		if ((main_changecount & 1) != 0)
 			continue;
 
-		chkp_tree_type = checkpoint_state->treeType;
-		datoid = checkpoint_state->datoid;
-		relnode = checkpoint_state->relnode;
 		result = checkpoint_state->lastCheckpointNumber;
-		completed = checkpoint_state->completed;
+		state = get_tree_checkpoint_state(type, oids->datoid, oids->relnode);
 
-		chkp_save_changecount_after(checkpoint_state, after_changecount);
-		if (before_changecount != after_changecount)
+		chkp_save_changecount_before(state, before_changecount);
+		if ((before_changecount & 1) != 0)
+			continue;
+
+		chkp_tree_type = state->treeType;
+		datoid = state->datoid;
+		relnode = state->relnode;
+		completed = state->completed;
+
+		if (!tree_checkpoint_state_is_stable(state, before_changecount,
+											 main_changecount))
 			continue;
 
 		if (OidIsValid(datoid))
@@ -4836,8 +5716,8 @@ get_cur_checkpoint_number(ORelOids *oids, OIndexType type,
 			*checkpoint_concurrent = false;
 		}
 		/* else checkpoint is not in progress */
-		chkp_save_changecount_after(checkpoint_state, after_changecount);
-		if (before_changecount == after_changecount)
+		if (tree_checkpoint_state_is_stable(state, before_changecount,
+											main_changecount))
 			break;
 	} while (true);
 
@@ -5459,3 +6339,63 @@ systrees_modify_end(bool any_wal)
 	LWLockRelease(&checkpoint_state->oSysTreesLock);
 	add_systrees_lock_undo(true);
 }
+
+/*
+ * Returns the progress of the checkpoint in progress.  Returns no rows when
+ * no checkpoint is in progress.
+ */
+Datum
+orioledb_get_checkpoint_progress(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Datum		values[7];
+	bool		nulls[7];
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	TimestampTz startTime;
+	double		progress;
+
+	orioledb_check_shmem();
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	startTime = checkpoint_state->progressStartTime;
+	pg_read_barrier();
+	if (startTime == 0)
+		return (Datum) 0;
+
+	MemSet(nulls, 0, sizeof(nulls));
+	progress = checkpoint_get_progress();
+	values[0] = Int64GetDatum(checkpoint_state->lastCheckpointNumber + 1);
+	values[1] = TimestampTzGetDatum(startTime);
+	values[2] = Int64GetDatum(pg_atomic_read_u32(&checkpoint_state->progressTreesDone));
+	values[3] = Int64GetDatum(pg_atomic_read_u64(&checkpoint_state->progressPagesWritten));
+	values[4] = Int64GetDatum(pg_atomic_read_u64(&checkpoint_state->progressBytesWritten));
+	values[5] = Float8GetDatum(progress);
+	if (progress > 0.0)
+	{
+		TimestampTz now = GetCurrentTimestamp();
+
+		values[6] = TimestampTzGetDatum(startTime +
+										(TimestampTz) ((now - startTime) / progress));
+	}
+	else
+		nulls[6] = true;
+	tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+
+	return (Datum) 0;
+}
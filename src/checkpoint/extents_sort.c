@@ -0,0 +1,369 @@
+/*-------------------------------------------------------------------------
+ *
+ * extents_sort.c
+ *		Routines for sorting the free extents files.
+ *
+ * Copyright (c) 2025-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/checkpoint/extents_sort.c
+ *
+ * NOTES
+ *
+ *		The map and tmp files of big trees might not fit into memory.  So,
+ *		they are sorted externally with maintenance_work_mem of memory.  The
+ *		file is cut into runs, each run is radix sorted in memory and written
+ *		to the temporary file.  Then the runs are merged back into the
+ *		original file.  Thus, every item is read and written twice.  The file
+ *		which fits into the single run is sorted in place.
+ *
+ *		The items are sorted by the 64-bit keys: the block number for the
+ *		uncompressed trees, the length descending and then the offset for
+ *		the extents.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "btree/io.h"
+#include "checkpoint/extents_sort.h"
+
+#include "miscadmin.h"
+#include "utils/memutils.h"
+#include "utils/wait_event.h"
+
+#define RADIX_BITS			(8)
+#define RADIX_BUCKETS		(1 << RADIX_BITS)
+#define RADIX_MAX_DIGITS	(sizeof(uint64))
+
+/* Minimal size of the read buffer of the run during the merge */
+#define MERGE_MIN_BUFFER_SIZE (BLCKSZ)
+
+#define EXTENT_OFF_MASK		((UINT64CONST(1) << 48) - 1)
+
+typedef struct
+{
+	File		file;
+	File		runsFile;
+	Size		itemSize;
+	bool		extents;
+	/* size of the read buffer of each run and of the output buffer */
+	Size		bufSize;
+} ExtentsSortState;
+
+typedef struct
+{
+	/* position of the unread part of the run in the temporary file */
+	off_t		pos;
+	off_t		end;
+	Pointer		buf;
+	Size		bufItems;
+	Size		bufPos;
+	/* key of the current item */
+	uint64		key;
+} MergeRun;
+
+static inline uint64
+item_get_key(ExtentsSortState *state, Pointer item)
+{
+	if (state->extents)
+	{
+		FileExtent	extent;
+
+		memcpy(&extent, item, sizeof(extent));
+		return ((uint64) (PG_UINT16_MAX - extent.len) << 48) | extent.off;
+	}
+	else
+	{
+		uint32		blkno;
+
+		memcpy(&blkno, item, sizeof(blkno));
+		return blkno;
+	}
+}
+
+static inline void
+key_get_item(ExtentsSortState *state, uint64 key, Pointer item)
+{
+	if (state->extents)
+	{
+		FileExtent	extent;
+
+		extent.len = PG_UINT16_MAX - (key >> 48);
+		extent.off = key & EXTENT_OFF_MASK;
+		memcpy(item, &extent, sizeof(extent));
+	}
+	else
+	{
+		uint32		blkno = (uint32) key;
+
+		memcpy(item, &blkno, sizeof(blkno));
+	}
+}
+
+static void
+extents_sort_read(File file, Pointer buf, Size len, off_t offset)
+{
+	if (OFileRead(file, buf, len, offset, WAIT_EVENT_DATA_FILE_READ) != (int) len)
+		ereport(FATAL, (errcode_for_file_access(),
+						errmsg("Could not read free extents from file: %s",
+							   FilePathName(file))));
+}
+
+static void
+extents_sort_write(File file, Pointer buf, Size len, off_t offset)
+{
+	if (OFileWrite(file, buf, len, offset, WAIT_EVENT_DATA_FILE_WRITE) != (int) len)
+		ereport(FATAL, (errcode_for_file_access(),
+						errmsg("Could not write sorted free extents to file: %s",
+							   FilePathName(file))));
+}
+
+/*
+ * LSD radix sort of the keys.  Uses 'tmp' array of the same size.  Returns
+ * either 'keys' or 'tmp' depending on where the sorted keys have finished.
+ */
+static uint64 *
+radix_sort_keys(uint64 *keys, uint64 *tmp, Size n, int digits)
+{
+	Size		counts[RADIX_MAX_DIGITS][RADIX_BUCKETS];
+	Size		i;
+	int			digit;
+
+	Assert(digits <= RADIX_MAX_DIGITS);
+
+	/* Histograms of all the digits in a single pass */
+	memset(counts, 0, sizeof(counts));
+	for (i = 0; i < n; i++)
+	{
+		uint64		key = keys[i];
+
+		for (digit = 0; digit < digits; digit++)
+			counts[digit][(key >> (digit * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+	}
+
+	for (digit = 0; digit < digits; digit++)
+	{
+		int			shift = digit * RADIX_BITS;
+		Size		sum = 0;
+		uint64	   *swap;
+		int			j;
+
+		/* Skip the digit which is the same for all the keys */
+		if (counts[digit][(keys[0] >> shift) & (RADIX_BUCKETS - 1)] == n)
+			continue;
+
+		for (j = 0; j < RADIX_BUCKETS; j++)
+		{
+			Size		count = counts[digit][j];
+
+			counts[digit][j] = sum;
+			sum += count;
+		}
+
+		for (i = 0; i < n; i++)
+			tmp[counts[digit][(keys[i] >> shift) & (RADIX_BUCKETS - 1)]++] = keys[i];
+
+		swap = keys;
+		keys = tmp;
+		tmp = swap;
+	}
+
+	return keys;
+}
+
+/*
+ * Loads the next item of the run.  Returns false if the run is finished.
+ */
+static bool
+merge_run_next(ExtentsSortState *state, MergeRun *run)
+{
+	if (run->bufPos == run->bufItems)
+	{
+		Size		len;
+
+		if (run->pos == run->end)
+			return false;
+
+		len = Min(state->bufSize, run->end - run->pos);
+		extents_sort_read(state->runsFile, run->buf, len, run->pos);
+		run->pos += len;
+		run->bufItems = len / state->itemSize;
+		run->bufPos = 0;
+	}
+
+	run->key = item_get_key(state, run->buf + run->bufPos * state->itemSize);
+	run->bufPos++;
+	return true;
+}
+
+static void
+merge_heap_sift_down(MergeRun *runs, int *heap, int heapSize, int i)
+{
+	while (true)
+	{
+		int			left = 2 * i + 1,
+					right = left + 1,
+					min = i,
+					swap;
+
+		if (left < heapSize && runs[heap[left]].key < runs[heap[min]].key)
+			min = left;
+		if (right < heapSize && runs[heap[right]].key < runs[heap[min]].key)
+			min = right;
+		if (min == i)
+			break;
+
+		swap = heap[i];
+		heap[i] = heap[min];
+		heap[min] = swap;
+		i = min;
+	}
+}
+
+/*
+ * Merges the sorted runs of the temporary file into the original file
+ * starting from 'start'.
+ */
+static void
+merge_runs(ExtentsSortState *state, off_t start, uint64 nitems,
+		   Size runItems, int nruns)
+{
+	MergeRun   *runs;
+	int		   *heap;
+	int			heapSize = 0;
+	int			i;
+	Pointer		outBuf;
+	Size		outLen = 0;
+	off_t		outPos = start;
+
+	runs = (MergeRun *) palloc(sizeof(MergeRun) * nruns);
+	heap = (int *) palloc(sizeof(int) * nruns);
+	outBuf = palloc(state->bufSize);
+
+	for (i = 0; i < nruns; i++)
+	{
+		uint64		first = (uint64) i * runItems;
+
+		runs[i].pos = first * state->itemSize;
+		runs[i].end = Min(first + runItems, nitems) * state->itemSize;
+		runs[i].buf = palloc(state->bufSize);
+		runs[i].bufItems = 0;
+		runs[i].bufPos = 0;
+		if (merge_run_next(state, &runs[i]))
+			heap[heapSize++] = i;
+	}
+
+	for (i = heapSize / 2 - 1; i >= 0; i--)
+		merge_heap_sift_down(runs, heap, heapSize, i);
+
+	while (heapSize > 0)
+	{
+		MergeRun   *run = &runs[heap[0]];
+
+		key_get_item(state, run->key, outBuf + outLen);
+		outLen += state->itemSize;
+		if (outLen == state->bufSize)
+		{
+			extents_sort_write(state->file, outBuf, outLen, outPos);
+			outPos += outLen;
+			outLen = 0;
+		}
+
+		if (!merge_run_next(state, run))
+			heap[0] = heap[--heapSize];
+		merge_heap_sift_down(runs, heap, heapSize, 0);
+	}
+
+	if (outLen > 0)
+		extents_sort_write(state->file, outBuf, outLen, outPos);
+
+	for (i = 0; i < nruns; i++)
+		pfree(runs[i].buf);
+	pfree(runs);
+	pfree(heap);
+	pfree(outBuf);
+}
+
+/*
+ * Sorts the free extents stored in the 'file' from 'start' to
+ * 'start + size'.  'extents' means FileExtent items, otherwise the items are
+ * uint32 block numbers.  The caller is responsible for syncing the file.
+ */
+void
+sort_extents_file(File file, off_t start, uint64 size, bool extents)
+{
+	ExtentsSortState state;
+	Size		memory = Min((Size) maintenance_work_mem * 1024L, MaxAllocSize);
+	Size		runItems;
+	uint64		nitems;
+	uint64	   *keys,
+			   *tmp;
+	int			nruns,
+				run;
+
+	state.file = file;
+	state.runsFile = -1;
+	state.extents = extents;
+	state.itemSize = extents ? sizeof(FileExtent) : sizeof(uint32);
+
+	nitems = size / state.itemSize;
+	if (nitems == 0)
+		return;
+
+	/* Keys and the radix sort buffer of the single run */
+	runItems = Max(memory / (2 * sizeof(uint64)),
+				   MERGE_MIN_BUFFER_SIZE / sizeof(uint64));
+	runItems = Min(runItems, nitems);
+	nruns = (nitems + runItems - 1) / runItems;
+
+	keys = (uint64 *) palloc(sizeof(uint64) * runItems);
+	tmp = (uint64 *) palloc(sizeof(uint64) * runItems);
+
+	if (nruns > 1)
+		state.runsFile = OpenTemporaryFile(true);
+
+	for (run = 0; run < nruns; run++)
+	{
+		uint64		first = (uint64) run * runItems;
+		Size		n = Min(runItems, nitems - first);
+		Size		i;
+		uint64	   *sorted;
+		Pointer		items;
+
+		CHECK_FOR_INTERRUPTS();
+
+		/* Raw items are read into the sort buffer and converted to keys */
+		items = (Pointer) tmp;
+		extents_sort_read(file, items, n * state.itemSize,
+						  start + first * state.itemSize);
+		for (i = 0; i < n; i++)
+			keys[i] = item_get_key(&state, items + i * state.itemSize);
+
+		sorted = radix_sort_keys(keys, tmp, n,
+								 extents ? sizeof(uint64) : sizeof(uint32));
+
+		items = (Pointer) (sorted == keys ? tmp : keys);
+		for (i = 0; i < n; i++)
+			key_get_item(&state, sorted[i], items + i * state.itemSize);
+
+		if (nruns == 1)
+			extents_sort_write(file, items, n * state.itemSize, start);
+		else
+			extents_sort_write(state.runsFile, items, n * state.itemSize,
+							   first * state.itemSize);
+	}
+
+	pfree(keys);
+	pfree(tmp);
+
+	if (nruns > 1)
+	{
+		state.bufSize = Max(memory / (nruns + 1), MERGE_MIN_BUFFER_SIZE);
+		state.bufSize -= state.bufSize % sizeof(uint64);
+		merge_runs(&state, start, nitems, runItems, nruns);
+		FileClose(state.runsFile);
+	}
+}
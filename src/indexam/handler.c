@@ -34,6 +34,7 @@
 #include "nodes/pathnodes.h"
 #include "optimizer/optimizer.h"
 #include "parser/parsetree.h"
+#include "storage/spin.h"
 #include "utils/fmgroids.h"
 #include "utils/index_selfuncs.h"
 #include "utils/selfuncs.h"
@@ -117,7 +118,7 @@ orioledb_get_indexam_handler(void)
 	amroutine->amstorage = false;
 	amroutine->amclusterable = true;
 	amroutine->ampredlocks = true;
-	amroutine->amcanparallel = false;
+	amroutine->amcanparallel = true;
 	amroutine->amcaninclude = true;
 	amroutine->amusemaintenanceworkmem = false;
 	amroutine->amsummarizing = false;
@@ -1282,9 +1283,14 @@ orioledb_amrescan(IndexScanDesc scan, ScanKey scankey, int nscankeys,
 {
 	OScanState *o_scan = (OScanState *) scan;
 
+	o_index_scan_discard_batch(o_scan);
+	o_index_scan_discard_pk_batch(o_scan);
 	MemoryContextReset(o_scan->cxt);
 	o_scan->iterator = NULL;
 	o_scan->curKeyRangeIsLoaded = false;
+	o_scan->parallelChunks = false;
+	o_scan->parallelOwner = false;
+	o_scan->parallelDone = false;
 	o_scan->numPrefixExactKeys = o_get_num_prefix_exact_keys(scankey, nscankeys);
 	btrescan(scan, scankey, nscankeys, orderbys, norderbys);
 }
@@ -1478,6 +1484,10 @@ orioledb_amgettuple(IndexScanDesc scan, ScanDirection dir)
 
 	o_scan->scanDir = dir;
 
+	if (scan->parallel_scan != NULL && o_scan->pscan == NULL)
+		o_scan->pscan = (ParallelOIndexScanDesc) OffsetToPointer(scan->parallel_scan,
+																 scan->parallel_scan->ps_offset);
+
 	if (scan->xs_snapshot->snapshot_type == SNAPSHOT_DIRTY)
 		o_scan->oSnapshot = o_in_progress_snapshot;
 	else if (scan->xs_snapshot->snapshot_type == SNAPSHOT_NON_VACUUMABLE)
@@ -1541,6 +1551,9 @@ orioledb_amendscan(IndexScanDesc scan)
 
 	STOPEVENT(STOPEVENT_SCAN_END, NULL);
 
+	/* Buffered tuples live in the tuple context, not in the scan one */
+	o_index_scan_discard_batch(o_scan);
+	o_index_scan_discard_pk_batch(o_scan);
 	MemoryContextDelete(o_scan->cxt);
 }
 
@@ -1561,15 +1574,32 @@ orioledb_amestimateparallelscan(int nkeys, int norderbys)
 orioledb_amestimateparallelscan(void)
 #endif
 {
-	return sizeof(uint8);
+	return sizeof(ParallelOIndexScanDescData);
 }
 
 void
 orioledb_aminitparallelscan(void *target)
 {
+	ParallelOIndexScanDesc pscan = (ParallelOIndexScanDesc) target;
+
+	SpinLockInit(&pscan->mutex);
+	ConditionVariableInit(&pscan->cv);
+	pscan->status = OParallelIndexScanNotStarted;
+	clear_fixed_shmem_key(&pscan->nextKey);
 }
 
 void
 orioledb_amparallelrescan(IndexScanDesc scan)
 {
+	ParallelIndexScanDesc parallel_scan = scan->parallel_scan;
+	ParallelOIndexScanDesc pscan;
+
+	Assert(parallel_scan);
+	pscan = (ParallelOIndexScanDesc) OffsetToPointer(parallel_scan,
+													 parallel_scan->ps_offset);
+
+	SpinLockAcquire(&pscan->mutex);
+	pscan->status = OParallelIndexScanNotStarted;
+	clear_fixed_shmem_key(&pscan->nextKey);
+	SpinLockRelease(&pscan->mutex);
 }
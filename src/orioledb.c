@@ -15,9 +15,17 @@
 
 #include "orioledb.h"
 
+#include "btree/ahi.h"
+#include "btree/bloom.h"
 #include "btree/find.h"
 #include "btree/io.h"
+#include "btree/io_stats.h"
+#include "btree/key_sample.h"
+#include "btree/residency.h"
+#include "btree/page_state.h"
 #include "btree/scan.h"
+#include "btree/zone_map.h"
+#include "catalog/free_extents.h"
 #include "catalog/o_tables.h"
 #include "catalog/o_sys_cache.h"
 #include "catalog/sys_trees.h"
@@ -32,17 +40,24 @@
 #include "s3/requests.h"
 #include "s3/worker.h"
 #include "tableam/handler.h"
+#include "tableam/index_scan.h"
+#include "tableam/operations.h"
 #include "tableam/scan.h"
 #include "tableam/toast.h"
 #include "transam/oxid.h"
 #include "transam/undo.h"
+#include "tuple/slot.h"
 #include "tuple/toast.h"
 #include "utils/compress.h"
+#include "utils/latency.h"
 #include "utils/memdebug.h"
+#include "utils/o_wait_events.h"
 #include "utils/page_pool.h"
 #include "utils/stopevent.h"
 #include "utils/ucm.h"
 #include "workers/bgwriter.h"
+#include "workers/rollback.h"
+#include "workers/warmup.h"
 
 #include "access/table.h"
 #include "access/xlog_internal.h"
@@ -53,6 +68,7 @@
 #include "miscadmin.h"
 #include "optimizer/optimizer.h"
 #include "optimizer/plancat.h"
+#include "port/pg_bitutils.h"
 #include "postmaster/autovacuum.h"
 #include "postmaster/bgwriter.h"
 #include "postmaster/postmaster.h"
@@ -63,6 +79,7 @@
 #include "storage/lwlock.h"
 #include "storage/proclist.h"
 #include "utils/builtins.h"
+#include "utils/guc.h"
 #include "utils/inval.h"
 #include "utils/rangetypes.h"
 #include "utils/pg_locale.h"
@@ -72,6 +89,9 @@
 #include <dirent.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 
 PG_MODULE_MAGIC;
 
@@ -91,6 +111,7 @@ OrioleDBPageDesc *page_descs = NULL;
 
 /* Custom GUC variables */
 int			main_buffers_guc;
+int			main_buffers_limit_guc = 0;
 static int	undo_buffers_guc;
 static int	undo_system_buffers_guc;
 static int	xid_buffers_guc;
@@ -105,27 +126,71 @@ uint32		undo_system_buffers_count;
 Size		xid_circular_buffer_size;
 uint32		xid_buffers_count;
 bool		remove_old_checkpoint_files = true;
+bool		orioledb_async_file_cleanup = false;
 bool		skip_unmodified_trees = true;
+bool		skip_unmodified_subtrees = true;
 bool		debug_disable_bgwriter = false;
 bool		use_mmap = false;
+bool		numa_interleave = false;
+bool		orioledb_direct_io = false;
+int			buffers_huge_pages = BUFFERS_HUGE_PAGES_OFF;
+int			buffers_huge_page_size = 0;
+bool		buffers_prefault = false;
+static int	buffers_page_size = 0;
+static Pointer buffers_segment = NULL;
+static Size buffers_segment_size = 0;
+
+static const struct config_enum_entry buffers_huge_pages_options[] = {
+	{"off", BUFFERS_HUGE_PAGES_OFF, false},
+	{"on", BUFFERS_HUGE_PAGES_ON, false},
+	{"try", BUFFERS_HUGE_PAGES_TRY, false},
+	{"true", BUFFERS_HUGE_PAGES_ON, true},
+	{"false", BUFFERS_HUGE_PAGES_OFF, true},
+	{"yes", BUFFERS_HUGE_PAGES_ON, true},
+	{"no", BUFFERS_HUGE_PAGES_OFF, true},
+	{"1", BUFFERS_HUGE_PAGES_ON, true},
+	{"0", BUFFERS_HUGE_PAGES_OFF, true},
+	{NULL, 0, false}
+};
 bool		use_device = false;
 bool		orioledb_use_sparse_files = false;
+int			data_file_prealloc_size = 0;
+int			ctid_cache_size = 1;
 char	   *device_filename = NULL;
+char	   *data_stripe_directories = NULL;
 Pointer		mmap_data = NULL;
 int			device_fd;
 int			device_length_guc = 0;
 Size		device_length = 0;
 double		o_checkpoint_completion_ratio;
+int			checkpoint_workers = 0;
+double		checkpoint_read_latency_target = 2.0;
 int			bgwriter_num_workers = 1;
 int			max_io_concurrency = 0;
+int			background_io_concurrency = 0;
 ODBProcData *oProcData;
 int			default_compress = InvalidOCompress;
 int			default_primary_compress = InvalidOCompress;
 int			default_toast_compress = InvalidOCompress;
+int			hot_pages_compress = InvalidOCompress;
+int			compress_min_saving = 0;
 bool		orioledb_table_description_compress = false;
 bool		orioledb_s3_mode = false;
 int			s3_num_workers = 3;
 int			s3_desired_size = 10000;
+int			s3_multipart_part_size = 8192;
+int			s3_multipart_concurrency = 4;
+int			s3_prefetch_parts = 4;
+int			s3_wal_compression = 0;
+int			s3_checksum_algorithm = S3_CHECKSUM_SHA256;
+
+static const struct config_enum_entry s3_checksum_algorithm_options[] = {
+	{"sha256", S3_CHECKSUM_SHA256, false},
+	{"crc32c", S3_CHECKSUM_CRC32C, false},
+	{NULL, 0, false}
+};
+bool		s3_second_touch_admission = false;
+bool		s3_incremental_backup = false;
 int			s3_queue_size_guc;
 char	   *s3_host = NULL;
 bool		s3_use_https = true;
@@ -187,8 +252,22 @@ static ShmemItem shmemItems[] = {
 	{o_proc_shmem_needs, o_proc_shmem_init},
 	{ppools_shmem_needs, ppools_shmem_init},
 	{btree_scan_shmem_needs, btree_scan_init_shmem},
+	{ahi_shmem_needs, ahi_shmem_init},
+	{zone_map_shmem_needs, zone_map_shmem_init},
+	{bloom_filter_shmem_needs, bloom_filter_shmem_init},
+	{free_extents_cache_shmem_needs, free_extents_cache_shmem_init},
+	{bgwriter_shmem_needs, bgwriter_shmem_init},
+	{rollback_worker_shmem_needs, rollback_worker_shmem_init},
+	{page_lock_stats_shmem_needs, page_lock_stats_shmem_init},
+	{tree_io_stats_shmem_needs, tree_io_stats_shmem_init},
+	{pinned_trees_shmem_needs, pinned_trees_shmem_init},
+	{key_sample_shmem_needs, key_sample_shmem_init},
+	{o_wait_events_shmem_needs, o_wait_events_shmem_init},
+	{latency_shmem_needs, latency_shmem_init},
+	{wal_group_commit_shmem_needs, wal_group_commit_shmem_init},
 	{s3_queue_shmem_needs, s3_queue_init_shmem},
 	{s3_workers_shmem_needs, s3_workers_init_shmem},
+	{s3_requests_shmem_needs, s3_requests_shmem_init},
 	{s3_headers_shmem_needs, s3_headers_shmem_init}
 };
 
@@ -206,6 +285,7 @@ static void orioledb_get_relation_info_hook(PlannerInfo *root,
 static bool orioledb_skip_tree_height_hook(Relation indexRelation);
 
 PG_FUNCTION_INFO_V1(orioledb_page_stats);
+PG_FUNCTION_INFO_V1(orioledb_page_pool_stats);
 PG_FUNCTION_INFO_V1(orioledb_version);
 PG_FUNCTION_INFO_V1(orioledb_commit_hash);
 PG_FUNCTION_INFO_V1(orioledb_ucm_check);
@@ -221,6 +301,8 @@ orioledb_rm_desc(StringInfo buf, XLogReaderState *record)
 static const char *
 orioledb_rm_identify(uint8 info)
 {
+	if ((info & ~XLR_INFO_MASK) == ORIOLEDB_XLOG_CONTAINER_COMPRESSED)
+		return "OrioleDB compressed WAL container";
 	return "OrioleDB WAL container";
 }
 
@@ -292,6 +374,19 @@ _PG_init(void)
 							NULL,
 							NULL);
 
+	DefineCustomIntVariable("orioledb.main_buffers_limit",
+							"Limit of orioledb engine shared buffers for main data usable without restart, 0 means no limit.",
+							NULL,
+							&main_buffers_limit_guc,
+							0,
+							0,
+							INT_MAX,
+							PGC_SIGHUP,
+							GUC_UNIT_BLOCKS,
+							NULL,
+							NULL,
+							NULL);
+
 	DefineCustomIntVariable("orioledb.free_tree_buffers",
 							"Size of orioledb engine shared buffers for free extents BTrees.",
 							NULL,
@@ -318,6 +413,73 @@ _PG_init(void)
 							NULL,
 							NULL);
 
+	DefineCustomBoolVariable("orioledb.numa_interleave",
+							 "Interleave orioledb engine shared buffers across NUMA nodes.",
+							 NULL,
+							 &numa_interleave,
+							 false,
+							 PGC_POSTMASTER,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomEnumVariable("orioledb.buffers_huge_pages",
+							 "Use a dedicated huge pages segment for orioledb engine shared buffers.",
+							 NULL,
+							 &buffers_huge_pages,
+							 BUFFERS_HUGE_PAGES_OFF,
+							 buffers_huge_pages_options,
+							 PGC_POSTMASTER,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("orioledb.buffers_huge_page_size",
+							"The size of huge page for orioledb engine shared buffers, 0 means the system default.",
+							NULL,
+							&buffers_huge_page_size,
+							0,
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							GUC_UNIT_KB,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomBoolVariable("orioledb.buffers_prefault",
+							 "Pre-fault orioledb engine shared buffers on startup.",
+							 NULL,
+							 &buffers_prefault,
+							 false,
+							 PGC_POSTMASTER,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("orioledb.buffers_page_size",
+							"Shows the size of memory pages backing orioledb engine shared buffers.",
+							NULL,
+							&buffers_page_size,
+							0,
+							0,
+							INT_MAX,
+							PGC_INTERNAL,
+							GUC_UNIT_KB | GUC_NOT_IN_SAMPLE | GUC_DISALLOW_IN_FILE,
+							NULL,
+							NULL,
+							NULL);
+
+#ifdef EXEC_BACKEND
+	if (buffers_huge_pages != BUFFERS_HUGE_PAGES_OFF)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("orioledb.buffers_huge_pages is not supported on this platform")));
+#endif
+
 	DefineCustomIntVariable("orioledb.undo_buffers",
 							"Size of orioledb engine undo log buffers.",
 							NULL,
@@ -344,6 +506,19 @@ _PG_init(void)
 							NULL,
 							NULL);
 
+	DefineCustomIntVariable("orioledb.undo_compress",
+							"Compression level of undo log blocks spilled to disk, -1 disables compression.",
+							NULL,
+							&undo_compress,
+							-1,
+							-1,
+							o_compress_max_lvl(),
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
 	DefineCustomIntVariable("orioledb.xid_buffers",
 							"Size of orioledb engine xid buffers.",
 							NULL,
@@ -379,6 +554,28 @@ _PG_init(void)
 							 NULL,
 							 NULL);
 
+	DefineCustomBoolVariable("orioledb.page_lock_stats",
+							 "Collect per-tree page lock statistics.",
+							 NULL,
+							 &page_lock_stats,
+							 false,
+							 PGC_SUSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.latency_histograms",
+							 "Collect latency histograms of page loads, evictions, compression, commits and page lock waits.",
+							 NULL,
+							 &latency_histograms,
+							 true,
+							 PGC_SUSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
 	DefineCustomBoolVariable("orioledb.remove_old_checkpoint_files",
 							 "Remove temporary *.tmp and *.map files after checkpoint.",
 							 NULL,
@@ -390,6 +587,17 @@ _PG_init(void)
 							 NULL,
 							 NULL);
 
+	DefineCustomBoolVariable("orioledb.async_file_cleanup",
+							 "Unlink the files of dropped and truncated tables in the background.",
+							 NULL,
+							 &orioledb_async_file_cleanup,
+							 false,
+							 PGC_SIGHUP,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
 	DefineCustomBoolVariable("orioledb.skip_unmodified_trees",
 							 "Skip reading of unmodified trees during checkpointing.",
 							 NULL,
@@ -401,6 +609,17 @@ _PG_init(void)
 							 NULL,
 							 NULL);
 
+	DefineCustomBoolVariable("orioledb.skip_unmodified_subtrees",
+							 "Skip writing of unmodified subtrees during checkpointing.",
+							 NULL,
+							 &skip_unmodified_subtrees,
+							 true,
+							 PGC_SIGHUP,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
 	DefineCustomBoolVariable("orioledb.debug_disable_bgwriter",
 							 "Disables bgwriter for debug.",
 							 NULL,
@@ -425,6 +644,69 @@ _PG_init(void)
 							NULL,
 							NULL);
 
+	DefineCustomIntVariable("orioledb.commit_delay",
+							"Sets the delay in microseconds between transaction commit and flushing WAL to disk.",
+							"Committers, which arrive during the delay, are flushed by the same WAL flush.",
+							&wal_commit_delay,
+							0,
+							0,
+							100000,
+							PGC_SUSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.commit_group_size",
+							"Sets the amount of WAL, which makes the commit group flush before the end of the delay.",
+							NULL,
+							&wal_commit_group_size,
+							256,
+							1,
+							MAX_KILOBYTES,
+							PGC_SUSET,
+							GUC_UNIT_KB,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.wal_compress",
+							"Compression level of orioledb WAL containers, -1 disables compression.",
+							NULL,
+							&wal_compress,
+							-1,
+							-1,
+							o_compress_max_lvl(),
+							PGC_SUSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.wal_compress_threshold",
+							"Minimal size of orioledb WAL container to be compressed.",
+							NULL,
+							&wal_compress_threshold,
+							1024,
+							0,
+							LOCAL_WAL_BUFFER_SIZE,
+							PGC_SUSET,
+							GUC_UNIT_BYTE,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomBoolVariable("orioledb.wal_update_delta",
+							 "Logs only the changed bytes of updated primary key tuples.",
+							 NULL,
+							 &wal_update_delta,
+							 true,
+							 PGC_SUSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
 	DefineCustomIntVariable("orioledb.recovery_pool_size",
 							"Sets the number of recovery workers.",
 							NULL,
@@ -451,6 +733,39 @@ _PG_init(void)
 							NULL,
 							NULL);
 
+	DefineCustomBoolVariable("orioledb.recovery_rebalance",
+							 "Moves key hash buckets between recovery workers to even out their load.",
+							 NULL,
+							 &recovery_rebalance_guc,
+							 true,
+							 PGC_SIGHUP,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.recovery_skip_dropped",
+							 "Skips replay of modifications of the trees dropped later in the WAL.",
+							 NULL,
+							 &recovery_skip_dropped_guc,
+							 false,
+							 PGC_SIGHUP,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.recovery_prefetch",
+							 "Prefetches evicted pages to be modified by recovery workers.",
+							 NULL,
+							 &recovery_prefetch_guc,
+							 true,
+							 PGC_SIGHUP,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
 	DefineCustomIntVariable("orioledb.recovery_parallel_indices_rebuild_limit",
 							"Sets the maximum number of indices that could be rebuilt in parallel in recovery.",
 							NULL,
@@ -504,6 +819,45 @@ _PG_init(void)
 							 NULL,
 							 NULL);
 
+	DefineCustomIntVariable("orioledb.checkpoint_workers",
+							"Number of helper processes checkpointing table trees in parallel.",
+							NULL,
+							&checkpoint_workers,
+							0,
+							0,
+							64,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomRealVariable("orioledb.checkpoint_read_latency_target",
+							 "Page read latency in milliseconds above which the checkpoint slows down.",
+							 "Zero disables the slowdown.",
+							 &checkpoint_read_latency_target,
+							 2.0,
+							 0.0,
+							 1000.0,
+							 PGC_SIGHUP,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("orioledb.buffer_warmup_workers",
+							"Number of workers loading the hot page set after startup.",
+							"Zero disables saving and loading of the hot page set.",
+							&buffer_warmup_workers,
+							0,
+							0,
+							MAX_BACKENDS,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
 	DefineCustomIntVariable("orioledb.bgwriter_num_workers",
 							"Number of background writers.",
 							NULL,
@@ -517,18 +871,223 @@ _PG_init(void)
 							NULL,
 							NULL);
 
-	DefineCustomIntVariable("orioledb.max_io_concurrency",
-							"Number of maximum concurrent IO operations.",
-							NULL,
-							&max_io_concurrency,
-							0,
-							0,
-							INT_MAX,
-							PGC_POSTMASTER,
-							0,
-							NULL,
-							NULL,
-							NULL);
+	DefineCustomIntVariable("orioledb.bgwriter_eviction_queue_size",
+							"Size of the queue of dirty pages for eviction by background writers.",
+							"Zero makes backends write dirty pages being evicted themselves.",
+							&bgwriter_eviction_queue_size,
+							1024,
+							0,
+							INT_MAX / 1024,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.deferred_rollback_threshold",
+							"Size of the transaction undo, which makes its rollback done by the rollback worker.",
+							"-1 disables deferred rollback and the rollback worker.",
+							&deferred_rollback_threshold,
+							-1,
+							-1,
+							INT_MAX,
+							PGC_POSTMASTER,
+							GUC_UNIT_KB,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.max_io_concurrency",
+							"Number of maximum concurrent IO operations.",
+							NULL,
+							&max_io_concurrency,
+							0,
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.background_io_concurrency",
+							"Number of maximum concurrent IO operations of each background IO class.",
+							"Zero means half of orioledb.max_io_concurrency.",
+							&background_io_concurrency,
+							0,
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.adaptive_hash_index_size",
+							"Number of entries in the adaptive hash index over primary key leaves.",
+							"Zero disables the adaptive hash index.",
+							&adaptive_hash_index_size,
+							0,
+							0,
+							INT_MAX / 16,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.zone_map_size",
+							"Number of entries in the zone map over primary key leaves.",
+							"Zero disables the zone map.",
+							&zone_map_size,
+							0,
+							0,
+							INT_MAX / 64,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.bloom_filter_size",
+							"Number of Bloom filters over evicted primary key pages.",
+							"Zero disables the Bloom filters.",
+							&bloom_filter_size,
+							0,
+							0,
+							INT_MAX / 1024,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.pinned_pages_limit",
+							"Maximal percent of the main page pool taken by the pinned trees.",
+							NULL,
+							&pinned_pages_limit,
+							25,
+							0,
+							90,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.key_sample_rate",
+							"Samples one of this number of key lookups and modifications for the hot key reports.",
+							"Zero disables the sampling.",
+							&key_sample_rate,
+							0,
+							0,
+							INT_MAX,
+							PGC_SUSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.free_extents_cache_size",
+							"Number of buckets in the cache of freed extents of compressed trees.",
+							"Zero disables the cache.",
+							&free_extents_cache_size,
+							1024,
+							0,
+							INT_MAX / 1024,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomBoolVariable("orioledb.enable_parallel_index_scan",
+							 "Enables the planner's use of parallel scans of secondary indexes.",
+							 NULL,
+							 &orioledb_enable_parallel_index_scan,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.enable_parallel_bitmap_scan",
+							 "Enables the planner's use of parallel bitmap heap scans.",
+							 NULL,
+							 &orioledb_enable_parallel_bitmap_scan,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.enable_sorted_pk_fetch",
+							 "Enables fetching primary index tuples of secondary index scans in the primary key order.",
+							 NULL,
+							 &orioledb_enable_sorted_pk_fetch,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.enable_index_only_costing",
+							 "Costs index-only scans as never visiting the primary index.",
+							 NULL,
+							 &orioledb_enable_index_only_costing,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.enable_residency_costing",
+							 "Scales the planner page counts of orioledb tables by the residency of their trees.",
+							 NULL,
+							 &orioledb_enable_residency_costing,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.enable_index_prefetch",
+							 "Enables prefetching of the evicted secondary index leaves to be modified.",
+							 NULL,
+							 &orioledb_enable_index_prefetch,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.enable_count_pushdown",
+							 "Enables counting rows of the plain count(*) queries without passing them to the aggregate.",
+							 NULL,
+							 &orioledb_enable_count_pushdown,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.enable_skip_scan",
+							 "Enables skipping over the distinct values of the leading index column during index scans.",
+							 NULL,
+							 &orioledb_enable_skip_scan,
+							 true,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
 
 	DefineCustomBoolVariable("orioledb.use_mmap",
 							 "Store data in the mmap'ed file.",
@@ -541,6 +1100,22 @@ _PG_init(void)
 							 NULL,
 							 NULL);
 
+	DefineCustomBoolVariable("orioledb.direct_io",
+							 "Use direct I/O for data files of uncompressed trees.",
+							 NULL,
+							 &orioledb_direct_io,
+							 false,
+							 PGC_POSTMASTER,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	if (orioledb_direct_io && PG_O_DIRECT == 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("orioledb.direct_io is not supported on this platform")));
+
 	DefineCustomStringVariable("orioledb.device_filename",
 							   "Data file for mmap.",
 							   NULL,
@@ -552,6 +1127,17 @@ _PG_init(void)
 							   NULL,
 							   NULL);
 
+	DefineCustomStringVariable("orioledb.data_stripe_directories",
+							   "Comma-separated list of directories data file segments are striped over.",
+							   NULL,
+							   &data_stripe_directories,
+							   NULL,
+							   PGC_POSTMASTER,
+							   0,
+							   NULL,
+							   NULL,
+							   NULL);
+
 	DefineCustomIntVariable("orioledb.device_length",
 							"Size of mmap.",
 							NULL,
@@ -604,6 +1190,58 @@ _PG_init(void)
 							NULL,
 							NULL);
 
+	DefineCustomIntVariable("orioledb.ctid_cache_size",
+							"Sets the number of ctids each backend reserves at once for tables without a primary key.",
+							NULL,
+							&ctid_cache_size,
+							1,
+							1,
+							1024 * 1024,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.hot_pages_compress",
+							"Compression level of the hottest pages of zstd compressed trees, -1 disables adaptive compression levels.",
+							NULL,
+							&hot_pages_compress,
+							-1,
+							-1,
+							o_compress_max_lvl(),
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.compress_min_saving",
+							"Minimal space saving for the page to be written compressed, 0 requires a single compression block.",
+							NULL,
+							&compress_min_saving,
+							0,
+							0,
+							ORIOLEDB_BLCKSZ / 2,
+							PGC_SIGHUP,
+							GUC_UNIT_BYTE,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.inline_compress_threshold",
+							"Minimal size of a value to be compressed in the primary index leaf.",
+							NULL,
+							&inline_compress_threshold,
+							0,
+							0,
+							O_BTREE_MAX_TUPLE_SIZE,
+							PGC_USERSET,
+							GUC_UNIT_BYTE,
+							NULL,
+							NULL,
+							NULL);
+
 	DefineCustomBoolVariable("orioledb.table_description_compress",
 							 "Display compression column in "
 							 "orioledb_table_description",
@@ -627,6 +1265,19 @@ _PG_init(void)
 							 NULL,
 							 NULL);
 
+	DefineCustomIntVariable("orioledb.data_file_prealloc_size",
+							"Size of the chunks preallocated at the end of the data files.",
+							"Zero disables the preallocation.",
+							&data_file_prealloc_size,
+							0,
+							0,
+							ORIOLEDB_SEGMENT_SIZE / 1024,
+							PGC_SIGHUP,
+							GUC_UNIT_KB,
+							NULL,
+							NULL,
+							NULL);
+
 	DefineCustomBoolVariable("orioledb.s3_mode",
 							 "The OrioleDB function mode on top of S3 storage",
 							 NULL,
@@ -690,6 +1341,92 @@ _PG_init(void)
 							NULL,
 							NULL);
 
+	DefineCustomIntVariable("orioledb.s3_multipart_part_size",
+							"The part size of the multipart uploads of large files to S3.",
+							"Zero disables the multipart uploads.",
+							&s3_multipart_part_size,
+							8192,
+							0,
+							1024 * 1024,
+							PGC_SIGHUP,
+							GUC_UNIT_KB,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.s3_multipart_concurrency",
+							"The number of parts of the multipart upload uploaded concurrently by a S3 worker.",
+							NULL,
+							&s3_multipart_concurrency,
+							4,
+							1,
+							64,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.s3_prefetch_parts",
+							"The number of data file parts scans schedule to load from S3 ahead.",
+							"Zero disables the prefetch.",
+							&s3_prefetch_parts,
+							4,
+							0,
+							1024,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.s3_wal_compression",
+							"The zstd compression level of the WAL files uploaded to S3.",
+							"Zero uploads the WAL files uncompressed.",
+							&s3_wal_compression,
+							0,
+							0,
+							22,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomEnumVariable("orioledb.s3_checksum_algorithm",
+							 "The algorithm of the checksums S3 verifies the uploaded objects with.",
+							 NULL,
+							 &s3_checksum_algorithm,
+							 S3_CHECKSUM_SHA256,
+							 s3_checksum_algorithm_options,
+							 PGC_SIGHUP,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.s3_second_touch_admission",
+							 "Keep the file parts loaded from S3 locally only once they are accessed twice.",
+							 NULL,
+							 &s3_second_touch_admission,
+							 false,
+							 PGC_SIGHUP,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.s3_incremental_backup",
+							 "Upload only the changed chunks of large PostgreSQL files to S3.",
+							 NULL,
+							 &s3_incremental_backup,
+							 false,
+							 PGC_SIGHUP,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
 	DefineCustomStringVariable("orioledb.s3_host",
 							   "S3 host",
 							   NULL,
@@ -861,7 +1598,13 @@ _PG_init(void)
 
 	/* Register background writers */
 	for (i = 0; i < bgwriter_num_workers; i++)
-		register_bgwriter();
+		register_bgwriter(i);
+
+	/* Report the invalid stripe directories at startup */
+	(void) btree_stripe_directories();
+
+	register_warmup_workers();
+	register_rollback_worker();
 
 	if (orioledb_s3_mode)
 	{
@@ -891,6 +1634,7 @@ _PG_init(void)
 	o_compress_init();
 	o_sys_caches_init();
 	RegisterCustomScanMethods(&o_scan_methods);
+	RegisterCustomScanMethods(&o_count_scan_methods);
 
 	btree_insert_context = AllocSetContextCreate(TopMemoryContext,
 												 "orioledb B-tree insert context",
@@ -909,6 +1653,8 @@ _PG_init(void)
 	old_set_rel_pathlist_hook = set_rel_pathlist_hook;
 	set_rel_pathlist_hook = orioledb_set_rel_pathlist_hook;
 	set_plain_rel_pathlist_hook = orioledb_set_plain_rel_pathlist_hook;
+	old_create_upper_paths_hook = create_upper_paths_hook;
+	create_upper_paths_hook = orioledb_create_upper_paths_hook;
 	RegisterXactCallback(undo_xact_callback, NULL);
 	RegisterSubXactCallback(undo_subxact_callback, NULL);
 	CacheRegisterUsercacheCallback(orioledb_usercache_hook, PointerGetDatum(NULL));
@@ -995,7 +1741,6 @@ o_proc_shmem_init(Pointer ptr, bool found)
 				pg_atomic_init_u64(&oProcData[i].undoRetainLocations[j].transactionUndoRetainLocation, InvalidUndoLocation);
 			}
 			pg_atomic_init_u64(&oProcData[i].commitInProgressXlogLocation, OWalInvalidCommitPos);
-			pg_atomic_init_u64(&oProcData[i].xmin, InvalidOXid);
 			oProcData[i].autonomousNestingLevel = 0;
 			memset(&oProcData[i].vxids, 0, sizeof(oProcData[i].vxids));
 			LWLockInitialize(&oProcData[i].undoStackLocationsFlushLock,
@@ -1024,11 +1769,204 @@ ppools_shmem_needs(void)
 
 	for (i = 0; i < OPagePoolTypesCount; i++)
 		size = add_size(size, page_pools_size[i]);
-	size = add_size(size, orioledb_buffers_size);
-	size = add_size(size, page_descs_size);
+	/* The dedicated segment holds shared buffers and page descriptors */
+	if (buffers_huge_pages == BUFFERS_HUGE_PAGES_OFF)
+	{
+		size = add_size(size, orioledb_buffers_size);
+		size = add_size(size, page_descs_size);
+	}
 	return size;
 }
 
+/*
+ * Returns the size of huge page to use for the dedicated segment: either
+ * orioledb.buffers_huge_page_size or the system default from /proc/meminfo.
+ */
+static Size
+get_buffers_huge_page_size(void)
+{
+	Size		result = 2 * 1024 * 1024;
+	FILE	   *fp;
+
+	if (buffers_huge_page_size != 0)
+		return (Size) buffers_huge_page_size * 1024;
+
+	fp = AllocateFile("/proc/meminfo", "r");
+	if (fp)
+	{
+		char		buf[128];
+		unsigned int sz;
+		char		ch;
+
+		while (fgets(buf, sizeof(buf), fp))
+		{
+			if (sscanf(buf, "Hugepagesize: %u %c", &sz, &ch) == 2)
+			{
+				if (ch == 'k')
+					result = (Size) sz * 1024;
+				break;
+			}
+		}
+		FreeFile(fp);
+	}
+	return result;
+}
+
+/*
+ * Maps the dedicated segment for shared buffers and page descriptors.  It's
+ * backed by hugetlb pages if possible, the mapping is inherited by the forked
+ * children.  The segment is reused on the shared memory reinitialization after
+ * a crash.
+ */
+static Pointer
+map_buffers_segment(Size size)
+{
+	Pointer		ptr = MAP_FAILED;
+	Size		pageSize = 0;
+	char		buf[32];
+
+	if (buffers_segment)
+	{
+		Assert(buffers_segment_size >= size);
+		return buffers_segment;
+	}
+
+#ifdef MAP_HUGETLB
+	{
+		Size		hugePageSize = get_buffers_huge_page_size();
+		Size		mapSize = TYPEALIGN(hugePageSize, size);
+		int			flags = MAP_SHARED | MAP_ANONYMOUS | MAP_HUGETLB;
+
+#ifdef MAP_HUGE_SHIFT
+		if (buffers_huge_page_size != 0)
+			flags |= pg_ceil_log2_64(hugePageSize) << MAP_HUGE_SHIFT;
+#endif
+		ptr = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, flags, -1, 0);
+		if (ptr != MAP_FAILED)
+		{
+			pageSize = hugePageSize;
+			size = mapSize;
+		}
+		else
+			ereport(buffers_huge_pages == BUFFERS_HUGE_PAGES_ON ? FATAL : LOG,
+					(errmsg("could not map huge pages segment of %zu bytes for orioledb shared buffers: %m",
+							mapSize),
+					 errhint("Check the number of huge pages of %zu kB available in the system.",
+							 hugePageSize / 1024)));
+	}
+#else
+	if (buffers_huge_pages == BUFFERS_HUGE_PAGES_ON)
+		ereport(FATAL,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("huge pages are not supported on this platform")));
+#endif
+
+	if (ptr == MAP_FAILED)
+	{
+		pageSize = sysconf(_SC_PAGESIZE);
+		size = TYPEALIGN(pageSize, size);
+		ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+				   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if (ptr == MAP_FAILED)
+			ereport(FATAL,
+					(errmsg("could not map segment of %zu bytes for orioledb shared buffers: %m",
+							size)));
+#ifdef MADV_HUGEPAGE
+		/* Transparent huge pages might be still available for shmem */
+		(void) madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+	}
+
+	buffers_segment = ptr;
+	buffers_segment_size = size;
+
+	snprintf(buf, sizeof(buf), "%zu", pageSize / 1024);
+	SetConfigOption("orioledb.buffers_page_size", buf,
+					PGC_INTERNAL, PGC_S_DYNAMIC_DEFAULT);
+	elog(LOG, "orioledb shared buffers are mapped with %zu kB pages",
+		 pageSize / 1024);
+
+	return ptr;
+}
+
+/*
+ * Touches all the memory pages of the given range, so that page faults don't
+ * happen on the first access to the buffers.
+ */
+static void
+prefault_memory(Pointer ptr, Size size)
+{
+	Size		pageSize = sysconf(_SC_PAGESIZE);
+	Size		i;
+
+#ifdef MADV_POPULATE_WRITE
+	uintptr_t	start = TYPEALIGN_DOWN(pageSize, (uintptr_t) ptr);
+
+	if (madvise((void *) start, (uintptr_t) ptr + size - start,
+				MADV_POPULATE_WRITE) == 0)
+		return;
+#endif
+
+	for (i = 0; i < size; i += pageSize)
+		((volatile char *) ptr)[i] = 0;
+}
+
+#if defined(__linux__) && defined(SYS_mbind) && defined(SYS_get_mempolicy)
+/* Constants of <linux/mempolicy.h>, which might be not installed */
+#define O_MPOL_INTERLEAVE		3
+#define O_MPOL_F_MEMS_ALLOWED	(1 << 2)
+#define O_NUMA_MAX_NODES		1024
+/* Alignment of 2MB huge pages, covers the regular pages too */
+#define O_NUMA_ALIGN			(UINT64CONST(1) << 21)
+
+/*
+ * Sets the interleave memory policy for the given shared memory range across
+ * all the NUMA nodes allowed for the postmaster.  Should be called before the
+ * first touch of the memory: otherwise the postmaster initializing shared
+ * buffers places all of them on its own node, and backends of other nodes
+ * have only remote access to the page images.
+ */
+static void
+numa_interleave_memory(Pointer ptr, Size size)
+{
+	unsigned long nodemask[O_NUMA_MAX_NODES / (8 * sizeof(unsigned long))];
+	uintptr_t	start = TYPEALIGN(O_NUMA_ALIGN, (uintptr_t) ptr),
+				end = TYPEALIGN_DOWN(O_NUMA_ALIGN, (uintptr_t) ptr + size);
+	int			nnodes = 0;
+	int			i;
+
+	if (end <= start)
+		return;
+
+	memset(nodemask, 0, sizeof(nodemask));
+	if (syscall(SYS_get_mempolicy, NULL, nodemask, O_NUMA_MAX_NODES,
+				NULL, O_MPOL_F_MEMS_ALLOWED) != 0)
+	{
+		elog(WARNING, "could not get allowed NUMA nodes: %m");
+		return;
+	}
+
+	for (i = 0; i < lengthof(nodemask); i++)
+		nnodes += pg_popcount64(nodemask[i]);
+	if (nnodes <= 1)
+		return;
+
+	if (syscall(SYS_mbind, (void *) start, (unsigned long) (end - start),
+				O_MPOL_INTERLEAVE, nodemask, O_NUMA_MAX_NODES, 0) != 0)
+		elog(WARNING, "could not interleave orioledb shared buffers across %d NUMA nodes: %m",
+			 nnodes);
+	else
+		elog(LOG, "orioledb shared buffers are interleaved across %d NUMA nodes",
+			 nnodes);
+}
+#else
+static void
+numa_interleave_memory(Pointer ptr, Size size)
+{
+	elog(WARNING, "orioledb.numa_interleave is not supported on this platform");
+}
+#endif
+
 static void
 ppools_shmem_init(Pointer ptr, bool found)
 {
@@ -1040,10 +1978,19 @@ ppools_shmem_init(Pointer ptr, bool found)
 		page_pools_ptr[i] = ptr;
 		ptr += page_pools_size[i];
 	}
+	if (buffers_huge_pages != BUFFERS_HUGE_PAGES_OFF)
+		ptr = map_buffers_segment(orioledb_buffers_size + page_descs_size);
 	o_shared_buffers = ptr;
 	ptr += orioledb_buffers_size;
 	page_descs = (OrioleDBPageDesc *) ptr;
 
+	if (!found && numa_interleave)
+		numa_interleave_memory(o_shared_buffers,
+							   orioledb_buffers_size + page_descs_size);
+	if (!found && buffers_prefault)
+		prefault_memory(o_shared_buffers,
+						orioledb_buffers_size + page_descs_size);
+
 	for (i = 0; i < OPagePoolTypesCount; i++)
 		ppool_shmem_init(&page_pools[i], page_pools_ptr[i], found);
 
@@ -1069,6 +2016,10 @@ ppools_shmem_init(Pointer ptr, bool found)
 			page_descs[i].ionum = -1;
 			page_descs[i].type = 0;
 			page_descs[i].flags = 0;
+			page_descs[i].nReads = 0;
+			page_descs[i].nWrites = 0;
+			page_descs[i].parentBlkno = OInvalidInMemoryBlkno;
+			pg_atomic_init_u32(&page_descs[i].subtreeDirty, 1);
 			proclist_init(&page_descs[i].waitersList);
 		}
 	}
@@ -1094,7 +2045,7 @@ static void
 orioledb_on_shmem_exit(int code, Datum arg)
 {
 	if (MyProc)
-		pg_atomic_write_u64(&oProcData[MYPROCNUMBER].xmin, InvalidOXid);
+		pg_atomic_write_u64(&oProcXmins[MYPROCNUMBER], InvalidOXid);
 
 	if (orioledb_s3_mode)
 		s3_delete_lock_file();
@@ -1421,6 +2372,68 @@ orioledb_page_stats(PG_FUNCTION_ARGS)
 	return (Datum) 0;
 }
 
+/*
+ * Returns the cumulative statistics of the page pools.  Reads only a few
+ * shared counters per pool, so it's cheap enough for frequent monitoring.
+ */
+Datum
+orioledb_page_pool_stats(PG_FUNCTION_ARGS)
+{
+	Datum		values[14];
+	bool		nulls[14];
+	int			i;
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	static const char *const pool_names[OPagePoolTypesCount] =
+	{
+		"main", "free_tree", "catalog"
+	};
+
+	orioledb_check_shmem();
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	MemSet(nulls, 0, sizeof(nulls));
+	for (i = 0; i < OPagePoolTypesCount; i++)
+	{
+		OPagePool  *pool = &page_pools[i];
+		OPagePoolStats *stats = pool->stats;
+
+		values[0] = CStringGetTextDatum(pool_names[i]);
+		values[1] = Int64GetDatum((int64) ppool_free_pages_count(pool));
+		values[2] = Int64GetDatum((int64) ppool_dirty_pages_count(pool));
+		values[3] = Int64GetDatum(pg_atomic_read_u64(&stats->gets));
+		values[4] = Int64GetDatum(pg_atomic_read_u64(&stats->misses));
+		values[5] = Int64GetDatum(pg_atomic_read_u64(&stats->clockRuns));
+		values[6] = Int64GetDatum(pg_atomic_read_u64(&stats->clockIterations));
+		values[7] = Int64GetDatum(pg_atomic_read_u64(&stats->backendEvictions));
+		values[8] = Int64GetDatum(pg_atomic_read_u64(&stats->backendWrites));
+		values[9] = Int64GetDatum(pg_atomic_read_u64(&stats->bgwriterEvictions));
+		values[10] = Int64GetDatum(pg_atomic_read_u64(&stats->bgwriterWrites));
+		values[11] = Int64GetDatum(pg_atomic_read_u64(&stats->queuedEvictions));
+		values[12] = Int64GetDatum(pg_atomic_read_u64(&stats->queuedEvicted));
+		values[13] = Int64GetDatum(pg_atomic_read_u64(&stats->merges));
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
 Datum
 orioledb_ucm_check(PG_FUNCTION_ARGS)
 {
@@ -1596,6 +2609,7 @@ orioledb_error_cleanup_hook(void)
 		release_undo_size((UndoLogType) i);
 	btree_mark_incomplete_splits();
 	unset_skip_ucm();
+	unset_cold_ucm();
 	btree_io_error_cleanup();
 	o_reset_syscache_hooks();
 	o_rewrite_cleanup();
@@ -1621,6 +2635,27 @@ orioledb_get_relation_info_hook(PlannerInfo *root,
 		if (rel->rel_parallel_workers > 0)
 			elog(WARNING, "Rel parallel workers = %d", rel->rel_parallel_workers);
 
+		/*
+		 * Index-only scans take the visibility from the undo of the index
+		 * tree itself and never look into the primary index.  So, they are
+		 * costed as if the whole relation is all-visible.
+		 */
+		if (orioledb_enable_index_only_costing)
+			rel->allvisfrac = 1.0;
+
+		/*
+		 * Resident trees cost almost nothing to read, while the evicted
+		 * trees of S3 cost more than the local ones.
+		 */
+		if (orioledb_enable_residency_costing && !inhparent)
+		{
+			OTableDescr *descr = relation_get_descr(relation);
+
+			if (descr)
+				rel->pages = o_tree_costed_pages(&GET_PRIMARY(descr)->desc,
+												 rel->pages);
+		}
+
 		if (relation->rd_rel->relhasindex)
 		{
 			int			i;
@@ -1672,6 +2707,10 @@ orioledb_get_relation_info_hook(PlannerInfo *root,
 					rootPageBlkno = index_descr->desc.rootInfo.rootPageBlkno;
 					root_page = O_GET_IN_MEMORY_PAGE(rootPageBlkno);
 					info->tree_height = PAGE_GET_LEVEL(root_page);
+
+					if (orioledb_enable_residency_costing)
+						info->pages = o_tree_costed_pages(&index_descr->desc,
+														  info->pages);
 				}
 			}
 		}
@@ -147,17 +147,19 @@ convert_toast_pointers(OTableDescr *descr, OIndexDescr *indexDescr,
 	Datum	   *new_values = palloc0(natts * sizeof(Datum));
 	bool	   *isnull = palloc0(natts * sizeof(bool));
 	int			ctid_off = indexDescr->primaryIsCtid ? 1 : 0;
+	OTupleReaderState reader;
 
 	/*
 	 * Decode original tuple.
 	 */
 	Assert(descr->toast);
+	o_tuple_init_reader(&reader, tuple.tuple, descr->tupdesc,
+						&indexDescr->leafSpec);
 	for (int i = 0; i < natts; i++)
 	{
-		old_values[i] = o_fastgetattr(tuple.tuple, i + 1,
-									  descr->tupdesc,
-									  &indexDescr->leafSpec,
-									  &isnull[i]);
+		old_values[i] = o_tuple_read_field(&reader, tuple.tuple, i + 1,
+										   &indexDescr->leafSpec,
+										   &isnull[i]);
 		new_values[i] = old_values[i];
 	}
 
@@ -215,8 +217,12 @@ orioledb_decode(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 	XLogReaderState *record = buf->record;
 	XLogRecPtr	startXLogPtr = record->ReadRecPtr;
 	XLogRecPtr	endXLogPtr = record->EndRecPtr;
-	Pointer		startPtr = (Pointer) XLogRecGetData(record);
-	Pointer		endPtr = startPtr + XLogRecGetDataLen(record);
+	int			recLength = XLogRecGetDataLen(record);
+	int			containerLength = recLength;
+	Pointer		startPtr = wal_container_decompress(XLogRecGetInfo(record) & ~XLR_INFO_MASK,
+													(Pointer) XLogRecGetData(record),
+													&containerLength);
+	Pointer		endPtr = startPtr + containerLength;
 	Pointer		ptr = startPtr;
 	OTableDescr *descr = NULL;
 	OIndexDescr *indexDescr = NULL;
@@ -229,6 +235,7 @@ orioledb_decode(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 	OIndexType	ix_type = oIndexInvalid;
 	TupleDescData *o_toast_tupDesc = NULL;
 	TupleDescData *heap_toast_tupDesc = NULL;
+	bool		skipRelation = false;
 
 	while (ptr < endPtr)
 	{
@@ -247,6 +254,7 @@ orioledb_decode(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 			 rec_type == WAL_REC_ROLLBACK_TO_SAVEPOINT ? "ROLLBACK TO SAVEPOINT" :
 			 rec_type == WAL_REC_INSERT ? "INSERT" :
 			 rec_type == WAL_REC_UPDATE ? "UPDATE" :
+			 rec_type == WAL_REC_UPDATE_DELTA ? "UPDATE DELTA" :
 			 rec_type == WAL_REC_DELETE ? "DELETE" : "_UNKNOWN");
 
 		if (rec_type == WAL_REC_XID)
@@ -366,7 +374,22 @@ orioledb_decode(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 			else
 				sys_tree_num = -1;
 
-			if (sys_tree_num > 0)
+			/*
+			 * Decide once per relation record whether its changes are going
+			 * to be decoded.  The changes of the skipped relations are
+			 * stepped over without fetching the descriptors or deserializing
+			 * the tuples.
+			 */
+			skipRelation = (ctx->fast_forward ||
+							cur_oids.datoid != ctx->slot->data.database ||
+							sys_tree_num > 0 ||
+							(ix_type != oIndexInvalid && ix_type != oIndexToast));
+			if (skipRelation)
+			{
+				descr = NULL;
+				indexDescr = NULL;
+			}
+			else if (sys_tree_num > 0)
 			{
 				descr = NULL;
 				/* indexDescr = NULL; */
@@ -384,7 +407,12 @@ orioledb_decode(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 				indexDescr = o_fetch_index_descr(cur_oids, ix_type, false, NULL);
 				descr = o_fetch_table_descr(indexDescr->tableOids);
 				o_toast_tupDesc = descr->toast->leafTupdesc;
-				/* Init heap tupledesc for toast table */
+			}
+
+			/* Init heap tupledesc for toast table once per container */
+			if (!skipRelation && ix_type == oIndexToast &&
+				heap_toast_tupDesc == NULL)
+			{
 				heap_toast_tupDesc = CreateTemplateTupleDesc(3);
 				TupleDescInitEntry(heap_toast_tupDesc, (AttrNumber) 1, "chunk_id", OIDOID, -1, 0);
 				TupleDescInitEntry(heap_toast_tupDesc, (AttrNumber) 2, "chunk_seq", INT4OID, -1, 0);
@@ -466,11 +494,24 @@ orioledb_decode(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 
 			/* Skip */
 		}
+		else if (rec_type == WAL_REC_UPDATE_DELTA)
+		{
+			/*
+			 * Delta records are never written under wal_level = logical, and
+			 * they can't be decoded without the old tuple version.
+			 */
+			ereport(ERROR,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					 errmsg("cannot decode orioledb update delta WAL record"),
+					 errhint("Set \"orioledb.wal_update_delta\" to off or "
+							 "\"wal_level\" to \"logical\" on the primary.")));
+		}
 		else
 		{
 			OFixedTuple tuple;
 			ReorderBufferChange *change;
-			XLogRecPtr	changeXLogPtr = startXLogPtr + (ptr - startPtr);
+			XLogRecPtr	changeXLogPtr = startXLogPtr +
+				(uint64) (ptr - startPtr) * recLength / (endPtr - startPtr);
 
 			Assert(rec_type == WAL_REC_INSERT || rec_type == WAL_REC_UPDATE || rec_type == WAL_REC_DELETE);
 
@@ -482,7 +523,8 @@ orioledb_decode(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 			memcpy(&length, ptr, sizeof(OffsetNumber));
 			ptr += sizeof(OffsetNumber);
 
-			if (SnapBuildCurrentState(ctx->snapshot_builder) < SNAPBUILD_FULL_SNAPSHOT)
+			if (skipRelation ||
+				SnapBuildCurrentState(ctx->snapshot_builder) < SNAPBUILD_FULL_SNAPSHOT)
 			{
 				ptr += length;
 				continue;
@@ -687,6 +729,17 @@ orioledb_decode(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 											 changeXLogPtr,
 											 change, false);
 				}
+				else if (rec_type == WAL_REC_DELETE && ix_type == oIndexToast)
+				{
+					/*
+					 * Reorder buffer ignores the deletions of TOAST chunks.
+					 * Don't queue them: they only take the memory and, being
+					 * queued as TOAST inserts, they would mark the
+					 * transaction as having a partial change.  That prevents
+					 * streaming of the in-progress transaction till the next
+					 * insert or update.
+					 */
+				}
 				else if (rec_type == WAL_REC_DELETE)
 				{
 					change = ReorderBufferGetChange(ctx->reorder);
@@ -701,43 +754,31 @@ orioledb_decode(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 					change->data.tp.relnode.relNode = cur_oids.relnode;
 #endif
 					elog(DEBUG4, "reloid: %u", cur_oids.reloid);
-					if (ix_type == oIndexToast)
+					change->data.tp.clear_toast_afterwards = true;
+
+					/*
+					 * Primary table contains TOASTed attributes needs
+					 * conversion of them
+					 */
+					if (descr->ntoastable > 0)
+					{
+						HeapTuple	oldheaptuple;
+
+						oldheaptuple = convert_toast_pointers(descr, indexDescr, tuple);
+						change->data.tp.oldtuple = record_buffer_tuple(ctx->reorder, oldheaptuple, true);
+					}
+					else		/* Tuple without TOASTed attrs */
 					{
-						change->data.tp.clear_toast_afterwards = false;
 						tts_orioledb_store_non_leaf_tuple(descr->oldTuple, tuple.tuple,
 														  descr, COMMITSEQNO_INPROGRESS,
 														  PrimaryIndexNumber, false,
 														  NULL);
 						change->data.tp.oldtuple = record_buffer_tuple_slot(ctx->reorder, descr->oldTuple);
-					}
-					else
-					{
-						change->data.tp.clear_toast_afterwards = true;
 
-						/*
-						 * Primary table contains TOASTed attributes needs
-						 * conversion of them
-						 */
-						if (descr->ntoastable > 0)
-						{
-							HeapTuple	oldheaptuple;
-
-							oldheaptuple = convert_toast_pointers(descr, indexDescr, tuple);
-							change->data.tp.oldtuple = record_buffer_tuple(ctx->reorder, oldheaptuple, true);
-						}
-						else	/* Tuple without TOASTed attrs */
-						{
-							tts_orioledb_store_non_leaf_tuple(descr->oldTuple, tuple.tuple,
-															  descr, COMMITSEQNO_INPROGRESS,
-															  PrimaryIndexNumber, false,
-															  NULL);
-							change->data.tp.oldtuple = record_buffer_tuple_slot(ctx->reorder, descr->oldTuple);
-
-						}
 					}
 					ReorderBufferQueueChange(ctx->reorder, logicalXid,
 											 changeXLogPtr,
-											 change, (ix_type == oIndexToast));
+											 change, false);
 				}
 			}
 
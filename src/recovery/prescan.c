@@ -0,0 +1,424 @@
+/*-------------------------------------------------------------------------
+ *
+ * prescan.c
+ *		Pre-scan of the WAL to find trees dropped before the end of recovery.
+ *
+ * Copyright (c) 2021-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/recovery/prescan.c
+ *
+ * NOTES
+ *
+ *		Before the crash recovery starts, the startup process reads all the
+ *		WAL available in pg_wal and collects the trees, which are dropped by
+ *		the committed transactions.  Relnodes are never reused.  So, once the
+ *		drop of the tree is committed, all the modifications of the tree in
+ *		the WAL precede the drop, and replaying them is a waste.  The replay
+ *		skips them as if the tree doesn't exist.
+ *
+ *		The table is dropped by deletion of its o_tables entry, together with
+ *		its o_indices entries.  Only index trees dropped along with their
+ *		table are collected, the standalone index drops are left to the
+ *		regular replay.  Transactions rolled back to a savepoint are ignored
+ *		as well as prepared transactions, because the drop might be undone.
+ *
+ *		The pre-scan is only done during crash recovery.  Archive recovery
+ *		and standby replay don't have the whole WAL upfront.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "catalog/sys_trees.h"
+#include "checkpoint/checkpoint.h"
+#include "recovery/recovery.h"
+#include "recovery/wal.h"
+
+#include "access/rmgr.h"
+#include "access/xact.h"
+#include "access/xlog_internal.h"
+#include "access/xlogreader.h"
+#include "access/xlogrecovery.h"
+#include "storage/fd.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+
+#include <unistd.h>
+
+/*
+ * GUC value, enables the pre-scan of the WAL for the dropped trees.
+ */
+bool		recovery_skip_dropped_guc = false;
+
+/* The tree dropped by the transaction together with its table */
+typedef struct
+{
+	ORelOids	treeOids;
+	ORelOids	tableOids;
+} PrescanDrop;
+
+/* The transaction, which dropped something */
+typedef struct
+{
+	OXid		oxid;
+	/* PostgreSQL xid of the joint commit */
+	TransactionId xid;
+	/* false if the transaction was rolled back to a savepoint */
+	bool		valid;
+	int			nDrops;
+	int			allocDrops;
+	PrescanDrop *drops;
+} PrescanXact;
+
+typedef struct
+{
+	TimeLineID	tli;
+	int			fd;
+	XLogSegNo	segno;
+} PrescanReadState;
+
+static MemoryContext prescan_context = NULL;
+static HTAB *prescan_xacts = NULL;
+static HTAB *dropped_trees = NULL;
+
+static int
+prescan_page_read(XLogReaderState *reader, XLogRecPtr targetPagePtr,
+				  int reqLen, XLogRecPtr targetRecPtr, char *readBuf)
+{
+	PrescanReadState *state = (PrescanReadState *) reader->private_data;
+	XLogSegNo	segno;
+	uint32		offset;
+
+	XLByteToSeg(targetPagePtr, segno, wal_segment_size);
+	offset = XLogSegmentOffset(targetPagePtr, wal_segment_size);
+
+	if (state->fd < 0 || state->segno != segno)
+	{
+		char		path[MAXPGPATH];
+
+		if (state->fd >= 0)
+			close(state->fd);
+		XLogFilePath(path, state->tli, segno, wal_segment_size);
+		state->fd = BasicOpenFile(path, O_RDONLY | PG_BINARY);
+		state->segno = segno;
+		if (state->fd < 0)
+			return -1;
+	}
+
+	if (pg_pread(state->fd, readBuf, XLOG_BLCKSZ, offset) != XLOG_BLCKSZ)
+		return -1;
+
+	return XLOG_BLCKSZ;
+}
+
+static void
+prescan_add_drop(OXid oxid, ORelOids treeOids, ORelOids tableOids)
+{
+	PrescanXact *xact;
+	bool		found;
+
+	xact = (PrescanXact *) hash_search(prescan_xacts, &oxid, HASH_ENTER,
+									   &found);
+	if (!found)
+	{
+		xact->xid = InvalidTransactionId;
+		xact->valid = true;
+		xact->nDrops = 0;
+		xact->allocDrops = 4;
+		xact->drops = (PrescanDrop *) MemoryContextAlloc(prescan_context,
+														 sizeof(PrescanDrop) * xact->allocDrops);
+	}
+	else if (xact->nDrops >= xact->allocDrops)
+	{
+		xact->allocDrops *= 2;
+		xact->drops = (PrescanDrop *) repalloc(xact->drops,
+											   sizeof(PrescanDrop) * xact->allocDrops);
+	}
+
+	xact->drops[xact->nDrops].treeOids = treeOids;
+	xact->drops[xact->nDrops].tableOids = tableOids;
+	xact->nDrops++;
+}
+
+/*
+ * Moves the drops of the finished transaction to the dropped trees on
+ * commit and forgets them on abort.
+ */
+static void
+prescan_finish_xact(PrescanXact *xact, bool commit)
+{
+	int			i,
+				j;
+
+	for (i = 0; commit && xact->valid && i < xact->nDrops; i++)
+	{
+		PrescanDrop *drop = &xact->drops[i];
+
+		/* Take only trees dropped together with their table */
+		for (j = 0; j < xact->nDrops; j++)
+		{
+			if (ORelOidsIsEqual(xact->drops[j].treeOids,
+								xact->drops[j].tableOids) &&
+				ORelOidsIsEqual(xact->drops[j].tableOids, drop->tableOids))
+				break;
+		}
+
+		if (j < xact->nDrops)
+			(void) hash_search(dropped_trees, &drop->treeOids, HASH_ENTER,
+							   NULL);
+	}
+
+	pfree(xact->drops);
+	(void) hash_search(prescan_xacts, &xact->oxid, HASH_REMOVE, NULL);
+}
+
+static void
+prescan_container(Pointer startPtr, Pointer endPtr)
+{
+	Pointer		ptr = startPtr;
+	OXid		oxid = InvalidOXid;
+	ORelOids	oids = {0, 0, 0};
+	PrescanXact *xact;
+
+	while (ptr < endPtr)
+	{
+		uint8		rec_type = *ptr;
+
+		switch (rec_type)
+		{
+			case WAL_REC_XID:
+				memcpy(&oxid, ptr + offsetof(WALRecXid, oxid), sizeof(OXid));
+				ptr += sizeof(WALRecXid);
+				break;
+			case WAL_REC_COMMIT:
+			case WAL_REC_ROLLBACK:
+				xact = (PrescanXact *) hash_search(prescan_xacts, &oxid,
+												   HASH_FIND, NULL);
+				if (xact)
+					prescan_finish_xact(xact, rec_type == WAL_REC_COMMIT);
+				ptr += sizeof(WALRecFinish);
+				break;
+			case WAL_REC_JOINT_COMMIT:
+				xact = (PrescanXact *) hash_search(prescan_xacts, &oxid,
+												   HASH_FIND, NULL);
+				if (xact)
+					memcpy(&xact->xid, ptr + offsetof(WALRecJointCommit, xid),
+						   sizeof(TransactionId));
+				ptr += sizeof(WALRecJointCommit);
+				break;
+			case WAL_REC_RELATION:
+				memcpy(&oids.datoid, ptr + offsetof(WALRecRelation, datoid),
+					   sizeof(Oid));
+				memcpy(&oids.reloid, ptr + offsetof(WALRecRelation, reloid),
+					   sizeof(Oid));
+				memcpy(&oids.relnode, ptr + offsetof(WALRecRelation, relnode),
+					   sizeof(Oid));
+				ptr += sizeof(WALRecRelation);
+				break;
+			case WAL_REC_O_TABLES_META_LOCK:
+				ptr += sizeof(WALRec);
+				break;
+			case WAL_REC_O_TABLES_META_UNLOCK:
+				ptr += sizeof(WALRecOTablesUnlockMeta);
+				break;
+			case WAL_REC_SAVEPOINT:
+				ptr += sizeof(WALRecSavepoint);
+				break;
+			case WAL_REC_ROLLBACK_TO_SAVEPOINT:
+				xact = (PrescanXact *) hash_search(prescan_xacts, &oxid,
+												   HASH_FIND, NULL);
+				if (xact)
+					xact->valid = false;
+				ptr += sizeof(WALRecRollbackToSavepoint);
+				break;
+			case WAL_REC_TRUNCATE:
+				ptr += sizeof(WALRecTruncate);
+				break;
+			case WAL_REC_INSERT:
+			case WAL_REC_UPDATE:
+			case WAL_REC_DELETE:
+			case WAL_REC_UPDATE_DELTA:
+				{
+					OffsetNumber length;
+					Pointer		data;
+
+					memcpy(&length, ptr + offsetof(WALRecModify, length),
+						   sizeof(OffsetNumber));
+					data = ptr + sizeof(WALRecModify);
+					ptr = data + length;
+
+					if (rec_type != WAL_REC_DELETE || !OXidIsValid(oxid))
+						break;
+
+					if (OIDS_EQ_SYS_TREE(oids, SYS_TREES_O_TABLES))
+					{
+						OTableChunkKey key;
+
+						Assert(length >= sizeof(key));
+						memcpy(&key, data, sizeof(key));
+						if (key.chunknum == 0)
+							prescan_add_drop(oxid, key.oids, key.oids);
+					}
+					else if (OIDS_EQ_SYS_TREE(oids, SYS_TREES_O_INDICES))
+					{
+						OIndexChunk chunk;
+						ORelOids	tableOids;
+
+						/* o_indices deletions are logged with full tuples */
+						Assert(length >= offsetof(OIndexChunk, data) +
+							   sizeof(tableOids));
+						memcpy(&chunk, data, offsetof(OIndexChunk, data));
+						if (chunk.key.chunknum != 0)
+							break;
+						memcpy(&tableOids, data + offsetof(OIndexChunk, data),
+							   sizeof(tableOids));
+						prescan_add_drop(oxid, chunk.key.oids, tableOids);
+					}
+					break;
+				}
+			default:
+				/* Unknown record, stop parsing the container */
+				elog(WARNING, "unknown orioledb WAL record type %u during pre-scan",
+					 rec_type);
+				return;
+		}
+	}
+}
+
+/*
+ * Handles the PostgreSQL commit or abort of the joint commit transactions.
+ */
+static void
+prescan_xact_record(XLogReaderState *reader)
+{
+	uint8		info = XLogRecGetInfo(reader) & XLOG_XACT_OPMASK;
+	TransactionId xid = XLogRecGetXid(reader);
+	HASH_SEQ_STATUS status;
+	PrescanXact *xact;
+
+	if (info != XLOG_XACT_COMMIT && info != XLOG_XACT_ABORT)
+		return;
+
+	if (hash_get_num_entries(prescan_xacts) == 0)
+		return;
+
+	hash_seq_init(&status, prescan_xacts);
+	while ((xact = (PrescanXact *) hash_seq_search(&status)) != NULL)
+	{
+		if (TransactionIdIsValid(xact->xid) &&
+			TransactionIdEquals(xact->xid, xid))
+		{
+			hash_seq_term(&status);
+			prescan_finish_xact(xact, info == XLOG_XACT_COMMIT);
+			break;
+		}
+	}
+}
+
+/*
+ * Reads the WAL to be replayed and collects the trees dropped by the
+ * committed transactions.
+ */
+void
+recovery_prescan_dropped_trees(void)
+{
+	XLogReaderState *reader;
+	PrescanReadState state;
+	XLogRecPtr	startPtr;
+	XLogRecPtr	first;
+	char	   *errormsg;
+	HASHCTL		ctl;
+
+	dropped_trees = NULL;
+	if (!recovery_skip_dropped_guc || ArchiveRecoveryRequested)
+		return;
+
+	startPtr = GetXLogReplayRecPtr(&state.tli);
+	startPtr = Max(startPtr, checkpoint_state->controlReplayStartPtr);
+	state.fd = -1;
+	state.segno = 0;
+
+	prescan_context = AllocSetContextCreate(TopMemoryContext,
+											"orioledb recovery pre-scan context",
+											ALLOCSET_DEFAULT_SIZES);
+
+	MemSet(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(OXid);
+	ctl.entrysize = sizeof(PrescanXact);
+	ctl.hcxt = prescan_context;
+	prescan_xacts = hash_create("orioledb recovery pre-scan xacts hash",
+								16, &ctl,
+								HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	MemSet(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(ORelOids);
+	ctl.entrysize = sizeof(ORelOids);
+	ctl.hcxt = TopMemoryContext;
+	dropped_trees = hash_create("orioledb recovery dropped trees hash",
+								16, &ctl,
+								HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	reader = XLogReaderAllocate(wal_segment_size, NULL,
+								XL_ROUTINE(.page_read = prescan_page_read,
+										   .segment_open = NULL,
+										   .segment_close = NULL),
+								&state);
+	if (!reader)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory"),
+				 errdetail("Failed while allocating a WAL reading processor.")));
+
+	first = XLogFindNextRecord(reader, startPtr);
+	if (!XLogRecPtrIsInvalid(first))
+	{
+		XLogBeginRead(reader, first);
+		while (XLogReadRecord(reader, &errormsg) != NULL)
+		{
+			RmgrId		rmid = XLogRecGetRmid(reader);
+
+			if (rmid == ORIOLEDB_RMGR_ID &&
+				reader->ReadRecPtr >= checkpoint_state->controlReplayStartPtr)
+			{
+				uint8		info = XLogRecGetInfo(reader) & ~XLR_INFO_MASK;
+				Pointer		data = XLogRecGetData(reader);
+				int			length = XLogRecGetDataLen(reader);
+
+				data = wal_container_decompress(info, data, &length);
+				prescan_container(data, data + length);
+			}
+			else if (rmid == RM_XACT_ID)
+			{
+				prescan_xact_record(reader);
+			}
+			CHECK_FOR_INTERRUPTS();
+		}
+	}
+
+	if (state.fd >= 0)
+		close(state.fd);
+	XLogReaderFree(reader);
+
+	/* Transactions not finished within the WAL don't drop anything */
+	MemoryContextDelete(prescan_context);
+	prescan_context = NULL;
+	prescan_xacts = NULL;
+
+	elog(LOG, "orioledb recovery pre-scan found %ld dropped trees",
+		 hash_get_num_entries(dropped_trees));
+}
+
+/*
+ * Checks if the tree is known to be dropped before the end of recovery.
+ */
+bool
+recovery_tree_is_dropped(ORelOids oids)
+{
+	if (dropped_trees == NULL)
+		return false;
+
+	return hash_search(dropped_trees, &oids, HASH_FIND, NULL) != NULL;
+}
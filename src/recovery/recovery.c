@@ -15,7 +15,9 @@
 #include "orioledb.h"
 
 #include "btree/btree.h"
+#include "btree/find.h"
 #include "btree/io.h"
+#include "btree/iterator.h"
 #include "btree/modify.h"
 #include "btree/undo.h"
 #include "catalog/free_extents.h"
@@ -24,6 +26,7 @@
 #include "checkpoint/checkpoint.h"
 #include "recovery/recovery.h"
 #include "recovery/internal.h"
+#include "recovery/ring.h"
 #include "recovery/wal.h"
 #include "tableam/descr.h"
 #include "tableam/operations.h"
@@ -37,6 +40,8 @@
 #include "access/hash.h"
 #include "access/xlog_internal.h"
 #include "access/xlogrecovery.h"
+#include "common/hashfn.h"
+#include "funcapi.h"
 #include "lib/ilist.h"
 #include "lib/pairingheap.h"
 #include "miscadmin.h"
@@ -45,9 +50,12 @@
 #include "pgstat.h"
 #include "replication/message.h"
 #include "storage/ipc.h"
-#include "storage/shm_mq.h"
 #include "storage/standby.h"
+#include "utils/builtins.h"
+#include "utils/jsonb.h"
 #include "utils/memutils.h"
+#include "utils/pg_lsn.h"
+#include "utils/tuplestore.h"
 #include "utils/typcache.h"
 
 #include <unistd.h>
@@ -58,7 +66,7 @@
 typedef struct
 {
 	/* Pointer to the worker queue */
-	shm_mq_handle *queue;
+	RecoveryRing *queue;
 	char		queue_buf[RECOVERY_QUEUE_BUF_SIZE];
 	int			queue_buf_len;
 	/* Current oids */
@@ -127,6 +135,9 @@ typedef struct
 
 
 PG_FUNCTION_INFO_V1(orioledb_recovery_synchronized);
+PG_FUNCTION_INFO_V1(orioledb_recovery_consistent_lsn);
+PG_FUNCTION_INFO_V1(orioledb_recovery_stats);
+PG_FUNCTION_INFO_V1(orioledb_recovery_worker_stats);
 
 /*
  * Comparator for regular retain min-heap.
@@ -256,6 +267,38 @@ int			recovery_queue_size_guc;
 
 int			recovery_parallel_indices_rebuild_limit_guc;
 
+/*
+ * GUC value, enables moving hash buckets between recovery workers.
+ */
+bool		recovery_rebalance_guc = true;
+
+/*
+ * GUC value, enables prefetching of the evicted pages to be modified by the
+ * recovery workers.
+ */
+bool		recovery_prefetch_guc = true;
+
+/*
+ * Modify records are spread to the workers by hash buckets of their keys.
+ * Buckets are mapped to the workers and the mapping is periodically
+ * rebalanced.
+ */
+#define RECOVERY_HASH_BUCKETS (4096)
+#define RECOVERY_REBALANCE_INTERVAL (16384)
+
+typedef struct
+{
+	int			worker_id;
+	/* number of records since last rebalance, decays exponentially */
+	uint32		load;
+	/* the last record put into the bucket */
+	OXid		lastOxid;
+	XLogRecPtr	lastPtr;
+} RecoveryHashBucket;
+
+static RecoveryHashBucket *recovery_buckets = NULL;
+static uint32 recovery_rebalance_counter = 0;
+
 /*
  * Are TOAST trees consistent with primary indices.
  */
@@ -295,7 +338,8 @@ static void o_handle_startup_proc_interrupts_hook(void);
 static void abort_recovery(RecoveryWorkerState *workers_pool, bool send_to_idx_pool);
 
 static void replay_container(Pointer ptr, Pointer endPtr,
-							 bool single, XLogRecPtr xlogRecPtr);
+							 bool single, XLogRecPtr xlogRecPtr,
+							 int recLength);
 
 static void worker_send_modify(int worker_id, BTreeDescr *desc, uint16 recType,
 							   OTuple tuple, int tuple_len);
@@ -311,7 +355,7 @@ static inline bool apply_sys_tree_modify_record(int sys_tree_num, uint16 type,
 												OTuple tup,
 												OXid oxid, CommitSeqNo csn);
 static inline void spread_idx_modify(BTreeDescr *desc, uint16 recType,
-									 OTuple rec);
+									 OTuple rec, XLogRecPtr ptr);
 
 static inline uint16 recovery_msg_from_wal_record(uint8 wal_record);
 static void recovery_send_init(int worker_num);
@@ -410,10 +454,12 @@ recovery_shmem_init(Pointer ptr, bool found)
 
 		for (i = 0; i < recovery_pool_size_guc + recovery_idx_pool_size_guc; i++)
 		{
-			shm_mq_create(GET_WORKER_QUEUE(i), recovery_queue_data_size);
+			recovery_ring_create(GET_WORKER_QUEUE(i), recovery_queue_data_size);
 			pg_atomic_init_u64(&worker_ptrs[i].commitPtr, InvalidXLogRecPtr);
 			pg_atomic_init_u64(&worker_ptrs[i].retainPtr, InvalidXLogRecPtr);
 			worker_ptrs[i].flushedUndoLocCompletedCheckpointNumber = 0;
+			pg_atomic_init_u64(&worker_ptrs[i].appliedRecords, 0);
+			pg_atomic_init_u64(&worker_ptrs[i].appliedBytes, 0);
 		}
 		pg_atomic_init_u64(recovery_ptr, InvalidXLogRecPtr);
 		pg_atomic_init_u64(recovery_main_retain_ptr, InvalidXLogRecPtr);
@@ -436,6 +482,9 @@ undo_stack_locations_set_invalid(UndoStackLocations *location)
 	location->onCommitLocation = InvalidUndoLocation;
 }
 
+/* Number of xids file records read at once */
+#define XIDS_READ_BATCH		1024
+
 /*
  * Read information about undo locations of in-progress transactions.
  */
@@ -447,6 +496,9 @@ read_xids(int checkpointnum, bool recovery_single, int worker_id)
 	off_t		offset = 0;
 	uint32		count = 0,
 				i;
+	XidFileRec *xidRecs;
+	uint32		nBuffered = 0,
+				bufferPos = 0;
 
 	xidFile = PathNameOpenFile(xidFilename, O_RDONLY | PG_BINARY);
 	if (xidFile < 0)
@@ -460,17 +512,32 @@ read_xids(int checkpointnum, bool recovery_single, int worker_id)
 						errmsg("could not read xid record from file %s", xidFilename)));
 	offset += sizeof(count);
 
+	/*
+	 * The file is huge after a crash under heavy load, so read it in batches
+	 * of records rather than a record per call.
+	 */
+	xidRecs = (XidFileRec *) palloc(sizeof(XidFileRec) * XIDS_READ_BATCH);
+
 	for (i = 0; i < count; i++)
 	{
 		RecoveryXidState *state;
-		XidFileRec	xidRec = {0};
+		XidFileRec	xidRec;
 		bool		found;
 
-		if (OFileRead(xidFile, (Pointer) &xidRec,
-					  sizeof(xidRec), offset,
-					  WAIT_EVENT_SLRU_READ) != sizeof(xidRec))
-			ereport(FATAL, (errcode_for_file_access(),
-							errmsg("could not read xid record from file %s", xidFilename)));
+		if (bufferPos == nBuffered)
+		{
+			int			nbytes;
+
+			nBuffered = Min(count - i, XIDS_READ_BATCH);
+			nbytes = sizeof(XidFileRec) * nBuffered;
+			if (OFileRead(xidFile, (Pointer) xidRecs, nbytes, offset,
+						  WAIT_EVENT_SLRU_READ) != nbytes)
+				ereport(FATAL, (errcode_for_file_access(),
+								errmsg("could not read xid record from file %s", xidFilename)));
+			offset += nbytes;
+			bufferPos = 0;
+		}
+		xidRec = xidRecs[bufferPos++];
 
 		advance_oxids(xidRec.oxid);
 		state = (RecoveryXidState *) hash_search(recovery_xid_state_hash,
@@ -518,13 +585,12 @@ read_xids(int checkpointnum, bool recovery_single, int worker_id)
 			dlist_push_tail(&state->checkpoint_undo_stacks, &stack->node);
 			set_oxid_csn(xidRec.oxid, COMMITSEQNO_INPROGRESS);
 		}
-
-		offset += sizeof(xidRec);
 	}
 
 	if (worker_id < 0)
 		update_run_xmin();
 	FileClose(xidFile);
+	pfree(xidRecs);
 	pfree(xidFilename);
 }
 
@@ -606,10 +672,18 @@ o_recovery_start_hook(void)
 
 		workers_pool = palloc0(sizeof(RecoveryWorkerState) * (finish + 1));
 
+		recovery_buckets = palloc(sizeof(RecoveryHashBucket) * RECOVERY_HASH_BUCKETS);
+		for (i = 0; i < RECOVERY_HASH_BUCKETS; i++)
+		{
+			recovery_buckets[i].worker_id = GET_WORKER_ID(i);
+			recovery_buckets[i].load = 0;
+			recovery_buckets[i].lastOxid = InvalidOXid;
+			recovery_buckets[i].lastPtr = InvalidXLogRecPtr;
+		}
+
 		for (i = recovery_first_worker; i <= finish; i++)
 		{
 			state = &workers_pool[i];
-			shm_mq_set_sender(GET_WORKER_QUEUE(i), MyProc);
 			state->type = oIndexInvalid;
 			state->oids.datoid = InvalidOid;
 			state->oids.reloid = InvalidOid;
@@ -635,12 +709,13 @@ o_recovery_start_hook(void)
 
 				break;
 			}
-			state->queue = shm_mq_attach(GET_WORKER_QUEUE(i), NULL, workers_pool[i].handle);
+			state->queue = (RecoveryRing *) GET_WORKER_QUEUE(i);
 			state->queue_buf_len = 0;
 		}
 		for (i = recovery_first_worker; i <= finish; i++)
 		{
-			if (shm_mq_wait_for_attach(workers_pool[i].queue) != SHM_MQ_SUCCESS)
+			if (!recovery_ring_wait_for_attach(workers_pool[i].queue,
+											   workers_pool[i].handle))
 				elog(ERROR, "unable to attach recovery workers to shm queue");
 			recovery_send_init(i);
 		}
@@ -660,16 +735,21 @@ o_recovery_start_hook(void)
 
 	if (checkpoint_state->lastCheckpointNumber > 0)
 		apply_xids_branches();
+
+	recovery_prescan_dropped_trees();
 }
 
 void
 orioledb_redo(XLogReaderState *record)
 {
 	Pointer		msg_start = (Pointer) XLogRecGetData(record);
-	int			msg_len = XLogRecGetDataLen(record);
+	int			rec_len = XLogRecGetDataLen(record);
+	int			msg_len = rec_len;
+	uint8		info = XLogRecGetInfo(record) & ~XLR_INFO_MASK;
 	bool		recovery_single;
 
-	Assert((XLogRecGetInfo(record) & ~XLR_INFO_MASK) == ORIOLEDB_XLOG_CONTAINER);
+	Assert(info == ORIOLEDB_XLOG_CONTAINER ||
+		   info == ORIOLEDB_XLOG_CONTAINER_COMPRESSED);
 	recovery_single = *recovery_single_process;
 
 	if (record->ReadRecPtr >= checkpoint_state->controlToastConsistentPtr)
@@ -681,8 +761,9 @@ orioledb_redo(XLogReaderState *record)
 
 	if (record->ReadRecPtr >= checkpoint_state->controlReplayStartPtr)
 	{
+		msg_start = wal_container_decompress(info, msg_start, &msg_len);
 		replay_container(msg_start, msg_start + msg_len,
-						 recovery_single, record->ReadRecPtr);
+						 recovery_single, record->ReadRecPtr, rec_len);
 	}
 
 	if (unexpected_worker_detach)
@@ -718,7 +799,7 @@ o_recovery_finish_hook(bool cleanup)
 		for (i = 0; i < num_workers; i++)
 		{
 			state = &workers_pool[i];
-			shm_mq_detach(state->queue);
+			recovery_ring_detach(state->queue);
 		}
 		pfree(workers_pool);
 	}
@@ -727,9 +808,9 @@ o_recovery_finish_hook(bool cleanup)
 	LockReleaseCurrentOwner(NULL, 0);
 
 	/*
-	 * No sense to check recovery_internal_error state, because shm_mq_sendv()
-	 * can return SHM_MQ_DETACHED even if finish message was successfully
-	 * sent.
+	 * No sense to check recovery_internal_error state, because
+	 * recovery_ring_send() can return RecoveryRingDetached even if finish
+	 * message was successfully sent.
 	 */
 	if (!recovery_single && pg_atomic_read_u32(worker_finish_count) != num_workers)
 	{
@@ -906,7 +987,6 @@ recovery_init(int worker_id)
 		for (i = index_build_first_worker; i <= index_build_last_worker; i++)
 		{
 			state = &workers_pool[i];
-			shm_mq_set_sender(GET_WORKER_QUEUE(i), MyProc);
 			state->type = oIndexInvalid;
 			state->oids.datoid = InvalidOid;
 			state->oids.reloid = InvalidOid;
@@ -930,13 +1010,14 @@ recovery_init(int worker_id)
 						 errmsg("unable to start recovery workers"),
 						 errdetail("You must increase max_worker_processes value or decrease orioledb.recovery_idx_pool_size value. Fallback to index build in single-process mode.")));
 			}
-			state->queue = shm_mq_attach(GET_WORKER_QUEUE(i), NULL, workers_pool[i].handle);
+			state->queue = (RecoveryRing *) GET_WORKER_QUEUE(i);
 			state->queue_buf_len = 0;
 		}
 
 		for (i = index_build_first_worker; i <= index_build_last_worker; i++)
 		{
-			if (shm_mq_wait_for_attach(workers_pool[i].queue) != SHM_MQ_SUCCESS)
+			if (!recovery_ring_wait_for_attach(workers_pool[i].queue,
+											   workers_pool[i].handle))
 				elog(ERROR, "unable to attach recovery workers to shm queue");
 			recovery_send_init(i);
 		}
@@ -1224,7 +1305,15 @@ recovery_finish_current_oxid(CommitSeqNo csn, XLogRecPtr ptr,
 	bool		flush_undo_pos = need_flush_undo_pos(worker_id);
 	int			i;
 
-	delay_if_queued_for_idxbuild();
+	/*
+	 * Only the transactions changing the system trees wait for the queued
+	 * index builds: they might be the ones that queued them or might alter
+	 * the relations being indexed.  The modifications of the relations being
+	 * indexed are delayed by delay_rels_queued_for_idxbuild(), so the other
+	 * transactions don't need to wait.
+	 */
+	if (cur_state && (cur_state->systree_modified || cur_state->checkpoint_xid))
+		delay_if_queued_for_idxbuild();
 
 	if (!COMMITSEQNO_IS_ABORTED(csn) && sync)
 	{
@@ -1585,6 +1674,104 @@ recovery_rec_update(BTreeDescr *desc, OTuple tuple, bool *allocated, int *size)
 	return tuple;
 }
 
+/*
+ * Returns the length of WAL_REC_UPDATE_DELTA record payload.
+ */
+int
+recovery_rec_update_delta_length(OTuple rec)
+{
+	WALRecUpdateDelta *delta = (WALRecUpdateDelta *) rec.data;
+	OffsetNumber keyLen,
+				newLen,
+				prefixLen,
+				suffixLen;
+
+	memcpy(&keyLen, delta->keyLength, sizeof(OffsetNumber));
+	memcpy(&newLen, delta->newLength, sizeof(OffsetNumber));
+	memcpy(&prefixLen, delta->prefixLength, sizeof(OffsetNumber));
+	memcpy(&suffixLen, delta->suffixLength, sizeof(OffsetNumber));
+
+	return WALRecUpdateDeltaHeaderSize + MAXALIGN(keyLen) +
+		(newLen - prefixLen - suffixLen);
+}
+
+/*
+ * Rebuilds the new tuple version from the WAL_REC_UPDATE_DELTA record and the
+ * current tuple version in the tree.  Returns null tuple if the current
+ * version is not found, then the record is skipped as the regular update of
+ * the missing tuple would be.
+ *
+ * The current version might differ from the one the delta was made against
+ * only when replaying over the checkpoint image, which already contains the
+ * change.  The primary trees images are written before the TOAST consistent
+ * point, so the delta is skipped before it, and an error is thrown after.
+ */
+OTuple
+recovery_rec_update_from_delta(BTreeDescr *desc, OTuple rec)
+{
+	WALRecUpdateDelta *delta = (WALRecUpdateDelta *) rec.data;
+	OTuple		key,
+				oldTuple,
+				result;
+	OffsetNumber keyLen,
+				oldLen,
+				newLen,
+				prefixLen,
+				suffixLen;
+	uint32		checksum;
+
+	memcpy(&keyLen, delta->keyLength, sizeof(OffsetNumber));
+	memcpy(&oldLen, delta->oldLength, sizeof(OffsetNumber));
+	memcpy(&checksum, delta->oldChecksum, sizeof(uint32));
+	memcpy(&newLen, delta->newLength, sizeof(OffsetNumber));
+	memcpy(&prefixLen, delta->prefixLength, sizeof(OffsetNumber));
+	memcpy(&suffixLen, delta->suffixLength, sizeof(OffsetNumber));
+
+	key.formatFlags = delta->keyFormatFlags;
+	key.data = rec.data + WALRecUpdateDeltaHeaderSize;
+
+	O_TUPLE_SET_NULL(result);
+
+	o_btree_load_shmem(desc);
+	oldTuple = o_btree_find_tuple_by_key(desc, &key, BTreeKeyNonLeafKey,
+										 &o_in_progress_snapshot, NULL,
+										 CurrentMemoryContext, NULL);
+	if (O_TUPLE_IS_NULL(oldTuple))
+		return result;
+
+	if (o_btree_len(desc, oldTuple, OTupleLength) != oldLen ||
+		hash_bytes((unsigned char *) oldTuple.data, oldLen) != checksum)
+	{
+		JsonbParseState *state = NULL;
+		Jsonb	   *keyJsonb;
+
+		pfree(oldTuple.data);
+		keyJsonb = JsonbValueToJsonb(o_btree_key_to_jsonb(desc, key, &state));
+		ereport(toast_consistent ? ERROR : DEBUG1,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("tuple version mismatch for update delta of tree (%u, %u, %u)",
+						desc->oids.datoid, desc->oids.reloid,
+						desc->oids.relnode),
+				 errdetail("Key %s.",
+						   JsonbToCString(NULL, &keyJsonb->root,
+										  VARSIZE(keyJsonb)))));
+		return result;
+	}
+
+	result.formatFlags = rec.formatFlags;
+	result.data = palloc(newLen);
+	memcpy(result.data, oldTuple.data, prefixLen);
+	memcpy(result.data + prefixLen,
+		   key.data + MAXALIGN(keyLen),
+		   newLen - prefixLen - suffixLen);
+	memcpy(result.data + newLen - suffixLen,
+		   oldTuple.data + oldLen - suffixLen,
+		   suffixLen);
+	pfree(oldTuple.data);
+
+	return result;
+}
+
 OTuple
 recovery_rec_delete(BTreeDescr *desc, OTuple tuple, bool *allocated, int *size)
 {
@@ -1626,6 +1813,138 @@ orioledb_recovery_synchronized(PG_FUNCTION_ARGS)
 	PG_RETURN_BOOL(true);
 }
 
+/*
+ * Returns the WAL position up to which all the transactions are applied by
+ * the recovery workers, so the reads on the replica see everything committed
+ * before it.  NULL if the recovery isn't in progress.
+ */
+Datum
+orioledb_recovery_consistent_lsn(PG_FUNCTION_ARGS)
+{
+	XLogRecPtr	ptr;
+
+	orioledb_check_shmem();
+
+	if (!RecoveryInProgress())
+		PG_RETURN_NULL();
+
+	ptr = recovery_get_current_ptr();
+	if (XLogRecPtrIsInvalid(ptr))
+		PG_RETURN_NULL();
+
+	PG_RETURN_LSN(ptr);
+}
+
+static Datum
+recovery_ptr_get_datum(XLogRecPtr ptr, bool *isnull)
+{
+	*isnull = XLogRecPtrIsInvalid(ptr);
+	return LSNGetDatum(ptr);
+}
+
+/*
+ * Returns the replay positions of the recovery: the WAL position dispatched
+ * to the workers by the startup process, the position consistent for reads
+ * and the position the undo is retained for.  Also returns the number of
+ * index builds queued to the index build workers and not completed yet.
+ */
+Datum
+orioledb_recovery_stats(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Datum		values[5];
+	bool		nulls[5];
+	uint32		newPosition,
+				completedPosition;
+
+	orioledb_check_shmem();
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	if (!RecoveryInProgress())
+		PG_RETURN_NULL();
+
+	/* Approximate values are fine here, so don't take the mutex */
+	newPosition = recovery_oidxshared->new_position;
+	completedPosition = recovery_oidxshared->completed_position;
+
+	MemSet(nulls, 0, sizeof(nulls));
+	values[0] = recovery_ptr_get_datum(pg_atomic_read_u64(recovery_ptr),
+									   &nulls[0]);
+	values[1] = recovery_ptr_get_datum(recovery_get_current_ptr(), &nulls[1]);
+	values[2] = recovery_ptr_get_datum(recovery_get_retain_ptr(), &nulls[2]);
+	values[3] = Int64GetDatum(newPosition);
+	values[4] = Int64GetDatum(newPosition > completedPosition ?
+							  newPosition - completedPosition : 0);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
+
+/*
+ * Returns a row per recovery worker: its replay positions, the number of
+ * bytes waiting in its queue and the counters of the applied messages.
+ * Sampling the counters gives the apply rate of each worker.  Returns nothing
+ * if the recovery isn't in progress or is done by the startup process alone.
+ */
+Datum
+orioledb_recovery_worker_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	MemoryContext oldcontext;
+	int			i;
+
+	orioledb_check_shmem();
+
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	if (!RecoveryInProgress() || *recovery_single_process)
+		return (Datum) 0;
+
+	for (i = 0; i < recovery_pool_size_guc + recovery_idx_pool_size_guc; i++)
+	{
+		RecoveryRing *ring = (RecoveryRing *) GET_WORKER_QUEUE(i);
+		Datum		values[8];
+		bool		nulls[8];
+		uint64		head,
+					tail;
+
+		tail = pg_atomic_read_u64(&ring->tail);
+		head = pg_atomic_read_u64(&ring->head);
+
+		MemSet(nulls, 0, sizeof(nulls));
+		values[0] = Int32GetDatum(i);
+		if (i <= recovery_last_worker)
+			values[1] = CStringGetTextDatum("main");
+		else if (i == index_build_leader)
+			values[1] = CStringGetTextDatum("index_build_leader");
+		else
+			values[1] = CStringGetTextDatum("index_build");
+		values[2] = recovery_ptr_get_datum(pg_atomic_read_u64(&worker_ptrs[i].commitPtr),
+										   &nulls[2]);
+		values[3] = recovery_ptr_get_datum(pg_atomic_read_u64(&worker_ptrs[i].retainPtr),
+										   &nulls[3]);
+		values[4] = Int64GetDatum(head > tail ? head - tail : 0);
+		values[5] = Int64GetDatum(ring->size);
+		values[6] = Int64GetDatum(pg_atomic_read_u64(&worker_ptrs[i].appliedRecords));
+		values[7] = Int64GetDatum(pg_atomic_read_u64(&worker_ptrs[i].appliedBytes));
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
 static void
 update_run_xmin(void)
 {
@@ -1996,7 +2315,7 @@ abort_recovery(RecoveryWorkerState *workers_pool, bool send_to_idx_pool)
 	for (i = start; i <= finish; i++)
 	{
 		if (workers_pool[i].queue != NULL)
-			shm_mq_detach(workers_pool[i].queue);
+			recovery_ring_detach(workers_pool[i].queue);
 
 		if (workers_pool[i].handle != NULL)
 		{
@@ -2045,6 +2364,7 @@ recovery_cleanup_old_files(uint32 chkp_num, bool before_recovery)
 			   *dbFile;
 	char	   *filename;
 	char		ext[5];
+	HTAB	   *chkpNums;
 
 	if (!before_recovery && chkp_num == 0)
 		return;
@@ -2053,6 +2373,12 @@ recovery_cleanup_old_files(uint32 chkp_num, bool before_recovery)
 	if (dir == NULL)
 		return;
 
+	/*
+	 * With thousands of tables there are many *.map files, so read the latest
+	 * checkpoint numbers once instead of looking up each of them.
+	 */
+	chkpNums = o_load_latest_chkp_nums();
+
 	while (errno = 0, (file = readdir(dir)) != NULL)
 	{
 		Oid			dbOid;
@@ -2114,14 +2440,27 @@ recovery_cleanup_old_files(uint32 chkp_num, bool before_recovery)
 						uint32		my_chkp_num;
 						bool		found;
 
-						my_chkp_num = o_get_latest_chkp_num(dbOid, file_reloid,
-															chkp_num, &found);
+						my_chkp_num = o_lookup_latest_chkp_num(chkpNums, dbOid,
+															   file_reloid,
+															   chkp_num,
+															   &found);
 
 						cleanup = (file_chkp > my_chkp_num);
 
 						if (!found && file_chkp == chkp_num)
+						{
+							SharedRootInfoKey key = {dbOid, file_reloid};
+							ChkpNumTuple *entry;
+
 							o_update_latest_chkp_num(dbOid, file_reloid,
 													 file_chkp);
+							entry = (ChkpNumTuple *) hash_search(chkpNums,
+																 &key,
+																 HASH_ENTER,
+																 NULL);
+							entry->checkpointNumbers[0] = file_chkp;
+							entry->checkpointNumbers[1] = 0;
+						}
 					}
 
 					if (!cleanup)
@@ -2145,8 +2484,10 @@ recovery_cleanup_old_files(uint32 chkp_num, bool before_recovery)
 					{
 						uint32		my_chkp_num;
 
-						my_chkp_num = o_get_latest_chkp_num(dbOid, file_reloid,
-															chkp_num, NULL);
+						my_chkp_num = o_lookup_latest_chkp_num(chkpNums, dbOid,
+															   file_reloid,
+															   chkp_num,
+															   NULL);
 
 						cleanup = (file_chkp < my_chkp_num);
 					}
@@ -2189,6 +2530,7 @@ recovery_cleanup_old_files(uint32 chkp_num, bool before_recovery)
 	}
 
 	closedir(dir);
+	hash_destroy(chkpNums);
 }
 
 static ORelOids *
@@ -2476,7 +2818,7 @@ handle_o_tables_meta_unlock(ORelOids oids, Oid oldRelnode)
  */
 static void
 replay_container(Pointer startPtr, Pointer endPtr,
-				 bool single, XLogRecPtr xlogRecPtr)
+				 bool single, XLogRecPtr xlogRecPtr, int recLength)
 {
 	OTableDescr *descr = NULL;
 	OIndexDescr *indexDescr = NULL;
@@ -2493,7 +2835,12 @@ replay_container(Pointer startPtr, Pointer endPtr,
 
 	while (ptr < endPtr)
 	{
-		xlogPtr = xlogRecPtr + (ptr - startPtr);
+		/*
+		 * Positions of the decompressed container items are scaled to stay
+		 * within the WAL record.
+		 */
+		xlogPtr = xlogRecPtr + (uint64) (ptr - startPtr) * recLength /
+			(endPtr - startPtr);
 		rec_type = *ptr;
 		ptr++;
 
@@ -2589,6 +2936,12 @@ replay_container(Pointer startPtr, Pointer endPtr,
 				indexDescr = NULL;
 				Assert(sys_tree_get_storage_type(sys_tree_num) == BTreeStoragePersistence);
 			}
+			else if (recovery_tree_is_dropped(cur_oids))
+			{
+				/* The tree is dropped later in the WAL, skip its records */
+				descr = NULL;
+				indexDescr = NULL;
+			}
 			else if (ix_type == oIndexInvalid)
 			{
 				descr = o_fetch_table_descr(cur_oids);
@@ -2646,7 +2999,10 @@ replay_container(Pointer startPtr, Pointer endPtr,
 			ptr += sizeof(Oid);
 
 			if (!single)
+			{
+				delay_rels_queued_for_idxbuild(oids);
 				workers_synchronize(xlogPtr, true);
+			}
 
 			o_truncate_table(oids);
 
@@ -2685,7 +3041,8 @@ replay_container(Pointer startPtr, Pointer endPtr,
 		{
 			OFixedTuple tuple;
 
-			Assert(rec_type == WAL_REC_INSERT || rec_type == WAL_REC_UPDATE || rec_type == WAL_REC_DELETE);
+			Assert(rec_type == WAL_REC_INSERT || rec_type == WAL_REC_UPDATE ||
+				   rec_type == WAL_REC_DELETE || rec_type == WAL_REC_UPDATE_DELTA);
 
 			tuple.tuple.formatFlags = *ptr;
 			ptr++;
@@ -2705,6 +3062,9 @@ replay_container(Pointer startPtr, Pointer endPtr,
 				Assert(sys_tree_supports_transactions(sys_tree_num));
 				recovery_switch_to_oxid(oxid, -1);
 
+				/* DDL doesn't overtake the queued index builds */
+				delay_if_queued_for_idxbuild();
+
 				cur_state->systree_modified = true;
 				if (sys_tree_num == SYS_TREES_O_TABLES)
 					Assert(cur_state->o_tables_meta_locked);
@@ -2749,7 +3109,8 @@ replay_container(Pointer startPtr, Pointer endPtr,
 			}
 			else
 			{
-				spread_idx_modify(&indexDescr->desc, type, tuple.tuple);
+				spread_idx_modify(&indexDescr->desc, type, tuple.tuple,
+								  xlogPtr);
 			}
 
 			ptr += length;
@@ -2850,6 +3211,15 @@ delay_rels_queued_for_idxbuild(ORelOids oids)
 	RecoveryIdxBuildQueueState *hash_elem;
 	bool		found;
 
+	/*
+	 * This is called for every modify record dispatched to the workers.  The
+	 * hash is local to the recovery main process, so when no index builds
+	 * are queued, skip the spinlock and the condition variable broadcast.
+	 */
+	if (idxbuild_oids_hash == NULL ||
+		hash_get_num_entries(idxbuild_oids_hash) == 0)
+		return;
+
 	/*
 	 * Delay modify requests if indexes for the relation are requested to be
 	 * build but haven't been built yet
@@ -3199,17 +3569,20 @@ void
 worker_queue_flush(int worker_id)
 {
 	RecoveryWorkerState *state = &workers_pool[worker_id];
-	shm_mq_result result;
+	RecoveryRingResult result;
+
+	if (state->queue_buf_len == 0)
+		return;
 
-	result = shm_mq_send(state->queue, state->queue_buf_len, state->queue_buf, false, true);
+	result = recovery_ring_send(state->queue, state->queue_buf,
+								state->queue_buf_len, state->handle);
 	state->queue_buf_len = 0;
-	Assert(result != SHM_MQ_WOULD_BLOCK);
-	if (result == SHM_MQ_DETACHED)
+	if (result == RecoveryRingDetached)
 	{
 		unexpected_worker_detach = true;
 		return;
 	}
-	Assert(result == SHM_MQ_SUCCESS);
+	Assert(result == RecoveryRingSuccess);
 }
 
 /*
@@ -3232,14 +3605,124 @@ apply_sys_tree_modify_record(int sys_tree_num, uint16 type, OTuple tup,
 	return result;
 }
 
+/*
+ * Checks if the hash bucket could be moved to another worker without
+ * breaking the order of records with the same key.  That requires the
+ * current worker to already process all the bucket records, and the last
+ * transaction, which modified the bucket, to be finished.  Since records of
+ * the bucket are processed, so are the records of its earlier transactions.  Otherwise, the
+ * same transaction might modify the same key in two workers.
+ */
+static bool
+recovery_bucket_is_movable(RecoveryHashBucket *bucket)
+{
+	RecoveryXidState *state;
+
+	if (pg_atomic_read_u64(&worker_ptrs[bucket->worker_id].commitPtr) <=
+		bucket->lastPtr)
+		return false;
+
+	if (OXidIsValid(bucket->lastOxid))
+	{
+		state = (RecoveryXidState *) hash_search(recovery_xid_state_hash,
+												 &bucket->lastOxid,
+												 HASH_FIND, NULL);
+		if (state && COMMITSEQNO_IS_INPROGRESS(state->csn))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Moves the hash buckets from the most loaded worker to the least loaded
+ * one.  Hot buckets, which alone exceed the half of the load difference,
+ * stay in place: moving them would just move the problem.
+ */
+static void
+recovery_rebalance_workers(void)
+{
+	uint64	   *loads;
+	uint64		gap;
+	int			i,
+				max_worker = 0,
+				min_worker = 0,
+				moved = 0;
+
+	loads = palloc0(sizeof(uint64) * recovery_pool_size_guc);
+	for (i = 0; i < RECOVERY_HASH_BUCKETS; i++)
+		loads[recovery_buckets[i].worker_id] += recovery_buckets[i].load;
+
+	for (i = 1; i < recovery_pool_size_guc; i++)
+	{
+		if (loads[i] > loads[max_worker])
+			max_worker = i;
+		if (loads[i] < loads[min_worker])
+			min_worker = i;
+	}
+
+	if (loads[max_worker] - loads[min_worker] >= RECOVERY_REBALANCE_INTERVAL / 8)
+	{
+		gap = (loads[max_worker] - loads[min_worker]) / 2;
+		for (i = 0; i < RECOVERY_HASH_BUCKETS && gap > 0; i++)
+		{
+			RecoveryHashBucket *bucket = &recovery_buckets[i];
+
+			if (bucket->worker_id != max_worker || bucket->load == 0 ||
+				bucket->load > gap || !recovery_bucket_is_movable(bucket))
+				continue;
+
+			bucket->worker_id = min_worker;
+			gap -= bucket->load;
+			moved++;
+		}
+	}
+
+	for (i = 0; i < RECOVERY_HASH_BUCKETS; i++)
+		recovery_buckets[i].load /= 2;
+
+	if (moved > 0)
+		elog(DEBUG1, "orioledb recovery moved %d hash buckets from worker %d to worker %d",
+			 moved, max_worker, min_worker);
+
+	pfree(loads);
+}
+
+/*
+ * Returns the worker for the record with the given key hash.
+ */
+static int
+recovery_get_worker_id(uint32 hash, XLogRecPtr ptr)
+{
+	RecoveryHashBucket *bucket;
+
+	if (recovery_rebalance_guc && recovery_pool_size_guc > 1 &&
+		++recovery_rebalance_counter >= RECOVERY_REBALANCE_INTERVAL)
+	{
+		recovery_rebalance_counter = 0;
+		recovery_rebalance_workers();
+	}
+
+	bucket = &recovery_buckets[hash % RECOVERY_HASH_BUCKETS];
+	bucket->load++;
+	bucket->lastOxid = recovery_oxid;
+	bucket->lastPtr = ptr;
+
+	return bucket->worker_id;
+}
+
 /*
  * Spreads the index modify recovery record to the recovery workers pool.
  *
  * Tuples with a same key will be processed by a same worker. This approach
- * helps to apply recovery records for tuples in the right order.
+ * helps to apply recovery records for tuples in the right order.  Keys are
+ * grouped into hash buckets, which might be moved between workers to even
+ * out their load.  When enabled, the evicted page to be modified is
+ * prefetched before the record is sent to the worker.
  */
 static inline void
-spread_idx_modify(BTreeDescr *desc, uint16 recType, OTuple rec)
+spread_idx_modify(BTreeDescr *desc, uint16 recType, OTuple rec,
+				  XLogRecPtr ptr)
 {
 	OTuple		key PG_USED_FOR_ASSERTS_ONLY;
 	uint32		hash;
@@ -3259,15 +3742,34 @@ spread_idx_modify(BTreeDescr *desc, uint16 recType, OTuple rec)
 			if (key_pfree)
 				pfree(key.data);
 #endif
-			worker_send_modify(GET_WORKER_ID(hash), desc,
+			if (recovery_prefetch_guc)
+				btree_prefetch_key(desc, (Pointer) &rec, BTreeKeyLeafTuple);
+			worker_send_modify(recovery_get_worker_id(hash, ptr), desc,
 							   recType, rec, tup_len);
 			break;
 		case RECOVERY_DELETE:
 			key_len = o_btree_len(desc, rec, OKeyLength);
 			hash = o_btree_hash(desc, rec, BTreeKeyNonLeafKey);
-			worker_send_modify(GET_WORKER_ID(hash), desc, recType,
+			if (recovery_prefetch_guc)
+				btree_prefetch_key(desc, (Pointer) &rec, BTreeKeyNonLeafKey);
+			worker_send_modify(recovery_get_worker_id(hash, ptr), desc, recType,
 							   rec, key_len);
 			break;
+		case RECOVERY_UPDATE_DELTA:
+			{
+				WALRecUpdateDelta *delta = (WALRecUpdateDelta *) rec.data;
+				OTuple		deltaKey;
+
+				deltaKey.formatFlags = delta->keyFormatFlags;
+				deltaKey.data = rec.data + WALRecUpdateDeltaHeaderSize;
+				hash = o_btree_hash(desc, deltaKey, BTreeKeyNonLeafKey);
+				if (recovery_prefetch_guc)
+					btree_prefetch_key(desc, (Pointer) &deltaKey,
+									   BTreeKeyNonLeafKey);
+				worker_send_modify(recovery_get_worker_id(hash, ptr), desc, recType, rec,
+								   recovery_rec_update_delta_length(rec));
+				break;
+			}
 		default:
 			Assert(false);
 	}
@@ -3287,6 +3789,8 @@ recovery_msg_from_wal_record(uint8 wal_record)
 			return RECOVERY_DELETE;
 		case WAL_REC_UPDATE:
 			return RECOVERY_UPDATE;
+		case WAL_REC_UPDATE_DELTA:
+			return RECOVERY_UPDATE_DELTA;
 		default:
 			Assert(false);
 			elog(ERROR, "Wrong WAL record modify type %d", wal_record);
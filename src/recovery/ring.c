@@ -0,0 +1,201 @@
+/*-------------------------------------------------------------------------
+ *
+ * ring.c
+ *		Recovery message ring between the startup process and the workers.
+ *
+ * Copyright (c) 2021-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/recovery/ring.c
+ *
+ * NOTES
+ *
+ *		The startup process packs recovery messages into batches of up to
+ *		RECOVERY_QUEUE_BUF_SIZE and publishes each batch with a single
+ *		advance of the ring head.  Batches are never split over the ring end:
+ *		a wrap marker makes the receiver continue from the ring start.  The
+ *		receiver reads the batches in place.  It releases the space only
+ *		after it processes all the batches seen at the last head check, so
+ *		the tail is advanced once per group of batches.
+ *
+ *		Both sides poll the ring.  So, there is no latch signalling on the
+ *		hot path.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "recovery/ring.h"
+
+#include "miscadmin.h"
+#include "storage/pmsignal.h"
+
+#define RECOVERY_RING_BATCH_HEADER_SIZE MAXALIGN(sizeof(uint32))
+#define RECOVERY_RING_WRAP ((uint32) 0xFFFFFFFF)
+
+/* Check the receiver is alive every so many sleeps */
+#define RECOVERY_RING_CHECK_INTERVAL (100)
+
+void
+recovery_ring_create(Pointer ptr, Size size)
+{
+	RecoveryRing *ring = (RecoveryRing *) ptr;
+
+	Assert(size > RECOVERY_RING_OVERHEAD);
+	pg_atomic_init_u64(&ring->head, 0);
+	pg_atomic_init_u64(&ring->tail, 0);
+	pg_atomic_init_u32(&ring->receiverAttached, 0);
+	pg_atomic_init_u32(&ring->detached, 0);
+	ring->size = MAXALIGN_DOWN(size - RECOVERY_RING_OVERHEAD);
+}
+
+static bool
+recovery_ring_receiver_is_alive(BackgroundWorkerHandle *handle)
+{
+	BgwHandleStatus status;
+	pid_t		pid;
+
+	if (handle == NULL)
+		return PostmasterIsAlive();
+
+	status = GetBackgroundWorkerPid(handle, &pid);
+	return status == BGWH_STARTED || status == BGWH_NOT_YET_STARTED;
+}
+
+/*
+ * Waits for the receiver to attach to the ring.  Returns false if the
+ * receiver has gone away before attaching.
+ */
+bool
+recovery_ring_wait_for_attach(RecoveryRing *ring,
+							  BackgroundWorkerHandle *handle)
+{
+	while (pg_atomic_read_u32(&ring->receiverAttached) == 0)
+	{
+		if (pg_atomic_read_u32(&ring->detached) != 0 ||
+			!recovery_ring_receiver_is_alive(handle))
+			return false;
+
+		CHECK_FOR_INTERRUPTS();
+		pg_usleep(100);
+	}
+	return true;
+}
+
+/*
+ * Publishes the batch of messages.  Waits for the receiver to free enough
+ * space.
+ */
+RecoveryRingResult
+recovery_ring_send(RecoveryRing *ring, Pointer data, Size len,
+				   BackgroundWorkerHandle *handle)
+{
+	Size		need = RECOVERY_RING_BATCH_HEADER_SIZE + MAXALIGN(len);
+	uint64		head = pg_atomic_read_u64(&ring->head);
+	Size		offset = head % ring->size;
+	Size		waste = (offset + need > ring->size) ? ring->size - offset : 0;
+	uint32		batchLen = len;
+	int			i = 0;
+
+	Assert(need <= ring->size / 2);
+
+	while (ring->size - (head - pg_atomic_read_u64(&ring->tail)) < waste + need)
+	{
+		if (pg_atomic_read_u32(&ring->detached) != 0)
+			return RecoveryRingDetached;
+
+		if (++i % RECOVERY_RING_CHECK_INTERVAL == 0 &&
+			!recovery_ring_receiver_is_alive(handle))
+			return RecoveryRingDetached;
+
+		CHECK_FOR_INTERRUPTS();
+		pg_usleep(10);
+	}
+
+	/* Don't overwrite the data until the receiver is done with it */
+	pg_memory_barrier();
+
+	if (waste > 0)
+	{
+		uint32		wrap = RECOVERY_RING_WRAP;
+
+		memcpy(ring->data + offset, &wrap, sizeof(uint32));
+		head += waste;
+		offset = 0;
+	}
+
+	memcpy(ring->data + offset, &batchLen, sizeof(uint32));
+	memcpy(ring->data + offset + RECOVERY_RING_BATCH_HEADER_SIZE, data, len);
+
+	pg_write_barrier();
+	pg_atomic_write_u64(&ring->head, head + need);
+
+	return RecoveryRingSuccess;
+}
+
+void
+recovery_ring_attach(RecoveryRing *ring, RecoveryRingReader *reader)
+{
+	reader->ring = ring;
+	reader->pos = pg_atomic_read_u64(&ring->tail);
+	reader->end = reader->pos;
+	pg_atomic_write_u32(&ring->receiverAttached, 1);
+}
+
+/*
+ * Returns the next batch of messages.  The batch stays valid until the next
+ * call.
+ */
+RecoveryRingResult
+recovery_ring_receive(RecoveryRingReader *reader, Size *len, Pointer *data)
+{
+	RecoveryRing *ring = reader->ring;
+
+	while (true)
+	{
+		Size		offset;
+		uint32		batchLen;
+
+		if (reader->pos == reader->end)
+		{
+			/* Release all the batches processed since the last check */
+			pg_memory_barrier();
+			pg_atomic_write_u64(&ring->tail, reader->pos);
+
+			reader->end = pg_atomic_read_u64(&ring->head);
+			if (reader->pos == reader->end)
+			{
+				if (pg_atomic_read_u32(&ring->detached) != 0)
+					return RecoveryRingDetached;
+				return RecoveryRingEmpty;
+			}
+			pg_read_barrier();
+		}
+
+		offset = reader->pos % ring->size;
+		memcpy(&batchLen, ring->data + offset, sizeof(uint32));
+		if (batchLen == RECOVERY_RING_WRAP)
+		{
+			reader->pos += ring->size - offset;
+			continue;
+		}
+
+		*len = batchLen;
+		*data = ring->data + offset + RECOVERY_RING_BATCH_HEADER_SIZE;
+		reader->pos += RECOVERY_RING_BATCH_HEADER_SIZE + MAXALIGN(batchLen);
+		return RecoveryRingSuccess;
+	}
+}
+
+/*
+ * Marks the ring detached by either side.  The receiver still gets the
+ * batches published before the detach.
+ */
+void
+recovery_ring_detach(RecoveryRing *ring)
+{
+	pg_write_barrier();
+	pg_atomic_write_u32(&ring->detached, 1);
+}
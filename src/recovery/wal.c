@@ -20,9 +20,55 @@
 #include "recovery/wal.h"
 #include "tableam/descr.h"
 #include "transam/oxid.h"
-
+#include "transam/undo.h"
+#include "utils/compress.h"
+#include "utils/latency.h"
+
+#include "access/xlog.h"
+#include "common/hashfn.h"
+#include "funcapi.h"
+#include "portability/instr_time.h"
 #include "replication/message.h"
+#include "storage/condition_variable.h"
 #include "storage/proc.h"
+#include "storage/spin.h"
+#include "utils/builtins.h"
+
+bool		wal_update_delta = true;
+
+/* Group commit settings: delay in microseconds and size trigger in kB */
+int			wal_commit_delay = 0;
+int			wal_commit_group_size = 256;
+
+/* Compression level for WAL containers, -1 means no compression */
+int			wal_compress = InvalidOCompress;
+int			wal_compress_threshold = 1024;
+
+/*
+ * Shared state of the WAL flush group commit.  The first committer, which
+ * finds no active leader, becomes the leader.  It waits for others to join
+ * the group for up to 'wal_commit_delay', then flushes WAL up to the
+ * furthest position requested by the group.  Everybody else sleeps on the
+ * condition variable until their commit position is flushed.
+ */
+typedef struct
+{
+	slock_t		mutex;
+	bool		leaderActive;
+	int			groupSize;
+	XLogRecPtr	requestPtr;
+	XLogRecPtr	flushedPtr;
+	ConditionVariable cv;
+
+	pg_atomic_uint64 groups;
+	pg_atomic_uint64 commits;
+	pg_atomic_uint64 waitTime;
+} WalGroupCommitShmem;
+
+static WalGroupCommitShmem *walGroupCommit = NULL;
+
+PG_FUNCTION_INFO_V1(orioledb_wal_group_commit_stats);
+PG_FUNCTION_INFO_V1(orioledb_wal_group_commit_stats_reset);
 
 static char local_wal_buffer[LOCAL_WAL_BUFFER_SIZE];
 static int	local_wal_buffer_offset = 0;
@@ -59,7 +105,10 @@ add_modify_wal_record(uint8 rec_type, BTreeDescr *desc,
 	}
 
 	Assert(!is_recovery_process());
-	Assert(rec_type == WAL_REC_INSERT || rec_type == WAL_REC_UPDATE || rec_type == WAL_REC_DELETE);
+	Assert(rec_type == WAL_REC_INSERT || rec_type == WAL_REC_UPDATE ||
+		   rec_type == WAL_REC_DELETE || rec_type == WAL_REC_UPDATE_DELTA);
+
+	add_pending_savepoint_wal_records();
 
 	required_length = sizeof(WALRecModify) + length;
 
@@ -185,6 +234,193 @@ wal_rollback(OXid oxid, TransactionId logicalXid)
 		XLogFlush(wait_pos);
 }
 
+Size
+wal_group_commit_shmem_needs(void)
+{
+	return sizeof(WalGroupCommitShmem);
+}
+
+void
+wal_group_commit_shmem_init(Pointer ptr, bool found)
+{
+	walGroupCommit = (WalGroupCommitShmem *) ptr;
+
+	if (!found)
+	{
+		SpinLockInit(&walGroupCommit->mutex);
+		walGroupCommit->leaderActive = false;
+		walGroupCommit->groupSize = 0;
+		walGroupCommit->requestPtr = InvalidXLogRecPtr;
+		walGroupCommit->flushedPtr = InvalidXLogRecPtr;
+		ConditionVariableInit(&walGroupCommit->cv);
+		pg_atomic_init_u64(&walGroupCommit->groups, 0);
+		pg_atomic_init_u64(&walGroupCommit->commits, 0);
+		pg_atomic_init_u64(&walGroupCommit->waitTime, 0);
+	}
+}
+
+/*
+ * Leader part of the group commit.  Waits for the group to gather, then
+ * flushes WAL for the whole group and wakes up its members.
+ */
+static void
+wal_group_commit_lead(XLogRecPtr pos)
+{
+	XLogRecPtr	target;
+	int			groupSize;
+	instr_time	delayStart,
+				delayTime;
+
+	INSTR_TIME_SET_CURRENT(delayStart);
+	while (true)
+	{
+		long		remaining;
+
+		SpinLockAcquire(&walGroupCommit->mutex);
+		target = walGroupCommit->requestPtr;
+		SpinLockRelease(&walGroupCommit->mutex);
+
+		/* Size trigger: the group has already written enough WAL */
+		if (target - pos >= (uint64) wal_commit_group_size * 1024)
+			break;
+
+		INSTR_TIME_SET_CURRENT(delayTime);
+		INSTR_TIME_SUBTRACT(delayTime, delayStart);
+		remaining = wal_commit_delay - (long) INSTR_TIME_GET_MICROSEC(delayTime);
+		if (remaining <= 0)
+			break;
+		pg_usleep(Min(remaining, 100));
+	}
+
+	SpinLockAcquire(&walGroupCommit->mutex);
+	target = walGroupCommit->requestPtr;
+	groupSize = walGroupCommit->groupSize;
+	walGroupCommit->groupSize = 0;
+	SpinLockRelease(&walGroupCommit->mutex);
+
+	Assert(target >= pos);
+	XLogFlush(target);
+
+	SpinLockAcquire(&walGroupCommit->mutex);
+	if (walGroupCommit->flushedPtr < target)
+		walGroupCommit->flushedPtr = target;
+	walGroupCommit->leaderActive = false;
+	SpinLockRelease(&walGroupCommit->mutex);
+
+	ConditionVariableBroadcast(&walGroupCommit->cv);
+
+	pg_atomic_fetch_add_u64(&walGroupCommit->groups, 1);
+	pg_atomic_fetch_add_u64(&walGroupCommit->commits, groupSize);
+}
+
+/*
+ * Flushes WAL up to the commit position.  With non-zero 'wal_commit_delay',
+ * concurrent committers are gathered into groups, each flushed by a single
+ * XLogFlush() call of the group leader.
+ */
+void
+wal_commit_flush(XLogRecPtr pos)
+{
+	instr_time	waitStart,
+				waitTime,
+				flushStart;
+	bool		joined = false;
+
+	latency_start(&flushStart);
+	if (wal_commit_delay <= 0)
+	{
+		XLogFlush(pos);
+		latency_record(OLatencyCommitFlush, &flushStart);
+		return;
+	}
+
+	INSTR_TIME_SET_CURRENT(waitStart);
+	while (true)
+	{
+		bool		lead = false;
+
+		SpinLockAcquire(&walGroupCommit->mutex);
+		if (walGroupCommit->flushedPtr >= pos)
+		{
+			SpinLockRelease(&walGroupCommit->mutex);
+			break;
+		}
+		if (!joined)
+		{
+			if (walGroupCommit->requestPtr < pos)
+				walGroupCommit->requestPtr = pos;
+			walGroupCommit->groupSize++;
+			joined = true;
+		}
+		if (!walGroupCommit->leaderActive)
+		{
+			walGroupCommit->leaderActive = true;
+			lead = true;
+		}
+		SpinLockRelease(&walGroupCommit->mutex);
+
+		if (lead)
+		{
+			wal_group_commit_lead(pos);
+			break;
+		}
+
+		ConditionVariableSleep(&walGroupCommit->cv, PG_WAIT_EXTENSION);
+	}
+	ConditionVariableCancelSleep();
+
+	INSTR_TIME_SET_CURRENT(waitTime);
+	INSTR_TIME_SUBTRACT(waitTime, waitStart);
+	pg_atomic_fetch_add_u64(&walGroupCommit->waitTime,
+							INSTR_TIME_GET_MICROSEC(waitTime));
+	latency_record(OLatencyCommitFlush, &flushStart);
+}
+
+/*
+ * Returns the WAL group commit statistics.
+ */
+Datum
+orioledb_wal_group_commit_stats(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Datum		values[4];
+	bool		nulls[4];
+	uint64		groups,
+				commits;
+
+	orioledb_check_shmem();
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+	tupdesc = BlessTupleDesc(tupdesc);
+
+	groups = pg_atomic_read_u64(&walGroupCommit->groups);
+	commits = pg_atomic_read_u64(&walGroupCommit->commits);
+
+	MemSet(nulls, 0, sizeof(nulls));
+	values[0] = Int64GetDatum(groups);
+	values[1] = Int64GetDatum(commits);
+	if (groups > 0)
+		values[2] = Float8GetDatum((double) commits / (double) groups);
+	else
+		nulls[2] = true;
+	values[3] = Float8GetDatum((double) pg_atomic_read_u64(&walGroupCommit->waitTime) / 1000.0);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
+
+Datum
+orioledb_wal_group_commit_stats_reset(PG_FUNCTION_ARGS)
+{
+	orioledb_check_shmem();
+
+	pg_atomic_write_u64(&walGroupCommit->groups, 0);
+	pg_atomic_write_u64(&walGroupCommit->commits, 0);
+	pg_atomic_write_u64(&walGroupCommit->waitTime, 0);
+
+	PG_RETURN_VOID();
+}
+
 static void
 add_finish_wal_record(uint8 rec_type, OXid xmin)
 {
@@ -286,6 +522,7 @@ add_o_tables_meta_lock_wal_record(void)
 	WALRec	   *rec;
 
 	Assert(!is_recovery_process());
+	add_pending_savepoint_wal_records();
 	flush_local_wal_if_needed(sizeof(*rec));
 	Assert(local_wal_buffer_offset + sizeof(*rec) <= LOCAL_WAL_BUFFER_SIZE);
 
@@ -304,6 +541,7 @@ add_o_tables_meta_unlock_wal_record(ORelOids oids, Oid oldRelnode)
 	WALRecOTablesUnlockMeta *rec;
 
 	Assert(!is_recovery_process());
+	add_pending_savepoint_wal_records();
 	flush_local_wal_if_needed(sizeof(*rec));
 	Assert(local_wal_buffer_offset + sizeof(*rec) <= LOCAL_WAL_BUFFER_SIZE);
 
@@ -416,11 +654,65 @@ flush_local_wal_if_needed(int required_length)
 XLogRecPtr
 log_logical_wal_container(Pointer ptr, int length)
 {
+	static char compressed[LOCAL_WAL_BUFFER_SIZE];
+
+	Assert(length <= LOCAL_WAL_BUFFER_SIZE);
+
+	if (OCompressIsValid(wal_compress) && length >= wal_compress_threshold)
+	{
+		WALContainerCompressed *hdr = (WALContainerCompressed *) compressed;
+		uint16		rawLength = length;
+		size_t		size;
+
+		/* Only use the compressed container if it's actually smaller */
+		size = o_compress_buffer(ptr, length,
+								 compressed + sizeof(WALContainerCompressed),
+								 length - sizeof(WALContainerCompressed) - 1,
+								 wal_compress);
+		if (size > 0)
+		{
+			memcpy(hdr->rawLength, &rawLength, sizeof(uint16));
+			XLogBeginInsert();
+			XLogRegisterData(compressed,
+							 sizeof(WALContainerCompressed) + size);
+			return XLogInsert(ORIOLEDB_RMGR_ID,
+							  ORIOLEDB_XLOG_CONTAINER_COMPRESSED);
+		}
+	}
+
 	XLogBeginInsert();
 	XLogRegisterData(ptr, length);
 	return XLogInsert(ORIOLEDB_RMGR_ID, ORIOLEDB_XLOG_CONTAINER);
 }
 
+/*
+ * Returns the raw container of the orioledb WAL record.  Compressed
+ * containers are decompressed into the static buffer, which is valid till
+ * the next call.  '*length' is the record data length on input and the raw
+ * container length on output.
+ */
+Pointer
+wal_container_decompress(uint8 info, Pointer data, int *length)
+{
+	static char decompressed[LOCAL_WAL_BUFFER_SIZE];
+	WALContainerCompressed *hdr = (WALContainerCompressed *) data;
+	uint16		rawLength;
+
+	if (info == ORIOLEDB_XLOG_CONTAINER)
+		return data;
+
+	Assert(info == ORIOLEDB_XLOG_CONTAINER_COMPRESSED);
+	memcpy(&rawLength, hdr->rawLength, sizeof(uint16));
+	if (rawLength > LOCAL_WAL_BUFFER_SIZE)
+		elog(PANIC, "invalid orioledb WAL container length %u", rawLength);
+
+	o_decompress_buffer(data + sizeof(WALContainerCompressed),
+						*length - sizeof(WALContainerCompressed),
+						decompressed, rawLength);
+	*length = rawLength;
+	return decompressed;
+}
+
 /*
  * Makes WAL insert record.
  */
@@ -453,6 +745,87 @@ o_wal_update(BTreeDescr *desc, OTuple tuple)
 		pfree(wal_record.data);
 }
 
+/*
+ * Makes WAL update record for the primary key tree given both old and new
+ * tuple versions.  When the versions share the most of their bytes, only the
+ * changed bytes are logged together with the primary key.  Otherwise, falls
+ * back to the regular update record.
+ *
+ * The delta record can't be decoded without the old tuple.  So, it's not
+ * used when WAL is decoded logically.
+ */
+void
+o_wal_update_delta(BTreeDescr *desc, OTuple oldTuple, OTuple newTuple)
+{
+	WALRecUpdateDelta *delta;
+	OTuple		key,
+				wal_record;
+	bool		key_pfree;
+	OffsetNumber oldLen,
+				newLen,
+				keyLen,
+				prefixLen = 0,
+				suffixLen = 0,
+				middleLen;
+	uint32		checksum;
+	int			size;
+
+	if (!wal_update_delta || XLogLogicalInfoActive() ||
+		IS_SYS_TREE_OIDS(desc->oids) || desc->type != oIndexPrimary ||
+		O_TUPLE_IS_NULL(oldTuple))
+	{
+		o_wal_update(desc, newTuple);
+		return;
+	}
+
+	oldLen = o_btree_len(desc, oldTuple, OTupleLength);
+	newLen = o_btree_len(desc, newTuple, OTupleLength);
+
+	while (prefixLen < oldLen && prefixLen < newLen &&
+		   oldTuple.data[prefixLen] == newTuple.data[prefixLen])
+		prefixLen++;
+	while (suffixLen < oldLen - prefixLen && suffixLen < newLen - prefixLen &&
+		   oldTuple.data[oldLen - suffixLen - 1] ==
+		   newTuple.data[newLen - suffixLen - 1])
+		suffixLen++;
+	middleLen = newLen - prefixLen - suffixLen;
+
+	key = o_btree_tuple_make_key(desc, newTuple, NULL, true, &key_pfree);
+	keyLen = o_btree_len(desc, key, OKeyLength);
+
+	/* Only use the delta record when it's at most half of the full one */
+	size = WALRecUpdateDeltaHeaderSize + MAXALIGN(keyLen) + middleLen;
+	if (size * 2 > newLen)
+	{
+		if (key_pfree)
+			pfree(key.data);
+		o_wal_update(desc, newTuple);
+		return;
+	}
+
+	checksum = hash_bytes((unsigned char *) oldTuple.data, oldLen);
+
+	wal_record.formatFlags = newTuple.formatFlags;
+	wal_record.data = palloc0(size);
+	delta = (WALRecUpdateDelta *) wal_record.data;
+	memcpy(delta->keyLength, &keyLen, sizeof(OffsetNumber));
+	delta->keyFormatFlags = key.formatFlags;
+	memcpy(delta->oldLength, &oldLen, sizeof(OffsetNumber));
+	memcpy(delta->oldChecksum, &checksum, sizeof(uint32));
+	memcpy(delta->newLength, &newLen, sizeof(OffsetNumber));
+	memcpy(delta->prefixLength, &prefixLen, sizeof(OffsetNumber));
+	memcpy(delta->suffixLength, &suffixLen, sizeof(OffsetNumber));
+	memcpy(wal_record.data + WALRecUpdateDeltaHeaderSize, key.data, keyLen);
+	memcpy(wal_record.data + WALRecUpdateDeltaHeaderSize + MAXALIGN(keyLen),
+		   newTuple.data + prefixLen, middleLen);
+
+	add_modify_wal_record(WAL_REC_UPDATE_DELTA, desc, wal_record, size);
+
+	pfree(wal_record.data);
+	if (key_pfree)
+		pfree(key.data);
+}
+
 /*
  * Makes WAL delete record.
  */
@@ -488,6 +861,7 @@ add_truncate_wal_record(ORelOids oids)
 	WALRecTruncate *rec;
 
 	Assert(!is_recovery_process());
+	add_pending_savepoint_wal_records();
 	flush_local_wal_if_needed(sizeof(*rec));
 	Assert(local_wal_buffer_offset + sizeof(*rec) <= LOCAL_WAL_BUFFER_SIZE);
 
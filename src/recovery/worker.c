@@ -20,6 +20,7 @@
 #include "catalog/o_tables.h"
 #include "recovery/recovery.h"
 #include "recovery/internal.h"
+#include "recovery/ring.h"
 #include "tableam/descr.h"
 #include "tableam/operations.h"
 #include "tableam/tree.h"
@@ -32,7 +33,6 @@
 #include "storage/latch.h"
 #include "storage/pmsignal.h"
 #include "storage/proc.h"
-#include "storage/shm_mq.h"
 #include "storage/sinvaladt.h"
 #include "utils/inval.h"
 #include "utils/syscache.h"
@@ -47,8 +47,8 @@ static bool detached = false;
 static CommitSeqNo my_ptr;
 static bool recovery_initialized = false;
 
-static void recovery_queue_process(shm_mq_handle *queue, int id);
-static inline Pointer recovery_queue_read(shm_mq_handle *queue, Size *data_size, int id);
+static void recovery_queue_process(RecoveryRingReader *queue, int id);
+static inline Pointer recovery_queue_read(RecoveryRingReader *queue, Size *data_size, int id);
 static void apply_tbl_modify_record(OTableDescr *descr, uint16 type,
 									OTuple p, OXid oxid, CommitSeqNo csn);
 static void apply_tbl_insert(OTableDescr *descr, OTuple tuple,
@@ -179,7 +179,8 @@ handle_sigterm(SIGNAL_ARGS)
 void
 recovery_worker_main(Datum main_arg)
 {
-	shm_mq_handle *recovery_worker_queue = NULL;
+	RecoveryRing *recovery_worker_queue = NULL;
+	RecoveryRingReader reader;
 
 	PG_TRY();
 	{
@@ -200,17 +201,17 @@ recovery_worker_main(Datum main_arg)
 		pqsignal(SIGTERM, handle_sigterm);
 		BackgroundWorkerUnblockSignals();
 
-		shm_mq_set_receiver(GET_WORKER_QUEUE(id), MyProc);
-		recovery_worker_queue = shm_mq_attach(GET_WORKER_QUEUE(id), NULL, NULL);
+		recovery_worker_queue = (RecoveryRing *) GET_WORKER_QUEUE(id);
+		recovery_ring_attach(recovery_worker_queue, &reader);
 
 		my_ptr = pg_atomic_read_u64(&worker_ptrs[id].commitPtr);
-		recovery_queue_process(recovery_worker_queue, id);
+		recovery_queue_process(&reader, id);
 		if (detached)
 		{
 			elog(ERROR, "orioledb recovery worker %d finished: unexpected detach from recovery messages queue.", id);
 		}
 
-		shm_mq_detach(recovery_worker_queue);
+		recovery_ring_detach(recovery_worker_queue);
 		recovery_worker_queue = NULL;
 
 		recovery_finish(id);
@@ -229,7 +230,7 @@ recovery_worker_main(Datum main_arg)
 		if (recovery_worker_queue != NULL)
 		{
 			/* detach from queue if attached */
-			shm_mq_detach(recovery_worker_queue);
+			recovery_ring_detach(recovery_worker_queue);
 		}
 
 		/*
@@ -259,7 +260,7 @@ update_worker_ptr(int worker_id, XLogRecPtr ptr)
  * Reads messages from recovery queue and applies modify records to BTrees.
  */
 static void
-recovery_queue_process(shm_mq_handle *queue, int id)
+recovery_queue_process(RecoveryRingReader *queue, int id)
 {
 	RecoveryMsgOXidPtr *oxid_csn_record;
 	RecoveryMsgPtr *csn_record;
@@ -277,6 +278,8 @@ recovery_queue_process(shm_mq_handle *queue, int id)
 
 	while (!finished)
 	{
+		uint64		nrecords = 0;
+
 		data = recovery_queue_read(queue, &data_size, id);
 		if (detached)
 			break;
@@ -290,6 +293,7 @@ recovery_queue_process(shm_mq_handle *queue, int id)
 			{
 				OTuple		tuple;
 
+				nrecords++;
 				data_pos += sizeof(RecoveryMsgHeader);
 				if (recovery_header->type & RECOVERY_MODIFY_OXID)
 				{
@@ -483,6 +487,8 @@ recovery_queue_process(shm_mq_handle *queue, int id)
 			}
 			data_pos = MAXALIGN(data_pos);
 		}
+		pg_atomic_fetch_add_u64(&worker_ptrs[id].appliedRecords, nrecords);
+		pg_atomic_fetch_add_u64(&worker_ptrs[id].appliedBytes, data_size);
 		update_recovery_undo_loc_flush(false, id);
 	}
 	if (descr)
@@ -497,9 +503,23 @@ apply_modify_record(OTableDescr *descr, OIndexDescr *id, uint16 type,
 					OTuple p)
 {
 	OXid		oxid;
+	OTuple		tuple = p;
 
 	oxid = get_current_oxid();
 
+	/*
+	 * Delta update records are rebuilt against the current tuple version.
+	 * Records with the same key are applied by the same worker in WAL order,
+	 * so the current version is the one the delta was made against.
+	 */
+	if (type == RECOVERY_UPDATE_DELTA)
+	{
+		tuple = recovery_rec_update_from_delta(&id->desc, p);
+		if (O_TUPLE_IS_NULL(tuple))
+			return;
+		type = RECOVERY_UPDATE;
+	}
+
 	/*
 	 * Don't apply changes to secondary indices before TOAST is consisntent.
 	 * Otherwise, values of secondary indices on TOASTed fields can be
@@ -508,22 +528,25 @@ apply_modify_record(OTableDescr *descr, OIndexDescr *id, uint16 type,
 	if (descr && toast_consistent)
 	{
 		/* Modify table */
-		apply_tbl_modify_record(descr, type, p, oxid, COMMITSEQNO_INPROGRESS);
+		apply_tbl_modify_record(descr, type, tuple, oxid, COMMITSEQNO_INPROGRESS);
 	}
 	else
 	{
 		o_btree_load_shmem(&id->desc);
-		apply_btree_modify_record(&id->desc, type, p, oxid, COMMITSEQNO_INPROGRESS);
+		apply_btree_modify_record(&id->desc, type, tuple, oxid, COMMITSEQNO_INPROGRESS);
 	}
+
+	if (tuple.data != p.data)
+		pfree(tuple.data);
 }
 
 /*
  * Reads a message from the queue.
  */
 static inline Pointer
-recovery_queue_read(shm_mq_handle *queue, Size *data_size, int id)
+recovery_queue_read(RecoveryRingReader *queue, Size *data_size, int id)
 {
-	shm_mq_result read_result;
+	RecoveryRingResult read_result;
 	XLogRecPtr	prev_rec_ptr = InvalidXLogRecPtr,
 				cur_rec_ptr;
 	long		usleep_time;
@@ -532,13 +555,13 @@ recovery_queue_read(shm_mq_handle *queue, Size *data_size, int id)
 	usleep_time = QUEUE_READ_USLEEP_BASE;
 	while (true)
 	{
-		read_result = shm_mq_receive(queue, data_size, (void **) &data, true);
+		read_result = recovery_ring_receive(queue, data_size, &data);
 
-		if (read_result == SHM_MQ_SUCCESS)
+		if (read_result == RecoveryRingSuccess)
 		{
 			break;
 		}
-		else if (read_result == SHM_MQ_DETACHED || detached)
+		else if (read_result == RecoveryRingDetached || detached)
 		{
 			detached = true;
 			data = NULL;
@@ -548,7 +571,7 @@ recovery_queue_read(shm_mq_handle *queue, Size *data_size, int id)
 		/*
 		 * else the queue is empty
 		 */
-		Assert(read_result == SHM_MQ_WOULD_BLOCK);
+		Assert(read_result == RecoveryRingEmpty);
 
 		/* we can try to update our ptr if queue is empty */
 		cur_rec_ptr = pg_atomic_read_u64(recovery_ptr);
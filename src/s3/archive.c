@@ -209,6 +209,6 @@ s3_archive_file(const char *file, const char *path)
 		location = s3_schedule_wal_file_write((char *) file);
 	}
 
-	s3_queue_wait_for_location(location);
+	s3_queue_wait_for_task(location);
 	return true;
 }
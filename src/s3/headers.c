@@ -26,6 +26,8 @@
 #include "common/file_utils.h"
 #include "common/hashfn.h"
 #include "common/pg_prng.h"
+#include "funcapi.h"
+#include "miscadmin.h"
 #if PG_VERSION_NUM < 160000
 #include "port/pg_iovec.h"
 #endif
@@ -33,6 +35,7 @@
 #if PG_VERSION_NUM < 160000
 #include "storage/fd.h"
 #endif
+#include "utils/tuplestore.h"
 
 #define S3_HEADER_BUFFERS_PER_GROUP 4
 #define S3_HEADER_BUFFERS_PER_GROUP_NUM_BITS 2
@@ -43,6 +46,16 @@ typedef struct
 	int			groupCtlTrancheId;
 	int			bufferCtlTrancheId;
 	pg_atomic_uint64 numberOfLoadedParts;
+
+	/* Statistics of the local cache of the file parts */
+	pg_atomic_uint64 hits;
+	pg_atomic_uint64 misses;
+	pg_atomic_uint64 loads;
+	pg_atomic_uint64 prefetchLoads;
+	pg_atomic_uint64 evictions;
+	pg_atomic_uint64 unusedPrefetchEvictions;
+	pg_atomic_uint64 evictedBytes;
+	pg_atomic_uint64 evictionPasses;
 } S3HeadersMeta;
 
 typedef struct
@@ -94,12 +107,21 @@ static S3HeadersBuffersGroup *groups;
 #define S3_PART_DIRTY_FLAG		   UINT64CONST(0x0000000000200000)
 #define S3_PART_WRITING_FLAG	   UINT64CONST(0x0000000000400000)
 #define S3_PART_SCHEDULED_FOR_WRITE_FLAG UINT64CONST(0x0000000000800000)
+#define S3_PART_PREFETCHED_FLAG	   UINT64CONST(0x0000000001000000)
 #define S3_PART_USAGE_COUNT_MASK   UINT64CONST(0x00000000FE000000)
 #define S3_PART_USAGE_COUNT_MAX    (0x7F)
 #define S3_PART_USAGE_COUNT_SHIFT  (25)
 #define S3_PART_GET_USAGE_COUNT(p) (((p) & S3_PART_USAGE_COUNT_MASK) >> S3_PART_USAGE_COUNT_SHIFT)
 #define S3_PART_SET_USAGE_COUNT(p, u) (((p) & (~S3_PART_USAGE_COUNT_MASK)) | ((uint64) (u) << S3_PART_USAGE_COUNT_SHIFT))
 
+/*
+ * Every eviction pass halves the usage counts of the parts it can't evict.
+ * So, this number of passes is enough to make any part evictable.
+ */
+#define S3_EVICTION_MAX_PASSES	   (8)
+
+PG_FUNCTION_INFO_V1(orioledb_s3_cache_stats);
+
 static void initial_parts_conting(void);
 static void sync_buffer(S3HeaderBuffer *buffer);
 
@@ -186,6 +208,14 @@ s3_headers_shmem_init(Pointer buf, bool found)
 		meta->groupCtlTrancheId = LWLockNewTrancheId();
 		meta->bufferCtlTrancheId = LWLockNewTrancheId();
 		pg_atomic_init_u64(&meta->numberOfLoadedParts, 0);
+		pg_atomic_init_u64(&meta->hits, 0);
+		pg_atomic_init_u64(&meta->misses, 0);
+		pg_atomic_init_u64(&meta->loads, 0);
+		pg_atomic_init_u64(&meta->prefetchLoads, 0);
+		pg_atomic_init_u64(&meta->evictions, 0);
+		pg_atomic_init_u64(&meta->unusedPrefetchEvictions, 0);
+		pg_atomic_init_u64(&meta->evictedBytes, 0);
+		pg_atomic_init_u64(&meta->evictionPasses, 0);
 
 		for (i = 0; i < groupsCount; i++)
 		{
@@ -690,6 +720,11 @@ s3_header_compare_and_swap(S3HeaderTag tag, int index,
 }
 
 
+/*
+ * Number of the file parts, which this backend found not loaded from S3.
+ */
+uint64		s3_header_my_misses = 0;
+
 /*
  * We allow only one part to be locked simultaneosly.
  */
@@ -708,6 +743,13 @@ s3_header_lock_part(S3HeaderTag tag, int index, uint32 *loadId)
 	Assert(!OidIsValid(curLockedTag.datoid) && !OidIsValid(curLockedTag.relnode));
 
 	value = s3_header_read_value(tag, index);
+	if (S3_PART_GET_STATUS(value) == S3PartStatusLoaded)
+		pg_atomic_fetch_add_u64(&meta->hits, 1);
+	else
+	{
+		pg_atomic_fetch_add_u64(&meta->misses, 1);
+		s3_header_my_misses++;
+	}
 
 	while (true)
 	{
@@ -742,6 +784,7 @@ s3_header_lock_part(S3HeaderTag tag, int index, uint32 *loadId)
 			if (usageCount < S3_PART_USAGE_COUNT_MAX)
 				usageCount++;
 			newValue = S3_PART_SET_USAGE_COUNT(newValue, usageCount);
+			newValue &= ~S3_PART_PREFETCHED_FLAG;
 		}
 
 		if (s3_header_compare_and_swap_extended(tag, index, &value,
@@ -754,8 +797,12 @@ s3_header_lock_part(S3HeaderTag tag, int index, uint32 *loadId)
 	}
 }
 
+/*
+ * Marks the part as being loaded from S3.  'prefetch' means that the part is
+ * loaded ahead of the access, which might never happen.
+ */
 S3PartStatus
-s3_header_mark_part_loading(S3HeaderTag tag, int index)
+s3_header_mark_part_loading(S3HeaderTag tag, int index, bool prefetch)
 {
 	uint32		value;
 
@@ -783,6 +830,10 @@ s3_header_mark_part_loading(S3HeaderTag tag, int index)
 		{
 			Assert(status == S3PartStatusNotLoaded);
 			newValue = S3_PART_SET_STATUS(value, S3PartStatusLoading);
+			if (prefetch)
+				newValue |= S3_PART_PREFETCHED_FLAG;
+			else
+				newValue &= ~S3_PART_PREFETCHED_FLAG;
 		}
 
 		if (s3_header_compare_and_swap(tag, index, &value, newValue))
@@ -801,8 +852,12 @@ s3_header_mark_part_loading(S3HeaderTag tag, int index)
 	}
 }
 
+/*
+ * Marks the part as loaded.  'fromS3' means that the part data was actually
+ * read from S3, rather than written locally.
+ */
 void
-s3_header_mark_part_loaded(S3HeaderTag tag, int index)
+s3_header_mark_part_loaded(S3HeaderTag tag, int index, bool fromS3)
 {
 	uint32		value;
 
@@ -817,10 +872,29 @@ s3_header_mark_part_loaded(S3HeaderTag tag, int index)
 
 		Assert(status == S3PartStatusLoading);
 		newValue = S3_PART_SET_STATUS(value, S3PartStatusLoaded);
-		newValue = S3_PART_SET_USAGE_COUNT(newValue, 1);
+
+		/*
+		 * With the second touch admission, the access the part is loaded for
+		 * makes its usage count one instead of two.  So, the part read once
+		 * survives one eviction cycle less than the part accessed again.
+		 * This keeps the parts read by scans from pushing hot parts out of
+		 * the local storage.  The prefetched parts are always admitted this
+		 * way: the scans prefetch the parts they read once.
+		 */
+		newValue = S3_PART_SET_USAGE_COUNT(newValue,
+										   (s3_second_touch_admission ||
+											(value & S3_PART_PREFETCHED_FLAG)) ? 0 : 1);
 
 		if (s3_header_compare_and_swap(tag, index, &value, newValue))
+		{
+			if (fromS3)
+			{
+				pg_atomic_fetch_add_u64(&meta->loads, 1);
+				if (value & S3_PART_PREFETCHED_FLAG)
+					pg_atomic_fetch_add_u64(&meta->prefetchLoads, 1);
+			}
 			return;
+		}
 	}
 }
 
@@ -1236,10 +1310,16 @@ eviction_callback(S3HeaderTag tag)
 					S3_PART_GET_STATUS(newValue) == S3PartStatusEvicting)
 				{
 					off_t		offset = (off_t) i * (off_t) ORIOLEDB_S3_PART_SIZE + (off_t) ORIOLEDB_BLCKSZ;
+					off_t		length = Max(Min(offset + ORIOLEDB_S3_PART_SIZE, fileSize) - offset, 0);
 					uint64		result;
 
 					elog(DEBUG1, "S3 evict %u %u %u %d %d", tag.datoid, tag.relnode, tag.checkpointNum, tag.segNum, i);
-					pg_pwrite_zeros(fd, Min(offset + ORIOLEDB_S3_PART_SIZE, fileSize) - offset, offset);
+					pg_pwrite_zeros(fd, length, offset);
+
+					pg_atomic_fetch_add_u64(&meta->evictions, 1);
+					pg_atomic_fetch_add_u64(&meta->evictedBytes, length);
+					if (value & S3_PART_PREFETCHED_FLAG)
+						pg_atomic_fetch_add_u64(&meta->unusedPrefetchEvictions, 1);
 
 					result = pg_atomic_fetch_sub_u64(&meta->numberOfLoadedParts, 1);
 					elog(DEBUG1, "eviction_callback(%llu 1)",
@@ -1260,16 +1340,84 @@ eviction_callback(S3HeaderTag tag)
 	close(fd);
 }
 
+/*
+ * Evicts the file parts until the local storage fits orioledb.s3_desired_size.
+ * A single pass over the files only evicts the parts, which weren't used
+ * since the previous pass.  So, the passes are repeated while the budget is
+ * exceeded.
+ */
 void
 s3_headers_try_eviction_cycle(void)
 {
 	uint64		desiredNumParts = (uint64) s3_desired_size * (uint64) (1024 * 1024) / (uint64) ORIOLEDB_S3_PART_SIZE;
+	int			pass;
 
 	Assert(orioledb_s3_mode);
 
-	if (pg_atomic_read_u64(&meta->numberOfLoadedParts) < desiredNumParts)
-		return;
+	for (pass = 0; pass < S3_EVICTION_MAX_PASSES; pass++)
+	{
+		if (pg_atomic_read_u64(&meta->numberOfLoadedParts) < desiredNumParts)
+			return;
 
-	iterate_files(eviction_callback);
+		iterate_files(eviction_callback);
+		pg_atomic_fetch_add_u64(&meta->evictionPasses, 1);
+	}
+}
 
+/*
+ * Returns the statistics of the local cache of the file parts loaded from S3.
+ */
+Datum
+orioledb_s3_cache_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Datum		values[12];
+	bool		nulls[12];
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	uint64		loadedParts,
+				hits,
+				misses;
+
+	orioledb_check_shmem();
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	loadedParts = pg_atomic_read_u64(&meta->numberOfLoadedParts);
+	hits = pg_atomic_read_u64(&meta->hits);
+	misses = pg_atomic_read_u64(&meta->misses);
+
+	MemSet(nulls, 0, sizeof(nulls));
+	values[0] = Int64GetDatum(loadedParts);
+	values[1] = Int64GetDatum(loadedParts * ORIOLEDB_S3_PART_SIZE);
+	values[2] = Int64GetDatum((int64) s3_desired_size * 1024 * 1024);
+	values[3] = Int64GetDatum(hits);
+	values[4] = Int64GetDatum(misses);
+	if (hits + misses > 0)
+		values[5] = Float8GetDatum((double) hits / (double) (hits + misses));
+	else
+		nulls[5] = true;
+	values[6] = Int64GetDatum(pg_atomic_read_u64(&meta->loads));
+	values[7] = Int64GetDatum(pg_atomic_read_u64(&meta->prefetchLoads));
+	values[8] = Int64GetDatum(pg_atomic_read_u64(&meta->evictions));
+	values[9] = Int64GetDatum(pg_atomic_read_u64(&meta->unusedPrefetchEvictions));
+	values[10] = Int64GetDatum(pg_atomic_read_u64(&meta->evictedBytes));
+	values[11] = Int64GetDatum(pg_atomic_read_u64(&meta->evictionPasses));
+	tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+
+	return (Datum) 0;
 }
@@ -16,6 +16,7 @@
 #include "orioledb.h"
 
 #include "s3/queue.h"
+#include "utils/o_wait_events.h"
 
 #include "utils/wait_event.h"
 
@@ -27,6 +28,8 @@ typedef struct
 	/* Location to insert new tasks */
 	pg_atomic_uint64 insertLocation;
 	ConditionVariable insertLocationCV;
+	/* Number of workers sleeping on insertLocationCV */
+	pg_atomic_uint32 sleepingWorkers;
 
 	/* Location to pick the existing tasks by workers */
 	pg_atomic_uint64 pickLocation;
@@ -81,6 +84,7 @@ s3_queue_init_shmem(Pointer ptr, bool found)
 		pg_atomic_init_u64(&s3_queue_meta->insertLocation, 0);
 		pg_atomic_init_u64(&s3_queue_meta->pickLocation, 0);
 		pg_atomic_init_u64(&s3_queue_meta->erasedLocation, 0);
+		pg_atomic_init_u32(&s3_queue_meta->sleepingWorkers, 0);
 
 		ConditionVariableInit(&s3_queue_meta->insertLocationCV);
 		ConditionVariableInit(&s3_queue_meta->erasedLocationCV);
@@ -104,6 +108,7 @@ s3_queue_put_task(Pointer data, uint32 len)
 	S3TaskLocation insertLocation;
 	bool		slept = false;
 	uint32		totallen = len + sizeof(uint32);
+	instr_time	waitStart;
 
 	Assert(totallen = INTALIGN(totallen));
 
@@ -116,11 +121,17 @@ s3_queue_put_task(Pointer data, uint32 len)
 	 */
 	while (insertLocation + totallen > pg_atomic_read_u64(&s3_queue_meta->erasedLocation) + s3_queue_size)
 	{
-		ConditionVariableSleep(&s3_queue_meta->erasedLocationCV, WAIT_EVENT_MQ_PUT_MESSAGE);
+		if (!slept)
+			INSTR_TIME_SET_CURRENT(waitStart);
+		ConditionVariableSleep(&s3_queue_meta->erasedLocationCV,
+							   o_wait_event_info(OWaitS3Queue));
 		slept = true;
 	}
 	if (slept)
+	{
 		ConditionVariableCancelSleep();
+		o_wait_event_account(OWaitS3Queue, &waitStart);
+	}
 
 	/* Put the task into a circular buffer */
 	if (insertLocation / s3_queue_size == (insertLocation + totallen - 1) / s3_queue_size)
@@ -155,9 +166,45 @@ s3_queue_put_task(Pointer data, uint32 len)
 	pg_write_barrier();
 	*((uint32 *) (s3_queue_buffer + insertLocation % s3_queue_size)) = totallen;
 
+	/*
+	 * Wake up a sleeping worker.  The barrier pairs with the one in
+	 * s3_queue_wait_for_tasks(): either we see the worker going to sleep or
+	 * the worker sees our task.
+	 */
+	pg_memory_barrier();
+	if (pg_atomic_read_u32(&s3_queue_meta->sleepingWorkers) > 0)
+		ConditionVariableSignal(&s3_queue_meta->insertLocationCV);
+
 	return insertLocation;
 }
 
+/*
+ * Sleep until a new task is put into the queue or the timeout expires.
+ */
+void
+s3_queue_wait_for_tasks(long timeout)
+{
+	S3TaskLocation pickLocation,
+				insertLocation;
+	uint32		taskLen;
+
+	ConditionVariablePrepareToSleep(&s3_queue_meta->insertLocationCV);
+	(void) pg_atomic_fetch_add_u32(&s3_queue_meta->sleepingWorkers, 1);
+
+	pickLocation = pg_atomic_read_u64(&s3_queue_meta->pickLocation);
+	insertLocation = pg_atomic_read_u64(&s3_queue_meta->insertLocation);
+	taskLen = pickLocation < insertLocation ?
+		*((volatile uint32 *) (s3_queue_buffer + pickLocation % s3_queue_size)) : 0;
+
+	/* Don't sleep if there is the task ready to be picked */
+	if (taskLen == 0 || (taskLen & LENGTH_ERASED_FLAG))
+		(void) ConditionVariableTimedSleep(&s3_queue_meta->insertLocationCV,
+										   timeout, WAIT_EVENT_MQ_RECEIVE);
+
+	(void) pg_atomic_fetch_sub_u32(&s3_queue_meta->sleepingWorkers, 1);
+	ConditionVariableCancelSleep();
+}
+
 /*
  * Try to pick the task for processing.  Returns the task location on success,
  * and InvalidS3TaskLocation on failure.
@@ -329,19 +376,71 @@ s3_queue_erase_task(S3TaskLocation taskLocation)
 }
 
 /*
- * Wait till the task with given location is processed by worker.
+ * Wait till the task with given location and all the tasks before it are
+ * processed by workers.
  */
 void
 s3_queue_wait_for_location(S3TaskLocation location)
 {
 	bool		slept = false;
+	instr_time	waitStart;
 
 	while (pg_atomic_read_u64(&s3_queue_meta->erasedLocation) <= location)
 	{
+		if (!slept)
+			INSTR_TIME_SET_CURRENT(waitStart);
 		ConditionVariableSleep(&s3_queue_meta->erasedLocationCV,
-							   WAIT_EVENT_MQ_PUT_MESSAGE);
+							   o_wait_event_info(OWaitS3Queue));
 		slept = true;
 	}
 	if (slept)
+	{
 		ConditionVariableCancelSleep();
+		o_wait_event_account(OWaitS3Queue, &waitStart);
+	}
+}
+
+/*
+ * Checks if the single task with given location is processed.  The task is
+ * done if its length is marked as erased, or if the erased location already
+ * passed it.  The task slot can't be reused until the erased location passes
+ * the task, so its flag can't belong to another unprocessed task.
+ */
+static bool
+s3_queue_task_is_done(S3TaskLocation location)
+{
+	uint32		taskLen;
+
+	taskLen = *((volatile uint32 *) (s3_queue_buffer + location % s3_queue_size));
+	if (taskLen & LENGTH_ERASED_FLAG)
+		return true;
+
+	pg_read_barrier();
+	return pg_atomic_read_u64(&s3_queue_meta->erasedLocation) > location;
+}
+
+/*
+ * Wait till the single task with given location is processed by worker.
+ * Unlike s3_queue_wait_for_location(), doesn't wait for the tasks before it,
+ * so it's not delayed by long uploads scheduled earlier.
+ */
+void
+s3_queue_wait_for_task(S3TaskLocation location)
+{
+	bool		slept = false;
+	instr_time	waitStart;
+
+	while (!s3_queue_task_is_done(location))
+	{
+		if (!slept)
+			INSTR_TIME_SET_CURRENT(waitStart);
+		ConditionVariableSleep(&s3_queue_meta->erasedLocationCV,
+							   o_wait_event_info(OWaitS3Queue));
+		slept = true;
+	}
+	if (slept)
+	{
+		ConditionVariableCancelSleep();
+		o_wait_event_account(OWaitS3Queue, &waitStart);
+	}
 }
@@ -13,23 +13,85 @@
 
 #include "postgres.h"
 
+#include <ctype.h>
 #include <stdbool.h>
 #include <unistd.h>
 
 #include "orioledb.h"
 
+#include "btree/io.h"
 #include "s3/requests.h"
+#include "utils/compress.h"
 
 #include "common/base64.h"
+#include "funcapi.h"
 #include "lib/stringinfo.h"
+#include "miscadmin.h"
+#include "port/pg_crc32c.h"
+#include "utils/builtins.h"
+#include "utils/tuplestore.h"
 #include "utils/wait_event.h"
 
 #include "curl/curl.h"
 #include "openssl/hmac.h"
 #include "openssl/sha.h"
+#include <zstd.h>
 
 PG_FUNCTION_INFO_V1(s3_get);
 PG_FUNCTION_INFO_V1(s3_put);
+PG_FUNCTION_INFO_V1(orioledb_s3_stats);
+PG_FUNCTION_INFO_V1(orioledb_s3_stats_reset);
+
+/* S3 doesn't accept the parts smaller than 5MB except the last one */
+#define S3_MULTIPART_MIN_PART_SIZE	(5 * 1024 * 1024)
+#define S3_PART_MAX_ATTEMPTS		3
+
+/*
+ * The part of the multipart upload.
+ */
+typedef struct
+{
+	int			partNum;
+	Pointer		data;
+	uint64		size;
+	char	   *checksum;
+	char	   *checksumHeader;
+	int			attempts;
+	/* the request in flight */
+	CURL	   *curl;
+	struct curl_slist *slist;
+	char	   *url;
+	/* the result of the last attempt */
+	int			sc;
+	long		httpCode;
+	char	   *etag;
+	StringInfoData response;
+} S3UploadPart;
+
+/* How long the resolved host names are kept in the DNS cache, in seconds */
+#define S3_DNS_CACHE_TIMEOUT		300
+
+/*
+ * The counters of S3 requests made by all the processes.
+ */
+typedef struct
+{
+	pg_atomic_uint64 requests;
+	pg_atomic_uint64 newConnections;
+	pg_atomic_uint64 http2Requests;
+	/* in microseconds */
+	pg_atomic_uint64 connectTime;
+	pg_atomic_uint64 requestTime;
+} S3RequestStats;
+
+static S3RequestStats *s3_request_stats = NULL;
+
+/*
+ * The connections, DNS cache and TLS sessions are shared by all the curl
+ * handles of the process and survive between the requests.
+ */
+static CURLSH *s3_curl_share = NULL;
+static CURL *s3_curl = NULL;
 
 static void
 hmac_sha256(char *input, char *output, char *secretkey, int secretkeylen)
@@ -60,26 +122,50 @@ hex_string(Pointer data, int len)
 	return result;
 }
 
+/*
+ * Returns the list of signed headers.  'checksumheader' is the optional
+ * "x-amz-checksum-*: value" header, which sorts between "host" and
+ * "x-amz-content-sha256".
+ */
+static char *
+signed_header_names(char *checksumheader)
+{
+	if (checksumheader)
+		return psprintf("host;%.*s;x-amz-content-sha256;x-amz-date",
+						(int) strcspn(checksumheader, ":"), checksumheader);
+	return pstrdup("host;x-amz-content-sha256;x-amz-date");
+}
+
 /*
  * Calculate the checksum of canonical request according to AWS4-HMAC-SHA256.
  */
 static char *
 canonical_request_checksum(char *method, char *datetime, char *objectname,
-						   char *contentchecksum)
+						   char *query, char *contentchecksum,
+						   char *checksumheader)
 {
 	StringInfoData buf;
 	unsigned char checksumbuf[32];
+	char	   *headernames = signed_header_names(checksumheader);
 
 	initStringInfo(&buf);
 	appendStringInfo(&buf, "%s\n", method);
 	appendStringInfo(&buf, "/%s\n", objectname);
-	appendStringInfo(&buf, "\n");
+	appendStringInfo(&buf, "%s\n", query);
 	appendStringInfo(&buf, "host:%s\n", s3_host);
+	if (checksumheader)
+	{
+		int			namelen = strcspn(checksumheader, ":");
+
+		appendStringInfo(&buf, "%.*s:%s\n", namelen, checksumheader,
+						 checksumheader + namelen + 2);
+	}
 	appendStringInfo(&buf, "x-amz-content-sha256:%s\n", contentchecksum);
 	appendStringInfo(&buf, "x-amz-date:%s\n", datetime);
 	appendStringInfo(&buf, "\n");
-	appendStringInfo(&buf, "host;x-amz-content-sha256;x-amz-date\n");
+	appendStringInfo(&buf, "%s\n", headernames);
 	appendStringInfo(&buf, "%s", contentchecksum);
+	pfree(headernames);
 
 	(void) SHA256((unsigned char *) buf.data, buf.len, checksumbuf);
 	pfree(buf.data);
@@ -93,7 +179,8 @@ canonical_request_checksum(char *method, char *datetime, char *objectname,
  */
 static char *
 s3_signature(char *method, char *datetimestring, char *datestring,
-			 char *objectname, char *secretkey, char *checksumstring)
+			 char *objectname, char *query, char *secretkey,
+			 char *checksumstring, char *checksumheader)
 {
 	StringInfoData buf;
 	char	   *key;
@@ -101,7 +188,9 @@ s3_signature(char *method, char *datetimestring, char *datestring,
 	char	   *canonical_checksum;
 
 	canonical_checksum = canonical_request_checksum(method, datetimestring,
-													objectname, checksumstring);
+													objectname, query,
+													checksumstring,
+													checksumheader);
 
 	key = psprintf("AWS4%s", s3_secretkey);
 	hmac_sha256(datestring, checksumbuf, key, strlen(key));
@@ -158,6 +247,101 @@ httpdatetime(time_t *timer)
 	return datetimestring;
 }
 
+Size
+s3_requests_shmem_needs(void)
+{
+	return CACHELINEALIGN(sizeof(S3RequestStats));
+}
+
+void
+s3_requests_shmem_init(Pointer ptr, bool found)
+{
+	s3_request_stats = (S3RequestStats *) ptr;
+
+	if (!found)
+	{
+		pg_atomic_init_u64(&s3_request_stats->requests, 0);
+		pg_atomic_init_u64(&s3_request_stats->newConnections, 0);
+		pg_atomic_init_u64(&s3_request_stats->http2Requests, 0);
+		pg_atomic_init_u64(&s3_request_stats->connectTime, 0);
+		pg_atomic_init_u64(&s3_request_stats->requestTime, 0);
+	}
+}
+
+/*
+ * Sets the options common for all the S3 requests.  The connections are kept
+ * alive and reused, HTTP/2 is negotiated over TLS when the endpoint supports
+ * it.
+ */
+static void
+s3_curl_setup(CURL *curl)
+{
+	if (s3_curl_share == NULL)
+	{
+		s3_curl_share = curl_share_init();
+		curl_share_setopt(s3_curl_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+		curl_share_setopt(s3_curl_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+		curl_share_setopt(s3_curl_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+	}
+
+	curl_easy_setopt(curl, CURLOPT_SHARE, s3_curl_share);
+	curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+	curl_easy_setopt(curl, CURLOPT_DNS_CACHE_TIMEOUT, (long) S3_DNS_CACHE_TIMEOUT);
+	curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, (long) CURL_HTTP_VERSION_2TLS);
+	curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+	if (s3_cainfo)
+		curl_easy_setopt(curl, CURLOPT_CAINFO, s3_cainfo);
+}
+
+/*
+ * Returns the persistent curl handle of the process for the next request.
+ */
+static CURL *
+s3_curl_get(void)
+{
+	if (s3_curl == NULL)
+		s3_curl = curl_easy_init();
+	else
+		curl_easy_reset(s3_curl);
+
+	s3_curl_setup(s3_curl);
+	return s3_curl;
+}
+
+/*
+ * Accounts the finished request in the S3 stats.  The connection setup time
+ * is counted only for the requests, which established new connections.
+ */
+static void
+s3_curl_report_stats(CURL *curl)
+{
+	long		numConnects = 0,
+				httpVersion = 0;
+	curl_off_t	connectTime = 0,
+				appConnectTime = 0,
+				totalTime = 0;
+
+	if (s3_request_stats == NULL)
+		return;
+
+	curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &numConnects);
+	curl_easy_getinfo(curl, CURLINFO_HTTP_VERSION, &httpVersion);
+	curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connectTime);
+	curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &appConnectTime);
+	curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &totalTime);
+
+	pg_atomic_fetch_add_u64(&s3_request_stats->requests, 1);
+	if (numConnects > 0)
+	{
+		pg_atomic_fetch_add_u64(&s3_request_stats->newConnections, numConnects);
+		pg_atomic_fetch_add_u64(&s3_request_stats->connectTime,
+								Max(connectTime, appConnectTime));
+	}
+	if (httpVersion == CURL_HTTP_VERSION_2_0)
+		pg_atomic_fetch_add_u64(&s3_request_stats->http2Requests, 1);
+	pg_atomic_fetch_add_u64(&s3_request_stats->requestTime, totalTime);
+}
+
 /*
  * Curl callback, which appends data to String Info.
  */
@@ -213,7 +397,7 @@ s3_get_object(char *objectname, StringInfo str, bool missing_ok)
 	datestring = httpdate(NULL);
 	datetimestring = httpdatetime(NULL);
 	signature = s3_signature("GET", datetimestring, datestring, objectpath,
-							 s3_secretkey, checksumstringbuf);
+							 "", s3_secretkey, checksumstringbuf, NULL);
 
 	slist = NULL;
 	slist = curl_slist_append(slist, (tmp = psprintf("x-amz-date: %s", datetimestring)));
@@ -225,11 +409,9 @@ s3_get_object(char *objectname, StringInfo str, bool missing_ok)
 											  s3_accesskey, datestring, s3_region, signature)));
 	pfree(tmp);
 
-	curl = curl_easy_init();
+	curl = s3_curl_get();
 	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, slist);
 	curl_easy_setopt(curl, CURLOPT_URL, url);
-	if (s3_cainfo)
-		curl_easy_setopt(curl, CURLOPT_CAINFO, s3_cainfo);
 	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data_to_buf);
 	curl_easy_setopt(curl, CURLOPT_WRITEDATA, str);
 
@@ -249,7 +431,7 @@ s3_get_object(char *objectname, StringInfo str, bool missing_ok)
 									  sc, http_code, str->data)));
 	}
 
-	curl_easy_cleanup(curl);
+	s3_curl_report_stats(curl);
 
 	curl_slist_free_all(slist);
 	pfree(url);
@@ -319,7 +501,7 @@ s3_delete_object(char *objectname)
 	datestring = httpdate(NULL);
 	datetimestring = httpdatetime(NULL);
 	signature = s3_signature("DELETE", datetimestring, datestring, objectpath,
-							 s3_secretkey, checksumstringbuf);
+							 "", s3_secretkey, checksumstringbuf, NULL);
 
 	slist = NULL;
 	slist = curl_slist_append(slist, (tmp = psprintf("x-amz-date: %s", datetimestring)));
@@ -333,12 +515,10 @@ s3_delete_object(char *objectname)
 
 	initStringInfo(&buf);
 
-	curl = curl_easy_init();
+	curl = s3_curl_get();
 	curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "DELETE");
 	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, slist);
 	curl_easy_setopt(curl, CURLOPT_URL, url);
-	if (s3_cainfo)
-		curl_easy_setopt(curl, CURLOPT_CAINFO, s3_cainfo);
 	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data_to_buf);
 	curl_easy_setopt(curl, CURLOPT_WRITEDATA, &buf);
 
@@ -351,7 +531,7 @@ s3_delete_object(char *objectname)
 						errdetail("return code = %d, http code = %ld, response = %s",
 								  sc, http_code, buf.data)));
 
-	curl_easy_cleanup(curl);
+	s3_curl_report_stats(curl);
 
 	curl_slist_free_all(slist);
 	pfree(url);
@@ -447,7 +627,7 @@ write_file_part(const char *filename, uint64 offset,
 		return;
 	}
 
-	rc = FileWrite(file, data, size, offset, WAIT_EVENT_DATA_FILE_WRITE);
+	rc = OFileWrite(file, data, size, offset, WAIT_EVENT_DATA_FILE_WRITE);
 
 	if (rc < 0 || rc != size)
 	{
@@ -480,10 +660,62 @@ write_file(const char *filename, Pointer data, uint64 size)
 	write_file_part(filename, 0, data, size);
 }
 
+/*
+ * Returns the "x-amz-checksum-crc32c: value" header of the data.  CRC32C is
+ * computed using the CPU instructions when they are available.
+ */
+static char *
+crc32c_checksum_header(Pointer data, uint64 dataSize)
+{
+	pg_crc32c	crc;
+	uint8		crcbuf[sizeof(crc)];
+	char		b64[16];
+	int			len;
+
+	INIT_CRC32C(crc);
+	COMP_CRC32C(crc, data, dataSize);
+	FIN_CRC32C(crc);
+
+	/* S3 expects base64 of the big-endian CRC value */
+	crcbuf[0] = (crc >> 24) & 0xFF;
+	crcbuf[1] = (crc >> 16) & 0xFF;
+	crcbuf[2] = (crc >> 8) & 0xFF;
+	crcbuf[3] = crc & 0xFF;
+	len = pg_b64_encode((void *) crcbuf, sizeof(crcbuf), b64, sizeof(b64) - 1);
+	Assert(len > 0);
+	b64[len] = '\0';
+
+	return psprintf("x-amz-checksum-crc32c: %s", b64);
+}
+
+/*
+ * Computes the checksum of the payload according to
+ * orioledb.s3_checksum_algorithm.  Returns the value of the
+ * x-amz-content-sha256 header.  For CRC32C the payload isn't signed and
+ * '*checksumheader' is set to the x-amz-checksum-crc32c header S3
+ * verifies the payload with, otherwise it's set to NULL.
+ */
+static char *
+payload_checksum(Pointer data, uint64 dataSize, char **checksumheader)
+{
+	unsigned char checksumbuf[SHA256_DIGEST_LENGTH];
+
+	if (s3_checksum_algorithm == S3_CHECKSUM_CRC32C)
+	{
+		*checksumheader = crc32c_checksum_header(data, dataSize);
+		return pstrdup("UNSIGNED-PAYLOAD");
+	}
+
+	*checksumheader = NULL;
+	(void) SHA256((unsigned char *) data, dataSize, checksumbuf);
+	return hex_string((Pointer) checksumbuf, sizeof(checksumbuf));
+}
+
 /*
  * Put object with given binary contents to S3.
  *
- * If dataChecksum is NULL the function calculates checksum of the content.
+ * If dataChecksum is NULL the function calculates checksum of the content
+ * according to orioledb.s3_checksum_algorithm.
  *
  * Returns HTTP status code.
  */
@@ -497,6 +729,8 @@ s3_put_object_with_contents(char *objectname, Pointer data, uint64 dataSize,
 	char	   *datetimestring;
 	char	   *signature;
 	char	   *checksumstringbuf;
+	char	   *checksumheader = NULL;
+	char	   *headernames;
 	char	   *objectpath = objectname;
 	struct curl_slist *slist;
 	char	   *tmp;
@@ -505,12 +739,7 @@ s3_put_object_with_contents(char *objectname, Pointer data, uint64 dataSize,
 	long		http_code = 0;
 
 	if (dataChecksum == NULL)
-	{
-		unsigned char checksumbuf[SHA256_DIGEST_LENGTH];
-
-		(void) SHA256((unsigned char *) data, dataSize, checksumbuf);
-		checksumstringbuf = hex_string((Pointer) checksumbuf, sizeof(checksumbuf));
-	}
+		checksumstringbuf = payload_checksum(data, dataSize, &checksumheader);
 	else
 		checksumstringbuf = dataChecksum;
 
@@ -531,31 +760,34 @@ s3_put_object_with_contents(char *objectname, Pointer data, uint64 dataSize,
 	datestring = httpdate(NULL);
 	datetimestring = httpdatetime(NULL);
 	signature = s3_signature("PUT", datetimestring, datestring, objectpath,
-							 s3_secretkey, checksumstringbuf);
+							 "", s3_secretkey, checksumstringbuf,
+							 checksumheader);
+	headernames = signed_header_names(checksumheader);
 
 	slist = NULL;
 	slist = curl_slist_append(slist, (tmp = psprintf("x-amz-date: %s", datetimestring)));
 	pfree(tmp);
 	slist = curl_slist_append(slist, (tmp = psprintf("x-amz-content-sha256: %s", checksumstringbuf)));
 	pfree(tmp);
+	if (checksumheader)
+		slist = curl_slist_append(slist, checksumheader);
 	slist = curl_slist_append(slist, (tmp = psprintf("Content-Length: %lu", dataSize)));
 	pfree(tmp);
 	slist = curl_slist_append(slist,
-							  (tmp = psprintf("Authorization: AWS4-HMAC-SHA256 Credential=%s/%s/%s/s3/aws4_request, SignedHeaders=host;x-amz-content-sha256;x-amz-date, Signature=%s",
-											  s3_accesskey, datestring, s3_region, signature)));
+							  (tmp = psprintf("Authorization: AWS4-HMAC-SHA256 Credential=%s/%s/%s/s3/aws4_request, SignedHeaders=%s, Signature=%s",
+											  s3_accesskey, datestring, s3_region, headernames, signature)));
 	pfree(tmp);
+	pfree(headernames);
 	slist = curl_slist_append(slist, "Content-Type: application/octet-stream");
 	if (ifNoneMatch)
 		slist = curl_slist_append(slist, "If-None-Match: *");
 
 	initStringInfo(&buf);
 
-	curl = curl_easy_init();
+	curl = s3_curl_get();
 	curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
 	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, slist);
 	curl_easy_setopt(curl, CURLOPT_URL, url);
-	if (s3_cainfo)
-		curl_easy_setopt(curl, CURLOPT_CAINFO, s3_cainfo);
 	curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data);
 	curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, dataSize);
 	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data_to_buf);
@@ -582,7 +814,7 @@ s3_put_object_with_contents(char *objectname, Pointer data, uint64 dataSize,
 									  sc, http_code, buf.data)));
 	}
 
-	curl_easy_cleanup(curl);
+	s3_curl_report_stats(curl);
 
 	curl_slist_free_all(slist);
 	pfree(url);
@@ -594,10 +826,436 @@ s3_put_object_with_contents(char *objectname, Pointer data, uint64 dataSize,
 		pfree(objectpath);
 	if (checksumstringbuf != dataChecksum)
 		pfree(checksumstringbuf);
+	if (checksumheader)
+		pfree(checksumheader);
 
 	return http_code;
 }
 
+/*
+ * Returns the path of the object in the bucket.  The caller should free it
+ * if it differs from 'objectname'.
+ */
+static char *
+s3_object_path(char *objectname)
+{
+	if (s3_prefix)
+	{
+		int			prefix_len = strlen(s3_prefix);
+
+		if (prefix_len != 0)
+		{
+			if (s3_prefix[prefix_len - 1] == '/')
+				prefix_len--;
+			return psprintf("%.*s/%s", prefix_len, s3_prefix, objectname);
+		}
+	}
+	return objectname;
+}
+
+/*
+ * Makes the list of signed headers for the request to 'objectpath'.  'query'
+ * is the canonical query string of the request.  'checksumheader' is the
+ * optional x-amz-checksum-* header.
+ */
+static struct curl_slist *
+s3_signed_headers(char *method, char *objectpath, char *query,
+				  char *checksumstring, char *checksumheader)
+{
+	char	   *datestring;
+	char	   *datetimestring;
+	char	   *signature;
+	char	   *headernames;
+	struct curl_slist *slist = NULL;
+	char	   *tmp;
+
+	datestring = httpdate(NULL);
+	datetimestring = httpdatetime(NULL);
+	signature = s3_signature(method, datetimestring, datestring, objectpath,
+							 query, s3_secretkey, checksumstring,
+							 checksumheader);
+	headernames = signed_header_names(checksumheader);
+
+	slist = curl_slist_append(slist, (tmp = psprintf("x-amz-date: %s", datetimestring)));
+	pfree(tmp);
+	slist = curl_slist_append(slist, (tmp = psprintf("x-amz-content-sha256: %s", checksumstring)));
+	pfree(tmp);
+	if (checksumheader)
+		slist = curl_slist_append(slist, checksumheader);
+	slist = curl_slist_append(slist,
+							  (tmp = psprintf("Authorization: AWS4-HMAC-SHA256 Credential=%s/%s/%s/s3/aws4_request, SignedHeaders=%s, Signature=%s",
+											  s3_accesskey, datestring, s3_region, headernames, signature)));
+	pfree(tmp);
+
+	pfree(headernames);
+	pfree(datestring);
+	pfree(datetimestring);
+	pfree(signature);
+
+	return slist;
+}
+
+/*
+ * Makes the request of the multipart upload protocol: initiation, completion
+ * or abort.  Puts the response body into 'response'.  'checksumheader' is
+ * the optional x-amz-checksum-* header of the request.
+ *
+ * Returns HTTP status code.
+ */
+static long
+s3_multipart_request(char *method, char *objectpath, char *query,
+					 Pointer data, uint64 dataSize, StringInfo response,
+					 char *checksumheader)
+{
+	CURL	   *curl;
+	char	   *url;
+	unsigned char checksumbuf[SHA256_DIGEST_LENGTH];
+	char	   *checksumstringbuf;
+	struct curl_slist *slist;
+	int			sc;
+	long		http_code = 0;
+
+	(void) SHA256((unsigned char *) data, dataSize, checksumbuf);
+	checksumstringbuf = hex_string((Pointer) checksumbuf, sizeof(checksumbuf));
+
+	url = psprintf("%s://%s/%s?%s",
+				   s3_use_https ? "https" : "http", s3_host, objectpath, query);
+	slist = s3_signed_headers(method, objectpath, query, checksumstringbuf,
+							  checksumheader);
+
+	resetStringInfo(response);
+
+	curl = s3_curl_get();
+	curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, method);
+	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, slist);
+	curl_easy_setopt(curl, CURLOPT_URL, url);
+	if (strcmp(method, "POST") == 0)
+	{
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data ? data : "");
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t) dataSize);
+	}
+	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data_to_buf);
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, response);
+
+	sc = curl_easy_perform(curl);
+	curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+	if (sc != 0)
+		http_code = 0;
+
+	s3_curl_report_stats(curl);
+
+	curl_slist_free_all(slist);
+	pfree(url);
+	pfree(checksumstringbuf);
+
+	return http_code;
+}
+
+/*
+ * Curl header callback, which saves the ETag of the uploaded part.
+ */
+static size_t
+read_etag_header(char *buffer, size_t size, size_t nitems, void *userdata)
+{
+	size_t		len = size * nitems;
+	S3UploadPart *part = (S3UploadPart *) userdata;
+
+	if (len > 5 && pg_strncasecmp(buffer, "etag:", 5) == 0)
+	{
+		char	   *start = buffer + 5,
+				   *end = buffer + len;
+
+		while (start < end && isspace((unsigned char) *start))
+			start++;
+		while (end > start && isspace((unsigned char) end[-1]))
+			end--;
+
+		if (part->etag)
+			pfree(part->etag);
+		part->etag = pnstrdup(start, end - start);
+	}
+
+	return len;
+}
+
+/*
+ * Adds the request uploading the part to the multi handle.
+ */
+static void
+s3_upload_part_start(CURLM *multi, char *objectpath, char *uploadQuery,
+					 S3UploadPart *part)
+{
+	char	   *query;
+
+	query = psprintf("partNumber=%d&%s", part->partNum, uploadQuery);
+	part->url = psprintf("%s://%s/%s?%s",
+						 s3_use_https ? "https" : "http", s3_host,
+						 objectpath, query);
+	part->slist = s3_signed_headers("PUT", objectpath, query, part->checksum,
+									part->checksumHeader);
+	part->slist = curl_slist_append(part->slist, "Content-Type: application/octet-stream");
+	/* Don't wait for "100 Continue" before sending the part */
+	part->slist = curl_slist_append(part->slist, "Expect:");
+	pfree(query);
+
+	resetStringInfo(&part->response);
+	if (part->etag)
+	{
+		pfree(part->etag);
+		part->etag = NULL;
+	}
+
+	part->curl = curl_easy_init();
+	s3_curl_setup(part->curl);
+	curl_easy_setopt(part->curl, CURLOPT_CUSTOMREQUEST, "PUT");
+	curl_easy_setopt(part->curl, CURLOPT_HTTPHEADER, part->slist);
+	curl_easy_setopt(part->curl, CURLOPT_URL, part->url);
+	curl_easy_setopt(part->curl, CURLOPT_POSTFIELDS, part->data);
+	curl_easy_setopt(part->curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t) part->size);
+	curl_easy_setopt(part->curl, CURLOPT_WRITEFUNCTION, write_data_to_buf);
+	curl_easy_setopt(part->curl, CURLOPT_WRITEDATA, &part->response);
+	curl_easy_setopt(part->curl, CURLOPT_HEADERFUNCTION, read_etag_header);
+	curl_easy_setopt(part->curl, CURLOPT_HEADERDATA, part);
+	curl_easy_setopt(part->curl, CURLOPT_PRIVATE, part);
+
+	part->attempts++;
+	curl_multi_add_handle(multi, part->curl);
+}
+
+static void
+s3_upload_part_cleanup(CURLM *multi, S3UploadPart *part)
+{
+	curl_multi_remove_handle(multi, part->curl);
+	s3_curl_report_stats(part->curl);
+	curl_easy_cleanup(part->curl);
+	part->curl = NULL;
+	curl_slist_free_all(part->slist);
+	part->slist = NULL;
+	pfree(part->url);
+	part->url = NULL;
+}
+
+/*
+ * Uploads the parts keeping up to orioledb.s3_multipart_concurrency requests
+ * in flight.  The failed part is retried up to S3_PART_MAX_ATTEMPTS times.
+ * Returns the part failed all the attempts or NULL on success.
+ */
+static S3UploadPart *
+s3_upload_parts(char *objectpath, char *uploadQuery,
+				S3UploadPart *parts, int nparts)
+{
+	CURLM	   *multi;
+	S3UploadPart *failedPart = NULL;
+	int			next = 0,
+				active = 0,
+				done = 0,
+				i;
+
+	multi = curl_multi_init();
+	curl_multi_setopt(multi, CURLMOPT_PIPELINING, (long) CURLPIPE_MULTIPLEX);
+
+	while (done < nparts && !failedPart)
+	{
+		CURLMsg    *msg;
+		int			running,
+					queued;
+
+		while (active < s3_multipart_concurrency && next < nparts)
+		{
+			s3_upload_part_start(multi, objectpath, uploadQuery, &parts[next++]);
+			active++;
+		}
+
+		(void) curl_multi_perform(multi, &running);
+
+		while ((msg = curl_multi_info_read(multi, &queued)) != NULL)
+		{
+			S3UploadPart *part;
+			char	   *private;
+			long		http_code = 0;
+
+			if (msg->msg != CURLMSG_DONE)
+				continue;
+
+			curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &private);
+			curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &http_code);
+			part = (S3UploadPart *) private;
+			part->sc = msg->data.result;
+			part->httpCode = http_code;
+			s3_upload_part_cleanup(multi, part);
+			active--;
+
+			if (part->sc == CURLE_OK && part->httpCode == S3_RESPONSE_OK &&
+				part->etag != NULL)
+			{
+				done++;
+			}
+			else if (part->attempts < S3_PART_MAX_ATTEMPTS)
+			{
+				s3_upload_part_start(multi, objectpath, uploadQuery, part);
+				active++;
+			}
+			else if (!failedPart)
+			{
+				failedPart = part;
+			}
+		}
+
+		if (done < nparts && !failedPart)
+			(void) curl_multi_poll(multi, NULL, 0, 1000, NULL);
+	}
+
+	for (i = 0; i < nparts; i++)
+	{
+		if (parts[i].curl)
+			s3_upload_part_cleanup(multi, &parts[i]);
+	}
+	curl_multi_cleanup(multi);
+
+	return failedPart;
+}
+
+/*
+ * Put object with given binary contents to S3 using the multipart upload.
+ * The parts are uploaded concurrently over the separate connections.
+ *
+ * Returns HTTP status code.
+ */
+static long
+s3_put_object_multipart(char *objectname, Pointer data, uint64 dataSize,
+						uint64 partSize)
+{
+	char	   *objectpath = s3_object_path(objectname);
+	char	   *uploadId,
+			   *escapedUploadId,
+			   *uploadQuery,
+			   *start,
+			   *end;
+	StringInfoData buf,
+				xml;
+	S3UploadPart *parts,
+			   *failedPart;
+	int			nparts,
+				i;
+	long		http_code;
+	bool		crc32c = (s3_checksum_algorithm == S3_CHECKSUM_CRC32C);
+
+	/*
+	 * The parts are checked by CRC32C only when the upload declares the
+	 * algorithm at the initiation.
+	 */
+	initStringInfo(&buf);
+	http_code = s3_multipart_request("POST", objectpath, "uploads=",
+									 NULL, 0, &buf,
+									 crc32c ? "x-amz-checksum-algorithm: CRC32C" : NULL);
+	start = strstr(buf.data, "<UploadId>");
+	end = start ? strstr(start, "</UploadId>") : NULL;
+	if (http_code != S3_RESPONSE_OK || !end)
+		ereport(FATAL, (errcode(ERRCODE_CONNECTION_EXCEPTION),
+						errmsg("could not start multipart upload to S3"),
+						errdetail("http code = %ld, response = %s",
+								  http_code, buf.data)));
+	start += strlen("<UploadId>");
+	uploadId = pnstrdup(start, end - start);
+	escapedUploadId = curl_easy_escape(NULL, uploadId, 0);
+	uploadQuery = psprintf("uploadId=%s", escapedUploadId);
+	curl_free(escapedUploadId);
+
+	nparts = (dataSize + partSize - 1) / partSize;
+	parts = (S3UploadPart *) palloc0(sizeof(S3UploadPart) * nparts);
+	for (i = 0; i < nparts; i++)
+	{
+		parts[i].partNum = i + 1;
+		parts[i].data = data + (uint64) i * partSize;
+		parts[i].size = Min(partSize, dataSize - (uint64) i * partSize);
+		parts[i].checksum = payload_checksum(parts[i].data, parts[i].size,
+											 &parts[i].checksumHeader);
+		initStringInfo(&parts[i].response);
+	}
+
+	failedPart = s3_upload_parts(objectpath, uploadQuery, parts, nparts);
+	if (failedPart)
+	{
+		(void) s3_multipart_request("DELETE", objectpath, uploadQuery,
+									NULL, 0, &buf, NULL);
+		ereport(FATAL, (errcode(ERRCODE_CONNECTION_EXCEPTION),
+						errmsg("could not put object part to S3"),
+						errdetail("part = %d, return code = %d, http code = %ld, response = %s",
+								  failedPart->partNum, failedPart->sc,
+								  failedPart->httpCode,
+								  failedPart->response.data)));
+	}
+
+	initStringInfo(&xml);
+	appendStringInfoString(&xml, "<CompleteMultipartUpload>");
+	for (i = 0; i < nparts; i++)
+	{
+		appendStringInfo(&xml, "<Part><PartNumber>%d</PartNumber><ETag>%s</ETag>",
+						 parts[i].partNum, parts[i].etag);
+		if (parts[i].checksumHeader)
+			appendStringInfo(&xml, "<ChecksumCRC32C>%s</ChecksumCRC32C>",
+							 strchr(parts[i].checksumHeader, ':') + 2);
+		appendStringInfoString(&xml, "</Part>");
+	}
+	appendStringInfoString(&xml, "</CompleteMultipartUpload>");
+
+	http_code = s3_multipart_request("POST", objectpath, uploadQuery,
+									 xml.data, xml.len, &buf, NULL);
+
+	/* S3 might report the completion error with the 200 status code */
+	if (http_code != S3_RESPONSE_OK || strstr(buf.data, "<Error>") != NULL)
+	{
+		StringInfoData abortBuf;
+
+		initStringInfo(&abortBuf);
+		(void) s3_multipart_request("DELETE", objectpath, uploadQuery,
+									NULL, 0, &abortBuf, NULL);
+		ereport(FATAL, (errcode(ERRCODE_CONNECTION_EXCEPTION),
+						errmsg("could not complete multipart upload to S3"),
+						errdetail("http code = %ld, response = %s",
+								  http_code, buf.data)));
+	}
+
+	for (i = 0; i < nparts; i++)
+	{
+		pfree(parts[i].checksum);
+		if (parts[i].checksumHeader)
+			pfree(parts[i].checksumHeader);
+		pfree(parts[i].response.data);
+		if (parts[i].etag)
+			pfree(parts[i].etag);
+	}
+	pfree(parts);
+	pfree(xml.data);
+	pfree(buf.data);
+	pfree(uploadQuery);
+	pfree(uploadId);
+	if (objectpath != objectname)
+		pfree(objectpath);
+
+	return http_code;
+}
+
+/*
+ * Put the data as S3 object using the multipart upload for the data larger
+ * than the part size.
+ */
+static long
+s3_put_data(char *objectname, Pointer data, uint64 dataSize, bool ifNoneMatch)
+{
+	uint64		partSize;
+
+	partSize = Max((uint64) s3_multipart_part_size * 1024,
+				   S3_MULTIPART_MIN_PART_SIZE);
+
+	/* Conditional writes aren't supported by the multipart upload */
+	if (!ifNoneMatch && s3_multipart_part_size > 0 && dataSize > partSize)
+		return s3_put_object_multipart(objectname, data, dataSize, partSize);
+	else
+		return s3_put_object_with_contents(objectname, data, dataSize, NULL,
+										   ifNoneMatch);
+}
+
 /*
  * Put the whole file as S3 object.
  */
@@ -611,9 +1269,43 @@ s3_put_file(char *objectname, char *filename, bool ifNoneMatch)
 	data = read_file(filename, &dataSize);
 	if (data)
 	{
-		res = s3_put_object_with_contents(objectname, data, dataSize, NULL,
-										  ifNoneMatch);
+		res = s3_put_data(objectname, data, dataSize, ifNoneMatch);
+		pfree(data);
+	}
+
+	return res;
+}
+
+/*
+ * Put the file as S3 object compressed with zstd of the given level.  The
+ * object is a single zstd frame, which can be decompressed by any zstd tool.
+ */
+long
+s3_put_file_compressed(char *objectname, char *filename, int level)
+{
+	Pointer		data;
+	uint64		dataSize = 0;
+	long		res = -1;
+
+	data = read_file(filename, &dataSize);
+	if (data)
+	{
+		size_t		capacity = ZSTD_compressBound(dataSize);
+		size_t		compressedSize;
+		Pointer		compressed;
+
+		compressed = MemoryContextAllocHuge(CurrentMemoryContext, capacity);
+		compressedSize = o_compress_buffer(data, dataSize, compressed,
+										   capacity, level);
 		pfree(data);
+		if (compressedSize == 0)
+			elog(ERROR, "could not compress file \"%s\"", filename);
+
+		elog(DEBUG1, "S3 compressed %s from %llu to %zu bytes",
+			 filename, (unsigned long long) dataSize, compressedSize);
+
+		res = s3_put_data(objectname, compressed, compressedSize, false);
+		pfree(compressed);
 	}
 
 	return res;
@@ -705,3 +1397,58 @@ s3_put(PG_FUNCTION_ARGS)
 
 	PG_RETURN_NULL();
 }
+
+/*
+ * Returns the counters of S3 requests and the connection setup cost.
+ */
+Datum
+orioledb_s3_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Datum		values[5];
+	bool		nulls[5];
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+
+	orioledb_check_shmem();
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	MemSet(nulls, 0, sizeof(nulls));
+	values[0] = Int64GetDatum(pg_atomic_read_u64(&s3_request_stats->requests));
+	values[1] = Int64GetDatum(pg_atomic_read_u64(&s3_request_stats->newConnections));
+	values[2] = Int64GetDatum(pg_atomic_read_u64(&s3_request_stats->http2Requests));
+	values[3] = Float8GetDatum((double) pg_atomic_read_u64(&s3_request_stats->connectTime) / 1000.0);
+	values[4] = Float8GetDatum((double) pg_atomic_read_u64(&s3_request_stats->requestTime) / 1000.0);
+	tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+
+	return (Datum) 0;
+}
+
+Datum
+orioledb_s3_stats_reset(PG_FUNCTION_ARGS)
+{
+	orioledb_check_shmem();
+
+	pg_atomic_write_u64(&s3_request_stats->requests, 0);
+	pg_atomic_write_u64(&s3_request_stats->newConnections, 0);
+	pg_atomic_write_u64(&s3_request_stats->http2Requests, 0);
+	pg_atomic_write_u64(&s3_request_stats->connectTime, 0);
+	pg_atomic_write_u64(&s3_request_stats->requestTime, 0);
+
+	PG_RETURN_VOID();
+}
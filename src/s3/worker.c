@@ -16,6 +16,7 @@
 #include "orioledb.h"
 
 #include "btree/io.h"
+#include "btree/io_stats.h"
 #include "s3/checksum.h"
 #include "s3/headers.h"
 #include "s3/queue.h"
@@ -276,6 +277,49 @@ flush_worker_checksum_state(void)
 	flushS3ChecksumState(checksum_state, filename);
 }
 
+/*
+ * Puts the changed chunks of the PostgreSQL file into S3.  Every chunk has
+ * its own checksum entry, so the unchanged chunks are referenced from the
+ * checkpoints they were uploaded by.
+ */
+static void
+s3_put_pg_file_chunks(char *objectname, char *filename,
+					  Pointer data, uint64 size)
+{
+	uint64		offset;
+	uint32		chunkNum = 0;
+
+	for (offset = 0; offset < size; offset += S3_PG_FILE_CHUNK_SIZE)
+	{
+		uint64		len = Min(S3_PG_FILE_CHUNK_SIZE, size - offset);
+		char		chunkFilename[MAXPGPATH];
+		S3FileChecksum *entry;
+
+		snprintf(chunkFilename, MAXPGPATH, "%s" S3_PG_FILE_CHUNK_SUFFIX "%u",
+				 filename, chunkNum);
+
+		if (checksum_state->fileChecksumsLen == WORKERS_FILE_CHECKSUMS_MAX_LEN)
+			flush_worker_checksum_state();
+
+		entry = getS3FileChecksum(checksum_state, chunkFilename,
+								  data + offset, len);
+
+		if (entry->changed)
+		{
+			char	   *chunkObjectname;
+
+			chunkObjectname = psprintf("%s" S3_PG_FILE_CHUNK_SUFFIX "%u",
+									   objectname, chunkNum);
+			(void) s3_put_object_with_contents(chunkObjectname, data + offset,
+											   len, entry->checksum, false);
+			pfree(chunkObjectname);
+		}
+
+		pfree(entry);
+		chunkNum++;
+	}
+}
+
 /*
  * Process the task at given location.
  */
@@ -376,7 +420,8 @@ s3process_task(uint64 taskLocation)
 		tag.checkpointNum = task->typeSpecific.filePart.chkpNum;
 		tag.segNum = task->typeSpecific.filePart.segNum;
 
-		s3_header_mark_part_loaded(tag, task->typeSpecific.filePart.partNum);
+		s3_header_mark_part_loaded(tag, task->typeSpecific.filePart.partNum,
+								   true);
 
 		pfree(filename);
 		pfree(objectname);
@@ -454,9 +499,22 @@ s3process_task(uint64 taskLocation)
 		char	   *filename;
 
 		filename = psprintf(XLOGDIR "/%s", task->typeSpecific.walFilename);
-		objectname = psprintf("wal/%s", task->typeSpecific.walFilename);
 
-		s3_put_file(objectname, filename, false);
+		/*
+		 * The compressed WAL files are marked by the ".zst" suffix, so the
+		 * restore can tell them from the uncompressed ones.
+		 */
+		if (s3_wal_compression > 0)
+		{
+			objectname = psprintf("wal/%s" S3_WAL_COMPRESSED_SUFFIX,
+								  task->typeSpecific.walFilename);
+			s3_put_file_compressed(objectname, filename, s3_wal_compression);
+		}
+		else
+		{
+			objectname = psprintf("wal/%s", task->typeSpecific.walFilename);
+			s3_put_file(objectname, filename, false);
+		}
 
 		pfree(filename);
 		pfree(objectname);
@@ -546,14 +604,21 @@ s3process_task(uint64 taskLocation)
 
 			Assert(checksum_state->checkpointNumber == task->typeSpecific.writePGFile.chkpNum);
 
-			if (checksum_state->fileChecksumsLen == WORKERS_FILE_CHECKSUMS_MAX_LEN)
-				flush_worker_checksum_state();
+			if (s3_incremental_backup && size > S3_PG_FILE_CHUNK_SIZE)
+			{
+				s3_put_pg_file_chunks(objectname, filename, data, size);
+			}
+			else
+			{
+				if (checksum_state->fileChecksumsLen == WORKERS_FILE_CHECKSUMS_MAX_LEN)
+					flush_worker_checksum_state();
 
-			entry = getS3FileChecksum(checksum_state, filename, data, size);
+				entry = getS3FileChecksum(checksum_state, filename, data, size);
 
-			if (entry->changed)
-				(void) s3_put_object_with_contents(objectname, data, size,
-												   entry->checksum, false);
+				if (entry->changed)
+					(void) s3_put_object_with_contents(objectname, data, size,
+													   entry->checksum, false);
+			}
 
 			pfree(data);
 		}
@@ -659,18 +724,19 @@ s3_schedule_file_part_write(uint32 chkpNum, Oid datoid, Oid relnode,
 }
 
 /*
- * Schedule the read of given data file part from S3.
+ * Schedule the read of given data file part from S3.  'prefetch' means that
+ * the part is loaded ahead of the access.
  */
 S3TaskLocation
 s3_schedule_file_part_read(uint32 chkpNum, Oid datoid, Oid relnode,
-						   int32 segNum, int32 partNum)
+						   int32 segNum, int32 partNum, bool prefetch)
 {
 	S3Task	   *task;
 	S3TaskLocation location;
 	S3PartStatus status;
 	S3HeaderTag tag = {.datoid = datoid,.relnode = relnode,.checkpointNum = chkpNum,.segNum = segNum};
 
-	status = s3_header_mark_part_loading(tag, partNum);
+	status = s3_header_mark_part_loading(tag, partNum, prefetch);
 	if (status == S3PartStatusLoading)
 	{
 		/*
@@ -759,7 +825,7 @@ s3_schedule_undo_file_write(UndoLogType undoType, uint64 fileNum)
  * Schedule the load of given downlink from S3 to local storage.
  */
 S3TaskLocation
-s3_schedule_downlink_load(BTreeDescr *desc, uint64 downlink)
+s3_schedule_downlink_load(BTreeDescr *desc, uint64 downlink, bool prefetch)
 {
 	uint64		offset = DOWNLINK_GET_DISK_OFF(downlink);
 	uint16		len = DOWNLINK_GET_DISK_LEN(downlink);
@@ -792,7 +858,7 @@ s3_schedule_downlink_load(BTreeDescr *desc, uint64 downlink)
 		partNum = (byte_offset % ORIOLEDB_SEGMENT_SIZE) / ORIOLEDB_S3_PART_SIZE;
 		location = s3_schedule_file_part_read(chkpNum,
 											  desc->oids.datoid, desc->oids.relnode,
-											  segNum, partNum);
+											  segNum, partNum, prefetch);
 		result = Max(result, location);
 		if (byte_offset % ORIOLEDB_S3_PART_SIZE + read_size > ORIOLEDB_S3_PART_SIZE)
 		{
@@ -810,6 +876,58 @@ s3_schedule_downlink_load(BTreeDescr *desc, uint64 downlink)
 	return result;
 }
 
+/*
+ * Schedules the load of the parts containing the downlink, which is expected
+ * to be read soon.  Consecutive downlinks usually lie in the same part, so the
+ * last scheduled part is remembered not to look it up again.
+ */
+void
+s3_prefetch_downlink(BTreeDescr *desc, uint64 downlink)
+{
+	static S3HeaderTag lastTag;
+	static int32 lastPartNum = -1;
+	uint64		offset = DOWNLINK_GET_DISK_OFF(downlink);
+	uint16		len = DOWNLINK_GET_DISK_LEN(downlink);
+	off_t		byte_offset,
+				read_size;
+	S3HeaderTag tag;
+	int32		partNum,
+				lastByteSegNum,
+				lastBytePartNum;
+
+	tag.datoid = desc->oids.datoid;
+	tag.relnode = desc->oids.relnode;
+	tag.checkpointNum = S3_GET_CHKP_NUM(offset);
+	offset &= S3_OFFSET_MASK;
+
+	if (!OCompressIsValid(desc->compress))
+	{
+		byte_offset = (off_t) offset * (off_t) ORIOLEDB_BLCKSZ;
+		read_size = ORIOLEDB_BLCKSZ;
+	}
+	else
+	{
+		byte_offset = (off_t) offset * (off_t) ORIOLEDB_COMP_BLCKSZ;
+		read_size = len * ORIOLEDB_COMP_BLCKSZ;
+	}
+
+	tag.segNum = byte_offset / ORIOLEDB_SEGMENT_SIZE;
+	partNum = (byte_offset % ORIOLEDB_SEGMENT_SIZE) / ORIOLEDB_S3_PART_SIZE;
+	lastByteSegNum = (byte_offset + read_size - 1) / ORIOLEDB_SEGMENT_SIZE;
+	lastBytePartNum = ((byte_offset + read_size - 1) % ORIOLEDB_SEGMENT_SIZE) /
+		ORIOLEDB_S3_PART_SIZE;
+
+	if (lastByteSegNum == tag.segNum && lastBytePartNum == partNum &&
+		partNum == lastPartNum && S3HeaderTagsIsEqual(tag, lastTag))
+		return;
+
+	(void) s3_schedule_downlink_load(desc, downlink, true);
+
+	lastTag = tag;
+	lastTag.segNum = lastByteSegNum;
+	lastPartNum = lastBytePartNum;
+}
+
 /*
  * Schedule a synchronization of given file to S3.
  */
@@ -877,9 +995,10 @@ s3_load_file_part(uint32 chkpNum, Oid datoid, Oid relnode,
 	S3TaskLocation location;
 
 	location = s3_schedule_file_part_read(chkpNum, datoid, relnode,
-										  segNum, partNum);
+										  segNum, partNum, false);
 
-	s3_queue_wait_for_location(location);
+	s3_queue_wait_for_task(location);
+	tree_io_stats_s3_load(datoid, relnode);
 }
 
 void
@@ -888,17 +1007,14 @@ s3_load_map_file(uint32 chkpNum, Oid datoid, Oid relnode)
 	S3TaskLocation location;
 
 	location = s3_schedule_file_part_read(chkpNum, datoid, relnode,
-										  -1, 0);
+										  -1, 0, false);
 
-	s3_queue_wait_for_location(location);
+	s3_queue_wait_for_task(location);
 }
 
 void
 s3worker_main(Datum main_arg)
 {
-	int			rc,
-				wake_events = WL_LATCH_SET | WL_POSTMASTER_DEATH | WL_TIMEOUT;
-
 	worker_num = Int32GetDatum(main_arg);
 
 	/* enable timeout for relation lock */
@@ -921,6 +1037,7 @@ s3worker_main(Datum main_arg)
 	BackgroundWorkerUnblockSignals();
 
 	elog(LOG, "orioledb s3 worker %d started", worker_num);
+	set_io_class(OIOClassS3);
 
 	CurTransactionContext = AllocSetContextCreate(TopMemoryContext,
 												  "orioledb s3worker current transaction context",
@@ -953,14 +1070,11 @@ s3worker_main(Datum main_arg)
 				break;
 
 			/*
-			 * Sleep until we are signaled or it's time to check the queue.
+			 * Sleep until a new task is put into the queue or it's time to
+			 * check the queue.  The worker exits on the postmaster death
+			 * while sleeping.
 			 */
-			rc = WaitLatch(MyLatch, wake_events,
-						   BgWriterDelay,
-						   WAIT_EVENT_BGWRITER_MAIN);
-
-			if (rc & WL_POSTMASTER_DEATH)
-				shutdown_requested = true;
+			s3_queue_wait_for_tasks(BgWriterDelay);
 
 			/*
 			 * Task processing loop.  It might happend that error occurs and
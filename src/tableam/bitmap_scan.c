@@ -24,8 +24,9 @@
 #include "access/table.h"
 #include "catalog/pg_type.h"
 #include "executor/nodeIndexscan.h"
-#include "lib/rbtree.h"
+#include "miscadmin.h"
 #include "nodes/execnodes.h"
+#include "pgstat.h"
 #include "utils/memutils.h"
 
 #include <math.h>
@@ -36,11 +37,27 @@ typedef struct OBitmapScan
 	ScanState  *ss;
 	OSnapshot	oSnapshot;
 	MemoryContext cxt;
-	RBTree	   *saved_bitmap;
+	OKeyBitmap *saved_bitmap;
+	ExprState  *recheckqual;
 	Oid			typeoid;
 	BTreeSeqScan *seq_scan;
+
+	/*
+	 * Parallel scan state.  saved_bitmap contains only the claimed chunk,
+	 * iterator scans the primary key range it covers.
+	 */
+	ParallelOBitmapScan pscan;
+	Pointer		chunks;
+	BTreeIterator *iter;
+	OFixedKey	rangeHigh;
 } OBitmapScan;
 
+/*
+ * Number of bitmap chunks claimed by a parallel scan participant at once.
+ * Each chunk covers 65536 keys.
+ */
+#define O_PARALLEL_BITMAP_CHUNKS	1
+
 static bool o_bitmap_is_range_valid(OTuple low, OTuple high, void *arg);
 static bool o_bitmap_get_next_key(OFixedKey *key, bool inclusive, void *arg);
 
@@ -114,6 +131,25 @@ uint64_get_val(uint64 val, Oid typeoid, Pointer ptr)
 	}
 }
 
+/*
+ * Makes the primary key non-leaf tuple from the bitmap value.
+ */
+static void
+uint64_get_key(uint64 val, OIndexDescr *primary, OFixedKey *key)
+{
+	FormData_pg_attribute *attr = TupleDescAttr(primary->nonLeafTupdesc, 0);
+	OTupleHeader tuphdr;
+
+	Assert(primary->nFields == 1);
+	tuphdr = (OTupleHeader) key->fixedData;
+	tuphdr->hasnulls = false;
+	tuphdr->natts = 1;
+	tuphdr->len = SizeOfOTupleHeader + attr->attlen;
+	uint64_get_val(val, attr->atttypid, &key->fixedData[SizeOfOTupleHeader]);
+	key->tuple.data = key->fixedData;
+	key->tuple.formatFlags = 0;
+}
+
 static uint64
 seconary_tuple_get_pk_data(OTuple tuple, OIndexDescr *ix_descr)
 {
@@ -153,7 +189,7 @@ primary_tuple_get_data(OTuple tuple, OIndexDescr *primary, bool onlyPkey)
 
 static double
 o_index_getbitmap(OBitmapHeapPlanState *bitmap_state,
-				  BitmapIndexScanState *node, RBTree *bitmap)
+				  BitmapIndexScanState *node, OKeyBitmap *bitmap)
 {
 	OScanState	ostate = {0};
 	OTableDescr *descr;
@@ -255,10 +291,10 @@ o_index_getbitmap(OBitmapHeapPlanState *bitmap_state,
 	return nTuples;
 }
 
-static RBTree *
+static OKeyBitmap *
 o_exec_bitmapqual(OBitmapHeapPlanState *bitmap_state, PlanState *planstate)
 {
-	RBTree	   *result = NULL;
+	OKeyBitmap *result = NULL;
 
 	switch (nodeTag(planstate))
 	{
@@ -274,7 +310,7 @@ o_exec_bitmapqual(OBitmapHeapPlanState *bitmap_state, PlanState *planstate)
 				for (i = 0; i < node->nplans; i++)
 				{
 					PlanState  *subnode = node->bitmapplans[i];
-					RBTree	   *subresult = o_exec_bitmapqual(bitmap_state,
+					OKeyBitmap *subresult = o_exec_bitmapqual(bitmap_state,
 															  subnode);
 
 					if (result == NULL)
@@ -312,13 +348,13 @@ o_exec_bitmapqual(OBitmapHeapPlanState *bitmap_state, PlanState *planstate)
 				for (i = 0; i < node->nplans; i++)
 				{
 					PlanState  *subnode = node->bitmapplans[i];
-					RBTree	   *subresult;
+					OKeyBitmap *subresult;
 
 					if (IsA(subnode, BitmapIndexScanState))
 					{
 						if (result == NULL) /* first subplan */
 						{
-							result = o_keybitmap_create();
+							result = o_keybitmap_create(work_mem * (Size) 1024);
 						}
 
 						bitmap_state->scan->saved_bitmap = result;
@@ -363,7 +399,7 @@ o_exec_bitmapqual(OBitmapHeapPlanState *bitmap_state, PlanState *planstate)
 				}
 				else
 				{
-					result = o_keybitmap_create();
+					result = o_keybitmap_create(work_mem * (Size) 1024);
 				}
 
 				nTuples = o_index_getbitmap(bitmap_state, node, result);
@@ -380,6 +416,144 @@ o_exec_bitmapqual(OBitmapHeapPlanState *bitmap_state, PlanState *planstate)
 	return result;
 }
 
+/*
+ * Builds the key bitmap of parallel scan.  The first participant executes the
+ * bitmap quals and publishes the result in the query DSA area, while the
+ * others wait for it.
+ */
+static void
+o_parallel_bitmap_build(OBitmapScan *scan, OBitmapHeapPlanState *bitmap_state,
+						PlanState *bitmapqualplanstate, dsa_area *dsa)
+{
+	ParallelOBitmapScan pscan = scan->pscan;
+	bool		build = false;
+
+	Assert(dsa != NULL);
+
+	SpinLockAcquire(&pscan->mutex);
+	if (pscan->status == OParallelBitmapInitial)
+	{
+		pscan->status = OParallelBitmapInProgress;
+		build = true;
+	}
+	SpinLockRelease(&pscan->mutex);
+
+	if (build)
+	{
+		OKeyBitmap *bitmap;
+		uint64		nchunks;
+		dsa_pointer chunks = InvalidDsaPointer;
+
+		bitmap = o_exec_bitmapqual(bitmap_state, bitmapqualplanstate);
+		nchunks = o_keybitmap_count_chunks(bitmap);
+		if (nchunks > 0)
+		{
+			chunks = dsa_allocate_extended(dsa,
+										   o_keybitmap_serialized_size(bitmap),
+										   DSA_ALLOC_HUGE);
+			o_keybitmap_serialize(bitmap, dsa_get_address(dsa, chunks));
+		}
+		o_keybitmap_free(bitmap);
+
+		SpinLockAcquire(&pscan->mutex);
+		pscan->chunks = chunks;
+		pscan->nchunks = nchunks;
+		pscan->status = OParallelBitmapFinished;
+		SpinLockRelease(&pscan->mutex);
+		ConditionVariableBroadcast(&pscan->cv);
+	}
+	else
+	{
+		ConditionVariablePrepareToSleep(&pscan->cv);
+		while (true)
+		{
+			bool		finished;
+
+			SpinLockAcquire(&pscan->mutex);
+			finished = (pscan->status == OParallelBitmapFinished);
+			SpinLockRelease(&pscan->mutex);
+
+			if (finished)
+				break;
+			ConditionVariableSleep(&pscan->cv, WAIT_EVENT_PARALLEL_BITMAP_SCAN);
+		}
+		ConditionVariableCancelSleep();
+	}
+
+	if (pscan->nchunks > 0)
+		scan->chunks = dsa_get_address(dsa, pscan->chunks);
+}
+
+/*
+ * Claims the next group of bitmap chunks and starts iterating the primary key
+ * range they cover.  Returns false when all the chunks are already claimed.
+ */
+static bool
+o_parallel_bitmap_next_range(OBitmapScan *scan, MemoryContext tupleCxt)
+{
+	ParallelOBitmapScan pscan = scan->pscan;
+	OIndexDescr *primary = GET_PRIMARY(scan->tbl_desc);
+	OFixedKey	rangeLow;
+	uint64		first,
+				count,
+				low,
+				high;
+	bool		found;
+
+	first = pg_atomic_fetch_add_u64(&pscan->nextChunk,
+									O_PARALLEL_BITMAP_CHUNKS);
+	if (first >= pscan->nchunks)
+		return false;
+	count = Min(O_PARALLEL_BITMAP_CHUNKS, pscan->nchunks - first);
+
+	if (scan->saved_bitmap)
+		o_keybitmap_free(scan->saved_bitmap);
+	scan->saved_bitmap = o_keybitmap_deserialize(scan->chunks, first, count);
+
+	low = o_keybitmap_get_next(scan->saved_bitmap, 0, &found);
+	Assert(found);
+	high = o_keybitmap_get_last(scan->saved_bitmap, &found);
+	Assert(found);
+	uint64_get_key(low, primary, &rangeLow);
+	uint64_get_key(high, primary, &scan->rangeHigh);
+
+	scan->iter = o_btree_iterator_create(&primary->desc,
+										 (Pointer) &rangeLow.tuple,
+										 BTreeKeyNonLeafKey,
+										 &scan->oSnapshot,
+										 ForwardScanDirection);
+	o_btree_iterator_set_tuple_ctx(scan->iter, tupleCxt);
+	return true;
+}
+
+static OTuple
+o_parallel_bitmap_getnext(OBitmapScan *scan, MemoryContext tupleCxt,
+						  CommitSeqNo *tupleCsn, BTreeLocationHint *hint)
+{
+	OTuple		tuple;
+
+	while (true)
+	{
+		if (scan->iter)
+		{
+			tuple = o_btree_iterator_fetch(scan->iter, tupleCsn,
+										   (Pointer) &scan->rangeHigh.tuple,
+										   BTreeKeyNonLeafKey, true, hint);
+			if (!O_TUPLE_IS_NULL(tuple))
+				return tuple;
+
+			btree_iterator_free(scan->iter);
+			scan->iter = NULL;
+		}
+
+		if (!o_parallel_bitmap_next_range(scan, tupleCxt))
+		{
+			O_TUPLE_SET_NULL(tuple);
+			return tuple;
+		}
+	}
+}
+
 OBitmapScan *
 o_make_bitmap_scan(OBitmapHeapPlanState *bitmap_state, ScanState *ss,
 				   PlanState *bitmapqualplanstate, Relation rel,
@@ -393,7 +567,17 @@ o_make_bitmap_scan(OBitmapHeapPlanState *bitmap_state, ScanState *ss,
 	scan->cxt = cxt;
 	scan->ss = ss;
 	scan->tbl_desc = relation_get_descr(rel);
+	scan->pscan = bitmap_state->pscan;
+	scan->recheckqual = bitmap_state->bitmapqualorigstate;
 	bitmap_state->scan = scan;
+
+	if (scan->pscan)
+	{
+		o_parallel_bitmap_build(scan, bitmap_state, bitmapqualplanstate,
+								ss->ps.state->es_query_dsa);
+		return scan;
+	}
+
 	scan->saved_bitmap = o_exec_bitmapqual(bitmap_state, bitmapqualplanstate);
 	scan->seq_scan = make_btree_seq_scan_cb(&GET_PRIMARY(scan->tbl_desc)->desc,
 											&scan->oSnapshot,
@@ -414,8 +598,12 @@ o_exec_bitmap_fetch(OBitmapScan *scan, CustomScanState *node)
 		MemoryContext tupleCxt = node->ss.ss_ScanTupleSlot->tts_mcxt;
 		CommitSeqNo tupleCsn;
 
-		tuple = btree_seq_scan_getnext(scan->seq_scan, tupleCxt, &tupleCsn,
-									   &hint);
+		if (scan->pscan)
+			tuple = o_parallel_bitmap_getnext(scan, tupleCxt, &tupleCsn,
+											  &hint);
+		else
+			tuple = btree_seq_scan_getnext(scan->seq_scan, tupleCxt,
+										   &tupleCsn, &hint);
 
 		if (O_TUPLE_IS_NULL(tuple))
 		{
@@ -426,11 +614,12 @@ o_exec_bitmap_fetch(OBitmapScan *scan, CustomScanState *node)
 		{
 			OTableDescr *descr;
 			uint64		value;
+			bool		recheck = false;
 
 			descr = relation_get_descr(node->ss.ss_currentRelation);
 			value = primary_tuple_get_data(tuple, GET_PRIMARY(descr), false);
 
-			if (o_keybitmap_test(scan->saved_bitmap, value))
+			if (o_keybitmap_test(scan->saved_bitmap, value, &recheck))
 			{
 				TupleTableSlot *scan_slot;
 				MemoryContext oldcxt;
@@ -446,7 +635,11 @@ o_exec_bitmap_fetch(OBitmapScan *scan, CustomScanState *node)
 										 true, &hint);
 
 				slot = scan_slot;
-				valid = true;
+
+				/* Lossy bitmap parts need the original quals to be rechecked */
+				valid = !recheck ||
+					o_exec_qual(node->ss.ps.ps_ExprContext,
+								scan->recheckqual, slot);
 			}
 		}
 
@@ -465,11 +658,41 @@ o_exec_bitmap_fetch(OBitmapScan *scan, CustomScanState *node)
 void
 o_free_bitmap_scan(OBitmapScan *scan)
 {
-	free_btree_seq_scan(scan->seq_scan);
-	o_keybitmap_free(scan->saved_bitmap);
+	if (scan->seq_scan)
+		free_btree_seq_scan(scan->seq_scan);
+	if (scan->iter)
+		btree_iterator_free(scan->iter);
+	if (scan->saved_bitmap)
+		o_keybitmap_free(scan->saved_bitmap);
 	pfree(scan);
 }
 
+void
+o_init_parallel_bitmap_scan(ParallelOBitmapScan pscan)
+{
+	SpinLockInit(&pscan->mutex);
+	ConditionVariableInit(&pscan->cv);
+	pscan->status = OParallelBitmapInitial;
+	pscan->chunks = InvalidDsaPointer;
+	pscan->nchunks = 0;
+	pg_atomic_init_u64(&pscan->nextChunk, 0);
+}
+
+/*
+ * Resets the shared state before rescan.  Called by the leader only, while
+ * the workers are not running.
+ */
+void
+o_reinit_parallel_bitmap_scan(ParallelOBitmapScan pscan, dsa_area *dsa)
+{
+	if (DsaPointerIsValid(pscan->chunks))
+		dsa_free(dsa, pscan->chunks);
+	pscan->status = OParallelBitmapInitial;
+	pscan->chunks = InvalidDsaPointer;
+	pscan->nchunks = 0;
+	pg_atomic_write_u64(&pscan->nextChunk, 0);
+}
+
 static bool
 o_bitmap_is_range_valid(OTuple low, OTuple high, void *arg)
 {
@@ -499,7 +722,6 @@ o_bitmap_get_next_key(OFixedKey *key, bool inclusive, void *arg)
 	bool		found;
 	uint64		prev_value = 0;
 	uint64		res_value;
-	OTupleHeader tuphdr;
 	OIndexDescr *primary = GET_PRIMARY(bitmap_scan->tbl_desc);
 
 	if (!O_TUPLE_IS_NULL(key->tuple))
@@ -517,20 +739,7 @@ o_bitmap_get_next_key(OFixedKey *key, bool inclusive, void *arg)
 									 &found);
 
 	if (found)
-	{
-		FormData_pg_attribute *attr = TupleDescAttr(primary->nonLeafTupdesc, 0);
-
-		Assert(primary->nFields == 1);
-		tuphdr = (OTupleHeader) key->fixedData;
-		tuphdr->hasnulls = false;
-		tuphdr->natts = 1;
-		tuphdr->len = SizeOfOTupleHeader + attr->attlen;
-		uint64_get_val(res_value,
-					   attr->atttypid,
-					   &key->fixedData[SizeOfOTupleHeader]);
-		key->tuple.data = key->fixedData;
-		key->tuple.formatFlags = 0;
-	}
+		uint64_get_key(res_value, primary, key);
 	else
 	{
 		O_TUPLE_SET_NULL(key->tuple);
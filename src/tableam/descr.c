@@ -28,11 +28,14 @@
 #include "tableam/tree.h"
 #include "tuple/slot.h"
 #include "transam/undo.h"
+#include "utils/compress.h"
 #include "utils/page_pool.h"
 #include "utils/stopevent.h"
 
 #include "access/nbtree.h"
+#include "catalog/pg_collation.h"
 #include "catalog/pg_opfamily.h"
+#include "catalog/pg_type.h"
 #include "common/hashfn.h"
 #include "funcapi.h"
 #include "miscadmin.h"
@@ -45,7 +48,7 @@
 #include "pgstat.h"
 
 static OIndexDescr *get_index_descr(ORelOids ixOids, OIndexType ixType,
-									bool miss_ok);
+									bool miss_ok, OTable *oTable);
 static void o_table_descr_fill_indices(OTableDescr *descr, OTable *table);
 static void init_shared_root_info(OPagePool *pool,
 								  SharedRootInfo *sharedRootInfo);
@@ -77,6 +80,7 @@ struct OComparator
 	FmgrInfo	finfo;
 
 	/* Filled when haveSortSupport == true */
+	FmgrInfo	ssup_finfo;
 	MemoryContext ssup_cxt;
 	void	   *ssup_extra;
 	int			(*ssup_comparator) (Datum x, Datum y, SortSupport ssup);
@@ -85,12 +89,58 @@ struct OComparator
 static HTAB *oTableDescrHash;
 static HTAB *oIndexDescrHash;
 static HTAB *comparatorCache;
+static HTAB *rootInfoCache;
 static OComparatorKey lastkey = {0};
 static OComparator *lastcmp = NULL;
 static MemoryContext descrCxt = NULL;
 
 static void o_find_toastable_attrs(OTableDescr *tableDescr);
 
+typedef struct
+{
+	SharedRootInfoKey key;
+	BTreeRootInfo rootInfo;
+} RootInfoCacheEntry;
+
+/*
+ * Looks up the backend-local cache of the shared root infos.  Descriptors
+ * lose their root info on each invalidation, and the shared root info
+ * lookup is a system tree descent, which shows up when thousands of
+ * partitions are reopened.  The root page change count serves as the
+ * generation number: it changes once the tree is evicted or dropped and its
+ * root page is freed, so the stale entries are detected and removed.
+ */
+static bool
+root_info_cache_lookup(SharedRootInfoKey *key, BTreeRootInfo *rootInfo)
+{
+	RootInfoCacheEntry *entry;
+
+	entry = (RootInfoCacheEntry *) hash_search(rootInfoCache, key,
+											   HASH_FIND, NULL);
+	if (entry == NULL)
+		return false;
+
+	if (O_PAGE_GET_CHANGE_COUNT(O_GET_IN_MEMORY_PAGE(entry->rootInfo.rootPageBlkno)) !=
+		entry->rootInfo.rootPageChangeCount)
+	{
+		(void) hash_search(rootInfoCache, key, HASH_REMOVE, NULL);
+		return false;
+	}
+
+	*rootInfo = entry->rootInfo;
+	return true;
+}
+
+static void
+root_info_cache_remember(SharedRootInfoKey *key, BTreeRootInfo *rootInfo)
+{
+	RootInfoCacheEntry *entry;
+
+	entry = (RootInfoCacheEntry *) hash_search(rootInfoCache, key,
+											   HASH_ENTER, NULL);
+	entry->rootInfo = *rootInfo;
+}
+
 
 /*
  * Creates shared root info.  But insertion into shared cache is performed by
@@ -252,6 +302,15 @@ o_btree_load_shmem_internal(BTreeDescr *desc, bool checkpoint)
 	key.datoid = desc->oids.datoid;
 	key.relnode = desc->oids.relnode;
 
+	if (root_info_cache_lookup(&key, &desc->rootInfo))
+	{
+		if (desc->storageType == BTreeStoragePersistence || desc->storageType == BTreeStorageUnlogged)
+			checkpointable_tree_init(desc, false, NULL);
+		else if (desc->storageType == BTreeStorageTemporary)
+			evictable_tree_init(desc, false, NULL);
+		return true;
+	}
+
 	/*
 	 * evictable_tree_init() needs that.  Initialized it before we get one of
 	 * checkpoint_state->oSharedRootInfoInsertLocks.
@@ -312,6 +371,11 @@ o_btree_load_shmem_internal(BTreeDescr *desc, bool checkpoint)
 		is_compressed = OCompressIsValid(desc->compress);
 		desc->rootInfo = sharedRootInfo->rootInfo;
 
+		if (is_compressed && !orioledb_s3_mode)
+			pg_atomic_write_u64(&BTREE_GET_META(desc)->compressDict,
+								o_compress_dict_find_last(desc->oids.datoid,
+														  desc->oids.relnode));
+
 		init_extents = false;
 		if (is_compressed && !was_evicted)
 		{
@@ -374,6 +438,7 @@ o_btree_load_shmem_internal(BTreeDescr *desc, bool checkpoint)
 
 	Assert(sharedRootInfo != NULL);
 	Assert(!sharedRootInfo->placeholder);
+	root_info_cache_remember(&key, &desc->rootInfo);
 	pfree(sharedRootInfo);
 	ppool_release_reserved(desc->ppool, PPOOL_RESERVE_META);
 	return true;
@@ -413,6 +478,15 @@ o_btree_try_use_shmem(BTreeDescr *desc)
 		key.datoid = desc->oids.datoid;
 		key.relnode = desc->oids.relnode;
 
+		if (root_info_cache_lookup(&key, &desc->rootInfo))
+		{
+			if (desc->storageType == BTreeStoragePersistence || desc->storageType == BTreeStorageUnlogged)
+				checkpointable_tree_init(desc, false, NULL);
+			else if (desc->storageType == BTreeStorageTemporary)
+				evictable_tree_init(desc, false, NULL);
+			return true;
+		}
+
 		shared = o_find_shared_root_info(&key);
 		if (shared == NULL)
 			return false;
@@ -422,6 +496,7 @@ o_btree_try_use_shmem(BTreeDescr *desc)
 		Assert(OInMemoryBlknoIsValid(shared->rootInfo.metaPageBlkno));
 
 		desc->rootInfo = shared->rootInfo;
+		root_info_cache_remember(&key, &desc->rootInfo);
 
 		if (desc->storageType == BTreeStoragePersistence || desc->storageType == BTreeStorageUnlogged)
 		{
@@ -770,7 +845,7 @@ o_fetch_index_descr(ORelOids oids, OIndexType type, bool lock, bool *nested)
 	if (lock)
 		o_tables_rel_lock_extended(&oids, AccessShareLock, true);
 
-	index_descr = get_index_descr(oids, type, true);
+	index_descr = get_index_descr(oids, type, true, NULL);
 
 	if (!index_descr && lock)
 	{
@@ -949,8 +1024,14 @@ o_drop_shared_root_info(Oid datoid, Oid relnode)
 									 key_tuple, BTreeKeyNonLeafKey, NULL);
 }
 
+/*
+ * Get the index descriptor from the cache or build it.  The caller may pass
+ * the already loaded table the index belongs to, so the primary index
+ * descriptor doesn't have to fetch and deserialize it once again.
+ */
 static OIndexDescr *
-get_index_descr(ORelOids ixOids, OIndexType ixType, bool miss_ok)
+get_index_descr(ORelOids ixOids, OIndexType ixType, bool miss_ok,
+				OTable *oTable)
 {
 	bool		found;
 	OIndexDescr *result;
@@ -970,7 +1051,7 @@ get_index_descr(ORelOids ixOids, OIndexType ixType, bool miss_ok)
 		return NULL;
 	}
 	mcxt = MemoryContextSwitchTo(descrCxt);
-	o_index_fill_descr(result, oIndex, NULL);
+	o_index_fill_descr(result, oIndex, oTable);
 	MemoryContextSwitchTo(mcxt);
 	index_btree_desc_init(&result->desc, result->compress, result->fillfactor, result->oids,
 						  oIndex->indexType, oIndex->table_persistence, oIndex->createOxid, result);
@@ -1033,13 +1114,15 @@ o_table_descr_fill_indices(OTableDescr *descr, OTable *table)
 			ixType = table->indices[cur_ix - ix_off].type;
 		}
 
-		descr->indices[cur_ix] = get_index_descr(ixOids, ixType, false);
+		descr->indices[cur_ix] = get_index_descr(ixOids, ixType, false,
+												 table);
 		descr->indices[cur_ix]->refcnt++;
 	}
 
 	if (ORelOidsIsValid(table->toast_oids))
 	{
-		descr->toast = get_index_descr(table->toast_oids, oIndexToast, false);
+		descr->toast = get_index_descr(table->toast_oids, oIndexToast,
+									   false, table);
 		descr->toast->refcnt++;
 	}
 	else
@@ -1104,6 +1187,52 @@ o_find_toastable_attrs(OTableDescr *tableDescr)
 }
 
 /* fills field opclass fields and finds comparator for it */
+/*
+ * Returns the built-in comparison for the index field values.  Only built-in
+ * operator families whose ordering is known to match the comparison are
+ * supported.
+ */
+static OFieldCmpType
+o_field_cmp_type(OIndexField *field)
+{
+	switch (field->opfamily)
+	{
+		case O_INTEGER_BTREE_FAM_OID:
+			if (field->inputtype == INT2OID)
+				return OFieldCmpInt2;
+			if (field->inputtype == INT4OID)
+				return OFieldCmpInt4;
+			if (field->inputtype == INT8OID)
+				return OFieldCmpInt8;
+			break;
+		case O_OID_BTREE_FAM_OID:
+			if (field->inputtype == OIDOID)
+				return OFieldCmpOid;
+			break;
+		case O_DATETIME_BTREE_FAM_OID:
+			if (field->inputtype == DATEOID)
+				return OFieldCmpInt4;
+			if (field->inputtype == TIMESTAMPOID ||
+				field->inputtype == TIMESTAMPTZOID)
+				return OFieldCmpInt8;
+			break;
+		case O_UUID_BTREE_FAM_OID:
+			if (field->inputtype == UUIDOID)
+				return OFieldCmpUuid;
+			break;
+		case O_TEXT_BTREE_FAM_OID:
+			/* Only bytewise collations are ordered like memcmp() */
+			if (field->inputtype == TEXTOID &&
+				(field->collation == C_COLLATION_OID ||
+				 field->collation == POSIX_COLLATION_OID))
+				return OFieldCmpCText;
+			break;
+		default:
+			break;
+	}
+	return OFieldCmpGeneric;
+}
+
 void
 oFillFieldOpClassAndComparator(OIndexField *field, Oid datoid, Oid opclassoid)
 {
@@ -1115,6 +1244,7 @@ oFillFieldOpClassAndComparator(OIndexField *field, Oid datoid, Oid opclassoid)
 	field->inputtype = opclass->inputtype;
 	field->opfamily = opclass->opfamily;
 	field->comparator = o_find_opclass_comparator(opclass, field->collation);
+	field->cmpType = o_field_cmp_type(field);
 
 	Assert(field->comparator != NULL);
 }
@@ -1160,7 +1290,8 @@ o_find_comparator(Oid opfamily, Oid lefttype, Oid righttype, Oid collation)
 		ssup.ssup_cxt = descrCxt;
 		ssup.ssup_collation = collation;
 		ssup.abbreviate = false;
-		OidFunctionCall1(procOid, PointerGetDatum(&ssup));
+		fmgr_info_cxt(procOid, &comparator.ssup_finfo, descrCxt);
+		FunctionCall1(&comparator.ssup_finfo, PointerGetDatum(&ssup));
 		if (ssup.comparator != NULL)
 		{
 			comparator.haveSortSupport = true;
@@ -1233,17 +1364,15 @@ o_find_opclass_comparator(OOpclass *opclass, Oid collation)
 		OidIsValid(opclass->ssupOid))
 	{
 		SortSupportData ssup;
-		FmgrInfo	finfo;
 
-		memset(&finfo, 0, sizeof(FmgrInfo));
 		memset(&ssup, 0, sizeof(ssup));
 		ssup.ssup_cxt = descrCxt;
 		ssup.ssup_collation = collation;
 		ssup.abbreviate = false;
 
-		o_proc_cache_fill_finfo(&finfo, opclass->ssupOid);
+		o_proc_cache_fill_finfo(&comparator.ssup_finfo, opclass->ssupOid);
 
-		FunctionCall1(&finfo, PointerGetDatum(&ssup));
+		FunctionCall1(&comparator.ssup_finfo, PointerGetDatum(&ssup));
 
 		if (ssup.comparator != NULL)
 		{
@@ -1406,9 +1535,36 @@ comparison_shim(Datum x, Datum y, SortSupport ssup)
 	return result;
 }
 
+/*
+ * Fills the comparison function of the sort support.  If the caller asks for
+ * abbreviation, the sort support function is called once again in the
+ * caller's context, because the cached comparator is built without
+ * abbreviation and its state can't be shared with the abbreviation state.
+ * That gives abbreviated keys for uuid, text, numeric and similar types,
+ * while pass-by-value types like int8 and timestamp already get the
+ * ssup_datum_*_cmp() comparators, which tuplesort sorts with its specialized
+ * quicksort routines.
+ */
 void
 o_finish_sort_support_function(OComparator *comparator, SortSupport ssup)
 {
+	if (comparator->haveSortSupport && ssup->abbreviate)
+	{
+		ssup->comparator = NULL;
+		ssup->ssup_extra = NULL;
+		ssup->abbrev_converter = NULL;
+		ssup->abbrev_abort = NULL;
+		ssup->abbrev_full_comparator = NULL;
+
+		o_set_syscache_hooks();
+		FunctionCall1(&comparator->ssup_finfo, PointerGetDatum(ssup));
+		o_unset_syscache_hooks();
+
+		if (ssup->comparator != NULL)
+			return;
+		ssup->abbreviate = false;
+	}
+
 	if (comparator->haveSortSupport)
 	{
 		ssup->comparator = comparator->ssup_comparator;
@@ -1466,6 +1622,14 @@ o_tableam_descr_init(void)
 	comparatorCache = hash_create("OrioleDB comparators", 8,
 								  &ctl,
 								  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	MemSet(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(SharedRootInfoKey);
+	ctl.entrysize = sizeof(RootInfoCacheEntry);
+	ctl.hcxt = descrCxt;
+	rootInfoCache = hash_create("OrioleDB root infos", 64,
+								&ctl,
+								HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
 }
 
 static bool
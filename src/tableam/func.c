@@ -17,9 +17,12 @@
 
 #include "btree/btree.h"
 #include "btree/check.h"
+#include "btree/find.h"
 #include "btree/io.h"
 #include "btree/iterator.h"
 #include "btree/page_chunks.h"
+#include "btree/scan.h"
+#include "catalog/free_extents.h"
 #include "catalog/indices.h"
 #include "tableam/descr.h"
 #include "tableam/handler.h"
@@ -27,6 +30,7 @@
 #include "tuple/format.h"
 #include "tuple/toast.h"
 #include "utils/compress.h"
+#include "utils/page_pool.h"
 
 #include "access/genam.h"
 #include "access/relation.h"
@@ -40,7 +44,9 @@
 #include "utils/datum.h"
 #include "utils/fmgroids.h"
 #include "utils/lsyscache.h"
+#include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/sampling.h"
 
 PG_FUNCTION_INFO_V1(orioledb_tbl_structure);
 PG_FUNCTION_INFO_V1(orioledb_idx_structure);
@@ -53,6 +59,9 @@ PG_FUNCTION_INFO_V1(orioledb_relation_size);
 PG_FUNCTION_INFO_V1(orioledb_tbl_are_indices_equal);
 PG_FUNCTION_INFO_V1(orioledb_table_pages);
 PG_FUNCTION_INFO_V1(orioledb_tree_stat);
+PG_FUNCTION_INFO_V1(orioledb_tree_defragment);
+PG_FUNCTION_INFO_V1(orioledb_tree_space);
+PG_FUNCTION_INFO_V1(orioledb_tree_train_dictionary);
 
 extern void log_btree(BTreeDescr *desc);
 
@@ -1402,7 +1411,8 @@ orioledb_tbl_indices(PG_FUNCTION_ARGS)
 		appendStringInfo(&buf, "    Index type: %s", primary ? "primary" : "secondary");
 		appendStringInfo(&buf, "%s", ct->unique ? ", unique" : "");
 		if (OCompressIsValid(ct->compress))
-			appendStringInfo(&buf, ", compression = %d", ct->compress);
+			appendStringInfo(&buf, ", compression = %s",
+							 o_compress_name(ct->compress));
 		appendStringInfo(&buf, "%s\n", primary && ct->primaryIsCtid ? ", ctid" : "");
 		if (ct->predicate)
 			appendStringInfo(&buf, "    Predicate: %s\n", ct->predicate_str);
@@ -1640,3 +1650,414 @@ orioledb_tree_stat(PG_FUNCTION_ARGS)
 
 	return (Datum) 0;
 }
+
+/*
+ * Marks the page dirty if it's stored at or after 'tailStart' of the data
+ * file.  The page must be locked.
+ */
+static bool
+defragment_mark_page(BTreeDescr *desc, OInMemoryBlkno blkno, uint64 tailStart,
+					 uint64 *units)
+{
+	OrioleDBPageDesc *pageDesc = O_GET_IN_MEMORY_PAGEDESC(blkno);
+
+	if (IS_DIRTY(blkno) || !FileExtentIsValid(pageDesc->fileExtent) ||
+		pageDesc->fileExtent.off < tailStart)
+		return false;
+
+	*units += pageDesc->fileExtent.len;
+	MARK_DIRTY(desc, blkno);
+	return true;
+}
+
+static void
+defragment_throttle(double pagesPerSecond)
+{
+	if (pagesPerSecond > 0)
+		pg_usleep((long) (1000000.0 / pagesPerSecond));
+	CHECK_FOR_INTERRUPTS();
+}
+
+/*
+ * Marks dirty the pages stored beyond the size of live data in the data file.
+ * The following checkpoints write them into the free space, which is handed
+ * out from the lowest offsets.  Thus, the live pages move towards the file
+ * start in the key order, while the tail of the file becomes free.
+ *
+ * The non-leaf pages of the first level are walked in the key order, the
+ * leaves are only loaded when their downlinks point to the tail.  The walk
+ * stops after 'maxPages' marked pages or when the free space is over.
+ */
+static int64
+tree_defragment(BTreeDescr *desc, int64 maxPages, double pagesPerSecond)
+{
+	BTreeMetaPage *metaPage = BTREE_GET_META(desc);
+	OBTreeFindPageContext context;
+	OFixedKey	key;
+	uint64		freeUnits,
+				tailStart,
+				units = 0;
+	int64		marked = 0;
+
+	freeUnits = pg_atomic_read_u64(&metaPage->numFreeBlocks);
+	tailStart = pg_atomic_read_u64(&metaPage->datafileLength[0]);
+	if (freeUnits == 0 || freeUnits >= tailStart)
+		return 0;
+	tailStart -= freeUnits;
+
+	init_page_find_context(&context, desc, COMMITSEQNO_INPROGRESS,
+						   BTREE_PAGE_FIND_MODIFY);
+	clear_fixed_key(&key);
+
+	while (marked < maxPages && units < freeUnits)
+	{
+		OInMemoryBlkno blkno;
+		BTreePageItemLocator loc;
+		Page		p;
+		List	   *children = NIL;
+		ListCell   *lc;
+		bool		rightmost;
+
+		if (O_TUPLE_IS_NULL(key.tuple))
+			(void) find_page(&context, NULL, BTreeKeyNone, 1);
+		else
+			(void) find_page(&context, &key.tuple, BTreeKeyNonLeafKey, 1);
+		blkno = context.items[context.index].blkno;
+		p = O_GET_IN_MEMORY_PAGE(blkno);
+
+		if (defragment_mark_page(desc, blkno, tailStart, &units))
+			marked++;
+
+		if (PAGE_GET_LEVEL(p) == 0)
+		{
+			/* The root is a leaf */
+			unlock_page(blkno);
+			break;
+		}
+
+		BTREE_PAGE_FOREACH_ITEMS(p, &loc)
+		{
+			BTreeNonLeafTuphdr *tuphdr;
+			OTuple		tuple;
+			OFixedKey  *childKey;
+			uint64		off;
+
+			BTREE_PAGE_READ_INTERNAL_ITEM(tuphdr, tuple, p, &loc);
+			if (DOWNLINK_IS_ON_DISK(tuphdr->downlink))
+			{
+				off = DOWNLINK_GET_DISK_OFF(tuphdr->downlink);
+			}
+			else if (DOWNLINK_IS_IN_MEMORY(tuphdr->downlink))
+			{
+				OrioleDBPageDesc *childDesc;
+
+				childDesc = O_GET_IN_MEMORY_PAGEDESC(DOWNLINK_GET_IN_MEMORY_BLKNO(tuphdr->downlink));
+				if (!FileExtentIsValid(childDesc->fileExtent))
+					continue;
+				off = childDesc->fileExtent.off;
+			}
+			else
+				continue;
+
+			if (off < tailStart)
+				continue;
+
+			/* The first child starts with the lokey of the page */
+			childKey = (OFixedKey *) palloc(sizeof(OFixedKey));
+			if (BTREE_PAGE_LOCATOR_GET_OFFSET(p, &loc) > 0)
+				copy_fixed_key(desc, childKey, tuple);
+			else
+				copy_fixed_key(desc, childKey, key.tuple);
+			children = lappend(children, childKey);
+		}
+
+		rightmost = O_PAGE_IS(p, RIGHTMOST);
+		if (!rightmost)
+			copy_fixed_hikey(desc, &key, p);
+		unlock_page(blkno);
+
+		foreach(lc, children)
+		{
+			OFixedKey  *childKey = (OFixedKey *) lfirst(lc);
+			bool		childMarked;
+
+			if (marked >= maxPages || units >= freeUnits)
+				break;
+
+			if (O_TUPLE_IS_NULL(childKey->tuple))
+				(void) find_page(&context, NULL, BTreeKeyNone, 0);
+			else
+				(void) find_page(&context, &childKey->tuple,
+								 BTreeKeyNonLeafKey, 0);
+			blkno = context.items[context.index].blkno;
+			childMarked = defragment_mark_page(desc, blkno, tailStart, &units);
+			unlock_page(blkno);
+
+			if (childMarked)
+			{
+				marked++;
+				defragment_throttle(pagesPerSecond);
+			}
+		}
+		list_free_deep(children);
+
+		if (rightmost)
+			break;
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	return marked;
+}
+
+Datum
+orioledb_tree_defragment(PG_FUNCTION_ARGS)
+{
+	Oid			relid = PG_GETARG_OID(0);
+	int64		maxPages = PG_GETARG_INT64(1);
+	double		pagesPerSecond = PG_GETARG_FLOAT8(2);
+	OIndexDescr *descr;
+
+	if (orioledb_s3_mode || use_device)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("defragmentation isn't supported with S3 or device storage")));
+	if (maxPages < 0 || pagesPerSecond < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("max_pages and pages_per_second must not be negative")));
+
+	orioledb_check_shmem();
+
+	descr = fetch_index_descr_by_oid(relid);
+	if (descr->desc.storageType == BTreeStorageInMemory)
+		PG_RETURN_INT64(0);
+
+	o_btree_load_shmem(&descr->desc);
+	PG_RETURN_INT64(tree_defragment(&descr->desc, maxPages, pagesPerSecond));
+}
+
+typedef struct
+{
+	int64		count;
+	int64		total;
+	int64		maxLen;
+} TreeFreeSpace;
+
+static void
+tree_space_add_extent(BTreeDescr *desc, FileExtent extent, void *arg)
+{
+	TreeFreeSpace *space = (TreeFreeSpace *) arg;
+
+	space->count++;
+	space->total += extent.len;
+	space->maxLen = Max(space->maxLen, extent.len);
+}
+
+/*
+ * Reports the data file space of the tree: the data file length, the free
+ * space inside it, the number of the free extents and the largest of them.
+ * The uncompressed trees have only single-block free extents.
+ */
+Datum
+orioledb_tree_space(PG_FUNCTION_ARGS)
+{
+	Oid			relid = PG_GETARG_OID(0);
+	OIndexDescr *descr;
+	BTreeMetaPage *metaPage;
+	TupleDesc	tupdesc;
+	TreeFreeSpace space = {0};
+	int64		blockSize;
+	Datum		values[4];
+	bool		nulls[4] = {false};
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	orioledb_check_shmem();
+
+	descr = fetch_index_descr_by_oid(relid);
+	if (descr->desc.storageType == BTreeStorageInMemory)
+		PG_RETURN_NULL();
+
+	o_btree_load_shmem(&descr->desc);
+	metaPage = BTREE_GET_META(&descr->desc);
+
+	if (OCompressIsValid(descr->desc.compress) || use_device)
+	{
+		blockSize = ORIOLEDB_COMP_BLCKSZ;
+		foreach_free_extent(&descr->desc, tree_space_add_extent, &space);
+	}
+	else
+	{
+		blockSize = ORIOLEDB_BLCKSZ;
+		space.count = space.total = pg_atomic_read_u64(&metaPage->numFreeBlocks);
+		space.maxLen = space.count > 0 ? 1 : 0;
+	}
+
+	values[0] = Int64GetDatum(pg_atomic_read_u64(&metaPage->datafileLength[0]) * blockSize);
+	values[1] = Int64GetDatum(space.total * blockSize);
+	values[2] = Int64GetDatum(space.count);
+	values[3] = Int64GetDatum(space.maxLen * blockSize);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
+
+/*
+ * Collects the training samples for the compression dictionary from
+ * 'samplePages' randomly chosen leaf pages.  Each sample is the page-sized
+ * run of the consecutive tuples.
+ */
+static Pointer
+tree_collect_dict_samples(BTreeDescr *desc, int samplePages,
+						  size_t **sampleSizes, int *nsamples)
+{
+	BlockSamplerData bs;
+	BTreeSeqScan *scan;
+	MemoryContext tupleCxt;
+	Pointer		samples;
+	Size		samplesAllocated,
+				samplesLen = 0,
+				curSampleLen = 0;
+	int			sizesAllocated = 64;
+	bool		scanEnd = false;
+
+	(void) BlockSampler_Init(&bs, TREE_NUM_LEAF_PAGES(desc), samplePages,
+							 random());
+	scan = make_btree_sampling_scan(desc, &bs);
+
+	samplesAllocated = (Size) samplePages * ORIOLEDB_BLCKSZ;
+	samples = palloc(samplesAllocated);
+	*sampleSizes = (size_t *) palloc(sizeof(size_t) * sizesAllocated);
+	*nsamples = 0;
+
+	tupleCxt = AllocSetContextCreate(CurrentMemoryContext,
+									 "orioledb dictionary samples",
+									 ALLOCSET_DEFAULT_SIZES);
+
+	while (true)
+	{
+		OTuple		tuple;
+		int			len;
+
+		CHECK_FOR_INTERRUPTS();
+
+		MemoryContextReset(tupleCxt);
+		tuple = btree_seq_scan_getnext_raw(scan, tupleCxt, &scanEnd, NULL);
+		if (scanEnd)
+			break;
+		if (O_TUPLE_IS_NULL(tuple))
+			continue;
+
+		len = o_btree_len(desc, tuple, OTupleLength);
+		if (samplesLen + len > samplesAllocated)
+			break;
+
+		memcpy(samples + samplesLen, tuple.data, len);
+		samplesLen += len;
+		curSampleLen += len;
+
+		if (curSampleLen >= ORIOLEDB_BLCKSZ)
+		{
+			if (*nsamples >= sizesAllocated)
+			{
+				sizesAllocated *= 2;
+				*sampleSizes = (size_t *) repalloc(*sampleSizes,
+												   sizeof(size_t) * sizesAllocated);
+			}
+			(*sampleSizes)[(*nsamples)++] = curSampleLen;
+			curSampleLen = 0;
+		}
+	}
+
+	/* The tail of the samples buffer is the last sample */
+	if (curSampleLen > 0)
+	{
+		if (*nsamples >= sizesAllocated)
+			*sampleSizes = (size_t *) repalloc(*sampleSizes,
+											   sizeof(size_t) * (sizesAllocated + 1));
+		(*sampleSizes)[(*nsamples)++] = curSampleLen;
+	}
+
+	free_btree_seq_scan(scan);
+	MemoryContextDelete(tupleCxt);
+
+	return samples;
+}
+
+/*
+ * Trains the new compression dictionary for the tree.  The subsequently
+ * written page images are compressed with this dictionary.  The previously
+ * written pages will be recompressed once they are written again.  Returns
+ * the new dictionary id.
+ */
+Datum
+orioledb_tree_train_dictionary(PG_FUNCTION_ARGS)
+{
+	Oid			relid = PG_GETARG_OID(0);
+	int32		samplePages = PG_GETARG_INT32(1);
+	int32		dictCapacity = PG_GETARG_INT32(2);
+	OIndexDescr *descr;
+	BTreeMetaPage *meta;
+	Pointer		samples,
+				dict;
+	size_t	   *sampleSizes;
+	size_t		dictSize;
+	int			nsamples;
+	uint32		zstdId;
+	uint32		dictId;
+
+	if (orioledb_s3_mode || use_device)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("compression dictionaries aren't supported with S3 or device storage")));
+	if (samplePages <= 0 || samplePages > MaxAllocSize / ORIOLEDB_BLCKSZ)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("sample_pages must be between 1 and %d",
+						(int) (MaxAllocSize / ORIOLEDB_BLCKSZ))));
+	if (dictCapacity < 1024 || dictCapacity > O_COMPRESS_DICT_MAX_SIZE)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("dict_size must be between %d and %d",
+						1024, O_COMPRESS_DICT_MAX_SIZE)));
+
+	orioledb_check_shmem();
+
+	descr = fetch_index_descr_by_oid(relid);
+	if (!OCompressIsValid(descr->desc.compress))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("relation \"%s\" is not compressed",
+						get_rel_name(relid))));
+	if (OCompressIsLZ4(descr->desc.compress))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("compression dictionaries are supported only for zstd compression")));
+
+	o_btree_load_shmem(&descr->desc);
+
+	samples = tree_collect_dict_samples(&descr->desc, samplePages,
+										&sampleSizes, &nsamples);
+	dict = o_compress_dict_train(samples, sampleSizes, nsamples,
+								 dictCapacity, &dictSize, &zstdId);
+	pfree(samples);
+	pfree(sampleSizes);
+
+	/* Dictionary ids are dense, so dictionaries are created one at a time */
+	meta = BTREE_GET_META(&descr->desc);
+	LWLockAcquire(&meta->metaLock, LW_EXCLUSIVE);
+	dictId = O_COMPRESS_DICT_GET_ID(pg_atomic_read_u64(&meta->compressDict)) + 1;
+	if (dictId > O_COMPRESS_DICT_MAX_ID)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("too many compression dictionaries for relation \"%s\"",
+						get_rel_name(relid))));
+	o_compress_dict_write(descr->desc.oids.datoid, descr->desc.oids.relnode,
+						  dictId, dict, dictSize);
+	pg_atomic_write_u64(&meta->compressDict,
+						O_COMPRESS_DICT_MAKE(dictId, zstdId));
+	LWLockRelease(&meta->metaLock);
+
+	pfree(dict);
+	PG_RETURN_INT32(dictId);
+}
@@ -18,6 +18,7 @@
 
 #include "btree/btree.h"
 #include "btree/iterator.h"
+#include "btree/merge.h"
 #include "btree/scan.h"
 #include "btree/undo.h"
 #include "catalog/indices.h"
@@ -65,6 +66,7 @@
 #include "utils/lsyscache.h"
 #include "utils/sampling.h"
 #include "utils/syscache.h"
+#include "pgstat.h"
 
 bool		in_nontransactional_truncate = false;
 
@@ -360,7 +362,9 @@ orioledb_tuple_insert(Relation relation, TupleTableSlot *slot,
 
 	descr = relation_get_descr(relation);
 	fill_current_oxid_osnapshot(&oxid, &oSnapshot);
-	return o_tbl_insert(descr, relation, slot, oxid, oSnapshot.csn);
+	slot = o_tbl_insert(descr, relation, slot, oxid, oSnapshot.csn);
+	pgstat_count_heap_insert(relation, 1);
+	return slot;
 }
 
 static TupleTableSlot *
@@ -406,6 +410,8 @@ orioledb_tuple_insert_with_arbiter(ResultRelInfo *rinfo,
 
 	slot = o_tbl_insert_with_arbiter(rel, descr, slot, arbiterIndexes,
 									 lockmode, lockedSlot);
+	if (slot)
+		pgstat_count_heap_insert(rel, 1);
 
 	return slot;
 }
@@ -490,7 +496,10 @@ orioledb_tuple_delete(Relation relation, Datum tupleid, CommandId cid,
 
 	if (mres.success)
 	{
-		return mres.self_modified ? TM_SelfModified : TM_Ok;
+		if (mres.self_modified)
+			return TM_SelfModified;
+		pgstat_count_heap_delete(relation);
+		return TM_Ok;
 	}
 
 	return mres.self_modified ? TM_SelfModified : (marg.modified ? TM_Updated : TM_Deleted);
@@ -599,7 +608,10 @@ orioledb_tuple_update(Relation relation, Datum tupleid, TupleTableSlot *slot,
 	bms_free(marg.keyAttrs);
 	Assert(mres.success);
 
-	return mres.oldTuple ? TM_Ok : (marg.modified ? TM_Updated : TM_Deleted);
+	if (!mres.oldTuple)
+		return marg.modified ? TM_Updated : TM_Deleted;
+	pgstat_count_heap_update(relation, false, false);
+	return TM_Ok;
 }
 
 static TM_Result
@@ -680,7 +692,7 @@ orioledb_tuple_lock(Relation rel, Datum tupleid, Snapshot snapshot,
 static void
 orioledb_finish_bulk_insert(Relation relation, int options)
 {
-	/* Do nothing here */
+	o_tbl_bulk_load_finish(relation);
 }
 
 
@@ -973,10 +985,24 @@ orioledb_estimate_rel_size(Relation rel, int32 *attr_widths,
 	double		reltuples;
 	BlockNumber relallvisible;
 	double		density;
+	double		liveDensity = 0.0;
+	OTableDescr *descr;
 
 	/* it has storage, ok to call the smgr */
 	curpages = RelationGetNumberOfBlocks(rel);
 
+	/*
+	 * The primary tree keeps a running estimate of live tuples per leaf page.
+	 * It follows the recent modifications, so prefer it to the pg_class
+	 * statistics, which are only as fresh as the last ANALYZE.
+	 */
+	descr = relation_get_descr(rel);
+	if (descr && tbl_data_exists(&GET_PRIMARY(descr)->oids))
+	{
+		o_btree_load_shmem(&GET_PRIMARY(descr)->desc);
+		liveDensity = TREE_LEAF_DENSITY(&GET_PRIMARY(descr)->desc);
+	}
+
 	/* coerce values in pg_class to more desirable types */
 	relpages = (BlockNumber) rel->rd_rel->relpages;
 	reltuples = (double) rel->rd_rel->reltuples;
@@ -1023,8 +1049,12 @@ orioledb_estimate_rel_size(Relation rel, int32 *attr_widths,
 		return;
 	}
 
-	/* estimate number of tuples from previous tuple density */
-	if (reltuples >= 0 && relpages > 0)
+	/* estimate number of tuples from the live or previous tuple density */
+	if (liveDensity > 0.0)
+	{
+		density = liveDensity;
+	}
+	else if (reltuples >= 0 && relpages > 0)
 	{
 		density = reltuples / (double) relpages;
 	}
@@ -1312,19 +1342,20 @@ orioledb_getnextslot(TableScanDesc sscan, ScanDirection direction,
 		OTuple		tuple = {0};
 		BTreeLocationHint hint;
 		CommitSeqNo csn;
+		bool		allocated = true;
 
 		scan = (OScanDesc) sscan;
 		descr = relation_get_descr(scan->rs_base.rs_rd);
 
 		if (scan->scan)
-			tuple = btree_seq_scan_getnext(scan->scan, slot->tts_mcxt,
-										   &csn, &hint);
+			tuple = btree_seq_scan_getnext_ref(scan->scan, slot->tts_mcxt,
+											   &csn, &hint, &allocated);
 
 		if (O_TUPLE_IS_NULL(tuple))
 			return false;
 
 		tts_orioledb_store_tuple(slot, tuple, descr, csn,
-								 PrimaryIndexNumber, true, &hint);
+								 PrimaryIndexNumber, allocated, &hint);
 
 		result = slot_keytest(slot,
 							  scan->rs_base.rs_nkeys,
@@ -1339,10 +1370,21 @@ static void
 orioledb_multi_insert(Relation relation, TupleTableSlot **slots, int ntuples,
 					  CommandId cid, int options, BulkInsertState bistate)
 {
-	int			i;
+	OTableDescr *descr;
+	OSnapshot	oSnapshot;
+	OXid		oxid;
 
-	for (i = 0; i < ntuples; i++)
-		orioledb_tuple_insert(relation, slots[i], cid, options, bistate);
+	if (OidIsValid(relation->rd_rel->relrewrite))
+		return;
+
+	descr = relation_get_descr(relation);
+	if (!o_tbl_bulk_load_insert(descr, relation, slots, ntuples, options))
+	{
+		fill_current_oxid_osnapshot(&oxid, &oSnapshot);
+		o_tbl_insert_batch(descr, relation, slots, ntuples, oxid,
+						   oSnapshot.csn);
+	}
+	pgstat_count_heap_insert(relation, ntuples);
 }
 
 static void
@@ -1352,11 +1394,37 @@ orioledb_get_latest_tid(TableScanDesc sscan,
 	elog(ERROR, "Not implemented: %s", PG_FUNCNAME_MACRO);
 }
 
+/*
+ * There are no dead tuples to collect: undo takes care of old versions.  But
+ * bulk deletes might leave sparse pages, which wouldn't be merged until the
+ * next modification.  So, compact and merge in-memory pages of all the trees.
+ */
 static void
 orioledb_vacuum_rel(Relation onerel, VacuumParams *params,
 					BufferAccessStrategy bstrategy)
 {
-	/* nothing to do */
+	OTableDescr *descr;
+	OBTreeVacuumStats stats;
+	int			elevel = (params->options & VACOPT_VERBOSE) ? INFO : DEBUG2;
+	int			i;
+
+	descr = relation_get_descr(onerel);
+	if (descr == NULL)
+		return;
+
+	memset(&stats, 0, sizeof(stats));
+	for (i = 0; i < descr->nIndices; i++)
+		btree_vacuum_tree(&descr->indices[i]->desc, &stats);
+	btree_vacuum_tree(&descr->toast->desc, &stats);
+
+	ereport(elevel,
+			(errmsg("vacuuming \"%s.%s\"",
+					get_namespace_name(RelationGetNamespace(onerel)),
+					RelationGetRelationName(onerel)),
+			 errdetail("pages: " UINT64_FORMAT " scanned, " UINT64_FORMAT " compacted, "
+					   UINT64_FORMAT " merged; " UINT64_FORMAT " bytes reclaimed.",
+					   stats.pagesScanned, stats.pagesCompacted,
+					   stats.pagesMerged, stats.bytesReclaimed)));
 }
 
 static TransactionId
@@ -25,8 +25,15 @@
 
 #include "access/nbtree.h"
 #include "access/skey.h"
+#include "catalog/pg_proc_d.h"
 #include "executor/nodeIndexscan.h"
 #include "parser/parse_coerce.h"
+#include "pgstat.h"
+#include "storage/spin.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+
+bool		orioledb_enable_skip_scan = true;
 
 void
 init_index_scan_state(OPlanState *o_plan_state, OScanState *ostate, Relation index,
@@ -97,7 +104,7 @@ static inline bool
 o_bound_is_coercible(OBTreeValueBound *bound, OIndexField *field)
 {
 	return (bound->flags & O_VALUE_BOUND_COERCIBLE) ||
-		IsBinaryCoercible(bound->type, field->inputtype);
+		o_is_binary_coercible(bound->type, field->inputtype);
 }
 
 static bool
@@ -180,8 +187,8 @@ is_tuple_valid(OTuple tup, OIndexDescr *id, OBTreeKeyRange *range,
 				int			cmp;
 
 				if (o_bound_is_coercible(bound, field))
-					cmp = o_call_comparator(field->comparator,
-											value, arrayKey->elem_values[j]);
+					cmp = o_call_field_comparator(field, value,
+												  arrayKey->elem_values[j]);
 				else
 					cmp = o_call_comparator(bound->comparator,
 											value, arrayKey->elem_values[j]);
@@ -259,6 +266,284 @@ o_bt_advance_array_keys_increment(OScanState *ostate, ScanDirection dir)
 }
 #endif
 
+/*
+ * Claims the whole parallel index scan for this worker.  Returns false if
+ * another worker has already started it.
+ */
+static bool
+o_parallel_index_scan_claim(OScanState *ostate)
+{
+	ParallelOIndexScanDesc pscan = ostate->pscan;
+
+	if (ostate->parallelOwner)
+		return true;
+
+	SpinLockAcquire(&pscan->mutex);
+	if (pscan->status == OParallelIndexScanNotStarted)
+	{
+		pscan->status = OParallelIndexScanExclusive;
+		ostate->parallelOwner = true;
+	}
+	SpinLockRelease(&pscan->mutex);
+
+	return ostate->parallelOwner;
+}
+
+/*
+ * Marks the parallel index scan as finished for all the workers.
+ */
+static void
+o_parallel_index_scan_finish(OScanState *ostate)
+{
+	ParallelOIndexScanDesc pscan = ostate->pscan;
+
+	ostate->parallelDone = true;
+	SpinLockAcquire(&pscan->mutex);
+	pscan->status = OParallelIndexScanDone;
+	SpinLockRelease(&pscan->mutex);
+	ConditionVariableBroadcast(&pscan->cv);
+}
+
+/*
+ * Takes the next chunk of the parallel index scan and makes an iterator over
+ * it.  The chunk spans from the published start key to the hikey of the leaf
+ * page containing it.  Returns false if there are no more chunks.
+ */
+static bool
+o_parallel_index_scan_next_chunk(OIndexDescr *indexDescr, OScanState *ostate,
+								 MemoryContext tupleCxt)
+{
+	ParallelOIndexScanDesc pscan = ostate->pscan;
+	BTreeDescr *desc = &indexDescr->desc;
+	OFixedKey	start;
+	bool		started = false;
+	bool		last;
+	MemoryContext oldcontext;
+
+	Assert(ostate->iterator == NULL);
+
+	SpinLockAcquire(&pscan->mutex);
+	while (pscan->status == OParallelIndexScanAdvancing)
+	{
+		SpinLockRelease(&pscan->mutex);
+		ConditionVariableSleep(&pscan->cv, WAIT_EVENT_BTREE_PAGE);
+		SpinLockAcquire(&pscan->mutex);
+	}
+	if (pscan->status == OParallelIndexScanDone ||
+		pscan->status == OParallelIndexScanExclusive)
+	{
+		SpinLockRelease(&pscan->mutex);
+		ConditionVariableCancelSleep();
+		ostate->parallelDone = true;
+		return false;
+	}
+	started = (pscan->status == OParallelIndexScanIdle);
+	pscan->status = OParallelIndexScanAdvancing;
+	SpinLockRelease(&pscan->mutex);
+	ConditionVariableCancelSleep();
+
+	/* Nobody else touches nextKey while we're advancing */
+	if (started)
+		copy_from_fixed_shmem_key(&start, &pscan->nextKey);
+
+	oldcontext = MemoryContextSwitchTo(ostate->cxt);
+	if (started)
+		ostate->iterator = o_btree_iterator_create(desc, (Pointer) &start.tuple,
+												   BTreeKeyNonLeafKey,
+												   &ostate->oSnapshot,
+												   ForwardScanDirection);
+	else
+		ostate->iterator = o_btree_iterator_create(desc,
+												   (Pointer) &ostate->curKeyRange.low,
+												   BTreeKeyBound,
+												   &ostate->oSnapshot,
+												   ForwardScanDirection);
+	o_btree_iterator_set_tuple_ctx(ostate->iterator, tupleCxt);
+	MemoryContextSwitchTo(oldcontext);
+
+	ostate->chunkHasEnd = o_btree_iterator_get_hikey(ostate->iterator,
+													 &ostate->chunkEnd);
+
+	/* It's the last chunk if the key range ends before the hikey */
+	last = !ostate->chunkHasEnd ||
+		o_btree_cmp(desc, &ostate->curKeyRange.high, BTreeKeyBound,
+					&ostate->chunkEnd.tuple, BTreeKeyNonLeafKey) < 0;
+	if (!last)
+		copy_fixed_shmem_key(desc, &pscan->nextKey, ostate->chunkEnd.tuple);
+
+	SpinLockAcquire(&pscan->mutex);
+	pscan->status = last ? OParallelIndexScanDone : OParallelIndexScanIdle;
+	SpinLockRelease(&pscan->mutex);
+	ConditionVariableBroadcast(&pscan->cv);
+
+	return true;
+}
+
+/*
+ * Fetches the next batch of the parallel index scan chunk.  Switches to the
+ * next chunk once the current one is exhausted.
+ */
+static int
+o_parallel_index_scan_fetch_batch(OIndexDescr *indexDescr, OScanState *ostate,
+								  OBTreeKeyBound *bound,
+								  MemoryContext tupleCxt)
+{
+	BTreeDescr *desc = &indexDescr->desc;
+	int			n,
+				i;
+
+	while (!ostate->parallelDone)
+	{
+		if (ostate->iterator == NULL &&
+			!o_parallel_index_scan_next_chunk(indexDescr, ostate, tupleCxt))
+			break;
+
+		if (!ostate->chunkHasEnd)
+			return o_btree_iterator_fetch_batch(ostate->iterator,
+												ostate->batchTuples,
+												ostate->batchCsns,
+												O_SCAN_BATCH_SIZE,
+												bound, BTreeKeyBound, true,
+												&ostate->batchHint);
+
+		n = o_btree_iterator_fetch_batch(ostate->iterator,
+										 ostate->batchTuples,
+										 ostate->batchCsns,
+										 O_SCAN_BATCH_SIZE,
+										 &ostate->chunkEnd.tuple,
+										 BTreeKeyNonLeafKey, false,
+										 &ostate->batchHint);
+		if (n == 0)
+		{
+			btree_iterator_free(ostate->iterator);
+			ostate->iterator = NULL;
+			continue;
+		}
+
+		/*
+		 * The chunk is bounded by the hikey, which might be beyond the key
+		 * range.  Chunks are ordered, so no worker needs to go further.
+		 */
+		for (i = 0; i < n; i++)
+		{
+			if (o_btree_cmp(desc, &ostate->batchTuples[i], BTreeKeyLeafTuple,
+							bound, BTreeKeyBound) > 0)
+				break;
+		}
+		if (i < n)
+		{
+			int			j;
+
+			for (j = i; j < n; j++)
+				pfree(ostate->batchTuples[j].data);
+			o_parallel_index_scan_finish(ostate);
+		}
+		return i;
+	}
+
+	return 0;
+}
+
+/*
+ * Checks if the current key range could be scanned by skipping over the
+ * distinct values of the first non-exact column.  That requires a bound on
+ * the next column, which isn't used to position the iterator otherwise.
+ */
+static bool
+o_index_scan_can_skip(OIndexDescr *id, OScanState *ostate, BTScanOpaque so)
+{
+	OBTreeKeyBound *low = &ostate->curKeyRange.low;
+	OBTreeKeyBound *high = &ostate->curKeyRange.high;
+	int			skipColumn = ostate->numPrefixExactKeys;
+
+	if (!orioledb_enable_skip_scan || ostate->exact ||
+		ostate->iterator == NULL || ostate->parallelChunks ||
+		ostate->scanDir != ForwardScanDirection || so->numArrayKeys != 0 ||
+		skipColumn + 1 >= low->nkeys ||
+		OIgnoreColumn(id, skipColumn) || OIgnoreColumn(id, skipColumn + 1))
+		return false;
+
+	return !(low->keys[skipColumn + 1].flags & O_VALUE_BOUND_UNBOUNDED) ||
+		!(high->keys[skipColumn + 1].flags & O_VALUE_BOUND_UNBOUNDED);
+}
+
+/*
+ * Skips the iterator over the tuples, which can't match the bound on the
+ * column following the skip column, given the skip column value of the
+ * rejected tuple.  If the column is below its lower bound, we seek to the
+ * lower bound within the same skip column value.  If it's above its upper
+ * bound, we seek past the skip column value.  The seek is a fresh descent
+ * from the root unless the target is within the current batch.
+ */
+static void
+o_index_scan_skip(OIndexDescr *id, OScanState *ostate, OTuple tup,
+				  MemoryContext tupleCxt)
+{
+	OBTreeKeyBound *low = &ostate->curKeyRange.low;
+	OBTreeKeyBound *high = &ostate->curKeyRange.high;
+	int			skipColumn = ostate->numPrefixExactKeys;
+	int			nextColumn = skipColumn + 1;
+	OBTreeKeyBound bound;
+	AttrNumber	attnum;
+	Datum		value;
+	bool		isnull;
+	bool		belowLow = false;
+	bool		aboveHigh = false;
+	MemoryContext oldcontext;
+
+	attnum = OIndexKeyAttnumToTupleAttnum(BTreeKeyLeafTuple, id,
+										  nextColumn + 1);
+	value = o_fastgetattr(tup, attnum, id->leafTupdesc, &id->leafSpec,
+						  &isnull);
+	if (!(low->keys[nextColumn].flags & O_VALUE_BOUND_UNBOUNDED))
+		belowLow = o_idx_cmp_range_key_to_value(&low->keys[nextColumn],
+												&id->fields[nextColumn],
+												value, isnull) > 0;
+	if (!belowLow && !(high->keys[nextColumn].flags & O_VALUE_BOUND_UNBOUNDED))
+		aboveHigh = o_idx_cmp_range_key_to_value(&high->keys[nextColumn],
+												 &id->fields[nextColumn],
+												 value, isnull) < 0;
+
+	/* The tuple is rejected by some other column, nothing to skip */
+	if (!belowLow && !aboveHigh)
+		return;
+
+	bound = *low;
+	bound.n_row_keys = 0;
+	bound.row_keys = NULL;
+
+	attnum = OIndexKeyAttnumToTupleAttnum(BTreeKeyLeafTuple, id,
+										  skipColumn + 1);
+	bound.keys[skipColumn].value = o_fastgetattr(tup, attnum, id->leafTupdesc,
+												 &id->leafSpec, &isnull);
+	bound.keys[skipColumn].type = id->leafTupdesc->attrs[attnum - 1].atttypid;
+	bound.keys[skipColumn].flags = O_VALUE_BOUND_PLAIN_VALUE;
+	if (aboveHigh)
+		bound.keys[skipColumn].flags &= ~O_VALUE_BOUND_INCLUSIVE;
+	if (isnull)
+		bound.keys[skipColumn].flags |= O_VALUE_BOUND_NULL;
+	bound.keys[skipColumn].comparator = id->fields[skipColumn].comparator;
+
+	/* Don't descend if the rest of the batch reaches the target anyway */
+	if (ostate->batchIndex < ostate->batchCount &&
+		o_btree_cmp(&id->desc, &bound, BTreeKeyBound,
+					&ostate->batchTuples[ostate->batchCount - 1],
+					BTreeKeyLeafTuple) <= 0)
+		return;
+
+	btree_iterator_free(ostate->iterator);
+	o_index_scan_discard_batch(ostate);
+
+	oldcontext = MemoryContextSwitchTo(ostate->rescanCxt ? ostate->rescanCxt
+									   : ostate->cxt);
+	ostate->iterator = o_btree_iterator_create(&id->desc, (Pointer) &bound,
+											   BTreeKeyBound,
+											   &ostate->oSnapshot,
+											   ForwardScanDirection);
+	o_btree_iterator_set_tuple_ctx(ostate->iterator, tupleCxt);
+	MemoryContextSwitchTo(oldcontext);
+}
+
 static bool
 switch_to_next_range(OIndexDescr *indexDescr, OScanState *ostate,
 					 MemoryContext tupleCxt)
@@ -266,6 +551,7 @@ switch_to_next_range(OIndexDescr *indexDescr, OScanState *ostate,
 	OBTreeKeyBound *bound;
 	IndexScanDesc scan = &ostate->scandesc;
 	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	BTreeIterator *prevIterator;
 	MemoryContext oldcontext;
 	bool		result = true;
 
@@ -310,11 +596,14 @@ switch_to_next_range(OIndexDescr *indexDescr, OScanState *ostate,
 	if (!result)
 		return false;
 
-	if (ostate->iterator != NULL)
-	{
-		btree_iterator_free(ostate->iterator);
-		ostate->iterator = NULL;
-	}
+	/*
+	 * Keep the iterator of the previous array key range.  Array elements are
+	 * sorted, so the next range often starts on the same leaf or nearby, and
+	 * the forward iterator can be rescanned from there without the descent.
+	 */
+	prevIterator = ostate->iterator;
+	ostate->iterator = NULL;
+	o_index_scan_discard_batch(ostate);
 
 	oldcontext = MemoryContextSwitchTo(ostate->cxt);
 	ostate->exact = o_key_data_to_key_range(&ostate->curKeyRange,
@@ -325,22 +614,293 @@ switch_to_next_range(OIndexDescr *indexDescr, OScanState *ostate,
 											indexDescr->nonLeafTupdesc->natts,
 											indexDescr->fields);
 
-	if (!ostate->exact)
+	if (ostate->pscan)
+	{
+		/*
+		 * Only a single forward range scan can be split into chunks.  Other
+		 * scans are done by the first worker coming here.
+		 */
+		ostate->parallelChunks = !ostate->exact && so->numArrayKeys == 0 &&
+			ostate->scanDir == ForwardScanDirection;
+		if (!ostate->parallelChunks && !o_parallel_index_scan_claim(ostate))
+		{
+			MemoryContextSwitchTo(oldcontext);
+			if (prevIterator != NULL)
+				btree_iterator_free(prevIterator);
+			return false;
+		}
+	}
+
+	if (!ostate->exact && !ostate->parallelChunks)
 	{
 		bound = (ostate->scanDir == ForwardScanDirection
 				 ? &ostate->curKeyRange.low
 				 : &ostate->curKeyRange.high);
-		ostate->iterator = o_btree_iterator_create(&indexDescr->desc, (Pointer) bound,
-												   BTreeKeyBound, &ostate->oSnapshot,
-												   ostate->scanDir);
+		if (prevIterator != NULL &&
+			ostate->scanDir == ForwardScanDirection)
+		{
+			ostate->iterator = prevIterator;
+			prevIterator = NULL;
+			o_btree_iterator_rescan(ostate->iterator, (Pointer) bound,
+									BTreeKeyBound);
+		}
+		else if (ostate->rescanIterator != NULL &&
+				 ostate->scanDir == ForwardScanDirection)
+		{
+			ostate->iterator = ostate->rescanIterator;
+			ostate->rescanIterator = NULL;
+			o_btree_iterator_rescan(ostate->iterator, (Pointer) bound,
+									BTreeKeyBound);
+		}
+		else
+		{
+			if (ostate->rescanCxt)
+				MemoryContextSwitchTo(ostate->rescanCxt);
+			ostate->iterator = o_btree_iterator_create(&indexDescr->desc, (Pointer) bound,
+													   BTreeKeyBound, &ostate->oSnapshot,
+													   ostate->scanDir);
+		}
 		o_btree_iterator_set_tuple_ctx(ostate->iterator, tupleCxt);
 	}
 
 	MemoryContextSwitchTo(oldcontext);
 
+	if (prevIterator != NULL)
+		btree_iterator_free(prevIterator);
+
+	ostate->skipScan = o_index_scan_can_skip(indexDescr, ostate, so);
+
 	return true;
 }
 
+/*
+ * Frees the tuples fetched from the iterator, but not returned yet.  Must be
+ * called each time the iterator is freed or forgotten.
+ */
+void
+o_index_scan_discard_batch(OScanState *ostate)
+{
+	while (ostate->batchIndex < ostate->batchCount)
+		pfree(ostate->batchTuples[ostate->batchIndex++].data);
+	ostate->batchCount = 0;
+	ostate->batchIndex = 0;
+}
+
+/*
+ * Frees the secondary index tuples buffered for the sorted primary key fetch.
+ */
+void
+o_index_scan_discard_pk_batch(OScanState *ostate)
+{
+	while (ostate->pkBatchIndex < ostate->pkBatchCount)
+		pfree(ostate->pkBatchTuples[ostate->pkBatchIndex++].data);
+	ostate->pkBatchCount = 0;
+	ostate->pkBatchIndex = 0;
+}
+
+/*
+ * Picks the quals of form "column op constant" over fixed-length index fields
+ * from the scan quals.  They are checked on index leaf tuples of the whole
+ * batch at once, so that the rejected tuples never reach the slot and (for
+ * secondary indexes) never cause primary key lookups.  The complete qual is
+ * still evaluated by the executor for the survivors.
+ *
+ * Filters are evaluated before the quals preceding them in the executor
+ * order, so only leakproof non-volatile operators are picked: they can't
+ * throw an error for the values, which the preceding quals would reject.
+ */
+void
+o_index_scan_init_filters(OScanState *ostate, OIndexDescr *id,
+						  List *qual, Index scanrelid)
+{
+	ListCell   *lc;
+	int			ctid_off = id->primaryIsCtid ? 1 : 0;
+
+	ostate->nFilters = 0;
+	ostate->filters = NULL;
+
+	foreach(lc, qual)
+	{
+		OpExpr	   *op = (OpExpr *) lfirst(lc);
+		Node	   *left,
+				   *right;
+		Var		   *var;
+		Const	   *cnst;
+		OScanFilter *filter;
+		Form_pg_attribute att;
+		int			attnum = 0;
+		int			i;
+
+		if (!IsA(op, OpExpr) || list_length(op->args) != 2)
+			continue;
+
+		left = (Node *) linitial(op->args);
+		right = (Node *) lsecond(op->args);
+		if (IsA(left, Var) && IsA(right, Const))
+		{
+			var = (Var *) left;
+			cnst = (Const *) right;
+		}
+		else if (IsA(left, Const) && IsA(right, Var))
+		{
+			var = (Var *) right;
+			cnst = (Const *) left;
+		}
+		else
+			continue;
+
+		if (var->varno != scanrelid || var->varlevelsup != 0 ||
+			var->varattno <= 0 || cnst->constisnull ||
+			!func_strict(op->opfuncid) ||
+			!get_func_leakproof(op->opfuncid) ||
+			func_volatile(op->opfuncid) == PROVOLATILE_VOLATILE)
+			continue;
+
+		for (i = 0; i < id->nFields; i++)
+		{
+			if (id->fields[i].tableAttnum == var->varattno + ctid_off)
+			{
+				attnum = OIndexKeyAttnumToTupleAttnum(BTreeKeyLeafTuple,
+													  id, i + 1);
+				break;
+			}
+		}
+		if (attnum <= 0)
+			continue;
+
+		/* Fixed-length values are never toasted */
+		att = TupleDescAttr(id->leafTupdesc, attnum - 1);
+		if (att->attlen <= 0 || att->atttypid != var->vartype)
+			continue;
+
+		if (ostate->nFilters == 0)
+			ostate->filters = (OScanFilter *) palloc(sizeof(OScanFilter) *
+													 list_length(qual));
+		filter = &ostate->filters[ostate->nFilters++];
+		filter->attnum = attnum;
+		filter->varOnLeft = ((Node *) var == left);
+		filter->value = cnst->constvalue;
+		filter->collation = op->inputcollid;
+		fmgr_info(op->opfuncid, &filter->finfo);
+	}
+}
+
+/*
+ * Applies the filters to the fetched batch.  Each filter is evaluated over
+ * all the remaining tuples of the batch before the next one, and the
+ * rejected tuples are freed.
+ */
+static void
+o_index_scan_filter_batch(OScanState *ostate, OIndexDescr *id)
+{
+	int			i;
+
+	for (i = 0; i < ostate->nFilters && ostate->batchCount > 0; i++)
+	{
+		OScanFilter *filter = &ostate->filters[i];
+		int			j,
+					n = 0;
+
+		for (j = 0; j < ostate->batchCount; j++)
+		{
+			OTuple		tup = ostate->batchTuples[j];
+			bool		isnull;
+			bool		pass = false;
+			Datum		value;
+
+			value = o_fastgetattr(tup, filter->attnum, id->leafTupdesc,
+								  &id->leafSpec, &isnull);
+			if (!isnull)
+			{
+				if (filter->varOnLeft)
+					pass = DatumGetBool(FunctionCall2Coll(&filter->finfo,
+														  filter->collation,
+														  value,
+														  filter->value));
+				else
+					pass = DatumGetBool(FunctionCall2Coll(&filter->finfo,
+														  filter->collation,
+														  filter->value,
+														  value));
+			}
+
+			if (pass)
+			{
+				ostate->batchTuples[n] = tup;
+				ostate->batchCsns[n] = ostate->batchCsns[j];
+				n++;
+			}
+			else
+				pfree(tup.data);
+		}
+		ostate->batchCount = n;
+	}
+}
+
+/*
+ * Returns the maximum number of tuples to fetch at once.  That's fewer than
+ * the buffer size if the row bound is known to be close.
+ */
+static inline int
+o_index_scan_max_fetch(OScanState *ostate, int bufferSize)
+{
+	int64		remaining;
+
+	if (ostate->rowBound <= 0)
+		return bufferSize;
+
+	remaining = ostate->rowBound - ostate->rowsReturned;
+	if (remaining >= bufferSize)
+		return bufferSize;
+	return Max(remaining, 1);
+}
+
+/*
+ * Returns the next tuple from the iterator.  Tuples are fetched from the
+ * iterator by batches, each containing tuples of the single leaf page.
+ */
+static OTuple
+o_iterate_index_batch(OIndexDescr *id, OScanState *ostate,
+					  OBTreeKeyBound *bound, CommitSeqNo *tupleCsn,
+					  MemoryContext tupleCxt, BTreeLocationHint *hint)
+{
+	OTuple		tup;
+	int			maxTuples = o_index_scan_max_fetch(ostate, O_SCAN_BATCH_SIZE);
+
+	while (ostate->batchIndex >= ostate->batchCount)
+	{
+		ostate->batchIndex = 0;
+		if (ostate->parallelChunks)
+			ostate->batchCount = o_parallel_index_scan_fetch_batch(id, ostate,
+																   bound,
+																   tupleCxt);
+		else
+			ostate->batchCount = o_btree_iterator_fetch_batch(ostate->iterator,
+															  ostate->batchTuples,
+															  ostate->batchCsns,
+															  maxTuples,
+															  bound, BTreeKeyBound,
+															  true,
+															  &ostate->batchHint);
+		if (ostate->batchCount == 0)
+		{
+			O_TUPLE_SET_NULL(tup);
+			return tup;
+		}
+
+		if (ostate->nFilters > 0)
+			o_index_scan_filter_batch(ostate, id);
+	}
+
+	tup = ostate->batchTuples[ostate->batchIndex];
+	if (tupleCsn)
+		*tupleCsn = ostate->batchCsns[ostate->batchIndex];
+	if (hint)
+		*hint = ostate->batchHint;
+	ostate->batchIndex++;
+	return tup;
+}
+
 OTuple
 o_iterate_index(OIndexDescr *indexDescr, OScanState *ostate,
 				CommitSeqNo *tupleCsn, MemoryContext tupleCxt,
@@ -377,16 +937,15 @@ o_iterate_index(OIndexDescr *indexDescr, OScanState *ostate,
 			if (!O_TUPLE_IS_NULL(tup))
 				tup_fetched = true;
 		}
-		else if (ostate->iterator)
+		else if (ostate->iterator || ostate->parallelChunks)
 		{
 			bound = (ostate->scanDir == ForwardScanDirection
 					 ? &ostate->curKeyRange.high : &ostate->curKeyRange.low);
 
 			do
 			{
-				tup = o_btree_iterator_fetch(ostate->iterator, tupleCsn,
-											 bound, BTreeKeyBound,
-											 true, hint);
+				tup = o_iterate_index_batch(indexDescr, ostate, bound,
+											tupleCsn, tupleCxt, hint);
 
 				if (O_TUPLE_IS_NULL(tup))
 					tup_is_valid = true;
@@ -398,6 +957,8 @@ o_iterate_index(OIndexDescr *indexDescr, OScanState *ostate,
 												  ostate->numPrefixExactKeys);
 					if (tup_is_valid)
 						tup_fetched = true;
+					else if (ostate->skipScan)
+						o_index_scan_skip(indexDescr, ostate, tup, tupleCxt);
 				}
 			} while (!tup_is_valid);
 		}
@@ -417,6 +978,102 @@ o_iterate_index(OIndexDescr *indexDescr, OScanState *ostate,
 	return tup;
 }
 
+typedef struct
+{
+	OIndexDescr *secondary;
+	OIndexDescr *primary;
+} OPkBatchSortArg;
+
+/*
+ * Compares the secondary index tuples by their primary keys.
+ */
+static int
+o_pk_batch_cmp(const void *a, const void *b, void *arg)
+{
+	OPkBatchSortArg *sortArg = (OPkBatchSortArg *) arg;
+	OBTreeKeyBound bound1,
+				bound2;
+
+	o_fill_pindex_tuple_key_bound(&sortArg->secondary->desc, *((OTuple *) a),
+								  &bound1);
+	o_fill_pindex_tuple_key_bound(&sortArg->secondary->desc, *((OTuple *) b),
+								  &bound2);
+	return o_btree_cmp(&sortArg->primary->desc, &bound1, BTreeKeyBound,
+					   &bound2, BTreeKeyBound);
+}
+
+/*
+ * Returns the next primary index tuple for the secondary index scan, whose
+ * consumer doesn't need the index order.  Secondary index tuples are
+ * buffered and sorted by the primary key, so the lookups go in the primary
+ * key order.  Thus, subsequent lookups mostly hit the leaf remembered by the
+ * finger, and the evicted leaves are read in their order.
+ */
+static OTuple
+o_index_scan_getnext_sorted(OTableDescr *descr, OScanState *ostate,
+							CommitSeqNo *tupleCsn, MemoryContext tupleCxt,
+							BTreeLocationHint *hint)
+{
+	OIndexDescr *id = descr->indices[ostate->ixNum];
+	OIndexDescr *primary = GET_PRIMARY(descr);
+	OTuple		tup;
+
+	while (true)
+	{
+		OBTreeKeyBound bound;
+		OTuple		ptup;
+
+		if (ostate->pkBatchIndex >= ostate->pkBatchCount)
+		{
+			OPkBatchSortArg sortArg;
+			int			maxCount = o_index_scan_max_fetch(ostate,
+														  O_SCAN_PK_BATCH_SIZE);
+
+			ostate->pkBatchCount = 0;
+			ostate->pkBatchIndex = 0;
+			o_btree_load_shmem(&id->desc);
+			while (ostate->pkBatchCount < maxCount)
+			{
+				tup = o_iterate_index(id, ostate, NULL, tupleCxt, NULL);
+				if (O_TUPLE_IS_NULL(tup))
+					break;
+				ostate->pkBatchTuples[ostate->pkBatchCount++] = tup;
+			}
+
+			if (ostate->pkBatchCount == 0)
+			{
+				O_TUPLE_SET_NULL(tup);
+				return tup;
+			}
+
+			sortArg.secondary = id;
+			sortArg.primary = primary;
+			qsort_arg(ostate->pkBatchTuples, ostate->pkBatchCount,
+					  sizeof(OTuple), o_pk_batch_cmp, &sortArg);
+		}
+
+		tup = ostate->pkBatchTuples[ostate->pkBatchIndex++];
+		o_fill_pindex_tuple_key_bound(&id->desc, tup, &bound);
+
+		if (hint)
+		{
+			hint->blkno = InvalidBlockNumber;
+			hint->pageChangeCount = 0;
+		}
+
+		o_btree_load_shmem(&primary->desc);
+		ptup = o_btree_find_tuple_by_key(&primary->desc,
+										 (Pointer) &bound, BTreeKeyBound,
+										 &ostate->oSnapshot, tupleCsn,
+										 tupleCxt, hint);
+		pfree(tup.data);
+
+		/* skip tuples deleted or updated concurrently */
+		if (!O_TUPLE_IS_NULL(ptup))
+			return ptup;
+	}
+}
+
 OTuple
 o_index_scan_getnext(OTableDescr *descr, OScanState *ostate,
 					 CommitSeqNo *tupleCsn, bool scan_primary,
@@ -444,6 +1101,11 @@ o_index_scan_getnext(OTableDescr *descr, OScanState *ostate,
 		ostate->curKeyRange.empty = true;
 	}
 
+	if (ostate->sortedPkFetch && scan_primary &&
+		ostate->ixNum != PrimaryIndexNumber)
+		return o_index_scan_getnext_sorted(descr, ostate, tupleCsn, tupleCxt,
+										   hint);
+
 	o_btree_load_shmem(&id->desc);
 	while (true)
 	{
@@ -492,6 +1154,23 @@ o_index_scan_getnext(OTableDescr *descr, OScanState *ostate,
 	return tup;
 }
 
+/*
+ * Returns the context for the tuples fetched into the scan slot.  Those are
+ * allocated a batch at a time and freed in the same order once the slot is
+ * cleared, which suits the generation context better than the slot's
+ * allocation set: no per-chunk free lists, and the blocks are released as
+ * soon as the batches they hold are consumed.
+ */
+static MemoryContext
+o_scan_tuple_cxt(OScanState *ostate, TupleTableSlot *slot)
+{
+	if (ostate->tupleCxt == NULL)
+		ostate->tupleCxt = GenerationContextCreate(slot->tts_mcxt,
+												   "orioledb scan tuples",
+												   ALLOCSET_DEFAULT_SIZES);
+	return ostate->tupleCxt;
+}
+
 /* fetches next tuple for oIterateDirectModify */
 TupleTableSlot *
 o_exec_fetch(OScanState *ostate, ScanState *ss)
@@ -501,7 +1180,7 @@ o_exec_fetch(OScanState *ostate, ScanState *ss)
 	OTuple		tuple;
 	bool		scan_primary = ostate->ixNum == PrimaryIndexNumber ||
 		!ostate->onlyCurIx;
-	MemoryContext tupleCxt = ss->ss_ScanTupleSlot->tts_mcxt;
+	MemoryContext tupleCxt = o_scan_tuple_cxt(ostate, ss->ss_ScanTupleSlot);
 
 	do
 	{
@@ -529,6 +1208,9 @@ o_exec_fetch(OScanState *ostate, ScanState *ss)
 			 !o_exec_qual(ss->ps.ps_ExprContext,
 						  ss->ps.qual, slot));
 
+	if (!TupIsNull(slot))
+		ostate->rowsReturned++;
+
 	return slot;
 }
 
@@ -581,8 +1263,10 @@ eanalyze_counter_explain(OEACallsCounter *counter, char *label,
 {
 	StringInfoData explain;
 	char	   *fnames[EA_COUNTERS_NUM] = {"read", "lock", "evict",
-	"write", "load"};
-	uint32		counts[EA_COUNTERS_NUM],
+		"write", "load", "retry", "descent", "wait", "s3load", "undo",
+	"decompressed"};
+	uint64		counts[EA_COUNTERS_NUM];
+	int			ncounts,
 				i;
 	bool		is_first,
 				is_null;
@@ -595,9 +1279,18 @@ eanalyze_counter_explain(OEACallsCounter *counter, char *label,
 	counts[2] = counter->evict;
 	counts[3] = counter->write;
 	counts[4] = counter->load;
+	counts[5] = counter->retry;
+	counts[6] = counter->descent;
+	counts[7] = counter->wait;
+	counts[8] = counter->s3load;
+	counts[9] = counter->undo;
+	counts[10] = counter->decompressed;
+
+	/* btree internals are shown in verbose mode only */
+	ncounts = es->verbose ? EA_COUNTERS_NUM : EA_BASIC_COUNTERS_NUM;
 
 	is_null = true;
-	for (i = 0; i < EA_COUNTERS_NUM; i++)
+	for (i = 0; i < ncounts; i++)
 		if (counts[i] > 0)
 			is_null = false;
 
@@ -633,7 +1326,7 @@ eanalyze_counter_explain(OEACallsCounter *counter, char *label,
 	}
 
 	is_first = true;
-	for (i = 0; i < EA_COUNTERS_NUM; i++)
+	for (i = 0; i < ncounts; i++)
 	{
 		if (counts[i] > 0)
 		{
@@ -644,7 +1337,8 @@ eanalyze_counter_explain(OEACallsCounter *counter, char *label,
 						appendStringInfo(&explain, ", ");
 					else
 						initStringInfo(&explain);
-					appendStringInfo(&explain, "%s=%d", fnames[i], counts[i]);
+					appendStringInfo(&explain, "%s=" UINT64_FORMAT,
+									 fnames[i], counts[i]);
 					break;
 				case EXPLAIN_FORMAT_JSON:
 				case EXPLAIN_FORMAT_XML:
@@ -7,495 +7,1097 @@
  *
  * IDENTIFICATION
  *	  contrib/orioledb/src/tableam/key_bitmap.c
+ *
+ * NOTES
+ *
+ *		Key bitmap is a roaring-style compressed bitmap of uint64 keys.  The
+ *		high 48 bits of the key select a container, containers are kept in an
+ *		array sorted by them.  Each container holds the low 16 bits of its keys
+ *		either as a sorted array, as a plain bitmap or as a sorted array of
+ *		runs, whichever takes less memory.
+ *
+ *		Inserted keys are accumulated in the pending buffer, which is sorted
+ *		and merged into the containers in batches.  So, inserts in random
+ *		order don't need to shift the container array.
+ *
+ *		When the bitmap exceeds its memory limit, containers are replaced with
+ *		single runs covering all their keys, marked for recheck.  The scan
+ *		then rechecks the original quals for those keys.
+ *
  *-------------------------------------------------------------------------
  */
 #include "postgres.h"
 
 #include "orioledb.h"
 
-#include "btree/io.h"
-#include "btree/iterator.h"
-#include "btree/page_chunks.h"
 #include "tableam/bitmap_scan.h"
-#include "tableam/index_scan.h"
-#include "tuple/slot.h"
 
-#include "lib/rbtree.h"
+#include "port/pg_bitutils.h"
+#include "utils/memutils.h"
+
+#define KB_CONTAINER_SHIFT		16
+#define KB_CONTAINER_SIZE		(1 << KB_CONTAINER_SHIFT)
+#define KB_HIGH(value)			((value) >> KB_CONTAINER_SHIFT)
+#define KB_LOW(value)			((int) ((value) & (KB_CONTAINER_SIZE - 1)))
+#define KB_MAKE_VALUE(high, low) (((high) << KB_CONTAINER_SHIFT) | (uint64) (low))
 
-static int	bm_rbt_comparator(const RBTNode *a, const RBTNode *b, void *arg);
-static void bm_rbt_combiner(RBTNode *existing, const RBTNode *newdata, void *arg);
-static RBTNode *bm_rbt_allocfunc(void *arg);
-static void bm_rbt_freefunc(RBTNode *x, void *arg);
+/* Array containers are converted to bitmaps above this cardinality */
+#define KB_ARRAY_MAX_CARD		4096
+#define KB_BITMAP_WORDS			(KB_CONTAINER_SIZE / 64)
+#define KB_BITMAP_BYTES			(KB_BITMAP_WORDS * sizeof(uint64))
 
-#define HIGH_PART_MASK	(0xFFFFFFFFFFFFFC00)
-#define LOW_PART_MASK	(0x00000000000003FF)
-#define BITMAP_SIZE		0x80
+#define KB_PENDING_MIN			1024
+#define KB_PENDING_MAX			65536
+
+typedef enum
+{
+	KBContainerArray,
+	KBContainerBitmap,
+	KBContainerRun
+} KBContainerType;
 
 typedef struct
 {
-	RBTNode		rbtnode;
-	uint64		key;
-	uint8	   *bitmap;
-} OKeyBitmapRBTNode;
+	uint16		start;
+	uint16		last;			/* inclusive */
+} KBRun;
 
-RBTree *
-o_keybitmap_create(void)
+typedef struct
+{
+	uint64		high;
+	KBContainerType type;
+	bool		recheck;		/* keys of container must be rechecked */
+	int			card;			/* number of keys */
+	int			n;				/* number of array items or runs */
+	int			capacity;		/* allocated array items or runs */
+	void	   *data;
+} KBContainer;
+
+struct OKeyBitmap
+{
+	MemoryContext cxt;
+	KBContainer *containers;
+	int			ncontainers;
+	int			lastIndex;		/* last container found, for sequential
+								 * lookups */
+	uint64	   *pending;
+	int			npending;
+	int			maxpending;
+	Size		memUsed;		/* memory used by containers data */
+	Size		maxMem;
+};
+
+/* Serialized container, its data follows the array of headers */
+typedef struct
 {
-	return rbt_create(sizeof(OKeyBitmapRBTNode),
-					  bm_rbt_comparator,
-					  bm_rbt_combiner,
-					  bm_rbt_allocfunc,
-					  bm_rbt_freefunc,
-					  NULL);
+	uint64		high;
+	Size		offset;
+	KBContainerType type;
+	bool		recheck;
+	int			card;
+	int			n;
+} KBSerializedContainer;
+
+OKeyBitmap *
+o_keybitmap_create(Size maxMem)
+{
+	OKeyBitmap *bitmap = palloc0(sizeof(OKeyBitmap));
+
+	bitmap->cxt = CurrentMemoryContext;
+	bitmap->maxpending = KB_PENDING_MIN;
+	bitmap->pending = palloc(sizeof(uint64) * bitmap->maxpending);
+	bitmap->maxMem = maxMem;
+	return bitmap;
 }
 
-void
-o_keybitmap_insert(RBTree *rbtree, uint64 value)
+static Size
+kb_container_memory(KBContainer *c)
 {
-	OKeyBitmapRBTNode node;
-	bool		is_new;
+	switch (c->type)
+	{
+		case KBContainerArray:
+			return c->capacity * sizeof(uint16);
+		case KBContainerBitmap:
+			return KB_BITMAP_BYTES;
+		case KBContainerRun:
+			return c->capacity * sizeof(KBRun);
+	}
+	return 0;
+}
 
-	node.key = value;
-	node.bitmap = NULL;
-	(void) rbt_insert(rbtree, &node.rbtnode, &is_new);
+static Size
+kb_container_data_size(KBContainer *c)
+{
+	switch (c->type)
+	{
+		case KBContainerArray:
+			return c->n * sizeof(uint16);
+		case KBContainerBitmap:
+			return KB_BITMAP_BYTES;
+		case KBContainerRun:
+			return c->n * sizeof(KBRun);
+	}
+	return 0;
 }
 
-bool
-o_keybitmap_test(RBTree *rbtree, uint64 value)
+static inline Size
+kb_memory_used(OKeyBitmap *bitmap)
 {
-	OKeyBitmapRBTNode node;
-	OKeyBitmapRBTNode *found;
+	return bitmap->memUsed + bitmap->ncontainers * sizeof(KBContainer);
+}
 
-	node.key = value;
-	node.bitmap = NULL;
-	found = (OKeyBitmapRBTNode *) rbt_find(rbtree, &node.rbtnode);
-	if (!found)
-		return false;
+/*
+ * Returns the position of the first bit, which is set (or not set) at the
+ * given offset or after it.  Returns -1 if there is no such bit.
+ */
+static int
+kb_bitmap_next(const uint64 *words, int from, bool set)
+{
+	int			i = from >> 6;
+	uint64		word;
+
+	if (from >= KB_CONTAINER_SIZE)
+		return -1;
 
-	if (found->bitmap)
+	word = set ? words[i] : ~words[i];
+	word &= ~UINT64CONST(0) << (from & 63);
+	while (true)
 	{
-		int			offset = (value & LOW_PART_MASK);
+		if (word)
+			return (i << 6) + pg_rightmost_one_pos64(word);
+		if (++i >= KB_BITMAP_WORDS)
+			return -1;
+		word = set ? words[i] : ~words[i];
+	}
+}
 
-		if (found->bitmap[offset >> 3] & (1 << (offset & 7)))
-			return true;
-		else
-			return false;
+static void
+kb_bitmap_set_range(uint64 *words, int start, int last)
+{
+	int			firstWord = start >> 6,
+				lastWord = last >> 6,
+				i;
+	uint64		firstMask = ~UINT64CONST(0) << (start & 63),
+				lastMask = ~UINT64CONST(0) >> (63 - (last & 63));
+
+	if (firstWord == lastWord)
+	{
+		words[firstWord] |= firstMask & lastMask;
+		return;
+	}
+
+	words[firstWord] |= firstMask;
+	for (i = firstWord + 1; i < lastWord; i++)
+		words[i] = ~UINT64CONST(0);
+	words[lastWord] |= lastMask;
+}
+
+static void
+kb_container_fill_bitmap(KBContainer *c, uint64 *words)
+{
+	int			i;
+
+	memset(words, 0, KB_BITMAP_BYTES);
+	if (c->type == KBContainerArray)
+	{
+		uint16	   *values = (uint16 *) c->data;
+
+		for (i = 0; i < c->n; i++)
+			words[values[i] >> 6] |= UINT64CONST(1) << (values[i] & 63);
+	}
+	else if (c->type == KBContainerRun)
+	{
+		KBRun	   *runs = (KBRun *) c->data;
+
+		for (i = 0; i < c->n; i++)
+			kb_bitmap_set_range(words, runs[i].start, runs[i].last);
 	}
 	else
 	{
-		return (found->key == value);
+		memcpy(words, c->data, KB_BITMAP_BYTES);
 	}
 }
 
-bool
-o_keybitmap_range_is_valid(RBTree *rbtree, uint64 low, uint64 high)
+static void
+kb_container_set_data(KBContainer *c, KBContainerType type, void *data,
+					  int n, int capacity)
+{
+	if (c->data)
+		pfree(c->data);
+	c->type = type;
+	c->data = data;
+	c->n = n;
+	c->capacity = capacity;
+}
+
+static void
+kb_container_to_bitmap(OKeyBitmap *bitmap, KBContainer *c)
+{
+	uint64	   *words;
+
+	if (c->type == KBContainerBitmap)
+		return;
+
+	words = MemoryContextAlloc(bitmap->cxt, KB_BITMAP_BYTES);
+	kb_container_fill_bitmap(c, words);
+	kb_container_set_data(c, KBContainerBitmap, words, 0, 0);
+}
+
+static int
+kb_container_count_runs(KBContainer *c)
 {
-	OKeyBitmapRBTNode lowNode;
-	OKeyBitmapRBTNode *node;
 	int			i,
-				iStart,
-				iEnd;
-	uint8		startMask,
-				endMask;
-	bool		valid = false;
-	bool		first = true;
+				nruns = 0;
 
-	while (!valid && ((low & HIGH_PART_MASK) <= (high & HIGH_PART_MASK)))
+	if (c->type == KBContainerArray)
 	{
-		bool		skip_step = false;
-
-		lowNode.key = low;
-		lowNode.bitmap = NULL;
+		uint16	   *values = (uint16 *) c->data;
 
-		node = (OKeyBitmapRBTNode *) rbt_find_great(rbtree,
-													&lowNode.rbtnode,
-													true);
-		if (!node)
-			break;
+		for (i = 0; i < c->n; i++)
+		{
+			if (i == 0 || values[i] != values[i - 1] + 1)
+				nruns++;
+		}
+	}
+	else if (c->type == KBContainerRun)
+	{
+		nruns = c->n;
+	}
+	else
+	{
+		uint64	   *words = (uint64 *) c->data;
+		uint64		carry = 0;
 
-		if (!node->bitmap)
+		/* Count the set bits, which don't follow another set bit */
+		for (i = 0; i < KB_BITMAP_WORDS; i++)
 		{
-			if (node->key >= low && node->key < high)
-				valid = true;
-			skip_step = true;
+			nruns += pg_popcount64(words[i] & ~((words[i] << 1) | carry));
+			carry = words[i] >> 63;
 		}
+	}
+	return nruns;
+}
+
+/*
+ * Converts the container to the representation, which takes least memory.
+ */
+static void
+kb_container_optimize(OKeyBitmap *bitmap, KBContainer *c)
+{
+	Size		arraySize,
+				runSize;
+	int			nruns;
+	KBContainerType type;
+
+	nruns = kb_container_count_runs(c);
+	runSize = nruns * sizeof(KBRun);
+	arraySize = c->card <= KB_ARRAY_MAX_CARD ? c->card * sizeof(uint16) :
+		KB_BITMAP_BYTES + 1;
+
+	if (runSize < arraySize && runSize < KB_BITMAP_BYTES)
+		type = KBContainerRun;
+	else if (arraySize <= KB_BITMAP_BYTES)
+		type = KBContainerArray;
+	else
+		type = KBContainerBitmap;
+
+	if (type == c->type)
+		return;
+
+	if (type == KBContainerBitmap)
+	{
+		kb_container_to_bitmap(bitmap, c);
+	}
+	else if (type == KBContainerArray)
+	{
+		uint16	   *values = MemoryContextAlloc(bitmap->cxt,
+												Max(c->card, 1) * sizeof(uint16));
+		int			n = 0;
 
-		if (!skip_step)
+		if (c->type == KBContainerRun)
 		{
-			if ((low & HIGH_PART_MASK) == (node->key & HIGH_PART_MASK))
+			KBRun	   *runs = (KBRun *) c->data;
+			int			i,
+						value;
+
+			for (i = 0; i < c->n; i++)
+				for (value = runs[i].start; value <= runs[i].last; value++)
+					values[n++] = value;
+		}
+		else
+		{
+			uint64	   *words = (uint64 *) c->data;
+			int			i;
+
+			for (i = 0; i < KB_BITMAP_WORDS; i++)
 			{
-				iStart = (low & LOW_PART_MASK) >> 3;
-				startMask = 0xFF << ((low & LOW_PART_MASK) & 7);
+				uint64		word = words[i];
+
+				while (word)
+				{
+					values[n++] = (i << 6) + pg_rightmost_one_pos64(word);
+					word &= word - 1;
+				}
 			}
-			else
+		}
+		Assert(n == c->card);
+		kb_container_set_data(c, KBContainerArray, values, n, Max(c->card, 1));
+	}
+	else
+	{
+		KBRun	   *runs = MemoryContextAlloc(bitmap->cxt,
+											  Max(nruns, 1) * sizeof(KBRun));
+		int			n = 0;
+
+		if (c->type == KBContainerArray)
+		{
+			uint16	   *values = (uint16 *) c->data;
+			int			i;
+
+			for (i = 0; i < c->n; i++)
 			{
-				iStart = 0;
-				startMask = 0xFF;
+				if (n > 0 && values[i] == runs[n - 1].last + 1)
+				{
+					runs[n - 1].last = values[i];
+				}
+				else
+				{
+					runs[n].start = runs[n].last = values[i];
+					n++;
+				}
 			}
+		}
+		else
+		{
+			uint64	   *words = (uint64 *) c->data;
+			int			start = kb_bitmap_next(words, 0, true);
 
-			if ((high & HIGH_PART_MASK) == (node->key & HIGH_PART_MASK))
+			while (start >= 0)
 			{
-				iEnd = ((high - 1) & LOW_PART_MASK) >> 3;
-				endMask = 0xFF >> (7 - (((high - 1) & LOW_PART_MASK) & 7));
+				int			end = kb_bitmap_next(words, start, false);
+
+				if (end < 0)
+					end = KB_CONTAINER_SIZE;
+				runs[n].start = start;
+				runs[n].last = end - 1;
+				n++;
+				start = kb_bitmap_next(words, end, true);
 			}
+		}
+		Assert(n == nruns);
+		kb_container_set_data(c, KBContainerRun, runs, n, Max(nruns, 1));
+	}
+}
+
+/*
+ * Adds sorted unique values to the container.
+ */
+static void
+kb_container_add(OKeyBitmap *bitmap, KBContainer *c,
+				 const uint16 *values, int nvalues)
+{
+	int			i;
+
+	if (c->type == KBContainerArray && c->card + nvalues <= KB_ARRAY_MAX_CARD)
+	{
+		uint16	   *old = (uint16 *) c->data;
+		uint16	   *merged;
+		int			j = 0,
+					n = 0;
+
+		merged = MemoryContextAlloc(bitmap->cxt,
+									(c->n + nvalues) * sizeof(uint16));
+		i = 0;
+		while (i < c->n || j < nvalues)
+		{
+			if (j >= nvalues || (i < c->n && old[i] < values[j]))
+				merged[n++] = old[i++];
+			else if (i >= c->n || values[j] < old[i])
+				merged[n++] = values[j++];
 			else
 			{
-				iEnd = BITMAP_SIZE - 1;
-				endMask = 0xFF;
+				merged[n++] = old[i++];
+				j++;
 			}
-			for (i = iStart; i <= iEnd; i++)
-			{
-				uint8		mask;
+		}
+		kb_container_set_data(c, KBContainerArray, merged, n, c->n + nvalues);
+		c->card = n;
+	}
+	else
+	{
+		uint64	   *words;
 
-				mask = (i == iStart) ? startMask : 0xFF;
-				if (i == iEnd)
-					mask &= endMask;
+		kb_container_to_bitmap(bitmap, c);
+		words = (uint64 *) c->data;
+		for (i = 0; i < nvalues; i++)
+		{
+			uint64		mask = UINT64CONST(1) << (values[i] & 63);
 
-				if (node->bitmap[i] & mask)
-					valid = true;
+			if (!(words[values[i] >> 6] & mask))
+			{
+				words[values[i] >> 6] |= mask;
+				c->card++;
 			}
 		}
-		if (!valid)
+	}
+	kb_container_optimize(bitmap, c);
+}
+
+static bool
+kb_container_contains(KBContainer *c, int low)
+{
+	int			lo = 0,
+				hi = c->n - 1;
+
+	if (c->type == KBContainerBitmap)
+		return (((uint64 *) c->data)[low >> 6] >> (low & 63)) & 1;
+
+	while (lo <= hi)
+	{
+		int			mid = (lo + hi) / 2;
+
+		if (c->type == KBContainerArray)
+		{
+			int			value = ((uint16 *) c->data)[mid];
+
+			if (value == low)
+				return true;
+			else if (value < low)
+				lo = mid + 1;
+			else
+				hi = mid - 1;
+		}
+		else
 		{
-			low = node->key;
-			if (!first)
-				low += (1L << 10);
+			KBRun	   *run = &((KBRun *) c->data)[mid];
+
+			if (low < run->start)
+				hi = mid - 1;
+			else if (low > run->last)
+				lo = mid + 1;
+			else
+				return true;
 		}
-		first = false;
 	}
+	return false;
+}
 
-	return valid;
+/*
+ * Returns the first value of the container, which is greater or equal to the
+ * given one.  Returns -1 if there is no such value.
+ */
+static int
+kb_container_next(KBContainer *c, int low)
+{
+	int			lo = 0,
+				hi = c->n;
+
+	if (c->type == KBContainerBitmap)
+		return kb_bitmap_next((uint64 *) c->data, low, true);
+
+	/* Find the first array item or run, which isn't less than low */
+	while (lo < hi)
+	{
+		int			mid = (lo + hi) / 2;
+		int			value;
+
+		if (c->type == KBContainerArray)
+			value = ((uint16 *) c->data)[mid];
+		else
+			value = ((KBRun *) c->data)[mid].last;
+
+		if (value < low)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo >= c->n)
+		return -1;
+	if (c->type == KBContainerArray)
+		return ((uint16 *) c->data)[lo];
+	else
+		return Max(((KBRun *) c->data)[lo].start, low);
 }
 
 static int
-find_next_offset(uint8 *bitmap, int minOffset)
+kb_container_last(KBContainer *c)
 {
-	int			i;
-	uint8		mask;
+	Assert(c->card > 0);
 
-	i = minOffset >> 3;
-	mask = 0xFF << (minOffset & 7);
-	while (i < BITMAP_SIZE)
+	if (c->type == KBContainerArray)
+		return ((uint16 *) c->data)[c->n - 1];
+	else if (c->type == KBContainerRun)
+		return ((KBRun *) c->data)[c->n - 1].last;
+	else
 	{
-		mask &= bitmap[i];
-		if (mask)
-		{
-			int			result;
+		uint64	   *words = (uint64 *) c->data;
+		int			i;
 
-			result = i << 3;
-			while (!(mask & 1))
-			{
-				result++;
-				mask >>= 1;
-			}
-			return result;
+		for (i = KB_BITMAP_WORDS - 1; i >= 0; i--)
+		{
+			if (words[i])
+				return (i << 6) + pg_leftmost_one_pos64(words[i]);
 		}
-		mask = 0xFF;
-		i++;
 	}
+	Assert(false);
 	return -1;
 }
 
+static void
+kb_container_copy(OKeyBitmap *bitmap, KBContainer *dst, KBContainer *src)
+{
+	Size		size = kb_container_data_size(src);
 
-uint64
-o_keybitmap_get_next(RBTree *rbtree, uint64 prev, bool *found)
+	*dst = *src;
+	dst->data = MemoryContextAlloc(bitmap->cxt, Max(size, 1));
+	memcpy(dst->data, src->data, size);
+	if (dst->type != KBContainerBitmap)
+		dst->capacity = dst->n;
+}
+
+/*
+ * Intersects the container a with the container b in place.
+ */
+static void
+kb_container_and(OKeyBitmap *bitmap, KBContainer *a, KBContainer *b)
 {
-	OKeyBitmapRBTNode lowNode;
-	OKeyBitmapRBTNode *node;
-	RBTreeIterator iter;
+	int			i,
+				n = 0;
 
-	lowNode.key = prev;
-	lowNode.bitmap = NULL;
-	node = (OKeyBitmapRBTNode *) rbt_find_great(rbtree,
-												&lowNode.rbtnode,
-												true);
-	if (!node)
-	{
-		*found = false;
-		return 0;
-	}
+	a->recheck = a->recheck || b->recheck;
 
-	if (!node->bitmap)
+	if (a->type == KBContainerArray)
 	{
-		if (node->key >= prev)
+		uint16	   *values = (uint16 *) a->data;
+
+		for (i = 0; i < a->n; i++)
 		{
-			*found = true;
-			return node->key;
+			if (kb_container_contains(b, values[i]))
+				values[n++] = values[i];
 		}
+		a->n = a->card = n;
 	}
-	else if ((prev & HIGH_PART_MASK) == (node->key & HIGH_PART_MASK))
+	else if (b->type == KBContainerArray)
 	{
-		int			nextOffset;
-
-		nextOffset = find_next_offset(node->bitmap, prev & LOW_PART_MASK);
+		uint16	   *bvalues = (uint16 *) b->data;
+		uint16	   *values;
 
-		if (nextOffset >= 0)
+		values = MemoryContextAlloc(bitmap->cxt, b->n * sizeof(uint16));
+		for (i = 0; i < b->n; i++)
 		{
-			*found = true;
-			return node->key + nextOffset;
+			if (kb_container_contains(a, bvalues[i]))
+				values[n++] = bvalues[i];
 		}
+		kb_container_set_data(a, KBContainerArray, values, n, b->n);
+		a->card = n;
 	}
-
-	if ((prev & HIGH_PART_MASK) == (node->key & HIGH_PART_MASK))
+	else
 	{
-		rbt_begin_iterate(rbtree, LeftRightWalk, &iter);
-		iter.last_visited = (RBTNode *) node;
-		node = (OKeyBitmapRBTNode *) rbt_iterate(&iter);
+		uint64	   *awords,
+				   *bwords,
+					tmp[KB_BITMAP_WORDS];
+
+		kb_container_to_bitmap(bitmap, a);
+		awords = (uint64 *) a->data;
+		if (b->type == KBContainerBitmap)
+		{
+			bwords = (uint64 *) b->data;
+		}
+		else
+		{
+			kb_container_fill_bitmap(b, tmp);
+			bwords = tmp;
+		}
+
+		/* Simple word loops get vectorized by the compiler */
+		for (i = 0; i < KB_BITMAP_WORDS; i++)
+			awords[i] &= bwords[i];
+		a->card = pg_popcount((char *) awords, KB_BITMAP_BYTES);
 	}
 
-	if (!node)
+	if (a->card > 0)
+		kb_container_optimize(bitmap, a);
+}
+
+/*
+ * Unites the container a with the container b in place.
+ */
+static void
+kb_container_or(OKeyBitmap *bitmap, KBContainer *a, KBContainer *b)
+{
+	uint64	   *awords;
+	int			i;
+
+	a->recheck = a->recheck || b->recheck;
+
+	if (b->type == KBContainerArray)
 	{
-		*found = false;
-		return 0;
+		kb_container_add(bitmap, a, (uint16 *) b->data, b->n);
+		return;
 	}
 
-	if (!node->bitmap)
+	kb_container_to_bitmap(bitmap, a);
+	awords = (uint64 *) a->data;
+	if (b->type == KBContainerBitmap)
 	{
-		*found = true;
-		return node->key;
+		uint64	   *bwords = (uint64 *) b->data;
+
+		for (i = 0; i < KB_BITMAP_WORDS; i++)
+			awords[i] |= bwords[i];
 	}
 	else
 	{
-		int			nextOffset = find_next_offset(node->bitmap, 0);
+		KBRun	   *runs = (KBRun *) b->data;
 
-		Assert(nextOffset >= 0);
-		*found = true;
-		return node->key + nextOffset;
+		for (i = 0; i < b->n; i++)
+			kb_bitmap_set_range(awords, runs[i].start, runs[i].last);
 	}
+	a->card = pg_popcount((char *) awords, KB_BITMAP_BYTES);
+	kb_container_optimize(bitmap, a);
 }
 
+/*
+ * Replaces containers with single runs covering all their keys until the
+ * bitmap fits into half of the memory limit, so that we don't have to do it
+ * again soon.  Keys of such containers are marked for recheck.
+ */
 static void
-free_tree_node(RBTNode *node)
+kb_lossify(OKeyBitmap *bitmap)
 {
-	OKeyBitmapRBTNode *keyNode = (OKeyBitmapRBTNode *) node;
+	int			i;
 
-	if (node->left == node)
-	{
-		Assert(node->right == node);
+	if (kb_memory_used(bitmap) <= bitmap->maxMem)
 		return;
+
+	for (i = 0; i < bitmap->ncontainers; i++)
+	{
+		KBContainer *c = &bitmap->containers[i];
+		KBRun	   *run;
+
+		if (kb_memory_used(bitmap) <= bitmap->maxMem / 2)
+			break;
+		if (c->type == KBContainerRun && c->n == 1)
+			continue;
+
+		run = MemoryContextAlloc(bitmap->cxt, sizeof(KBRun));
+		run->start = kb_container_next(c, 0);
+		run->last = kb_container_last(c);
+
+		bitmap->memUsed -= kb_container_memory(c);
+		kb_container_set_data(c, KBContainerRun, run, 1, 1);
+		c->card = run->last - run->start + 1;
+		c->recheck = true;
+		bitmap->memUsed += kb_container_memory(c);
 	}
-	if (keyNode->bitmap)
-		pfree(keyNode->bitmap);
-	free_tree_node(node->left);
-	free_tree_node(node->right);
-	pfree(node);
 }
 
-void
-o_keybitmap_free(RBTree *tree)
+static int
+kb_uint64_cmp(const void *a, const void *b)
 {
-	free_tree_node(*((RBTNode **) tree));
-	pfree(tree);
-}
+	uint64		va = *((const uint64 *) a);
+	uint64		vb = *((const uint64 *) b);
 
-bool
-o_keybitmap_is_empty(RBTree *rbtree)
-{
-	return rbt_leftmost(rbtree) == NULL;
+	return va > vb ? 1 : va < vb ? -1 : 0;
 }
 
-void
-o_keybitmap_intersect(RBTree *a, RBTree *b)
+/*
+ * Merges the pending keys into the containers.
+ */
+static void
+kb_flush(OKeyBitmap *bitmap)
 {
-	RBTreeIterator iterA;
-	RBTreeIterator iterB;
-	OKeyBitmapRBTNode *nodeA;
-	OKeyBitmapRBTNode *nodeB;
-	List	   *removing = NIL;
-	ListCell   *lc;
+	KBContainer *containers;
+	uint16	   *lows;
+	int			i,
+				j,
+				n,
+				npending = 0,
+				nhighs = 0;
 
-	rbt_begin_iterate(a, LeftRightWalk, &iterA);
-	rbt_begin_iterate(b, LeftRightWalk, &iterB);
+	if (bitmap->npending == 0)
+		return;
 
-	nodeB = (OKeyBitmapRBTNode *) rbt_iterate(&iterB);
-	while ((nodeA = (OKeyBitmapRBTNode *) rbt_iterate(&iterA)) != NULL)
+	qsort(bitmap->pending, bitmap->npending, sizeof(uint64), kb_uint64_cmp);
+	for (i = 0; i < bitmap->npending; i++)
 	{
-		while (nodeB &&
-			   (nodeB->key & HIGH_PART_MASK) < (nodeA->key & HIGH_PART_MASK))
-		{
-			nodeB = (OKeyBitmapRBTNode *) rbt_iterate(&iterB);
-		}
+		if (npending > 0 && bitmap->pending[npending - 1] == bitmap->pending[i])
+			continue;
+		if (npending == 0 ||
+			KB_HIGH(bitmap->pending[npending - 1]) != KB_HIGH(bitmap->pending[i]))
+			nhighs++;
+		bitmap->pending[npending++] = bitmap->pending[i];
+	}
 
-		if (!nodeB ||
-			(nodeB->key & HIGH_PART_MASK) > (nodeA->key & HIGH_PART_MASK))
-		{
-			OKeyBitmapRBTNode *removed_node;
+	containers = MemoryContextAlloc(bitmap->cxt,
+									(bitmap->ncontainers + nhighs) *
+									sizeof(KBContainer));
+	lows = MemoryContextAlloc(bitmap->cxt, npending * sizeof(uint16));
 
-			removed_node = palloc0(sizeof(OKeyBitmapRBTNode));
-			memcpy(removed_node, nodeA, sizeof(OKeyBitmapRBTNode));
-			removing = lappend(removing, removed_node);
+	i = 0;
+	j = 0;
+	n = 0;
+	while (i < bitmap->ncontainers || j < npending)
+	{
+		uint64		high;
+		int			nlows = 0;
+		KBContainer *c;
+
+		if (j >= npending ||
+			(i < bitmap->ncontainers &&
+			 bitmap->containers[i].high < KB_HIGH(bitmap->pending[j])))
+		{
+			containers[n++] = bitmap->containers[i++];
 			continue;
 		}
 
-		Assert((nodeA->key & HIGH_PART_MASK) == (nodeB->key & HIGH_PART_MASK));
+		high = KB_HIGH(bitmap->pending[j]);
+		while (j < npending && KB_HIGH(bitmap->pending[j]) == high)
+			lows[nlows++] = KB_LOW(bitmap->pending[j++]);
 
-		if (!nodeA->bitmap)
+		c = &containers[n++];
+		if (i < bitmap->ncontainers && bitmap->containers[i].high == high)
 		{
-			if (!nodeB->bitmap)
-			{
-				if (nodeA->key != nodeB->key)
-				{
-					OKeyBitmapRBTNode *removed_node;
-
-					removed_node = palloc0(sizeof(OKeyBitmapRBTNode));
-					memcpy(removed_node, nodeA, sizeof(OKeyBitmapRBTNode));
-					removing = lappend(removing, removed_node);
-					continue;
-				}
-			}
-			else
-			{
-				int			offset = (nodeA->key & LOW_PART_MASK);
-
-				if (!(nodeB->bitmap[offset >> 3] & (1 << (offset & 7))))
-				{
-					OKeyBitmapRBTNode *removed_node;
-
-					removed_node = palloc0(sizeof(OKeyBitmapRBTNode));
-					memcpy(removed_node, nodeA, sizeof(OKeyBitmapRBTNode));
-					removing = lappend(removing, removed_node);
-					continue;
-				}
-			}
+			*c = bitmap->containers[i++];
+			bitmap->memUsed -= kb_container_memory(c);
 		}
 		else
 		{
-			if (!nodeB->bitmap)
-			{
-				int			offset = (nodeB->key & LOW_PART_MASK);
-
-				if (!(nodeA->bitmap[offset >> 3] & (1 << (offset & 7))))
-				{
-					OKeyBitmapRBTNode *removed_node;
+			memset(c, 0, sizeof(KBContainer));
+			c->high = high;
+			c->type = KBContainerArray;
+		}
+		kb_container_add(bitmap, c, lows, nlows);
+		bitmap->memUsed += kb_container_memory(c);
+	}
 
-					removed_node = palloc0(sizeof(OKeyBitmapRBTNode));
-					memcpy(removed_node, nodeA, sizeof(OKeyBitmapRBTNode));
-					removing = lappend(removing, removed_node);
-					continue;
-				}
-				pfree(nodeA->bitmap);
-				nodeA->bitmap = NULL;
-				nodeA->key = nodeB->key;
-			}
-			else
-			{
-				int			i;
-				bool		empty = true;
+	pfree(lows);
+	if (bitmap->containers)
+		pfree(bitmap->containers);
+	bitmap->containers = containers;
+	bitmap->ncontainers = n;
+	bitmap->lastIndex = 0;
+	bitmap->npending = 0;
+
+	/* Grow the pending buffer with the bitmap to amortize merges */
+	if (bitmap->maxpending < KB_PENDING_MAX &&
+		bitmap->maxpending < bitmap->ncontainers * 4)
+	{
+		bitmap->maxpending = Min(KB_PENDING_MAX, bitmap->maxpending * 2);
+		bitmap->pending = repalloc(bitmap->pending,
+								   sizeof(uint64) * bitmap->maxpending);
+	}
 
-				for (i = 0; i < BITMAP_SIZE; i++)
-				{
-					nodeA->bitmap[i] &= nodeB->bitmap[i];
-					if (nodeA->bitmap[i] != 0)
-						empty = false;
-				}
+	kb_lossify(bitmap);
+}
 
-				if (empty)
-				{
-					OKeyBitmapRBTNode *removed_node;
+/*
+ * Returns the index of the first container, which high part isn't less than
+ * the given one.
+ */
+static int
+kb_find_container(OKeyBitmap *bitmap, uint64 high)
+{
+	int			lo = 0,
+				hi = bitmap->ncontainers;
 
-					removed_node = palloc0(sizeof(OKeyBitmapRBTNode));
-					memcpy(removed_node, nodeA, sizeof(OKeyBitmapRBTNode));
-					removing = lappend(removing, removed_node);
-					continue;
-				}
-			}
-		}
-	}
+	if (bitmap->lastIndex < bitmap->ncontainers &&
+		bitmap->containers[bitmap->lastIndex].high == high)
+		return bitmap->lastIndex;
 
-	foreach(lc, removing)
+	while (lo < hi)
 	{
-		OKeyBitmapRBTNode *search_node;
-		OKeyBitmapRBTNode *removing_node;
+		int			mid = (lo + hi) / 2;
 
-		search_node = (OKeyBitmapRBTNode *) lfirst(lc);
-		if (search_node->bitmap)
-			pfree(search_node->bitmap);
-		removing_node = (OKeyBitmapRBTNode *) rbt_find(a,
-													   (RBTNode *) search_node);
-		rbt_delete(a, (RBTNode *) removing_node);
-		pfree(search_node);
+		if (bitmap->containers[mid].high < high)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
-	list_free(removing);
+	bitmap->lastIndex = lo;
+	return lo;
 }
 
 void
-o_keybitmap_union(RBTree *a, RBTree *b)
+o_keybitmap_insert(OKeyBitmap *bitmap, uint64 value)
 {
-	RBTreeIterator iterB;
-	OKeyBitmapRBTNode *nodeB;
+	if (bitmap->npending >= bitmap->maxpending)
+		kb_flush(bitmap);
+	bitmap->pending[bitmap->npending++] = value;
+}
 
-	rbt_begin_iterate(b, LeftRightWalk, &iterB);
-	while ((nodeB = (OKeyBitmapRBTNode *) rbt_iterate(&iterB)) != NULL)
-	{
-		bool		is_new;
+/*
+ * Checks if the value is in the bitmap.  *recheck is set if the quals should
+ * be rechecked for the value.
+ */
+bool
+o_keybitmap_test(OKeyBitmap *bitmap, uint64 value, bool *recheck)
+{
+	int			i;
+	KBContainer *c;
 
-		rbt_insert(a, &nodeB->rbtnode, &is_new);
-	}
+	kb_flush(bitmap);
+	i = kb_find_container(bitmap, KB_HIGH(value));
+	if (i >= bitmap->ncontainers)
+		return false;
+
+	c = &bitmap->containers[i];
+	if (c->high != KB_HIGH(value) || !kb_container_contains(c, KB_LOW(value)))
+		return false;
+
+	*recheck = c->recheck;
+	return true;
 }
 
-static int
-bm_rbt_comparator(const RBTNode *a, const RBTNode *b, void *arg)
+/*
+ * Checks if the bitmap has any value in the [low, high) range.
+ */
+bool
+o_keybitmap_range_is_valid(OKeyBitmap *bitmap, uint64 low, uint64 high)
 {
-	const OKeyBitmapRBTNode *keyA = (OKeyBitmapRBTNode *) a;
-	const OKeyBitmapRBTNode *keyB = (OKeyBitmapRBTNode *) b;
-	uint64		va = keyA->key & HIGH_PART_MASK;
-	uint64		vb = keyB->key & HIGH_PART_MASK;
+	bool		found;
+	uint64		next;
 
-	return va > vb ? 1 : va < vb ? -1 : 0;
+	next = o_keybitmap_get_next(bitmap, low, &found);
+	return found && next < high;
 }
 
-static void
-node_make_bitmap(OKeyBitmapRBTNode *node)
+/*
+ * Returns the first value of the bitmap, which is greater or equal to prev.
+ */
+uint64
+o_keybitmap_get_next(OKeyBitmap *bitmap, uint64 prev, bool *found)
 {
-	int			offset;
+	int			i;
+	int			low;
 
-	node->bitmap = palloc0(BITMAP_SIZE);
-	offset = node->key & LOW_PART_MASK;
+	kb_flush(bitmap);
+	i = kb_find_container(bitmap, KB_HIGH(prev));
+	if (i < bitmap->ncontainers && bitmap->containers[i].high == KB_HIGH(prev))
+	{
+		low = kb_container_next(&bitmap->containers[i], KB_LOW(prev));
+		if (low >= 0)
+		{
+			*found = true;
+			return KB_MAKE_VALUE(bitmap->containers[i].high, low);
+		}
+		i++;
+	}
+
+	if (i >= bitmap->ncontainers)
+	{
+		*found = false;
+		return 0;
+	}
 
-	node->bitmap[offset >> 3] |= 1 << (offset & 7);
-	node->key &= HIGH_PART_MASK;
+	low = kb_container_next(&bitmap->containers[i], 0);
+	Assert(low >= 0);
+	*found = true;
+	return KB_MAKE_VALUE(bitmap->containers[i].high, low);
 }
 
-static void
-bm_rbt_combiner(RBTNode *existing,
-				const RBTNode *newdata,
-				void *arg)
+uint64
+o_keybitmap_get_last(OKeyBitmap *bitmap, bool *found)
 {
-	OKeyBitmapRBTNode *old = (OKeyBitmapRBTNode *) existing;
-	OKeyBitmapRBTNode *new = (OKeyBitmapRBTNode *) newdata;
+	KBContainer *c;
 
-	if (!old->bitmap)
+	kb_flush(bitmap);
+	if (bitmap->ncontainers == 0)
 	{
-		if (!new->bitmap && new->key == old->key)
-			return;
-		node_make_bitmap(old);
+		*found = false;
+		return 0;
 	}
 
-	if (!new->bitmap)
+	c = &bitmap->containers[bitmap->ncontainers - 1];
+	*found = true;
+	return KB_MAKE_VALUE(c->high, kb_container_last(c));
+}
+
+void
+o_keybitmap_free(OKeyBitmap *bitmap)
+{
+	int			i;
+
+	for (i = 0; i < bitmap->ncontainers; i++)
+		pfree(bitmap->containers[i].data);
+	if (bitmap->containers)
+		pfree(bitmap->containers);
+	pfree(bitmap->pending);
+	pfree(bitmap);
+}
+
+bool
+o_keybitmap_is_empty(OKeyBitmap *bitmap)
+{
+	kb_flush(bitmap);
+	return bitmap->ncontainers == 0;
+}
+
+void
+o_keybitmap_intersect(OKeyBitmap *a, OKeyBitmap *b)
+{
+	int			i,
+				j = 0,
+				n = 0;
+
+	kb_flush(a);
+	kb_flush(b);
+
+	for (i = 0; i < a->ncontainers; i++)
 	{
-		int			offset = new->key & LOW_PART_MASK;
+		KBContainer *c = &a->containers[i];
+
+		while (j < b->ncontainers && b->containers[j].high < c->high)
+			j++;
 
-		old->bitmap[offset >> 3] |= 1 << (offset & 7);
+		a->memUsed -= kb_container_memory(c);
+		if (j < b->ncontainers && b->containers[j].high == c->high)
+			kb_container_and(a, c, &b->containers[j]);
+		else
+			c->card = 0;
+
+		if (c->card > 0)
+		{
+			a->memUsed += kb_container_memory(c);
+			a->containers[n++] = *c;
+		}
+		else
+		{
+			pfree(c->data);
+		}
 	}
-	else
+	a->ncontainers = n;
+	a->lastIndex = 0;
+}
+
+void
+o_keybitmap_union(OKeyBitmap *a, OKeyBitmap *b)
+{
+	KBContainer *containers;
+	int			i = 0,
+				j = 0,
+				n = 0;
+
+	kb_flush(a);
+	kb_flush(b);
+
+	if (b->ncontainers == 0)
+		return;
+
+	containers = MemoryContextAlloc(a->cxt,
+									(a->ncontainers + b->ncontainers) *
+									sizeof(KBContainer));
+	while (i < a->ncontainers || j < b->ncontainers)
 	{
-		int			i;
+		KBContainer *c = &containers[n++];
 
-		for (i = 0; i < BITMAP_SIZE; i++)
-			old->bitmap[i] |= new->bitmap[i];
+		if (j >= b->ncontainers ||
+			(i < a->ncontainers &&
+			 a->containers[i].high < b->containers[j].high))
+		{
+			*c = a->containers[i++];
+		}
+		else if (i >= a->ncontainers ||
+				 b->containers[j].high < a->containers[i].high)
+		{
+			kb_container_copy(a, c, &b->containers[j++]);
+			a->memUsed += kb_container_memory(c);
+		}
+		else
+		{
+			*c = a->containers[i++];
+			a->memUsed -= kb_container_memory(c);
+			kb_container_or(a, c, &b->containers[j++]);
+			a->memUsed += kb_container_memory(c);
+		}
 	}
+
+	if (a->containers)
+		pfree(a->containers);
+	a->containers = containers;
+	a->ncontainers = n;
+	a->lastIndex = 0;
+	kb_lossify(a);
 }
 
-static RBTNode *
-bm_rbt_allocfunc(void *arg)
+/*
+ * Each container is a separate chunk for parallel scans.
+ */
+uint64
+o_keybitmap_count_chunks(OKeyBitmap *bitmap)
 {
-	RBTNode    *result = palloc0(sizeof(OKeyBitmapRBTNode));
+	kb_flush(bitmap);
+	return bitmap->ncontainers;
+}
 
-	return result;
+Size
+o_keybitmap_serialized_size(OKeyBitmap *bitmap)
+{
+	Size		size;
+	int			i;
+
+	kb_flush(bitmap);
+	size = MAXALIGN(bitmap->ncontainers * sizeof(KBSerializedContainer));
+	for (i = 0; i < bitmap->ncontainers; i++)
+		size += MAXALIGN(kb_container_data_size(&bitmap->containers[i]));
+	return size;
 }
 
-static void
-bm_rbt_freefunc(RBTNode *x, void *arg)
+/*
+ * Writes the bitmap to o_keybitmap_serialized_size() bytes at dst.
+ */
+void
+o_keybitmap_serialize(OKeyBitmap *bitmap, Pointer dst)
 {
-	pfree(x);
+	KBSerializedContainer *headers = (KBSerializedContainer *) dst;
+	Size		offset;
+	int			i;
+
+	kb_flush(bitmap);
+	offset = MAXALIGN(bitmap->ncontainers * sizeof(KBSerializedContainer));
+	for (i = 0; i < bitmap->ncontainers; i++)
+	{
+		KBContainer *c = &bitmap->containers[i];
+		Size		size = kb_container_data_size(c);
+
+		headers[i].high = c->high;
+		headers[i].offset = offset;
+		headers[i].type = c->type;
+		headers[i].recheck = c->recheck;
+		headers[i].card = c->card;
+		headers[i].n = c->n;
+		memcpy(dst + offset, c->data, size);
+		offset += MAXALIGN(size);
+	}
+}
+
+/*
+ * Makes a bitmap of count serialized chunks starting from the first one.
+ */
+OKeyBitmap *
+o_keybitmap_deserialize(Pointer src, uint64 first, uint64 count)
+{
+	KBSerializedContainer *headers = (KBSerializedContainer *) src;
+	OKeyBitmap *bitmap = o_keybitmap_create(SIZE_MAX);
+	uint64		i;
+
+	bitmap->containers = palloc(Max(count, 1) * sizeof(KBContainer));
+	for (i = 0; i < count; i++)
+	{
+		KBSerializedContainer *header = &headers[first + i];
+		KBContainer *c = &bitmap->containers[i];
+		KBContainer tmp;
+
+		tmp.high = header->high;
+		tmp.type = header->type;
+		tmp.recheck = header->recheck;
+		tmp.card = header->card;
+		tmp.n = header->n;
+		tmp.capacity = header->n;
+		tmp.data = src + header->offset;
+		kb_container_copy(bitmap, c, &tmp);
+		bitmap->memUsed += kb_container_memory(c);
+	}
+	bitmap->ncontainers = count;
+	return bitmap;
 }
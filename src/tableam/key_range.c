@@ -27,7 +27,26 @@
 #include "parser/parse_coerce.h"
 #include "utils/array.h"
 #include "utils/arrayaccess.h"
+#include "utils/inval.h"
 #include "utils/lsyscache.h"
+#include "utils/syscache.h"
+
+/*
+ * Cache of IsBinaryCoercible() results for the bound types.  The check is a
+ * pg_cast lookup, which is otherwise repeated for each key of each execution
+ * of a prepared lookup, and for each comparison with a bound of another type.
+ */
+#define COERCIBLE_CACHE_SIZE	16
+
+typedef struct
+{
+	Oid			srctype;
+	Oid			targettype;
+	bool		result;
+} CoercibleCacheEntry;
+
+static CoercibleCacheEntry coercibleCache[COERCIBLE_CACHE_SIZE];
+static bool coercibleCacheCallbackRegistered = false;
 
 static bool o_key_range_is_unbounded(OBTreeKeyRange *range, int attnum);
 static void o_fill_key_bounds(Datum v, Oid type,
@@ -286,6 +305,36 @@ o_key_data_to_key_range(OBTreeKeyRange *res, ScanKeyData *keyData,
 	return exact;
 }
 
+static void
+coercible_cache_invalidate(Datum arg, int cacheid, uint32 hashvalue)
+{
+	memset(coercibleCache, 0, sizeof(coercibleCache));
+}
+
+bool
+o_is_binary_coercible(Oid srctype, Oid targettype)
+{
+	CoercibleCacheEntry *entry;
+
+	if (!coercibleCacheCallbackRegistered)
+	{
+		CacheRegisterSyscacheCallback(CASTSOURCETARGET,
+									  coercible_cache_invalidate,
+									  (Datum) 0);
+		coercibleCacheCallbackRegistered = true;
+	}
+
+	entry = &coercibleCache[(srctype ^ (targettype << 3)) %
+							COERCIBLE_CACHE_SIZE];
+	if (entry->srctype != srctype || entry->targettype != targettype)
+	{
+		entry->result = IsBinaryCoercible(srctype, targettype);
+		entry->srctype = srctype;
+		entry->targettype = targettype;
+	}
+	return entry->result;
+}
+
 static void
 o_fill_key_bounds(Datum v, Oid type,
 				  OBTreeValueBound *low, OBTreeValueBound *high,
@@ -298,7 +347,7 @@ o_fill_key_bounds(Datum v, Oid type,
 		return;
 
 	if (type == field->opclass || type == field->inputtype ||
-		IsBinaryCoercible(type, field->inputtype))
+		o_is_binary_coercible(type, field->inputtype))
 		coercible = true;
 	else
 		comparator = o_find_comparator(field->opfamily, type,
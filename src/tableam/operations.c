@@ -15,8 +15,12 @@
 #include "orioledb.h"
 
 #include "btree/btree.h"
+#include "btree/build.h"
+#include "btree/find.h"
 #include "btree/iterator.h"
 #include "btree/modify.h"
+#include "btree/page_contents.h"
+#include "catalog/o_sys_cache.h"
 #include "recovery/recovery.h"
 #include "recovery/wal.h"
 #include "tableam/descr.h"
@@ -26,10 +30,12 @@
 #include "transam/oxid.h"
 #include "transam/undo.h"
 #include "tuple/slot.h"
+#include "tuple/sort.h"
 #include "utils/stopevent.h"
 
 #include "access/heapam.h"
 #include "access/tableam.h"
+#include "access/xact.h"
 #include "catalog/index.h"
 #include "catalog/storage.h"
 #include "commands/vacuum.h"
@@ -37,6 +43,7 @@
 #include "parser/parsetree.h"
 #include "storage/bufmgr.h"
 #include "utils/lsyscache.h"
+#include "utils/memutils.h"
 
 static OTableModifyResult o_tbl_indices_overwrite(OTableDescr *descr,
 												  OBTreeKeyBound *oldPkey,
@@ -151,21 +158,77 @@ update_arg_get_slot(OModifyCallbackArg *arg)
 		return arg->tmpSlot;
 }
 
-TupleTableSlot *
-o_tbl_insert(OTableDescr *descr, Relation relation,
-			 TupleTableSlot *slot, OXid oxid, CommitSeqNo csn)
+bool		orioledb_enable_index_prefetch = false;
+
+/*
+ * Checks if it's worth prefetching the leaf of the secondary index for the
+ * modification.  Expression and partial indices are skipped to avoid
+ * evaluating their expressions twice.  Trees, which never had pages written,
+ * have nothing to prefetch.
+ */
+static bool
+o_index_prefetch_allowed(OIndexDescr *id)
+{
+	BTreeMetaPage *metaPage;
+
+	if (id->expressions_state != NIL || id->predicate != NIL)
+		return false;
+
+	o_btree_load_shmem(&id->desc);
+	metaPage = BTREE_GET_META(&id->desc);
+	return pg_atomic_read_u64(&metaPage->datafileLength[0]) > 0;
+}
+
+/*
+ * Issues the reads of the evicted secondary index leaves, which are going to
+ * be modified for the new tuple.  PostgreSQL modifies the secondary indices
+ * one by one, so without the prefetch every evicted leaf is a synchronous
+ * random read.  When there are several secondary indices, we let the reads
+ * of all their leaves proceed in parallel.  If oldSlot is given, only the
+ * indices with the changed key are considered, and both old and new leaves
+ * are prefetched.
+ */
+static void
+o_tbl_prefetch_secondary_leaves(OTableDescr *descr, TupleTableSlot *slot,
+								TupleTableSlot *oldSlot)
+{
+	int			i;
+
+	if (!orioledb_enable_index_prefetch || descr->nIndices <= 2)
+		return;
+
+	for (i = PrimaryIndexNumber + 1; i < descr->nIndices; i++)
+	{
+		OIndexDescr *id = descr->indices[i];
+		OBTreeKeyBound key;
+
+		if (!o_index_prefetch_allowed(id))
+			continue;
+
+		tts_orioledb_fill_key_bound(slot, id, &key);
+		if (oldSlot)
+		{
+			OBTreeKeyBound oldKey;
+
+			tts_orioledb_fill_key_bound(oldSlot, id, &oldKey);
+			if (is_keys_eq(&id->desc, &key, &oldKey))
+				continue;
+			btree_prefetch_key(&id->desc, (Pointer) &oldKey, BTreeKeyBound);
+		}
+		btree_prefetch_key(&id->desc, (Pointer) &key, BTreeKeyBound);
+	}
+}
+
+/*
+ * Prepares the slot for insertion to the primary index: assigns ctid if
+ * needed, toasts the values and forms the tuple (cached in the slot).
+ */
+static TupleTableSlot *
+o_tbl_insert_prepare(OTableDescr *descr, Relation relation,
+					 TupleTableSlot *slot)
 {
-	OTableModifyResult mres;
 	OTuple		tup;
 	OIndexDescr *primary = GET_PRIMARY(descr);
-	BTreeModifyCallbackInfo callbackInfo =
-	{
-		.waitCallback = NULL,
-		.modifyDeletedCallback = o_insert_callback,
-		.modifyCallback = NULL,
-		.needsUndoForSelfCreated = true,
-		.arg = slot
-	};
 
 	if (slot->tts_ops != descr->newTuple->tts_ops)
 	{
@@ -188,6 +251,27 @@ o_tbl_insert(OTableDescr *descr, Relation relation,
 	o_btree_check_size_of_tuple(o_tuple_size(tup, &primary->leafSpec),
 								RelationGetRelationName(relation),
 								false);
+	return slot;
+}
+
+/*
+ * Inserts the slot prepared by o_tbl_insert_prepare().
+ */
+static void
+o_tbl_insert_prepared(OTableDescr *descr, Relation relation,
+					  TupleTableSlot *slot, OXid oxid, CommitSeqNo csn)
+{
+	OTableModifyResult mres;
+	OTuple		tup;
+	OIndexDescr *primary = GET_PRIMARY(descr);
+	BTreeModifyCallbackInfo callbackInfo =
+	{
+		.waitCallback = NULL,
+		.modifyDeletedCallback = o_insert_callback,
+		.modifyCallback = NULL,
+		.needsUndoForSelfCreated = true,
+		.arg = slot
+	};
 
 	mres.success = (o_tbl_index_insert(descr, descr->indices[0], NULL, slot,
 									   oxid, csn, &callbackInfo) == OBTreeModifyResultInserted);
@@ -203,16 +287,305 @@ o_tbl_insert(OTableDescr *descr, Relation relation,
 		o_report_duplicate(relation, descr->indices[mres.failedIxNum], slot);
 	}
 
+	o_tbl_prefetch_secondary_leaves(descr, slot, NULL);
+
 	o_toast_insert_values(relation, descr, slot, oxid, csn);
 
 	/* Tuple might be changes in the callback */
 	tup = tts_orioledb_form_tuple(slot, descr);
 	if (primary->desc.storageType == BTreeStoragePersistence)
 		o_wal_insert(&primary->desc, tup);
+}
 
+TupleTableSlot *
+o_tbl_insert(OTableDescr *descr, Relation relation,
+			 TupleTableSlot *slot, OXid oxid, CommitSeqNo csn)
+{
+	slot = o_tbl_insert_prepare(descr, relation, slot);
+	o_tbl_insert_prepared(descr, relation, slot, oxid, csn);
 	return slot;
 }
 
+typedef struct
+{
+	OTableDescr *descr;
+	TupleTableSlot **slots;
+} OInsertBatchSortArg;
+
+static int
+o_tbl_insert_batch_cmp(const void *a, const void *b, void *arg)
+{
+	OInsertBatchSortArg *sortArg = (OInsertBatchSortArg *) arg;
+	int			i1 = *((const int *) a),
+				i2 = *((const int *) b);
+	OTuple		tup1,
+				tup2;
+	int			cmp;
+
+	tup1 = tts_orioledb_form_tuple(sortArg->slots[i1], sortArg->descr);
+	tup2 = tts_orioledb_form_tuple(sortArg->slots[i2], sortArg->descr);
+	cmp = o_btree_cmp(&GET_PRIMARY(sortArg->descr)->desc,
+					  &tup1, BTreeKeyLeafTuple,
+					  &tup2, BTreeKeyLeafTuple);
+	if (cmp != 0)
+		return cmp;
+
+	/* Keep the original order of duplicates */
+	return (i1 > i2) - (i1 < i2);
+}
+
+/*
+ * Inserts the batch of tuples to the primary index.  Tuples are inserted in
+ * the primary key order, so that the neighboring tuples land to the same leaf
+ * and find it via the finger cache instead of descending from the root.
+ */
+void
+o_tbl_insert_batch(OTableDescr *descr, Relation relation,
+				   TupleTableSlot **slots, int ntuples,
+				   OXid oxid, CommitSeqNo csn)
+{
+	OInsertBatchSortArg sortArg;
+	int		   *order;
+	int			i;
+
+	/*
+	 * Slots of other types are copied to the single descr->newTuple, they
+	 * can't be inserted in any order other than given.
+	 */
+	for (i = 0; i < ntuples; i++)
+	{
+		if (slots[i]->tts_ops != descr->newTuple->tts_ops)
+			break;
+	}
+	if (i < ntuples || ntuples <= 1)
+	{
+		for (i = 0; i < ntuples; i++)
+			(void) o_tbl_insert(descr, relation, slots[i], oxid, csn);
+		return;
+	}
+
+	for (i = 0; i < ntuples; i++)
+		(void) o_tbl_insert_prepare(descr, relation, slots[i]);
+
+	order = (int *) palloc(sizeof(int) * ntuples);
+	for (i = 0; i < ntuples; i++)
+		order[i] = i;
+
+	/* Ctids are already ascending */
+	if (!GET_PRIMARY(descr)->primaryIsCtid)
+	{
+		sortArg.descr = descr;
+		sortArg.slots = slots;
+		qsort_arg(order, ntuples, sizeof(int), o_tbl_insert_batch_cmp, &sortArg);
+	}
+
+	for (i = 0; i < ntuples; i++)
+		o_tbl_insert_prepared(descr, relation, slots[order[i]], oxid, csn);
+
+	pfree(order);
+}
+
+/*
+ * State of the bulk load in progress.  It lives until the end of the COPY
+ * command, so the transaction and subtransaction are remembered to detect
+ * stale state left after an error.
+ */
+typedef struct
+{
+	Oid			reloid;
+	OXid		oxid;
+	SubTransactionId subid;
+	Tuplesortstate *primarySort;
+	Tuplesortstate *toastSort;
+} OBulkLoadState;
+
+static OBulkLoadState bulkLoad = {InvalidOid};
+
+static bool
+o_tbl_bulk_load_is_active(Relation relation)
+{
+	if (!OidIsValid(bulkLoad.reloid))
+		return false;
+
+	if (bulkLoad.oxid != get_current_oxid_if_any() ||
+		bulkLoad.subid != GetCurrentSubTransactionId())
+	{
+		/* Memory and temporary files were released by the abort */
+		memset(&bulkLoad, 0, sizeof(bulkLoad));
+		return false;
+	}
+
+	return bulkLoad.reloid == RelationGetRelid(relation);
+}
+
+static bool
+o_tbl_bulk_load_tree_is_empty(BTreeDescr *desc)
+{
+	Page		page;
+
+	o_btree_load_shmem(desc);
+	page = O_GET_IN_MEMORY_PAGE(desc->rootInfo.rootPageBlkno);
+
+	return O_PAGE_IS(page, LEAF) && BTREE_PAGE_ITEMS_COUNT(page) == 0;
+}
+
+/*
+ * Checks if the relation can be bulk loaded.  COPY FREEZE ensures the
+ * relation was created or truncated in the current subtransaction, so nobody
+ * else can see its trees.  We don't write WAL for the built pages, so only
+ * unlogged and temporary relations are eligible.  Triggers (including
+ * foreign keys) could look into the table before the load is finished.
+ */
+static bool
+o_tbl_bulk_load_allowed(OTableDescr *descr, Relation relation, int options)
+{
+	if (!(options & TABLE_INSERT_FROZEN) ||
+		relation->rd_rel->relpersistence == RELPERSISTENCE_PERMANENT ||
+		relation->trigdesc != NULL ||
+		!OXidIsValid(get_current_oxid_if_any()))
+		return false;
+
+	return o_tbl_bulk_load_tree_is_empty(&GET_PRIMARY(descr)->desc) &&
+		o_tbl_bulk_load_tree_is_empty(&descr->toast->desc);
+}
+
+/*
+ * Puts the batch of tuples to the bulk load sorts.  Returns false if the
+ * relation isn't eligible for bulk load, then the caller must insert tuples
+ * as usual.
+ */
+bool
+o_tbl_bulk_load_insert(OTableDescr *descr, Relation relation,
+					   TupleTableSlot **slots, int ntuples, int options)
+{
+	MemoryContext oldcontext;
+	int			i;
+
+	if (!o_tbl_bulk_load_is_active(relation))
+	{
+		if (OidIsValid(bulkLoad.reloid) ||
+			!o_tbl_bulk_load_allowed(descr, relation, options))
+			return false;
+
+		oldcontext = MemoryContextSwitchTo(CurTransactionContext);
+		bulkLoad.primarySort = tuplesort_begin_orioledb_index(GET_PRIMARY(descr),
+															  maintenance_work_mem,
+															  false, NULL);
+		bulkLoad.toastSort = tuplesort_begin_orioledb_toast(descr->toast,
+															GET_PRIMARY(descr),
+															maintenance_work_mem,
+															false, NULL);
+		MemoryContextSwitchTo(oldcontext);
+
+		bulkLoad.reloid = RelationGetRelid(relation);
+		bulkLoad.oxid = get_current_oxid_if_any();
+		bulkLoad.subid = GetCurrentSubTransactionId();
+	}
+
+	for (i = 0; i < ntuples; i++)
+	{
+		TupleTableSlot *slot;
+
+		slot = o_tbl_insert_prepare(descr, relation, slots[i]);
+		tuplesort_putotuple(bulkLoad.primarySort,
+							tts_orioledb_form_tuple(slot, descr));
+		tts_orioledb_toast_sort_add(slot, descr, bulkLoad.toastSort);
+	}
+
+	return true;
+}
+
+/*
+ * Drops the empty in-memory tree to replace it with the built one.  The
+ * placeholder keeps others away until the file header is written.
+ */
+static void
+o_tbl_bulk_load_reset_tree(BTreeDescr *desc)
+{
+	o_tables_rel_lock_extended(&desc->oids, AccessExclusiveLock, false);
+	o_tables_rel_lock_extended(&desc->oids, AccessExclusiveLock, true);
+	cleanup_btree(desc->oids.datoid, desc->oids.relnode, true);
+	o_insert_shared_root_placeholder(desc->oids.datoid, desc->oids.relnode);
+	o_tables_rel_unlock_extended(&desc->oids, AccessExclusiveLock, false);
+	o_tables_rel_unlock_extended(&desc->oids, AccessExclusiveLock, true);
+
+	desc->rootInfo.rootPageBlkno = OInvalidInMemoryBlkno;
+	desc->rootInfo.metaPageBlkno = OInvalidInMemoryBlkno;
+	desc->rootInfo.rootPageChangeCount = 0;
+}
+
+/*
+ * Finishes the bulk load: writes the sorted tuples as packed pages of the
+ * primary and TOAST trees.
+ */
+void
+o_tbl_bulk_load_finish(Relation relation)
+{
+	OTableDescr *descr;
+	OIndexDescr *primary;
+	BTreeDescr *trees[2];
+	Tuplesortstate *sorts[2];
+	CheckpointFileHeader fileHeaders[2];
+	uint64		ctid = 0;
+	int			i;
+
+	if (!o_tbl_bulk_load_is_active(relation))
+		return;
+
+	descr = relation_get_descr(relation);
+	primary = GET_PRIMARY(descr);
+	trees[0] = &primary->desc;
+	trees[1] = &descr->toast->desc;
+	sorts[0] = bulkLoad.primarySort;
+	sorts[1] = bulkLoad.toastSort;
+	tuplesort_orioledb_index_set_insert_rel(sorts[0], relation);
+
+	/* Somebody has inserted to the table bypassing the bulk load */
+	if (!o_tbl_bulk_load_tree_is_empty(trees[0]) ||
+		!o_tbl_bulk_load_tree_is_empty(trees[1]))
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("relation \"%s\" was modified during bulk load",
+						RelationGetRelationName(relation))));
+
+	if (primary->primaryIsCtid)
+		ctid = pg_atomic_read_u64(&BTREE_GET_META(trees[0])->ctid);
+
+	for (i = 0; i < 2; i++)
+		o_tbl_bulk_load_reset_tree(trees[i]);
+
+	o_set_syscache_hooks();
+	for (i = 0; i < 2; i++)
+	{
+		OIndexDescr *idx = (OIndexDescr *) trees[i]->arg;
+
+		tuplesort_performsort(sorts[i]);
+		btree_write_index_data(trees[i], idx->leafTupdesc, sorts[i],
+							   i == 0 ? ctid : 0, &fileHeaders[i]);
+		tuplesort_end(sorts[i]);
+	}
+	o_unset_syscache_hooks();
+
+	memset(&bulkLoad, 0, sizeof(bulkLoad));
+
+	/*
+	 * Write the file headers.  Meta lock will prevent checkpointer from
+	 * walking through.  No WAL is needed: the relation is either temporary
+	 * or unlogged.
+	 */
+	o_tables_meta_lock_no_wal();
+	for (i = 0; i < 2; i++)
+	{
+		btree_write_file_header(trees[i], &fileHeaders[i]);
+		o_drop_shared_root_info(trees[i]->oids.datoid,
+								trees[i]->oids.relnode);
+	}
+	o_tables_meta_unlock_no_wal();
+
+	for (i = 0; i < 2; i++)
+		o_invalidate_oids(trees[i]->oids);
+}
+
 static RowLockMode
 tuple_lock_mode_to_row_lock_mode(LockTupleMode mode)
 {
@@ -245,6 +618,7 @@ o_tbl_lock(OTableDescr *descr, OBTreeKeyBound *pkey, LockTupleMode mode,
 		.modifyDeletedCallback = o_lock_deleted_callback,
 		.modifyCallback = o_lock_modify_callback,
 		.needsUndoForSelfCreated = true,
+		.noWait = (larg->waitPolicy != LockWaitBlock),
 		.arg = larg
 	};
 
@@ -563,6 +937,7 @@ o_tbl_update(OTableDescr *descr, TupleTableSlot *slot,
 		if (mres.action == BTreeOperationUpdate)
 		{
 			oldSlot = mres.oldTuple;
+			o_tbl_prefetch_secondary_leaves(descr, slot, oldSlot);
 			mres.failedIxNum = TOASTIndexNumber;
 			mres.success = tts_orioledb_update_toast_values(oldSlot, slot, descr,
 															oxid, csn);
@@ -570,14 +945,16 @@ o_tbl_update(OTableDescr *descr, TupleTableSlot *slot,
 			if (mres.success &&
 				primary->desc.storageType == BTreeStoragePersistence)
 			{
-				OTuple		final_tup = tts_orioledb_form_tuple(slot, descr);
+				OTuple		old_tup = ((OTableSlot *) oldSlot)->tuple,
+							final_tup = tts_orioledb_form_tuple(slot, descr);
 
-				o_wal_update(&primary->desc, final_tup);
+				o_wal_update_delta(&primary->desc, old_tup, final_tup);
 			}
 		}
 		else if (mres.action == BTreeOperationDelete)
 		{
 			oldSlot = mres.oldTuple;
+			o_tbl_prefetch_secondary_leaves(descr, slot, oldSlot);
 			/* reinsert TOAST value */
 			mres.failedIxNum = TOASTIndexNumber;
 			/* insert new value in TOAST table */
@@ -27,8 +27,11 @@
 #include "tuple/slot.h"
 #include "utils/stopevent.h"
 
+#include "access/nbtree.h"
 #include "access/relation.h"
 #include "access/table.h"
+#include "catalog/pg_am_d.h"
+#include "commands/defrem.h"
 #include "common/hashfn.h"
 #include "executor/executor.h"
 #include "executor/nodeIndexscan.h"
@@ -42,6 +45,7 @@
 #include "optimizer/plancat.h"
 #include "optimizer/planmain.h"
 #include "parser/parsetree.h"
+#include "utils/fmgroids.h"
 #include "utils/json.h"
 #include "utils/lsyscache.h"
 #include "utils/rel.h"
@@ -54,6 +58,7 @@ typedef enum OPathTag
 {
 	O_IndexPath,
 	O_BitmapHeapPath,
+	O_SeqScanPath,
 } OPathTag;
 
 typedef struct OPath
@@ -73,6 +78,20 @@ typedef struct OBitmapHeapPath
 	OPath		o_path;
 } OBitmapHeapPath;
 
+typedef struct OSeqScanPath
+{
+	OPath		o_path;
+} OSeqScanPath;
+
+typedef struct OSeqScanPlanState
+{
+	OPlanState	o_plan_state;
+	OSnapshot	oSnapshot;
+	BTreeSeqScan *scan;
+	OZoneMapQual *zoneMap;
+	uint64		zoneMapSkipped;
+} OSeqScanPlanState;
+
 typedef struct OCustomScanState
 {
 	CustomScanState css;
@@ -82,6 +101,10 @@ typedef struct OCustomScanState
 } OCustomScanState;
 
 set_rel_pathlist_hook_type old_set_rel_pathlist_hook = NULL;
+bool		orioledb_enable_parallel_index_scan = false;
+bool		orioledb_enable_parallel_bitmap_scan = false;
+bool		orioledb_enable_sorted_pk_fetch = false;
+bool		orioledb_enable_index_only_costing = false;
 OEACallsCounters *ea_counters = NULL;
 
 /* custom scan */
@@ -95,6 +118,17 @@ static void o_rescan_custom_scan(CustomScanState *node);
 static void o_explain_custom_scan(CustomScanState *node, List *ancestors,
 								  ExplainState *es);
 static Node *o_create_custom_scan_state(CustomScan *cscan);
+static Size o_estimate_dsm_custom_scan(CustomScanState *node,
+									   ParallelContext *pcxt);
+static void o_initialize_dsm_custom_scan(CustomScanState *node,
+										 ParallelContext *pcxt,
+										 void *coordinate);
+static void o_reinitialize_dsm_custom_scan(CustomScanState *node,
+										   ParallelContext *pcxt,
+										   void *coordinate);
+static void o_initialize_worker_custom_scan(CustomScanState *node,
+											shm_toc *toc,
+											void *coordinate);
 
 static CustomPathMethods o_path_methods =
 {
@@ -117,10 +151,10 @@ static CustomExecMethods o_scan_exec_methods =
 	o_rescan_custom_scan,
 	NULL,
 	NULL,
-	NULL,
-	NULL,
-	NULL,
-	NULL,
+	o_estimate_dsm_custom_scan,
+	o_initialize_dsm_custom_scan,
+	o_reinitialize_dsm_custom_scan,
+	o_initialize_worker_custom_scan,
 	NULL,
 	o_explain_custom_scan
 };
@@ -162,11 +196,9 @@ transform_path(Path *src_path, OTableDescr *descr)
 
 	if (IsA(src_path, Path))
 	{
-		OIndexPath *new_path = palloc0(sizeof(OIndexPath));
+		OSeqScanPath *new_path = palloc0(sizeof(OSeqScanPath));
 
-		new_path->o_path.type = O_IndexPath;
-		new_path->ix_num = PrimaryIndexNumber;
-		new_path->scandir = ForwardScanDirection;
+		new_path->o_path.type = O_SeqScanPath;
 		result->custom_private = list_make1(new_path);
 	}
 	else if (IsA(src_path, IndexPath))
@@ -199,6 +231,104 @@ transform_path(Path *src_path, OTableDescr *descr)
 	return &result->path;
 }
 
+/*
+ * Builds zone map conditions from the "column op constant" clauses over a
+ * fixed-length by-value column, whose operator belongs to the default btree
+ * opclass of the column type.  Only the column of the first such clause is
+ * considered.  Returns NULL if there are no suitable clauses.
+ */
+static OZoneMapQual *
+o_zone_map_qual_from_clauses(OIndexDescr *primary, List *clauses,
+							 Index scanrelid)
+{
+	OZoneMapQual *qual = NULL;
+	ListCell   *lc;
+	int			ctid_off = primary->primaryIsCtid ? 1 : 0;
+
+	foreach(lc, clauses)
+	{
+		OpExpr	   *op = (OpExpr *) lfirst(lc);
+		Node	   *left,
+				   *right;
+		Var		   *var;
+		Const	   *cnst;
+		Form_pg_attribute att;
+		AttrNumber	attnum;
+		Oid			opclass,
+					opfamily;
+		int			strategy;
+
+		if (IsA(op, RestrictInfo))
+			op = (OpExpr *) ((RestrictInfo *) op)->clause;
+
+		if (!IsA(op, OpExpr) || list_length(op->args) != 2)
+			continue;
+
+		left = (Node *) linitial(op->args);
+		right = (Node *) lsecond(op->args);
+		if (IsA(left, Var) && IsA(right, Const))
+		{
+			var = (Var *) left;
+			cnst = (Const *) right;
+		}
+		else if (IsA(left, Const) && IsA(right, Var))
+		{
+			var = (Var *) right;
+			cnst = (Const *) left;
+		}
+		else
+			continue;
+
+		if (var->varno != scanrelid || var->varlevelsup != 0 ||
+			var->varattno <= 0 || cnst->constisnull)
+			continue;
+
+		attnum = var->varattno + ctid_off;
+		if (attnum > primary->leafTupdesc->natts)
+			continue;
+
+		att = TupleDescAttr(primary->leafTupdesc, attnum - 1);
+		if (att->attisdropped || !att->attbyval || att->attlen <= 0 ||
+			att->atttypid != var->vartype ||
+			att->atttypid != cnst->consttype)
+			continue;
+
+		if (qual != NULL &&
+			(qual->attnum != attnum || qual->nConds >= ZONE_MAP_MAX_CONDS))
+			continue;
+
+		opclass = GetDefaultOpClass(att->atttypid, BTREE_AM_OID);
+		if (!OidIsValid(opclass))
+			continue;
+		opfamily = get_opclass_family(opclass);
+		strategy = get_op_opfamily_strategy(op->opno, opfamily);
+		if (strategy == InvalidStrategy)
+			continue;
+		if ((Node *) var != left)
+			strategy = BTCommuteStrategyNumber(strategy);
+
+		if (qual == NULL)
+		{
+			Oid			cmpProc;
+
+			cmpProc = get_opfamily_proc(opfamily, att->atttypid,
+										att->atttypid, BTORDER_PROC);
+			if (!OidIsValid(cmpProc))
+				continue;
+
+			qual = (OZoneMapQual *) palloc0(sizeof(OZoneMapQual));
+			qual->attnum = attnum;
+			qual->collation = op->inputcollid;
+			fmgr_info(cmpProc, &qual->cmpProc);
+		}
+		qual->conds[qual->nConds].strategy = strategy;
+		qual->conds[qual->nConds].value = cnst->constvalue;
+		qual->nConds++;
+	}
+
+	return qual;
+}
+
 bool
 orioledb_set_plain_rel_pathlist_hook(PlannerInfo *root, RelOptInfo *rel,
 									 RangeTblEntry *rte)
@@ -310,6 +440,29 @@ orioledb_set_plain_rel_pathlist_hook(PlannerInfo *root, RelOptInfo *rel,
 	return result;
 }
 
+/*
+ * Returns the number of rows, which the query needs from the given path of
+ * the relation according to the LIMIT clause, or -1 if unknown.  That's only
+ * known for the single relation queries, when nothing reorders the rows
+ * above the scan.  Rows filtered out by the scan quals don't count.
+ */
+static int
+o_path_row_bound(PlannerInfo *root, RelOptInfo *rel, List *pathkeys)
+{
+	if (root->limit_tuples < 0 || root->limit_tuples > PG_INT32_MAX)
+		return -1;
+
+	if (rel->reloptkind != RELOPT_BASEREL ||
+		!bms_equal(rel->relids, root->all_baserels))
+		return -1;
+
+	if (root->query_pathkeys != NIL &&
+		!pathkeys_contained_in(root->query_pathkeys, pathkeys))
+		return -1;
+
+	return (int) root->limit_tuples;
+}
+
 /*
  * Removes all index and base relation scan paths for a orioledb TableAm table.
  */
@@ -345,6 +498,21 @@ orioledb_set_rel_pathlist_hook(PlannerInfo *root, RelOptInfo *rel,
 				{
 					bool		replace = !IsA(path, Path);
 
+					/*
+					 * Sequential scans are done by the custom scan if they
+					 * could skip leaves using the zone map.  The custom scan
+					 * doesn't support EvalPlanQual, so only do that for plain
+					 * selects.
+					 */
+					if (IsA(path, Path) && path->pathtype == T_SeqScan &&
+						zone_map_size > 0 && path->param_info == NULL &&
+						root->parse->commandType == CMD_SELECT &&
+						root->parse->rowMarks == NIL &&
+						o_zone_map_qual_from_clauses(GET_PRIMARY(descr),
+													 rel->baserestrictinfo,
+													 rel->relid) != NULL)
+						replace = true;
+
 					if (IsA(path, Path) && path->pathtype == T_SampleScan)
 					{
 						ereport(ERROR,
@@ -382,12 +550,53 @@ orioledb_set_rel_pathlist_hook(PlannerInfo *root, RelOptInfo *rel,
 			while (i < list_length(rel->partial_pathlist))
 			{
 				Path	   *path = list_nth(rel->partial_pathlist, i);
+				int			rowBound;
+
+				bool		keep = IsA(path, Path);
+
+				/*
+				 * Don't start workers if the few rows needed are likely to
+				 * come from the first leaf page.
+				 */
+				rowBound = o_path_row_bound(root, rel, path->pathkeys);
+				if (rowBound >= 0 && rowBound <= O_SCAN_BATCH_SIZE &&
+					rel->rows >= rowBound)
+				{
+					rel->partial_pathlist = list_delete_nth_cell(rel->partial_pathlist, i);
+					continue;
+				}
 
 				/*
-				 * TODO: Remove when parallel bitmap heap scan will be
-				 * implemented
+				 * Parallel bitmap heap scans are custom scans, which share
+				 * the key bitmap between participants.
 				 */
-				if (!IsA(path, Path))
+				if (orioledb_enable_parallel_bitmap_scan &&
+					IsA(path, BitmapHeapPath))
+				{
+					Path	   *custom_path = transform_path(path, descr);
+
+					rel->partial_pathlist = list_delete_nth_cell(rel->partial_pathlist, i);
+					rel->partial_pathlist = list_insert_nth(rel->partial_pathlist, i,
+															custom_path);
+					i++;
+					continue;
+				}
+
+				/*
+				 * Parallel scans of secondary indexes are done by the index
+				 * AM.  Primary key scans are custom scans, which aren't
+				 * parallel-aware yet.
+				 */
+				if (orioledb_enable_parallel_index_scan &&
+					IsA(path, IndexPath))
+				{
+					IndexPath  *ix_path = (IndexPath *) path;
+					OIndexDescr *primary = GET_PRIMARY(descr);
+
+					keep = primary->oids.reloid != ix_path->indexinfo->indexoid;
+				}
+
+				if (!keep)
 					rel->partial_pathlist = list_delete_nth_cell(rel->partial_pathlist, i);
 				else
 					i++;
@@ -454,6 +663,8 @@ o_plan_custom_path(PlannerInfo *root, RelOptInfo *rel,
 	{
 		OIndexPath *ix_path = (OIndexPath *) o_path;
 		bool		onlyCurIx = IsA(custom_plan, IndexOnlyScan);
+		bool		sortedPkFetch;
+		int			rowBound;
 
 		if (custom_plans && IsA(custom_plan, IndexScan))
 		{
@@ -472,12 +683,34 @@ o_plan_custom_path(PlannerInfo *root, RelOptInfo *rel,
 			qpqual = ixo_scan->scan.plan.qual;
 		}
 
+		/*
+		 * Primary index lookups of secondary index scan could be reordered if
+		 * nobody needs the index order.
+		 */
+		sortedPkFetch = orioledb_enable_sorted_pk_fetch && !onlyCurIx &&
+			ix_path->ix_num != PrimaryIndexNumber &&
+			best_path->path.pathkeys == NIL;
+		rowBound = o_path_row_bound(root, rel, best_path->path.pathkeys);
+
 		custom_scan->custom_exprs = NIL;
 		custom_scan->custom_private =
 			list_make4(makeInteger(O_IndexPlan),
 					   makeInteger(ix_path->ix_num),
 					   makeInteger(ix_path->scandir),
 					   makeInteger(onlyCurIx));
+		custom_scan->custom_private = lappend(custom_scan->custom_private,
+											  makeInteger(sortedPkFetch));
+		custom_scan->custom_private = lappend(custom_scan->custom_private,
+											  makeInteger(rowBound));
+	}
+	else if (o_path->type == O_SeqScanPath)
+	{
+		SeqScan    *seq_scan = (SeqScan *) custom_plan;
+
+		Assert(IsA(custom_plan, SeqScan));
+		plan->targetlist = seq_scan->scan.plan.targetlist;
+		qpqual = seq_scan->scan.plan.qual;
+		custom_scan->custom_private = list_make1(makeInteger(O_SeqScanPlan));
 	}
 	else
 	{
@@ -558,6 +791,10 @@ o_create_custom_scan_state(CustomScan *cscan)
 		}
 		ix_plan_state->ostate.onlyCurIx =
 			intVal(lfourth(cscan->custom_private));
+		ix_plan_state->ostate.sortedPkFetch =
+			intVal(list_nth(cscan->custom_private, 4));
+		ix_plan_state->ostate.rowBound =
+			Max(intVal(list_nth(cscan->custom_private, 5)), 0);
 
 		ocstate->o_plan_state = (OPlanState *) ix_plan_state;
 	}
@@ -572,6 +809,13 @@ o_create_custom_scan_state(CustomScan *cscan)
 		bitmap_state->bitmapqualorig = copyObject(bh_scan->bitmapqualorig);
 		ocstate->o_plan_state = (OPlanState *) bitmap_state;
 	}
+	else if (plan_tag == O_SeqScanPlan)
+	{
+		OSeqScanPlanState *seq_state =
+			(OSeqScanPlanState *) palloc0(sizeof(OSeqScanPlanState));
+
+		ocstate->o_plan_state = (OPlanState *) seq_state;
+	}
 	else
 	{
 		Assert(false);
@@ -619,8 +863,25 @@ o_begin_custom_scan(CustomScanState *node, EState *estate, int eflags)
 							  &ix_plan_state->iss_NumScanKeys);
 		index_close(index, AccessShareLock);
 
+		/*
+		 * Quals of index-only scans reference the index tuple, so they are
+		 * left to the executor.
+		 */
+		if (!scan_state->onlyCurIx)
+			o_index_scan_init_filters(scan_state, ix_descr,
+									  node->ss.ps.plan->qual,
+									  ((Scan *) node->ss.ps.plan)->scanrelid);
+
 		ix_plan_state->iss_RuntimeContext = CreateExprContext(estate);
 
+		/*
+		 * Parameterized scans are restarted for each outer row.  Keep their
+		 * iterators across the rescans, so that the next scan could start
+		 * from the same leaf page, if the new key is there.
+		 */
+		if (ix_plan_state->iss_NumRuntimeKeys != 0)
+			scan_state->rescanCxt = estate->es_query_cxt;
+
 		/*
 		 * If no run-time keys to calculate or they are ready, go ahead and
 		 * pass the scankeys to the index AM.
@@ -635,6 +896,8 @@ o_begin_custom_scan(CustomScanState *node, EState *estate, int eflags)
 
 		bitmap_state->bitmapqualplanstate =
 			ExecInitNode(bitmap_state->bitmapqualplan, estate, eflags);
+		bitmap_state->bitmapqualorigstate =
+			ExecInitQual(bitmap_state->bitmapqualorig, &node->ss.ps);
 
 		if (ocstate->useEaCounters)
 		{
@@ -653,6 +916,60 @@ o_begin_custom_scan(CustomScanState *node, EState *estate, int eflags)
 												  "orioledb_cs plan data",
 												  ALLOCSET_DEFAULT_SIZES);
 	}
+	else if (ocstate->o_plan_state->type == O_SeqScanPlan)
+	{
+		OSeqScanPlanState *seq_state =
+			(OSeqScanPlanState *) ocstate->o_plan_state;
+
+		O_LOAD_SNAPSHOT(&seq_state->oSnapshot, estate->es_snapshot);
+		seq_state->zoneMap =
+			o_zone_map_qual_from_clauses(GET_PRIMARY(descr),
+										 node->ss.ps.plan->qual,
+										 ((Scan *) node->ss.ps.plan)->scanrelid);
+	}
+}
+
+/*
+ * Fetches the next tuple of the sequential scan, which satisfies the quals.
+ */
+static TupleTableSlot *
+o_exec_seq_scan_fetch(OSeqScanPlanState *seq_state, CustomScanState *node)
+{
+	OTableDescr *descr = relation_get_descr(node->ss.ss_currentRelation);
+	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
+
+	if (seq_state->scan == NULL)
+	{
+		seq_state->scan = make_btree_seq_scan(&GET_PRIMARY(descr)->desc,
+											  &seq_state->oSnapshot, NULL);
+		if (seq_state->zoneMap)
+			btree_seq_scan_set_zone_map(seq_state->scan, seq_state->zoneMap,
+										&seq_state->zoneMapSkipped);
+	}
+
+	while (true)
+	{
+		OTuple		tuple;
+		BTreeLocationHint hint;
+		CommitSeqNo tupleCsn;
+		bool		allocated;
+
+		/*
+		 * The slot refers to the private page image of the scan, unless the
+		 * tuple version is taken from undo.
+		 */
+		tuple = btree_seq_scan_getnext_ref(seq_state->scan, slot->tts_mcxt,
+										   &tupleCsn, &hint, &allocated);
+		if (O_TUPLE_IS_NULL(tuple))
+			return ExecClearTuple(slot);
+
+		tts_orioledb_store_tuple(slot, tuple, descr, tupleCsn,
+								 PrimaryIndexNumber, allocated, &hint);
+
+		if (o_exec_qual(node->ss.ps.ps_ExprContext, node->ss.ps.qual, slot))
+			return slot;
+		InstrCountFiltered1(node, 1);
+	}
 }
 
 /*
@@ -750,6 +1067,11 @@ o_exec_custom_scan(CustomScanState *node)
 
 		slot = o_exec_bitmap_fetch(bitmap_state->scan, node);
 	}
+	else if (ocstate->o_plan_state->type == O_SeqScanPlan)
+	{
+		slot = o_exec_seq_scan_fetch((OSeqScanPlanState *) ocstate->o_plan_state,
+									 node);
+	}
 
 	slot = o_exec_project(node->ss.ps.ps_ProjInfo, node->ss.ps.ps_ExprContext,
 						  slot, NULL);
@@ -784,16 +1106,25 @@ o_rescan_custom_scan(CustomScanState *node)
 		btrescan(&ix_plan_state->ostate.scandesc, ix_plan_state->iss_ScanKeys,
 				 ix_plan_state->iss_NumScanKeys, NULL, 0);
 
-		if (node->ss.ps.chgParam != NULL)
-		{
-			MemoryContextReset(ix_plan_state->ostate.cxt);
-		}
-		else if (ix_plan_state->ostate.iterator != NULL)
+		if (ix_plan_state->ostate.iterator != NULL)
 		{
-			btree_iterator_free(ix_plan_state->ostate.iterator);
+			OScanState *ostate = &ix_plan_state->ostate;
+
+			/* Only iterators outside of cxt survive its reset */
+			if (ostate->rescanCxt != NULL && ostate->pscan == NULL &&
+				ostate->rescanIterator == NULL &&
+				ostate->scanDir == ForwardScanDirection)
+				ostate->rescanIterator = ostate->iterator;
+			else
+				btree_iterator_free(ostate->iterator);
 		}
+		if (node->ss.ps.chgParam != NULL)
+			MemoryContextReset(ix_plan_state->ostate.cxt);
+		o_index_scan_discard_batch(&ix_plan_state->ostate);
+		o_index_scan_discard_pk_batch(&ix_plan_state->ostate);
 
 		ix_plan_state->ostate.curKeyRangeIsLoaded = false;
+		ix_plan_state->ostate.rowsReturned = 0;
 		ix_plan_state->ostate.numPrefixExactKeys = o_get_num_prefix_exact_keys(ix_plan_state->iss_ScanKeys, ix_plan_state->iss_NumScanKeys);
 		ix_plan_state->ostate.curKeyRange.empty = true;
 		ix_plan_state->ostate.curKeyRange.low.n_row_keys = 0;
@@ -813,6 +1144,15 @@ o_rescan_custom_scan(CustomScanState *node)
 			pfree(bitmap_state->eaCounters);
 		bitmap_state->scan = NULL;
 	}
+	else if (ocstate->o_plan_state->type == O_SeqScanPlan)
+	{
+		OSeqScanPlanState *seq_state =
+			(OSeqScanPlanState *) ocstate->o_plan_state;
+
+		if (seq_state->scan)
+			free_btree_seq_scan(seq_state->scan);
+		seq_state->scan = NULL;
+	}
 }
 
 /*
@@ -833,6 +1173,10 @@ o_end_custom_scan(CustomScanState *node)
 
 		if (ix_plan_state->ostate.iterator != NULL)
 			btree_iterator_free(ix_plan_state->ostate.iterator);
+		if (ix_plan_state->ostate.rescanIterator != NULL)
+			btree_iterator_free(ix_plan_state->ostate.rescanIterator);
+		o_index_scan_discard_batch(&ix_plan_state->ostate);
+		o_index_scan_discard_pk_batch(&ix_plan_state->ostate);
 		MemoryContextDelete(ix_plan_state->ostate.cxt);
 		ix_plan_state->ostate.cxt = NULL;
 	}
@@ -850,9 +1194,78 @@ o_end_custom_scan(CustomScanState *node)
 		MemoryContextDelete(bitmap_state->cxt);
 		bitmap_state->cxt = NULL;
 	}
+	else if (ocstate->o_plan_state->type == O_SeqScanPlan)
+	{
+		OSeqScanPlanState *seq_state =
+			(OSeqScanPlanState *) ocstate->o_plan_state;
+
+		if (seq_state->scan)
+			free_btree_seq_scan(seq_state->scan);
+		seq_state->scan = NULL;
+	}
 	ea_counters = NULL;
 }
 
+/*
+ * Parallel custom scan.  Only bitmap heap scans are parallel-aware.
+ */
+static Size
+o_estimate_dsm_custom_scan(CustomScanState *node, ParallelContext *pcxt)
+{
+	OCustomScanState *ocstate = (OCustomScanState *) node;
+
+	Assert(ocstate->o_plan_state->type == O_BitmapHeapPlan);
+	return sizeof(ParallelOBitmapScanData);
+}
+
+static void
+o_initialize_dsm_custom_scan(CustomScanState *node, ParallelContext *pcxt,
+							 void *coordinate)
+{
+	OCustomScanState *ocstate = (OCustomScanState *) node;
+	OBitmapHeapPlanState *bitmap_state;
+
+	Assert(ocstate->o_plan_state->type == O_BitmapHeapPlan);
+	bitmap_state = (OBitmapHeapPlanState *) ocstate->o_plan_state;
+
+	/*
+	 * Without the DSA area (no DSM segment available) the leader runs the
+	 * whole scan alone.
+	 */
+	if (node->ss.ps.state->es_query_dsa == NULL)
+		return;
+
+	o_init_parallel_bitmap_scan((ParallelOBitmapScan) coordinate);
+	bitmap_state->pscan = (ParallelOBitmapScan) coordinate;
+}
+
+static void
+o_reinitialize_dsm_custom_scan(CustomScanState *node, ParallelContext *pcxt,
+							   void *coordinate)
+{
+	OCustomScanState *ocstate = (OCustomScanState *) node;
+	OBitmapHeapPlanState *bitmap_state;
+
+	Assert(ocstate->o_plan_state->type == O_BitmapHeapPlan);
+	bitmap_state = (OBitmapHeapPlanState *) ocstate->o_plan_state;
+
+	if (bitmap_state->pscan)
+		o_reinit_parallel_bitmap_scan(bitmap_state->pscan,
+									  node->ss.ps.state->es_query_dsa);
+}
+
+static void
+o_initialize_worker_custom_scan(CustomScanState *node, shm_toc *toc,
+								void *coordinate)
+{
+	OCustomScanState *ocstate = (OCustomScanState *) node;
+	OBitmapHeapPlanState *bitmap_state;
+
+	Assert(ocstate->o_plan_state->type == O_BitmapHeapPlan);
+	bitmap_state = (OBitmapHeapPlanState *) ocstate->o_plan_state;
+	bitmap_state->pscan = (ParallelOBitmapScan) coordinate;
+}
+
 typedef struct OExplainContext
 {
 	List	   *ancestors;
@@ -1093,6 +1506,283 @@ o_explain_custom_scan(CustomScanState *node, List *ancestors, ExplainState *es)
 			ExplainCloseGroup("Plans", "Plans", false, es);
 		}
 	}
+	else if (ocstate->o_plan_state->type == O_SeqScanPlan)
+	{
+		OSeqScanPlanState *seq_state =
+			(OSeqScanPlanState *) ocstate->o_plan_state;
+
+		switch (es->format)
+		{
+			case EXPLAIN_FORMAT_TEXT:
+				appendStringInfoSpaces(es->str, es->indent * 2);
+				appendStringInfoString(es->str, "Seq scan\n");
+				break;
+
+			case EXPLAIN_FORMAT_XML:
+			case EXPLAIN_FORMAT_YAML:
+			case EXPLAIN_FORMAT_JSON:
+				ExplainPropertyText("Custom Scan Subtype", "Seq Scan", es);
+				break;
+		}
+
+		if (node->ss.ps.qual)
+			show_instrumentation_count("Rows Removed by Filter", 1,
+									   &node->ss.ps, es);
+		if (es->analyze && seq_state->zoneMap)
+			ExplainPropertyUInteger("Zone Map Skipped Leaves", NULL,
+									seq_state->zoneMapSkipped, es);
+	}
 	if (ocstate->useEaCounters)
 		eanalyze_counters_explain(descr, &ocstate->eaCounters, es);
 }
+
+/*
+ * count(*) pushdown.
+ *
+ * Plain "SELECT count(*) FROM tbl" is planned as a single custom scan node,
+ * which counts the visible tuples of the primary tree without storing them
+ * into slots and passing each of them to the aggregate.
+ */
+
+typedef struct OCountScanState
+{
+	CustomScanState css;
+	Relation	rel;
+	OSnapshot	oSnapshot;
+	bool		done;
+} OCountScanState;
+
+create_upper_paths_hook_type old_create_upper_paths_hook = NULL;
+bool		orioledb_enable_count_pushdown = false;
+
+static void
+o_begin_count_scan(CustomScanState *node, EState *estate, int eflags)
+{
+	OCountScanState *cstate = (OCountScanState *) node;
+	CustomScan *cscan = (CustomScan *) node->ss.ps.plan;
+
+	/* The relation is locked as a member of the range table */
+	cstate->rel = table_open(intVal(linitial(cscan->custom_private)), NoLock);
+	O_LOAD_SNAPSHOT(&cstate->oSnapshot, estate->es_snapshot);
+	cstate->done = false;
+}
+
+static TupleTableSlot *
+o_exec_count_scan(CustomScanState *node)
+{
+	OCountScanState *cstate = (OCountScanState *) node;
+	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
+	OTableDescr *descr;
+	BTreeSeqScan *scan;
+	int64		count = 0;
+	int			i;
+
+	if (cstate->done)
+		return ExecClearTuple(slot);
+	cstate->done = true;
+
+	descr = relation_get_descr(cstate->rel);
+	scan = make_btree_seq_scan(&GET_PRIMARY(descr)->desc,
+							   &cstate->oSnapshot, NULL);
+	while (true)
+	{
+		OTuple		tuple;
+		BTreeLocationHint hint;
+		CommitSeqNo tupleCsn;
+		bool		allocated;
+
+		tuple = btree_seq_scan_getnext_ref(scan, CurrentMemoryContext,
+										   &tupleCsn, &hint, &allocated);
+		if (O_TUPLE_IS_NULL(tuple))
+			break;
+		if (allocated)
+			pfree(tuple.data);
+		count++;
+
+		CHECK_FOR_INTERRUPTS();
+	}
+	free_btree_seq_scan(scan);
+
+	/* Every column of the scan tuple is the same count(*) */
+	ExecClearTuple(slot);
+	for (i = 0; i < slot->tts_tupleDescriptor->natts; i++)
+	{
+		slot->tts_values[i] = Int64GetDatum(count);
+		slot->tts_isnull[i] = false;
+	}
+	ExecStoreVirtualTuple(slot);
+
+	return o_exec_project(node->ss.ps.ps_ProjInfo, node->ss.ps.ps_ExprContext,
+						  slot, NULL);
+}
+
+static void
+o_end_count_scan(CustomScanState *node)
+{
+	OCountScanState *cstate = (OCountScanState *) node;
+
+	table_close(cstate->rel, NoLock);
+}
+
+static void
+o_rescan_count_scan(CustomScanState *node)
+{
+	((OCountScanState *) node)->done = false;
+}
+
+static void
+o_explain_count_scan(CustomScanState *node, List *ancestors,
+					 ExplainState *es)
+{
+	OCountScanState *cstate = (OCountScanState *) node;
+
+	ExplainPropertyText("Count Rows Of", RelationGetRelationName(cstate->rel),
+						es);
+}
+
+static CustomExecMethods o_count_exec_methods =
+{
+	.CustomName = "o_count_exec_scan",
+	.BeginCustomScan = o_begin_count_scan,
+	.ExecCustomScan = o_exec_count_scan,
+	.EndCustomScan = o_end_count_scan,
+	.ReScanCustomScan = o_rescan_count_scan,
+	.ExplainCustomScan = o_explain_count_scan
+};
+
+static Node *
+o_create_count_scan_state(CustomScan *cscan)
+{
+	OCountScanState *cstate = palloc0(sizeof(OCountScanState));
+
+	NodeSetTag(cstate, T_CustomScanState);
+	cstate->css.methods = &o_count_exec_methods;
+	cstate->css.slotOps = &TTSOpsVirtual;
+
+	return (Node *) cstate;
+}
+
+CustomScanMethods o_count_scan_methods =
+{
+	"o_count_scan",
+	o_create_count_scan_state
+};
+
+/*
+ * The scan tuple consists of the count(*) aggregates themselves, so setrefs
+ * replaces them in the targetlist with the references to the scan tuple.
+ */
+static Plan *
+o_plan_count_path(PlannerInfo *root, RelOptInfo *rel,
+				  CustomPath *best_path, List *tlist,
+				  List *clauses, List *custom_plans)
+{
+	CustomScan *custom_scan = makeNode(CustomScan);
+
+	custom_scan->scan.plan.targetlist = tlist;
+	custom_scan->scan.plan.qual = NIL;
+	custom_scan->scan.scanrelid = 0;
+	custom_scan->flags = best_path->flags;
+	custom_scan->methods = &o_count_scan_methods;
+	custom_scan->custom_scan_tlist = copyObject(tlist);
+	custom_scan->custom_private = best_path->custom_private;
+
+	return (Plan *) custom_scan;
+}
+
+static CustomPathMethods o_count_path_methods =
+{
+	.CustomName = "o_count_path",
+	.PlanCustomPath = o_plan_count_path
+};
+
+/*
+ * Returns the oid of the orioledb table if the query is nothing but count(*)
+ * over all its rows.  Returns InvalidOid otherwise.
+ */
+static Oid
+o_count_pushdown_reloid(PlannerInfo *root, RelOptInfo *input_rel,
+						PathTarget *target)
+{
+	Query	   *parse = root->parse;
+	RangeTblEntry *rte;
+	Relation	relation;
+	ListCell   *lc;
+	Oid			result = InvalidOid;
+	int			relid;
+
+	if (parse->commandType != CMD_SELECT || !parse->hasAggs ||
+		parse->groupClause != NIL || parse->groupingSets != NIL ||
+		parse->havingQual != NULL || parse->rowMarks != NIL ||
+		parse->hasWindowFuncs || parse->hasTargetSRFs ||
+		target->exprs == NIL)
+		return InvalidOid;
+
+	if (input_rel->reloptkind != RELOPT_BASEREL ||
+		!bms_get_singleton_member(input_rel->relids, &relid) ||
+		input_rel->baserestrictinfo != NIL)
+		return InvalidOid;
+
+	foreach(lc, target->exprs)
+	{
+		Aggref	   *aggref = (Aggref *) lfirst(lc);
+
+		if (!IsA(aggref, Aggref) || aggref->aggfnoid != F_COUNT_ ||
+			aggref->agglevelsup != 0 || aggref->aggfilter != NULL ||
+			aggref->aggdistinct != NIL || aggref->aggorder != NIL)
+			return InvalidOid;
+	}
+
+	rte = planner_rt_fetch(relid, root);
+	if (rte->rtekind != RTE_RELATION || rte->inh || rte->tablesample ||
+		(rte->relkind != RELKIND_RELATION && rte->relkind != RELKIND_MATVIEW))
+		return InvalidOid;
+
+	relation = table_open(rte->relid, NoLock);
+	if (is_orioledb_rel(relation))
+		result = rte->relid;
+	table_close(relation, NoLock);
+
+	return result;
+}
+
+/*
+ * Adds the count(*) pushdown path for the plain count(*) queries.  The path
+ * is costed as a sequential scan without the per-tuple processing.
+ */
+void
+orioledb_create_upper_paths_hook(PlannerInfo *root, UpperRelationKind stage,
+								 RelOptInfo *input_rel, RelOptInfo *output_rel,
+								 void *extra)
+{
+	if (old_create_upper_paths_hook)
+		old_create_upper_paths_hook(root, stage, input_rel, output_rel, extra);
+
+	if (orioledb_enable_count_pushdown && stage == UPPERREL_GROUP_AGG)
+	{
+		PathTarget *target = root->upper_targets[UPPERREL_GROUP_AGG];
+		Oid			reloid = o_count_pushdown_reloid(root, input_rel, target);
+		CustomPath *path;
+		double		spc_seq_page_cost;
+		Cost		cost;
+
+		if (!OidIsValid(reloid))
+			return;
+
+		get_tablespace_page_costs(input_rel->reltablespace, NULL,
+								  &spc_seq_page_cost);
+		cost = spc_seq_page_cost * input_rel->pages +
+			cpu_operator_cost * input_rel->tuples;
+
+		path = makeNode(CustomPath);
+		path->path.pathtype = T_CustomScan;
+		path->path.parent = output_rel;
+		path->path.pathtarget = target;
+		path->path.rows = 1;
+		path->path.startup_cost = cost;
+		path->path.total_cost = cost;
+		path->methods = &o_count_path_methods;
+		path->custom_private = list_make1(makeInteger(reloid));
+		add_path(output_rel, &path->path);
+	}
+}
@@ -21,17 +21,22 @@
 #include "catalog/o_sys_cache.h"
 #include "catalog/sys_trees.h"
 #include "recovery/recovery.h"
+#include "tableam/key_range.h"
 #include "tableam/toast.h"
 #include "tableam/tree.h"
 #include "tuple/toast.h"
 #include "utils/stopevent.h"
 
 #include "access/nbtree.h"
+#include "catalog/pg_collation.h"
 #include "catalog/pg_type.h"
 #include "miscadmin.h"
 #include "parser/parse_coerce.h"
 #include "utils/builtins.h"
+#include "utils/date.h"
 #include "utils/syscache.h"
+#include "utils/timestamp.h"
+#include "utils/uuid.h"
 
 static uint32 o_idx_hash(BTreeDescr *desc, OTuple tuple, BTreeKeyType kind);
 static uint32 o_toast_hash(BTreeDescr *desc, OTuple tuple, BTreeKeyType kind);
@@ -51,6 +56,8 @@ static OTuple o_create_key_tuple(BTreeDescr *desc, OTuple tuple,
 static bool pk_needs_undo(BTreeDescr *desc, BTreeOperationType action,
 						  OTuple oldTuple, OTupleXactInfo oldXactInfo,
 						  bool oldDeleted, OTuple newTuple, OXid newOxid);
+static bool o_idx_key_image(BTreeDescr *desc, void *p, BTreeKeyType keyType,
+							OKeyImage *image);
 
 static BTreeOps primaryOps = {
 	.len = o_idx_len,
@@ -58,6 +65,7 @@ static BTreeOps primaryOps = {
 	.tuple_make_key = o_tuple_make_key,
 	.needs_undo = pk_needs_undo,
 	.cmp = o_idx_cmp,
+	.key_image = o_idx_key_image,
 	.hash = o_idx_hash,
 	.unique_hash = o_idx_unique_hash
 },
@@ -68,6 +76,7 @@ static BTreeOps primaryOps = {
 	.tuple_make_key = o_sidx_tuple_make_key,
 	.needs_undo = NULL,
 	.cmp = o_idx_cmp,
+	.key_image = o_idx_key_image,
 	.hash = o_idx_hash,
 	.unique_hash = o_idx_unique_hash
 },
@@ -121,6 +130,7 @@ index_btree_desc_init(BTreeDescr *desc, OCompress compress, int fillfactor,
 		desc->storageType = BTreeStoragePersistence;
 	desc->undoType = UndoLogRegular;
 	desc->createOxid = createOxid;
+	desc->lastExtentEnd = 0;
 }
 
 static inline OIndexDescr *
@@ -135,15 +145,18 @@ o_get_key_len(BTreeDescr *desc, OTuple tuple, OIndexType type, bool keepVersion)
 	OIndexDescr *id = o_get_tree_def(desc);
 	Datum		values[INDEX_MAX_KEYS];
 	bool		isnull[INDEX_MAX_KEYS] = {false};
+	OTupleReaderState reader;
 	int			i,
 				len;
 
+	o_tuple_init_reader(&reader, tuple, id->leafTupdesc, &id->leafSpec);
 	for (i = 0; i < id->nonLeafTupdesc->natts; i++)
 	{
 		int			attnum = (type == oIndexPrimary) ? id->fields[i].tableAttnum : i + 1;
 
 		Assert(attnum > 0);
-		values[i] = o_fastgetattr(tuple, attnum, id->leafTupdesc, &id->leafSpec, &isnull[i]);
+		values[i] = o_tuple_read_field(&reader, tuple, attnum, &id->leafSpec,
+									&isnull[i]);
 	}
 
 	len = o_new_tuple_size(id->nonLeafTupdesc, &id->nonLeafSpec, NULL,
@@ -182,6 +195,7 @@ o_create_key_tuple(BTreeDescr *desc, OTuple tuple, Pointer data,
 	OIndexDescr *id = o_get_tree_def(desc);
 	Datum		key[INDEX_MAX_KEYS];
 	bool		isnull[INDEX_MAX_KEYS] = {false};
+	OTupleReaderState reader;
 	int			i,
 				len;
 	OTuple		result;
@@ -189,12 +203,14 @@ o_create_key_tuple(BTreeDescr *desc, OTuple tuple, Pointer data,
 
 	Assert(type == oIndexPrimary || type == oIndexRegular);
 
+	o_tuple_init_reader(&reader, tuple, id->leafTupdesc, &id->leafSpec);
 	for (i = 0; i < id->nonLeafTupdesc->natts; i++)
 	{
 		int			attnum = (type == oIndexPrimary) ? id->fields[i].tableAttnum : i + 1;
 
 		Assert(attnum > 0);
-		key[i] = o_fastgetattr(tuple, attnum, id->leafTupdesc, &id->leafSpec, &isnull[i]);
+		key[i] = o_tuple_read_field(&reader, tuple, attnum, &id->leafSpec,
+									&isnull[i]);
 	}
 
 	len = o_new_tuple_size(id->nonLeafTupdesc, &id->nonLeafSpec, NULL, version, key, isnull, NULL);
@@ -444,7 +460,7 @@ static inline bool
 o_bound_is_coercible(OBTreeValueBound *bound, OIndexField *field)
 {
 	return (bound->flags & O_VALUE_BOUND_COERCIBLE) ||
-		IsBinaryCoercible(bound->type, field->inputtype);
+		o_is_binary_coercible(bound->type, field->inputtype);
 }
 
 /* fills key bound from tuple or index tuple that belongs to current BTree */
@@ -582,7 +598,7 @@ o_idx_cmp_range_key_to_value(OBTreeValueBound *bound1, OIndexField *field,
 		if ((bound1->flags & O_VALUE_BOUND_COERCIBLE) && bound1->value == value)
 			cmp = 0;
 		else if (o_bound_is_coercible(bound1, field))
-			cmp = o_call_comparator(field->comparator, bound1->value, value);
+			cmp = o_call_field_comparator(field, bound1->value, value);
 		else
 			cmp = o_call_comparator(bound1->comparator, bound1->value, value);
 
@@ -663,7 +679,7 @@ o_idx_cmp_tuples(OIndexDescr *id,
 
 			if (!isnull1 && !isnull2)
 			{
-				cmp = o_call_comparator(field->comparator, value1, value2);
+				cmp = o_call_field_comparator(field, value1, value2);
 				if (!field->ascending)
 					cmp = -cmp;
 			}
@@ -772,8 +788,8 @@ o_idx_cmp_value_bounds(OBTreeValueBound *bound1,
 			bool		coercible2 = o_bound_is_coercible(bound2, field);
 
 			if (coercible1 && coercible2)
-				res = o_call_comparator(field->comparator, bound1->value,
-										bound2->value);
+				res = o_call_field_comparator(field, bound1->value,
+											  bound2->value);
 			else if (coercible1)
 				res = -o_call_comparator(bound2->comparator, bound2->value,
 										 bound1->value);
@@ -919,6 +935,259 @@ o_idx_cmp(BTreeDescr *desc,
 	return 0;
 }
 
+/*
+ * Returns the kind of normalized image for the values of given index field.
+ * Only built-in operator families whose ordering matches the ordering of the
+ * image are supported.
+ */
+static OKeyImageType
+o_index_field_key_image_type(OIndexField *field)
+{
+	switch (field->opfamily)
+	{
+		case O_INTEGER_BTREE_FAM_OID:
+			if (field->inputtype == INT2OID ||
+				field->inputtype == INT4OID ||
+				field->inputtype == INT8OID)
+				return OKeyImageInt;
+			break;
+		case O_OID_BTREE_FAM_OID:
+			if (field->inputtype == OIDOID)
+				return OKeyImageOid;
+			break;
+		case O_TID_BTREE_FAM_OID:
+			if (field->inputtype == TIDOID)
+				return OKeyImageTid;
+			break;
+		case O_DATETIME_BTREE_FAM_OID:
+			if (field->inputtype == DATEOID)
+				return OKeyImageDate;
+			if (field->inputtype == TIMESTAMPOID ||
+				field->inputtype == TIMESTAMPTZOID)
+				return OKeyImageTimestamp;
+			break;
+		case O_UUID_BTREE_FAM_OID:
+			if (field->inputtype == UUIDOID)
+				return OKeyImageUuid;
+			break;
+		case O_TEXT_BTREE_FAM_OID:
+			/* Only bytewise collations are ordered like memcmp() */
+			if (field->inputtype == TEXTOID &&
+				(field->collation == C_COLLATION_OID ||
+				 field->collation == POSIX_COLLATION_OID))
+				return OKeyImageText;
+			break;
+		case O_BYTEA_BTREE_FAM_OID:
+			if (field->inputtype == BYTEAOID)
+				return OKeyImageBytea;
+			break;
+		default:
+			break;
+	}
+	return OKeyImageNone;
+}
+
+/*
+ * Fills the kinds of normalized images for the leading index fields.  We
+ * stop on the first field without an image or with an inexact image,
+ * because the following fields are never reached by o_key_image_cmp().
+ */
+void
+o_index_fill_key_image_types(OIndexDescr *id)
+{
+	int			i;
+
+	id->nKeyImageFields = 0;
+	for (i = 0; i < Min(id->nKeyFields, O_KEY_IMAGE_MAX_VALUES); i++)
+	{
+		OKeyImageType type;
+
+		if (id->desc.type == oIndexPrimary && id->fields[i].tableAttnum <= 0)
+			break;
+
+		type = o_index_field_key_image_type(&id->fields[i]);
+		if (type == OKeyImageNone)
+			break;
+
+		id->keyImageTypes[i] = type;
+		id->nKeyImageFields++;
+		if (!OKeyImageIsExact(type))
+			break;
+	}
+}
+
+/*
+ * Image of the bytes sequence: big-endian first 8 bytes padded with zeros.
+ */
+static inline uint64
+o_bytes_get_key_image(const uint8 *data, int len)
+{
+	uint64		image = 0;
+	int			i;
+
+	for (i = 0; i < sizeof(uint64); i++)
+		image = (image << 8) | (i < len ? data[i] : 0);
+	return image;
+}
+
+#define INT64_GET_KEY_IMAGE(value) \
+	((uint64) (value) ^ (UINT64CONST(1) << 63))
+
+static bool
+o_datum_get_key_image(OKeyImageType imageType, Oid fieldType,
+					  Datum value, Oid type, uint64 *image)
+{
+	/* Cross-type values are supported only for integers */
+	if (imageType != OKeyImageInt && type != fieldType)
+		return false;
+
+	switch (imageType)
+	{
+		case OKeyImageInt:
+			if (type == INT2OID)
+				*image = INT64_GET_KEY_IMAGE(DatumGetInt16(value));
+			else if (type == INT4OID)
+				*image = INT64_GET_KEY_IMAGE(DatumGetInt32(value));
+			else if (type == INT8OID)
+				*image = INT64_GET_KEY_IMAGE(DatumGetInt64(value));
+			else
+				return false;
+			return true;
+		case OKeyImageOid:
+			*image = (uint64) DatumGetObjectId(value);
+			return true;
+		case OKeyImageTid:
+			{
+				ItemPointer iptr = DatumGetItemPointer(value);
+
+				*image = ((uint64) ItemPointerGetBlockNumberNoCheck(iptr) << 16) |
+					(uint64) ItemPointerGetOffsetNumberNoCheck(iptr);
+				return true;
+			}
+		case OKeyImageDate:
+			*image = INT64_GET_KEY_IMAGE(DatumGetDateADT(value));
+			return true;
+		case OKeyImageTimestamp:
+			*image = INT64_GET_KEY_IMAGE(DatumGetTimestamp(value));
+			return true;
+		case OKeyImageUuid:
+			/* uuid_cmp() is memcmp() */
+			*image = o_bytes_get_key_image(DatumGetUUIDP(value)->data,
+										   UUID_LEN);
+			return true;
+		case OKeyImageText:
+		case OKeyImageBytea:
+			{
+				Pointer		ptr = DatumGetPointer(value);
+
+				if (VARATT_IS_EXTERNAL(ptr) || VARATT_IS_COMPRESSED(ptr))
+					return false;
+				*image = o_bytes_get_key_image((uint8 *) VARDATA_ANY(ptr),
+											   VARSIZE_ANY_EXHDR(ptr));
+				return true;
+			}
+		default:
+			return false;
+	}
+}
+
+/*
+ * Fills normalized image of the leading key columns.  Descending columns get
+ * an inverted image, so the image order always matches o_idx_cmp().
+ */
+static bool
+o_idx_key_image(BTreeDescr *desc, void *p, BTreeKeyType keyType,
+				OKeyImage *image)
+{
+	OIndexDescr *id = o_get_tree_def(desc);
+	OBTreeKeyBound *bound = NULL;
+	OTuple	   *tuple = NULL;
+	TupleDesc	tupdesc = NULL;
+	OTupleFixedFormatSpec *spec = NULL;
+	int			i,
+				n = id->nKeyImageFields;
+
+	image->nvalues = 0;
+	image->nexact = 0;
+
+	if (n == 0)
+		return false;
+
+	if (IS_BOUND_KEY_TYPE(keyType))
+	{
+		bound = (OBTreeKeyBound *) p;
+		if (bound->n_row_keys > 0)
+			return false;
+		if (keyType != BTreeKeyBound)
+			n = Min(n, id->nUniqueFields);
+	}
+	else
+	{
+		Assert(keyType == BTreeKeyLeafTuple || keyType == BTreeKeyNonLeafKey);
+		tuple = (OTuple *) p;
+		if (keyType == BTreeKeyLeafTuple)
+		{
+			tupdesc = id->leafTupdesc;
+			spec = &id->leafSpec;
+		}
+		else
+		{
+			tupdesc = id->nonLeafTupdesc;
+			spec = &id->nonLeafSpec;
+		}
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		OIndexField *field = &id->fields[i];
+		Datum		value;
+		Oid			type;
+		uint64		valueImage;
+		bool		exact = true;
+
+		if (bound)
+		{
+			OBTreeValueBound *valueBound = &bound->keys[i];
+
+			if (valueBound->flags & O_VALUE_BOUND_NO_VALUE)
+				break;
+			value = valueBound->value;
+			type = valueBound->type;
+
+			/*
+			 * Strict bound isn't equal to the tuple having the same value.
+			 * Let the full comparison decide then, and don't let the image
+			 * go on to the next columns.
+			 */
+			if (!(valueBound->flags & O_VALUE_BOUND_INCLUSIVE))
+				exact = false;
+		}
+		else
+		{
+			bool		isnull;
+
+			value = o_fastgetattr(*tuple,
+								  OIndexKeyAttnumToTupleAttnum(keyType, id, i + 1),
+								  tupdesc, spec, &isnull);
+			if (isnull)
+				break;
+			type = field->inputtype;
+		}
+
+		if (!o_datum_get_key_image(id->keyImageTypes[i], field->inputtype,
+								   value, type, &valueImage))
+			break;
+
+		image->values[i] = field->ascending ? valueImage : ~valueImage;
+		image->nvalues++;
+		if (!exact || !OKeyImageIsExact(id->keyImageTypes[i]))
+			break;
+		image->nexact++;
+	}
+
+	return image->nvalues > 0;
+}
+
 static bool
 pk_needs_undo(BTreeDescr *desc, BTreeOperationType action,
 			  OTuple oldTuple, OTupleXactInfo oldXactInfo, bool oldDeleted,
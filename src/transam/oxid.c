@@ -18,15 +18,19 @@
 #include "recovery/recovery.h"
 #include "transam/oxid.h"
 #include "utils/o_buffers.h"
+#include "utils/o_wait_events.h"
+#include "workers/rollback.h"
 
 #include "access/transam.h"
 #include "access/twophase.h"
+#include "funcapi.h"
 #include "miscadmin.h"
 #include "storage/lmgr.h"
 #include "storage/sinvaladt.h"
 #include "storage/procsignal.h"
 #include "storage/proc.h"
 #include "utils/snapmgr.h"
+#include "utils/tuplestore.h"
 
 #define XID_FILE_SIZE (0x1000000)
 
@@ -69,7 +73,20 @@ static OXidMapItem *xidBuffer;
 
 XidMeta    *xid_meta;
 
-pg_atomic_uint32 *logicalXidsShmemMap;
+pg_atomic_uint64 *oProcXmins;
+
+/*
+ * Map of logical xids in use.  Every process starts searching for a free
+ * logical xid from its own word, so words are padded to the cache line size
+ * to prevent false sharing between processes.
+ */
+typedef union
+{
+	pg_atomic_uint32 bits;
+	char		pad[PG_CACHE_LINE_SIZE];
+} LogicalXidsMapItem;
+
+static LogicalXidsMapItem *logicalXidsShmemMap;
 
 OSnapshot	o_in_progress_snapshot = {COMMITSEQNO_INPROGRESS, InvalidXLogRecPtr, 0};
 OSnapshot	o_non_deleted_snapshot = {COMMITSEQNO_NON_DELETED, InvalidXLogRecPtr, 0};
@@ -81,6 +98,37 @@ static OBuffersDesc buffersDesc = {
 	.bufferCtlTrancheName = "xidBuffersCtlTranche"
 };
 
+/*
+ * Backend-local cache of finished oxids.  Once the transaction is finished,
+ * its csn and commit ptr in the xid map never change (apart from freezing,
+ * which doesn't change the visibility).  So, we can remember them and skip
+ * map_oxid() for oxids met repeatedly by visibility checks.
+ */
+#define OXID_CSN_CACHE_SIZE	256
+
+typedef struct
+{
+	OXid		oxid;
+	CommitSeqNo csn;			/* COMMITSEQNO_INPROGRESS if not cached */
+	XLogRecPtr	ptr;			/* InvalidXLogRecPtr if not cached */
+} OXidCsnCacheEntry;
+
+static OXidCsnCacheEntry oxidCsnCache[OXID_CSN_CACHE_SIZE];
+
+/*
+ * Adaptive number of spins in wait_for_oxid() before sleeping on the
+ * transaction lock.  It grows when the transaction finishes while we spin,
+ * and slowly shrinks otherwise.  So the spin phase is only used when the
+ * conflicting transactions are usually short.
+ */
+#define MIN_OXID_WAIT_SPINS		10
+#define MAX_OXID_WAIT_SPINS		1000
+#define DEFAULT_OXID_WAIT_SPINS	100
+
+static int	oxidWaitSpins = DEFAULT_OXID_WAIT_SPINS;
+
+PG_FUNCTION_INFO_V1(orioledb_oxid_wait_stats);
+
 static void advance_global_xmin(OXid newXid);
 
 Size
@@ -94,7 +142,9 @@ oxid_shmem_needs(void)
 	size = add_size(size, mul_size(xid_circular_buffer_size,
 								   sizeof(OXidMapItem)));
 	size = add_size(size, o_buffers_shmem_needs(&buffersDesc));
-	size = add_size(size, mul_size(max_procs, sizeof(pg_atomic_uint32)));
+	size = add_size(size, PG_CACHE_LINE_SIZE);
+	size = add_size(size, mul_size(max_procs, sizeof(LogicalXidsMapItem)));
+	size = add_size(size, mul_size(max_procs, sizeof(pg_atomic_uint64)));
 
 	return size;
 }
@@ -201,7 +251,10 @@ oxid_init_shmem(Pointer ptr, bool found)
 	ptr += xid_circular_buffer_size * sizeof(OXidMapItem);
 	o_buffers_shmem_init(&buffersDesc, ptr, found);
 	ptr += o_buffers_shmem_needs(&buffersDesc);
-	logicalXidsShmemMap = (pg_atomic_uint32 *) ptr;
+	ptr = (Pointer) CACHELINEALIGN(ptr);
+	logicalXidsShmemMap = (LogicalXidsMapItem *) ptr;
+	ptr += max_procs * sizeof(LogicalXidsMapItem);
+	oProcXmins = (pg_atomic_uint64 *) ptr;
 
 	if (!found)
 	{
@@ -209,6 +262,9 @@ oxid_init_shmem(Pointer ptr, bool found)
 
 		/* xid_meta fields are initialized in checkpoint_shmem_init() */
 		SpinLockInit(&xid_meta->xminMutex);
+		pg_atomic_init_u64(&xid_meta->waitSpins, 0);
+		pg_atomic_init_u64(&xid_meta->waitSpinSuccesses, 0);
+		pg_atomic_init_u64(&xid_meta->waitSleeps, 0);
 		for (i = 0; i < xid_circular_buffer_size; i++)
 		{
 			pg_atomic_init_u64(&xidBuffer[i].csn, COMMITSEQNO_FROZEN);
@@ -220,7 +276,10 @@ oxid_init_shmem(Pointer ptr, bool found)
 						 xid_meta->xidMapTrancheId);
 
 		for (i = 0; i < max_procs; i++)
-			pg_atomic_init_u32(&logicalXidsShmemMap[i], 0);
+		{
+			pg_atomic_init_u32(&logicalXidsShmemMap[i].bits, 0);
+			pg_atomic_init_u64(&oProcXmins[i], InvalidOXid);
+		}
 
 		/* Undo positions are initialized in checkpoint_shmem_init() */
 	}
@@ -244,7 +303,7 @@ acquire_logical_xid(void)
 
 	while (true)
 	{
-		uint32		value = pg_atomic_read_u32(&logicalXidsShmemMap[i]);
+		uint32		value = pg_atomic_read_u32(&logicalXidsShmemMap[i].bits);
 		uint32		bit,
 					bitnum;
 
@@ -265,7 +324,7 @@ acquire_logical_xid(void)
 		bitnum = pg_ceil_log2_32(bit);
 		Assert(bit == (1 << bitnum));
 
-		value = pg_atomic_fetch_or_u32(&logicalXidsShmemMap[i], bit);
+		value = pg_atomic_fetch_or_u32(&logicalXidsShmemMap[i].bits, bit);
 		if ((value & bit) == 0)
 		{
 			mynum = i * 32 + bitnum;
@@ -304,7 +363,7 @@ release_logical_xid(TransactionId xid)
 
 	Assert(TransactionIdIsNormal(xid));
 
-	value = pg_atomic_fetch_and_u32(&logicalXidsShmemMap[mynum / 32],
+	value = pg_atomic_fetch_and_u32(&logicalXidsShmemMap[mynum / 32].bits,
 									~(1 << (mynum % 32)));
 
 	Assert((value & (1 << (mynum % 32))) != 0);
@@ -491,6 +550,63 @@ map_oxid(OXid oxid, CommitSeqNo *outCsn, XLogRecPtr *outPtr)
 		*outPtr = pg_atomic_read_u64(&mapItem.commitPtr);
 }
 
+static inline OXidCsnCacheEntry *
+oxid_csn_cache_entry(OXid oxid)
+{
+	/* Recovery workers might see csns from their local maps */
+	if (is_recovery_process())
+		return NULL;
+	return &oxidCsnCache[oxid % OXID_CSN_CACHE_SIZE];
+}
+
+/*
+ * Looks up csn and/or commit ptr of the oxid in the backend-local cache.
+ * Found values are returned and the corresponding pointers are reset.
+ */
+static inline void
+oxid_csn_cache_lookup(OXid oxid, CommitSeqNo **outCsn, XLogRecPtr **outPtr)
+{
+	OXidCsnCacheEntry *entry = oxid_csn_cache_entry(oxid);
+
+	if (!entry || entry->oxid != oxid)
+		return;
+
+	if (*outCsn && entry->csn != COMMITSEQNO_INPROGRESS)
+	{
+		**outCsn = entry->csn;
+		*outCsn = NULL;
+	}
+	if (*outPtr && !XLogRecPtrIsInvalid(entry->ptr))
+	{
+		**outPtr = entry->ptr;
+		*outPtr = NULL;
+	}
+}
+
+/*
+ * Remembers final csn and/or commit ptr of the oxid.  Values of transactions
+ * in progress are not cached.
+ */
+static inline void
+oxid_csn_cache_store(OXid oxid, CommitSeqNo csn, XLogRecPtr ptr)
+{
+	OXidCsnCacheEntry *entry = oxid_csn_cache_entry(oxid);
+
+	if (!entry)
+		return;
+
+	if (entry->oxid != oxid)
+	{
+		entry->oxid = oxid;
+		entry->csn = COMMITSEQNO_INPROGRESS;
+		entry->ptr = InvalidXLogRecPtr;
+	}
+	if (csn != COMMITSEQNO_INPROGRESS)
+		entry->csn = csn;
+	if (!XLogRecPtrIsInvalid(ptr))
+		entry->ptr = ptr;
+}
+
 /*
  * Write some data from circular buffer to o_buffers
  */
@@ -591,6 +707,33 @@ fsync_xidmap_range(OXid xmin, OXid xmax, uint32 wait_event_info)
  * Wait particular oxid to finish or oxid_notify() call.  Returns true if
  * oxid was finished.
  */
+/*
+ * Spins until the transaction is finished, without sleeping.  Returns false
+ * if the transaction is still running after oxidWaitSpins iterations.
+ */
+static bool
+oxid_wait_spin(OXid oxid, XidVXidMapElement *vxidElem)
+{
+	CommitSeqNo csn;
+	int			i;
+
+	pg_atomic_fetch_add_u64(&xid_meta->waitSpins, 1);
+
+	for (i = 0; i < oxidWaitSpins; i++)
+	{
+		pg_spin_delay();
+		map_oxid(oxid, &csn, NULL);
+		if (!COMMITSEQNO_IS_SPECIAL(csn) || vxidElem->oxid != oxid)
+		{
+			oxidWaitSpins = Min(oxidWaitSpins + 100, MAX_OXID_WAIT_SPINS);
+			pg_atomic_fetch_add_u64(&xid_meta->waitSpinSuccesses, 1);
+			return true;
+		}
+	}
+	oxidWaitSpins = Max(oxidWaitSpins - 1, MIN_OXID_WAIT_SPINS);
+	return false;
+}
+
 bool
 wait_for_oxid(OXid oxid)
 {
@@ -599,6 +742,7 @@ wait_for_oxid(OXid oxid)
 	XidVXidMapElement *vxidElem;
 	VirtualTransactionId vxid;
 	bool		result;
+	instr_time	waitStart;
 
 	map_oxid(oxid, &csn, NULL);
 
@@ -620,14 +764,66 @@ wait_for_oxid(OXid oxid)
 		return true;
 	}
 
+	/*
+	 * Conflicting transactions are often very short.  Give them a chance to
+	 * finish before going through the sleep and wakeup round trip.
+	 */
+	if (oxid_wait_spin(oxid, vxidElem))
+		return true;
+
 	Assert(VirtualTransactionIdIsValid(vxid));
+	pg_atomic_fetch_add_u64(&xid_meta->waitSleeps, 1);
 	GET_CUR_PROCDATA()->waitingForOxid = true;
+	/* The lock manager reports its own wait event, so only account the wait */
+	INSTR_TIME_SET_CURRENT(waitStart);
 	result = VirtualXactLock(vxid, true);
+	o_wait_event_account(OWaitOxid, &waitStart);
 	GET_CUR_PROCDATA()->waitingForOxid = false;
 
 	return result;
 }
 
+/*
+ * Returns the statistics of waiting for the transactions: how many waits
+ * started with spinning, how many of them finished during the spin, and how
+ * many had to sleep on the transaction lock.
+ */
+Datum
+orioledb_oxid_wait_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Datum		values[3];
+	bool		nulls[3];
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+
+	orioledb_check_shmem();
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	MemSet(nulls, 0, sizeof(nulls));
+	values[0] = Int64GetDatum(pg_atomic_read_u64(&xid_meta->waitSpins));
+	values[1] = Int64GetDatum(pg_atomic_read_u64(&xid_meta->waitSpinSuccesses));
+	values[2] = Int64GetDatum(pg_atomic_read_u64(&xid_meta->waitSleeps));
+	tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+
+	return (Datum) 0;
+}
+
 /*
  * Notify wait_for_oxid() caller only if it is waiting for current process.
  */
@@ -846,12 +1042,21 @@ advance_global_xmin(OXid newXid)
 	{
 		OXid		xmin;
 
-		xmin = pg_atomic_read_u64(&oProcData[i].xmin);
+		xmin = pg_atomic_read_u64(&oProcXmins[i]);
 
 		if (OXidIsValid(xmin) && xmin < globalXmin)
 			globalXmin = xmin;
 	}
 
+	/*
+	 * The transaction handed over to the rollback worker holds the xmin.  The
+	 * backend releases its xmin only after the hand over, so check it last.
+	 */
+	pg_read_barrier();
+	xmin = deferred_rollback_get_oxid();
+	if (OXidIsValid(xmin) && xmin < globalXmin)
+		globalXmin = xmin;
+
 	prevGlobalXmin = pg_atomic_read_u64(&xid_meta->globalXmin);
 
 	/*
@@ -1204,7 +1409,7 @@ current_oxid_commit(CommitSeqNo csn)
 {
 	ODBProcData *my_proc_info = &oProcData[MYPROCNUMBER];
 
-	pg_atomic_write_u64(&my_proc_info->xmin, InvalidOXid);
+	pg_atomic_write_u64(&oProcXmins[MYPROCNUMBER], InvalidOXid);
 
 	if (!OXidIsValid(curOxid))
 		return;
@@ -1223,7 +1428,7 @@ current_oxid_abort(void)
 {
 	ODBProcData *my_proc_info = &oProcData[MYPROCNUMBER];
 
-	pg_atomic_write_u64(&my_proc_info->xmin, InvalidOXid);
+	pg_atomic_write_u64(&oProcXmins[MYPROCNUMBER], InvalidOXid);
 
 	if (!OXidIsValid(curOxid))
 		return;
@@ -1247,9 +1452,16 @@ oxid_get_csn(OXid oxid)
 	CommitSeqNo csn;
 	SpinDelayStatus status;
 
+	CommitSeqNo *outCsn = &csn;
+	XLogRecPtr *outPtr = NULL;
+
 	if (oxid == BootstrapTransactionId)
 		return COMMITSEQNO_FROZEN;
 
+	oxid_csn_cache_lookup(oxid, &outCsn, &outPtr);
+	if (!outCsn)
+		return csn;
+
 	init_local_spin_delay(&status);
 
 	while (true)
@@ -1270,6 +1482,8 @@ oxid_get_csn(OXid oxid)
 	if (COMMITSEQNO_IS_SPECIAL(csn))
 		return COMMITSEQNO_INPROGRESS;
 
+	oxid_csn_cache_store(oxid, csn, InvalidXLogRecPtr);
+
 	return csn;
 }
 
@@ -1282,10 +1496,16 @@ oxid_get_xlog_ptr(OXid oxid)
 {
 	XLogRecPtr	ptr;
 	SpinDelayStatus status;
+	CommitSeqNo *outCsn = NULL;
+	XLogRecPtr *outPtr = &ptr;
 
 	if (oxid == BootstrapTransactionId)
 		return COMMITSEQNO_FROZEN;
 
+	oxid_csn_cache_lookup(oxid, &outCsn, &outPtr);
+	if (!outPtr)
+		return ptr;
+
 	init_local_spin_delay(&status);
 
 	while (true)
@@ -1306,6 +1526,8 @@ oxid_get_xlog_ptr(OXid oxid)
 	if (XLOG_PTR_IS_SPECIAL(ptr))
 		return InvalidXLogRecPtr;
 
+	oxid_csn_cache_store(oxid, COMMITSEQNO_INPROGRESS, ptr);
+
 	return ptr;
 }
 
@@ -1318,6 +1540,8 @@ oxid_match_snapshot(OXid oxid, OSnapshot *snapshot,
 					CommitSeqNo *outCsn, XLogRecPtr *outPtr)
 {
 	SpinDelayStatus status;
+	CommitSeqNo csn = COMMITSEQNO_INPROGRESS;
+	XLogRecPtr	ptr = InvalidXLogRecPtr;
 
 	if (oxid == BootstrapTransactionId || oxid < snapshot->xmin)
 	{
@@ -1328,6 +1552,10 @@ oxid_match_snapshot(OXid oxid, OSnapshot *snapshot,
 		return;
 	}
 
+	oxid_csn_cache_lookup(oxid, &outCsn, &outPtr);
+	if (!outCsn && !outPtr)
+		return;
+
 	init_local_spin_delay(&status);
 
 	while (true)
@@ -1349,6 +1577,8 @@ oxid_match_snapshot(OXid oxid, OSnapshot *snapshot,
 		{
 			if (COMMITSEQNO_IS_SPECIAL(*outCsn))
 				*outCsn = COMMITSEQNO_INPROGRESS;
+			else
+				csn = *outCsn;
 			outCsn = NULL;
 		}
 
@@ -1358,6 +1588,8 @@ oxid_match_snapshot(OXid oxid, OSnapshot *snapshot,
 		{
 			if (XLOG_PTR_IS_SPECIAL(*outPtr))
 				*outPtr = InvalidXLogRecPtr;
+			else
+				ptr = *outPtr;
 			outPtr = NULL;
 		}
 
@@ -1368,6 +1600,8 @@ oxid_match_snapshot(OXid oxid, OSnapshot *snapshot,
 	}
 
 	finish_spin_delay(&status);
+
+	oxid_csn_cache_store(oxid, csn, ptr);
 }
 
 void
@@ -1458,10 +1692,25 @@ xid_is_finished_for_everybody(OXid xid)
 
 	xmin = pg_atomic_read_u64(&xid_meta->runXmin);
 
+	/* Changes of the deferred rollback might be not undone yet */
 	if (xid < xmin)
-		return true;
+		return xid != deferred_rollback_get_oxid();
 
 	csn = oxid_get_csn(xid);
 
 	return COMMITSEQNO_IS_COMMITTED(csn);
 }
+
+/*
+ * Check if changes of xid look the same for every snapshot.  That is, xid is
+ * finished for everybody and oxid_match_snapshot() considers it frozen.
+ */
+bool
+xid_is_visible_for_everybody(OXid xid)
+{
+	if (xid == BootstrapTransactionId)
+		return true;
+
+	return xid < pg_atomic_read_u64(&xid_meta->globalXmin) &&
+		xid_is_finished_for_everybody(xid);
+}
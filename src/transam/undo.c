@@ -26,15 +26,20 @@
 #include "transam/oxid.h"
 #include "transam/undo.h"
 #include "utils/o_buffers.h"
+#include "utils/o_wait_events.h"
 #include "utils/page_pool.h"
 #include "utils/stopevent.h"
+#include "workers/rollback.h"
 
 #include "access/transam.h"
+#include "funcapi.h"
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "storage/lmgr.h"
 #include "storage/proc.h"
+#include "utils/builtins.h"
 #include "utils/memutils.h"
+#include "utils/tuplestore.h"
 
 #define GET_UNDO_REC(undoType, loc) (o_undo_buffers[(int) (undoType)] + \
 	(loc) % o_undo_circular_sizes[(int) (undoType)])
@@ -99,11 +104,18 @@ UndoItemTypeDescr undoItemTypeDescrs[] = {
 		.type = SubXactUndoItemType,
 		.callback = o_stub_item_callback,
 		.callOnCommit = false
+	},
+	{
+		.type = ModifyDeltaUndoItemType,
+		.callback = modify_undo_callback,
+		.callOnCommit = false
 	}
 };
 
 
 PG_FUNCTION_INFO_V1(orioledb_has_retained_undo);
+PG_FUNCTION_INFO_V1(orioledb_undo_stats);
+PG_FUNCTION_INFO_V1(orioledb_undo_backend_stats);
 
 static UndoMeta *undo_metas = NULL;
 static Pointer o_undo_buffers[(int) UndoLogsCount] =
@@ -122,6 +134,27 @@ UndoLocation curRetainUndoLocations[(int) UndoLogsCount] =
 };
 bool		oxid_needs_wal_flush = false;
 
+int			undo_compress = InvalidOCompress;
+
+/*
+ * Stack of the active subtransactions of the current transaction.  The undo
+ * item and the WAL record of the savepoint are added lazily, when the
+ * subtransaction is about to add its first undo stack item or WAL record.
+ * The bottom undoCount (walCount) subtransactions already have their undo
+ * items (WAL records).  Thus, savepoints, which don't modify anything, cost
+ * neither undo nor WAL and are rolled back for free.
+ */
+typedef struct
+{
+	SubTransactionId *parentSubids;
+	int			count;
+	int			allocated;
+	int			undoCount;
+	int			walCount;
+} ActiveSubxacts;
+
+static ActiveSubxacts activeSubxacts = {NULL, 0, 0, 0, 0};
+
 static Size reserved_undo_size = 0;
 
 static OBuffersDesc undoBuffersDescs[(int) UndoLogsCount] =
@@ -130,18 +163,21 @@ static OBuffersDesc undoBuffersDescs[(int) UndoLogsCount] =
 		.singleFileSize = UNDO_FILE_SIZE,
 			.filenameTemplate = ORIOLEDB_UNDO_DATA_FILENAME_TEMPLATE,
 			.groupCtlTrancheName = "undoRegularBuffersGroupCtlTranche",
-			.bufferCtlTrancheName = "undoRegularBuffersCtlTranche"
+			.bufferCtlTrancheName = "undoRegularBuffersCtlTranche",
+			.compress = &undo_compress
 	},
 	{
 		.singleFileSize = UNDO_FILE_SIZE,
 			.filenameTemplate = ORIOLEDB_UNDO_SYSTEM_FILENAME_TEMPLATE,
 			.groupCtlTrancheName = "undoSystemBuffersGroupCtlTranche",
-			.bufferCtlTrancheName = "undoSystemBuffersCtlTranche"
+			.bufferCtlTrancheName = "undoSystemBuffersCtlTranche",
+			.compress = &undo_compress
 	}
 };
 
 static bool wait_for_reserved_location(UndoLogType undoType,
 									   UndoLocation undoLocationToWait);
+static void add_pending_subxact_undo_items(void);
 
 Size
 undo_shmem_needs(void)
@@ -192,6 +228,8 @@ undo_shmem_init(Pointer buf, bool found)
 		pending_truncates_meta->pendingTruncatesTrancheId = LWLockNewTrancheId();
 		LWLockInitialize(&pending_truncates_meta->pendingTruncatesLock,
 						 pending_truncates_meta->pendingTruncatesTrancheId);
+		pending_truncates_meta->pendingTruncatesStart = 0;
+		pending_truncates_meta->pendingTruncatesLocation = 0;
 	}
 	LWLockRegisterTranche(pending_truncates_meta->pendingTruncatesTrancheId,
 						  "OPendingTruncatesTranche");
@@ -488,6 +526,7 @@ wait_for_reserved_location(UndoLogType undoType,
 	ODBProcData *curProcData = GET_CUR_PROCDATA();
 	bool		delay_inited;
 	int			i;
+	instr_time	waitStart;
 
 	if (undoLocationToWait > pg_atomic_read_u64(&curProcData->undoRetainLocations[undoType].reservedUndoLocation) + o_undo_circular_sizes[(int) undoType])
 	{
@@ -502,6 +541,7 @@ wait_for_reserved_location(UndoLogType undoType,
 			if (!delay_inited)
 			{
 				init_local_spin_delay(&delay);
+				o_wait_event_start(OWaitUndoReserve, &waitStart);
 				delay_inited = true;
 			}
 			else
@@ -511,7 +551,10 @@ wait_for_reserved_location(UndoLogType undoType,
 		}
 
 		if (delay_inited)
+		{
 			finish_spin_delay(&delay);
+			o_wait_event_end(OWaitUndoReserve, &waitStart);
+		}
 	}
 
 	return true;
@@ -950,6 +993,27 @@ write_undo(UndoLogType undoType,
 	LWLockRelease(&meta->undoWriteLock);
 }
 
+/*
+ * Waits for the in-progress undo write to be finished.  LWLockAcquire()
+ * reports its own wait event, so only account the wait.
+ */
+static void
+wait_for_undo_write(UndoMeta *meta)
+{
+	instr_time	waitStart;
+
+	if (LWLockConditionalAcquire(&meta->undoWriteLock, LW_SHARED))
+	{
+		LWLockRelease(&meta->undoWriteLock);
+		return;
+	}
+
+	INSTR_TIME_SET_CURRENT(waitStart);
+	LWLockAcquire(&meta->undoWriteLock, LW_SHARED);
+	LWLockRelease(&meta->undoWriteLock);
+	o_wait_event_account(OWaitUndoReserve, &waitStart);
+}
+
 bool
 reserve_undo_size_extended(UndoLogType undoType, Size size,
 						   bool waitForUndoLocation, bool reportError)
@@ -963,6 +1027,13 @@ reserve_undo_size_extended(UndoLogType undoType, Size size,
 	Assert(undoType != UndoLogNone);
 	Assert(size > 0);
 
+	/*
+	 * Transactional changes reserve undo before taking the page locks.  So,
+	 * that's the point to add the undo items of the pending savepoints.
+	 */
+	if (waitForUndoLocation && activeSubxacts.undoCount < activeSubxacts.count)
+		add_pending_subxact_undo_items();
+
 	if (reserved_undo_size >= size)
 		return true;
 
@@ -1019,8 +1090,7 @@ reserve_undo_size_extended(UndoLogType undoType, Size size,
 		 * It should be enough to just wait for current in-progress write to
 		 * be finished.
 		 */
-		LWLockAcquire(&meta->undoWriteLock, LW_SHARED);
-		LWLockRelease(&meta->undoWriteLock);
+		wait_for_undo_write(meta);
 
 		SpinLockAcquire(&meta->minUndoLocationsMutex);
 		Assert(location + size <= pg_atomic_read_u64(&meta->writtenLocation) + circularBufferSize);
@@ -1151,6 +1221,8 @@ add_new_undo_stack_item(UndoLogType undoType, UndoLocation location)
 	UndoStackSharedLocations *sharedLocations = GET_CUR_UNDO_STACK_LOCATIONS(undoType);
 	UndoItemTypeDescr *descr = item_type_get_descr(item->type);
 
+	Assert(activeSubxacts.undoCount == activeSubxacts.count);
+
 	item->prev = pg_atomic_read_u64(&sharedLocations->location);
 	pg_atomic_write_u64(&sharedLocations->location, location);
 
@@ -1268,7 +1340,7 @@ orioledb_reset_xmin_hook(void)
 				xmin = location->xmin;
 		}
 	}
-	pg_atomic_write_u64(&curProcData->xmin, xmin);
+	pg_atomic_write_u64(&oProcXmins[MYPROCNUMBER], xmin);
 }
 
 void
@@ -1328,7 +1400,7 @@ undo_xact_callback(XactEvent event, void *arg)
 					if (!XLogRecPtrIsInvalid(flushPos) &&
 						(synchronous_commit > SYNCHRONOUS_COMMIT_OFF ||
 						 oxid_needs_wal_flush))
-						XLogFlush(flushPos);
+						wal_commit_flush(flushPos);
 				}
 				else
 				{
@@ -1351,8 +1423,11 @@ undo_xact_callback(XactEvent event, void *arg)
 				if (!RecoveryInProgress())
 					wal_rollback(oxid,
 								 get_current_logical_xid());
-				for (i = 0; i < (int) UndoLogsCount; i++)
-					apply_undo_stack((UndoLogType) i, oxid, NULL, true);
+				if (!deferred_rollback_hand_over(oxid))
+				{
+					for (i = 0; i < (int) UndoLogsCount; i++)
+						apply_undo_stack((UndoLogType) i, oxid, NULL, true);
+				}
 				reset_cur_undo_locations();
 				current_oxid_abort();
 				set_oxid_xlog_ptr(oxid, InvalidXLogRecPtr);
@@ -1392,6 +1467,10 @@ undo_xact_callback(XactEvent event, void *arg)
 
 		for (i = 0; i < (int) UndoLogsCount; i++)
 			saved_undo_location[i] = InvalidUndoLocation;
+
+		activeSubxacts.count = 0;
+		activeSubxacts.undoCount = 0;
+		activeSubxacts.walCount = 0;
 	}
 
 	if (event == XACT_EVENT_COMMIT && isParallelWorker)
@@ -1428,6 +1507,87 @@ add_subxact_undo_item(SubTransactionId parentSubid)
 	}
 }
 
+static void
+push_active_subxact(SubTransactionId parentSubid)
+{
+	ActiveSubxacts *subxacts = &activeSubxacts;
+
+	if (subxacts->count >= subxacts->allocated)
+	{
+		if (subxacts->allocated == 0)
+		{
+			subxacts->allocated = 16;
+			subxacts->parentSubids = MemoryContextAlloc(TopMemoryContext,
+														sizeof(SubTransactionId) * subxacts->allocated);
+		}
+		else
+		{
+			subxacts->allocated *= 2;
+			subxacts->parentSubids = repalloc(subxacts->parentSubids,
+											  sizeof(SubTransactionId) * subxacts->allocated);
+		}
+	}
+	subxacts->parentSubids[subxacts->count++] = parentSubid;
+}
+
+/*
+ * Removes the innermost subtransaction from the stack.  Returns whether it has
+ * the undo item and the WAL record.
+ */
+static void
+pop_active_subxact(SubTransactionId parentSubid, bool *hasUndo, bool *hasWal)
+{
+	ActiveSubxacts *subxacts = &activeSubxacts;
+
+	Assert(subxacts->count > 0);
+	Assert(subxacts->parentSubids[subxacts->count - 1] == parentSubid);
+
+	*hasUndo = (subxacts->undoCount == subxacts->count);
+	*hasWal = (subxacts->walCount == subxacts->count);
+	subxacts->count--;
+	subxacts->undoCount = Min(subxacts->undoCount, subxacts->count);
+	subxacts->walCount = Min(subxacts->walCount, subxacts->count);
+}
+
+static void
+add_pending_subxact_undo_items(void)
+{
+	ActiveSubxacts *subxacts = &activeSubxacts;
+	int			i = subxacts->undoCount;
+
+	(void) get_current_oxid();
+
+	/* Mark them added first, add_subxact_undo_item() reserves undo itself */
+	subxacts->undoCount = subxacts->count;
+	for (; i < subxacts->count; i++)
+		add_subxact_undo_item(subxacts->parentSubids[i]);
+}
+
+/*
+ * Adds the WAL records of the pending savepoints.  Called before adding any
+ * WAL record of the transaction changes.
+ */
+void
+add_pending_savepoint_wal_records(void)
+{
+	ActiveSubxacts *subxacts = &activeSubxacts;
+	int			i = subxacts->walCount;
+
+	if (i == subxacts->count)
+		return;
+
+	(void) get_current_oxid();
+
+	subxacts->walCount = subxacts->count;
+	for (; i < subxacts->count; i++)
+	{
+		TransactionId parentLogicalXid = get_current_logical_xid();
+
+		assign_subtransaction_logical_xid();
+		add_savepoint_wal_record(subxacts->parentSubids[i], parentLogicalXid);
+	}
+}
+
 static bool
 search_for_undo_sub_location(UndoLogType undoType,
 							 UndoStackKind kind, UndoLocation location,
@@ -1557,7 +1717,8 @@ void
 undo_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
 					  SubTransactionId parentSubid, void *arg)
 {
-	TransactionId prentLogicalXid;
+	bool		hasUndo,
+				hasWal;
 	int			i;
 
 	/*
@@ -1569,31 +1730,36 @@ undo_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
 	switch (event)
 	{
 		case SUBXACT_EVENT_START_SUB:
-			(void) get_current_oxid();
-			add_subxact_undo_item(parentSubid);
-			prentLogicalXid = get_current_logical_xid();
-			assign_subtransaction_logical_xid();
-			add_savepoint_wal_record(parentSubid, prentLogicalXid);
+			push_active_subxact(parentSubid);
 			break;
 		case SUBXACT_EVENT_COMMIT_SUB:
-			update_subxact_undo_location_on_commit(parentSubid);
+			pop_active_subxact(parentSubid, &hasUndo, &hasWal);
+			if (hasUndo)
+				update_subxact_undo_location_on_commit(parentSubid);
 			for (i = 0; i < (int) UndoLogsCount; i++)
 				saved_undo_location[i] = InvalidUndoLocation;
 			break;
 		case SUBXACT_EVENT_ABORT_SUB:
-			for (i = 0; i < (int) UndoLogsCount; i++)
-				rollback_to_savepoint((UndoLogType) i, UndoStackFull,
-									  parentSubid, true);
-			add_rollback_to_savepoint_wal_record(parentSubid);
+			pop_active_subxact(parentSubid, &hasUndo, &hasWal);
+			if (hasUndo)
+			{
+				for (i = 0; i < (int) UndoLogsCount; i++)
+					rollback_to_savepoint((UndoLogType) i, UndoStackFull,
+										  parentSubid, true);
+			}
+			if (hasWal)
+				add_rollback_to_savepoint_wal_record(parentSubid);
 			for (i = 0; i < (int) UndoLogsCount; i++)
 				saved_undo_location[i] = InvalidUndoLocation;
 
 			/*
 			 * It might happen that we've released some row-level locks.  Some
 			 * waiters must be woken up.  We currently can't distinguish them
-			 * and just wake up everybody.
+			 * and just wake up everybody.  The subtransaction without undo
+			 * items hasn't taken any locks.
 			 */
-			oxid_notify_all();
+			if (hasUndo)
+				oxid_notify_all();
 			break;
 		default:
 			break;
@@ -1647,6 +1813,159 @@ orioledb_has_retained_undo(PG_FUNCTION_ARGS)
 	PG_RETURN_BOOL(result);
 }
 
+static const char *const undoLogTypeNames[(int) UndoLogsCount] =
+{
+	"regular",
+	"system"
+};
+
+/*
+ * Materializes the set-returning function result: switches to the per-query
+ * memory context and builds the tuplestore.
+ */
+static void
+undo_stats_init_srf(FunctionCallInfo fcinfo)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	MemoryContext oldcontext;
+
+	orioledb_check_shmem();
+
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+}
+
+static Datum
+undo_location_get_datum(UndoLocation location, bool *isnull)
+{
+	*isnull = !UndoLocationIsValid(location);
+	return Int64GetDatum(location);
+}
+
+/*
+ * Returns the undo locations and sizes for each undo log type.  The undo
+ * between the cleaned and the written locations is spilled to the files, the
+ * retained undo above the written location is kept only in the circular
+ * buffer.
+ */
+Datum
+orioledb_undo_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	int			i;
+
+	undo_stats_init_srf(fcinfo);
+
+	for (i = 0; i < (int) UndoLogsCount; i++)
+	{
+		UndoMeta   *meta = &undo_metas[i];
+		Datum		values[11];
+		bool		nulls[11];
+		UndoLocation lastUsed,
+					written,
+					minRetain,
+					cleaned;
+
+		MemSet(nulls, 0, sizeof(nulls));
+		lastUsed = pg_atomic_read_u64(&meta->lastUsedLocation);
+		written = pg_atomic_read_u64(&meta->writtenLocation);
+		minRetain = pg_atomic_read_u64(&meta->minProcRetainLocation);
+		cleaned = pg_atomic_read_u64(&meta->cleanedLocation);
+
+		values[0] = CStringGetTextDatum(undoLogTypeNames[i]);
+		values[1] = Int64GetDatum(lastUsed);
+		values[2] = Int64GetDatum(pg_atomic_read_u64(&meta->minProcReservedLocation));
+		values[3] = Int64GetDatum(pg_atomic_read_u64(&meta->minProcTransactionRetainLocation));
+		values[4] = Int64GetDatum(minRetain);
+		values[5] = Int64GetDatum(written);
+		values[6] = Int64GetDatum(cleaned);
+		values[7] = undo_location_get_datum(pg_atomic_read_u64(&meta->checkpointRetainStartLocation),
+											&nulls[7]);
+		values[8] = Int64GetDatum(o_undo_circular_sizes[i]);
+		values[9] = Int64GetDatum(lastUsed > Max(written, minRetain) ?
+								  lastUsed - Max(written, minRetain) : 0);
+		values[10] = Int64GetDatum(written > cleaned ? written - cleaned : 0);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * Returns the undo locations reserved and retained by each backend, which has
+ * any.  Sizes are counted from the location up to the last used undo
+ * location, so the biggest retained size points to the backend, which holds
+ * the undo from being cleaned.
+ */
+Datum
+orioledb_undo_backend_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	OXid		nextXid;
+	int			i,
+				j;
+
+	undo_stats_init_srf(fcinfo);
+
+	nextXid = pg_atomic_read_u64(&xid_meta->nextXid);
+	for (i = 0; i < max_procs; i++)
+	{
+		PGPROC	   *proc = GetPGProcByNumber(i);
+		OXid		xmin = pg_atomic_read_u64(&oProcXmins[i]);
+
+		for (j = 0; j < (int) UndoLogsCount; j++)
+		{
+			UndoRetainSharedLocations *shared = &oProcData[i].undoRetainLocations[j];
+			UndoLocation lastUsed,
+						reserved,
+						transactionRetain,
+						snapshotRetain;
+			Datum		values[9];
+			bool		nulls[9];
+
+			reserved = pg_atomic_read_u64(&shared->reservedUndoLocation);
+			transactionRetain = pg_atomic_read_u64(&shared->transactionUndoRetainLocation);
+			snapshotRetain = pg_atomic_read_u64(&shared->snapshotRetainUndoLocation);
+			if (!UndoLocationIsValid(reserved) &&
+				!UndoLocationIsValid(transactionRetain) &&
+				!UndoLocationIsValid(snapshotRetain))
+				continue;
+
+			lastUsed = pg_atomic_read_u64(&undo_metas[j].lastUsedLocation);
+
+			MemSet(nulls, 0, sizeof(nulls));
+			values[0] = Int32GetDatum(proc->pid);
+			values[1] = CStringGetTextDatum(undoLogTypeNames[j]);
+			values[2] = undo_location_get_datum(reserved, &nulls[2]);
+			values[3] = undo_location_get_datum(transactionRetain, &nulls[3]);
+			values[4] = undo_location_get_datum(snapshotRetain, &nulls[4]);
+			nulls[5] = !UndoLocationIsValid(transactionRetain);
+			values[5] = Int64GetDatum(nulls[5] || transactionRetain > lastUsed ?
+									  0 : lastUsed - transactionRetain);
+			nulls[6] = !UndoLocationIsValid(snapshotRetain);
+			values[6] = Int64GetDatum(nulls[6] || snapshotRetain > lastUsed ?
+									  0 : lastUsed - snapshotRetain);
+			nulls[7] = !OXidIsValid(xmin);
+			values[7] = Int64GetDatum(xmin);
+			nulls[8] = !OXidIsValid(xmin);
+			values[8] = Int64GetDatum(nextXid > xmin ? nextXid - xmin : 0);
+			tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+		}
+	}
+
+	return (Datum) 0;
+}
+
 void
 start_autonomous_transaction(OAutonomousTxState *state)
 {
@@ -1660,6 +1979,12 @@ start_autonomous_transaction(OAutonomousTxState *state)
 		state->has_retained_undo_location[i] = undo_type_has_retained_location((UndoLogType) i);
 	state->local_wal_has_material_changes = get_local_wal_has_material_changes();
 
+	/* Pending savepoints of the outer transaction aren't ours */
+	state->subxactsUndoCount = activeSubxacts.undoCount;
+	state->subxactsWalCount = activeSubxacts.walCount;
+	activeSubxacts.undoCount = activeSubxacts.count;
+	activeSubxacts.walCount = activeSubxacts.count;
+
 	if (!local_wal_is_empty())
 		flush_local_wal(false);
 
@@ -1697,6 +2022,8 @@ abort_autonomous_transaction(OAutonomousTxState *state)
 	set_current_oxid(state->oxid);
 	set_current_logical_xid(state->logicalXid);
 	set_local_wal_has_material_changes(state->local_wal_has_material_changes);
+	activeSubxacts.undoCount = state->subxactsUndoCount;
+	activeSubxacts.walCount = state->subxactsWalCount;
 }
 
 void
@@ -1734,6 +2061,8 @@ finish_autonomous_transaction(OAutonomousTxState *state)
 	set_current_oxid(state->oxid);
 	set_current_logical_xid(state->logicalXid);
 	set_local_wal_has_material_changes(state->local_wal_has_material_changes);
+	activeSubxacts.undoCount = state->subxactsUndoCount;
+	activeSubxacts.walCount = state->subxactsWalCount;
 }
 
 void
@@ -1899,7 +2228,6 @@ orioledb_snapshot_hook(Snapshot snapshot)
 	UndoLocation lastUsedLocation,
 				lastUsedUndoLocationWhenUpdatedMinLocation;
 	OXid		curXmin;
-	ODBProcData *curProcData = GET_CUR_PROCDATA();
 	int			i;
 
 	/*
@@ -1928,9 +2256,9 @@ orioledb_snapshot_hook(Snapshot snapshot)
 	snapshot->undoRegularLocationPhNode.undoLocation = set_my_retain_location(UndoLogRegular);
 	snapshot->undoSystemLocationPhNode.undoLocation = set_my_retain_location(UndoLogSystem);
 	snapshot->undoRegularLocationPhNode.xmin = snapshot->undoSystemLocationPhNode.xmin = pg_atomic_read_u64(&xid_meta->runXmin);
-	curXmin = pg_atomic_read_u64(&curProcData->xmin);
+	curXmin = pg_atomic_read_u64(&oProcXmins[MYPROCNUMBER]);
 	if (!OXidIsValid(curXmin))
-		pg_atomic_write_u64(&curProcData->xmin, snapshot->undoRegularLocationPhNode.xmin);
+		pg_atomic_write_u64(&oProcXmins[MYPROCNUMBER], snapshot->undoRegularLocationPhNode.xmin);
 
 	/*
 	 * Snapshot CSN could be newer than retained location, not older.  Enforce
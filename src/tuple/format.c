@@ -158,6 +158,49 @@ o_tuple_read_next_field(OTupleReaderState *state, bool *isnull)
 	return fetchatt(att, state->tp + off);
 }
 
+/*
+ * Reads the next fields belonging to the leading fixed-width fields of the
+ * tuple, but not beyond 'natts'.  The offsets of these fields don't depend
+ * on the tuple contents, so they are taken from attcacheoff without walking
+ * the fields one by one.  Stops at the first null field.  Returns the number
+ * of fields read, the rest should be read by o_tuple_read_next_field().
+ */
+int
+o_tuple_read_fixed_fields(OTupleReaderState *state,
+						  OTupleFixedFormatSpec *spec, int natts,
+						  Datum *values, bool *isnull)
+{
+	int			attnum = state->attnum;
+	int			i;
+	Form_pg_attribute att = NULL;
+
+	if (state->slow)
+		return 0;
+
+	natts = Min(natts, Min(spec->natts, state->natts));
+	for (i = attnum; i < natts; i++)
+	{
+		att = TupleDescAttr(state->desc, i);
+
+		Assert(att->attlen > 0);
+		if (att->attcacheoff < 0 ||
+			(state->hasnulls && att_isnull(i, state->bp)))
+			break;
+
+		values[i - attnum] = fetchatt(att, state->tp + att->attcacheoff);
+		isnull[i - attnum] = false;
+	}
+
+	if (i > attnum)
+	{
+		att = TupleDescAttr(state->desc, i - 1);
+		state->off = att->attcacheoff + att->attlen;
+		state->attnum = i;
+	}
+
+	return i - attnum;
+}
+
 static Pointer
 o_tuple_read_next_field_ptr(OTupleReaderState *state)
 {
@@ -180,6 +223,28 @@ o_tuple_read_next_field_ptr(OTupleReaderState *state)
 	return state->tp + off;
 }
 
+/*
+ * o_fastgetattr() analog for the series of accesses to the same tuple.
+ * 'state' should be initialized by o_tuple_init_reader() for the tuple.  It
+ * memorizes the position of the walk over the fields, so the accesses with
+ * increasing attribute numbers continue the walk instead of re-scanning the
+ * fields from the beginning, as o_toast_nocachegetattr() does.
+ */
+Datum
+o_tuple_read_field(OTupleReaderState *state, OTuple tuple, int attnum,
+				   OTupleFixedFormatSpec *spec, bool *isnull)
+{
+	Assert(attnum > 0);
+
+	if (attnum - 1 < state->attnum || attnum > state->natts)
+		return o_fastgetattr(tuple, attnum, state->desc, spec, isnull);
+
+	while (state->attnum < attnum - 1)
+		(void) o_tuple_read_next_field_ptr(state);
+
+	return o_tuple_read_next_field(state, isnull);
+}
+
 ItemPointer
 o_tuple_get_last_iptr(TupleDesc desc, OTupleFixedFormatSpec *spec,
 					  OTuple tuple, bool *isnull)
@@ -21,6 +21,7 @@
 #include "tuple/slot.h"
 
 #include "access/detoast.h"
+#include "access/toast_compression.h"
 #include "access/toast_internals.h"
 #include "catalog/heap.h"
 #include "catalog/pg_type_d.h"
@@ -187,6 +188,8 @@ make_key_from_secondary_slot(TupleTableSlot *slot, OIndexDescr *idx, OTableDescr
 	return result;
 }
 
+int			inline_compress_threshold = 0;
+
 static void
 alloc_to_toast_vfree_detoasted(TupleTableSlot *slot)
 {
@@ -294,8 +297,20 @@ tts_orioledb_getsomeattrs(TupleTableSlot *slot, int __natts)
 		natts = oslot->state.desc->natts;
 	}
 
+	attnum = slot->tts_nvalid;
+
+	/*
+	 * The leading fixed-width attributes of the table tuple are read at
+	 * their cached offsets bypassing the generic loop below.
+	 */
+	if (oslot->ixnum == PrimaryIndexNumber && oslot->leafTuple &&
+		!index_order && oslot->state.attnum == attnum + ctid_off)
+		attnum += o_tuple_read_fixed_fields(&oslot->state, &idx->leafSpec,
+											natts + ctid_off,
+											values + attnum, isnull + attnum);
+
 	/* Iterate over the attributes to populate values and null flags. */
-	for (attnum = slot->tts_nvalid; attnum < natts; attnum++)
+	for (; attnum < natts; attnum++)
 	{
 		Form_pg_attribute thisatt;
 		int			res_attnum;
@@ -556,6 +571,30 @@ tts_orioledb_materialize(TupleTableSlot *slot)
 
 	slot_getallattrs(slot);
 
+	/*
+	 * The tuple isn't owned by the slot.  It might point to the private page
+	 * image of the scan, so copy it.
+	 */
+	if (!O_TUPLE_IS_NULL(oslot->tuple))
+	{
+		OIndexDescr *idx = oslot->descr->indices[oslot->ixnum];
+		OTuple		tuple;
+		Size		len;
+
+		len = oslot->leafTuple ? o_tuple_size(oslot->tuple, &idx->leafSpec) :
+			o_tuple_size(oslot->tuple, &idx->nonLeafSpec);
+		tuple.formatFlags = oslot->tuple.formatFlags;
+		tuple.data = MemoryContextAlloc(slot->tts_mcxt, len);
+		memcpy(tuple.data, oslot->tuple.data, len);
+		oslot->state.tp = tuple.data + (oslot->state.tp - oslot->tuple.data);
+		if (oslot->state.bp)
+			oslot->state.bp = (bits8 *) (tuple.data +
+										 ((Pointer) oslot->state.bp -
+										  oslot->tuple.data));
+		oslot->tuple = tuple;
+		slot->tts_flags |= TTS_FLAG_SHOULDFREE;
+	}
+
 	/* compute size of memory required */
 	for (int natt = 0; natt < desc->natts; natt++)
 	{
@@ -1132,6 +1171,81 @@ can_be_stored_in_index(TupleTableSlot *slot, OTableDescr *descr)
 	return false;
 }
 
+/*
+ * Checks if the attribute of the primary leaf tuple is a key field of any
+ * secondary index.
+ */
+static bool
+is_secondary_key_attnum(OTableDescr *descr, AttrNumber attnum)
+{
+	int			i,
+				j;
+
+	for (i = PrimaryIndexNumber + 1; i < descr->nIndices; i++)
+	{
+		OIndexDescr *id = descr->indices[i];
+
+		for (j = 0; j < id->nKeyFields; j++)
+		{
+			if (id->fields[j].tableAttnum == attnum)
+				return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Compresses the toastable values not smaller than inline_compress_threshold
+ * in place, using the compression method of the column.  That's done
+ * regardless of the tuple size, so the medium-sized values take less space
+ * in the primary leaf and more of them avoid the toast tree.  Compressed
+ * values are decompressed transparently on read like any inline compressed
+ * varlena.  The key fields of secondary indices are left as-is, because key
+ * images and hashes are made of the raw value bytes.
+ */
+static void
+o_compress_medium_values(TupleTableSlot *slot, OTableDescr *descr)
+{
+	OTableSlot *oslot = (OTableSlot *) slot;
+	int			ctid_off = GET_PRIMARY(descr)->primaryIsCtid ? 1 : 0;
+	int			i;
+
+	for (i = 0; i < descr->ntoastable; i++)
+	{
+		AttrNumber	attn = descr->toastable[i] - ctid_off;
+		Form_pg_attribute att = TupleDescAttr(slot->tts_tupleDescriptor, attn);
+		Datum		value = slot->tts_values[attn];
+		Datum		tmp;
+		char		cmethod;
+		MemoryContext oldMctx;
+
+		if (slot->tts_isnull[attn] ||
+			att->attstorage == TYPSTORAGE_EXTERNAL ||
+			VARATT_IS_EXTENDED(DatumGetPointer(value)) ||
+			VARSIZE(DatumGetPointer(value)) < inline_compress_threshold ||
+			is_secondary_key_attnum(descr, descr->toastable[i] + 1))
+			continue;
+
+		cmethod = att->attcompression;
+		if (!CompressionMethodIsValid(cmethod))
+			cmethod = default_toast_compression;
+
+		oldMctx = MemoryContextSwitchTo(slot->tts_mcxt);
+		tmp = toast_compress_datum(value, cmethod);
+		MemoryContextSwitchTo(oldMctx);
+
+		if (DatumGetPointer(tmp) == NULL)
+			continue;
+
+		if (!oslot->to_toast)
+			alloc_to_toast_vfree_detoasted(slot);
+		if (oslot->vfree[attn])
+			pfree(DatumGetPointer(value));
+		slot->tts_values[attn] = tmp;
+		oslot->vfree[attn] = true;
+	}
+}
+
 /*
  * Apply TOAST including compression and out-of-line storage to the tuple
  * stored in the slot if necessary.
@@ -1155,6 +1269,9 @@ tts_orioledb_toast(TupleTableSlot *slot, OTableDescr *descr)
 	ctid_off = primaryIsCtid ? 1 : 0;
 	slot_getallattrs(slot);
 
+	if (inline_compress_threshold > 0)
+		o_compress_medium_values(slot, descr);
+
 	/* temporary, pointers to TupleDesc attributes */
 	natts = tupdesc->natts;
 	for (i = 0; i < natts; i++)
@@ -1601,6 +1718,7 @@ tts_orioledb_update_toast_values(TupleTableSlot *oldSlot,
 					oldToast = false;
 		bool		insertNew = false;
 		bool		deleteOld = false;
+		bool		updateOld = false;
 
 		toast_attn = descr->toastable[i] - ctid_off;
 		if (!oldSlot->tts_isnull[toast_attn])
@@ -1670,8 +1788,41 @@ tts_orioledb_update_toast_values(TupleTableSlot *oldSlot,
 					continue;
 			}
 
-			insertNew = true;
-			deleteOld = true;
+			/* rewrite only the changed and appended chunks */
+			updateOld = true;
+		}
+
+		if (updateOld)
+		{
+			Datum		newSrcValue;
+			Datum		oldSrcValue;
+			Pointer		newPtr;
+			Pointer		oldPtr;
+			bool		freeNew;
+			bool		freeOld;
+
+			newSrcValue = o_get_src_value(newValue, &freeNew);
+			oldSrcValue = o_get_src_value(oldValue, &freeOld);
+			newPtr = DatumGetPointer(newSrcValue);
+			oldPtr = DatumGetPointer(oldSrcValue);
+
+			o_btree_load_shmem(&descr->toast->desc);
+			result = o_toast_update(GET_PRIMARY(descr),
+									descr->toast,
+									idx_tup,
+									toast_attn + 1 + ctid_off,
+									newPtr,
+									toast_datum_size(newSrcValue),
+									oldPtr,
+									toast_datum_size(oldSrcValue),
+									oxid,
+									csn);
+			if (freeNew)
+				pfree(newPtr);
+			if (freeOld)
+				pfree(oldPtr);
+			if (!result)
+				break;
 		}
 
 		if (deleteOld)
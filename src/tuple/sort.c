@@ -21,6 +21,8 @@
 
 #include "catalog/pg_collation_d.h"
 #include "catalog/pg_opclass_d.h"
+#include "utils/lsyscache.h"
+#include "utils/rel.h"
 #include "utils/tuplesort.h"
 
 typedef struct
@@ -28,6 +30,8 @@ typedef struct
 	TupleDesc	tupDesc;
 	OIndexDescr *id;
 	bool		enforceUnique;
+	/* relation being loaded, duplicates are reported as for insertion */
+	Relation	insertRel;
 } OIndexBuildSortArg;
 
 static void
@@ -53,6 +57,63 @@ read_o_tuple(void *ptr)
 	return tup;
 }
 
+/*
+ * Reports the duplicate key found while sorting tuples loaded into the
+ * relation the same way as the insertion into the unique index does.
+ */
+static void
+report_insert_duplicate(OIndexBuildSortArg *arg, OTuple tuple)
+{
+	OIndexDescr *id = arg->id;
+	StringInfoData str;
+	int			i;
+
+	initStringInfo(&str);
+	appendStringInfo(&str, "(");
+	for (i = 0; i < id->nKeyFields; i++)
+	{
+		if (i != 0)
+			appendStringInfo(&str, ", ");
+		appendStringInfo(&str, "%s",
+						 id->nonLeafTupdesc->attrs[i].attname.data);
+	}
+	appendStringInfo(&str, ")=(");
+	for (i = 0; i < id->nKeyFields; i++)
+	{
+		int			attnum = OIndexKeyAttnumToTupleAttnum(BTreeKeyLeafTuple,
+														  id, i + 1);
+		Datum		value;
+		bool		isnull;
+
+		value = o_fastgetattr(tuple, attnum, arg->tupDesc, &id->leafSpec,
+							  &isnull);
+		if (i != 0)
+			appendStringInfo(&str, ", ");
+		if (isnull)
+			appendStringInfo(&str, "null");
+		else
+		{
+			Oid			typoutput;
+			bool		typisvarlena;
+
+			getTypeOutputInfo(id->nonLeafTupdesc->attrs[i].atttypid,
+							  &typoutput, &typisvarlena);
+			appendStringInfo(&str, "'%s'",
+							 OidOutputFunctionCall(typoutput, value));
+		}
+	}
+	appendStringInfo(&str, ")");
+
+	ereport(ERROR,
+			(errcode(ERRCODE_UNIQUE_VIOLATION),
+			 errmsg("duplicate key value violates unique "
+					"constraint \"%s\"", id->name.data),
+			 errdetail("Key %s already exists.", str.data),
+			 errtableconstraint(arg->insertRel,
+								id->desc.type == oIndexPrimary ?
+								"pk" : "sk")));
+}
+
 static int
 comparetup_orioledb_index(const SortTuple *a, const SortTuple *b, Tuplesortstate *state)
 {
@@ -137,6 +198,8 @@ comparetup_orioledb_index(const SortTuple *a, const SortTuple *b, Tuplesortstate
 	 */
 	if (arg->enforceUnique && !equal_hasnull)
 	{
+		if (arg->insertRel != NULL)
+			report_insert_duplicate(arg, ltup);
 		ereport(ERROR,
 				(errcode(ERRCODE_UNIQUE_VIOLATION),
 				 errmsg("could not create unique index \"%s\"",
@@ -264,7 +327,6 @@ tuplesort_begin_orioledb_index(OIndexDescr *idx,
 				OIndexKeyAttnumToTupleAttnum(BTreeKeyLeafTuple, idx, i + 1);
 			sortKey->abbreviate = (i == 0);
 			sortKey->ssup_reverse = !idx->fields[i].ascending;
-			/* FIXME: no abbrev converter yet */
 			o_finish_sort_support_function(idx->fields[i].comparator, sortKey);
 		}
 	}
@@ -274,6 +336,19 @@ tuplesort_begin_orioledb_index(OIndexDescr *idx,
 	return state;
 }
 
+/*
+ * Makes the index sort report duplicates as the unique constraint violation
+ * on insertion into the relation, not as the index build failure.
+ */
+void
+tuplesort_orioledb_index_set_insert_rel(Tuplesortstate *state, Relation rel)
+{
+	TuplesortPublic *base = TuplesortstateGetPublic(state);
+	OIndexBuildSortArg *arg = (OIndexBuildSortArg *) base->arg;
+
+	arg->insertRel = rel;
+}
+
 Tuplesortstate *
 tuplesort_begin_orioledb_toast(OIndexDescr *toast,
 							   OIndexDescr *primary,
@@ -320,7 +395,6 @@ tuplesort_begin_orioledb_toast(OIndexDescr *toast,
 		sortKey->ssup_attno = OIndexKeyAttnumToTupleAttnum(BTreeKeyLeafTuple, primary, i + 1);
 		sortKey->abbreviate = (i == 0);
 		sortKey->ssup_reverse = !primary->fields[i].ascending;
-		/* FIXME: no abbrev converter yet */
 		o_finish_sort_support_function(primary->fields[i].comparator, sortKey);
 	}
 
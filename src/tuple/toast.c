@@ -28,7 +28,9 @@
 #include "access/heapam.h"
 #include "access/htup_details.h"
 #include "access/detoast.h"
+#include "access/toast_internals.h"
 #include "catalog/pg_type.h"
+#include "common/pg_lzcompress.h"
 #include "utils/builtins.h"
 #include "miscadmin.h"
 
@@ -226,6 +228,162 @@ o_detoast(struct varlena *attr)
 										  ote.toasted_size, &oSnapshot);
 }
 
+typedef struct
+{
+	struct varlena *result;
+	/* stored range to be copied into the result */
+	Size		start;
+	Size		end;
+	/* requested part of the raw value */
+	Size		slicelimit;
+	Size		toastedSize;
+} ODetoastSliceState;
+
+/*
+ * Collects the prefix of the compressed value.  The first chunk brings the
+ * compression header, which tells how large the needed prefix is.
+ */
+static bool
+o_detoast_slice_callback(Pointer data, Size length, Size offset, void *arg)
+{
+	ODetoastSliceState *state = (ODetoastSliceState *) arg;
+	Size		copyLength;
+
+	if (state->result == NULL)
+	{
+		Assert(offset == 0 && length >= VARHDRSZ_COMPRESSED);
+		Assert(VARATT_IS_COMPRESSED(data));
+
+		if (VARDATA_COMPRESSED_GET_COMPRESS_METHOD(data) == TOAST_PGLZ_COMPRESSION_ID)
+			state->end = Min(state->toastedSize,
+							 pglz_maximum_compressed_size(state->slicelimit,
+														  state->toastedSize - VARHDRSZ_COMPRESSED) +
+							 VARHDRSZ_COMPRESSED);
+		else
+			state->end = state->toastedSize;
+		state->result = (struct varlena *) palloc(state->end);
+	}
+
+	copyLength = Min(length, state->end - offset);
+	memcpy((Pointer) state->result + offset, data, copyLength);
+	return offset + copyLength < state->end;
+}
+
+/*
+ * Fetches the slice of the orioledb TOAST value.  Only the chunks covering
+ * the slice are read from the TOAST tree.  Compressed values are fetched up
+ * to the prefix needed to decompress the slice, like detoast_attr_slice()
+ * does for the heap TOAST.  Negative slicelength means the rest of the value.
+ */
+struct varlena *
+o_detoast_slice(struct varlena *attr, int32 sliceoffset, int32 slicelength)
+{
+	OToastExternal ote;
+	ORelOids	oids;
+	OTableDescr *descr;
+	OFixedKey	key;
+	OSnapshot	oSnapshot;
+	struct varlena *result;
+	Size		slicelimit;
+
+	Assert(sliceoffset >= 0);
+
+	memcpy(&ote, VARDATA_EXTERNAL(attr), O_TOAST_EXTERNAL_SZ);
+	oids.datoid = ote.datoid;
+	oids.reloid = ote.relid;
+	oids.relnode = ote.relnode;
+	descr = o_fetch_table_descr(oids);
+
+	Assert(descr);
+
+	if (sliceoffset >= ote.raw_size)
+		sliceoffset = slicelength = 0;
+	if (slicelength < 0 || (Size) sliceoffset + slicelength > ote.raw_size)
+		slicelength = ote.raw_size - sliceoffset;
+	slicelimit = (Size) sliceoffset + slicelength;
+
+	o_btree_load_shmem(&descr->toast->desc);
+	key.tuple.formatFlags = ote.formatFlags;
+	key.tuple.data = key.fixedData;
+	memcpy(key.fixedData,
+		   VARDATA_EXTERNAL(attr) + O_TOAST_EXTERNAL_SZ,
+		   ote.data_size);
+	O_LOAD_SNAPSHOT_CSN(&oSnapshot, ote.csn);
+
+	if (ote.toasted_size == ote.raw_size + VARHDRSZ)
+	{
+		Pointer		data = NULL;
+
+		/* Uncompressed value: read just the chunks covering the slice */
+		result = (struct varlena *) palloc(VARHDRSZ + slicelength);
+		SET_VARSIZE(result, VARHDRSZ + slicelength);
+		if (slicelength > 0)
+			data = o_toast_get_slice(GET_PRIMARY(descr), descr->toast,
+									 key.tuple, ote.attnum,
+									 VARHDRSZ + sliceoffset, slicelength,
+									 &oSnapshot);
+		if (data)
+		{
+			memcpy(VARDATA(result), data, slicelength);
+			pfree(data);
+		}
+		else if (slicelength > 0)
+		{
+			pfree(result);
+			return NULL;
+		}
+	}
+	else
+	{
+		ODetoastSliceState state = {0};
+		struct varlena *compressed;
+		OToastKey	tkey;
+		OTableToastArg arg = {GET_PRIMARY(descr), descr->toast};
+
+		if (slicelength == 0)
+		{
+			result = (struct varlena *) palloc(VARHDRSZ);
+			SET_VARSIZE(result, VARHDRSZ);
+			return result;
+		}
+
+		tkey.pk_tuple = key.tuple;
+		tkey.attnum = ote.attnum;
+		tkey.chunknum = 0;
+
+		state.slicelimit = slicelimit;
+		state.toastedSize = ote.toasted_size;
+		(void) generic_toast_stream(&tableToastAPI, (Pointer) &tkey,
+									0, ote.toasted_size, &oSnapshot, &arg,
+									o_detoast_slice_callback, &state);
+		if (state.result == NULL)
+			return NULL;
+
+		compressed = state.result;
+		SET_VARSIZE_COMPRESSED(compressed, state.end);
+		if (state.end == ote.toasted_size)
+			result = toast_decompress_datum(compressed);
+		else
+			result = toast_decompress_datum_slice(compressed, slicelimit);
+		pfree(compressed);
+
+		if (sliceoffset > 0)
+		{
+			struct varlena *slice;
+
+			slice = (struct varlena *) palloc(VARHDRSZ + slicelength);
+			SET_VARSIZE(slice, VARHDRSZ + slicelength);
+			memcpy(VARDATA(slice), VARDATA(result) + sliceoffset, slicelength);
+			pfree(result);
+			result = slice;
+		}
+		else if (VARSIZE(result) > VARHDRSZ + slicelength)
+			SET_VARSIZE(result, VARHDRSZ + slicelength);
+	}
+
+	return result;
+}
+
 static BTreeDescr *
 tableGetBTreeDesc(void *arg)
 {
@@ -524,10 +682,17 @@ o_delete_callback(BTreeDescr *descr,
 	return OBTreeCallbackActionDelete;
 }
 
-bool
-generic_toast_update_optional_wal(ToastAPI *api, void *key, Pointer data,
-								  Size data_size, OXid oxid, CommitSeqNo csn,
-								  void *arg, bool wal)
+/*
+ * Writes the chunks of the new value over the chunks of the old one.  If
+ * 'old_data' is given, the chunks equal to the same chunks of the old value
+ * are kept as is, and the tailing chunks are deleted only if the old value
+ * had more chunks.
+ */
+static bool
+generic_toast_update_common(ToastAPI *api, void *key, Pointer data,
+							Size data_size, Pointer old_data,
+							Size old_data_size, OXid oxid, CommitSeqNo csn,
+							void *arg, bool wal)
 {
 	BTreeDescr *desc = api->getBTreeDesc(arg);
 	int			max_length = api->getMaxChunkSize(key, arg);
@@ -559,6 +724,17 @@ generic_toast_update_optional_wal(ToastAPI *api, void *key, Pointer data,
 			length = max_length;
 		}
 
+		if (old_data && offset < old_data_size &&
+			Min(max_length, old_data_size - offset) == length &&
+			memcmp(old_data + offset, data + offset, length) == 0)
+		{
+			/* the chunk isn't changed */
+			offset += length;
+			chunknum++;
+			data_size -= length;
+			continue;
+		}
+
 		tup = api->createTuple(key, data, offset, chunknum, length, arg);
 
 		result = o_btree_modify(desc, BTreeOperationInsert,
@@ -591,12 +767,34 @@ generic_toast_update_optional_wal(ToastAPI *api, void *key, Pointer data,
 	/*
 	 * There might be tailing tuples.  We need to delete them.
 	 */
-	api->updateKey(key, chunknum, arg);
-	(void) generic_toast_delete_optional_wal(api, key, oxid, csn, arg, wal);
+	if (!old_data || old_data_size > (Size) chunknum * max_length)
+	{
+		api->updateKey(key, chunknum, arg);
+		(void) generic_toast_delete_optional_wal(api, key, oxid, csn, arg, wal);
+	}
 
 	return success;
 }
 
+bool
+generic_toast_update_optional_wal(ToastAPI *api, void *key, Pointer data,
+								  Size data_size, OXid oxid, CommitSeqNo csn,
+								  void *arg, bool wal)
+{
+	return generic_toast_update_common(api, key, data, data_size, NULL, 0,
+									   oxid, csn, arg, wal);
+}
+
+bool
+generic_toast_update_changed(ToastAPI *api, void *key, Pointer data,
+							 Size data_size, Pointer old_data,
+							 Size old_data_size, OXid oxid, CommitSeqNo csn,
+							 void *arg)
+{
+	return generic_toast_update_common(api, key, data, data_size, old_data,
+									   old_data_size, oxid, csn, arg, true);
+}
+
 bool
 generic_toast_update(ToastAPI *api, void *key, Pointer data, Size data_size,
 					 OXid oxid, CommitSeqNo csn, void *arg)
@@ -756,6 +954,115 @@ generic_toast_get(ToastAPI *api, void *key, Size data_size,
 	return data;
 }
 
+/*
+ * Passes the part [offset, offset + length) of the value to the callback
+ * chunk by chunk.  Iteration starts from the chunk containing 'offset', so
+ * the preceding chunks are never read.  Stops after the chunk containing the
+ * end of the range, at the last chunk of the value, or when the callback
+ * returns false.  Returns the number of bytes passed to the callback.
+ */
+Size
+generic_toast_stream(ToastAPI *api, void *key, Size offset, Size length,
+					 OSnapshot *o_snapshot, void *arg,
+					 ToastStreamCallback callback, void *callback_arg)
+{
+	BTreeDescr *desc = api->getBTreeDesc(arg);
+	BTreeIterator *it;
+	void	   *nextKey;
+	uint32		max_length = api->getMaxChunkSize(key, arg);
+	uint32		firstChunk = offset / max_length;
+	Size		end = offset + length;
+	Size		passed = 0;
+
+	if (length == 0)
+		return 0;
+
+	nextKey = api->getNextKey(key, arg);
+	api->updateKey(key, firstChunk, arg);
+
+	it = o_btree_iterator_create(desc, key, BTreeKeyBound,
+								 o_snapshot, ForwardScanDirection);
+	if (api->versionCallback)
+		o_btree_iterator_set_callback(it, api->versionCallback, (void *) key);
+
+	do
+	{
+		OTuple		tup;
+		Size		chunkStart,
+					chunkEnd,
+					from,
+					to;
+		uint32		chunk_size;
+		bool		next;
+
+		tup = o_btree_iterator_fetch(it, NULL, nextKey, BTreeKeyBound, false, NULL);
+
+		/* if tuple not found */
+		if (O_TUPLE_IS_NULL(tup))
+			break;
+
+		chunk_size = api->getTupleDataSize(tup, arg);
+		chunkStart = (Size) api->getTupleChunknum(tup, arg) * max_length;
+		chunkEnd = chunkStart + chunk_size;
+
+		from = Max(chunkStart, offset);
+		to = Min(chunkEnd, end);
+		next = true;
+		if (from < to)
+		{
+			next = callback(api->getTupleData(tup, arg) + (from - chunkStart),
+							to - from, from, callback_arg);
+			passed += to - from;
+		}
+		pfree(tup.data);
+
+		if (!next || chunkEnd >= end || chunk_size < max_length)
+			break;
+	} while (true);
+
+	btree_iterator_free(it);
+	api->updateKey(key, 0, arg);
+
+	return passed;
+}
+
+typedef struct
+{
+	Pointer		data;
+	Size		offset;
+} ToastSliceBuffer;
+
+static bool
+toast_slice_callback(Pointer data, Size length, Size offset, void *arg)
+{
+	ToastSliceBuffer *buf = (ToastSliceBuffer *) arg;
+
+	memcpy(buf->data + (offset - buf->offset), data, length);
+	return true;
+}
+
+Pointer
+generic_toast_get_slice(ToastAPI *api, void *key, Size offset, Size length,
+						OSnapshot *o_snapshot, void *arg)
+{
+	ToastSliceBuffer buf;
+	Size		actual_size;
+
+	buf.data = palloc(length);
+	buf.offset = offset;
+
+	actual_size = generic_toast_stream(api, key, offset, length, o_snapshot,
+									   arg, toast_slice_callback, &buf);
+
+	Assert(actual_size == length);
+	if (actual_size != length)
+	{
+		pfree(buf.data);
+		return NULL;
+	}
+	return buf.data;
+}
+
 /*
  * Common code for
  * generic_toast_get_any_with_callback and generic_toast_get_any_with_key
@@ -905,6 +1212,29 @@ o_toast_sort_add(OIndexDescr *primary, OIndexDescr *toast,
 
 }
 
+bool
+o_toast_update(OIndexDescr *primary, OIndexDescr *toast, OTuple pk,
+			   uint16 attn, Pointer data, Size data_size,
+			   Pointer old_data, Size old_data_size,
+			   OXid oxid, CommitSeqNo csn)
+{
+	OToastKey	tkey;
+	bool		result;
+	OTableToastArg arg = {primary, toast};
+
+	tkey.pk_tuple = pk;
+	tkey.attnum = attn;
+	tkey.chunknum = 0;
+
+	Assert(toast->desc.type == oIndexToast);
+
+	result = generic_toast_update_changed(&tableToastAPI, (Pointer) &tkey,
+										  data, data_size, old_data,
+										  old_data_size, oxid, csn, &arg);
+
+	return result;
+}
+
 bool
 o_toast_delete(OIndexDescr *primary, OIndexDescr *toast,
 			   OTuple pk, uint16 attn,
@@ -947,6 +1277,27 @@ o_toast_get(OIndexDescr *primary, OIndexDescr *toast,
 	return result;
 }
 
+Pointer
+o_toast_get_slice(OIndexDescr *primary, OIndexDescr *toast,
+				  OTuple pk, uint16 attn,
+				  Size offset, Size length, OSnapshot *o_snapshot)
+{
+	OToastKey	tkey;
+	Pointer		result;
+	OTableToastArg arg = {primary, toast};
+
+	tkey.pk_tuple = pk;
+	tkey.attnum = attn;
+	tkey.chunknum = 0;
+
+	Assert(toast->desc.type == oIndexToast);
+
+	result = generic_toast_get_slice(&tableToastAPI, (Pointer) &tkey, offset,
+									 length, o_snapshot, &arg);
+
+	return result;
+}
+
 static OTuple
 o_create_toast_tuple(OToastKey tkey, Pointer data_ptr, Size data_length,
 					 OTableToastArg *arg)
@@ -0,0 +1,594 @@
+/*-------------------------------------------------------------------------
+ *
+ * bench.c
+ *		Microbenchmarks of the BTree primitives.
+ *
+ * Copyright (c) 2021-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/utils/bench.c
+ *
+ * NOTES
+ *
+ *		orioledb_btree_bench() runs the given number of operations against
+ *		the primary tree of an orioledb table with the single int8 primary
+ *		key column, bypassing the executor and the table access method.
+ *		The supported operations are:
+ *
+ *		- find_page: descent to the leaf containing the key;
+ *		- lookup: o_btree_find_tuple_by_key();
+ *		- insert: o_btree_modify() inserting the tuple with the key and nulls
+ *		  in the rest of columns.  The inserted tuples are a part of the
+ *		  current transaction.  So, the benchmark is meant for a scratch
+ *		  (typically temporary) table;
+ *		- reorg: btree_page_reorg() of the copy of the leaf containing the
+ *		  key;
+ *		- compress: o_compress_page() of the copy of the leaf containing the
+ *		  key using the compression level of the tree.
+ *
+ *		Keys are taken from the range [1, keys] with the sequential, uniform
+ *		or zipfian distribution.  The zipfian distribution (theta = 0.99)
+ *		isn't scrambled: the lower keys are the hotter ones.
+ *
+ *		Read-only operations may run in parallel workers.  The operations are
+ *		claimed by the participants in batches from the shared counter, so
+ *		the total number of operations is the same, however many workers
+ *		were actually launched.  Latencies are collected into per-participant
+ *		log-linear histograms having 8 buckets per power of two.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "btree/btree.h"
+#include "btree/find.h"
+#include "btree/iterator.h"
+#include "btree/modify.h"
+#include "btree/page_chunks.h"
+#include "btree/page_state.h"
+#include "recovery/wal.h"
+#include "tableam/descr.h"
+#include "tableam/handler.h"
+#include "transam/oxid.h"
+#include "tuple/format.h"
+#include "utils/bench.h"
+#include "utils/compress.h"
+
+#include <math.h>
+
+#include "access/parallel.h"
+#include "access/relation.h"
+#include "catalog/pg_type_d.h"
+#include "common/pg_prng.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "port/atomics.h"
+#include "port/pg_bitutils.h"
+#include "portability/instr_time.h"
+#include "utils/builtins.h"
+#include "utils/rel.h"
+
+PG_FUNCTION_INFO_V1(orioledb_btree_bench);
+
+#define PARALLEL_KEY_BENCH_SHARED	UINT64CONST(0xA000000000000101)
+
+/* Number of operations claimed by a participant at once */
+#define BENCH_BATCH_SIZE		(1024)
+
+/* Log-linear latency histogram: 8 buckets per power of two nanoseconds */
+#define BENCH_HIST_SUB_BITS		(3)
+#define BENCH_HIST_SUB_BUCKETS	(1 << BENCH_HIST_SUB_BITS)
+#define BENCH_HIST_BUCKETS		((64 - BENCH_HIST_SUB_BITS + 1) * BENCH_HIST_SUB_BUCKETS)
+
+#define BENCH_ZIPF_THETA		(0.99)
+
+typedef enum
+{
+	BTreeBenchFindPage,
+	BTreeBenchLookup,
+	BTreeBenchInsert,
+	BTreeBenchReorg,
+	BTreeBenchCompress
+} BTreeBenchOp;
+
+typedef enum
+{
+	BTreeBenchSequential,
+	BTreeBenchUniform,
+	BTreeBenchZipfian
+} BTreeBenchDist;
+
+typedef struct
+{
+	uint64		ops;
+	uint64		maxNs;
+	uint64		hist[BENCH_HIST_BUCKETS];
+} BTreeBenchResult;
+
+typedef struct
+{
+	ORelOids	oids;
+	BTreeBenchOp op;
+	BTreeBenchDist dist;
+	int64		nops;
+	int64		nkeys;
+	double		zetan;
+	int			nparticipants;
+	pg_atomic_uint64 nextOp;
+	pg_atomic_uint32 nextParticipant;
+	BTreeBenchResult results[FLEXIBLE_ARRAY_MEMBER];
+} BTreeBenchShared;
+
+typedef struct
+{
+	pg_prng_state prng;
+	double		alpha;
+	double		eta;
+} BTreeBenchKeyGen;
+
+static void
+bench_keygen_init(BTreeBenchKeyGen *gen, BTreeBenchShared *shared,
+				  uint32 participant)
+{
+	double		zeta2;
+
+	pg_prng_seed(&gen->prng, ((uint64) MyProcPid << 32) | participant);
+	if (shared->dist != BTreeBenchZipfian)
+		return;
+
+	zeta2 = 1.0 + pow(0.5, BENCH_ZIPF_THETA);
+	gen->alpha = 1.0 / (1.0 - BENCH_ZIPF_THETA);
+	gen->eta = (1.0 - pow(2.0 / shared->nkeys, 1.0 - BENCH_ZIPF_THETA)) /
+		(1.0 - zeta2 / shared->zetan);
+}
+
+static double
+bench_zeta(int64 n)
+{
+	double		sum = 0.0;
+	int64		i;
+
+	for (i = 1; i <= n; i++)
+	{
+		sum += 1.0 / pow((double) i, BENCH_ZIPF_THETA);
+		if ((i & 0xFFFF) == 0)
+			CHECK_FOR_INTERRUPTS();
+	}
+	return sum;
+}
+
+/*
+ * Returns the key for the operation number 'opnum'.  Zipfian generator
+ * follows "Quickly Generating Billion-Record Synthetic Databases" by Gray et
+ * al.
+ */
+static int64
+bench_next_key(BTreeBenchKeyGen *gen, BTreeBenchShared *shared, uint64 opnum)
+{
+	double		u,
+				uz;
+	int64		result;
+
+	switch (shared->dist)
+	{
+		case BTreeBenchSequential:
+			return (int64) (opnum % shared->nkeys) + 1;
+		case BTreeBenchUniform:
+			return (int64) pg_prng_uint64_range(&gen->prng, 1, shared->nkeys);
+		case BTreeBenchZipfian:
+			u = pg_prng_double(&gen->prng);
+			uz = u * shared->zetan;
+			if (uz < 1.0)
+				return 1;
+			if (uz < 1.0 + pow(0.5, BENCH_ZIPF_THETA))
+				return Min(2, shared->nkeys);
+			result = 1 + (int64) (shared->nkeys *
+								  pow(gen->eta * u - gen->eta + 1.0, gen->alpha));
+			return Min(result, shared->nkeys);
+	}
+	pg_unreachable();
+}
+
+static int
+bench_hist_bucket(uint64 ns)
+{
+	int			shift;
+
+	if (ns < BENCH_HIST_SUB_BUCKETS)
+		return (int) ns;
+	shift = pg_leftmost_one_pos64(ns) - BENCH_HIST_SUB_BITS;
+	return ((shift + 1) << BENCH_HIST_SUB_BITS) +
+		(int) ((ns >> shift) & (BENCH_HIST_SUB_BUCKETS - 1));
+}
+
+/*
+ * Returns the lowest latency falling into the histogram bucket.
+ */
+static uint64
+bench_hist_bucket_low(int bucket)
+{
+	int			shift;
+
+	if (bucket < BENCH_HIST_SUB_BUCKETS)
+		return (uint64) bucket;
+	shift = (bucket >> BENCH_HIST_SUB_BITS) - 1;
+	return (uint64) (BENCH_HIST_SUB_BUCKETS +
+					 (bucket & (BENCH_HIST_SUB_BUCKETS - 1))) << shift;
+}
+
+static void
+bench_fill_key_bound(OIndexDescr *id, int64 key, OBTreeKeyBound *bound)
+{
+	bound->nkeys = 1;
+	bound->n_row_keys = 0;
+	bound->row_keys = NULL;
+	bound->keys[0].value = Int64GetDatum(key);
+	bound->keys[0].type = INT8OID;
+	bound->keys[0].flags = O_VALUE_BOUND_PLAIN_VALUE;
+	bound->keys[0].comparator = id->fields[0].comparator;
+}
+
+/*
+ * Copies the leaf containing the key to 'img'.
+ */
+static void
+bench_copy_leaf(OBTreeFindPageContext *context, OIndexDescr *id,
+				OBTreeKeyBound *bound, Page img)
+{
+	OInMemoryBlkno blkno;
+
+	init_page_find_context(context, &id->desc, COMMITSEQNO_INPROGRESS,
+						   BTREE_PAGE_FIND_MODIFY);
+	(void) find_page(context, bound, BTreeKeyBound, 0);
+	blkno = context->items[context->index].blkno;
+	memcpy(img, O_GET_IN_MEMORY_PAGE(blkno), ORIOLEDB_BLCKSZ);
+	unlock_page(blkno);
+}
+
+/*
+ * Runs the benchmark operations in the current process until the shared
+ * counter is exhausted.
+ */
+static void
+bench_run(BTreeBenchShared *shared, OTableDescr *descr)
+{
+	OIndexDescr *id = GET_PRIMARY(descr);
+	BTreeDescr *desc = &id->desc;
+	BTreeBenchResult *result;
+	BTreeBenchKeyGen gen;
+	OBTreeFindPageContext *context;
+	Page		img;
+	Datum	   *values = NULL;
+	bool	   *isnull = NULL;
+	AttrNumber	keyAttnum = id->fields[0].tableAttnum;
+	OCompress	compress;
+	OXid		oxid = InvalidOXid;
+	CommitSeqNo csn = COMMITSEQNO_INPROGRESS;
+	uint32		participant;
+
+	participant = pg_atomic_fetch_add_u32(&shared->nextParticipant, 1);
+	Assert(participant < shared->nparticipants);
+	result = &shared->results[participant];
+	bench_keygen_init(&gen, shared, participant);
+
+	context = (OBTreeFindPageContext *) palloc(sizeof(OBTreeFindPageContext));
+	img = (Page) palloc(ORIOLEDB_BLCKSZ);
+	compress = OCompressIsValid(id->compress) ? id->compress : O_COMPRESS_DEFAULT;
+
+	if (shared->op == BTreeBenchInsert)
+	{
+		OSnapshot	oSnapshot;
+
+		values = (Datum *) palloc0(sizeof(Datum) * id->leafTupdesc->natts);
+		isnull = (bool *) palloc(sizeof(bool) * id->leafTupdesc->natts);
+		memset(isnull, true, sizeof(bool) * id->leafTupdesc->natts);
+		isnull[keyAttnum - 1] = false;
+		fill_current_oxid_osnapshot(&oxid, &oSnapshot);
+		csn = oSnapshot.csn;
+	}
+
+	o_btree_load_shmem(desc);
+
+	while (true)
+	{
+		uint64		opnum,
+					opend;
+
+		opnum = pg_atomic_fetch_add_u64(&shared->nextOp, BENCH_BATCH_SIZE);
+		if (opnum >= (uint64) shared->nops)
+			break;
+		opend = Min(opnum + BENCH_BATCH_SIZE, (uint64) shared->nops);
+
+		for (; opnum < opend; opnum++)
+		{
+			OBTreeKeyBound bound;
+			OTuple		tuple = {0};
+			instr_time	start,
+						duration;
+			uint64		ns;
+			size_t		size;
+
+			CHECK_FOR_INTERRUPTS();
+
+			bench_fill_key_bound(id, bench_next_key(&gen, shared, opnum),
+								 &bound);
+			if (shared->op == BTreeBenchInsert)
+			{
+				values[keyAttnum - 1] = bound.keys[0].value;
+				tuple = o_form_tuple(id->leafTupdesc, &id->leafSpec, 0,
+									 values, isnull);
+			}
+			else if (shared->op == BTreeBenchReorg ||
+					 shared->op == BTreeBenchCompress)
+			{
+				bench_copy_leaf(context, id, &bound, img);
+			}
+
+			INSTR_TIME_SET_CURRENT(start);
+			switch (shared->op)
+			{
+				case BTreeBenchFindPage:
+					init_page_find_context(context, desc,
+										   COMMITSEQNO_INPROGRESS,
+										   BTREE_PAGE_FIND_IMAGE);
+					(void) find_page(context, &bound, BTreeKeyBound, 0);
+					break;
+				case BTreeBenchLookup:
+					tuple = o_btree_find_tuple_by_key(desc, &bound,
+													  BTreeKeyBound,
+													  &o_in_progress_snapshot,
+													  NULL,
+													  CurrentMemoryContext,
+													  NULL);
+					break;
+				case BTreeBenchInsert:
+					if (o_btree_modify(desc, BTreeOperationInsert,
+									   tuple, BTreeKeyLeafTuple,
+									   (Pointer) &bound, BTreeKeyBound,
+									   oxid, csn, RowLockUpdate,
+									   NULL, &nullCallbackInfo) == OBTreeModifyResultInserted &&
+						desc->storageType == BTreeStoragePersistence)
+						o_wal_insert(desc, tuple);
+					break;
+				case BTreeBenchReorg:
+					split_page_by_chunks(desc, img);
+					break;
+				case BTreeBenchCompress:
+					(void) o_compress_page(img, &size, compress);
+					break;
+			}
+			INSTR_TIME_SET_CURRENT(duration);
+			INSTR_TIME_SUBTRACT(duration, start);
+
+#if PG_VERSION_NUM >= 160000
+			ns = INSTR_TIME_GET_NANOSEC(duration);
+#else
+			ns = (uint64) (INSTR_TIME_GET_DOUBLE(duration) * 1000000000.0);
+#endif
+			result->ops++;
+			result->maxNs = Max(result->maxNs, ns);
+			result->hist[bench_hist_bucket(ns)]++;
+
+			if (!O_TUPLE_IS_NULL(tuple))
+				pfree(tuple.data);
+		}
+	}
+
+	pfree(context);
+	pfree(img);
+}
+
+void
+o_btree_bench_worker_main(dsm_segment *seg, shm_toc *toc)
+{
+	BTreeBenchShared *shared;
+	OTableDescr *descr;
+
+	shared = (BTreeBenchShared *) shm_toc_lookup(toc, PARALLEL_KEY_BENCH_SHARED,
+												 false);
+	descr = o_fetch_table_descr(shared->oids);
+	if (descr == NULL)
+		elog(ERROR, "orioledb table descriptor is not found");
+	bench_run(shared, descr);
+}
+
+static BTreeBenchOp
+bench_parse_op(const char *name)
+{
+	if (strcmp(name, "find_page") == 0)
+		return BTreeBenchFindPage;
+	if (strcmp(name, "lookup") == 0)
+		return BTreeBenchLookup;
+	if (strcmp(name, "insert") == 0)
+		return BTreeBenchInsert;
+	if (strcmp(name, "reorg") == 0)
+		return BTreeBenchReorg;
+	if (strcmp(name, "compress") == 0)
+		return BTreeBenchCompress;
+	ereport(ERROR,
+			(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+			 errmsg("unknown benchmark operation \"%s\"", name),
+			 errhint("Valid operations are \"find_page\", \"lookup\", \"insert\", \"reorg\" and \"compress\".")));
+	pg_unreachable();
+}
+
+static BTreeBenchDist
+bench_parse_dist(const char *name)
+{
+	if (strcmp(name, "sequential") == 0)
+		return BTreeBenchSequential;
+	if (strcmp(name, "uniform") == 0)
+		return BTreeBenchUniform;
+	if (strcmp(name, "zipfian") == 0)
+		return BTreeBenchZipfian;
+	ereport(ERROR,
+			(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+			 errmsg("unknown key distribution \"%s\"", name),
+			 errhint("Valid distributions are \"sequential\", \"uniform\" and \"zipfian\".")));
+	pg_unreachable();
+}
+
+/*
+ * Returns the latency in microseconds below which 'fraction' of operations
+ * fit, using the upper bound of the histogram bucket.
+ */
+static double
+bench_percentile(BTreeBenchResult *total, double fraction)
+{
+	uint64		threshold = (uint64) ceil(total->ops * fraction);
+	uint64		count = 0;
+	int			i;
+
+	for (i = 0; i < BENCH_HIST_BUCKETS; i++)
+	{
+		count += total->hist[i];
+		if (count >= threshold && count > 0)
+		{
+			uint64		high = i + 1 < BENCH_HIST_BUCKETS ?
+				bench_hist_bucket_low(i + 1) : total->maxNs;
+
+			return Min(high, total->maxNs) / 1000.0;
+		}
+	}
+	return 0.0;
+}
+
+Datum
+orioledb_btree_bench(PG_FUNCTION_ARGS)
+{
+	Oid			relid = PG_GETARG_OID(0);
+	char	   *opName = text_to_cstring(PG_GETARG_TEXT_PP(1));
+	int64		nops = PG_GETARG_INT64(2);
+	char	   *distName = text_to_cstring(PG_GETARG_TEXT_PP(3));
+	int64		nkeys = PG_GETARG_INT64(4);
+	int			nworkers = PG_GETARG_INT32(5);
+	BTreeBenchOp op = bench_parse_op(opName);
+	BTreeBenchDist dist = bench_parse_dist(distName);
+	BTreeBenchShared *shared;
+	BTreeBenchResult total;
+	ParallelContext *pcxt = NULL;
+	Relation	rel;
+	OTableDescr *descr;
+	OIndexDescr *primary;
+	Size		sharedSize;
+	TupleDesc	tupdesc;
+	Datum		values[7];
+	bool		nulls[7] = {false};
+	instr_time	start,
+				elapsed;
+	double		elapsedMs;
+	int			i;
+
+	if (nops < 0 || nkeys <= 0 || nworkers < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("ops and workers must not be negative, and keys must be positive")));
+	if (op == BTreeBenchInsert && nworkers > 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("insert benchmark can't use parallel workers")));
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	orioledb_check_shmem();
+
+	rel = relation_open(relid, AccessShareLock);
+	if (!is_orioledb_rel(rel))
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("\"%s\" is not an orioledb table",
+						RelationGetRelationName(rel))));
+	descr = relation_get_descr(rel);
+	primary = GET_PRIMARY(descr);
+	if (primary->primaryIsCtid || primary->nKeyFields != 1 ||
+		primary->nonLeafTupdesc->attrs[0].atttypid != INT8OID)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("\"%s\" must have the single int8 primary key column",
+						RelationGetRelationName(rel))));
+	if (op == BTreeBenchInsert && descr->nIndices > 1)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("insert benchmark doesn't support secondary indices")));
+
+	sharedSize = add_size(offsetof(BTreeBenchShared, results),
+						  mul_size(sizeof(BTreeBenchResult), nworkers + 1));
+
+	if (nworkers > 0)
+	{
+		EnterParallelMode();
+		pcxt = CreateParallelContext("orioledb", "o_btree_bench_worker_main",
+									 nworkers);
+		shm_toc_estimate_chunk(&pcxt->estimator, sharedSize);
+		shm_toc_estimate_keys(&pcxt->estimator, 1);
+		InitializeParallelDSM(pcxt);
+		if (pcxt->seg == NULL)
+			ereport(ERROR,
+					(errcode(ERRCODE_OUT_OF_MEMORY),
+					 errmsg("could not create dynamic shared memory segment for benchmark")));
+		shared = (BTreeBenchShared *) shm_toc_allocate(pcxt->toc, sharedSize);
+		shm_toc_insert(pcxt->toc, PARALLEL_KEY_BENCH_SHARED, shared);
+	}
+	else
+	{
+		shared = (BTreeBenchShared *) palloc(sharedSize);
+	}
+
+	memset(shared, 0, sharedSize);
+	shared->oids = descr->oids;
+	shared->op = op;
+	shared->dist = dist;
+	shared->nops = nops;
+	shared->nkeys = nkeys;
+	shared->zetan = (dist == BTreeBenchZipfian) ? bench_zeta(nkeys) : 0.0;
+	shared->nparticipants = nworkers + 1;
+	pg_atomic_init_u64(&shared->nextOp, 0);
+	pg_atomic_init_u32(&shared->nextParticipant, 0);
+
+	INSTR_TIME_SET_CURRENT(start);
+	if (pcxt)
+		LaunchParallelWorkers(pcxt);
+	bench_run(shared, descr);
+	if (pcxt)
+		WaitForParallelWorkersToFinish(pcxt);
+	INSTR_TIME_SET_CURRENT(elapsed);
+	INSTR_TIME_SUBTRACT(elapsed, start);
+	elapsedMs = INSTR_TIME_GET_MILLISEC(elapsed);
+
+	memset(&total, 0, sizeof(total));
+	for (i = 0; i < shared->nparticipants; i++)
+	{
+		BTreeBenchResult *result = &shared->results[i];
+		int			j;
+
+		total.ops += result->ops;
+		total.maxNs = Max(total.maxNs, result->maxNs);
+		for (j = 0; j < BENCH_HIST_BUCKETS; j++)
+			total.hist[j] += result->hist[j];
+	}
+
+	if (pcxt)
+	{
+		DestroyParallelContext(pcxt);
+		ExitParallelMode();
+	}
+	else
+	{
+		pfree(shared);
+	}
+	relation_close(rel, AccessShareLock);
+
+	values[0] = Int64GetDatum((int64) total.ops);
+	values[1] = Float8GetDatum(elapsedMs);
+	values[2] = Float8GetDatum(elapsedMs > 0.0 ?
+							   total.ops * 1000.0 / elapsedMs : 0.0);
+	values[3] = Float8GetDatum(bench_percentile(&total, 0.5));
+	values[4] = Float8GetDatum(bench_percentile(&total, 0.9));
+	values[5] = Float8GetDatum(bench_percentile(&total, 0.99));
+	values[6] = Float8GetDatum(total.maxNs / 1000.0);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
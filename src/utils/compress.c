@@ -1,13 +1,26 @@
 /*-------------------------------------------------------------------------
  *
  * compress.c
- *		Compression functions for BTree pages. Wrapper for libzstd.
+ *		Compression functions for BTree pages. Wrapper for libzstd and liblz4.
  *
  * Copyright (c) 2021-2025, Oriole DB Inc.
  *
  * IDENTIFICATION
  *	  contrib/orioledb/src/utils/compress.c
  *
+ * NOTES
+ *
+ *		Trees might have trained compression dictionaries.  Dictionaries are
+ *		stored in the immutable "<relnode>-<dictId>.dict" files alongside the
+ *		tree data files.  Dictionary ids are dense starting from 1, the last
+ *		one is used for the new page images.  The page image records the
+ *		dictionary id in OCompressHeader, zero means no dictionary.  Thus, the
+ *		previously written pages stay readable.
+ *
+ *		Each backend caches a few loaded dictionaries.  The relnode might be
+ *		reused after the tree drop, so cached dictionaries are validated using
+ *		the zstd dictionary id, which is random for the trained dictionaries.
+ *
  *-------------------------------------------------------------------------
  */
 #include "postgres.h"
@@ -16,16 +29,50 @@
 
 #include "utils/compress.h"
 
+#include "storage/fd.h"
 #include "utils/elog.h"
 #include "utils/memdebug.h"
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <zstd.h>
+#include <zdict.h>
+#ifdef USE_LZ4
+#include <lz4.h>
+#include <lz4hc.h>
+#endif
+
+/* Number of the dictionaries cached by a backend */
+#define O_COMPRESS_DICT_CACHE_SIZE	16
+
+typedef struct
+{
+	Oid			datoid;
+	Oid			relnode;
+	uint16		dictId;
+	uint32		zstdDictId;
+	Pointer		data;
+	size_t		size;
+	ZSTD_CDict *cdict;
+	OCompress	cdictLvl;
+	ZSTD_DDict *ddict;
+	uint64		lastUsed;
+} OCompressDictCacheEntry;
 
 static ZSTD_CCtx *zstd_cctx = NULL;
 static ZSTD_DCtx *zstd_dctx = NULL;
 static size_t zstd_dst_size;
 static Pointer zstd_dst = NULL;
 
+static OCompressDictCacheEntry dict_cache[O_COMPRESS_DICT_CACHE_SIZE];
+static uint64 dict_cache_counter = 0;
+
+#ifdef USE_LZ4
+static void *lz4_state = NULL;
+static void *lz4hc_state = NULL;
+#endif
+
 /*
  * Initializes compression context.
  */
@@ -35,6 +82,11 @@ o_compress_init(void)
 	zstd_cctx = ZSTD_createCCtx();
 	zstd_dctx = ZSTD_createDCtx();
 	zstd_dst_size = ZSTD_compressBound(ORIOLEDB_BLCKSZ);
+#ifdef USE_LZ4
+	zstd_dst_size = Max(zstd_dst_size, LZ4_compressBound(ORIOLEDB_BLCKSZ));
+	lz4_state = malloc(LZ4_sizeofState());
+	lz4hc_state = malloc(LZ4_sizeofStateHC());
+#endif
 	zstd_dst = malloc(zstd_dst_size);
 
 	/*
@@ -48,6 +100,143 @@ o_compress_init(void)
 	VALGRIND_MAKE_MEM_DEFINED(zstd_dst, ORIOLEDB_BLCKSZ);
 }
 
+static void
+dict_file_name(char *path, Oid datoid, Oid relnode, uint16 dictId)
+{
+	snprintf(path, MAXPGPATH, ORIOLEDB_DATA_DIR "/%u/%u-%u.dict",
+			 datoid, relnode, dictId);
+}
+
+/*
+ * Reads the dictionary file into the malloc'ed buffer.  Called during the
+ * page reads and writes, so it avoids palloc() and doesn't throw errors.
+ */
+static bool
+dict_file_read(Oid datoid, Oid relnode, uint16 dictId,
+			   Pointer *data, size_t *size)
+{
+	char		path[MAXPGPATH];
+	struct stat st;
+	size_t		done = 0;
+	int			fd;
+
+	dict_file_name(path, datoid, relnode, dictId);
+	fd = BasicOpenFile(path, O_RDONLY | PG_BINARY);
+	if (fd < 0)
+		return false;
+
+	if (fstat(fd, &st) < 0 || st.st_size == 0 ||
+		st.st_size > O_COMPRESS_DICT_MAX_SIZE ||
+		(*data = malloc(st.st_size)) == NULL)
+	{
+		close(fd);
+		return false;
+	}
+
+	while (done < (size_t) st.st_size)
+	{
+		ssize_t		len = read(fd, *data + done, st.st_size - done);
+
+		if (len <= 0)
+		{
+			free(*data);
+			close(fd);
+			return false;
+		}
+		done += len;
+	}
+
+	close(fd);
+	*size = st.st_size;
+	return true;
+}
+
+static void
+dict_cache_entry_clear(OCompressDictCacheEntry *entry)
+{
+	if (entry->cdict)
+		ZSTD_freeCDict(entry->cdict);
+	if (entry->ddict)
+		ZSTD_freeDDict(entry->ddict);
+	if (entry->data)
+		free(entry->data);
+	memset(entry, 0, sizeof(*entry));
+}
+
+/*
+ * Returns the cached dictionary loading it if needed.  'reload' forces
+ * re-reading of the dictionary file.  Returns NULL if the dictionary file
+ * can't be read.
+ */
+static OCompressDictCacheEntry *
+dict_cache_get(Oid datoid, Oid relnode, uint16 dictId, bool reload)
+{
+	OCompressDictCacheEntry *entry = NULL;
+	int			i;
+
+	for (i = 0; i < O_COMPRESS_DICT_CACHE_SIZE; i++)
+	{
+		OCompressDictCacheEntry *cur = &dict_cache[i];
+
+		if (cur->data && cur->datoid == datoid && cur->relnode == relnode &&
+			cur->dictId == dictId)
+		{
+			entry = cur;
+			if (!reload)
+			{
+				entry->lastUsed = ++dict_cache_counter;
+				return entry;
+			}
+			break;
+		}
+	}
+
+	if (!entry)
+	{
+		/* Choose the free or least recently used slot */
+		entry = &dict_cache[0];
+		for (i = 0; i < O_COMPRESS_DICT_CACHE_SIZE && entry->data; i++)
+		{
+			if (!dict_cache[i].data ||
+				dict_cache[i].lastUsed < entry->lastUsed)
+				entry = &dict_cache[i];
+		}
+	}
+
+	dict_cache_entry_clear(entry);
+	if (!dict_file_read(datoid, relnode, dictId, &entry->data, &entry->size))
+		return NULL;
+
+	entry->datoid = datoid;
+	entry->relnode = relnode;
+	entry->dictId = dictId;
+	entry->zstdDictId = ZSTD_getDictID_fromDict(entry->data, entry->size);
+	entry->lastUsed = ++dict_cache_counter;
+	return entry;
+}
+
+#ifdef USE_LZ4
+static Pointer
+o_compress_page_lz4(Pointer page, size_t *size, OCompress lvl)
+{
+	int			result;
+
+	if (lvl == O_COMPRESS_LZ4)
+		result = LZ4_compress_fast_extState(lz4_state, page, zstd_dst,
+											ORIOLEDB_BLCKSZ, zstd_dst_size, 1);
+	else
+		result = LZ4_compress_HC_extStateHC(lz4hc_state, page, zstd_dst,
+											ORIOLEDB_BLCKSZ, zstd_dst_size,
+											lvl - O_COMPRESS_LZ4);
+	if (result <= 0)
+		elog(PANIC, "Unable to compress page with LZ4");
+
+	*size = result;
+	VALGRIND_MAKE_MEM_DEFINED(zstd_dst, *size);
+	return zstd_dst;
+}
+#endif
+
 /*
  * Compresses a BTree page.
  */
@@ -55,6 +244,15 @@ Pointer
 o_compress_page(Pointer page, size_t *size, OCompress lvl)
 {
 	VALGRIND_CHECK_MEM_IS_DEFINED(page, ORIOLEDB_BLCKSZ);
+	if (OCompressIsLZ4(lvl))
+	{
+#ifdef USE_LZ4
+		return o_compress_page_lz4(page, size, lvl);
+#else
+		elog(PANIC, "LZ4 compression is not supported by this build");
+#endif
+	}
+
 	*size = ZSTD_compressCCtx(zstd_cctx,
 							  zstd_dst, zstd_dst_size,
 							  page, ORIOLEDB_BLCKSZ,
@@ -70,16 +268,116 @@ o_compress_page(Pointer page, size_t *size, OCompress lvl)
 }
 
 /*
- * Decompresses a BTree page.
+ * Compresses a BTree page using the tree dictionary 'dict' (see
+ * O_COMPRESS_DICT_MAKE()).  Falls back to the compression without
+ * dictionary if the dictionary can't be loaded.  Sets '*dictId' to the
+ * dictionary actually used.
+ */
+Pointer
+o_compress_page_dict(Pointer page, size_t *size, OCompress lvl,
+					 Oid datoid, Oid relnode, uint64 dict, uint16 *dictId)
+{
+	OCompressDictCacheEntry *entry;
+	uint16		id = O_COMPRESS_DICT_GET_ID(dict);
+	uint32		zstdId = O_COMPRESS_DICT_GET_ZSTD_ID(dict);
+
+	*dictId = 0;
+	if (id == 0 || OCompressIsLZ4(lvl))
+		return o_compress_page(page, size, lvl);
+
+	entry = dict_cache_get(datoid, relnode, id, false);
+	if (entry && entry->zstdDictId != zstdId)
+		entry = dict_cache_get(datoid, relnode, id, true);
+	if (!entry || entry->zstdDictId != zstdId)
+		return o_compress_page(page, size, lvl);
+
+	if (entry->cdict && entry->cdictLvl != lvl)
+	{
+		ZSTD_freeCDict(entry->cdict);
+		entry->cdict = NULL;
+	}
+	if (!entry->cdict)
+	{
+		entry->cdict = ZSTD_createCDict(entry->data, entry->size, lvl);
+		entry->cdictLvl = lvl;
+		if (!entry->cdict)
+			return o_compress_page(page, size, lvl);
+	}
+
+	VALGRIND_CHECK_MEM_IS_DEFINED(page, ORIOLEDB_BLCKSZ);
+	*size = ZSTD_compress_usingCDict(zstd_cctx,
+									 zstd_dst, zstd_dst_size,
+									 page, ORIOLEDB_BLCKSZ,
+									 entry->cdict);
+	VALGRIND_MAKE_MEM_DEFINED(zstd_dst, *size);
+	if (ZSTD_isError(*size))
+	{
+		elog(PANIC,
+			 "Unable to compress page, reason: %s", ZSTD_getErrorName(*size));
+	}
+
+	*dictId = id;
+	return zstd_dst;
+}
+
+/*
+ * Decompresses a BTree page.  'algorithm' and 'dictId' are taken from
+ * OCompressHeader, zero 'dictId' means no dictionary.
  */
 void
-o_decompress_page(Pointer src, size_t size, Pointer page)
+o_decompress_page(Pointer src, size_t size, Pointer page, int algorithm,
+				  Oid datoid, Oid relnode, uint16 dictId)
 {
 	size_t		result;
 
-	result = ZSTD_decompressDCtx(zstd_dctx,
-								 page, ORIOLEDB_BLCKSZ,
-								 src, size);
+	if (algorithm == O_COMPRESS_ALGORITHM_LZ4)
+	{
+#ifdef USE_LZ4
+		int			lz4result;
+
+		lz4result = LZ4_decompress_safe(src, page, size, ORIOLEDB_BLCKSZ);
+		if (lz4result != ORIOLEDB_BLCKSZ)
+			elog(PANIC, "Unable to decompress LZ4 page, result: %d", lz4result);
+		return;
+#else
+		elog(PANIC, "LZ4 compression is not supported by this build");
+#endif
+	}
+	else if (algorithm != O_COMPRESS_ALGORITHM_ZSTD)
+		elog(PANIC, "Unknown page compression algorithm %d", algorithm);
+
+	if (dictId == 0)
+	{
+		result = ZSTD_decompressDCtx(zstd_dctx,
+									 page, ORIOLEDB_BLCKSZ,
+									 src, size);
+	}
+	else
+	{
+		OCompressDictCacheEntry *entry;
+		uint32		zstdId = ZSTD_getDictID_fromFrame(src, size);
+
+		entry = dict_cache_get(datoid, relnode, dictId, false);
+		if (entry && entry->zstdDictId != zstdId)
+			entry = dict_cache_get(datoid, relnode, dictId, true);
+		if (!entry || entry->zstdDictId != zstdId)
+			elog(PANIC, "Unable to decompress page, compression dictionary %u of relnode %u is not found",
+				 dictId, relnode);
+
+		if (!entry->ddict)
+		{
+			entry->ddict = ZSTD_createDDict(entry->data, entry->size);
+			if (!entry->ddict)
+				elog(PANIC, "Unable to load compression dictionary %u of relnode %u",
+					 dictId, relnode);
+		}
+
+		result = ZSTD_decompress_usingDDict(zstd_dctx,
+											page, ORIOLEDB_BLCKSZ,
+											src, size,
+											entry->ddict);
+	}
+
 	if (ZSTD_isError(result))
 	{
 		elog(PANIC,
@@ -89,6 +387,157 @@ o_decompress_page(Pointer src, size_t size, Pointer page)
 	Assert(result == ORIOLEDB_BLCKSZ);
 }
 
+/*
+ * Compresses an arbitrary buffer into 'dst'.  Returns zero if the compressed
+ * data doesn't fit 'dstCapacity'.
+ */
+size_t
+o_compress_buffer(Pointer src, size_t srcSize, Pointer dst,
+				  size_t dstCapacity, OCompress lvl)
+{
+	size_t		result;
+
+	result = ZSTD_compressCCtx(zstd_cctx, dst, dstCapacity, src, srcSize, lvl);
+	if (ZSTD_isError(result))
+		return 0;
+
+	return result;
+}
+
+/*
+ * Decompresses a buffer compressed by o_compress_buffer().  The decompressed
+ * size must be exactly 'dstSize'.
+ */
+void
+o_decompress_buffer(Pointer src, size_t size, Pointer dst, size_t dstSize)
+{
+	size_t		result;
+
+	result = ZSTD_decompressDCtx(zstd_dctx, dst, dstSize, src, size);
+	if (ZSTD_isError(result))
+	{
+		elog(PANIC,
+			 "Unable to decompress buffer, reason: %s", ZSTD_getErrorName(result));
+	}
+
+	if (result != dstSize)
+		elog(PANIC, "Unexpected decompressed buffer size %zu, expected %zu",
+			 result, dstSize);
+}
+
+/*
+ * Trains the compression dictionary of up to 'dictCapacity' bytes on the
+ * samples.  Returns the palloc'ed dictionary, sets its size and zstd id.
+ */
+Pointer
+o_compress_dict_train(Pointer samples, size_t *sampleSizes, int nsamples,
+					  size_t dictCapacity, size_t *dictSize, uint32 *zstdId)
+{
+	Pointer		dict = palloc(dictCapacity);
+	size_t		result;
+
+	result = ZDICT_trainFromBuffer(dict, dictCapacity, samples,
+								   sampleSizes, nsamples);
+	if (ZDICT_isError(result))
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_RESOURCES),
+				 errmsg("could not train compression dictionary: %s",
+						ZDICT_getErrorName(result)),
+				 errhint("Sample more pages or reduce the dictionary size.")));
+
+	*dictSize = result;
+	*zstdId = ZSTD_getDictID_fromDict(dict, result);
+	return dict;
+}
+
+/*
+ * Durably writes the new dictionary file.  The page images might refer the
+ * dictionary only once this function returns.
+ */
+void
+o_compress_dict_write(Oid datoid, Oid relnode, uint16 dictId,
+					  Pointer dict, size_t size)
+{
+	char		path[MAXPGPATH];
+	char		tmpPath[MAXPGPATH];
+	int			fd;
+
+	o_check_init_db_dir(datoid);
+	dict_file_name(path, datoid, relnode, dictId);
+	snprintf(tmpPath, MAXPGPATH, "%s.tmp", path);
+
+	fd = OpenTransientFile(tmpPath, O_RDWR | O_CREAT | O_TRUNC | PG_BINARY);
+	if (fd < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not create file \"%s\": %m", tmpPath)));
+
+	errno = 0;
+	if (write(fd, dict, size) != (ssize_t) size)
+	{
+		/* if write didn't set errno, assume problem is no disk space */
+		if (errno == 0)
+			errno = ENOSPC;
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not write file \"%s\": %m", tmpPath)));
+	}
+
+	if (pg_fsync(fd) != 0)
+		ereport(data_sync_elevel(ERROR),
+				(errcode_for_file_access(),
+				 errmsg("could not fsync file \"%s\": %m", tmpPath)));
+
+	if (CloseTransientFile(fd) != 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not close file \"%s\": %m", tmpPath)));
+
+	(void) durable_rename(tmpPath, path, ERROR);
+}
+
+/*
+ * Finds the last dictionary of the tree.  Returns the value made by
+ * O_COMPRESS_DICT_MAKE(), zero if the tree has no dictionaries.  Called
+ * during the tree loading, so it doesn't throw errors: new page images are
+ * just written without dictionary if the last one is unreadable.
+ */
+uint64
+o_compress_dict_find_last(Oid datoid, Oid relnode)
+{
+	char		path[MAXPGPATH];
+	struct stat st;
+	uint32		dictId = 0;
+	Pointer		data;
+	size_t		size;
+	uint64		result;
+
+	while (dictId < O_COMPRESS_DICT_MAX_ID)
+	{
+		dict_file_name(path, datoid, relnode, dictId + 1);
+		if (stat(path, &st) != 0)
+			break;
+		dictId++;
+	}
+
+	if (dictId == 0)
+		return 0;
+
+	if (!dict_file_read(datoid, relnode, dictId, &data, &size))
+	{
+		dict_file_name(path, datoid, relnode, dictId);
+		ereport(WARNING,
+				(errcode_for_file_access(),
+				 errmsg("could not read compression dictionary file \"%s\": %m",
+						path)));
+		return 0;
+	}
+
+	result = O_COMPRESS_DICT_MAKE(dictId, ZSTD_getDictID_fromDict(data, size));
+	free(data);
+	return result;
+}
+
 /*
  * Returns max orioledb compression level.
  */
@@ -98,11 +547,37 @@ o_compress_max_lvl()
 	return ZSTD_maxCLevel();
 }
 
+/*
+ * Returns the text representation of the compression setting, as accepted by
+ * o_parse_compress().
+ */
+char *
+o_compress_name(OCompress compress)
+{
+	if (compress == O_COMPRESS_LZ4)
+		return pstrdup("lz4");
+	else if (OCompressIsLZ4(compress))
+		return psprintf("lz4hc:%d", compress - O_COMPRESS_LZ4);
+	else
+		return psprintf("%d", compress);
+}
+
 void
 validate_compress(OCompress compress, char *prefix)
 {
 	OCompress	max_compress = o_compress_max_lvl();
 
+	if (OCompressIsLZ4(compress))
+	{
+#ifndef USE_LZ4
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("%s compression \"%s\" is not supported by this build",
+						prefix, o_compress_name(compress))));
+#endif
+		return;
+	}
+
 	if (compress < -1 || compress > max_compress)
 	{
 		elog(ERROR, "%s compression level must be between %d and %d",
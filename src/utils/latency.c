@@ -0,0 +1,417 @@
+/*-------------------------------------------------------------------------
+ *
+ * latency.c
+ *		Latency histograms for the critical paths.
+ *
+ * Copyright (c) 2025-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/utils/latency.c
+ *
+ * NOTES
+ *
+ *		Every process has its own set of histograms in the shared memory,
+ *		which only this process writes.  So, the accounting needs neither
+ *		locks nor atomic read-modify-write operations.  The histograms are
+ *		summed up on demand by orioledb_latency_stats() and
+ *		orioledb_latency_histogram().
+ *
+ *		The buckets are log-linear: each power of two nanoseconds is split
+ *		into LATENCY_HIST_SUB_BUCKETS buckets, so the relative error of the
+ *		bucket bounds is within 25%.  Latencies above 2^36 ns (~69 seconds)
+ *		fall into the last bucket.
+ *
+ *		The reset doesn't touch the histograms of other processes.  Instead it
+ *		advances the shared generation number.  Each process zeroes its
+ *		histograms before the next accounting once it sees the new generation,
+ *		while the histograms of the previous generation are skipped by the
+ *		aggregation.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <math.h>
+
+#include "orioledb.h"
+
+#include "utils/latency.h"
+
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "port/pg_bitutils.h"
+#include "storage/proc.h"
+#include "utils/builtins.h"
+#include "utils/tuplestore.h"
+
+#define LATENCY_HIST_SUB_BITS		(2)
+#define LATENCY_HIST_SUB_BUCKETS	(1 << LATENCY_HIST_SUB_BITS)
+#define LATENCY_HIST_MAX_BITS		(36)
+#define LATENCY_HIST_BUCKETS \
+	((LATENCY_HIST_MAX_BITS - LATENCY_HIST_SUB_BITS + 1) * LATENCY_HIST_SUB_BUCKETS)
+
+typedef struct
+{
+	pg_atomic_uint64 counts[LATENCY_HIST_BUCKETS];
+	pg_atomic_uint64 sum;		/* in nanoseconds */
+	pg_atomic_uint64 max;		/* in nanoseconds */
+} LatencyHistogram;
+
+typedef struct
+{
+	pg_atomic_uint32 generation;
+	LatencyHistogram hists[OLatencyEventsCount];
+} ProcLatencyHistograms;
+
+typedef struct
+{
+	pg_atomic_uint32 generation;
+	ProcLatencyHistograms procs[FLEXIBLE_ARRAY_MEMBER];
+} LatencyMeta;
+
+static const char *const latencyEventNames[OLatencyEventsCount] = {
+	"load_page_memory",
+	"load_page_disk",
+	"load_page_s3",
+	"evict_page",
+	"compress_page",
+	"decompress_page",
+	"commit_flush",
+	"page_lock_wait"
+};
+
+bool		latency_histograms = true;
+
+static LatencyMeta *latencyMeta = NULL;
+
+PG_FUNCTION_INFO_V1(orioledb_latency_stats);
+PG_FUNCTION_INFO_V1(orioledb_latency_histogram);
+PG_FUNCTION_INFO_V1(orioledb_latency_stats_reset);
+
+Size
+latency_shmem_needs(void)
+{
+	return add_size(offsetof(LatencyMeta, procs),
+					mul_size(sizeof(ProcLatencyHistograms), max_procs));
+}
+
+static void
+latency_clear_proc(ProcLatencyHistograms *proc, bool init)
+{
+	int			i,
+				j;
+
+	for (i = 0; i < OLatencyEventsCount; i++)
+	{
+		LatencyHistogram *hist = &proc->hists[i];
+
+		for (j = 0; j < LATENCY_HIST_BUCKETS; j++)
+		{
+			if (init)
+				pg_atomic_init_u64(&hist->counts[j], 0);
+			else
+				pg_atomic_write_u64(&hist->counts[j], 0);
+		}
+		if (init)
+		{
+			pg_atomic_init_u64(&hist->sum, 0);
+			pg_atomic_init_u64(&hist->max, 0);
+		}
+		else
+		{
+			pg_atomic_write_u64(&hist->sum, 0);
+			pg_atomic_write_u64(&hist->max, 0);
+		}
+	}
+}
+
+void
+latency_shmem_init(Pointer ptr, bool found)
+{
+	int			i;
+
+	latencyMeta = (LatencyMeta *) ptr;
+
+	if (!found)
+	{
+		pg_atomic_init_u32(&latencyMeta->generation, 0);
+		for (i = 0; i < max_procs; i++)
+		{
+			pg_atomic_init_u32(&latencyMeta->procs[i].generation, 0);
+			latency_clear_proc(&latencyMeta->procs[i], true);
+		}
+	}
+}
+
+static int
+latency_bucket(uint64 ns)
+{
+	int			shift;
+
+	if (ns < LATENCY_HIST_SUB_BUCKETS)
+		return (int) ns;
+	if (ns >= UINT64CONST(1) << LATENCY_HIST_MAX_BITS)
+		return LATENCY_HIST_BUCKETS - 1;
+	shift = pg_leftmost_one_pos64(ns) - LATENCY_HIST_SUB_BITS;
+	return ((shift + 1) << LATENCY_HIST_SUB_BITS) +
+		(int) ((ns >> shift) & (LATENCY_HIST_SUB_BUCKETS - 1));
+}
+
+/*
+ * Returns the lowest latency falling into the histogram bucket.
+ */
+static uint64
+latency_bucket_low(int bucket)
+{
+	int			shift;
+
+	if (bucket < LATENCY_HIST_SUB_BUCKETS)
+		return (uint64) bucket;
+	shift = (bucket >> LATENCY_HIST_SUB_BITS) - 1;
+	return (uint64) (LATENCY_HIST_SUB_BUCKETS +
+					 (bucket & (LATENCY_HIST_SUB_BUCKETS - 1))) << shift;
+}
+
+/*
+ * Increments the counter, which is written only by the current process.
+ */
+static inline void
+latency_add(pg_atomic_uint64 *counter, uint64 value)
+{
+	pg_atomic_write_u64(counter, pg_atomic_read_u64(counter) + value);
+}
+
+/*
+ * Accounts the operation started at 'start' by latency_start().
+ */
+void
+latency_record(OLatencyEvent event, instr_time *start)
+{
+	ProcLatencyHistograms *proc;
+	LatencyHistogram *hist;
+	instr_time	duration;
+	uint32		generation;
+	uint64		ns;
+
+	if (INSTR_TIME_IS_ZERO(*start) || !latencyMeta || !MyProc)
+		return;
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, *start);
+	ns = INSTR_TIME_GET_NANOSEC(duration);
+
+	proc = &latencyMeta->procs[MYPROCNUMBER];
+	generation = pg_atomic_read_u32(&latencyMeta->generation);
+	if (pg_atomic_read_u32(&proc->generation) != generation)
+	{
+		latency_clear_proc(proc, false);
+		pg_write_barrier();
+		pg_atomic_write_u32(&proc->generation, generation);
+	}
+
+	hist = &proc->hists[event];
+	latency_add(&hist->counts[latency_bucket(ns)], 1);
+	latency_add(&hist->sum, ns);
+	if (ns > pg_atomic_read_u64(&hist->max))
+		pg_atomic_write_u64(&hist->max, ns);
+}
+
+typedef struct
+{
+	uint64		counts[LATENCY_HIST_BUCKETS];
+	uint64		total;
+	uint64		sum;
+	uint64		max;
+} LatencyTotal;
+
+/*
+ * Sums up the histograms of the current generation for every event.
+ */
+static void
+latency_aggregate(LatencyTotal *totals)
+{
+	uint32		generation = pg_atomic_read_u32(&latencyMeta->generation);
+	int			i,
+				j,
+				k;
+
+	memset(totals, 0, sizeof(LatencyTotal) * OLatencyEventsCount);
+
+	for (i = 0; i < max_procs; i++)
+	{
+		ProcLatencyHistograms *proc = &latencyMeta->procs[i];
+
+		if (pg_atomic_read_u32(&proc->generation) != generation)
+			continue;
+		pg_read_barrier();
+
+		for (j = 0; j < OLatencyEventsCount; j++)
+		{
+			LatencyHistogram *hist = &proc->hists[j];
+			LatencyTotal *total = &totals[j];
+
+			for (k = 0; k < LATENCY_HIST_BUCKETS; k++)
+			{
+				uint64		count = pg_atomic_read_u64(&hist->counts[k]);
+
+				total->counts[k] += count;
+				total->total += count;
+			}
+			total->sum += pg_atomic_read_u64(&hist->sum);
+			total->max = Max(total->max, pg_atomic_read_u64(&hist->max));
+		}
+	}
+}
+
+/*
+ * Returns the latency in microseconds below which 'fraction' of operations
+ * fit, using the upper bound of the histogram bucket.
+ */
+static double
+latency_percentile(LatencyTotal *total, double fraction)
+{
+	uint64		threshold = (uint64) ceil(total->total * fraction);
+	uint64		count = 0;
+	int			i;
+
+	for (i = 0; i < LATENCY_HIST_BUCKETS; i++)
+	{
+		count += total->counts[i];
+		if (count >= threshold && count > 0)
+		{
+			uint64		high = i + 1 < LATENCY_HIST_BUCKETS ?
+				latency_bucket_low(i + 1) : total->max;
+
+			return Min(high, total->max) / 1000.0;
+		}
+	}
+	return 0.0;
+}
+
+static void
+latency_init_srf(FunctionCallInfo fcinfo)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * Returns the number of operations, mean, percentiles and maximum latency in
+ * microseconds for every event.
+ */
+Datum
+orioledb_latency_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	LatencyTotal *totals;
+	Datum		values[8];
+	bool		nulls[8];
+	int			i;
+
+	orioledb_check_shmem();
+	latency_init_srf(fcinfo);
+
+	totals = (LatencyTotal *) palloc(sizeof(LatencyTotal) * OLatencyEventsCount);
+	latency_aggregate(totals);
+
+	for (i = 0; i < OLatencyEventsCount; i++)
+	{
+		LatencyTotal *total = &totals[i];
+
+		MemSet(nulls, 0, sizeof(nulls));
+		values[0] = CStringGetTextDatum(latencyEventNames[i]);
+		values[1] = Int64GetDatum(total->total);
+		if (total->total > 0)
+		{
+			values[2] = Float8GetDatum((double) total->sum / total->total / 1000.0);
+			values[3] = Float8GetDatum(latency_percentile(total, 0.5));
+			values[4] = Float8GetDatum(latency_percentile(total, 0.9));
+			values[5] = Float8GetDatum(latency_percentile(total, 0.99));
+			values[6] = Float8GetDatum(latency_percentile(total, 0.999));
+			values[7] = Float8GetDatum(total->max / 1000.0);
+		}
+		else
+		{
+			memset(&nulls[2], true, sizeof(bool) * 6);
+		}
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+	pfree(totals);
+
+	return (Datum) 0;
+}
+
+/*
+ * Returns non-empty histogram buckets for every event.  Bounds are in
+ * microseconds.
+ */
+Datum
+orioledb_latency_histogram(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	LatencyTotal *totals;
+	Datum		values[4];
+	bool		nulls[4];
+	int			i,
+				j;
+
+	orioledb_check_shmem();
+	latency_init_srf(fcinfo);
+
+	totals = (LatencyTotal *) palloc(sizeof(LatencyTotal) * OLatencyEventsCount);
+	latency_aggregate(totals);
+
+	MemSet(nulls, 0, sizeof(nulls));
+	for (i = 0; i < OLatencyEventsCount; i++)
+	{
+		for (j = 0; j < LATENCY_HIST_BUCKETS; j++)
+		{
+			if (totals[i].counts[j] == 0)
+				continue;
+
+			values[0] = CStringGetTextDatum(latencyEventNames[i]);
+			values[1] = Float8GetDatum(latency_bucket_low(j) / 1000.0);
+			if (j + 1 < LATENCY_HIST_BUCKETS)
+			{
+				values[2] = Float8GetDatum(latency_bucket_low(j + 1) / 1000.0);
+				nulls[2] = false;
+			}
+			else
+			{
+				nulls[2] = true;
+			}
+			values[3] = Int64GetDatum(totals[i].counts[j]);
+			tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+		}
+	}
+	pfree(totals);
+
+	return (Datum) 0;
+}
+
+Datum
+orioledb_latency_stats_reset(PG_FUNCTION_ARGS)
+{
+	orioledb_check_shmem();
+
+	pg_atomic_fetch_add_u32(&latencyMeta->generation, 1);
+
+	PG_RETURN_VOID();
+}
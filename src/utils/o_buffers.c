@@ -6,7 +6,28 @@
  * Copyright (c) 2021-2025, Oriole DB Inc.
  *
  * IDENTIFICATION
- *	  contrib/orioledb/src/catalog/o_indices.c
+ *	  contrib/orioledb/src/utils/o_buffers.c
+ *
+ * NOTES
+ *
+ *		Buffers are read without any locks when possible.  Every change of
+ *		the buffer data or block number is surrounded by increments of the
+ *		buffer change count under the exclusive buffer lock.  So, the count
+ *		is odd while the change is in progress.  The reader copies the data
+ *		between two reads of an even count and retries with locks if the
+ *		count changed.  This way concurrent readers of the resident undo and
+ *		xid map blocks don't bounce the lock cache lines.
+ *
+ *		When a process reads consecutive blocks from the files, it hints the
+ *		kernel to read ahead the next O_BUFFERS_READ_AHEAD blocks.
+ *
+ *		When the descriptor has a valid compression level, blocks are
+ *		compressed on eviction.  The compressed block is written at the same
+ *		place within the file prefixed by OBuffersCompressedHeader, the rest
+ *		of the block slot is left unwritten.  Thus, random access by offset
+ *		is kept, while the files become sparse.  Blocks which don't compress
+ *		are written as is.  Reader recognizes compressed blocks by the
+ *		header, so blocks written with different settings are all readable.
  *
  *-------------------------------------------------------------------------
  */
@@ -18,11 +39,23 @@
 
 #include "btree/btree.h"
 #include "btree/io.h"
+#include "utils/compress.h"
 #include "utils/o_buffers.h"
 
 #include "pgstat.h"
+#include "port/pg_crc32c.h"
 
 #define O_BUFFERS_PER_GROUP 4
+#define O_BUFFERS_READ_AHEAD 16
+
+#define O_BUFFERS_COMPRESSED_MAGIC UINT64CONST(0x4F42554643505231)
+
+typedef struct
+{
+	uint64		magic;
+	uint32		size;
+	pg_crc32c	crc;
+} OBuffersCompressedHeader;
 
 struct OBuffersMeta
 {
@@ -33,6 +66,7 @@ struct OBuffersMeta
 typedef struct
 {
 	LWLock		bufferCtlLock;
+	pg_atomic_uint32 changeCount;
 	int64		blockNum;
 	int64		shadowBlockNum;
 	uint32		usageCount;
@@ -66,6 +100,8 @@ o_buffers_shmem_init(OBuffersDesc *desc, void *buf, bool found)
 	desc->groups = (OBuffersGroup *) ptr;
 	desc->groupsCount = (desc->buffersCount + O_BUFFERS_PER_GROUP - 1) / O_BUFFERS_PER_GROUP;
 	desc->curFile = -1;
+	desc->lastReadBlockNum = -1;
+	desc->readAheadBlockNum = -1;
 
 	Assert((desc->singleFileSize % ORIOLEDB_BLCKSZ) == 0);
 
@@ -89,6 +125,7 @@ o_buffers_shmem_init(OBuffersDesc *desc, void *buf, bool found)
 
 				LWLockInitialize(&buffer->bufferCtlLock,
 								 desc->metaPageBlkno->bufferCtlTrancheId);
+				pg_atomic_init_u32(&buffer->changeCount, 0);
 				buffer->blockNum = -1;
 				buffer->usageCount = 0;
 				buffer->dirty = false;
@@ -135,16 +172,81 @@ unlink_file(OBuffersDesc *desc, uint64 fileNum)
 	(void) unlink(fileNameToUnlink);
 }
 
+static char compressedBlock[ORIOLEDB_BLCKSZ];
+
+/*
+ * Compresses the block into compressedBlock.  Returns the size of the
+ * compressed image including the header, or zero if the compressed image
+ * doesn't fit the half of the block.  Smaller savings are unlikely to free any
+ * file system block.
+ */
+static int
+compress_buffer_data(OBuffersDesc *desc, char *data)
+{
+	OBuffersCompressedHeader *header = (OBuffersCompressedHeader *) compressedBlock;
+	size_t		size;
+
+	size = o_compress_buffer(data, ORIOLEDB_BLCKSZ,
+							 compressedBlock + sizeof(OBuffersCompressedHeader),
+							 ORIOLEDB_BLCKSZ / 2 - sizeof(OBuffersCompressedHeader),
+							 *desc->compress);
+	if (size == 0)
+		return 0;
+
+	header->magic = O_BUFFERS_COMPRESSED_MAGIC;
+	header->size = size;
+	INIT_CRC32C(header->crc);
+	COMP_CRC32C(header->crc, compressedBlock + sizeof(OBuffersCompressedHeader),
+				size);
+	FIN_CRC32C(header->crc);
+
+	return sizeof(OBuffersCompressedHeader) + size;
+}
+
+/*
+ * Decompresses the block read from the file in place if it has the compressed
+ * image header.
+ */
+static void
+decompress_buffer_data(char *data)
+{
+	OBuffersCompressedHeader header;
+	pg_crc32c	crc;
+
+	memcpy(&header, data, sizeof(header));
+	if (header.magic != O_BUFFERS_COMPRESSED_MAGIC ||
+		header.size > ORIOLEDB_BLCKSZ - sizeof(OBuffersCompressedHeader))
+		return;
+
+	INIT_CRC32C(crc);
+	COMP_CRC32C(crc, data + sizeof(OBuffersCompressedHeader), header.size);
+	FIN_CRC32C(crc);
+	if (!EQ_CRC32C(crc, header.crc))
+		return;
+
+	memcpy(compressedBlock, data + sizeof(OBuffersCompressedHeader),
+		   header.size);
+	o_decompress_buffer(compressedBlock, header.size, data, ORIOLEDB_BLCKSZ);
+}
+
 static void
 write_buffer_data(OBuffersDesc *desc, char *data, uint64 blockNum)
 {
-	int			result;
+	int			result,
+				size = 0;
+
+	if (desc->compress && OCompressIsValid(*desc->compress))
+		size = compress_buffer_data(desc, data);
+	if (size > 0)
+		data = compressedBlock;
+	else
+		size = ORIOLEDB_BLCKSZ;
 
 	open_file(desc, blockNum / (desc->singleFileSize / ORIOLEDB_BLCKSZ));
-	result = OFileWrite(desc->curFile, data, ORIOLEDB_BLCKSZ,
+	result = OFileWrite(desc->curFile, data, size,
 						(blockNum * ORIOLEDB_BLCKSZ) % desc->singleFileSize,
 						WAIT_EVENT_SLRU_WRITE);
-	if (result != ORIOLEDB_BLCKSZ)
+	if (result != size)
 		ereport(PANIC, (errcode_for_file_access(),
 						errmsg("could not write buffer to file %s", desc->curFileName)));
 }
@@ -155,12 +257,48 @@ write_buffer(OBuffersDesc *desc, OBuffer *buffer)
 	write_buffer_data(desc, buffer->data, buffer->blockNum);
 }
 
+/*
+ * Hints the kernel to read ahead the blocks following 'blockNum' if the
+ * process reads the file sequentially.  The read-ahead doesn't cross the file
+ * boundary.
+ */
+static void
+read_ahead(OBuffersDesc *desc, int64 blockNum)
+{
+	int64		fileBlocks = desc->singleFileSize / ORIOLEDB_BLCKSZ,
+				lastBlockNum;
+
+	if (blockNum != desc->lastReadBlockNum + 1)
+	{
+		desc->lastReadBlockNum = blockNum;
+		return;
+	}
+	desc->lastReadBlockNum = blockNum;
+
+	/* The following blocks are already hinted */
+	if (blockNum + O_BUFFERS_READ_AHEAD / 2 < desc->readAheadBlockNum)
+		return;
+
+	blockNum = Max(blockNum + 1, desc->readAheadBlockNum);
+	lastBlockNum = Min(desc->lastReadBlockNum + O_BUFFERS_READ_AHEAD,
+					   (desc->lastReadBlockNum / fileBlocks + 1) * fileBlocks);
+	if (blockNum >= lastBlockNum)
+		return;
+
+	(void) FilePrefetch(desc->curFile,
+						(blockNum * ORIOLEDB_BLCKSZ) % desc->singleFileSize,
+						(lastBlockNum - blockNum) * ORIOLEDB_BLCKSZ,
+						WAIT_EVENT_SLRU_READ);
+	desc->readAheadBlockNum = lastBlockNum;
+}
+
 static void
 read_buffer(OBuffersDesc *desc, OBuffer *buffer)
 {
 	int			result;
 
 	open_file(desc, buffer->blockNum / (desc->singleFileSize / ORIOLEDB_BLCKSZ));
+	read_ahead(desc, buffer->blockNum);
 	result = OFileRead(desc->curFile, buffer->data, ORIOLEDB_BLCKSZ,
 					   (buffer->blockNum * ORIOLEDB_BLCKSZ) % desc->singleFileSize,
 					   WAIT_EVENT_SLRU_READ);
@@ -172,6 +310,9 @@ read_buffer(OBuffersDesc *desc, OBuffer *buffer)
 
 	if (result < ORIOLEDB_BLCKSZ)
 		memset(&buffer->data[result], 0, ORIOLEDB_BLCKSZ - result);
+
+	if (desc->compress)
+		decompress_buffer_data(buffer->data);
 }
 
 static OBuffer *
@@ -238,6 +379,7 @@ get_buffer(OBuffersDesc *desc, int64 blockNum, bool write)
 	}
 	buffer = &group->buffers[victim];
 	LWLockAcquire(&buffer->bufferCtlLock, LW_EXCLUSIVE);
+	pg_atomic_fetch_add_u32(&buffer->changeCount, 1);
 
 	prevDirty = buffer->dirty;
 	prevBlockNum = buffer->blockNum;
@@ -255,10 +397,50 @@ get_buffer(OBuffersDesc *desc, int64 blockNum, bool write)
 	read_buffer(desc, buffer);
 
 	buffer->shadowBlockNum = -1;
+	pg_atomic_fetch_add_u32(&buffer->changeCount, 1);
 
 	return buffer;
 }
 
+/*
+ * Tries to copy the part of the resident block without taking locks.
+ * Returns false if the block isn't resident or is being changed.
+ */
+static bool
+read_buffer_optimistic(OBuffersDesc *desc, Pointer ptr, int64 blockNum,
+					   uint32 copyOffset, uint32 copySize)
+{
+	OBuffersGroup *group = &desc->groups[blockNum % desc->groupsCount];
+	int			i;
+
+	for (i = 0; i < O_BUFFERS_PER_GROUP; i++)
+	{
+		OBuffer    *buffer = &group->buffers[i];
+		uint32		changeCount;
+
+		if (buffer->blockNum != blockNum)
+			continue;
+
+		changeCount = pg_atomic_read_u32(&buffer->changeCount);
+		if (changeCount & 1)
+			return false;
+		pg_read_barrier();
+
+		if (buffer->blockNum != blockNum)
+			return false;
+		memcpy(ptr, &buffer->data[copyOffset], copySize);
+
+		pg_read_barrier();
+		if (pg_atomic_read_u32(&buffer->changeCount) != changeCount)
+			return false;
+
+		/* Usage count is just a hint, lost increments are OK */
+		buffer->usageCount++;
+		return true;
+	}
+	return false;
+}
+
 static void
 o_buffers_rw(OBuffersDesc *desc, Pointer buf,
 			 int64 offset, int64 size,
@@ -271,7 +453,7 @@ o_buffers_rw(OBuffersDesc *desc, Pointer buf,
 
 	for (blockNum = firstBlockNum; blockNum <= lastBlockNum; blockNum++)
 	{
-		OBuffer    *buffer = get_buffer(desc, blockNum, write);
+		OBuffer    *buffer;
 		uint32		copySize,
 					copyOffset;
 
@@ -296,10 +478,20 @@ o_buffers_rw(OBuffersDesc *desc, Pointer buf,
 			copyOffset = 0;
 		}
 
+		if (!write &&
+			read_buffer_optimistic(desc, ptr, blockNum, copyOffset, copySize))
+		{
+			ptr += copySize;
+			continue;
+		}
+
+		buffer = get_buffer(desc, blockNum, write);
 		if (write)
 		{
+			pg_atomic_fetch_add_u32(&buffer->changeCount, 1);
 			memcpy(&buffer->data[copyOffset], ptr, copySize);
 			buffer->dirty = true;
+			pg_atomic_fetch_add_u32(&buffer->changeCount, 1);
 		}
 		else
 		{
@@ -374,8 +566,10 @@ o_buffers_wipe(OBuffersDesc *desc,
 				buffer->blockNum >= firstBufferNumber &&
 				buffer->blockNum <= lastBufferNumber)
 			{
+				pg_atomic_fetch_add_u32(&buffer->changeCount, 1);
 				buffer->blockNum = -1;
 				buffer->dirty = false;
+				pg_atomic_fetch_add_u32(&buffer->changeCount, 1);
 			}
 			LWLockRelease(&buffer->bufferCtlLock);
 		}
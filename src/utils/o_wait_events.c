@@ -0,0 +1,206 @@
+/*-------------------------------------------------------------------------
+ *
+ * o_wait_events.c
+ *		OrioleDB wait events and their statistics.
+ *
+ * Copyright (c) 2025-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/utils/o_wait_events.c
+ *
+ * NOTES
+ *
+ *		Each blocking point of OrioleDB gets its own wait event of the
+ *		Extension type, so it's distinguishable in pg_stat_activity.  The wait
+ *		event identifiers are allocated by WaitEventExtensionNew() lazily on
+ *		the first use in the backend.  PostgreSQL 16 has no custom wait
+ *		events, so all the blocking points are reported as generic Extension
+ *		wait event there.
+ *
+ *		Besides, the number of the sleeps and the cumulative sleep time are
+ *		accounted for each wait event.  Only the actual sleeps are accounted,
+ *		so the timing overhead is negligible.  Some waits are done within
+ *		PostgreSQL lock manager, which reports its own wait events (for
+ *		instance, the IO completion waits show up as "orioledb_btree_io"
+ *		LWLock).  These are only accounted here.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "utils/o_wait_events.h"
+
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "utils/builtins.h"
+#include "utils/tuplestore.h"
+#include "utils/wait_event.h"
+
+typedef struct
+{
+	pg_atomic_uint64 waits;
+	pg_atomic_uint64 waitTime;	/* in microseconds */
+} OWaitEventStats;
+
+static const char *const waitEventNames[OWaitEventsCount] = {
+	"OrioleDBPageLock",
+	"OrioleDBPageReadEnable",
+	"OrioleDBPageChangeCount",
+	"OrioleDBIOCompletion",
+	"OrioleDBOxid",
+	"OrioleDBS3Queue",
+	"OrioleDBUndoReserve"
+};
+
+static OWaitEventStats *waitEventStats = NULL;
+static uint32 waitEventInfos[OWaitEventsCount] = {0};
+
+PG_FUNCTION_INFO_V1(orioledb_wait_stats);
+PG_FUNCTION_INFO_V1(orioledb_wait_stats_reset);
+
+Size
+o_wait_events_shmem_needs(void)
+{
+	return mul_size(sizeof(OWaitEventStats), OWaitEventsCount);
+}
+
+void
+o_wait_events_shmem_init(Pointer ptr, bool found)
+{
+	int			i;
+
+	waitEventStats = (OWaitEventStats *) ptr;
+
+	if (!found)
+	{
+		for (i = 0; i < OWaitEventsCount; i++)
+		{
+			pg_atomic_init_u64(&waitEventStats[i].waits, 0);
+			pg_atomic_init_u64(&waitEventStats[i].waitTime, 0);
+		}
+	}
+}
+
+/*
+ * Returns wait_event_info to report for the given blocking point.  The first
+ * call in the backend might take a lock, so it shouldn't be done after the
+ * process is queued as a waiter.
+ */
+uint32
+o_wait_event_info(OWaitEvent event)
+{
+	Assert(event >= 0 && event < OWaitEventsCount);
+
+	if (waitEventInfos[event] == 0)
+	{
+#if PG_VERSION_NUM >= 170000
+		waitEventInfos[event] = WaitEventExtensionNew(waitEventNames[event]);
+#else
+		waitEventInfos[event] = PG_WAIT_EXTENSION;
+#endif
+	}
+	return waitEventInfos[event];
+}
+
+/*
+ * Reports the start of the sleep and remembers its start time.
+ */
+void
+o_wait_event_start(OWaitEvent event, instr_time *start)
+{
+	uint32		info = o_wait_event_info(event);
+
+	INSTR_TIME_SET_CURRENT(*start);
+	pgstat_report_wait_start(info);
+}
+
+/*
+ * Reports the end of the sleep started by o_wait_event_start() and accounts
+ * it.
+ */
+void
+o_wait_event_end(OWaitEvent event, instr_time *start)
+{
+	pgstat_report_wait_end();
+	o_wait_event_account(event, start);
+}
+
+/*
+ * Accounts the sleep started at 'start' for the given blocking point.
+ */
+void
+o_wait_event_account(OWaitEvent event, instr_time *start)
+{
+	instr_time	duration;
+
+	if (!waitEventStats)
+		return;
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, *start);
+	pg_atomic_fetch_add_u64(&waitEventStats[event].waits, 1);
+	pg_atomic_fetch_add_u64(&waitEventStats[event].waitTime,
+							INSTR_TIME_GET_MICROSEC(duration));
+}
+
+/*
+ * Returns the number of sleeps and the cumulative sleep time for every
+ * OrioleDB wait event.
+ */
+Datum
+orioledb_wait_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Datum		values[3];
+	bool		nulls[3];
+	int			i;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+
+	orioledb_check_shmem();
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	MemSet(nulls, 0, sizeof(nulls));
+	for (i = 0; i < OWaitEventsCount; i++)
+	{
+		values[0] = CStringGetTextDatum(waitEventNames[i]);
+		values[1] = Int64GetDatum(pg_atomic_read_u64(&waitEventStats[i].waits));
+		values[2] = Float8GetDatum((double) pg_atomic_read_u64(&waitEventStats[i].waitTime) / 1000.0);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+Datum
+orioledb_wait_stats_reset(PG_FUNCTION_ARGS)
+{
+	int			i;
+
+	orioledb_check_shmem();
+
+	for (i = 0; i < OWaitEventsCount; i++)
+	{
+		pg_atomic_write_u64(&waitEventStats[i].waits, 0);
+		pg_atomic_write_u64(&waitEventStats[i].waitTime, 0);
+	}
+
+	PG_RETURN_VOID();
+}
@@ -16,11 +16,13 @@
 
 #include "btree/io.h"
 #include "btree/page_contents.h"
+#include "btree/residency.h"
 #include "btree/undo.h"
 #include "checkpoint/checkpoint.h"
 #include "transam/undo.h"
 #include "utils/page_pool.h"
 #include "utils/ucm.h"
+#include "workers/bgwriter.h"
 
 #include "utils/memdebug.h"
 
@@ -41,6 +43,8 @@ ppool_estimate_space(OPagePool *pool, OInMemoryBlkno offset, OInMemoryBlkno size
 
 	result += CACHELINEALIGN(sizeof(pg_atomic_uint64));
 	result += CACHELINEALIGN(sizeof(pg_atomic_uint32));
+	result += CACHELINEALIGN(sizeof(pg_atomic_uint64));
+	result += CACHELINEALIGN(sizeof(OPagePoolStats));
 
 	pool->ucmShmemSize = estimate_ucm_space(&pool->ucm, offset, size);
 
@@ -61,10 +65,29 @@ ppool_shmem_init(OPagePool *pool, Pointer ptr, bool found)
 	pool->dirtyPagesCount = (pg_atomic_uint32 *) ptr;
 	ptr += CACHELINEALIGN(sizeof(pg_atomic_uint32));
 
+	pool->withheldPagesCount = (pg_atomic_uint64 *) ptr;
+	ptr += CACHELINEALIGN(sizeof(pg_atomic_uint64));
+
+	pool->stats = (OPagePoolStats *) ptr;
+	ptr += CACHELINEALIGN(sizeof(OPagePoolStats));
+
 	if (!found)
 	{
 		pg_atomic_init_u64(pool->availablePagesCount, pool->size);
 		pg_atomic_init_u32(pool->dirtyPagesCount, 0);
+		pg_atomic_init_u64(pool->withheldPagesCount, 0);
+
+		pg_atomic_init_u64(&pool->stats->gets, 0);
+		pg_atomic_init_u64(&pool->stats->misses, 0);
+		pg_atomic_init_u64(&pool->stats->clockRuns, 0);
+		pg_atomic_init_u64(&pool->stats->clockIterations, 0);
+		pg_atomic_init_u64(&pool->stats->backendEvictions, 0);
+		pg_atomic_init_u64(&pool->stats->backendWrites, 0);
+		pg_atomic_init_u64(&pool->stats->bgwriterEvictions, 0);
+		pg_atomic_init_u64(&pool->stats->bgwriterWrites, 0);
+		pg_atomic_init_u64(&pool->stats->queuedEvictions, 0);
+		pg_atomic_init_u64(&pool->stats->queuedEvicted, 0);
+		pg_atomic_init_u64(&pool->stats->merges, 0);
 	}
 
 	init_ucm(&pool->ucm, ptr, found);
@@ -99,10 +122,13 @@ ppool_reserve_pages(OPagePool *pool, int kind, int count)
 	if (count <= 0)
 		return;
 
+	pg_atomic_fetch_add_u64(&pool->stats->gets, count);
 	val = pg_atomic_sub_fetch_u64(pool->availablePagesCount, count);
+	if (val & (UINT64CONST(1) << 63))
+		pg_atomic_fetch_add_u64(&pool->stats->misses, 1);
 	while (val & (UINT64CONST(1) << 63))
 	{
-		ppool_run_clock(pool, true, NULL);
+		ppool_run_clock(pool, true, NULL, NULL);
 		val = pg_atomic_read_u64(pool->availablePagesCount);
 	}
 
@@ -204,8 +230,12 @@ ppool_free_page(OPagePool *pool, OInMemoryBlkno blkno, bool haveLock)
 	page_desc->oids.relnode = InvalidOid;
 	page_desc->oids.reloid = InvalidOid;
 	page_desc->type = 0;
+	page_desc->nReads = 0;
+	page_desc->nWrites = 0;
 	page_desc->fileExtent.off = InvalidFileExtentOff;
 	page_desc->fileExtent.len = InvalidFileExtentLen;
+	page_desc->parentBlkno = OInvalidInMemoryBlkno;
+	pg_atomic_write_u32(&page_desc->subtreeDirty, 1);
 	unlock_page(blkno);
 
 	page_change_usage_count(&pool->ucm, blkno, UCM_FREE_PAGES_LEVEL);
@@ -236,21 +266,128 @@ ppool_dirty_pages_count(OPagePool *pool)
 	return pg_atomic_read_u32(pool->dirtyPagesCount);
 }
 
+/*
+ * Limits the number of pages used in the pool without the restart.  The pages
+ * above the limit are withheld from the count of available pages.  Raising
+ * the limit makes pages available immediately.  Lowering the limit withholds
+ * at most half of the currently free pages at once, so that backends don't
+ * have to evict the whole difference while reserving pages.  The caller is
+ * expected to repeat the call while evicting pages until the pool fits the
+ * limit.  Should be called by a single process: the first background writer.
+ */
+void
+ppool_set_pages_limit(OPagePool *pool, OInMemoryBlkno limit)
+{
+	uint64		withheld,
+				prevWithheld;
+
+	limit = Max(limit, PPOOL_MIN_SIZE);
+	withheld = limit < pool->size ? pool->size - limit : 0;
+	prevWithheld = pg_atomic_read_u64(pool->withheldPagesCount);
+
+	if (withheld > prevWithheld)
+		withheld = prevWithheld + Min(withheld - prevWithheld,
+									  ppool_free_pages_count(pool) / 2);
+
+	if (withheld == prevWithheld)
+		return;
+
+	pg_atomic_write_u64(pool->withheldPagesCount, withheld);
+	if (withheld > prevWithheld)
+		pg_atomic_fetch_sub_u64(pool->availablePagesCount, withheld - prevWithheld);
+	else
+		pg_atomic_fetch_add_u64(pool->availablePagesCount, prevWithheld - withheld);
+}
+
+/*
+ * Writes and evicts the given page.  Used by the background writers for the
+ * pages queued by bgwriter_queue_eviction().
+ */
+void
+ppool_evict_page(OPagePool *pool, OInMemoryBlkno blkno)
+{
+	OWalkPageResult result;
+
+	Assert(!have_locked_pages());
+	Assert(!have_retained_undo_location());
+	Assert(blkno >= pool->offset && blkno < pool->offset + pool->size);
+
+	/* We might need to merge pages */
+	reserve_undo_size(UndoLogRegular, 2 * O_MERGE_UNDO_IMAGE_SIZE);
+	reserve_undo_size(UndoLogSystem, 2 * O_MERGE_UNDO_IMAGE_SIZE);
+	set_skip_ucm();
+
+	result = walk_page(blkno, true);
+	Assert(!have_locked_pages());
+
+	if (result == OWalkPageEvicted)
+		pg_atomic_fetch_add_u64(&pool->stats->queuedEvicted, 1);
+	else if (result == OWalkPageMerged)
+		pg_atomic_fetch_add_u64(&pool->stats->merges, 1);
+
+	unset_skip_ucm();
+	release_undo_size(UndoLogRegular);
+	release_undo_size(UndoLogSystem);
+	free_retained_undo_location(UndoLogRegular);
+	free_retained_undo_location(UndoLogSystem);
+}
+
+/*
+ * Maximal number of dirty pages put into the background writer eviction
+ * queue by one clock run.  Then the dirty page is written by the caller.
+ */
+#define PPOOL_MAX_QUEUED_EVICTIONS	8
+
+/*
+ * Checks if the dirty page might be queued for the eviction by the
+ * background writer.  Non-leaf pages with in-memory children can't be
+ * evicted anyway.
+ */
+static bool
+ppool_page_can_be_queued(OInMemoryBlkno blkno)
+{
+	OrioleDBPageDesc *page_desc = O_GET_IN_MEMORY_PAGEDESC(blkno);
+	Page		p = O_GET_IN_MEMORY_PAGE(blkno);
+
+	if (!IS_DIRTY(blkno) || !ORelOidsIsValid(page_desc->oids) ||
+		page_desc->type == oIndexInvalid)
+		return false;
+
+	return O_PAGE_IS(p, LEAF) ||
+		PAGE_GET_N_ONDISK(p) == BTREE_PAGE_ITEMS_COUNT(p);
+}
+
 /*
  * Run clock replacement algorithm until we evict at least one page.
+ *
+ * Foreground backends evicting pages prefer clean pages: dirty pages are
+ * queued for the background writer while the queue has space.
+ *
+ * The clock starts from '*clockHand' if given, which is advanced past the
+ * page found.  Background writers keep their own hands within the parts of
+ * the pool assigned to them.  Otherwise, the clock starts from the random
+ * position.
  */
 void
 ppool_run_clock(OPagePool *pool, bool evict,
-				volatile sig_atomic_t *shutdown_requested)
+				volatile sig_atomic_t *shutdown_requested,
+				OInMemoryBlkno *clockHand)
 {
 	uint64		blkno;
 	Size		undoRegularSize = get_reserved_undo_size(UndoLogRegular);
 	Size		undoSystemSize = get_reserved_undo_size(UndoLogSystem);
 	bool		haveRetainLoc = have_retained_undo_location();
+	int			numQueued = 0;
+	uint64		numIterations = 0,
+				numPinnedSkipped = 0;
+	OWalkPageResult result = OWalkPageSkipped;
 
-	blkno = pg_prng_uint64_range(&pool->prngSeed,
-								 pool->offset,
-								 pool->offset + pool->size - 1);
+	if (clockHand)
+		blkno = *clockHand;
+	else
+		blkno = pg_prng_uint64_range(&pool->prngSeed,
+									 pool->offset,
+									 pool->offset + pool->size - 1);
 
 	/*
 	 * Shouldn't be called while holding a page lock: one should reserve the
@@ -272,11 +409,25 @@ ppool_run_clock(OPagePool *pool, bool evict,
 			break;
 
 		blkno = ucm_next_blkno(&pool->ucm, blkno, 1);
+		numIterations++;
 
 		Assert(blkno >= pool->offset && blkno < pool->offset + pool->size);
-		if (walk_page(blkno, evict) != OWalkPageSkipped)
+		if (evict && numPinnedSkipped < pool->size / 4 &&
+			o_page_is_pinned(blkno))
+		{
+			/* Pinned trees are evicted only if nothing else is found */
+			numPinnedSkipped++;
+		}
+		else if (evict && numQueued < PPOOL_MAX_QUEUED_EVICTIONS &&
+			ppool_page_can_be_queued(blkno) &&
+			bgwriter_queue_eviction(blkno))
+		{
+			numQueued++;
+		}
+		else if ((result = walk_page(blkno, evict)) != OWalkPageSkipped)
 		{
 			Assert(!have_locked_pages());
+			blkno++;
 			break;
 		}
 		Assert(!have_locked_pages());
@@ -285,8 +436,24 @@ ppool_run_clock(OPagePool *pool, bool evict,
 			blkno = pool->offset;
 	}
 
+	if (clockHand)
+		*clockHand = blkno < pool->offset + pool->size ? blkno : pool->offset;
+
 	unset_skip_ucm();
 
+	pg_atomic_fetch_add_u64(&pool->stats->clockRuns, 1);
+	pg_atomic_fetch_add_u64(&pool->stats->clockIterations, numIterations);
+	if (numQueued > 0)
+		pg_atomic_fetch_add_u64(&pool->stats->queuedEvictions, numQueued);
+	if (result == OWalkPageEvicted)
+		pg_atomic_fetch_add_u64(IsBGWriter ? &pool->stats->bgwriterEvictions :
+								&pool->stats->backendEvictions, 1);
+	else if (result == OWalkPageWritten)
+		pg_atomic_fetch_add_u64(IsBGWriter ? &pool->stats->bgwriterWrites :
+								&pool->stats->backendWrites, 1);
+	else if (result == OWalkPageMerged)
+		pg_atomic_fetch_add_u64(&pool->stats->merges, 1);
+
 	/*
 	 * The caller might have the undo location reserved.  We need to carefully
 	 * put the undo location back.
@@ -54,6 +54,12 @@
 #define SEQBUF_FILE_OFFSET(shared, blkno) ((off_t) SEQBUF_CHUNK_SIZE * (blkno) \
 												+ (shared)->evictOffset)
 
+/*
+ * Number of the written pages after which the kernel is asked to start their
+ * writeback.
+ */
+#define SEQBUF_WRITEBACK_PAGES (32)
+
 /*
  * this functions returns true if success
  */
@@ -252,7 +258,9 @@ seq_buf_finish_prev_page(SeqBufDescPrivate *seqBufPrivate)
 
 	if (seqBufPrivate->write)
 	{
-		offset = SEQBUF_FILE_OFFSET(shared, (off_t) shared->filePageNum - 1);
+		uint32		pageNum = shared->filePageNum - 1;
+
+		offset = SEQBUF_FILE_OFFSET(shared, (off_t) pageNum);
 
 		/* Write previous page */
 		if (OFileWrite(seqBufPrivate->file,
@@ -266,6 +274,17 @@ seq_buf_finish_prev_page(SeqBufDescPrivate *seqBufPrivate)
 								   (uint32) offset)));
 			return false;
 		}
+
+		/*
+		 * The pages are written into the OS cache while the other page is
+		 * filled.  Start the writeback of the recent pages in background, so
+		 * that the file sync doesn't have to write out the whole file.
+		 */
+		if ((pageNum + 1) % SEQBUF_WRITEBACK_PAGES == 0)
+			FileWriteback(seqBufPrivate->file,
+						  SEQBUF_FILE_OFFSET(shared, (off_t) pageNum + 1 - SEQBUF_WRITEBACK_PAGES),
+						  (off_t) SEQBUF_CHUNK_SIZE * SEQBUF_WRITEBACK_PAGES,
+						  WAIT_EVENT_SLRU_FLUSH_SYNC);
 	}
 	else
 	{
@@ -21,6 +21,7 @@
 #define UCM_LEVEL_MASK		0xF
 
 static bool skip_ucm = false;
+static bool cold_ucm = false;
 
 static int	init_ucm_non_leaf_recursive(UsageCountMap *map, int i);
 static void ucm_inc_recursive(UsageCountMap *map, int i, int prev, int next);
@@ -223,7 +224,7 @@ page_inc_usage_count(UsageCountMap *map, OInMemoryBlkno blkno,
 
 	if (usageCount == InvalidUsageCount ||
 		usageCount == UCM_FREE_PAGES_LEVEL ||
-		(!no_skip && skip_ucm))
+		(!no_skip && (skip_ucm || cold_ucm)))
 		return;
 
 	Assert(usageCount < UCM_USAGE_LEVELS);
@@ -256,6 +257,40 @@ page_change_usage_count(UsageCountMap *map, OInMemoryBlkno blkno, uint32 usageCo
 	ucm_inc(map, blkno - map->offset, prev_usagecount, usageCount);
 }
 
+/*
+ * Returns the usage count for the page just loaded to the pool.  Pages loaded
+ * by the scan-resistant scans get the coldest usage count, so they are the
+ * first candidates for eviction.
+ */
+uint32
+ucm_new_page_usage_count(UsageCountMap *map)
+{
+	uint32		epoch = pg_atomic_read_u32(map->epoch);
+
+	if (cold_ucm)
+		return epoch;
+	return (epoch + 2) % UCM_USAGE_LEVELS;
+}
+
+/*
+ * Returns the hotness of the page: the distance of its usage count from the
+ * current epoch.  Zero means the coldest pages, which are the next candidates
+ * for eviction, UCM_USAGE_LEVELS - 1 means the hottest pages.
+ */
+uint32
+page_get_hotness(UsageCountMap *map, OInMemoryBlkno blkno)
+{
+	uint32		epoch = pg_atomic_read_u32(map->epoch);
+	uint32		usageCount;
+	Page		p = O_GET_IN_MEMORY_PAGE(blkno);
+
+	usageCount = pg_atomic_read_u32(&(O_PAGE_HEADER(p)->usageCount));
+	if (usageCount >= UCM_USAGE_LEVELS)
+		return 0;
+
+	return (UCM_USAGE_LEVELS + usageCount - epoch) % UCM_USAGE_LEVELS;
+}
+
 static bool
 page_try_change_usage_count(UsageCountMap *map, OInMemoryBlkno blkno,
 							uint32 old_usagecount, uint32 new_usagecount)
@@ -578,3 +613,20 @@ unset_skip_ucm(void)
 {
 	skip_ucm = false;
 }
+
+/*
+ * Makes the pages accessed by this backend not getting hotter, and the pages
+ * loaded getting the coldest usage count.  Used by the large scans to not
+ * evict the hot pages.
+ */
+void
+set_cold_ucm(void)
+{
+	cold_ucm = true;
+}
+
+void
+unset_cold_ucm(void)
+{
+	cold_ucm = false;
+}
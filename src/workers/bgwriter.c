@@ -8,12 +8,34 @@
  * IDENTIFICATION
  *	  contrib/orioledb/src/workers/bgwriter.c
  *
+ * NOTES
+ *
+ *		Writing a dirty page implies its compression and IO.  Foreground
+ *		backends running the clock for page eviction don't do that
+ *		themselves.  Instead, they put the dirty pages picked for eviction
+ *		into the shared eviction queue and continue looking for a clean page.
+ *		Background writers write and evict the queued pages.  Once the queue
+ *		is full, backends write dirty pages themselves as before.
+ *
+ *		Each pool is split into equal parts between the background writers.
+ *		Each writer runs the clock with its own hand within its part, so
+ *		writers don't contend on the same pages and UCM words.  The part
+ *		boundary is soft: the clock might find the page behind it, then the
+ *		hand returns to the beginning of the part.  Only the first writer
+ *		shifts the UCM epoch.
+ *
+ *		The first writer also applies orioledb.main_buffers_limit reloaded
+ *		from the configuration: the main pool is gradually shrunk by
+ *		withholding free pages, while the regular eviction produces more free
+ *		pages (see ppool_set_pages_limit()).
+ *
  *-------------------------------------------------------------------------
  */
 #include "postgres.h"
 
 #include "orioledb.h"
 
+#include "btree/io.h"
 #include "btree/undo.h"
 #include "s3/headers.h"
 #include "transam/undo.h"
@@ -25,10 +47,13 @@
 #include "miscadmin.h"
 #include "postmaster/bgworker.h"
 #include "postmaster/bgwriter.h"
+#include "postmaster/interrupt.h"
 #include "storage/bufmgr.h"
 #include "storage/latch.h"
 #include "storage/proc.h"
 #include "storage/sinvaladt.h"
+#include "storage/spin.h"
+#include "utils/guc.h"
 #include "utils/memutils.h"
 #include "utils/snapmgr.h"
 #include "utils/syscache.h"
@@ -36,9 +61,165 @@
 
 #include "pgstat.h"
 
+typedef struct
+{
+	OInMemoryBlkno blkno;
+	uint32		changeCount;
+} BGWriterQueuedPage;
+
+typedef struct
+{
+	slock_t		lock;
+	/* positions of the next page to be taken and put */
+	uint64		head;
+	uint64		tail;
+	uint32		nextWorker;
+	uint32		numWorkers;
+	int			procnos[FLEXIBLE_ARRAY_MEMBER];
+} BGWriterShared;
+
 static volatile sig_atomic_t shutdown_requested = false;
 bool		IsBGWriter = false;
 
+/* Size of the eviction queue, zero disables queueing */
+int			bgwriter_eviction_queue_size = 1024;
+
+static BGWriterShared *bgwriterShared = NULL;
+static BGWriterQueuedPage *bgwriterQueue = NULL;
+
+/* Number of this background writer and its clock hands for each pool */
+static int	bgwriterNum = 0;
+static OInMemoryBlkno clockHands[OPagePoolTypesCount];
+
+Size
+bgwriter_shmem_needs(void)
+{
+	Size		size;
+
+	size = CACHELINEALIGN(add_size(offsetof(BGWriterShared, procnos),
+								   mul_size(sizeof(int), bgwriter_num_workers)));
+	size = add_size(size, mul_size(sizeof(BGWriterQueuedPage),
+								   bgwriter_eviction_queue_size));
+	return size;
+}
+
+void
+bgwriter_shmem_init(Pointer ptr, bool found)
+{
+	bgwriterShared = (BGWriterShared *) ptr;
+	ptr += CACHELINEALIGN(offsetof(BGWriterShared, procnos) +
+						  sizeof(int) * bgwriter_num_workers);
+	bgwriterQueue = (BGWriterQueuedPage *) ptr;
+
+	if (!found)
+	{
+		SpinLockInit(&bgwriterShared->lock);
+		bgwriterShared->head = 0;
+		bgwriterShared->tail = 0;
+		bgwriterShared->nextWorker = 0;
+		bgwriterShared->numWorkers = 0;
+	}
+}
+
+/*
+ * Puts the dirty page picked for eviction into the eviction queue and wakes
+ * up the background writer.  Returns false if the page should be written by
+ * the caller: the queue is full or disabled.
+ */
+bool
+bgwriter_queue_eviction(OInMemoryBlkno blkno)
+{
+	int			procno = -1;
+
+	if (bgwriter_eviction_queue_size == 0 || debug_disable_bgwriter ||
+		IsBGWriter)
+		return false;
+
+	SpinLockAcquire(&bgwriterShared->lock);
+	if (bgwriterShared->numWorkers == 0 ||
+		bgwriterShared->tail - bgwriterShared->head >= bgwriter_eviction_queue_size)
+	{
+		SpinLockRelease(&bgwriterShared->lock);
+		return false;
+	}
+	bgwriterQueue[bgwriterShared->tail % bgwriter_eviction_queue_size].blkno = blkno;
+	bgwriterQueue[bgwriterShared->tail % bgwriter_eviction_queue_size].changeCount =
+		O_PAGE_GET_CHANGE_COUNT(O_GET_IN_MEMORY_PAGE(blkno));
+	bgwriterShared->tail++;
+	procno = bgwriterShared->procnos[bgwriterShared->nextWorker++ %
+									 bgwriterShared->numWorkers];
+	SpinLockRelease(&bgwriterShared->lock);
+
+	SetLatch(&GetPGProcByNumber(procno)->procLatch);
+	return true;
+}
+
+/*
+ * Returns the clock hand of this background writer for the pool, keeping it
+ * within the part of the pool assigned to the writer.
+ */
+static OInMemoryBlkno *
+bgwriter_get_clock_hand(OPagePool *pool, OPagePoolType poolType)
+{
+	OInMemoryBlkno partStart,
+				partEnd;
+
+	partStart = pool->offset +
+		(uint64) pool->size * bgwriterNum / bgwriter_num_workers;
+	partEnd = pool->offset +
+		(uint64) pool->size * (bgwriterNum + 1) / bgwriter_num_workers;
+
+	if (clockHands[poolType] < partStart || clockHands[poolType] >= partEnd)
+		clockHands[poolType] = partStart;
+
+	return &clockHands[poolType];
+}
+
+/*
+ * Applies orioledb.main_buffers_limit to the main pool.
+ */
+static void
+bgwriter_apply_main_buffers_limit(OPagePool *pool)
+{
+	OInMemoryBlkno limit = pool->size;
+
+	if (main_buffers_limit_guc > 0)
+		limit = Min(limit, ((Size) main_buffers_limit_guc * (Size) BLCKSZ) / ORIOLEDB_BLCKSZ);
+
+	ppool_set_pages_limit(pool, limit);
+}
+
+/*
+ * Writes and evicts the queued pages.
+ */
+static void
+bgwriter_process_eviction_queue(void)
+{
+	while (!shutdown_requested)
+	{
+		BGWriterQueuedPage page;
+
+		SpinLockAcquire(&bgwriterShared->lock);
+		if (bgwriterShared->head == bgwriterShared->tail)
+		{
+			SpinLockRelease(&bgwriterShared->lock);
+			break;
+		}
+		page = bgwriterQueue[bgwriterShared->head % bgwriter_eviction_queue_size];
+		bgwriterShared->head++;
+		SpinLockRelease(&bgwriterShared->lock);
+
+		/* Skip the page already evicted and reused */
+		if (O_PAGE_GET_CHANGE_COUNT(O_GET_IN_MEMORY_PAGE(page.blkno)) != page.changeCount)
+			continue;
+
+		ppool_evict_page(get_ppool_by_blkno(page.blkno), page.blkno);
+	}
+
+	MemoryContextReset(CurTransactionContext);
+	MemoryContextReset(TopTransactionContext);
+}
+
 static void
 handle_sigterm(SIGNAL_ARGS)
 {
@@ -47,7 +228,7 @@ handle_sigterm(SIGNAL_ARGS)
 }
 
 void
-register_bgwriter(void)
+register_bgwriter(int num)
 {
 	BackgroundWorker worker;
 
@@ -60,6 +241,7 @@ register_bgwriter(void)
 	strcpy(worker.bgw_function_name, "bgwriter_main");
 	strcpy(worker.bgw_name, "orioledb background writer");
 	strcpy(worker.bgw_type, "orioledb background writer");
+	worker.bgw_main_arg = Int32GetDatum(num);
 	RegisterBackgroundWorker(&worker);
 }
 
@@ -89,10 +271,13 @@ bgwriter_main(Datum main_arg)
 
 	/* catch SIGTERM signal for reason to not interupt background writing */
 	pqsignal(SIGTERM, handle_sigterm);
+	pqsignal(SIGHUP, SignalHandlerForConfigReload);
 	BackgroundWorkerUnblockSignals();
 
-	elog(LOG, "orioledb background writer started");
+	bgwriterNum = DatumGetInt32(main_arg);
+	elog(LOG, "orioledb background writer %d started", bgwriterNum);
 	IsBGWriter = true;
+	set_io_class(OIOClassEvictionWrite);
 
 	if (debug_disable_bgwriter)
 	{
@@ -100,6 +285,12 @@ bgwriter_main(Datum main_arg)
 		return;
 	}
 
+	/* Make us visible to the backends queueing evictions */
+	SpinLockAcquire(&bgwriterShared->lock);
+	if (bgwriterShared->numWorkers < bgwriter_num_workers)
+		bgwriterShared->procnos[bgwriterShared->numWorkers++] = MYPROCNUMBER;
+	SpinLockRelease(&bgwriterShared->lock);
+
 	CurTransactionContext = AllocSetContextCreate(TopMemoryContext,
 												  "orioledb bgwriter current transaction context",
 												  ALLOCSET_DEFAULT_SIZES);
@@ -133,9 +324,21 @@ bgwriter_main(Datum main_arg)
 			if (rc & WL_POSTMASTER_DEATH)
 				shutdown_requested = true;
 
+			ResetLatch(MyLatch);
+
+			if (ConfigReloadPending)
+			{
+				ConfigReloadPending = false;
+				ProcessConfigFile(PGC_SIGHUP);
+			}
+
+			bgwriter_process_eviction_queue();
+
 			for (poolType = 0; poolType < OPagePoolTypesCount && !shutdown_requested; poolType++)
 			{
 				pool = get_ppool(poolType);
+				if (poolType == OPagePoolMain && bgwriterNum == 0)
+					bgwriter_apply_main_buffers_limit(pool);
 				need_eviction = ppool_free_pages_count(pool) < pool->size / 20;
 				need_write = ppool_dirty_pages_count(pool) > pool->size / 2;
 
@@ -145,7 +348,8 @@ bgwriter_main(Datum main_arg)
 
 					while (need_eviction || need_write)
 					{
-						ppool_run_clock(pool, need_eviction, &shutdown_requested);
+						ppool_run_clock(pool, need_eviction, &shutdown_requested,
+										bgwriter_get_clock_hand(pool, poolType));
 						i++;
 
 						if (i >= bgwriter_lru_maxpages * (BLCKSZ / ORIOLEDB_BLCKSZ))
@@ -162,7 +366,8 @@ bgwriter_main(Datum main_arg)
 					MemoryContextReset(TopTransactionContext);
 				}
 
-				if (!shutdown_requested && ucm_epoch_needs_shift(&pool->ucm))
+				if (!shutdown_requested && bgwriterNum == 0 &&
+					ucm_epoch_needs_shift(&pool->ucm))
 				{
 					if (ucm_epoch_needs_shift(&pool->ucm))
 						ucm_epoch_shift(&pool->ucm);
@@ -187,12 +392,10 @@ bgwriter_main(Datum main_arg)
 				}
 			}
 
-			check_pending_truncates();
+			check_pending_truncates(false);
 
 			if (orioledb_s3_mode)
 				s3_headers_try_eviction_cycle();
-
-			ResetLatch(MyLatch);
 		}
 		elog(LOG, "orioledb bgwriter is shut down");
 	}
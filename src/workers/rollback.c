@@ -0,0 +1,373 @@
+/*-------------------------------------------------------------------------
+ *
+ * rollback.c
+ *		Routines for background rollback of large transactions.
+ *
+ * Copyright (c) 2025-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/workers/rollback.c
+ *
+ * NOTES
+ *
+ *		Applying the undo of the transaction takes about as long as the
+ *		transaction itself.  Once the undo of the aborting transaction exceeds
+ *		orioledb.deferred_rollback_threshold, the backend hands it over to the
+ *		rollback worker instead.  The backend moves the undo stack locations
+ *		and the undo retain locations to the worker's ODBProcData, marks the
+ *		oxid aborted, and goes on.  The worker applies the undo stack as the
+ *		backend would do.
+ *
+ *		Meanwhile, readers skip the versions of the aborted oxid according to
+ *		its CSN, and writers roll back the tuples they meet themselves (see
+ *		o_btree_modify_handle_conflicts()).  The oxid being rolled back holds
+ *		the global xmin, so its versions are never considered frozen.  Also,
+ *		xid_is_finished_for_everybody() doesn't report it until the rollback
+ *		is done, so page compaction doesn't erase the tuples it deleted.  The
+ *		checkpointer sees the oxid in the worker's ODBProcData as in-progress,
+ *		so recovery finishes the rollback after a crash.
+ *
+ *		The worker takes one transaction at a time.  While it's busy, the
+ *		backends roll back themselves.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "checkpoint/checkpoint.h"
+#include "transam/oxid.h"
+#include "transam/undo.h"
+#include "workers/rollback.h"
+
+#include "access/htup_details.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/interrupt.h"
+#include "storage/latch.h"
+#include "storage/proc.h"
+#include "storage/sinvaladt.h"
+#include "storage/spin.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+#include "utils/relcache.h"
+#include "utils/syscache.h"
+#include "utils/timeout.h"
+
+#include "pgstat.h"
+
+typedef struct
+{
+	slock_t		lock;
+	/* proc number of the rollback worker, -1 if it's not running */
+	int			procno;
+	/* the oxid being rolled back by the worker */
+	pg_atomic_uint64 oxid;
+	pg_atomic_uint64 deferred;
+	pg_atomic_uint64 completed;
+} RollbackWorkerShared;
+
+/* Undo size in kB, which makes rollback deferred.  -1 disables deferring. */
+int			deferred_rollback_threshold = -1;
+
+static RollbackWorkerShared *rollbackShared = NULL;
+static volatile sig_atomic_t shutdown_requested = false;
+
+PG_FUNCTION_INFO_V1(orioledb_deferred_rollback_stats);
+
+Size
+rollback_worker_shmem_needs(void)
+{
+	return sizeof(RollbackWorkerShared);
+}
+
+void
+rollback_worker_shmem_init(Pointer ptr, bool found)
+{
+	rollbackShared = (RollbackWorkerShared *) ptr;
+
+	if (!found)
+	{
+		SpinLockInit(&rollbackShared->lock);
+		rollbackShared->procno = -1;
+		pg_atomic_init_u64(&rollbackShared->oxid, InvalidOXid);
+		pg_atomic_init_u64(&rollbackShared->deferred, 0);
+		pg_atomic_init_u64(&rollbackShared->completed, 0);
+	}
+}
+
+/*
+ * Returns the oxid being rolled back in the background, InvalidOXid if none.
+ */
+OXid
+deferred_rollback_get_oxid(void)
+{
+	if (!rollbackShared)
+		return InvalidOXid;
+	return pg_atomic_read_u64(&rollbackShared->oxid);
+}
+
+/*
+ * Hands over the undo stack of the aborting transaction to the rollback
+ * worker.  Must be called before the oxid is marked aborted.  Returns false
+ * if the caller should apply the undo itself: the undo is small, or the
+ * worker isn't available.
+ */
+bool
+deferred_rollback_hand_over(OXid oxid)
+{
+	ODBProcData *curProcData = GET_CUR_PROCDATA();
+	ODBProcData *workerProcData;
+	UndoStackLocations locations[(int) UndoLogsCount];
+	uint64		undoSize = 0;
+	int			procno;
+	int			i;
+
+	if (deferred_rollback_threshold < 0 ||
+		curProcData->autonomousNestingLevel != 0)
+		return false;
+
+	for (i = 0; i < (int) UndoLogsCount; i++)
+	{
+		UndoLocation retainLocation;
+
+		read_shared_undo_locations(&locations[i],
+								   GET_CUR_UNDO_STACK_LOCATIONS((UndoLogType) i));
+		retainLocation = pg_atomic_read_u64(&curProcData->undoRetainLocations[i].transactionUndoRetainLocation);
+		if (UndoLocationIsValid(locations[i].location) &&
+			UndoLocationIsValid(retainLocation) &&
+			locations[i].location > retainLocation)
+			undoSize += locations[i].location - retainLocation;
+	}
+
+	if (undoSize == 0 || undoSize < (uint64) deferred_rollback_threshold * 1024)
+		return false;
+
+	SpinLockAcquire(&rollbackShared->lock);
+	procno = rollbackShared->procno;
+	if (procno < 0 || OXidIsValid(pg_atomic_read_u64(&rollbackShared->oxid)))
+	{
+		SpinLockRelease(&rollbackShared->lock);
+		return false;
+	}
+
+	/*
+	 * Since now, the oxid holds the global xmin.  Our own xmin is still set,
+	 * so the global xmin can't pass the oxid meanwhile.
+	 */
+	pg_atomic_write_u64(&rollbackShared->oxid, oxid);
+	SpinLockRelease(&rollbackShared->lock);
+
+	workerProcData = &oProcData[procno];
+	for (i = 0; i < (int) UndoLogsCount; i++)
+		pg_atomic_write_u64(&workerProcData->undoRetainLocations[i].transactionUndoRetainLocation,
+							pg_atomic_read_u64(&curProcData->undoRetainLocations[i].transactionUndoRetainLocation));
+
+	LWLockAcquire(&workerProcData->undoStackLocationsFlushLock, LW_EXCLUSIVE);
+	for (i = 0; i < (int) UndoLogsCount; i++)
+		write_shared_undo_locations(&workerProcData->undoStackLocations[0][i],
+									&locations[i]);
+	pg_write_barrier();
+	workerProcData->vxids[0].oxid = oxid;
+	LWLockRelease(&workerProcData->undoStackLocationsFlushLock);
+
+	/*
+	 * The concurrent checkpointer might already pass the worker, but not us.
+	 * Then flush the undo locations as we would do after the rollback.
+	 */
+	LWLockAcquire(&curProcData->undoStackLocationsFlushLock, LW_EXCLUSIVE);
+	if (curProcData->flushUndoLocations)
+	{
+		for (i = 0; i < (int) UndoLogsCount; i++)
+		{
+			XidFileRec	rec;
+
+			rec.oxid = oxid;
+			rec.undoType = (UndoLogType) i;
+			rec.undoLocation = locations[i];
+			write_to_xids_queue(&rec);
+		}
+	}
+	LWLockRelease(&curProcData->undoStackLocationsFlushLock);
+
+	pg_atomic_fetch_add_u64(&rollbackShared->deferred, 1);
+	SetLatch(&GetPGProcByNumber(procno)->procLatch);
+
+	return true;
+}
+
+/*
+ * Applies the undo stack handed over by the backend and releases the undo
+ * locations as the backend does on abort.
+ */
+static void
+rollback_worker_apply(OXid oxid)
+{
+	ODBProcData *curProcData = GET_CUR_PROCDATA();
+	int			i;
+
+	elog(DEBUG1, "orioledb rollback worker applies undo of transaction " UINT64_FORMAT,
+		 oxid);
+
+	for (i = 0; i < (int) UndoLogsCount; i++)
+		apply_undo_stack((UndoLogType) i, oxid, NULL, true);
+	reset_cur_undo_locations();
+	pg_write_barrier();
+	curProcData->vxids[0].oxid = InvalidOXid;
+
+	for (i = 0; i < (int) UndoLogsCount; i++)
+	{
+		release_undo_size((UndoLogType) i);
+		free_retained_undo_location((UndoLogType) i);
+	}
+
+	MemoryContextReset(CurTransactionContext);
+	MemoryContextReset(TopTransactionContext);
+
+	/* The oxid doesn't need to hold the global xmin anymore */
+	pg_write_barrier();
+	pg_atomic_write_u64(&rollbackShared->oxid, InvalidOXid);
+	pg_atomic_fetch_add_u64(&rollbackShared->completed, 1);
+}
+
+static void
+handle_sigterm(SIGNAL_ARGS)
+{
+	shutdown_requested = true;
+	SetLatch(MyLatch);
+}
+
+void
+register_rollback_worker(void)
+{
+	BackgroundWorker worker;
+
+	if (deferred_rollback_threshold < 0)
+		return;
+
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
+	worker.bgw_restart_time = 1;
+	strcpy(worker.bgw_library_name, "orioledb");
+	strcpy(worker.bgw_function_name, "rollback_worker_main");
+	strcpy(worker.bgw_name, "orioledb rollback worker");
+	strcpy(worker.bgw_type, "orioledb rollback worker");
+	RegisterBackgroundWorker(&worker);
+}
+
+void
+rollback_worker_main(Datum main_arg)
+{
+	OXid		oxid = InvalidOXid;
+
+	/* enable timeout for relation lock */
+	RegisterTimeout(DEADLOCK_TIMEOUT, CheckDeadLockAlert);
+
+	/* enable relation cache invalidation (remove old OTableDescr) */
+	RelationCacheInitialize();
+	InitCatalogCache();
+	SharedInvalBackendInit(false);
+
+	SetProcessingMode(NormalProcessing);
+
+	/* the rollback in progress is finished before the shutdown */
+	pqsignal(SIGTERM, handle_sigterm);
+	pqsignal(SIGHUP, SignalHandlerForConfigReload);
+	BackgroundWorkerUnblockSignals();
+
+	elog(LOG, "orioledb rollback worker started");
+
+	CurTransactionContext = AllocSetContextCreate(TopMemoryContext,
+												  "orioledb rollback worker current transaction context",
+												  ALLOCSET_DEFAULT_SIZES);
+	TopTransactionContext = AllocSetContextCreate(TopMemoryContext,
+												  "orioledb rollback worker top transaction context",
+												  ALLOCSET_DEFAULT_SIZES);
+
+	/* Make us visible to the aborting backends */
+	SpinLockAcquire(&rollbackShared->lock);
+	rollbackShared->procno = MYPROCNUMBER;
+	SpinLockRelease(&rollbackShared->lock);
+
+	PG_TRY();
+	{
+		MemoryContextSwitchTo(CurTransactionContext);
+		while (!shutdown_requested)
+		{
+			int			rc;
+
+			rc = WaitLatch(MyLatch,
+						   WL_LATCH_SET | WL_POSTMASTER_DEATH | WL_TIMEOUT,
+						   1000, PG_WAIT_EXTENSION);
+
+			if (rc & WL_POSTMASTER_DEATH)
+				shutdown_requested = true;
+
+			ResetLatch(MyLatch);
+
+			if (ConfigReloadPending)
+			{
+				ConfigReloadPending = false;
+				ProcessConfigFile(PGC_SIGHUP);
+			}
+
+			oxid = pg_atomic_read_u64(&rollbackShared->oxid);
+			if (OXidIsValid(oxid))
+				rollback_worker_apply(oxid);
+			oxid = InvalidOXid;
+		}
+
+		/* Don't leave behind the transaction handed over meanwhile */
+		SpinLockAcquire(&rollbackShared->lock);
+		rollbackShared->procno = -1;
+		SpinLockRelease(&rollbackShared->lock);
+
+		oxid = pg_atomic_read_u64(&rollbackShared->oxid);
+		if (OXidIsValid(oxid))
+			rollback_worker_apply(oxid);
+	}
+	PG_CATCH();
+	{
+		/*
+		 * The aborted transaction can't be left half-applied: its undo stack
+		 * is only in our ODBProcData.  Let recovery finish the rollback.
+		 */
+		if (OXidIsValid(oxid))
+		{
+			EmitErrorReport();
+			elog(PANIC, "orioledb rollback worker failed to apply undo of transaction " UINT64_FORMAT,
+				 oxid);
+		}
+		LockReleaseSession(DEFAULT_LOCKMETHOD);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	elog(LOG, "orioledb rollback worker is shut down");
+}
+
+/*
+ * Returns the number of transactions handed over to the rollback worker and
+ * the number of transactions it has rolled back.
+ */
+Datum
+orioledb_deferred_rollback_stats(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Datum		values[2];
+	bool		nulls[2];
+
+	orioledb_check_shmem();
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	MemSet(nulls, 0, sizeof(nulls));
+	values[0] = Int64GetDatum(pg_atomic_read_u64(&rollbackShared->deferred));
+	values[1] = Int64GetDatum(pg_atomic_read_u64(&rollbackShared->completed));
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
@@ -0,0 +1,467 @@
+/*-------------------------------------------------------------------------
+ *
+ * warmup.c
+ *		Routines for saving and restoring the hot page set.
+ *
+ * Copyright (c) 2021-2025, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/workers/warmup.c
+ *
+ * NOTES
+ *
+ *		At the end of each checkpoint, the checkpointer saves the manifest of
+ *		the in-memory leaves of the main page pool.  The in-memory page
+ *		can't be referenced directly after restart, so each leaf is
+ *		identified by its tree and the key of its first tuple.  The entries
+ *		are ordered by the leaf usage count according to UCM, and within the
+ *		same usage count by the tree and the leaf location in the data file.
+ *
+ *		After the recovery is finished (including the promotion of the
+ *		standby), the warmup workers load the leaves back by looking up
+ *		their keys.  The entries are split between workers by chunks, so
+ *		every worker loads both the hottest leaves first and the most of
+ *		its leaves in disk order.  The loading stops once the main page pool
+ *		is almost full, and the warmup never evicts anything.
+ *
+ *		In S3 mode, the manifest is also uploaded with the checkpoint.  A node
+ *		restored by orioledb_s3_loader.py gets only the metadata and the map
+ *		files, and the data file parts are loaded from S3 on access.  So the
+ *		warmup workers fault the hot leaves in from S3 in the background
+ *		once the node is started.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "btree/btree.h"
+#include "btree/io.h"
+#include "btree/iterator.h"
+#include "btree/page_chunks.h"
+#include "btree/page_contents.h"
+#include "btree/page_state.h"
+#include "catalog/sys_trees.h"
+#include "s3/worker.h"
+#include "tableam/descr.h"
+#include "transam/oxid.h"
+#include "utils/page_pool.h"
+#include "utils/ucm.h"
+#include "workers/warmup.h"
+
+#include "miscadmin.h"
+#include "postmaster/bgworker.h"
+#include "storage/fd.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/sinvaladt.h"
+#include "utils/memutils.h"
+#include "utils/timeout.h"
+#include "utils/wait_event.h"
+
+#define WARMUP_FILENAME		(ORIOLEDB_DATA_DIR "/warmup")
+#define WARMUP_TMP_FILENAME	(ORIOLEDB_DATA_DIR "/warmup.tmp")
+#define WARMUP_MAGIC		(0x4F574D50)
+
+/* Number of consecutive entries loaded by the same worker */
+#define WARMUP_CHUNK_SIZE	(64)
+
+typedef struct
+{
+	uint32		magic;
+	uint32		count;
+} WarmupFileHeader;
+
+/* Manifest entry, followed by the key data */
+typedef struct
+{
+	ORelOids	oids;
+	uint8		type;
+	uint8		hotness;
+	uint8		keyFormatFlags;
+	uint8		pad;
+	uint16		keyLength;
+	uint64		offset;
+} WarmupFileEntry;
+
+typedef struct
+{
+	WarmupFileEntry entry;
+	Pointer		key;
+} WarmupEntry;
+
+/*
+ * GUC value, number of workers loading the hot page set on startup.  Zero
+ * disables both saving and loading of the hot page set.
+ */
+int			buffer_warmup_workers = 0;
+
+static volatile sig_atomic_t shutdown_requested = false;
+
+static void
+handle_sigterm(SIGNAL_ARGS)
+{
+	shutdown_requested = true;
+	SetLatch(MyLatch);
+}
+
+static int
+warmup_entry_cmp(const void *a, const void *b)
+{
+	const WarmupFileEntry *e1 = &((const WarmupEntry *) a)->entry;
+	const WarmupFileEntry *e2 = &((const WarmupEntry *) b)->entry;
+
+	if (e1->hotness != e2->hotness)
+		return e1->hotness > e2->hotness ? -1 : 1;
+	if (e1->oids.datoid != e2->oids.datoid)
+		return e1->oids.datoid < e2->oids.datoid ? -1 : 1;
+	if (e1->oids.relnode != e2->oids.relnode)
+		return e1->oids.relnode < e2->oids.relnode ? -1 : 1;
+	if (e1->type != e2->type)
+		return e1->type < e2->type ? -1 : 1;
+	if (e1->offset != e2->offset)
+		return e1->offset < e2->offset ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Makes the manifest entry for the in-memory leaf.  Returns false if the
+ * page isn't a leaf of a user tree or it's concurrently in use.
+ */
+static bool
+warmup_make_entry(OPagePool *pool, OInMemoryBlkno blkno, WarmupEntry *result)
+{
+	OrioleDBPageDesc *page_desc = O_GET_IN_MEMORY_PAGEDESC(blkno);
+	Page		p = O_GET_IN_MEMORY_PAGE(blkno);
+	BTreeDescr *desc;
+	BTreePageItemLocator loc;
+	ORelOids	oids = page_desc->oids;
+	OIndexType	type = page_desc->type;
+	uint32		usageCount;
+	char		tupleBuf[O_BTREE_MAX_TUPLE_SIZE];
+	OTuple		tuple;
+	OTuple		key;
+	bool		allocated;
+	int			len;
+
+	if (!ORelOidsIsValid(oids) || IS_SYS_TREE_OIDS(oids) ||
+		!O_PAGE_IS(p, LEAF))
+		return false;
+
+	usageCount = pg_atomic_read_u32(&O_PAGE_HEADER(p)->usageCount);
+	if (usageCount >= UCM_USAGE_LEVELS)
+		return false;
+
+	/* Only consider trees, which are already in use */
+	desc = index_oids_get_btree_descr(oids, type);
+	if (desc == NULL)
+		return false;
+
+	if (!try_lock_page(blkno))
+		return false;
+
+	if (!ORelOidsIsEqual(page_desc->oids, oids) || page_desc->type != type ||
+		!O_PAGE_IS(p, LEAF))
+	{
+		unlock_page(blkno);
+		return false;
+	}
+
+	BTREE_PAGE_LOCATOR_FIRST(p, &loc);
+	if (!page_locator_find_real_item(p, NULL, &loc))
+	{
+		unlock_page(blkno);
+		return false;
+	}
+	BTREE_PAGE_READ_LEAF_TUPLE(tuple, p, &loc);
+	len = o_btree_len(desc, tuple, OTupleLength);
+	memcpy(tupleBuf, tuple.data, len);
+	tuple.data = tupleBuf;
+	result->entry.offset = page_desc->fileExtent.off;
+	unlock_page(blkno);
+
+	key = o_btree_tuple_make_key(desc, tuple, NULL, true, &allocated);
+	len = o_btree_len(desc, key, OKeyLength);
+	result->key = palloc(len);
+	memcpy(result->key, key.data, len);
+	if (allocated)
+		pfree(key.data);
+
+	result->entry.oids = oids;
+	result->entry.type = type;
+	result->entry.hotness = (UCM_LEVELS + usageCount -
+							 pg_atomic_read_u32(pool->ucm.epoch)) % UCM_LEVELS;
+	result->entry.keyFormatFlags = key.formatFlags;
+	result->entry.pad = 0;
+	result->entry.keyLength = len;
+	return true;
+}
+
+static bool
+warmup_write(File file, Pointer data, int length, off_t *offset)
+{
+	if (FileWrite(file, data, length, *offset,
+				  WAIT_EVENT_DATA_FILE_WRITE) != length)
+	{
+		ereport(WARNING, (errcode_for_file_access(),
+						  errmsg("could not write warmup file %s: %m",
+								 WARMUP_TMP_FILENAME)));
+		return false;
+	}
+	*offset += length;
+	return true;
+}
+
+/*
+ * Saves the manifest of the hot leaves of the main page pool after the
+ * checkpoint 'chkpNum'.
+ */
+void
+buffer_warmup_save(uint32 chkpNum)
+{
+	OPagePool  *pool = get_ppool(OPagePoolMain);
+	MemoryContext mcxt,
+				prevContext;
+	WarmupEntry *entries;
+	WarmupFileHeader header;
+	OInMemoryBlkno blkno;
+	uint32		count = 0;
+	uint32		i;
+	File		file;
+	off_t		offset = 0;
+	bool		success;
+
+	if (buffer_warmup_workers <= 0)
+		return;
+
+	mcxt = AllocSetContextCreate(CurrentMemoryContext,
+								 "orioledb warmup save context",
+								 ALLOCSET_DEFAULT_SIZES);
+	prevContext = MemoryContextSwitchTo(mcxt);
+
+	entries = (WarmupEntry *) MemoryContextAllocHuge(mcxt,
+													 sizeof(WarmupEntry) * pool->size);
+	for (blkno = pool->offset; blkno < pool->offset + pool->size; blkno++)
+	{
+		if (warmup_make_entry(pool, blkno, &entries[count]))
+			count++;
+	}
+
+	pg_qsort(entries, count, sizeof(WarmupEntry), warmup_entry_cmp);
+
+	/*
+	 * The manifest is only a hint, so failure to write it shouldn't fail the
+	 * checkpoint.
+	 */
+	file = PathNameOpenFile(WARMUP_TMP_FILENAME,
+							O_WRONLY | O_CREAT | O_TRUNC | PG_BINARY);
+	if (file < 0)
+	{
+		ereport(WARNING, (errcode_for_file_access(),
+						  errmsg("could not open warmup file %s: %m",
+								 WARMUP_TMP_FILENAME)));
+		success = false;
+	}
+	else
+	{
+		header.magic = WARMUP_MAGIC;
+		header.count = count;
+		success = warmup_write(file, (Pointer) &header, sizeof(header),
+							   &offset);
+		for (i = 0; success && i < count; i++)
+		{
+			success = warmup_write(file, (Pointer) &entries[i].entry,
+								   sizeof(WarmupFileEntry), &offset) &&
+				warmup_write(file, entries[i].key,
+							 entries[i].entry.keyLength, &offset);
+		}
+
+		if (success && FileSync(file, WAIT_EVENT_DATA_FILE_SYNC) != 0)
+		{
+			ereport(WARNING, (errcode_for_file_access(),
+							  errmsg("could not sync warmup file %s: %m",
+									 WARMUP_TMP_FILENAME)));
+			success = false;
+		}
+		FileClose(file);
+
+		if (success)
+			success = durable_rename(WARMUP_TMP_FILENAME, WARMUP_FILENAME,
+									 WARNING) == 0;
+	}
+
+	MemoryContextSwitchTo(prevContext);
+	MemoryContextDelete(mcxt);
+
+	if (success)
+		elog(DEBUG1, "orioledb warmup manifest saved: %u leaves", count);
+
+	/* No need to wait for the upload: the manifest is only a hint */
+	if (success && orioledb_s3_mode)
+		(void) s3_schedule_file_write(chkpNum, WARMUP_FILENAME, false);
+}
+
+/*
+ * Reads the manifest.  Returns NULL if there is no valid manifest.
+ */
+static Pointer
+warmup_read_manifest(uint32 *count)
+{
+	File		file;
+	off_t		size;
+	Pointer		data;
+	WarmupFileHeader *header;
+
+	file = PathNameOpenFile(WARMUP_FILENAME, O_RDONLY | PG_BINARY);
+	if (file < 0)
+		return NULL;
+
+	size = FileSize(file);
+	if (size < (off_t) sizeof(WarmupFileHeader))
+	{
+		FileClose(file);
+		return NULL;
+	}
+
+	data = MemoryContextAllocHuge(TopMemoryContext, size);
+	if (FileRead(file, data, size, 0, WAIT_EVENT_DATA_FILE_READ) != size)
+		ereport(ERROR, (errcode_for_file_access(),
+						errmsg("could not read warmup file %s: %m",
+							   WARMUP_FILENAME)));
+	FileClose(file);
+
+	header = (WarmupFileHeader *) data;
+	if (header->magic != WARMUP_MAGIC)
+	{
+		pfree(data);
+		return NULL;
+	}
+
+	*count = header->count;
+	return data;
+}
+
+/*
+ * Loads the leaf of the manifest entry by looking up its key.
+ */
+static void
+warmup_load_leaf(WarmupFileEntry *entry, Pointer keyData)
+{
+	OIndexDescr *id;
+	OTuple		key;
+	OTuple		tuple;
+
+	id = o_fetch_index_descr(entry->oids, entry->type, false, NULL);
+	if (id == NULL)
+		return;
+
+	o_btree_load_shmem(&id->desc);
+
+	key.formatFlags = entry->keyFormatFlags;
+	key.data = keyData;
+	tuple = o_btree_find_tuple_by_key(&id->desc, &key, BTreeKeyNonLeafKey,
+									  &o_in_progress_snapshot, NULL,
+									  CurTransactionContext, NULL);
+	if (!O_TUPLE_IS_NULL(tuple))
+		pfree(tuple.data);
+}
+
+void
+register_warmup_workers(void)
+{
+	BackgroundWorker worker;
+	int			i;
+
+	for (i = 0; i < buffer_warmup_workers; i++)
+	{
+		memset(&worker, 0, sizeof(worker));
+		worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+		worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
+		worker.bgw_restart_time = BGW_NEVER_RESTART;
+		worker.bgw_main_arg = Int32GetDatum(i);
+		strcpy(worker.bgw_library_name, "orioledb");
+		strcpy(worker.bgw_function_name, "warmup_worker_main");
+		snprintf(worker.bgw_name, BGW_MAXLEN, "orioledb warmup worker %d", i);
+		strcpy(worker.bgw_type, "orioledb warmup worker");
+		RegisterBackgroundWorker(&worker);
+	}
+}
+
+void
+warmup_worker_main(Datum main_arg)
+{
+	int			id = DatumGetInt32(main_arg);
+	OPagePool  *pool;
+	Pointer		data;
+	Pointer		ptr;
+	uint32		count = 0,
+				loaded = 0,
+				i;
+
+	/* enable timeout for relation lock */
+	RegisterTimeout(DEADLOCK_TIMEOUT, CheckDeadLockAlert);
+
+	/* enable relation cache invalidation (remove old OTableDescr) */
+	RelationCacheInitialize();
+	InitCatalogCache();
+	SharedInvalBackendInit(false);
+
+	SetProcessingMode(NormalProcessing);
+
+	pqsignal(SIGTERM, handle_sigterm);
+	BackgroundWorkerUnblockSignals();
+
+	CurTransactionContext = AllocSetContextCreate(TopMemoryContext,
+												  "orioledb warmup current transaction context",
+												  ALLOCSET_DEFAULT_SIZES);
+	TopTransactionContext = AllocSetContextCreate(TopMemoryContext,
+												  "orioledb warmup top transaction context",
+												  ALLOCSET_DEFAULT_SIZES);
+
+	data = warmup_read_manifest(&count);
+	if (data == NULL)
+		proc_exit(0);
+
+	pool = get_ppool(OPagePoolMain);
+	ptr = data + sizeof(WarmupFileHeader);
+
+	PG_TRY();
+	{
+		MemoryContextSwitchTo(CurTransactionContext);
+		for (i = 0; i < count && !shutdown_requested; i++)
+		{
+			WarmupFileEntry entry;
+
+			memcpy(&entry, ptr, sizeof(entry));
+			ptr += sizeof(entry);
+
+			if ((i / WARMUP_CHUNK_SIZE) % buffer_warmup_workers == id)
+			{
+				/* Never make the warmup evict pages */
+				if (ppool_free_pages_count(pool) < pool->size / 10)
+					break;
+
+				warmup_load_leaf(&entry, ptr);
+				loaded++;
+
+				MemoryContextReset(CurTransactionContext);
+				MemoryContextReset(TopTransactionContext);
+			}
+			ptr += entry.keyLength;
+
+			CHECK_FOR_INTERRUPTS();
+		}
+	}
+	PG_CATCH();
+	{
+		LockReleaseSession(DEFAULT_LOCKMETHOD);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	LockReleaseSession(DEFAULT_LOCKMETHOD);
+	elog(LOG, "orioledb warmup worker %d finished: %u leaves loaded",
+		 id, loaded);
+	proc_exit(0);
+}
@@ -1363,6 +1363,31 @@ SELECT * FROM bitmap_test_complex WHERE val IN ('13!', 'b');
 EXPLAIN (COSTS OFF) SELECT * FROM bitmap_test_complex WHERE val < '13!';
 SELECT * FROM bitmap_test_complex WHERE val < '13!';
 
+CREATE TABLE bitmap_test_lossy (
+	id int8 PRIMARY KEY,
+	val_1 int NOT NULL,
+	val_2 int NOT NULL
+) USING orioledb;
+INSERT INTO bitmap_test_lossy
+	SELECT i * 6, i % 2, i % 3 FROM generate_series(1, 300000) i;
+CREATE INDEX bitmap_test_lossy_ix1 ON bitmap_test_lossy (val_1);
+CREATE INDEX bitmap_test_lossy_ix2 ON bitmap_test_lossy (val_2);
+
+BEGIN;
+SET LOCAL enable_seqscan = OFF;
+SET LOCAL enable_indexscan = OFF;
+-- Key bitmaps don't fit into work_mem and become lossy
+SET LOCAL work_mem = '64kB';
+SELECT count(*) AS rows_count, sum(id) AS rows_sum_total
+	FROM bitmap_test_lossy WHERE val_1 = 0;
+SELECT count(*) AS rows_count, sum(id) AS rows_sum_total
+	FROM bitmap_test_lossy WHERE val_1 = 0 OR val_2 = 0;
+SELECT count(*) AS rows_count, sum(id) AS rows_sum_total
+	FROM bitmap_test_lossy WHERE val_1 = 1 AND val_2 = 2;
+SELECT count(*) AS rows_count, sum(id) AS rows_sum_total
+	FROM bitmap_test_lossy WHERE val_1 = 1 AND id < 1000;
+COMMIT;
+
 DROP EXTENSION orioledb CASCADE;
 DROP SCHEMA bitmap_scan CASCADE;
 RESET search_path;
\ No newline at end of file
@@ -1950,6 +1950,72 @@ EXPLAIN (COSTS OFF)
 SELECT * FROM o_test_saop WHERE i < ANY(ARRAY[1, 2]) AND j = ANY(ARRAY[1, 3]) ORDER BY i, j, k;
 SELECT * FROM o_test_saop WHERE i < ANY(ARRAY[1, 2]) AND j = ANY(ARRAY[1, 3]) ORDER BY i, j, k;
 
+CREATE TABLE o_test_index_filter (
+	id int NOT NULL PRIMARY KEY,
+	a int NOT NULL,
+	b int,
+	c text
+) USING orioledb;
+CREATE INDEX o_test_index_filter_ix ON o_test_index_filter (a) INCLUDE (b);
+INSERT INTO o_test_index_filter
+	(SELECT i, i % 100, NULLIF(i % 7, 0), i::text FROM generate_series(1, 10000) i);
+
+SET enable_seqscan = off;
+SET enable_bitmapscan = off;
+-- Simple quals over index fields are checked before primary key lookups
+SELECT count(*) AS cnt, sum(id) AS idsum1 FROM o_test_index_filter
+	WHERE a BETWEEN 10 AND 19 AND b = 3;
+SELECT count(*) AS cnt, sum(id) AS idsum_2 FROM o_test_index_filter
+	WHERE a < 50 AND 4 < b AND id > 5000;
+-- Quals which might fail are left to the executor order
+CREATE FUNCTION o_test_index_filter_div_gt(int, int) RETURNS bool AS $$
+BEGIN
+	RETURN 100 / $1 > $2;
+END $$ LANGUAGE plpgsql IMMUTABLE STRICT;
+CREATE OPERATOR ### (FUNCTION = o_test_index_filter_div_gt,
+					 LEFTARG = int, RIGHTARG = int);
+SELECT count(*) AS cnt, sum(id) AS idsum_4 FROM o_test_index_filter
+	WHERE a BETWEEN 0 AND 5 AND a <> 0 AND a ### 30;
+DROP OPERATOR ### (int, int);
+DROP FUNCTION o_test_index_filter_div_gt(int, int);
+SET orioledb.enable_sorted_pk_fetch = on;
+-- Primary keys are looked up in their order if the index order isn't needed
+SELECT count(*) AS cnt, sum(id) AS idsum_3, sum(length(c)) AS clen
+	FROM o_test_index_filter WHERE a BETWEEN 20 AND 24;
+SELECT count(*) AS cnt, sum(id) AS idsum_2 FROM o_test_index_filter
+	WHERE a < 50 AND 4 < b AND id > 5000;
+SELECT a, c FROM o_test_index_filter WHERE a > 95 ORDER BY a LIMIT 3;
+RESET orioledb.enable_sorted_pk_fetch;
+RESET enable_seqscan;
+RESET enable_bitmapscan;
+
+CREATE TABLE o_test_skip_scan (
+	region int NOT NULL,
+	ts int NOT NULL,
+	val int,
+	PRIMARY KEY (region, ts)
+) USING orioledb;
+INSERT INTO o_test_skip_scan
+	(SELECT i % 10, i / 10, i FROM generate_series(0, 9999) i);
+
+SET enable_seqscan = off;
+SET enable_bitmapscan = off;
+-- Quals only on the second column skip over the leading column values
+SELECT count(*) AS rows_count, sum(val) AS rows_sum_total FROM o_test_skip_scan
+	WHERE ts BETWEEN 100 AND 102;
+SELECT count(*) AS rows_count, sum(val) AS rows_sum_total FROM o_test_skip_scan
+	WHERE region >= 7 AND ts = 500;
+SELECT count(*) AS rows_count, sum(val) AS rows_sum_total FROM o_test_skip_scan
+	WHERE ts < 2;
+SELECT count(*) AS rows_count, sum(val) AS rows_sum_total FROM o_test_skip_scan
+	WHERE ts > 997;
+SET orioledb.enable_skip_scan = off;
+SELECT count(*) AS rows_count, sum(val) AS rows_sum_total FROM o_test_skip_scan
+	WHERE ts BETWEEN 100 AND 102;
+RESET orioledb.enable_skip_scan;
+RESET enable_seqscan;
+RESET enable_bitmapscan;
+
 SELECT orioledb_parallel_debug_stop();
 DROP EXTENSION orioledb CASCADE;
 DROP SCHEMA indices CASCADE;
@@ -135,6 +135,39 @@ RESET enable_hashjoin;
 
 DROP TABLE o_joins2;
 DROP TABLE o_joins1;
+
+CREATE TABLE o_joins_rescan (
+	id int NOT NULL PRIMARY KEY,
+	v int NOT NULL
+) USING orioledb;
+CREATE INDEX o_joins_rescan_v_idx ON o_joins_rescan (v);
+INSERT INTO o_joins_rescan (SELECT id, 5001 - id FROM generate_series(1, 5000) id);
+
+SET enable_hashjoin = off;
+SET enable_mergejoin = off;
+SET enable_material = off;
+SET enable_seqscan = off;
+SET enable_bitmapscan = off;
+-- Inner range scans restart from the leaf of the previous scan
+SELECT count(*) AS rows_count, sum(t.id) AS rows_sum_total
+	FROM generate_series(1, 200) g,
+		 LATERAL (SELECT id FROM o_joins_rescan t
+				  WHERE t.id >= g * 10 AND t.id < g * 10 + 5) t;
+SELECT count(*) AS rows_count, sum(t.id) AS rows_sum_total
+	FROM generate_series(200, 1, -1) g,
+		 LATERAL (SELECT id FROM o_joins_rescan t
+				  WHERE t.id >= g * 10 AND t.id < g * 10 + 5) t;
+SELECT count(*) AS rows_count, sum(t.id) AS rows_sum_total
+	FROM generate_series(1, 200) g,
+		 LATERAL (SELECT id FROM o_joins_rescan t
+				  WHERE t.v >= g * 10 AND t.v < g * 10 + 5) t;
+RESET enable_hashjoin;
+RESET enable_mergejoin;
+RESET enable_material;
+RESET enable_seqscan;
+RESET enable_bitmapscan;
+DROP TABLE o_joins_rescan;
+
 DROP EXTENSION orioledb CASCADE;
 DROP SCHEMA joins CASCADE;
 RESET search_path;
@@ -47,6 +47,13 @@ EXPLAIN (COSTS OFF)
 	SELECT * FROM seq_scan_test WHERE i < 100 ORDER BY i,id LIMIT 20;
 SELECT * FROM seq_scan_test WHERE i < 100 ORDER BY i,id LIMIT 20;
 
+-- No workers for a few rows
+BEGIN;
+SET LOCAL enable_indexonlyscan = off;
+EXPLAIN (COSTS OFF) SELECT id FROM seq_scan_test LIMIT 5;
+SELECT id FROM seq_scan_test LIMIT 5;
+COMMIT;
+
 SET max_parallel_workers_per_gather = 0;
 EXPLAIN (COSTS OFF) SELECT count(*) FROM seq_scan_test WHERE i < 1000;
 SELECT count(*) FROM seq_scan_test WHERE i < 1000;
@@ -449,6 +456,70 @@ SELECT * FROM o_test_no_parallel_bitmap_scan WHERE val_1 <@ int4range(10,50);
 
 COMMIT;
 
+CREATE TABLE o_test_parallel_secondary_scan (
+	id int PRIMARY KEY,
+	val int NOT NULL
+) USING orioledb;
+INSERT INTO o_test_parallel_secondary_scan
+	SELECT i, i % 1000 FROM generate_series(1, 100000) i;
+CREATE INDEX o_test_parallel_secondary_scan_ix1
+	ON o_test_parallel_secondary_scan (val);
+ANALYZE o_test_parallel_secondary_scan;
+
+BEGIN;
+SET LOCAL orioledb.enable_parallel_index_scan = on;
+SET LOCAL max_parallel_workers_per_gather = 2;
+SET LOCAL parallel_setup_cost = 0;
+SET LOCAL parallel_tuple_cost = 0;
+SET LOCAL min_parallel_index_scan_size = 1;
+SET LOCAL enable_seqscan = off;
+SET LOCAL enable_bitmapscan = off;
+
+-- Workers split the key range along leaf pages
+SELECT count(*) AS rows_count, sum(id) AS rows_sum_total
+	FROM o_test_parallel_secondary_scan WHERE val >= 100 AND val < 300;
+SELECT count(*) AS rows_count, sum(id) AS rows_sum_total
+	FROM o_test_parallel_secondary_scan WHERE val >= 990;
+-- Scans with array keys are done by a single worker
+SELECT count(*) AS rows_count, sum(id) AS rows_sum_total
+	FROM o_test_parallel_secondary_scan WHERE val = ANY(ARRAY[5, 7]);
+COMMIT;
+
+CREATE TABLE o_test_parallel_bitmap_or (
+	id int PRIMARY KEY,
+	val_1 int NOT NULL,
+	val_2 int NOT NULL
+) USING orioledb;
+INSERT INTO o_test_parallel_bitmap_or
+	SELECT i, i % 1000, i % 997 FROM generate_series(1, 100000) i;
+CREATE INDEX o_test_parallel_bitmap_or_ix1 ON o_test_parallel_bitmap_or (val_1);
+CREATE INDEX o_test_parallel_bitmap_or_ix2 ON o_test_parallel_bitmap_or (val_2);
+ANALYZE o_test_parallel_bitmap_or;
+
+BEGIN;
+SET LOCAL orioledb.enable_parallel_bitmap_scan = on;
+SET LOCAL max_parallel_workers_per_gather = 2;
+SET LOCAL parallel_setup_cost = 0;
+SET LOCAL parallel_tuple_cost = 0;
+SET LOCAL min_parallel_table_scan_size = 1;
+SET LOCAL min_parallel_index_scan_size = 1;
+SET LOCAL enable_seqscan = off;
+SET LOCAL enable_indexscan = off;
+SET LOCAL enable_indexonlyscan = off;
+
+-- Participants scan disjoint key ranges of the shared bitmap
+SELECT count(*) AS rows_count, sum(id) AS rows_sum_total
+	FROM o_test_parallel_bitmap_or WHERE val_1 = 5 OR val_2 = 7;
+SELECT count(*) AS rows_count, sum(id) AS rows_sum_total
+	FROM o_test_parallel_bitmap_or
+	WHERE val_1 < 50 OR val_2 BETWEEN 100 AND 120;
+SELECT count(*) AS rows_count, sum(id) AS rows_sum_total
+	FROM o_test_parallel_bitmap_or WHERE val_1 < 100 AND val_2 < 100;
+-- Empty bitmap
+SELECT count(*) AS rows_count, sum(id) AS rows_sum_total
+	FROM o_test_parallel_bitmap_or WHERE val_1 = -1 OR val_2 = -1;
+COMMIT;
+
 DROP EXTENSION orioledb CASCADE;
 DROP SCHEMA parallel_scan CASCADE;
 RESET search_path;
@@ -347,6 +347,38 @@ EXPLAIN (COSTS off) SELECT * FROM o_pk6 WHERE i <= 2 AND dt = '2021-03-01'::date
 SELECT * FROM o_pk6 WHERE i = 2 AND dt >= '2021-03-01'::date;
 RESET enable_seqscan;
 
+CREATE TABLE o_pk_copy (
+	id int4 NOT NULL PRIMARY KEY,
+	val text
+) USING orioledb;
+COPY o_pk_copy FROM stdin;
+3	c
+1	a
+5	e
+2	b
+4	d
+\.
+COPY o_pk_copy FROM stdin;
+7	g
+6	f
+\.
+SELECT * FROM o_pk_copy;
+
+CREATE TABLE o_pk_strict (
+	a int4 NOT NULL,
+	b int4 NOT NULL,
+	PRIMARY KEY (a, b)
+) USING orioledb;
+INSERT INTO o_pk_strict
+	(SELECT a, b FROM generate_series(1, 10) a, generate_series(1, 10) b);
+SET enable_seqscan = off;
+-- Strict bound on the leading column doesn't let the following ones decide
+SELECT min(a), max(a), min(b), max(b), count(*) FROM o_pk_strict WHERE a > 5 AND b >= 3;
+SELECT min(a), max(a), min(b), max(b), count(*) FROM o_pk_strict WHERE a < 5 AND b <= 3;
+SELECT min(a), max(a), min(b), max(b), count(*) FROM o_pk_strict WHERE a >= 5 AND b > 3;
+SELECT a, b FROM o_pk_strict WHERE a > 9 AND b >= 9 ORDER BY a DESC, b DESC;
+RESET enable_seqscan;
+
 DROP EXTENSION orioledb CASCADE;
 DROP SCHEMA primary_key CASCADE;
 RESET search_path;
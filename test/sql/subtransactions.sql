@@ -425,6 +425,30 @@ BEGIN
 END;$$;
 ROLLBACK;
 
+-- Check savepoints, which don't modify anything
+CREATE TABLE o_lazy_savepoints (
+	id int PRIMARY KEY,
+	val int
+) USING orioledb;
+INSERT INTO o_lazy_savepoints VALUES (1, 1);
+BEGIN;
+SAVEPOINT s1;
+SELECT * FROM o_lazy_savepoints;
+SAVEPOINT s2;
+SAVEPOINT s3;
+UPDATE o_lazy_savepoints SET val = 2 WHERE id = 1;
+ROLLBACK TO s2;
+SELECT * FROM o_lazy_savepoints;
+SAVEPOINT s4;
+RELEASE s4;
+UPDATE o_lazy_savepoints SET val = 3 WHERE id = 1;
+SAVEPOINT s5;
+ROLLBACK TO s5;
+RELEASE s1;
+COMMIT;
+SELECT * FROM o_lazy_savepoints;
+DROP TABLE o_lazy_savepoints;
+
 DROP EXTENSION orioledb CASCADE;
 DROP SCHEMA subtransactions CASCADE;
 RESET search_path;
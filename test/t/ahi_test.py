@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+import unittest
+
+from .base_test import BaseTest
+
+
+class AHITest(BaseTest):
+
+	def test_ahi_pk_lookups(self):
+		node = self.node
+		node.append_conf('postgresql.conf',
+		                 "orioledb.adaptive_hash_index_size = 1024\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int8 NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_test (SELECT id, id::text FROM generate_series(1, 10000, 2) id);\n"
+		    "CREATE INDEX o_test_val_idx ON o_test (val);\n")
+
+		lookups = "SELECT sum(length((SELECT val FROM o_test t WHERE t.id = g))) FROM generate_series(1, 10000) g;"
+		expected = node.execute("SELECT sum(length(id::text)) FROM generate_series(1, 10000, 2) id;")[0][0]
+
+		# Populate and then use the adaptive hash index
+		self.assertEqual(node.execute(lookups)[0][0], expected)
+		self.assertEqual(node.execute(lookups)[0][0], expected)
+
+		# Splits move keys to the right pages
+		node.safe_psql(
+		    'postgres',
+		    "INSERT INTO o_test (SELECT id, id::text FROM generate_series(2, 10000, 2) id);"
+		)
+		expected = node.execute("SELECT sum(length(id::text)) FROM generate_series(1, 10000) id;")[0][0]
+		self.assertEqual(node.execute(lookups)[0][0], expected)
+
+		# Merges change the pages under remembered locations
+		node.safe_psql('postgres', "DELETE FROM o_test WHERE id % 10 != 0;")
+		expected = node.execute("SELECT sum(length(id::text)) FROM generate_series(10, 10000, 10) id;")[0][0]
+		self.assertEqual(node.execute(lookups)[0][0], expected)
+
+		# Secondary index lookups fetch primary keys as well
+		self.assertEqual(
+		    node.execute("SELECT id FROM o_test WHERE val = '5000';")[0][0],
+		    5000)
+		node.stop()
+
+	def test_ahi_eviction(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.adaptive_hash_index_size = 65536\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int4 NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "CREATE TABLE o_evict (\n"
+		    "	id int4 NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_test (SELECT id FROM generate_series(1, 1000) id);\n"
+		)
+
+		lookups = "SELECT count((SELECT id FROM o_test t WHERE t.id = g)) FROM generate_series(1, 1000) g;"
+		self.assertEqual(node.execute(lookups)[0][0], 1000)
+
+		# Evict o_test pages and reuse the memory for another tree
+		node.safe_psql(
+		    'postgres',
+		    "INSERT INTO o_evict (SELECT id, repeat('x', 200) FROM generate_series(1, 100000) id);"
+		)
+		self.assertEqual(node.execute(lookups)[0][0], 1000)
+		node.stop()
+
+	def test_ahi_upsert(self):
+		node = self.node
+		node.append_conf('postgresql.conf',
+		                 "orioledb.adaptive_hash_index_size = 1024\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int8 NOT NULL,\n"
+		    "	val int8 NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_test (SELECT id, 0 FROM generate_series(1, 10000, 2) id);\n"
+		)
+
+		upsert = ("INSERT INTO o_test (SELECT id, 1 FROM generate_series(1, 10000) id ORDER BY random())\n"
+		          "	ON CONFLICT (id) DO UPDATE SET val = o_test.val + 1;")
+
+		# Populate and then use the adaptive hash index for the conflicts
+		node.safe_psql('postgres', upsert)
+		node.safe_psql('postgres', upsert)
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(val) FROM o_test;")[0],
+		    (10000, 20000))
+
+		# Merges change the pages under remembered locations
+		node.safe_psql('postgres', "DELETE FROM o_test WHERE id % 10 != 0;")
+		node.safe_psql(
+		    'postgres',
+		    "INSERT INTO o_test (SELECT id, 0 FROM generate_series(1, 10000) id ORDER BY random())\n"
+		    "	ON CONFLICT (id) DO NOTHING;")
+		self.assertEqual(node.execute("SELECT count(*) FROM o_test;")[0][0],
+		                 10000)
+		node.stop()
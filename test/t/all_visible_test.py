@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+from .base_test import BaseTest
+
+
+class AllVisibleTest(BaseTest):
+
+	def test_all_visible_modify(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int NOT NULL,\n"
+		    "	val int NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_test\n"
+		    "	(SELECT id, id FROM generate_series(1, 10000) id);\n"
+		    "CHECKPOINT;\n")
+
+		con1 = node.connect()
+		con2 = node.connect()
+		con1.begin()
+		con1.execute("SET TRANSACTION ISOLATION LEVEL REPEATABLE READ;")
+		self.assertEqual(
+		    con1.execute("SELECT count(*), sum(val) FROM o_test;")[0],
+		    (10000, 50005000))
+
+		con2.execute("UPDATE o_test SET val = val + 1 WHERE id % 100 = 0;")
+		con2.execute("DELETE FROM o_test WHERE id % 100 = 1;")
+		self.assertEqual(
+		    con1.execute("SELECT count(*), sum(val) FROM o_test;")[0],
+		    (10000, 50005000))
+		con2.commit()
+		node.safe_psql('postgres', "CHECKPOINT;")
+
+		self.assertEqual(
+		    con1.execute("SELECT count(*), sum(val) FROM o_test;")[0],
+		    (10000, 50005000))
+		self.assertEqual(
+		    con1.execute("SELECT val FROM o_test WHERE id = 101;")[0][0],
+		    101)
+		con1.commit()
+
+		self.assertEqual(
+		    con1.execute("SELECT count(*), sum(val) FROM o_test;")[0],
+		    (9900, 50005000 - 495100 + 100))
+		self.assertEqual(
+		    con1.execute("SELECT val FROM o_test WHERE id = 100;")[0][0],
+		    101)
+		self.assertEqual(
+		    con1.execute("SELECT count(*) FROM o_test WHERE id = 101;")[0][0],
+		    0)
+
+		# Leaves are marked all-visible once nobody holds an older snapshot
+		node.safe_psql('postgres', "CHECKPOINT;")
+		self.assertEqual(
+		    con1.execute("SELECT count(*), sum(val) FROM o_test;")[0],
+		    (9900, 50005000 - 495100 + 100))
+		con1.commit()
+
+		con1.close()
+		con2.close()
+		node.stop()
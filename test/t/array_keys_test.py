@@ -0,0 +1,44 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+from .base_test import BaseTest
+
+
+class ArrayKeysTest(BaseTest):
+
+	def test_array_keys_secondary(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int NOT NULL,\n"
+		    "	val int NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "CREATE INDEX o_test_val_idx ON o_test (val);\n"
+		    "INSERT INTO o_test\n"
+		    "	(SELECT id, id / 3 FROM generate_series(1, 100000) id);\n")
+
+		con = node.connect()
+		con.execute("SET enable_seqscan = off;")
+		con.execute("SET enable_bitmapscan = off;")
+
+		# Unsorted elements with duplicates, many of them on the same leaf
+		keys = [(i * 7919) % 33000 for i in range(5000)] + [5, 5, 40000]
+		array = "ARRAY[%s]" % ",".join(str(k) for k in keys)
+		expected = sorted(i for i in range(1, 100001) if i // 3 in set(keys))
+		self.assertEqual(
+		    [
+		        r[0] for r in con.execute(
+		            "SELECT id FROM o_test WHERE val = ANY(%s) ORDER BY val, id;"
+		            % array)
+		    ], expected)
+		self.assertEqual(
+		    [
+		        r[0] for r in con.execute(
+		            "SELECT id FROM o_test WHERE val = ANY(%s) ORDER BY val DESC, id DESC;"
+		            % array)
+		    ], list(reversed(expected)))
+		con.close()
+		node.stop()
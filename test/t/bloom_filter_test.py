@@ -0,0 +1,55 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+import unittest
+
+from .base_test import BaseTest
+
+
+class BloomFilterTest(BaseTest):
+
+	def test_bloom_filter_eviction(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.bloom_filter_size = 16384\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int4 NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "CREATE TABLE o_evict (\n"
+		    "	id int4 NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_test (SELECT id FROM generate_series(2, 20000, 2) id);\n"
+		)
+		evict = "INSERT INTO o_evict (SELECT id, repeat('x', 200) FROM generate_series(%d, %d) id);"
+		lookups = "SELECT count((SELECT id FROM o_test t WHERE t.id = g)) FROM generate_series(1, 20000) g;"
+
+		# Evict o_test pages, then look up both existing and missing keys
+		node.safe_psql('postgres', evict % (1, 100000))
+		self.assertEqual(node.execute(lookups)[0][0], 10000)
+
+		# Keys inserted after loading the pages back must be found
+		node.safe_psql(
+		    'postgres',
+		    "INSERT INTO o_test (SELECT id FROM generate_series(1, 20000, 20) id);"
+		)
+		node.safe_psql('postgres', evict % (100001, 200000))
+		self.assertEqual(node.execute(lookups)[0][0], 11000)
+
+		# Deleted keys might be still visible to older snapshots
+		con1 = node.connect()
+		con1.execute("BEGIN TRANSACTION ISOLATION LEVEL REPEATABLE READ;")
+		self.assertEqual(con1.execute(lookups)[0][0], 11000)
+		node.safe_psql('postgres', "DELETE FROM o_test WHERE id % 4 = 0;")
+		node.safe_psql('postgres', evict % (200001, 300000))
+		self.assertEqual(con1.execute(lookups)[0][0], 11000)
+		con1.commit()
+		con1.close()
+		self.assertEqual(node.execute(lookups)[0][0], 6000)
+		node.stop()
@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+from testgres.connection import DatabaseError
+
+from .base_test import BaseTest
+
+
+class BTreeBenchTest(BaseTest):
+
+	def test_btree_bench(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int8 NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "CREATE TABLE o_test_text (\n"
+		    "	id text NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n")
+
+		con = node.connect()
+		self.assertEqual(
+		    con.execute("SELECT ops FROM orioledb_btree_bench("
+		                "'o_test', 'insert', 20000, 'sequential', 10000);"),
+		    [(20000, )])
+		con.commit()
+		self.assertEqual(node.execute("SELECT count(*) FROM o_test;"),
+		                 [(10000, )])
+
+		for op in ['find_page', 'lookup', 'reorg', 'compress']:
+			for dist in ['sequential', 'uniform', 'zipfian']:
+				result = con.execute(
+				    "SELECT ops, ops_per_sec > 0, p50_us <= p90_us,\n"
+				    "       p90_us <= p99_us, p99_us <= max_us\n"
+				    "FROM orioledb_btree_bench("
+				    "'o_test', '%s', 5000, '%s', 10000);" % (op, dist))
+				self.assertEqual(result, [(5000, True, True, True, True)])
+
+		self.assertEqual(
+		    con.execute("SELECT ops FROM orioledb_btree_bench("
+		                "'o_test', 'lookup', 50000, 'uniform', 10000, 2);"),
+		    [(50000, )])
+
+		with self.assertRaises(DatabaseError) as e:
+			con.execute("SELECT * FROM orioledb_btree_bench("
+			            "'o_test', 'insert', 100, 'uniform', 100, 2);")
+		self.assertErrorMessageEquals(
+		    e, "insert benchmark can't use parallel workers")
+		con.rollback()
+
+		with self.assertRaises(DatabaseError) as e:
+			con.execute("SELECT * FROM orioledb_btree_bench("
+			            "'o_test_text', 'lookup', 100);")
+		self.assertErrorMessageEquals(
+		    e, '"o_test_text" must have the single int8 primary key column')
+		con.rollback()
+
+		con.close()
+		node.stop()
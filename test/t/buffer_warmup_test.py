@@ -0,0 +1,55 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+import re
+import time
+
+from .base_test import BaseTest
+
+
+class BufferWarmupTest(BaseTest):
+
+	def loaded_leaves(self):
+		with open(self.node.pg_log_file) as f:
+			return [
+			    int(n) for n in re.findall(
+			        r'orioledb warmup worker \d+ finished: (\d+) leaves loaded',
+			        f.read())
+			]
+
+	def test_buffer_warmup(self):
+		node = self.node
+		node.append_conf('postgresql.conf',
+		                 "orioledb.buffer_warmup_workers = 2\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int8 NOT NULL,\n"
+		    "	val text NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "CREATE INDEX o_test_val_idx ON o_test (val);\n"
+		    "INSERT INTO o_test (SELECT id, id::text FROM generate_series(1, 50000) id);\n"
+		)
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_test;")[0][0], 50000)
+
+		# The shutdown checkpoint saves the manifest
+		node.stop()
+		node.start()
+
+		for i in range(100):
+			loaded = self.loaded_leaves()
+			if len(loaded) == 2:
+				break
+			time.sleep(0.1)
+		self.assertEqual(len(loaded), 2)
+		self.assertGreater(sum(loaded), 0)
+
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_test WHERE val = '12345';")
+		    [0][0], 1)
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_test;")[0][0], 50000)
+		node.stop()
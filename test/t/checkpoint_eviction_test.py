@@ -65,6 +65,36 @@ class CheckpointEvictionTest(BaseTest):
 				n = n - 10
 			node.safe_psql("CHECKPOINT;")
 
+	def test_checkpoint_temp_table_eviction(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "orioledb.main_buffers = 8MB\n")
+		node.start()
+		node.safe_psql('postgres',
+		               "CREATE EXTENSION IF NOT EXISTS orioledb;\n")
+		con1 = node.connect()
+		con1.execute("CREATE TEMP TABLE o_temp (\n"
+		             "	key int NOT NULL,\n"
+		             "	val text NOT NULL,\n"
+		             "	PRIMARY KEY (key)\n"
+		             ") USING orioledb;\n")
+		for i in range(3):
+			con1.execute("INSERT INTO o_temp\n"
+			             "	(SELECT key + %d, repeat('x', 100)\n"
+			             "	 FROM generate_series(1, 30000) key);\n" %
+			             (i * 30000))
+			con1.commit()
+			# Dirty temporary pages are left in memory by the checkpoint
+			# and written out by the eviction instead
+			node.safe_psql("CHECKPOINT;")
+			con1.execute("UPDATE o_temp SET val = repeat('y', 100)\n"
+			              "WHERE key % 7 = 0;")
+			con1.commit()
+		self.assertEqual(
+		    con1.execute("SELECT count(*), count(*) FILTER (WHERE val LIKE 'y%')\n"
+		                 "FROM o_temp;"), [(90000, 12857)])
+		con1.close()
+		node.stop()
+
 	def concurrent_eviction_base(self, compressed, bp_value):
 		node = self.node
 		node.append_conf(
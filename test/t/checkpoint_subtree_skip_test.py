@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+from .base_test import BaseTest
+
+
+class CheckpointSubtreeSkipTest(BaseTest):
+
+	def create_table(self, node):
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				id int NOT NULL,
+				val text NOT NULL,
+				PRIMARY KEY (id)
+			) USING orioledb;
+			INSERT INTO o_test
+				(SELECT id * 10, repeat('x', 300)
+				 FROM generate_series(1, 100000) id);
+		""")
+
+	def test_checkpoint_subtree_skip_update(self):
+		node = self.node
+		node.start()
+		self.create_table(node)
+		node.safe_psql('postgres', "CHECKPOINT;")
+
+		node.safe_psql(
+		    'postgres', """
+			UPDATE o_test SET val = 'a' WHERE id BETWEEN 10000 AND 11000;
+		""")
+		node.safe_psql('postgres', "CHECKPOINT;")
+		node.safe_psql(
+		    'postgres', """
+			UPDATE o_test SET val = 'b' WHERE id BETWEEN 900000 AND 901000;
+		""")
+		node.safe_psql('postgres', "CHECKPOINT;")
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_test;")[0][0], 100000)
+		self.assertEqual(
+		    node.execute("""
+			SELECT val, count(*) FROM o_test
+			WHERE val IN ('a', 'b') GROUP BY val ORDER BY val;
+		"""), [('a', 101), ('b', 101)])
+		node.stop()
+
+	def test_checkpoint_subtree_skip_split(self):
+		node = self.node
+		node.start()
+		self.create_table(node)
+		node.safe_psql('postgres', "CHECKPOINT;")
+
+		# Split internal pages in the middle of the tree
+		node.safe_psql(
+		    'postgres', """
+			INSERT INTO o_test
+				(SELECT id * 10 + 5, repeat('y', 300)
+				 FROM generate_series(40000, 60000) id);
+		""")
+		node.safe_psql('postgres', "CHECKPOINT;")
+		node.safe_psql(
+		    'postgres', """
+			DELETE FROM o_test WHERE id % 10 = 5 AND id % 4 = 1;
+		""")
+		node.safe_psql('postgres', "CHECKPOINT;")
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_test WHERE id % 10 = 0;")[0][0],
+		    100000)
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_test WHERE id % 10 = 5;")[0][0],
+		    10000)
+		node.stop()
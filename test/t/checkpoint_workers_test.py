@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+from .base_test import BaseTest
+from .base_test import ThreadQueryExecutor
+
+
+class CheckpointWorkersTest(BaseTest):
+
+	def test_checkpoint_workers(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', """
+			orioledb.checkpoint_workers = 3
+			orioledb.main_buffers = 8MB
+		""")
+		node.start()
+		node.safe_psql('postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;")
+		for i in range(8):
+			node.safe_psql(
+			    'postgres', """
+				CREATE TABLE o_test_%d (
+					id int NOT NULL,
+					val text NOT NULL,
+					PRIMARY KEY (id)
+				) USING orioledb;
+				CREATE INDEX o_test_%d_val_idx ON o_test_%d (val);
+				INSERT INTO o_test_%d
+					(SELECT id, repeat('x', id %% 50) || id
+					 FROM generate_series(1, 10000) id);
+			""" % (i, i, i, i))
+		node.safe_psql('postgres', "CHECKPOINT;")
+
+		for i in range(8):
+			node.safe_psql(
+			    'postgres', """
+				UPDATE o_test_%d SET val = val || 'y' WHERE id %% 3 = 0;
+				DELETE FROM o_test_%d WHERE id %% 7 = 0;
+			""" % (i, i))
+		node.safe_psql('postgres', "CHECKPOINT;")
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		for i in range(8):
+			self.assertEqual(
+			    node.execute("SELECT count(*) FROM o_test_%d;" % i)[0][0],
+			    10000 - 1428)
+			self.assertEqual(
+			    node.execute("""
+				SET enable_seqscan = off;
+				SELECT count(*) FROM o_test_%d WHERE val LIKE '%%y';
+			""" % i)[0][0], 3333 - 476)
+		node.stop()
+
+	def test_checkpoint_workers_concurrent_splits(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', """
+			orioledb.checkpoint_workers = 3
+			orioledb.main_buffers = 8MB
+			checkpoint_timeout = 1h
+		""")
+		node.start()
+		node.safe_psql('postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;")
+		for i in range(4):
+			node.safe_psql(
+			    'postgres', """
+				CREATE TABLE o_test_%d (
+					id int NOT NULL,
+					val text NOT NULL,
+					PRIMARY KEY (id)
+				) USING orioledb;
+				CREATE INDEX o_test_%d_val_idx ON o_test_%d (val);
+				INSERT INTO o_test_%d
+					(SELECT id * 2, repeat('x', 100) || id
+					 FROM generate_series(1, 20000) id);
+			""" % (i, i, i, i))
+
+		# Inserts into the middle of the trees split the pages, which the
+		# helpers are writing, and evict the others
+		cons = [node.connect() for i in range(4)]
+		threads = [
+		    ThreadQueryExecutor(
+		        cons[i], """
+				INSERT INTO o_test_%d
+					(SELECT (id * 7919) %% 40000 * 2 + 1, repeat('y', 100) || id
+					 FROM generate_series(1, 20000) id);
+			""" % i) for i in range(4)
+		]
+		for t in threads:
+			t.start()
+		for j in range(3):
+			node.safe_psql('postgres', "CHECKPOINT;")
+		for i in range(4):
+			threads[i].join()
+			cons[i].commit()
+			cons[i].close()
+		node.safe_psql('postgres', "CHECKPOINT;")
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		for i in range(4):
+			self.assertEqual(
+			    node.execute("SELECT count(*) FROM o_test_%d;" % i)[0][0],
+			    40000)
+			self.assertTrue(
+			    node.execute(
+			        "SELECT orioledb_tbl_check('o_test_%d'::regclass, true)" %
+			        i)[0][0])
+		node.stop()
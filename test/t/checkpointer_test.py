@@ -8,6 +8,7 @@ import re
 import os
 
 from .base_test import BaseTest
+from .base_test import ThreadQueryExecutor
 from .base_test import wait_checkpointer_stopevent
 from .base_test import generate_string
 from testgres.enums import NodeStatus
@@ -99,6 +100,53 @@ class CheckpointerTest(BaseTest):
 		    10000)
 		node.stop()
 
+	def test_checkpoint_progress_view(self):
+		node = self.node
+		node.append_conf('postgresql.conf',
+		                 "orioledb.enable_stopevents = true\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				id int NOT NULL,
+				val text NOT NULL,
+				PRIMARY KEY (id)
+			) USING orioledb;
+			INSERT INTO o_test
+				(SELECT id, repeat('x', 100) FROM generate_series(1, 20000) id);
+		""")
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM orioledb_checkpoint_progress;")
+		    [0][0], 0)
+
+		con1 = node.connect()
+		con2 = node.connect()
+		con2.execute("SELECT pg_stopevent_set('checkpoint_step',\n"
+		             "'$.action == \"walkDownwards\" && "
+		             "$.treeName == \"o_test_pkey\"');")
+		t1 = ThreadQueryExecutor(con1, "CHECKPOINT;")
+		t1.start()
+		wait_checkpointer_stopevent(node)
+
+		self.assertEqual(
+		    con2.execute("""
+				SELECT checkpoint_number > 0,
+					   start_time <= clock_timestamp(),
+					   trees_done > 0,
+					   progress BETWEEN 0.0 AND 1.0
+				FROM orioledb_checkpoint_progress;
+			"""), [(True, True, True, True)])
+
+		con2.execute("SELECT pg_stopevent_reset('checkpoint_step')")
+		t1.join()
+		self.assertEqual(
+		    con2.execute("SELECT count(*) FROM orioledb_checkpoint_progress;")
+		    [0][0], 0)
+		con1.close()
+		con2.close()
+		node.stop()
+
 	def is_checkpoint_exist(self):
 		orioledb_dir = self.node.data_dir + "/orioledb_data"
 		exist = False
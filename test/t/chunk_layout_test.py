@@ -0,0 +1,50 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+import unittest
+
+from .base_test import BaseTest
+
+
+class ChunkLayoutTest(BaseTest):
+
+	def test_chunks_follow_access_mix(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int4 NOT NULL,\n"
+		    "	val int4 NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_test (SELECT id, 0 FROM generate_series(1, 20000, 2) id);\n"
+		)
+
+		# Write-heavy: many insertions into the same leaves
+		node.safe_psql(
+		    'postgres', "DO $$\n"
+		    "BEGIN\n"
+		    "	FOR i IN 1..20 LOOP\n"
+		    "		UPDATE o_test SET val = val + 1 WHERE id < 2000;\n"
+		    "	END LOOP;\n"
+		    "END $$;\n"
+		    "INSERT INTO o_test (SELECT id, 20 FROM generate_series(2, 2000, 2) id);\n"
+		)
+
+		# Read-heavy: many lookups in other leaves followed by a few inserts
+		node.execute(
+		    "SELECT count((SELECT val FROM o_test t WHERE t.id = g % 9000 + 10000))\n"
+		    "FROM generate_series(1, 50000) g;")
+		node.safe_psql(
+		    'postgres',
+		    "INSERT INTO o_test (SELECT id, 0 FROM generate_series(10002, 20000, 2) id);"
+		)
+
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(val) FROM o_test;")[0],
+		    (16000, 40000))
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_test'::regclass)")[0]
+		    [0])
+		node.stop()
@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+from .base_test import BaseTest
+
+
+class CountPushdownTest(BaseTest):
+
+	def test_count_pushdown(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int8 NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_test (SELECT id, 'value ' || id\n"
+		    "	FROM generate_series(1, 10000) id);\n")
+
+		con1 = node.connect()
+		con1.execute("BEGIN TRANSACTION ISOLATION LEVEL REPEATABLE READ;")
+		con1.execute("SET orioledb.enable_count_pushdown = on;")
+		plan = '\n'.join(
+		    r[0] for r in con1.execute(
+		        "EXPLAIN (COSTS OFF) SELECT count(*), count(*) FROM o_test;"))
+		self.assertIn("o_count_scan", plan)
+		self.assertIn("o_test", plan)
+
+		# Quals and other aggregates aren't pushed down
+		plan = '\n'.join(
+		    r[0] for r in con1.execute(
+		        "EXPLAIN (COSTS OFF) SELECT count(*) FROM o_test "
+		        "WHERE id > 10;"))
+		self.assertNotIn("o_count_scan", plan)
+		plan = '\n'.join(
+		    r[0] for r in con1.execute(
+		        "EXPLAIN (COSTS OFF) SELECT count(val) FROM o_test;"))
+		self.assertNotIn("o_count_scan", plan)
+
+		self.assertEqual(
+		    con1.execute("SELECT count(*), count(*) FROM o_test;"),
+		    [(10000, 10000)])
+
+		# Concurrent changes are invisible to the snapshot
+		node.safe_psql('postgres', "DELETE FROM o_test WHERE id <= 1000;\n")
+		con2 = node.connect()
+		con2.execute("INSERT INTO o_test VALUES (20000, 'uncommitted');")
+		self.assertEqual(con1.execute("SELECT count(*) FROM o_test;"),
+		                 [(10000, )])
+		con1.commit()
+
+		self.assertEqual(con1.execute("SELECT count(*) FROM o_test;"),
+		                 [(9000, )])
+		con2.commit()
+		self.assertEqual(con1.execute("SELECT count(*) FROM o_test;"),
+		                 [(9001, )])
+		con1.close()
+		con2.close()
+		node.stop()
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+import time
+
+from .base_test import BaseTest
+
+
+class DeferredRollbackTest(BaseTest):
+
+	def waitRollbacks(self, node):
+		for _ in range(100):
+			deferred, completed = node.execute(
+			    "SELECT * FROM orioledb_deferred_rollback_stats();")[0]
+			if completed == deferred:
+				return deferred
+			time.sleep(0.1)
+		self.fail("deferred rollback isn't completed")
+
+	def test_deferred_rollback(self):
+		node = self.node
+		node.append_conf('postgresql.conf',
+		                 "orioledb.deferred_rollback_threshold = 0\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int NOT NULL,\n"
+		    "	val int NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "CREATE INDEX o_test_val_idx ON o_test (val);\n"
+		    "INSERT INTO o_test\n"
+		    "	(SELECT id, id FROM generate_series(1, 10000) id);\n")
+
+		con1 = node.connect()
+		con1.begin()
+		con1.execute("UPDATE o_test SET val = val + 1 WHERE id % 2 = 0;")
+		con1.execute("DELETE FROM o_test WHERE id % 3 = 0;")
+		con1.execute(
+		    "INSERT INTO o_test (SELECT id, id FROM generate_series(10001, 20000) id);"
+		)
+		con1.rollback()
+
+		# The rolled back rows are either undone or skipped by the readers
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(val) FROM o_test;")[0],
+		    (10000, 50005000))
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_test WHERE val > 10000;")[0]
+		    [0], 0)
+
+		# Writers undo the aborted changes they meet themselves
+		con1.execute("UPDATE o_test SET val = val + 1 WHERE id = 6;")
+		con1.execute("INSERT INTO o_test VALUES (10001, 10001);")
+		con1.commit()
+
+		self.assertGreater(self.waitRollbacks(node), 0)
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(val) FROM o_test;")[0],
+		    (10001, 50005000 + 1 + 10001))
+		self.assertEqual(
+		    node.execute("SELECT val FROM o_test WHERE id = 6;")[0][0], 7)
+		con1.close()
+
+		node.safe_psql('postgres', "CHECKPOINT;")
+		node.stop(['-m', 'immediate'])
+		node.start()
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(val) FROM o_test;")[0],
+		    (10001, 50005000 + 1 + 10001))
+		node.stop()
+
+	def test_deferred_rollback_crash(self):
+		node = self.node
+		node.append_conf('postgresql.conf',
+		                 "orioledb.deferred_rollback_threshold = 0\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int NOT NULL,\n"
+		    "	val int NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_test\n"
+		    "	(SELECT id, id FROM generate_series(1, 10000) id);\n")
+
+		con1 = node.connect()
+		con1.begin()
+		con1.execute("UPDATE o_test SET val = 0;")
+		con1.rollback()
+		con1.close()
+
+		# Crash regardless the rollback worker is done or not
+		node.safe_psql('postgres', "CHECKPOINT;")
+		node.stop(['-m', 'immediate'])
+		node.start()
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(val) FROM o_test;")[0],
+		    (10000, 50005000))
+		node.stop()
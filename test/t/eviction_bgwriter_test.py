@@ -34,6 +34,38 @@ class EvictionBGWriterTest(BaseTest):
 		    node.execute("SELECT COUNT(*) FROM o_eviction;")[0][0], 200000)
 		node.stop()
 
+	def test_eviction_partitioned_bgwriters(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.bgwriter_num_workers = 4\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_eviction (\n"
+		    "	key integer NOT NULL,\n"
+		    "	val integer NOT NULL,\n"
+		    "	PRIMARY KEY(key)\n"
+		    ") USING orioledb;\n\n")
+		n = 200000
+		node.safe_psql(
+		    'postgres', "INSERT INTO o_eviction\n"
+		    "	(SELECT id, %s - id FROM generate_series(%s, %s, 1) id);\n"
+		    "UPDATE o_eviction SET val = val + 1 WHERE key %% 3 = 0;\n" %
+		    (str(n), str(1), str(n)))
+		self.assertEqual(
+		    node.execute("SELECT COUNT(*) FROM o_eviction "
+		                 "WHERE val = %d - key + (key %% 3 = 0)::int;" %
+		                 n)[0][0], n)
+		node.stop()
+
+		node.start()
+		self.assertEqual(
+		    node.execute("SELECT COUNT(*) FROM o_eviction "
+		                 "WHERE val = %d - key + (key %% 3 = 0)::int;" %
+		                 n)[0][0], n)
+		node.stop()
+
 	def test_eviction_bgwriter_invalidation(self):
 		node = self.node
 		node.append_conf('postgresql.conf', "orioledb.main_buffers = 8MB\n")
@@ -62,6 +94,53 @@ class EvictionBGWriterTest(BaseTest):
 
 		node.stop()
 
+	def eviction_queue_base(self, queue_size):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.bgwriter_num_workers = 2\n"
+		    "orioledb.bgwriter_eviction_queue_size = %d\n" % queue_size)
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_eviction (
+				key integer NOT NULL,
+				val text NOT NULL,
+				PRIMARY KEY(key)
+			) USING orioledb WITH (primary_compress);
+			""")
+		n = 100000
+		node.safe_psql(
+		    'postgres', """
+			INSERT INTO o_eviction
+				(SELECT id, repeat('x', id %% 50) FROM generate_series(1, %d) id);
+			UPDATE o_eviction SET val = val || 'y' WHERE key %% 3 = 0;
+			""" % n)
+
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_eviction WHERE "
+		                 "val LIKE '%y';")[0][0], n // 3)
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_eviction'::regclass)")
+		    [0][0])
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_eviction WHERE "
+		                 "val = repeat('x', key % 50) || 'y';")[0][0], n // 3)
+		node.stop()
+
+	def test_eviction_queue(self):
+		self.eviction_queue_base(1024)
+
+	def test_eviction_small_queue(self):
+		self.eviction_queue_base(4)
+
+	def test_eviction_no_queue(self):
+		self.eviction_queue_base(0)
+
 
 if __name__ == "__main__":
 	unittest.main()
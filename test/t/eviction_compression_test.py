@@ -169,6 +169,189 @@ class EvictionCompressionTest(BaseTest):
 		con.close()
 		node.stop()
 
+	def eviction_compress_reuse_extents_base(self, cache_size):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.free_extents_cache_size = %d\n" % cache_size)
+		node.start()
+		n = 50000
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				key integer NOT NULL,
+				val text NOT NULL,
+				PRIMARY KEY (key)
+			) USING orioledb WITH (primary_compress);
+			INSERT INTO o_test
+				(SELECT id, repeat('x', id %% 100) FROM generate_series(1, %d) id);
+			CHECKPOINT;
+			""" % n)
+
+		# Rewritten pages get images of different sizes reusing freed extents
+		for i in range(1, 4):
+			node.safe_psql(
+			    'postgres', """
+				UPDATE o_test SET val = repeat('y', (key + %d) %% 100) || md5(key::text)
+					WHERE key %% 3 = %d %% 3;
+				CHECKPOINT;
+				""" % (i, i))
+
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_test;")[0][0], n)
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_test'::regclass)")[0][0])
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_test WHERE key % 3 = 1 AND "
+		                 "val = repeat('y', (key + 1) % 100) || md5(key::text);")
+		    [0][0], n // 3 + 1)
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_test'::regclass)")[0][0])
+		node.stop()
+
+	def test_eviction_compress_reuse_extents(self):
+		self.eviction_compress_reuse_extents_base(1024)
+
+	def test_eviction_compress_reuse_extents_no_cache(self):
+		self.eviction_compress_reuse_extents_base(0)
+
+	def test_eviction_compress_lz4(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "orioledb.main_buffers = 8MB\n")
+		node.start()
+		if not node.execute("SELECT setting LIKE '%--with-lz4%' FROM pg_config "
+		                    "WHERE name = 'CONFIGURE';")[0][0]:
+			node.stop()
+			self.skipTest("PostgreSQL is built without LZ4")
+		n = 100000
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				key integer NOT NULL,
+				val integer NOT NULL,
+				str text NOT NULL,
+				PRIMARY KEY (key)
+			) USING orioledb WITH (primary_compress = 'lz4',
+								   toast_compress = 'lz4hc:12');
+			CREATE UNIQUE INDEX o_test_ix1 ON o_test (val)
+				WITH (compress = 'lz4hc');
+			INSERT INTO o_test
+				(SELECT id, %d - id, repeat(md5(id::text), id %% 200)
+				 FROM generate_series(1, %d) id);
+			CHECKPOINT;
+			""" % (n, n))
+		self.assertIn(
+		    "compression = lz4hc:9",
+		    node.execute("SELECT orioledb_tbl_indices('o_test'::regclass);")
+		    [0][0])
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_test WHERE val = %d - key AND "
+		                 "str = repeat(md5(key::text), key %% 200);" % n)[0][0],
+		    n)
+		self.assertEqual(
+		    node.execute("SELECT sum(key) FROM o_test WHERE val > 0;")[0][0],
+		    n * (n - 1) // 2)
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_test'::regclass)")[0][0])
+		node.stop()
+
+	def test_eviction_compress_hot_pages(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.hot_pages_compress = 1\n")
+		node.start()
+		n = 100000
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				key integer NOT NULL,
+				val integer NOT NULL,
+				str text NOT NULL,
+				PRIMARY KEY (key)
+			) USING orioledb WITH (compress = 15);
+			INSERT INTO o_test
+				(SELECT id, %d - id, repeat(md5(id::text), id %% 200)
+				 FROM generate_series(1, %d) id);
+			CHECKPOINT;
+			UPDATE o_test SET val = val + 1 WHERE key %% 10 = 0;
+			CHECKPOINT;
+			""" % (n, n))
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_test WHERE "
+		                 "val = %d - key + (key %% 10 = 0)::int AND "
+		                 "str = repeat(md5(key::text), key %% 200);" % n)[0][0],
+		    n)
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_test'::regclass)")[0][0])
+		node.stop()
+
+	def test_eviction_compress_dictionary(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "orioledb.main_buffers = 8MB\n")
+		node.start()
+		n = 50000
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				key integer NOT NULL,
+				val text NOT NULL,
+				PRIMARY KEY (key)
+			) USING orioledb WITH (primary_compress);
+			INSERT INTO o_test
+				(SELECT id, 'status=active;region=' || (id %% 7) ||
+							';owner=' || md5((id %% 13)::text)
+				 FROM generate_series(1, %d) id);
+			CHECKPOINT;
+			""" % n)
+
+		self.assertEqual(
+		    node.execute("SELECT orioledb_tree_train_dictionary("
+		                 "'o_test'::regclass, 100, 4096);")[0][0], 1)
+
+		# Half of pages get rewritten with the dictionary
+		node.safe_psql(
+		    'postgres', """
+			UPDATE o_test SET val = val || ';updated' WHERE key % 2 = 0;
+			CHECKPOINT;
+			""")
+		self.assertEqual(
+		    node.execute("SELECT orioledb_tree_train_dictionary("
+		                 "'o_test'::regclass, 100, 4096);")[0][0], 2)
+		node.safe_psql(
+		    'postgres', """
+			UPDATE o_test SET val = val || ';twice' WHERE key % 4 = 0;
+			""")
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_test WHERE val LIKE "
+		                 "'status=active;%';")[0][0], n)
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_test WHERE val LIKE "
+		                 "'%;updated;twice';")[0][0], n // 4)
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_test'::regclass)")[0][0])
+		self.assertEqual(
+		    node.execute("SELECT orioledb_tree_train_dictionary("
+		                 "'o_test'::regclass, 100, 4096);")[0][0], 3)
+		node.safe_psql('postgres', "DROP TABLE o_test;")
+		node.stop()
+
 
 if __name__ == "__main__":
 	unittest.main()
@@ -1,6 +1,7 @@
 #!/usr/bin/env python3
 # coding: utf-8
 
+import os
 import unittest
 
 from .base_test import BaseTest
@@ -508,3 +509,199 @@ class EvictionTest(BaseTest):
 		self.assertTrue(
 		    node.execute("SELECT orioledb_tbl_check('o_evicted'::regclass)")[0]
 		    [0])
+
+	def test_eviction_buffers_dedicated_segment(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.buffers_huge_pages = try\n"
+		    "orioledb.buffers_prefault = on\n")
+		node.start()
+		self.assertGreater(
+		    int(
+		        node.execute(
+		            "SELECT setting FROM pg_settings "
+		            "WHERE name = 'orioledb.buffers_page_size';")[0][0]), 0)
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_evicted (\n"
+		    "	id integer NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_evicted\n"
+		    "	(SELECT id, repeat('x', 100) FROM generate_series(1, 100000) id);\n"
+		)
+		self.assertEqual(
+		    node.execute("SELECT COUNT(*) FROM o_evicted;")[0][0], 100000)
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		self.assertEqual(
+		    node.execute("SELECT COUNT(*) FROM o_evicted;")[0][0], 100000)
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_evicted'::regclass)")[0]
+		    [0])
+		node.stop()
+
+	def test_eviction_main_buffers_limit(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 16MB\n"
+		    "orioledb.main_buffers_limit = 8MB\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_evicted (\n"
+		    "	id integer NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_evicted\n"
+		    "	(SELECT id, repeat('x', 100) FROM generate_series(1, 100000) id);\n"
+		)
+		self.assertEqual(
+		    node.execute("SELECT COUNT(*) FROM o_evicted;")[0][0], 100000)
+
+		node.safe_psql(
+		    'postgres', "ALTER SYSTEM SET orioledb.main_buffers_limit = 0;\n"
+		    "SELECT pg_reload_conf();\n")
+		node.safe_psql(
+		    'postgres', "INSERT INTO o_evicted\n"
+		    "	(SELECT id, repeat('y', 100) FROM generate_series(100001, 150000) id);\n"
+		)
+		node.safe_psql(
+		    'postgres', "ALTER SYSTEM SET orioledb.main_buffers_limit = '4MB';\n"
+		    "SELECT pg_reload_conf();\n")
+		self.assertEqual(
+		    node.execute("SELECT COUNT(*) FROM o_evicted;")[0][0], 150000)
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_evicted'::regclass)")[0]
+		    [0])
+		node.stop()
+
+	def test_eviction_direct_io(self):
+		node = self.node
+		path = os.path.join(node.data_dir, 'o_direct_io_check')
+		try:
+			fd = os.open(path, os.O_RDWR | os.O_CREAT | os.O_DIRECT)
+			os.close(fd)
+		except (OSError, AttributeError):
+			self.skipTest("O_DIRECT is not supported")
+		finally:
+			if os.path.exists(path):
+				os.unlink(path)
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.direct_io = on\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_evicted (\n"
+		    "	id integer NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_evicted\n"
+		    "	(SELECT id, repeat('x', 100) FROM generate_series(1, 100000) id);\n"
+		    "CHECKPOINT;\n"
+		    "UPDATE o_evicted SET val = repeat('y', 100) WHERE id % 2 = 0;\n")
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		self.assertEqual(
+		    node.execute("SELECT COUNT(*) FROM o_evicted WHERE val = "
+		                 "repeat(CASE WHEN id % 2 = 0 THEN 'y' ELSE 'x' END, 100);")
+		    [0][0], 100000)
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_evicted'::regclass)")[0]
+		    [0])
+		node.stop()
+
+	def test_eviction_data_file_prealloc(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.data_file_prealloc_size = 1MB\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_evicted (\n"
+		    "	id integer NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_evicted\n"
+		    "	(SELECT id, repeat('x', 100) FROM generate_series(1, 100000) id);\n"
+		    "CHECKPOINT;\n")
+		node.stop()
+
+		node.start()
+		self.assertEqual(
+		    node.execute("SELECT COUNT(*) FROM o_evicted WHERE val = "
+		                 "repeat('x', 100);")[0][0], 100000)
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_evicted'::regclass)")[0]
+		    [0])
+		node.stop()
+
+	def test_eviction_io_classes(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.max_io_concurrency = 4\n"
+		    "orioledb.background_io_concurrency = 1\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_evicted (\n"
+		    "	id integer NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_evicted\n"
+		    "	(SELECT id, repeat('x', 100) FROM generate_series(1, 100000) id);\n"
+		    "CHECKPOINT;\n")
+		self.assertEqual(
+		    node.execute("SELECT COUNT(*) FROM o_evicted;")[0][0], 100000)
+
+		stats = {
+		    row[0]: row[1:]
+		    for row in node.execute(
+		        "SELECT io_class, concurrency, in_progress, waiting, ops "
+		        "FROM orioledb_io_stats();")
+		}
+		self.assertEqual(stats['foreground read'][0], 4)
+		self.assertEqual(stats['eviction write'][0], 1)
+		self.assertEqual(stats['checkpoint'][0], 1)
+		self.assertGreater(stats['foreground read'][3], 0)
+		self.assertGreater(stats['checkpoint'][3], 0)
+
+		node.safe_psql('postgres', "SELECT orioledb_io_stats_reset();")
+		self.assertEqual(
+		    node.execute("SELECT ops FROM orioledb_io_stats() "
+		                 "WHERE io_class = 'foreground read';")[0][0], 0)
+		node.stop()
+
+	def test_eviction_page_pool_stats(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "orioledb.main_buffers = 8MB\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_evicted (\n"
+		    "	id integer NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_evicted\n"
+		    "	(SELECT id, repeat('x', 100) FROM generate_series(1, 100000) id);\n"
+		)
+		stats = node.execute(
+		    "SELECT gets > 0, clock_runs > 0, "
+		    "clock_iterations >= clock_runs, "
+		    "backend_evictions + bgwriter_evictions + queued_evicted > 0, "
+		    "free_pages >= 0 "
+		    "FROM orioledb_page_pool_stats() WHERE pool_name = 'main';")
+		self.assertEqual(stats, [(True, True, True, True, True)])
+		node.stop()
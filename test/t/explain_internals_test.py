@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+import re
+
+from .base_test import BaseTest
+
+
+class ExplainInternalsTest(BaseTest):
+
+	def explainCounters(self, con, query, verbose):
+		options = "ANALYZE, COSTS OFF, TIMING OFF"
+		if verbose:
+			options += ", VERBOSE"
+		plan = con.execute("EXPLAIN (%s) %s" % (options, query))
+		for row in plan:
+			match = re.search(r"Primary pages: (.*)$", row[0])
+			if match:
+				return dict(
+				    (name, int(value))
+				    for name, value in re.findall(r"(\w+)=(\d+)",
+				                                  match.group(1)))
+		return {}
+
+	def test_explain_internals(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int8 NOT NULL,\n"
+		    "	val text NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb WITH (primary_compress);\n"
+		    "INSERT INTO o_test\n"
+		    "	(SELECT id, id || repeat('x', 100)\n"
+		    "	 FROM generate_series(1, 10000) id);\n")
+
+		con1 = node.connect()
+		con2 = node.connect()
+		con1.execute("SET enable_seqscan = off;")
+		con1.begin()
+		con1.execute("SET TRANSACTION ISOLATION LEVEL REPEATABLE READ;")
+		con1.execute("SELECT 1;")
+		con2.execute("UPDATE o_test SET val = val || 'y' WHERE id = 5000;")
+		con2.commit()
+		node.safe_psql(
+		    'postgres', "CHECKPOINT;\n"
+		    "SELECT orioledb_evict_pages('o_test'::regclass, 0);\n")
+
+		query = "SELECT * FROM o_test WHERE id = 5000"
+		counters = self.explainCounters(con1, query, True)
+		self.assertGreater(counters.get('descent', 0), 0)
+		self.assertGreater(counters.get('load', 0), 0)
+		self.assertGreater(counters.get('decompressed', 0), 0)
+		self.assertGreater(counters.get('undo', 0), 0)
+
+		counters = self.explainCounters(con1, query, False)
+		self.assertNotIn('descent', counters)
+		self.assertNotIn('undo', counters)
+		con1.commit()
+
+		con1.close()
+		con2.close()
+		node.stop()
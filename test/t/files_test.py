@@ -142,6 +142,58 @@ class FilesTest(BaseTest):
 	def test_seq_scan_compressed(self):
 		self.seq_scan_base(True)
 
+	def test_tree_defragment(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				key int NOT NULL PRIMARY KEY,
+				value text NOT NULL
+			) USING orioledb;
+			INSERT INTO o_test
+				(SELECT i, repeat('x', 100) FROM generate_series(1, 50000) i);
+			CHECKPOINT;
+			DELETE FROM o_test WHERE key <= 40000;
+			CHECKPOINT;
+			CHECKPOINT;
+			""")
+
+		self.assertEqual(
+		    node.execute(
+		        "SELECT datafile_size > 0, free_size <= datafile_size,\n"
+		        "       (free_extents > 0) = (free_size > 0),\n"
+		        "       max_free_extent <= free_size\n"
+		        "FROM orioledb_tree_space('o_test'::regclass);"),
+		    [(True, True, True, True)])
+
+		marked = node.execute(
+		    "SELECT orioledb_tree_defragment('o_test'::regclass, 100, 0);"
+		)[0][0]
+		self.assertGreaterEqual(marked, 0)
+		self.assertLessEqual(marked, 100)
+		marked = node.execute(
+		    "SELECT orioledb_tree_defragment('o_test_pkey'::regclass);")[0][0]
+		self.assertGreaterEqual(marked, 0)
+
+		node.safe_psql('postgres', "CHECKPOINT;\nCHECKPOINT;")
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_test;")[0][0], 10000)
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_test'::regclass, TRUE);")
+		    [0][0])
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		self.assertEqual(
+		    node.execute("SELECT min(key), max(key), count(*) FROM o_test;")[0],
+		    (40001, 50000, 10000))
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_test'::regclass, TRUE);")
+		    [0][0])
+		node.stop()
+
 	def test_check_if_tmp_not_exist(self):
 		node = self.node
 		node.start()  # start PostgreSQL
@@ -384,6 +436,41 @@ class FilesTest(BaseTest):
 		self.assertFalse(bool(re.match(r".*evt", all_files)))
 		self.assertFalse(bool(re.match(r"[0-9]*_[0-9]*_[0-9]*", all_files)))
 
+	def test_drop_table_async_cleanup(self):
+		node = self.node
+		node.append_conf('postgresql.conf',
+		                 "orioledb.async_file_cleanup = on\n")
+		node.start()  # start PostgreSQL
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE IF NOT EXISTS o_test (\n"
+		    "	id integer NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "CREATE INDEX o_test_val_idx ON o_test (val);\n"
+		    "INSERT INTO o_test\n"
+		    "	(SELECT id, id || 'val' FROM generate_series(1, 1000, 1) id);\n"
+		    "CHECKPOINT;\n")
+		datoid = node.execute(
+		    "SELECT oid FROM pg_database WHERE datname = current_database()"
+		)[0][0]
+		relnodes = [
+		    r[0] for r in node.execute(
+		        "SELECT relfilenode FROM pg_class\n"
+		        "WHERE relname IN ('o_test_pkey', 'o_test_val_idx');")
+		]
+		orioledb_dir = f"{node.data_dir}/orioledb_data/{datoid}"
+		for relnode in relnodes:
+			self.assertTrue(os.path.exists(f"{orioledb_dir}/{relnode}"))
+
+		# The files are unlinked in background, but not later than checkpoint
+		node.safe_psql('postgres', "DROP TABLE o_test;\n"
+		               "CHECKPOINT;\n")
+		for relnode in relnodes:
+			self.assertEqual(glob.glob(f"{orioledb_dir}/{relnode}*"), [])
+		node.stop()
+
 	def test_drop_extension_cleanup(self):
 		node = self.node
 		node.start()  # start PostgreSQL
@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+import unittest
+from threading import Thread
+
+from .base_test import BaseTest
+
+
+class GroupCommitTest(BaseTest):
+
+	def test_group_commit(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "orioledb.commit_delay = 1000\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int8 NOT NULL,\n"
+		    "	val int8 NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "SELECT orioledb_wal_group_commit_stats_reset();\n")
+
+		def committer(n):
+			con = node.connect()
+			for i in range(100):
+				con.execute("INSERT INTO o_test VALUES (%d, %d);" %
+				            (n * 1000 + i, i))
+				con.commit()
+			con.close()
+
+		threads = [Thread(target=committer, args=(n, )) for n in range(4)]
+		for t in threads:
+			t.start()
+		for t in threads:
+			t.join()
+
+		stats = node.execute(
+		    "SELECT groups > 0, commits = 400, groups <= commits, "
+		    "avg_group_size >= 1, wait_time > 0 "
+		    "FROM orioledb_wal_group_commit_stats();")
+		self.assertEqual(stats, [(True, True, True, True, True)])
+
+		# Committed data survives the crash
+		node.stop(['-m', 'immediate'])
+		node.start()
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(val) FROM o_test;"),
+		    [(400, 4 * 4950)])
+
+		node.safe_psql('postgres',
+		               "SELECT orioledb_wal_group_commit_stats_reset();")
+		self.assertEqual(
+		    node.execute(
+		        "SELECT groups, commits FROM orioledb_wal_group_commit_stats();"
+		    ), [(0, 0)])
+		node.stop()
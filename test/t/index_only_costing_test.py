@@ -0,0 +1,49 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+from .base_test import BaseTest
+
+
+class IndexOnlyCostingTest(BaseTest):
+
+	def test_index_only_costing(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int NOT NULL,\n"
+		    "	val int NOT NULL,\n"
+		    "	payload text NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "CREATE INDEX o_test_val_idx ON o_test (val) INCLUDE (payload);\n"
+		    "INSERT INTO o_test\n"
+		    "	(SELECT id, id % 1000, repeat('x', 50) FROM generate_series(1, 100000) id);\n"
+		    "ANALYZE o_test;\n")
+
+		query = "SELECT id, val, payload FROM o_test WHERE val < 10"
+		con = node.connect()
+		con.execute("SET orioledb.enable_index_only_costing = on;")
+		self.assertIn(
+		    "Index Only Scan",
+		    con.execute("EXPLAIN (COSTS OFF) " + query)[0][0])
+		self.assertEqual(
+		    con.execute(
+		        "SELECT count(*), sum(id), sum(val) FROM (%s) s;" % query)[0],
+		    (1000, sum(i for i in range(1, 100001) if i % 1000 < 10),
+		     sum(i % 1000 for i in range(1, 100001) if i % 1000 < 10)))
+
+		# Rows modified after the index scan started stay invisible
+		con.begin()
+		con.execute("SET TRANSACTION ISOLATION LEVEL REPEATABLE READ;")
+		self.assertEqual(
+		    con.execute("SELECT count(*) FROM (%s) s;" % query)[0][0], 1000)
+		node.safe_psql('postgres', "DELETE FROM o_test WHERE val < 5;")
+		self.assertEqual(
+		    con.execute("SELECT count(*) FROM (%s) s;" % query)[0][0], 1000)
+		con.commit()
+		self.assertEqual(
+		    con.execute("SELECT count(*) FROM (%s) s;" % query)[0][0], 500)
+		con.close()
+		node.stop()
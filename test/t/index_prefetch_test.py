@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+from .base_test import BaseTest
+
+
+class IndexPrefetchTest(BaseTest):
+
+	def test_index_prefetch_evicted(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.enable_index_prefetch = on\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int4 NOT NULL,\n"
+		    "	a int4 NOT NULL,\n"
+		    "	b text NOT NULL,\n"
+		    "	c int4 NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "CREATE INDEX o_test_a_idx ON o_test (a);\n"
+		    "CREATE INDEX o_test_b_idx ON o_test (b);\n"
+		    "CREATE INDEX o_test_c_idx ON o_test (lower(b), c);\n"
+		    "CREATE INDEX o_test_part_idx ON o_test (c) WHERE c % 2 = 0;\n"
+		    "CREATE TABLE o_evict (\n"
+		    "	id int4 NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n")
+		insert = "INSERT INTO o_test (SELECT id, (id * 37) %% 100000, " \
+		         "md5(id::text), id FROM generate_series(%d, %d) id);"
+		evict = "INSERT INTO o_evict (SELECT id, repeat('x', 200) FROM generate_series(%d, %d) id);"
+		check = "SELECT count(*) FROM o_test WHERE %s;"
+
+		node.safe_psql('postgres', insert % (1, 50000))
+		node.safe_psql('postgres', "CHECKPOINT;")
+		node.safe_psql('postgres', evict % (1, 100000))
+
+		# Inserts and key-changing updates over the evicted secondary leaves
+		node.safe_psql('postgres', insert % (50001, 60000))
+		node.safe_psql(
+		    'postgres', "UPDATE o_test SET a = a + 1, c = c + 1 "
+		    "WHERE id % 10 = 0;\n"
+		    "UPDATE o_test SET b = b || 'x' WHERE id % 10 = 1;\n"
+		    "UPDATE o_test SET id = id + 100000 WHERE id % 10 = 2;\n")
+		node.safe_psql('postgres', evict % (100001, 200000))
+
+		for cond in ["a >= 0", "b > ''", "lower(b) > ''", "c % 2 = 0"]:
+			seq = node.execute(
+			    "SET enable_indexscan = off;\n"
+			    "SET enable_bitmapscan = off;\n" + (check % cond))[0][0]
+			idx = node.execute(
+			    "SET enable_seqscan = off;\n"
+			    "SET enable_bitmapscan = off;\n" + (check % cond))[0][0]
+			self.assertEqual(seq, idx)
+		self.assertEqual(node.execute(check % "b LIKE '%x'")[0][0], 6000)
+		self.assertEqual(node.execute(check % "id > 100000")[0][0], 6000)
+		node.stop()
@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+from .base_test import BaseTest
+
+
+class InlineCompressTest(BaseTest):
+
+	def test_inline_compress(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int NOT NULL,\n"
+		    "	doc text NOT NULL,\n"
+		    "	ext text STORAGE EXTERNAL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "CREATE INDEX o_test_doc_idx ON o_test (substr(doc, 1, 10));\n")
+
+		con = node.connect()
+		con.execute(
+		    "INSERT INTO o_test VALUES (1, repeat('abcd', 400), repeat('abcd', 400));"
+		)
+		con.execute("SET orioledb.inline_compress_threshold = 1024;")
+		con.execute(
+		    "INSERT INTO o_test VALUES (2, repeat('abcd', 400), repeat('abcd', 400)),\n"
+		    "	(3, repeat('abcd', 100), NULL);")
+		con.execute(
+		    "UPDATE o_test SET doc = doc || 'x' WHERE id = 1;")
+		con.commit()
+
+		self.assertEqual(
+		    con.execute(
+		        "SELECT id, pg_column_compression(doc), pg_column_compression(ext)\n"
+		        "	FROM o_test ORDER BY id;"),
+		    [(1, 'pglz', None), (2, 'pglz', None), (3, None, None)])
+		self.assertEqual(
+		    con.execute("SELECT id, length(doc), md5(doc) = md5(repeat('abcd', 400))\n"
+		                "	FROM o_test ORDER BY id;"),
+		    [(1, 1601, False), (2, 1600, True), (3, 400, False)])
+		self.assertEqual(
+		    con.execute(
+		        "SELECT id FROM o_test WHERE substr(doc, 1, 10) = 'abcdabcdab' ORDER BY id;"
+		    ), [(1, ), (2, ), (3, )])
+		con.close()
+		node.stop()
+
+	def test_inline_compress_indexed(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int NOT NULL,\n"
+		    "	doc text NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "CREATE INDEX o_test_doc_idx ON o_test (doc);\n")
+
+		con = node.connect()
+		con.execute("SET orioledb.inline_compress_threshold = 1024;")
+		con.execute(
+		    "INSERT INTO o_test (SELECT id, id::text || repeat('abcd', 400)\n"
+		    "	FROM generate_series(1, 20) id);")
+		con.execute("UPDATE o_test SET doc = doc || 'x' WHERE id % 2 = 0;")
+		con.commit()
+
+		# Indexed values aren't compressed, so their keys match the lookups
+		self.assertEqual(
+		    con.execute(
+		        "SELECT count(*) FROM o_test WHERE pg_column_compression(doc) IS NOT NULL;"
+		    )[0][0], 0)
+		con.execute("SET enable_seqscan = off;")
+		con.execute("SET enable_bitmapscan = off;")
+		self.assertEqual(
+		    con.execute(
+		        "SELECT id FROM o_test WHERE doc = '7' || repeat('abcd', 400);"
+		    ), [(7, )])
+		self.assertEqual(
+		    con.execute(
+		        "SELECT id FROM o_test WHERE doc = '8' || repeat('abcd', 400) || 'x';"
+		    ), [(8, )])
+		self.assertEqual(
+		    con.execute(
+		        "SELECT count(*) FROM o_test WHERE doc > '2' AND doc < '3';"
+		    )[0][0], 2)
+		self.assertTrue(
+		    con.execute("SELECT orioledb_tbl_check('o_test'::regclass, true)")
+		    [0][0])
+		con.close()
+		node.stop()
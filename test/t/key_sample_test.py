@@ -0,0 +1,50 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+from .base_test import BaseTest
+
+
+class KeySampleTest(BaseTest):
+
+	def test_key_sample(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "orioledb.key_sample_rate = 1\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int NOT NULL,\n"
+		    "	val int NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_test\n"
+		    "	(SELECT id, id FROM generate_series(1, 10000) id);\n"
+		    "SELECT orioledb_key_sample_reset();\n")
+
+		con1 = node.connect()
+		for _ in range(200):
+			con1.execute("SELECT val FROM o_test WHERE id = 42;")
+		for i in range(1, 101):
+			con1.execute("SELECT val FROM o_test WHERE id = %d;" % (i * 97))
+		con1.execute("UPDATE o_test SET val = val + 1 WHERE id = 42;")
+		con1.commit()
+		con1.close()
+
+		top = node.execute(
+		    "SELECT key->>'id', samples FROM orioledb_key_sample_top('o_test');"
+		)
+		self.assertEqual(top[0][0], '42')
+		self.assertGreaterEqual(top[0][1], 201)
+		self.assertLess(top[1][1], top[0][1])
+
+		# The reservoir is full, so the histogram spreads all its samples
+		self.assertEqual(
+		    node.execute(
+		        "SELECT sum(samples), count(*) FILTER (WHERE low_key IS NULL) "
+		        "FROM orioledb_key_sample_histogram('o_test');")[0], (256, 1))
+
+		node.safe_psql('postgres', "SELECT orioledb_key_sample_reset();")
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM "
+		                 "orioledb_key_sample_top('o_test');")[0][0], 0)
+		node.stop()
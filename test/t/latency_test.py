@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+import unittest
+
+from .base_test import BaseTest
+
+
+class LatencyTest(BaseTest):
+
+	def test_latency_stats(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int8 NOT NULL,\n"
+		    "	val text NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb WITH (primary_compress);\n"
+		    "SELECT orioledb_latency_stats_reset();\n")
+		# Separate transaction without xid to get through the commit flush
+		node.safe_psql(
+		    'postgres', "INSERT INTO o_test\n"
+		    "	(SELECT id, id || repeat('x', 100)\n"
+		    "	 FROM generate_series(1, 10000) id);\n")
+		node.safe_psql(
+		    'postgres', "CHECKPOINT;\n"
+		    "SELECT orioledb_evict_pages('o_test'::regclass, 0);\n")
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_test;")[0][0], 10000)
+
+		stats = dict(
+		    node.execute(
+		        "SELECT event, count > 0 AND mean_us > 0 AND\n"
+		        "       p50_us <= p90_us AND p90_us <= p99_us AND\n"
+		        "       p99_us <= p999_us AND p999_us <= max_us\n"
+		        "FROM orioledb_latency_stats();"))
+		for event in [
+		    'load_page_memory', 'load_page_disk', 'evict_page',
+		    'compress_page', 'decompress_page', 'commit_flush'
+		]:
+			self.assertTrue(stats[event], event)
+
+		self.assertEqual(
+		    node.execute(
+		        "SELECT h.event, sum(h.count) = s.count\n"
+		        "FROM orioledb_latency_histogram() h\n"
+		        "	JOIN orioledb_latency_stats() s ON s.event = h.event\n"
+		        "WHERE h.event = 'load_page_disk'\n"
+		        "GROUP BY h.event, s.count;"), [('load_page_disk', True)])
+
+		node.safe_psql('postgres', "SELECT orioledb_latency_stats_reset();")
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM orioledb_latency_stats() "
+		                 "WHERE count > 0;")[0][0], 0)
+		node.stop()
@@ -70,6 +70,72 @@ class LogicalTest(BaseTest):
 		    "BEGIN\ntable public.data: INSERT: id[integer]:1 data[text]:'1'\ntable public.data: INSERT: id[integer]:2 data[text]:'2'\nCOMMIT\n"
 		)
 
+	@unittest.skipIf(not extension_installed("test_decoding"),
+	                 "'test_decoding' is not installed")
+	def test_skip_other_database(self):
+		node = self.node
+		node.start()  # start PostgreSQL
+		node.safe_psql('postgres', "CREATE DATABASE other;\n")
+		for db in ['postgres', 'other']:
+			node.safe_psql(
+			    db, "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+			    "CREATE TABLE data(id serial primary key, data text) USING orioledb;\n"
+			)
+
+		node.safe_psql(
+		    'postgres',
+		    "SELECT * FROM pg_create_logical_replication_slot('regression_slot', 'test_decoding', false, true);\n"
+		)
+
+		# Changes of the other database are skipped by the decoder
+		node.safe_psql(
+		    'other', "INSERT INTO data(data)\n"
+		    "	(SELECT repeat('x', 3000) FROM generate_series(1, 1000));\n")
+		node.safe_psql('postgres', "INSERT INTO data(data) VALUES('1');\n")
+
+		result = self.squashLogicalChanges(
+		    node.execute(
+		        "SELECT * FROM pg_logical_slot_get_changes('regression_slot', NULL, NULL,\n"
+		        "	'skip-empty-xacts', '1');"))
+		self.assertEqual(
+		    result,
+		    "BEGIN\ntable public.data: INSERT: id[integer]:1 data[text]:'1'\nCOMMIT\n"
+		)
+
+	@unittest.skipIf(not extension_installed("test_decoding"),
+	                 "'test_decoding' is not installed")
+	def test_stream_toasted_delete(self):
+		node = self.node
+		node.append_conf('postgresql.conf',
+		                 "logical_decoding_work_mem = 64kB\n")
+		node.start()  # start PostgreSQL
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE data(id serial primary key, data text) USING orioledb;\n"
+		    "INSERT INTO data(data)\n"
+		    "	(SELECT (SELECT string_agg(md5(i::text || g::text), '')\n"
+		    "			 FROM generate_series(1, 160) g)\n"
+		    "	 FROM generate_series(1, 2000) i);\n")
+
+		node.safe_psql(
+		    'postgres',
+		    "SELECT * FROM pg_create_logical_replication_slot('regression_slot', 'test_decoding', false, true);\n"
+		)
+
+		# Deletions of TOAST chunks don't prevent streaming
+		node.safe_psql('postgres', "DELETE FROM data;\n")
+
+		result = node.execute(
+		    "SELECT data FROM pg_logical_slot_get_changes('regression_slot', NULL, NULL,\n"
+		    "	'include-xids', '0', 'skip-empty-xacts', '1', 'stream-changes', '1');"
+		)
+		lines = [r[0] for r in result]
+		self.assertIn("opening a streamed block for transaction", lines)
+		self.assertIn("committing streamed transaction", lines)
+		self.assertEqual(
+		    len([l for l in lines if l.startswith("streaming change")]),
+		    2000)
+
 	@unittest.skipIf(not extension_installed("wal2json"),
 	                 "'wal2json' is not installed")
 	def test_wal2json(self):
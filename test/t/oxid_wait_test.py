@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+import unittest
+
+from .base_test import BaseTest
+from .base_test import ThreadQueryExecutor
+
+
+class OxidWaitTest(BaseTest):
+
+	def test_oxid_wait_stats(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int8 NOT NULL,\n"
+		    "	val int8 NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_test VALUES (1, 0);\n")
+
+		(spins, successes, sleeps) = node.execute(
+		    "SELECT * FROM orioledb_oxid_wait_stats();")[0]
+
+		con1 = node.connect()
+		con2 = node.connect()
+		con1.begin()
+		con1.execute("UPDATE o_test SET val = val + 1 WHERE id = 1;")
+
+		t = ThreadQueryExecutor(
+		    con2, "UPDATE o_test SET val = val + 1 WHERE id = 1;")
+		t.start()
+
+		# The second update waits until the first transaction is finished
+		node.poll_query_until(
+		    "SELECT sleeps > %d FROM orioledb_oxid_wait_stats();" % sleeps)
+		con1.commit()
+		t.join()
+		con2.commit()
+
+		self.assertEqual(
+		    node.execute("SELECT val FROM o_test WHERE id = 1;")[0][0], 2)
+		self.assertEqual(
+		    node.execute("SELECT spins > %d, spin_successes >= %d "
+		                 "FROM orioledb_oxid_wait_stats();" %
+		                 (spins, successes)), [(True, True)])
+		self.assertEqual(
+		    node.execute("SELECT waits > 0, wait_time > 0\n"
+		                 "FROM orioledb_wait_stats()\n"
+		                 "WHERE wait_event = 'OrioleDBOxid';"), [(True, True)])
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM orioledb_wait_stats();"),
+		    [(7, )])
+
+		con1.close()
+		con2.close()
+		node.stop()
@@ -0,0 +1,40 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+import unittest
+
+from .base_test import BaseTest
+
+
+class PageLockStatsTest(BaseTest):
+
+	def test_page_lock_stats(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "orioledb.page_lock_stats = on\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int8 NOT NULL,\n"
+		    "	val int8 NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "SELECT orioledb_page_lock_stats_reset();\n"
+		    "INSERT INTO o_test (SELECT id, id FROM generate_series(1, 1000) id);\n"
+		)
+
+		# Primary tree might be identified by the table or the index oid
+		stats = node.execute(
+		    "SELECT sum(acquisitions) >= 1000, "
+		    "bool_and(spins + waits <= acquisitions AND wait_time >= 0) "
+		    "FROM orioledb_page_lock_stats() "
+		    "WHERE reloid IN ('o_test'::regclass, 'o_test_pkey'::regclass);")
+		self.assertEqual(stats, [(True, True)])
+
+		node.safe_psql('postgres', "SELECT orioledb_page_lock_stats_reset();")
+		self.assertEqual(
+		    node.execute(
+		        "SELECT count(*) FROM orioledb_page_lock_stats() "
+		        "WHERE reloid IN ('o_test'::regclass, 'o_test_pkey'::regclass);"
+		    )[0][0], 0)
+		node.stop()
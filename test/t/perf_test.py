@@ -0,0 +1,386 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+import glob
+import json
+import os
+import re
+import subprocess
+import sys
+import time
+import unittest
+from tempfile import mkdtemp
+from threading import Event, Thread
+
+from .base_test import BaseTest
+
+# Performance scenarios aren't a part of the regular test run.  Set
+# ORIOLEDB_PERF=1 to run them, for instance:
+#
+#   ORIOLEDB_PERF=1 ORIOLEDB_PERF_RESULTS=perf.json make perfcheck
+#
+# Each scenario appends a JSON line to ORIOLEDB_PERF_RESULTS (if set) and
+# prints it to stderr.
+#
+# The soak scenario additionally needs ORIOLEDB_SOAK_DURATION (in seconds).
+# It runs the mixed workload against the small main buffers, samples the
+# space and eviction metrics every ORIOLEDB_SOAK_INTERVAL seconds and fails
+# if any of the metrics, which must stay flat, keeps growing.
+PERF_ENABLED = os.getenv('ORIOLEDB_PERF') is not None
+PERF_DURATION = int(os.getenv('ORIOLEDB_PERF_DURATION', '30'))
+PERF_SCALE = int(os.getenv('ORIOLEDB_PERF_SCALE', '10'))
+PERF_CLIENTS = int(os.getenv('ORIOLEDB_PERF_CLIENTS', '8'))
+PERF_RESULTS = os.getenv('ORIOLEDB_PERF_RESULTS')
+SOAK_DURATION = int(os.getenv('ORIOLEDB_SOAK_DURATION', '0'))
+SOAK_INTERVAL = int(os.getenv('ORIOLEDB_SOAK_INTERVAL', '60'))
+SOAK_MAIN_BUFFERS = os.getenv('ORIOLEDB_SOAK_MAIN_BUFFERS', '32MB')
+
+
+@unittest.skipUnless(PERF_ENABLED, "set ORIOLEDB_PERF to run")
+class PerfTest(BaseTest):
+
+	def startPerfNode(self, conf=''):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "default_table_access_method = 'orioledb'\n"
+		    "max_wal_size = 8GB\n"
+		    "checkpoint_timeout = 86400\n" + conf)
+		node.start()
+		node.safe_psql('postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n")
+		return node
+
+	def pgbenchInit(self, node, scale=PERF_SCALE):
+		pgbench = node.pgbench(options=["-i", "-s", str(scale)],
+		                       stdout=subprocess.DEVNULL,
+		                       stderr=subprocess.DEVNULL)
+		self.assertEqual(pgbench.wait(), 0)
+		node.safe_psql('postgres', "CHECKPOINT;")
+
+	def counters(self, node):
+		return node.execute(
+		    "SELECT pg_wal_lsn_diff(pg_current_wal_lsn(), '0/0')::int8,\n"
+		    "       (SELECT coalesce(sum(last_used_location), 0)::int8\n"
+		    "        FROM orioledb_undo_stats()),\n"
+		    "       (SELECT coalesce(sum(bytes_read + bytes_written), 0)::int8\n"
+		    "        FROM orioledb_tree_io_stats());")[0]
+
+	def countersDiff(self, before, after):
+		return {
+		    'wal_bytes': after[0] - before[0],
+		    'undo_bytes': after[1] - before[1],
+		    'io_bytes': after[2] - before[2]
+		}
+
+	def pgbenchRun(self, node, options, script=None):
+		logDir = mkdtemp(prefix='orioledb_perf_')
+		options = [
+		    "--client",
+		    str(PERF_CLIENTS), "--jobs",
+		    str(max(PERF_CLIENTS // 2, 1)), "--protocol", "prepared",
+		    "--time",
+		    str(PERF_DURATION), "--log", "--log-prefix",
+		    os.path.join(logDir, 'pgbench_log')
+		] + options
+		if script is not None:
+			scriptFile = os.path.join(logDir, 'script.sql')
+			with open(scriptFile, 'w') as f:
+				f.write(script)
+			options += ["--file", scriptFile]
+		pgbench = node.pgbench(options=options,
+		                       stdout=subprocess.PIPE,
+		                       stderr=subprocess.DEVNULL)
+		out, _ = pgbench.communicate()
+		self.assertEqual(pgbench.returncode, 0)
+
+		tps = float(re.search(r'tps = ([0-9.]+)', out.decode()).group(1))
+		latencies = []
+		for fname in glob.glob(os.path.join(logDir, 'pgbench_log.*')):
+			with open(fname) as f:
+				for line in f:
+					latencies.append(int(line.split()[2]))
+		latencies.sort()
+		result = {'tps': tps}
+		result.update(self.percentiles(latencies, 1000.0))
+		return result
+
+	@staticmethod
+	def percentiles(values, divisor):
+		if not values:
+			return {'p50_ms': None, 'p99_ms': None}
+		return {
+		    'p50_ms': values[len(values) // 2] / divisor,
+		    'p99_ms': values[min(len(values) * 99 // 100,
+		                         len(values) - 1)] / divisor
+		}
+
+	def report(self, scenario, result):
+		result = dict(result)
+		result['scenario'] = scenario
+		result['pg_version'] = self.get_pg_version()
+		result['duration'] = PERF_DURATION
+		result['scale'] = PERF_SCALE
+		result['clients'] = PERF_CLIENTS
+		line = json.dumps(result, sort_keys=True)
+		if PERF_RESULTS:
+			with open(PERF_RESULTS, 'a') as f:
+				f.write(line + '\n')
+		print(line, file=sys.stderr)
+
+	def runScenario(self, scenario, node, options=None, script=None):
+		before = self.counters(node)
+		result = self.pgbenchRun(node, options or [], script)
+		result.update(self.countersDiff(before, self.counters(node)))
+		self.report(scenario, result)
+		return result
+
+	def test_oltp(self):
+		node = self.startPerfNode()
+		self.pgbenchInit(node)
+		self.runScenario('oltp', node)
+		node.stop()
+
+	def test_bulk_copy(self):
+		node = self.startPerfNode()
+		nrows = PERF_SCALE * 100000
+		dataDir = mkdtemp(prefix='orioledb_perf_')
+		dataFile = os.path.join(dataDir, 'data.csv')
+		node.safe_psql(
+		    'postgres', "CREATE TABLE o_copy (\n"
+		    "	id int8 NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ");\n"
+		    "CREATE INDEX o_copy_val_idx ON o_copy (val);\n"
+		    "COPY (SELECT id, md5(id::text) FROM generate_series(1, %d) id)\n"
+		    "TO '%s' WITH (FORMAT csv);\n" % (nrows, dataFile))
+
+		before = self.counters(node)
+		start = time.time()
+		node.safe_psql('postgres',
+		               "COPY o_copy FROM '%s' WITH (FORMAT csv);\n" % dataFile)
+		elapsed = time.time() - start
+		result = {'tps': nrows / elapsed, 'p50_ms': None, 'p99_ms': None}
+		result.update(self.countersDiff(before, self.counters(node)))
+		self.report('bulk_copy', result)
+		os.remove(dataFile)
+		node.stop()
+
+	def test_range_scan(self):
+		node = self.startPerfNode()
+		self.pgbenchInit(node)
+		self.runScenario(
+		    'range_scan', node,
+		    script="\\set aid random(1, 100000 * :scale - 1000)\n"
+		    "SELECT sum(abalance) FROM pgbench_accounts\n"
+		    "WHERE aid BETWEEN :aid AND :aid + 1000;\n")
+		node.stop()
+
+	def test_eviction_heavy(self):
+		# The data set is several times bigger than the main buffers
+		node = self.startPerfNode("orioledb.main_buffers = 8MB\n")
+		self.pgbenchInit(node)
+		self.runScenario('eviction_heavy', node)
+		node.stop()
+
+	def test_checkpoint_under_load(self):
+		node = self.startPerfNode()
+		self.pgbenchInit(node)
+		stop = Event()
+		checkpoints = []
+
+		def checkpointer():
+			con = node.connect()
+			while not stop.wait(5):
+				start = time.time()
+				con.execute("CHECKPOINT;")
+				con.commit()
+				checkpoints.append(time.time() - start)
+			con.close()
+
+		t = Thread(target=checkpointer)
+		t.start()
+		before = self.counters(node)
+		try:
+			result = self.pgbenchRun(node, [])
+		finally:
+			stop.set()
+			t.join()
+		result.update(self.countersDiff(before, self.counters(node)))
+		result['checkpoints'] = len(checkpoints)
+		result['checkpoint_max_sec'] = max(checkpoints, default=0.0)
+		self.report('checkpoint_under_load', result)
+		node.stop()
+
+	def test_replication_lag(self):
+		node = self.startPerfNode()
+		self.pgbenchInit(node)
+		replica = self.getReplica().start()
+		self.catchup_orioledb(replica)
+		stop = Event()
+		lags = []
+
+		def lagSampler():
+			con = node.connect()
+			while not stop.wait(1):
+				lags.append(
+				    con.execute("SELECT coalesce(max(pg_wal_lsn_diff(\n"
+				                "	pg_current_wal_lsn(), replay_lsn)), 0)\n"
+				                "FROM pg_stat_replication;")[0][0])
+				con.commit()
+			con.close()
+
+		t = Thread(target=lagSampler)
+		t.start()
+		before = self.counters(node)
+		try:
+			result = self.pgbenchRun(node, [])
+		finally:
+			stop.set()
+			t.join()
+		result.update(self.countersDiff(before, self.counters(node)))
+
+		start = time.time()
+		self.catchup_orioledb(replica)
+		result['catchup_sec'] = time.time() - start
+		lags = sorted(int(lag) for lag in lags)
+		result['lag_max_bytes'] = lags[-1] if lags else 0
+		result['lag_p50_bytes'] = lags[len(lags) // 2] if lags else 0
+		self.report('replication_lag', result)
+		replica.stop()
+		node.stop()
+
+	def soakSample(self, con):
+		space = con.execute(
+		    "SELECT coalesce(sum(s.datafile_size), 0)::int8,\n"
+		    "       coalesce(sum(s.free_size), 0)::int8,\n"
+		    "       coalesce(sum(s.free_extents), 0)::int8\n"
+		    "FROM pg_class c, orioledb_tree_space(c.oid) s\n"
+		    "WHERE c.relname LIKE 'pgbench\\_%' OR\n"
+		    "      c.relname LIKE 'o\\_churn%';")[0]
+		evictions = con.execute(
+		    "SELECT coalesce(sum(backend_evictions + bgwriter_evictions), 0)::int8\n"
+		    "FROM orioledb_page_pool_stats();")[0][0]
+		s3Evictions = con.execute(
+		    "SELECT coalesce(sum(evictions), 0)::int8\n"
+		    "FROM orioledb_s3_cache_stats();")[0][0]
+		con.commit()
+
+		sizes = {'data_files': 0, 'map_files': 0, 'undo_files': 0}
+		for (subdir, category) in [('orioledb_data', None),
+		                           ('orioledb_undo', 'undo_files')]:
+			for root, _, files in os.walk(
+			    os.path.join(self.node.data_dir, subdir)):
+				for fname in files:
+					try:
+						size = os.path.getsize(os.path.join(root, fname))
+					except FileNotFoundError:
+						continue
+					if category is not None:
+						sizes[category] += size
+					elif fname.endswith(('.map', '.tmp')):
+						sizes['map_files'] += size
+					else:
+						sizes['data_files'] += size
+
+		sample = {
+		    'time': time.time(),
+		    'datafile_size': space[0],
+		    'free_size': space[1],
+		    'free_extents': space[2],
+		    'evictions': evictions,
+		    's3_cache_evictions': s3Evictions
+		}
+		sample.update(sizes)
+		return sample
+
+	@staticmethod
+	def growsMonotonically(values):
+		# Skip the warm-up and compare the quarters of the rest
+		values = values[len(values) // 4:]
+		if len(values) < 8:
+			return False
+		q = len(values) // 4
+		means = [sum(values[i * q:(i + 1) * q]) / q for i in range(4)]
+		return all(b > a for a, b in zip(means, means[1:])) and \
+		    means[3] > means[0] * 1.1
+
+	@unittest.skipUnless(SOAK_DURATION > 0,
+	                     "set ORIOLEDB_SOAK_DURATION to run")
+	def test_soak(self):
+		node = self.startPerfNode("orioledb.main_buffers = %s\n"
+		                          "checkpoint_timeout = 60\n"
+		                          "log_checkpoints = on\n" %
+		                          SOAK_MAIN_BUFFERS)
+		self.pgbenchInit(node)
+		node.safe_psql(
+		    'postgres', "CREATE TABLE o_churn (\n"
+		    "	id int8 NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ");\n"
+		    "CREATE INDEX o_churn_val_idx ON o_churn (val);\n")
+
+		scriptDir = mkdtemp(prefix='orioledb_soak_')
+		scriptFile = os.path.join(scriptDir, 'churn.sql')
+		with open(scriptFile, 'w') as f:
+			f.write("\\set id random(1, 100000 * :scale)\n"
+			        "INSERT INTO o_churn VALUES (:id, md5(random()::text))\n"
+			        "ON CONFLICT (id) DO UPDATE SET val = excluded.val;\n"
+			        "DELETE FROM o_churn WHERE id = :id + 1;\n")
+		pgbench = node.pgbench(options=[
+		    "--client",
+		    str(PERF_CLIENTS), "--jobs",
+		    str(max(PERF_CLIENTS // 2, 1)), "--protocol", "prepared",
+		    "--time",
+		    str(SOAK_DURATION), "--builtin", "tpcb-like@5", "--builtin",
+		    "select-only@3", "--file", scriptFile + "@2"
+		],
+		                       stdout=subprocess.DEVNULL,
+		                       stderr=subprocess.DEVNULL)
+
+		con = node.connect()
+		samples = []
+		checkpoints = []
+		logOffset = 0
+		while pgbench.poll() is None:
+			time.sleep(SOAK_INTERVAL)
+			sample = self.soakSample(con)
+			if samples:
+				sample['eviction_rate'] = \
+				    (sample['evictions'] - samples[-1]['evictions']) / \
+				    (sample['time'] - samples[-1]['time'])
+			samples.append(sample)
+
+			with open(node.pg_log_file) as f:
+				f.seek(logOffset)
+				for line in f:
+					m = re.search(r'checkpoint complete:.*total=([0-9.]+) s',
+					              line)
+					if m:
+						checkpoints.append(float(m.group(1)))
+				logOffset = f.tell()
+			sample['checkpoints'] = len(checkpoints)
+			sample['checkpoint_last_sec'] = checkpoints[-1] \
+			    if checkpoints else None
+			self.report('soak_sample', sample)
+		con.close()
+		self.assertEqual(pgbench.returncode, 0)
+
+		series = {
+		    name: [s[name] for s in samples] for name in [
+		        'datafile_size', 'free_extents', 'data_files', 'map_files',
+		        'undo_files'
+		    ]
+		}
+		series['checkpoint_sec'] = checkpoints
+		grown = sorted(name for name, values in series.items()
+		               if self.growsMonotonically(values))
+		self.report(
+		    'soak', {
+		        'samples': len(samples),
+		        'checkpoints': len(checkpoints),
+		        'checkpoint_max_sec': max(checkpoints, default=None),
+		        'monotonic_growth': grown
+		    })
+		self.assertEqual(grown, [])
+		node.stop()
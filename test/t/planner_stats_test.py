@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+import json
+import os
+
+from .base_test import BaseTest
+
+
+class PlannerStatsTest(BaseTest):
+
+	def plan_rows(self, node, query):
+		plan = node.execute("EXPLAIN (FORMAT JSON) " + query)[0][0]
+		if isinstance(plan, str):
+			plan = json.loads(plan)
+		return plan[0]['Plan']['Plan Rows']
+
+	def test_live_density_estimate(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int8 NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_test (SELECT id, 'value ' || id\n"
+		    "	FROM generate_series(1, 20000) id ORDER BY random());\n")
+
+		# No ANALYZE was run, the estimate comes from the live density
+		rows = self.plan_rows(node, "SELECT * FROM o_test")
+		self.assertGreater(rows, 10000)
+		self.assertLess(rows, 40000)
+
+		node.safe_psql('postgres', "DELETE FROM o_test WHERE id <= 5000;\n"
+		               "UPDATE o_test SET val = 'x' WHERE id <= 6000;\n")
+
+		stats = node.execute(
+		    "SELECT n_tup_ins, n_tup_del, n_tup_upd, n_mod_since_analyze\n"
+		    "FROM pg_stat_user_tables WHERE relname = 'o_test';")
+		self.assertEqual(stats, [(20000, 5000, 1000, 26000)])
+		node.stop()
+
+	def test_copy_insert_counters(self):
+		node = self.node
+		node.start()
+		dataFile = os.path.join(node.base_dir, 'o_test.data')
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int8 NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "COPY (SELECT id, 'value ' || id FROM generate_series(1, 3000) id)\n"
+		    "	TO '%s';\n"
+		    "COPY o_test FROM '%s';\n"
+		    "BEGIN;\n"
+		    "CREATE UNLOGGED TABLE o_test_freeze (\n"
+		    "	id int8 NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "COPY o_test_freeze FROM '%s' WITH (FREEZE);\n"
+		    "COMMIT;\n" % (dataFile, dataFile, dataFile))
+
+		# Both the batched and the bulk load paths of COPY count inserts
+		stats = node.execute(
+		    "SELECT relname, n_tup_ins FROM pg_stat_user_tables\n"
+		    "WHERE relname LIKE 'o_test%' ORDER BY relname;")
+		self.assertEqual(stats, [('o_test', 3000), ('o_test_freeze', 3000)])
+		node.stop()
+
+	def test_analyze_random_walk_sampling(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int8 NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_test (SELECT id, repeat('x', 500)\n"
+		    "	FROM generate_series(1, 100000) id);\n")
+
+		# The tiny sample makes ANALYZE sample leaves by random walks
+		node.safe_psql(
+		    'postgres', "SET default_statistics_target = 1;\n"
+		    "ANALYZE o_test;\n")
+		reltuples = node.execute(
+		    "SELECT reltuples FROM pg_class WHERE relname = 'o_test';")[0][0]
+		self.assertGreater(reltuples, 80000)
+		self.assertLess(reltuples, 120000)
+		node.stop()
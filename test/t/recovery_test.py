@@ -1111,6 +1111,60 @@ class RecoveryTest(BaseTest):
 		node.stop()
 		# stop PostgreSQL
 
+	def test_wal_toast_partial_update(self):
+		node = self.node
+		node.start()  # start PostgreSQL
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE IF NOT EXISTS o_test (\n"
+		    "	id integer NOT NULL PRIMARY KEY,\n"
+		    "	val text\n"
+		    ") USING orioledb;\n")
+
+		random.seed(0)
+		initial = generate_string(20000)
+		appended = initial + generate_string(5000)
+		changed = initial[:10000] + generate_string(100) + initial[10100:]
+		shrunk = initial[:7000]
+
+		node.safe_psql(
+		    'postgres', "INSERT INTO o_test VALUES (1, '%s'), (2, '%s'), "
+		    "(3, '%s'), (4, '%s');" % (initial, initial, initial, initial))
+		node.safe_psql('postgres', "CHECKPOINT;")
+
+		node.safe_psql(
+		    'postgres',
+		    "UPDATE o_test SET val = val || '%s' WHERE id = 1;" %
+		    (appended[20000:]))
+		node.safe_psql(
+		    'postgres',
+		    "UPDATE o_test SET val = '%s' WHERE id = 2;" % (changed))
+		node.safe_psql(
+		    'postgres',
+		    "UPDATE o_test SET val = '%s' WHERE id = 3;" % (shrunk))
+
+		con = node.connect()
+		con.begin()
+		con.execute("UPDATE o_test SET val = '%s' WHERE id = 4;" % (changed))
+		self.assertEqual(
+		    con.execute('SELECT val FROM o_test WHERE id = 4;')[0][0],
+		    changed)
+		con.rollback()
+		con.close()
+
+		self.assertEqual(
+		    node.execute('postgres',
+		                 'SELECT val FROM o_test WHERE id = 4;')[0][0],
+		    initial)
+
+		node.stop(['-m', 'immediate'])
+		node.start()
+
+		self.assertEqual(
+		    node.execute('postgres', 'SELECT id, val FROM o_test ORDER BY id;'),
+		    [(1, appended), (2, changed), (3, shrunk), (4, initial)])
+		node.stop()
+
 	def test_toast_subtrans(self):
 		node = self.node
 		self.maxDiff = None
@@ -1247,6 +1301,53 @@ class RecoveryTest(BaseTest):
 		    self.number_to_ctid(80000))
 		node.stop()
 
+	def test_ctid_cache(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id integer NOT NULL,\n"
+		    "	val text\n"
+		    ") USING orioledb;\n")
+		con1 = node.connect()
+		con2 = node.connect()
+		con1.execute("SET orioledb.ctid_cache_size = 1000;")
+		con2.execute("SET orioledb.ctid_cache_size = 1000;")
+		for i in range(3):
+			con1.execute("INSERT INTO o_test (SELECT id, 'con1'\n"
+			             "	FROM generate_series(%d, %d) id);" %
+			             (i * 100 + 1, i * 100 + 100))
+			con1.commit()
+			con2.execute("INSERT INTO o_test (SELECT id, 'con2'\n"
+			             "	FROM generate_series(%d, %d) id);" %
+			             (10000 + i * 100 + 1, 10000 + i * 100 + 100))
+			con2.commit()
+
+		# Each backend inserts to its own range of ctids
+		self.assertEqual(
+		    node.execute("SELECT ctid FROM o_test WHERE id = 10001;")[0][0],
+		    self.number_to_ctid(1001))
+		self.assertEqual(
+		    node.execute("SELECT ctid FROM o_test WHERE id = 300;")[0][0],
+		    self.number_to_ctid(300))
+		con1.close()
+		con2.close()
+		node.stop(['-m', 'immediate'])
+
+		# The ctids reserved after recovery don't overlap the replayed ones
+		node.start()
+		node.safe_psql(
+		    "SET orioledb.ctid_cache_size = 1000;\n"
+		    "INSERT INTO o_test (SELECT id, 'after'\n"
+		    "	FROM generate_series(20001, 20100) id);")
+		self.assertEqual(
+		    node.execute("SELECT count(*), count(DISTINCT ctid) FROM o_test;"),
+		    [(700, 700)])
+		self.assertEqual(
+		    node.execute("SELECT ctid FROM o_test WHERE id = 20001;")[0][0],
+		    self.number_to_ctid(1301))
+		node.stop()
 	def test_wal_only_commit_or_rollback_container(self):
 		node = self.node
 		node.append_conf('postgresql.conf',
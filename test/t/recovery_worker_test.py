@@ -1,6 +1,7 @@
 #!/usr/bin/env python3
 # coding: utf-8
 
+import re
 import unittest
 import testgres
 import logging
@@ -53,6 +54,124 @@ class RecoveryWorkerTest(BaseTest):
 		)
 		node.stop()
 
+	def test_recovery_rebalance(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "orioledb.recovery_pool_size = 3\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE IF NOT EXISTS o_test (\n"
+		    "	id integer NOT NULL,\n"
+		    "	val integer NOT NULL,\n"
+		    "	PRIMARY KEY (id)"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_test\n"
+		    "	(SELECT id, 0 FROM generate_series(1, 1000, 1) id);\n")
+		node.safe_psql('postgres', 'CHECKPOINT;')
+
+		# A few hot keys updated in many small transactions interleaved with
+		# bulk modifications of the other keys
+		script = ""
+		for i in range(100):
+			script += "UPDATE o_test SET val = val + 1 WHERE id = 1;\n" * 200
+			script += "UPDATE o_test SET val = val + 1 WHERE id > 1;\n"
+		node.safe_psql('postgres', script)
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		self.assertEqual(
+		    node.execute(
+		        'postgres',
+		        'SELECT count(*), sum(val), max(val) FROM o_test;'),
+		    [(1000, 20000 + 999 * 100, 20000)])
+		node.stop()
+
+	def test_recovery_prefetch(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.recovery_pool_size = 3\n"
+		    "orioledb.main_buffers = 8MB\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE IF NOT EXISTS o_test (\n"
+		    "	id integer NOT NULL,\n"
+		    "	val text NOT NULL,\n"
+		    "	PRIMARY KEY (id)"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_test\n"
+		    "	(SELECT id, repeat('x', 100) FROM generate_series(1, 100000, 1) id);\n"
+		)
+		node.safe_psql('postgres', 'CHECKPOINT;')
+
+		# After restart all the leaves are on disk, so recovery prefetches
+		# them for the workers
+		node.safe_psql(
+		    'postgres', "UPDATE o_test SET val = 'y' WHERE id % 7 = 0;\n"
+		    "DELETE FROM o_test WHERE id % 11 = 0;\n"
+		    "INSERT INTO o_test\n"
+		    "	(SELECT id, 'z' FROM generate_series(100001, 101000, 1) id);\n")
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		self.assertEqual(
+		    node.execute(
+		        'postgres',
+		        "SELECT count(*), count(*) FILTER (WHERE val = 'y'),\n"
+		        "       count(*) FILTER (WHERE val = 'z') FROM o_test;"),
+		    [(100000 - 9090 + 1000, 14285 - 1298, 1000)])
+		node.stop()
+
+	def test_recovery_skip_dropped(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.recovery_pool_size = 3\n"
+		    "orioledb.recovery_skip_dropped = on\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_keep (\n"
+		    "	id integer NOT NULL,\n"
+		    "	val text NOT NULL,\n"
+		    "	PRIMARY KEY (id)"
+		    ") USING orioledb;\n")
+		node.safe_psql('postgres', 'CHECKPOINT;')
+
+		# Staging table filled and dropped, and a drop rolled back
+		node.safe_psql(
+		    'postgres', "CREATE TABLE o_staging (\n"
+		    "	id integer NOT NULL,\n"
+		    "	val text NOT NULL,\n"
+		    "	PRIMARY KEY (id)"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_staging\n"
+		    "	(SELECT id, repeat('x', 3000) FROM generate_series(1, 5000, 1) id);\n"
+		    "INSERT INTO o_keep (SELECT id, val FROM o_staging WHERE id <= 1000);\n"
+		    "DROP TABLE o_staging;\n")
+		node.safe_psql(
+		    'postgres', "BEGIN;\n"
+		    "DROP TABLE o_keep;\n"
+		    "ROLLBACK;\n"
+		    "INSERT INTO o_keep\n"
+		    "	(SELECT id, 'y' FROM generate_series(1001, 2000, 1) id);\n")
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		self.assertEqual(
+		    node.execute(
+		        'postgres',
+		        "SELECT count(*), count(*) FILTER (WHERE val = 'y') FROM o_keep;"
+		    ), [(2000, 1000)])
+		self.assertEqual(
+		    node.execute(
+		        'postgres',
+		        "SELECT orioledb_tbl_check('o_keep'::regclass);")[0][0], True)
+		with open(node.pg_log_file) as f:
+			found = re.search(r'pre-scan found (\d+) dropped trees', f.read())
+		self.assertIsNotNone(found)
+		self.assertGreater(int(found.group(1)), 0)
+		node.stop()
+
 	def test_too_much_workers(self):
 		node = self.node
 		node.start()
@@ -107,6 +226,45 @@ class RecoveryWorkerTest(BaseTest):
 			self.assertIn('WARNING:  unable to start recovery workers',
 			              f.read())
 
+	def test_recovery_index_build_other_tables(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id integer NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "CREATE TABLE o_other (\n"
+		    "	id integer NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_test\n"
+		    "	(SELECT id, id || 'val' FROM generate_series(1, 20000) id);\n")
+		node.safe_psql('postgres', 'CHECKPOINT;')
+
+		# Replay of the other table goes on while the index is built
+		node.safe_psql('postgres', "CREATE INDEX o_test_idx ON o_test(val);")
+		for i in range(1, 101):
+			node.safe_psql('postgres', "INSERT INTO o_other VALUES (%d);" % i)
+		node.safe_psql(
+		    'postgres', "INSERT INTO o_test VALUES (20001, 'last');\n"
+		    "TRUNCATE o_other;\n"
+		    "INSERT INTO o_other VALUES (1);\n")
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		self.assertEqual(
+		    node.execute("SET enable_seqscan = off;\n"
+		                 "SELECT count(*) FROM o_test WHERE val >= '1';")[0][0],
+		    20001)
+		self.assertEqual(
+		    node.execute("SELECT id FROM o_test WHERE val = 'last';")[0][0],
+		    20001)
+		self.assertEqual(node.execute("SELECT * FROM o_other;"), [(1, )])
+		node.stop()
+
 	def wait_recovery_breakpoint(self, block_pid):
 		recovery_pid = None
 		while recovery_pid == None:
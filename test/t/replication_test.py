@@ -77,6 +77,45 @@ class ReplicationTest(BaseTest):
 				replica.poll_query_until(
 				    "SELECT orioledb_has_retained_undo();", expected=False)
 
+	def test_replication_update_delta(self):
+		with self.node as master:
+			master.start()
+
+			with self.getReplica().start() as replica:
+				master.safe_psql("""CREATE EXTENSION orioledb;
+					CREATE TABLE o_test (
+						id integer NOT NULL,
+						cnt integer NOT NULL,
+						val text,
+						PRIMARY KEY (id)
+					) USING orioledb;
+					INSERT INTO o_test (
+						SELECT id, 0, repeat('x', 200)
+						FROM generate_series(1, 1000) id);""")
+
+				# Small updates of wide rows produce delta WAL records
+				master.safe_psql(
+				    "UPDATE o_test SET cnt = cnt + 1 WHERE id % 2 = 0;")
+				master.safe_psql("""BEGIN;
+					UPDATE o_test SET cnt = cnt + 1 WHERE id <= 500;
+					UPDATE o_test SET cnt = cnt + 10 WHERE id <= 100;
+					COMMIT;""")
+				master.safe_psql(
+				    "UPDATE o_test SET val = repeat('y', 200) WHERE id = 7;")
+				master.safe_psql("""BEGIN;
+					UPDATE o_test SET cnt = cnt + 100 WHERE id > 900;
+					ROLLBACK;""")
+
+				catchup_orioledb(replica)
+				query = "SELECT count(*), sum(cnt), sum(length(val)), count(*) FILTER (WHERE val LIKE 'y%') FROM o_test;"
+				expected = master.execute(query)[0]
+				self.assertEqual(expected, (1000, 2000, 200000, 1))
+				self.assertEqual(replica.execute(query)[0], expected)
+
+				master.stop(['-m', 'immediate'])
+				master.start()
+				self.assertEqual(master.execute(query)[0], expected)
+
 	def test_replication_drop(self):
 		with self.node as master:
 			master.start()
@@ -461,6 +500,51 @@ class ReplicationTest(BaseTest):
 				    """SELECT COUNT(*) FROM o_test;""")[0][0]
 				self.assertEqual(count, 20000)
 
+	def test_recovery_stats(self):
+		with self.node as master:
+			master.start()
+
+			# create a backup
+			with self.getReplica().start() as replica:
+				master.execute("CREATE EXTENSION orioledb;")
+				master.execute("CREATE TABLE o_test\n"
+				               "    (id integer NOT NULL PRIMARY KEY)\n"
+				               "USING orioledb;")
+				master.execute("INSERT INTO o_test\n"
+				               "    SELECT generate_series(1, 1000);")
+				catchup_orioledb(replica)
+
+				self.assertEqual(
+				    master.execute(
+				        "SELECT orioledb_recovery_consistent_lsn();"),
+				    [(None, )])
+				self.assertEqual(
+				    master.execute(
+				        "SELECT count(*) FROM orioledb_recovery_worker_stats();"
+				    ), [(0, )])
+				self.assertTrue(
+				    replica.execute(
+				        "SELECT orioledb_recovery_consistent_lsn() <=\n"
+				        "       pg_last_wal_replay_lsn();")[0][0])
+				self.assertEqual(
+				    replica.execute(
+				        "SELECT consistent_lsn = orioledb_recovery_consistent_lsn(),\n"
+				        "       index_builds_pending\n"
+				        "FROM orioledb_recovery_stats();"), [(True, 0)])
+				self.assertEqual(
+				    replica.execute(
+				        "SELECT worker_type, count(*) FROM\n"
+				        "    orioledb_recovery_worker_stats()\n"
+				        "GROUP BY worker_type ORDER BY worker_type;"),
+				    [('index_build', 2), ('index_build_leader', 1),
+				     ('main', 3)])
+				self.assertTrue(
+				    replica.execute(
+				        "SELECT sum(applied_records) >= 1000 AND\n"
+				        "       bool_and(queue_used_bytes <= queue_size)\n"
+				        "FROM orioledb_recovery_worker_stats()\n"
+				        "WHERE worker_type = 'main';")[0][0])
+
 	def test_remote_apply(self):
 		with self.node as master:
 			master.append_conf(filename='postgresql.conf',
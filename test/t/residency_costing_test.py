@@ -0,0 +1,44 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+import re
+
+from .base_test import BaseTest
+
+
+class ResidencyCostingTest(BaseTest):
+
+	def scanCost(self, con, query):
+		plan = con.execute("EXPLAIN " + query)[0][0]
+		return float(re.search(r"cost=[0-9.]+\.\.([0-9.]+)", plan).group(1))
+
+	def test_residency_costing(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int NOT NULL,\n"
+		    "	val text NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_test\n"
+		    "	(SELECT id, repeat('x', 100) FROM generate_series(1, 50000) id);\n"
+		    "ANALYZE o_test;\n")
+
+		query = "SELECT * FROM o_test"
+		con = node.connect()
+		plainCost = self.scanCost(con, query)
+		con.execute("SET orioledb.enable_residency_costing = on;")
+		residentCost = self.scanCost(con, query)
+		self.assertLess(residentCost, plainCost)
+
+		node.safe_psql(
+		    'postgres', "CHECKPOINT;\n"
+		    "SELECT orioledb_evict_pages('o_test'::regclass, 0);\n")
+		evictedCost = self.scanCost(con, query)
+		self.assertLess(residentCost, evictedCost)
+		self.assertEqual(
+		    con.execute("SELECT count(*) FROM o_test;")[0][0], 50000)
+		con.close()
+		node.stop()
@@ -74,6 +74,105 @@ class S3Test(S3BaseTest):
 		node.stop(['-m', 'immediate'])
 		os.unlink(s3_test_file)
 
+	def test_s3_put_multipart(self):
+		fd, s3_test_file = mkstemp()
+		with os.fdopen(fd, 'wb') as fp:
+			fp.write(os.urandom(12 * 1024 * 1024 + 100))
+
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', f"""
+			orioledb.s3_mode = true
+			orioledb.s3_host = '{self.host}:{self.port}/{self.bucket_name}'
+			orioledb.s3_region = '{self.region}'
+			orioledb.s3_accesskey = '{self.access_key_id}'
+			orioledb.s3_secretkey = '{self.secret_access_key}'
+			orioledb.s3_cainfo = '{self.s3_cainfo}'
+			orioledb.s3_multipart_part_size = 5MB
+			orioledb.s3_multipart_concurrency = 2
+		""")
+		node.start()
+		node.safe_psql("CREATE EXTENSION IF NOT EXISTS orioledb;")
+		node.safe_psql(f"SELECT s3_put('wal/multipart', '{s3_test_file}');")
+
+		object = self.client.get_object(Bucket=self.bucket_name,
+		                                Key="wal/multipart")
+		with open(s3_test_file, "rb") as f:
+			self.assertEqual(object["Body"].read(), f.read())
+		self.assertTrue(object["ETag"].endswith('-3"'))
+		node.stop(['-m', 'immediate'])
+		os.unlink(s3_test_file)
+
+	def test_s3_put_crc32c(self):
+		fd, s3_test_file = mkstemp()
+		with os.fdopen(fd, 'wb') as fp:
+			fp.write(os.urandom(12 * 1024 * 1024 + 100))
+		fd, s3_small_file = mkstemp()
+		with os.fdopen(fd, 'wb') as fp:
+			fp.write(b'123456789')
+
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', f"""
+			orioledb.s3_mode = true
+			orioledb.s3_host = '{self.host}:{self.port}/{self.bucket_name}'
+			orioledb.s3_region = '{self.region}'
+			orioledb.s3_accesskey = '{self.access_key_id}'
+			orioledb.s3_secretkey = '{self.secret_access_key}'
+			orioledb.s3_cainfo = '{self.s3_cainfo}'
+			orioledb.s3_multipart_part_size = 5MB
+			orioledb.s3_checksum_algorithm = crc32c
+		""")
+		node.start()
+		node.safe_psql("CREATE EXTENSION IF NOT EXISTS orioledb;")
+		node.safe_psql(f"SELECT s3_put('wal/crc32c', '{s3_small_file}');")
+		node.safe_psql(f"SELECT s3_put('wal/multipart', '{s3_test_file}');")
+
+		# CRC32C of "123456789" is 0xE3069283
+		object = self.client.get_object(Bucket=self.bucket_name,
+		                                Key="wal/crc32c",
+		                                ChecksumMode='ENABLED')
+		self.assertEqual(object["Body"].read(), b'123456789')
+		self.assertEqual(object.get("ChecksumCRC32C"), "4waSgw==")
+
+		object = self.client.get_object(Bucket=self.bucket_name,
+		                                Key="wal/multipart")
+		with open(s3_test_file, "rb") as f:
+			self.assertEqual(object["Body"].read(), f.read())
+		node.stop(['-m', 'immediate'])
+		os.unlink(s3_test_file)
+		os.unlink(s3_small_file)
+
+	def test_s3_stats(self):
+		fd, s3_test_file = mkstemp()
+		with os.fdopen(fd, 'wt') as fp:
+			fp.write("HELLO\nIT'S A ME\nMARIO\n")
+
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', f"""
+			orioledb.s3_mode = true
+			orioledb.s3_host = '{self.host}:{self.port}/{self.bucket_name}'
+			orioledb.s3_region = '{self.region}'
+			orioledb.s3_accesskey = '{self.access_key_id}'
+			orioledb.s3_secretkey = '{self.secret_access_key}'
+			orioledb.s3_cainfo = '{self.s3_cainfo}'
+		""")
+		node.start()
+		node.safe_psql("CREATE EXTENSION IF NOT EXISTS orioledb;")
+		node.safe_psql("SELECT orioledb_s3_stats_reset();")
+		with node.connect() as con:
+			con.execute(f"SELECT s3_put('wal/1', '{s3_test_file}');")
+			con.execute(f"SELECT s3_put('wal/2', '{s3_test_file}');")
+			con.execute("SELECT s3_get('wal/1');")
+		requests, connections = node.execute(
+		    "SELECT requests, new_connections FROM orioledb_s3_stats();")[0]
+		self.assertGreaterEqual(requests, 3)
+		self.assertGreaterEqual(connections, 1)
+		self.assertLessEqual(connections, requests)
+		node.stop(['-m', 'immediate'])
+		os.unlink(s3_test_file)
+
 	def test_s3_credential_check(self):
 		node = self.node
 
@@ -241,6 +340,70 @@ class S3Test(S3BaseTest):
 
 		node.stop()
 
+	def test_s3_incremental_backup(self):
+		node = self.node
+		node.append_conf(f"""
+			orioledb.s3_mode = true
+			orioledb.s3_host = '{self.host}:{self.port}/{self.bucket_name}'
+			orioledb.s3_region = '{self.region}'
+			orioledb.s3_accesskey = '{self.access_key_id}'
+			orioledb.s3_secretkey = '{self.secret_access_key}'
+			orioledb.s3_cainfo = '{self.s3_cainfo}'
+
+			orioledb.s3_num_workers = 3
+			orioledb.recovery_pool_size = 1
+			orioledb.s3_incremental_backup = true
+
+			autovacuum = off
+		""")
+		node.start()
+
+		# 1st CHECKPOINT
+		node.safe_psql("""
+			CREATE TABLE test_1 (
+				val_1 int
+			) USING heap;
+			INSERT INTO test_1 SELECT * FROM generate_series(1, 400000);
+			VACUUM FREEZE test_1;
+		""")
+
+		test_1_filepath = node.execute(
+		    "SELECT pg_catalog.pg_relation_filepath('test_1'::regclass)")[0][0]
+		nchunks = node.execute(f"""
+			SELECT (pg_relation_size('test_1') + 4 * 1024 * 1024 - 1) /
+				   (4 * 1024 * 1024)
+		""")[0][0]
+		self.assertGreater(nchunks, 1)
+
+		node.safe_psql("CHECKPOINT")
+
+		objects_1 = self.client.list_objects(Bucket=self.bucket_name)
+		objects_1 = objects_1.get("Contents", [])
+		objects_1 = sorted(list(x["Key"] for x in objects_1))
+
+		self.assertNotIn("data/1/" + test_1_filepath, objects_1)
+		for i in range(nchunks):
+			self.assertIn(f"data/1/{test_1_filepath}.orioledb_chunk.{i}",
+			              objects_1)
+
+		# 2nd CHECKPOINT, only the last chunk is changed
+		node.safe_psql("""
+			INSERT INTO test_1 SELECT * FROM generate_series(1, 10);
+		""")
+		node.safe_psql("CHECKPOINT")
+
+		objects_2 = self.client.list_objects(Bucket=self.bucket_name)
+		objects_2 = objects_2.get("Contents", [])
+		objects_2 = sorted(list(x["Key"] for x in objects_2))
+
+		self.assertNotIn(f"data/2/{test_1_filepath}.orioledb_chunk.0",
+		                 objects_2)
+		self.assertIn(
+		    f"data/2/{test_1_filepath}.orioledb_chunk.{nchunks - 1}",
+		    objects_2)
+
+		node.stop()
+
 	def test_s3_checkpoint_checksum_error(self):
 		node = self.node
 		node.append_conf(f"""
@@ -448,11 +611,28 @@ class S3Test(S3BaseTest):
 			time.sleep(1)
 		self.assertEqual(20000,
 		                 node.execute("SELECT COUNT(*) FROM o_test")[0][0])
+		evictions, evicted_bytes = node.execute(
+		    "SELECT evictions, evicted_bytes FROM orioledb_s3_cache_stats();"
+		)[0]
+		self.assertGreater(evictions, 0)
+		self.assertGreater(evicted_bytes, 0)
 		node.stop(['-m', 'immediate'])
 
 		node.start()
 		self.assertEqual(20000,
 		                 node.execute("SELECT COUNT(*) FROM o_test")[0][0])
+		loads, misses = node.execute(
+		    "SELECT loads, misses FROM orioledb_s3_cache_stats();")[0]
+		self.assertGreater(loads, 0)
+		self.assertGreater(misses, 0)
+		self.assertEqual(
+		    10001,
+		    node.execute("SELECT COUNT(*) FROM o_test "
+		                 "WHERE id BETWEEN 5000 AND 15000")[0][0])
+		with node.connect() as con:
+			con.execute("SET orioledb.s3_prefetch_parts = 0;")
+			self.assertEqual(20000,
+			                 con.execute("SELECT COUNT(*) FROM o_test")[0][0])
 		node.stop()
 
 	def test_s3_data_dir_load(self):
@@ -509,6 +689,100 @@ class S3Test(S3BaseTest):
 			new_node.stop()
 			new_node.cleanup()
 
+	def test_s3_warmup_manifest(self):
+		node = self.node
+		node.append_conf(f"""
+			orioledb.s3_mode = true
+			orioledb.s3_host = '{self.host}:{self.port}/{self.bucket_name}'
+			orioledb.s3_region = '{self.region}'
+			orioledb.s3_accesskey = '{self.access_key_id}'
+			orioledb.s3_secretkey = '{self.secret_access_key}'
+			orioledb.s3_cainfo = '{self.s3_cainfo}'
+			orioledb.s3_num_workers = 3
+			orioledb.buffer_warmup_workers = 1
+		""")
+		node.start()
+		node.safe_psql("""
+			CREATE EXTENSION orioledb;
+			CREATE TABLE o_test_1 (
+				val_1 int PRIMARY KEY
+			) USING orioledb;
+			INSERT INTO o_test_1 SELECT * FROM generate_series(1, 1000);
+		""")
+		node.safe_psql("CHECKPOINT;")
+
+		# The manifest is uploaded asynchronously after the checkpoint
+		found = False
+		deadline = time.time() + 30
+		while not found and time.time() < deadline:
+			paginator = self.client.get_paginator('list_objects_v2')
+			for page in paginator.paginate(Bucket=self.bucket_name,
+			                               Prefix='data/'):
+				found = found or any(
+				    x["Key"].endswith("/orioledb_data/warmup")
+				    for x in page.get("Contents", []))
+			if not found:
+				time.sleep(0.1)
+		self.assertTrue(found)
+		node.stop()
+
+	def test_s3_wal_compression(self):
+		node = self.node
+		node.append_conf(f"""
+			orioledb.s3_mode = true
+			orioledb.s3_host = '{self.host}:{self.port}/{self.bucket_name}'
+			orioledb.s3_region = '{self.region}'
+			orioledb.s3_accesskey = '{self.access_key_id}'
+			orioledb.s3_secretkey = '{self.secret_access_key}'
+			orioledb.s3_cainfo = '{self.s3_cainfo}'
+			orioledb.s3_num_workers = 3
+			orioledb.s3_wal_compression = 3
+
+			archive_mode = on
+			archive_library = 'orioledb'
+		""")
+		node.start()
+		archiver_pid = node.execute("""
+			SELECT pid FROM pg_stat_activity WHERE backend_type = 'archiver';
+		""")[0][0]
+		node.safe_psql("""
+			CREATE EXTENSION orioledb;
+			CREATE TABLE o_test_1 (
+				val_1 int
+			) USING orioledb;
+			INSERT INTO o_test_1 SELECT * FROM generate_series(1, 5);
+		""")
+		node.safe_psql("CHECKPOINT;")
+		node.stop(['--no-wait'])
+
+		new_temp_dir = mkdtemp(prefix=self.myName + '_tgsb_')
+
+		objects = []
+		while objects == []:
+			objects = self.client.list_objects(Bucket=self.bucket_name,
+			                                   Prefix='wal/').get(
+			                                       'Contents', [])
+		os.kill(archiver_pid, signal.SIGUSR2)
+		while node.status() == NodeStatus.Running:
+			pass
+
+		objects = self.client.list_objects(Bucket=self.bucket_name,
+		                                   Prefix='wal/')['Contents']
+		for obj in objects:
+			self.assertTrue(obj['Key'].endswith('.zst'))
+			self.assertLess(obj['Size'], 16 * 1024 * 1024)
+
+		with testgres.get_new_node('test', base_dir=new_temp_dir) as new_node:
+			self.loader.download(new_node.data_dir)
+			new_node.port = self.getBasePort() + 1
+			new_node.append_conf(port=new_node.port)
+
+			new_node.start()
+			self.assertEqual([(1, ), (2, ), (3, ), (4, ), (5, )],
+			                 new_node.execute("SELECT * FROM o_test_1"))
+			new_node.stop()
+			new_node.cleanup()
+
 	@s3_test_attrs(
 	    http=True,
 	    prefix=f'{S3BaseTest.bucket_name}/{S3BaseTest.optional_prefix}')
@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+from testgres.connection import DatabaseError
+
+from .base_test import BaseTest
+
+
+class SkipLockedTest(BaseTest):
+
+	def test_skip_locked_queue(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_queue (\n"
+		    "	id int NOT NULL,\n"
+		    "	payload text,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_queue (SELECT id, 'job ' || id\n"
+		    "	FROM generate_series(1, 100) id);\n")
+
+		con1 = node.connect()
+		con2 = node.connect()
+		con3 = node.connect()
+
+		# Row locks of the different strength at the head of the chains
+		self.assertEqual(
+		    con1.execute("SELECT id FROM o_queue ORDER BY id\n"
+		                 "FOR UPDATE SKIP LOCKED LIMIT 5;"),
+		    [(1, ), (2, ), (3, ), (4, ), (5, )])
+		con2.execute("SELECT id FROM o_queue WHERE id IN (6, 7) FOR KEY SHARE;")
+		con2.execute("UPDATE o_queue SET payload = 'taken' WHERE id = 8;")
+
+		self.assertEqual(
+		    con3.execute("SELECT id FROM o_queue ORDER BY id\n"
+		                 "FOR UPDATE SKIP LOCKED LIMIT 3;"),
+		    [(9, ), (10, ), (11, )])
+		self.assertEqual(
+		    con3.execute("SELECT id FROM o_queue ORDER BY id\n"
+		                 "FOR NO KEY UPDATE SKIP LOCKED LIMIT 3;"),
+		    [(6, ), (7, ), (9, )])
+		with self.assertRaises(DatabaseError) as e:
+			con3.execute("SELECT id FROM o_queue WHERE id = 3 FOR SHARE NOWAIT;")
+		self.assertErrorMessageEquals(
+		    e, 'could not obtain lock on row in relation "o_queue"')
+		con3.rollback()
+
+		# Own locks don't block
+		self.assertEqual(
+		    con1.execute("SELECT id FROM o_queue ORDER BY id\n"
+		                 "FOR UPDATE SKIP LOCKED LIMIT 2;"), [(1, ), (2, )])
+
+		con1.commit()
+		con2.commit()
+		self.assertEqual(
+		    con3.execute("SELECT id FROM o_queue ORDER BY id\n"
+		                 "FOR UPDATE SKIP LOCKED LIMIT 2;"), [(1, ), (2, )])
+		con3.commit()
+
+		con1.close()
+		con2.close()
+		con3.close()
+		node.stop()
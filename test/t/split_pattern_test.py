@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+import unittest
+
+from .base_test import BaseTest
+
+
+class SplitPatternTest(BaseTest):
+
+	def leaf_occupancy(self, node, relname):
+		return node.execute(
+		    "SELECT ROUND(avgoccupied * 100 / 8192) FROM orioledb_tree_stat('%s'::regclass) WHERE level = 0;"
+		    % relname)[0][0]
+
+	def test_interleaved_ascending_inserts(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	stream int4 NOT NULL,\n"
+		    "	seq int4 NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (stream, seq)\n"
+		    ") USING orioledb;\n")
+
+		# Every stream is ascending, but the order within stream is jittered
+		node.safe_psql(
+		    'postgres', "INSERT INTO o_test\n"
+		    "	(SELECT s, r * 2 + (r * 2 + s * 3) % 5, repeat('x', 40)\n"
+		    "	 FROM generate_series(1, 2000) r, generate_series(1, 20) s\n"
+		    "	 ORDER BY r, s);\n")
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_test;")[0][0], 40000)
+		self.assertGreaterEqual(self.leaf_occupancy(node, 'o_test'), 70)
+
+		# Random inserts keep the default split
+		node.safe_psql(
+		    'postgres', "TRUNCATE o_test;\n"
+		    "INSERT INTO o_test\n"
+		    "	(SELECT (v * 7919) % 20, (v * 104729) % 100003, repeat('x', 40)\n"
+		    "	 FROM generate_series(1, 40000) v);\n")
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_test;")[0][0], 40000)
+		node.stop()
+
+	def test_chunk_boundary_splits(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id text NOT NULL,\n"
+		    "	val int4 NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n")
+
+		# Keys of varying length make the chunk hikeys of different sizes,
+		# ascending inserts split the leaves at the chunk boundaries
+		node.safe_psql(
+		    'postgres', "INSERT INTO o_test\n"
+		    "	(SELECT lpad(v::text, 8, '0') || repeat('k', v % 50), v\n"
+		    "	 FROM generate_series(1, 20000) v);\n"
+		    "INSERT INTO o_test\n"
+		    "	(SELECT 'r' || lpad(((v * 7919) % 20011)::text, 8, '0') || repeat('r', v % 70), v\n"
+		    "	 FROM generate_series(1, 20000) v);\n")
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_test;")[0][0], 40000)
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_test'::regclass, true)")
+		    [0][0])
+		node.stop()
@@ -0,0 +1,46 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+import unittest
+
+from .base_test import BaseTest
+
+
+class TreeIOStatsTest(BaseTest):
+
+	def test_tree_io_stats(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int8 NOT NULL,\n"
+		    "	val text NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "CREATE INDEX o_test_val_idx ON o_test (val);\n"
+		    "INSERT INTO o_test\n"
+		    "	(SELECT id, id || repeat('x', 100)\n"
+		    "	 FROM generate_series(1, 10000) id);\n"
+		    "SELECT orioledb_tree_io_stats_reset();\n"
+		    "CHECKPOINT;\n"
+		    "SELECT orioledb_evict_pages('o_test'::regclass, 0);\n")
+
+		stats = node.execute(
+		    "SELECT writes > 0, bytes_written > 0, evictions > 0, "
+		    "compression_ratio > 0 "
+		    "FROM orioledb_statio_tables WHERE relid = 'o_test'::regclass;")
+		self.assertEqual(stats, [(True, True, True, True)])
+
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_test;")[0][0], 10000)
+		stats = node.execute(
+		    "SELECT disk_loads > 0, bytes_read > 0, load_time >= 0 "
+		    "FROM orioledb_statio_tables WHERE relid = 'o_test'::regclass;")
+		self.assertEqual(stats, [(True, True, True)])
+
+		node.safe_psql('postgres', "SELECT orioledb_tree_io_stats_reset();")
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM orioledb_statio_tables "
+		                 "WHERE relid = 'o_test'::regclass;")[0][0], 0)
+		node.stop()
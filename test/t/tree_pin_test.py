@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+from .base_test import BaseTest
+
+
+class TreePinTest(BaseTest):
+
+	def resident_pages(self, node, relname):
+		return node.execute(
+		    "SELECT coalesce(sum(r.pages), 0), bool_and(r.pinned)\n"
+		    "	FROM orioledb_tree_residency() r\n"
+		    "	JOIN pg_class c ON c.oid = r.reloid\n"
+		    f"	WHERE c.relname LIKE '{relname}%';")[0]
+
+	def test_tree_pin(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.pinned_pages_limit = 50\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_pinned (\n"
+		    "	id int NOT NULL,\n"
+		    "	val text NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "CREATE TABLE o_big (\n"
+		    "	id int NOT NULL,\n"
+		    "	val text NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_pinned\n"
+		    "	(SELECT id, repeat('x', 100) FROM generate_series(1, 5000) id);\n"
+		    "CHECKPOINT;\n"
+		    "SELECT orioledb_tree_pin('o_pinned');\n")
+
+		pages, pinned = self.resident_pages(node, 'o_pinned')
+		self.assertGreater(pages, 0)
+		self.assertTrue(pinned)
+
+		# Push the rest of the pool out with a table larger than the pool
+		node.safe_psql(
+		    'postgres', "INSERT INTO o_big\n"
+		    "	(SELECT id, repeat('y', 200) FROM generate_series(1, 100000) id);\n"
+		    "CHECKPOINT;\n")
+		self.assertEqual(self.resident_pages(node, 'o_pinned')[0], pages)
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_pinned;")[0][0], 5000)
+
+		# The limit is checked against the tree size
+		with self.assertRaises(Exception) as e:
+			node.safe_psql('postgres', "SELECT orioledb_tree_pin('o_big');")
+		self.assertIn("pinned_pages_limit", str(e.exception))
+
+		node.safe_psql('postgres', "SELECT orioledb_tree_unpin('o_pinned');")
+		self.assertFalse(self.resident_pages(node, 'o_pinned')[1])
+		node.stop()
+
+	def test_prewarm(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int NOT NULL,\n"
+		    "	val text NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "CREATE INDEX o_test_val_idx ON o_test (val);\n"
+		    "INSERT INTO o_test\n"
+		    "	(SELECT id, id::text FROM generate_series(1, 20000) id);\n")
+		node.stop()
+		node.start()
+
+		self.assertEqual(self.resident_pages(node, 'o_test')[0], 0)
+		loaded = node.execute("SELECT orioledb_prewarm('o_test');")[0][0]
+		self.assertGreater(loaded, 0)
+		self.assertGreaterEqual(self.resident_pages(node, 'o_test')[0],
+		                        loaded)
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_test WHERE val = '12345';")
+		    [0][0], 1)
+		node.stop()
@@ -0,0 +1,44 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+import unittest
+
+from .base_test import BaseTest
+
+
+class UndoCompressTest(BaseTest):
+
+	def test_undo_compress_old_versions(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "max_connections = 10\n"
+		    "orioledb.undo_buffers = 2MB\n"
+		    "orioledb.undo_compress = 3\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int8 NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_test (SELECT id, 'value ' || id FROM generate_series(1, 50000) id);\n"
+		)
+		query = "SELECT count(*), sum(id), sum(length(val)) FROM o_test;"
+
+		con1 = node.connect()
+		con1.execute("BEGIN TRANSACTION ISOLATION LEVEL REPEATABLE READ;")
+		expected = con1.execute(query)
+
+		# Old row versions of con1 snapshot get spilled to the undo files
+		for i in range(5):
+			node.safe_psql('postgres',
+			               "UPDATE o_test SET val = val || ' updated';")
+
+		self.assertEqual(con1.execute(query), expected)
+		con1.commit()
+		con1.close()
+
+		self.assertNotEqual(node.execute('postgres', query), expected)
+		node.stop()
+
@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+import unittest
+
+from .base_test import BaseTest
+
+
+class UndoDeltaTest(BaseTest):
+
+	def test_partial_column_updates(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int4 NOT NULL,\n"
+		    "	counter int4 NOT NULL,\n"
+		    "	payload text NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_test (SELECT id, 0, repeat('x', 1000) || id FROM generate_series(1, 100) id);\n"
+		)
+
+		con1 = node.connect()
+		con1.execute("BEGIN TRANSACTION ISOLATION LEVEL REPEATABLE READ;")
+		self.assertEqual(
+		    con1.execute("SELECT sum(counter) FROM o_test;")[0][0], 0)
+
+		# Several updates of the same rows within one transaction
+		con2 = node.connect()
+		con2.begin()
+		con2.execute("UPDATE o_test SET counter = counter + 1;")
+		con2.execute("UPDATE o_test SET counter = counter + 1;")
+		con2.execute("SAVEPOINT s1;")
+		con2.execute("UPDATE o_test SET counter = counter + 10;")
+		con2.execute("ROLLBACK TO SAVEPOINT s1;")
+		con2.execute("UPDATE o_test SET counter = counter + 1;")
+		self.assertEqual(
+		    con2.execute("SELECT sum(counter) FROM o_test;")[0][0], 300)
+		con2.commit()
+
+		# Old versions are rebuilt from delta undo records
+		self.assertEqual(
+		    con1.execute("SELECT sum(counter), sum(length(payload)) FROM o_test;")
+		    [0], (0, 100192))
+		con1.commit()
+
+		con2.begin()
+		con2.execute("UPDATE o_test SET counter = counter + 5 WHERE id <= 50;")
+		con2.execute(
+		    "UPDATE o_test SET payload = payload || 'y' WHERE id <= 10;")
+		con2.rollback()
+		con1.close()
+		con2.close()
+
+		self.assertEqual(
+		    node.execute(
+		        "SELECT sum(counter), sum(length(payload)), "
+		        "count(*) FILTER (WHERE payload = repeat('x', 1000) || id) "
+		        "FROM o_test;")[0], (300, 100192, 100))
+		node.stop()
@@ -0,0 +1,52 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+import unittest
+
+from .base_test import BaseTest
+
+
+class UndoStatsTest(BaseTest):
+
+	def test_undo_stats_retaining_snapshot(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int8 NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_test (SELECT id, 'value ' || id FROM generate_series(1, 1000) id);\n"
+		)
+
+		con1 = node.connect()
+		con1.execute("BEGIN TRANSACTION ISOLATION LEVEL REPEATABLE READ;")
+		con1.execute("SELECT count(*) FROM o_test;")
+		pid = con1.pid
+
+		node.safe_psql('postgres', "UPDATE o_test SET val = val || ' updated';")
+
+		stats = node.execute(
+		    "SELECT snapshot_retain_location IS NOT NULL,\n"
+		    "       snapshot_retain_size > 0,\n"
+		    "       xmin_age >= 0\n"
+		    "FROM orioledb_undo_backend_stats()\n"
+		    "WHERE pid = %d AND undo_type = 'regular';" % pid)
+		self.assertEqual(stats, [(True, True, True)])
+
+		stats = node.execute(
+		    "SELECT last_used_location >= min_retain_location,\n"
+		    "       in_memory_size + spilled_size > 0\n"
+		    "FROM orioledb_undo_stats()\n"
+		    "WHERE undo_type = 'regular';")
+		self.assertEqual(stats, [(True, True)])
+
+		con1.commit()
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM orioledb_undo_backend_stats()\n"
+		                 "WHERE pid = %d AND snapshot_retain_location IS NOT NULL;" %
+		                 pid), [(0, )])
+		con1.close()
+		node.stop()
@@ -1,6 +1,8 @@
 #!/usr/bin/env python3
 # coding: utf-8
 
+import os
+
 from .base_test import BaseTest
 from testgres.exceptions import QueryException
 
@@ -61,6 +63,90 @@ class UnloggedTest(BaseTest):
 		self.assertEqual(node.execute("SELECT * FROM o_test_1;"), [(1, )])
 		node.stop()
 
+	def test_unlogged_table_copy_freeze(self):
+		node = self.node
+		node.start()
+		data = os.path.join(node.base_dir, 'copy_freeze.data')
+
+		node.safe_psql("""
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			COPY (SELECT id, CASE WHEN id %% 1000 = 0
+								  THEN repeat(id::text, 2000)
+								  ELSE id::text END
+				  FROM generate_series(10000, 1, -1) id)
+				TO '%s';
+
+			BEGIN;
+			CREATE UNLOGGED TABLE o_test_1 (
+				val_1 int PRIMARY KEY,
+				val_2 text
+			) USING orioledb;
+			CREATE UNLOGGED TABLE o_test_2 (
+				val_1 int,
+				val_2 text
+			) USING orioledb;
+			COPY o_test_1 FROM '%s' WITH (FREEZE);
+			COPY o_test_2 FROM '%s' WITH (FREEZE);
+			COMMIT;
+		""" % (data, data, data))
+
+		def check():
+			self.assertEqual(
+			    node.execute("SELECT count(*), sum(length(val_2)) "
+			                 "FROM o_test_1;"),
+			    node.execute("SELECT count(*), sum(length(val_2)) "
+			                 "FROM o_test_2;"))
+			self.assertEqual(
+			    node.execute("SELECT val_2 FROM o_test_1 WHERE val_1 = 5;"),
+			    [('5', )])
+			self.assertEqual(
+			    node.execute("SELECT length(val_2) FROM o_test_1 "
+			                 "WHERE val_1 = 3000;"), [(8000, )])
+
+		self.assertEqual(node.execute("SELECT count(*) FROM o_test_1;"),
+		                 [(10000, )])
+		check()
+		node.safe_psql("""
+			INSERT INTO o_test_1 VALUES (10001, '10001');
+			INSERT INTO o_test_2 VALUES (10001, '10001');
+		""")
+		self.assertEqual(
+		    node.execute("SELECT count(DISTINCT ctid) FROM o_test_2;"),
+		    [(10001, )])
+
+		node.stop()
+		node.start()
+		check()
+		node.stop()
+
+	def test_unlogged_table_copy_freeze_duplicate(self):
+		node = self.node
+		node.start()
+		data = os.path.join(node.base_dir, 'copy_freeze_dup.data')
+
+		node.safe_psql("""
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			COPY (SELECT id %% 5000 + 1, id::text
+				  FROM generate_series(1, 5001) id)
+				TO '%s';
+		""" % data)
+
+		with self.assertRaises(QueryException) as e:
+			node.safe_psql("""
+				BEGIN;
+				CREATE UNLOGGED TABLE o_test_1 (
+					val_1 int PRIMARY KEY,
+					val_2 text
+				) USING orioledb;
+				COPY o_test_1 FROM '%s' WITH (FREEZE);
+				COMMIT;
+			""" % data)
+		self.assertIn(
+		    'ERROR:  duplicate key value violates unique constraint '
+		    '"o_test_1_pkey"\n'
+		    'DETAIL:  Key (val_1)=(\'2\') already exists.', e.exception.message)
+		node.stop()
+
 	def test_unlogged_table_replication(self):
 		node = self.node
 		node.start()
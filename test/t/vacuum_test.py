@@ -1,3 +1,4 @@
+import re
 import unittest
 from .base_test import BaseTest
 from testgres.connection import DatabaseError
@@ -212,3 +213,37 @@ class VacuumTest(BaseTest):
 
 		node.start()
 		node.stop()
+
+	def test_vacuum_sparse_pages(self):
+		node = self.node
+		node.start()
+		node.safe_psql("""
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+
+			CREATE TABLE o_test_1(
+				val_1 int PRIMARY KEY,
+				val_2 text
+			)USING orioledb;
+			CREATE INDEX o_test_1_val_2_idx ON o_test_1 (val_2);
+
+			INSERT INTO o_test_1
+				(SELECT val_1, repeat('x', 50) || val_1
+				 FROM generate_series(1, 50000) AS val_1);
+			DELETE FROM o_test_1 WHERE val_1 % 10 != 0;
+		""")
+
+		_, _, err = node.psql("VACUUM (VERBOSE) o_test_1;")
+		match = re.search(
+		    r"pages: (\d+) scanned, (\d+) compacted, (\d+) merged; (\d+) bytes reclaimed",
+		    err.decode("utf-8"))
+		self.assertIsNotNone(match)
+		self.assertGreater(int(match.group(2)) + int(match.group(3)), 0)
+		self.assertGreater(int(match.group(4)), 0)
+
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(val_1) FROM o_test_1;")[0],
+		    (5000, 125025000))
+		self.assertEqual(
+		    node.execute("SELECT val_1 FROM o_test_1 WHERE val_2 = '" +
+		                 "x" * 50 + "12340';")[0][0], 12340)
+		node.stop()
@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+import unittest
+
+from .base_test import BaseTest
+
+
+class WalCompressTest(BaseTest):
+
+	def test_wal_compress_recovery(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.wal_compress = 3\n"
+		    "orioledb.wal_compress_threshold = 512\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int8 NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_test (SELECT id, 'value ' || id FROM generate_series(1, 20000) id);\n"
+		    "UPDATE o_test SET val = val || ' updated' WHERE id % 3 = 0;\n"
+		    "DELETE FROM o_test WHERE id % 7 = 0;\n")
+		query = "SELECT count(*), sum(id), sum(length(val)) FROM o_test;"
+		expected = node.execute(query)
+
+		node.stop(['-m', 'immediate'])
+		node.start()
+		self.assertEqual(node.execute(query), expected)
+		node.stop()
+
+	def test_wal_compress_replication(self):
+		with self.node as master:
+			master.append_conf('postgresql.conf',
+			                   "orioledb.wal_compress = 1\n")
+			master.start()
+
+			with self.getReplica().start() as replica:
+				master.safe_psql(
+				    "CREATE EXTENSION orioledb;\n"
+				    "CREATE TABLE o_test (\n"
+				    "	id int8 NOT NULL,\n"
+				    "	val text,\n"
+				    "	PRIMARY KEY (id)\n"
+				    ") USING orioledb;\n"
+				    "INSERT INTO o_test (SELECT id, repeat('x', id % 100) FROM generate_series(1, 10000) id);\n"
+				)
+				master.safe_psql(
+				    "UPDATE o_test SET val = val || 'y' WHERE id <= 5000;")
+
+				self.catchup_orioledb(replica)
+				query = "SELECT count(*), sum(length(val)) FROM o_test;"
+				self.assertEqual(replica.execute(query),
+				                 master.execute(query))
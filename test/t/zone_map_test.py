@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+import re
+import unittest
+
+from .base_test import BaseTest
+
+
+class ZoneMapTest(BaseTest):
+
+	def skipped_leaves(self, con, query):
+		plan = con.execute("EXPLAIN (ANALYZE, COSTS OFF, TIMING OFF) " +
+		                   query)
+		for row in plan:
+			match = re.search(r"Zone Map Skipped Leaves: (\d+)", row[0])
+			if match:
+				return int(match.group(1))
+		return None
+
+	def test_zone_map_seq_scan(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.zone_map_size = 65536\n"
+		    "max_parallel_workers_per_gather = 0\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id int8 NOT NULL,\n"
+		    "	ts int8 NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_test (SELECT id, id, id::text FROM generate_series(1, 100000) id);\n"
+		)
+
+		query = "SELECT count(*) FROM o_test WHERE ts >= 5000 AND ts <= 5010;"
+
+		# The first scan builds summaries, the next ones use them
+		self.assertEqual(node.execute(query)[0][0], 11)
+		self.assertEqual(node.execute(query)[0][0], 11)
+		self.assertGreater(self.skipped_leaves(node, query), 0)
+		self.assertEqual(node.execute(query)[0][0], 11)
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_test WHERE ts = 99999;")[0][0],
+		    1)
+
+		con1 = node.connect()
+		con1.execute("BEGIN TRANSACTION ISOLATION LEVEL REPEATABLE READ;")
+		self.assertEqual(con1.execute(query)[0][0], 11)
+
+		# Modifications invalidate summaries of the changed leaves
+		con2 = node.connect()
+		con2.begin()
+		con2.execute("UPDATE o_test SET ts = 5005 WHERE id = 100;")
+		con2.commit()
+		con2.close()
+
+		self.assertEqual(node.execute(query)[0][0], 12)
+		self.assertEqual(node.execute(query)[0][0], 12)
+		self.assertEqual(con1.execute(query)[0][0], 11)
+		con1.commit()
+		con1.close()
+
+		node.safe_psql('postgres', "DELETE FROM o_test WHERE id = 5003;")
+		self.assertEqual(node.execute(query)[0][0], 11)
+		self.assertEqual(
+		    node.execute(
+		        "SELECT count(*) FROM o_test WHERE ts < 0 OR ts > 100000;")
+		    [0][0], 0)
+		node.stop()